@@ -0,0 +1,550 @@
+/*
+ * Microbenchmarks of the request hot paths
+ *
+ * Usage: mbbench [filter]  Runs the workloads whose name contains filter
+ *
+ * Every workload is run for N_ROUNDS rounds of a fixed number of operations
+ * on deterministic inputs, and the minimum and median cost per operation is
+ * reported. Costs are CPU cycles (rdtsc on x86, DWT cycle counter on Armv7-M
+ * and Armv8-M Mainline), or nanoseconds on other targets. A port can provide
+ * its own counter by defining MBBENCH_CYCLES to a function returning uint64_t.
+ */
+#if !defined(MBBENCH_CYCLES) && !defined(__x86_64__) && !defined(__i386__) \
+	&& !defined(__ARM_ARCH_7M__) && !defined(__ARM_ARCH_7EM__) && !defined(__ARM_ARCH_8M_MAIN__)
+#define _POSIX_C_SOURCE 199309L
+#define MBBENCH_USE_CLOCK 1
+#endif
+
+#include <endian.h>
+#include <mbadu.h>
+#include <mbadu_ascii.h>
+#include <mbadu_tcp.h>
+#include <mbarena.h>
+#include <mbcoil.h>
+#include <mbcrc.h>
+#include <mbfile.h>
+#include <mbimage.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <mbplan.h>
+#include <mbreg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(MBBENCH_CYCLES)
+extern uint64_t MBBENCH_CYCLES(void);
+#define COST_UNIT "cycles"
+static uint64_t cycles(void) { return MBBENCH_CYCLES(); }
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define COST_UNIT "cycles"
+static uint64_t cycles(void) { return __rdtsc(); }
+#elif defined(MBBENCH_USE_CLOCK)
+#include <time.h>
+#define COST_UNIT "ns"
+static uint64_t cycles(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000u + (uint64_t)ts.tv_nsec;
+}
+#else
+#define COST_UNIT "cycles"
+#define DEMCR (*(volatile uint32_t *)0xE000EDFCu)
+#define DWT_CTRL (*(volatile uint32_t *)0xE0001000u)
+#define DWT_CYCCNT (*(volatile uint32_t *)0xE0001004u)
+static uint64_t cycles(void)
+{
+	static uint32_t s_last;
+	static uint64_t s_high;
+	uint32_t now;
+
+	if (!(DWT_CTRL & 1u)) {
+		DEMCR |= 1u<<24; /* TRCENA */
+		DWT_CYCCNT = 0u;
+		DWT_CTRL |= 1u; /* CYCCNTENA */
+	}
+
+	/* Extend the 32-bit counter, rounds are far shorter than a wrap */
+	now = DWT_CYCCNT;
+	if (now < s_last) s_high += 1ull<<32;
+	s_last = now;
+	return s_high | now;
+}
+#endif
+
+enum {
+	N_ROUNDS=15u,
+	N_REQS=64u, /* Distinct requests per workload, used round robin */
+
+	N_SMALL=8u,
+	N_MEDIUM=200u,
+	N_LARGE=5000u,
+
+	N_COILS=2048u,
+	N_FILE_WORDS=2048u,
+
+	READ_QTY=16u,
+
+	LOG_SUB_REQS=8u, /* Adjacent sub-requests of a log download */
+	LOG_SUB_LEN=14u, /* Records per sub-request, filling the response */
+	FC_FILE_LOG=0x80u, /* Function code 0x14 reading the sub-requests of a log download */
+};
+
+/* Register maps of increasing size, a mix of u16 and u32 registers */
+static struct mbreg_desc_s s_small[N_SMALL];
+static struct mbreg_desc_s s_medium[N_MEDIUM];
+static struct mbreg_desc_s s_large[N_LARGE];
+static uint16_t s_u16s[N_LARGE];
+static uint32_t s_u32s[N_LARGE];
+
+static uint16_t s_large_dense_storage[N_LARGE*2u];
+static struct mbreg_index_s s_large_dense;
+static uint16_t s_large_range_storage[MBREG_RANGE_INDEX_SIZE(N_LARGE)];
+static struct mbreg_index_s s_large_ranges;
+static struct mbreg_kernel_s s_large_kern[N_LARGE];
+static uint8_t s_large_image_bufs[2][N_LARGE*4u];
+static struct mbimage_s s_large_image;
+
+static uint8_t s_coil_bits[N_COILS/8u];
+static const struct mbcoil_desc_s s_coils[] = {
+	{.address=0x0000, .access=MCACC_RW_PTR, .read={.ptr=s_coil_bits, .ix=0u}, .write={.ptr=s_coil_bits, .ix=0u}, .n_block_entries=N_COILS},
+};
+
+static uint16_t s_file_words[N_FILE_WORDS];
+
+/* Log in "serial flash", copied as a flash driver would */
+static enum mbstatus_e log_read(uint16_t record_no, size_t n, uint8_t *dst)
+{
+	(void)memcpy(dst, (const uint8_t *)s_file_words + (2u*(size_t)record_no), 2u*n);
+	return MB_OK;
+}
+static const struct mbfile_region_s s_log = {.size=sizeof s_file_words, .is_be=0, .read_cb=log_read};
+
+static const struct mbfile_desc_s s_files[] = {
+	{.file_no=1u, .words=s_file_words, .n_words=N_FILE_WORDS},
+	{.file_no=2u, .region=&s_log},
+};
+
+static _Alignas(max_align_t) uint8_t s_arena_buf[1024];
+static struct mbarena_s s_arena = {.buf=s_arena_buf, .size=sizeof s_arena_buf};
+static struct mbadu_exc_table_s s_exc_table;
+static struct mbplan_entry_s s_plan_entries[N_REQS];
+static struct mbplan_s s_plan = {.entries=s_plan_entries, .n_entries=N_REQS};
+static struct mbinst_s s_inst;
+
+/* Requests of the current workload */
+static uint8_t s_reqs[N_REQS][MBADU_ASCII_SIZE_MAX];
+static size_t s_req_lens[N_REQS];
+static uint16_t s_addrs[N_REQS];
+
+static volatile size_t s_sink;
+
+/**
+ * @brief Deterministic pseudo random numbers (LCG)
+ */
+static uint32_t rnd(void)
+{
+	static uint32_t s_state = 12345u;
+	s_state = s_state*1103515245u + 12345u;
+	return s_state >> 8;
+}
+
+/**
+ * @brief Fill a register map, returns number of addresses covered
+ */
+static uint16_t build_map(struct mbreg_desc_s *regs, size_t n_regs)
+{
+	uint16_t addr = 0u;
+	size_t i;
+
+	for (i=0u; i<n_regs; ++i) {
+		(void)memset(regs+i, 0, sizeof regs[i]);
+		regs[i].address = addr;
+		if ((i%4u) == 3u) {
+			regs[i].type = MRTYPE_U32;
+			regs[i].access = MRACC_RW_PTR;
+			regs[i].read.pu32 = s_u32s+i;
+			regs[i].write.pu32 = s_u32s+i;
+			addr += 2u;
+		} else {
+			regs[i].type = MRTYPE_U16;
+			regs[i].access = MRACC_RW_PTR;
+			regs[i].read.pu16 = s_u16s+i;
+			regs[i].write.pu16 = s_u16s+i;
+			addr += 1u;
+		}
+	}
+
+	return addr;
+}
+
+/**
+ * @brief Random start addresses of READ_QTY register reads within a map
+ */
+static void pick_addrs(uint16_t n_addrs)
+{
+	size_t i;
+
+	for (i=0u; i<N_REQS; ++i) {
+		s_addrs[i] = (uint16_t)(rnd() % (uint32_t)(n_addrs - READ_QTY));
+	}
+}
+
+/**
+ * @brief Attach a holding register map to the instance
+ */
+static void use_map(const struct mbreg_desc_s *regs, size_t n_regs, const struct mbreg_index_s *ix)
+{
+	(void)memset(&s_inst, 0, sizeof s_inst);
+	s_inst.serial.slave_addr = 1u;
+	s_inst.hold_regs = regs;
+	s_inst.n_hold_regs = n_regs;
+	s_inst.hold_regs_ix = ix;
+	s_inst.coils = s_coils;
+	s_inst.n_coils = sizeof s_coils / sizeof s_coils[0];
+	s_inst.files = s_files;
+	s_inst.n_files = sizeof s_files / sizeof s_files[0];
+	s_inst.arena = &s_arena;
+	mbinst_init(&s_inst);
+	mbarena_init(&s_arena);
+}
+
+/**
+ * @brief Build PDU of request i of a function code mix
+ */
+static size_t build_pdu(uint8_t fc, size_t i, uint8_t *pdu)
+{
+	uint16_t addr = s_addrs[i];
+	size_t k;
+
+	pdu[0] = fc;
+	switch (fc) {
+	case MBFC_READ_COILS:
+		u16tobe((uint16_t)(addr % (N_COILS-64u)), pdu+1u);
+		u16tobe(64u, pdu+3u);
+		return 5u;
+	case MBFC_READ_HOLDING_REGS:
+		u16tobe(addr, pdu+1u);
+		u16tobe(READ_QTY, pdu+3u);
+		return 5u;
+	case MBFC_WRITE_MULTIPLE_REGS:
+		u16tobe(addr, pdu+1u);
+		u16tobe(READ_QTY, pdu+3u);
+		pdu[5] = READ_QTY*2u;
+		for (k=0u; k<READ_QTY; ++k) u16tobe((uint16_t)rnd(), pdu+6u+k*2u);
+		return 6u + READ_QTY*2u;
+	case MBFC_READ_FILE_RECORD:
+		pdu[1] = 7u;
+		pdu[2] = 6u; /* Reference type */
+		u16tobe(1u, pdu+3u);
+		u16tobe((uint16_t)(addr % (N_FILE_WORDS-READ_QTY)), pdu+5u);
+		u16tobe(READ_QTY, pdu+7u);
+		return 9u;
+	case FC_FILE_LOG:
+		pdu[0] = MBFC_READ_FILE_RECORD;
+		pdu[1] = LOG_SUB_REQS*7u;
+		for (k=0u; k<LOG_SUB_REQS; ++k) {
+			pdu[2u+k*7u] = 6u; /* Reference type */
+			u16tobe(2u, pdu+3u+k*7u); /* Log */
+			u16tobe((uint16_t)((addr % (N_FILE_WORDS-LOG_SUB_REQS*LOG_SUB_LEN)) + k*LOG_SUB_LEN), pdu+5u+k*7u);
+			u16tobe(LOG_SUB_LEN, pdu+7u+k*7u);
+		}
+		return 2u + LOG_SUB_REQS*7u;
+	case MBFC_READ_WRITE_REGS:
+		u16tobe(addr, pdu+1u);
+		u16tobe(READ_QTY/2u, pdu+3u);
+		u16tobe(addr, pdu+5u);
+		u16tobe(READ_QTY/2u, pdu+7u);
+		pdu[9] = READ_QTY;
+		for (k=0u; k<READ_QTY/2u; ++k) u16tobe((uint16_t)rnd(), pdu+10u+k*2u);
+		return 10u + READ_QTY;
+	default:
+		/* Unsupported function code, as sent by scanners */
+		(void)memset(pdu+1u, 0, 4u);
+		return 5u;
+	}
+}
+
+/** @brief Function code mix of the pdu_mix workload */
+static const uint8_t s_mix[] = {
+	MBFC_READ_HOLDING_REGS, MBFC_READ_HOLDING_REGS, MBFC_READ_HOLDING_REGS, MBFC_READ_HOLDING_REGS,
+	MBFC_WRITE_MULTIPLE_REGS, MBFC_WRITE_MULTIPLE_REGS,
+	MBFC_READ_COILS, MBFC_READ_WRITE_REGS, MBFC_READ_FILE_RECORD,
+};
+
+enum framing_e {FRAME_PDU, FRAME_RTU, FRAME_ASCII, FRAME_TCP};
+
+/**
+ * @brief Build the requests of a workload, fc 0 selects the mix
+ */
+static void build_reqs(uint8_t fc, enum framing_e framing)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	uint8_t pdu[MBPDU_SIZE_MAX];
+	size_t i, k, n;
+	uint8_t lrc;
+	uint8_t *req;
+
+	for (i=0u; i<N_REQS; ++i) {
+		n = build_pdu((fc!=0u) ? fc : s_mix[i % sizeof s_mix], i, pdu);
+		req = s_reqs[i];
+
+		switch (framing) {
+		case FRAME_PDU:
+			(void)memcpy(req, pdu, n);
+			s_req_lens[i] = n;
+			break;
+		case FRAME_RTU:
+			req[0] = 1u;
+			(void)memcpy(req+1u, pdu, n);
+			u16tole(mbcrc16(req, n+1u), req+n+1u);
+			s_req_lens[i] = n+3u;
+			break;
+		case FRAME_ASCII:
+			req[0] = ':';
+			lrc = 1u;
+			req[1] = '0';
+			req[2] = '1';
+			for (k=0u; k<n; ++k) {
+				req[3u+k*2u] = (uint8_t)hex[pdu[k] >> 4];
+				req[4u+k*2u] = (uint8_t)hex[pdu[k] & 0x0Fu];
+				lrc = (uint8_t)(lrc + pdu[k]);
+			}
+			lrc = (uint8_t)(-lrc);
+			req[3u+n*2u] = (uint8_t)hex[lrc >> 4];
+			req[4u+n*2u] = (uint8_t)hex[lrc & 0x0Fu];
+			req[5u+n*2u] = '\r';
+			req[6u+n*2u] = '\n';
+			s_req_lens[i] = 7u+n*2u;
+			break;
+		case FRAME_TCP:
+			u16tobe((uint16_t)i, req);
+			u16tobe(0u, req+2u);
+			u16tobe((uint16_t)(n+1u), req+4u);
+			req[6] = 1u;
+			(void)memcpy(req+7u, pdu, n);
+			s_req_lens[i] = n+7u;
+			break;
+		}
+	}
+}
+
+/**
+ * @brief Run operation i of a workload
+ */
+typedef size_t (*op_fn)(size_t i);
+
+static size_t op_pdu(size_t i)
+{
+	uint8_t res[MBPDU_SIZE_MAX];
+	return mbpdu_handle_req(&s_inst, s_reqs[i], s_req_lens[i], res);
+}
+
+static size_t op_rtu(size_t i)
+{
+	uint8_t res[MBADU_SIZE_MAX];
+	return mbadu_handle_req(&s_inst, s_reqs[i], s_req_lens[i], res);
+}
+
+static size_t op_ascii(size_t i)
+{
+	uint8_t res[MBADU_ASCII_SIZE_MAX];
+	return mbadu_ascii_handle_req(&s_inst, s_reqs[i], s_req_lens[i], res);
+}
+
+static size_t op_tcp(size_t i)
+{
+	uint8_t res[MBADU_TCP_SIZE_MAX];
+	return mbadu_tcp_handle_req(&s_inst, s_reqs[i], s_req_lens[i], res);
+}
+
+static size_t op_crc_rtu(size_t i)
+{
+	return mbcrc16(s_reqs[i], s_req_lens[i]);
+}
+
+static size_t op_crc_256(size_t i)
+{
+	return mbcrc16(s_reqs[0], 256u) + i;
+}
+
+static const struct mbreg_desc_s *s_find_regs;
+static size_t s_find_n_regs;
+static const struct mbreg_index_s *s_find_ix;
+
+static size_t op_find(size_t i)
+{
+	return mbreg_index_find(s_find_ix, s_find_regs, s_find_n_regs, s_addrs[i]) != NULL;
+}
+
+/**
+ * @brief Sort round costs for the median
+ */
+static void sort(uint64_t *v, size_t n)
+{
+	size_t i, j;
+	uint64_t x;
+
+	for (i=1u; i<n; ++i) {
+		x = v[i];
+		for (j=i; (j>0u) && (v[j-1u] > x); --j) v[j] = v[j-1u];
+		v[j] = x;
+	}
+}
+
+/**
+ * @brief Run and report a workload
+ */
+static void run(const char *filter, const char *name, op_fn op, size_t n_ops)
+{
+	uint64_t costs[N_ROUNDS];
+	uint64_t t0;
+	size_t round, k, sink, resp_size;
+
+	if ((filter!=NULL) && (strstr(name, filter)==NULL)) return;
+
+	/* Warm up and check that the workload gets responses */
+	resp_size = op(0u);
+
+	for (round=0u; round<N_ROUNDS; ++round) {
+		sink = 0u;
+		t0 = cycles();
+		for (k=0u; k<n_ops; ++k) {
+			sink += op(k % N_REQS);
+		}
+		costs[round] = cycles() - t0;
+		s_sink += sink;
+	}
+	sort(costs, N_ROUNDS);
+
+	printf("%-28s %10.1f %10.1f %8zu\n",
+		name,
+		(double)costs[0] / (double)n_ops,
+		(double)costs[N_ROUNDS/2u] / (double)n_ops,
+		resp_size);
+}
+
+int main(int argc, char **argv)
+{
+	const char *filter = (argc > 1) ? argv[1] : NULL;
+	uint16_t n_small, n_medium, n_large;
+	size_t i;
+
+	n_small = build_map(s_small, N_SMALL);
+	n_medium = build_map(s_medium, N_MEDIUM);
+	n_large = build_map(s_large, N_LARGE);
+	(void)mbreg_index_build(&s_large_dense, s_large, N_LARGE,
+		s_large_dense_storage, sizeof s_large_dense_storage / sizeof s_large_dense_storage[0]);
+	(void)mbreg_index_build_ranges(&s_large_ranges, s_large, N_LARGE,
+		s_large_range_storage, sizeof s_large_range_storage / sizeof s_large_range_storage[0]);
+	mbreg_kernels_build(s_large_kern, s_large, N_LARGE, 0);
+	for (i=0u; i<N_FILE_WORDS; ++i) s_file_words[i] = (uint16_t)i;
+
+	printf("%-28s %10s %10s %8s\n", "workload", "min", "median", "resp");
+	printf("%-28s %21s/op\n", "", COST_UNIT);
+
+	/* CRC */
+	for (i=0u; i<N_REQS; ++i) {
+		for (size_t k=0u; k<MBADU_ASCII_SIZE_MAX; ++k) s_reqs[i][k] = (uint8_t)rnd();
+		s_req_lens[i] = 8u;
+	}
+	run(filter, "crc16_8B", op_crc_rtu, 10000u);
+	run(filter, "crc16_256B", op_crc_256, 1000u);
+
+	/* Descriptor lookup */
+	s_find_ix = NULL;
+	s_find_regs = s_small; s_find_n_regs = N_SMALL; pick_addrs(n_small);
+	run(filter, "find_desc_small", op_find, 10000u);
+	s_find_regs = s_medium; s_find_n_regs = N_MEDIUM; pick_addrs(n_medium);
+	run(filter, "find_desc_medium", op_find, 10000u);
+	s_find_regs = s_large; s_find_n_regs = N_LARGE; pick_addrs(n_large);
+	run(filter, "find_desc_large", op_find, 10000u);
+	s_find_ix = &s_large_dense;
+	run(filter, "find_desc_large_dense_ix", op_find, 10000u);
+	s_find_ix = &s_large_ranges;
+	run(filter, "find_desc_large_range_ix", op_find, 10000u);
+
+	/* Function codes on maps of increasing size */
+	use_map(s_small, N_SMALL, NULL);
+	pick_addrs(n_small);
+	build_reqs(MBFC_READ_HOLDING_REGS, FRAME_PDU);
+	run(filter, "pdu_fc03_small", op_pdu, 2000u);
+
+	use_map(s_medium, N_MEDIUM, NULL);
+	pick_addrs(n_medium);
+	build_reqs(MBFC_READ_HOLDING_REGS, FRAME_PDU);
+	run(filter, "pdu_fc03_medium", op_pdu, 2000u);
+
+	use_map(s_large, N_LARGE, NULL);
+	pick_addrs(n_large);
+	build_reqs(MBFC_READ_HOLDING_REGS, FRAME_PDU);
+	run(filter, "pdu_fc03_large", op_pdu, 2000u);
+	build_reqs(MBFC_WRITE_MULTIPLE_REGS, FRAME_PDU);
+	run(filter, "pdu_fc10_large", op_pdu, 2000u);
+	build_reqs(MBFC_READ_COILS, FRAME_PDU);
+	run(filter, "pdu_fc01_64coils", op_pdu, 2000u);
+	build_reqs(MBFC_READ_WRITE_REGS, FRAME_PDU);
+	run(filter, "pdu_fc17_large", op_pdu, 2000u);
+	build_reqs(MBFC_READ_FILE_RECORD, FRAME_PDU);
+	run(filter, "pdu_fc14_flat_file", op_pdu, 2000u);
+	build_reqs(FC_FILE_LOG, FRAME_PDU);
+	run(filter, "pdu_fc14_flash_log", op_pdu, 2000u);
+	build_reqs(0u, FRAME_PDU);
+	run(filter, "pdu_mix_large", op_pdu, 2000u);
+
+	use_map(s_large, N_LARGE, &s_large_dense);
+	run(filter, "pdu_mix_large_dense_ix", op_pdu, 2000u);
+	use_map(s_large, N_LARGE, &s_large_ranges);
+	run(filter, "pdu_mix_large_range_ix", op_pdu, 2000u);
+
+	/* Kernels against the generic register access */
+	use_map(s_large, N_LARGE, &s_large_dense);
+	build_reqs(MBFC_READ_HOLDING_REGS, FRAME_PDU);
+	run(filter, "pdu_fc03_large_dense_ix", op_pdu, 2000u);
+	build_reqs(MBFC_WRITE_MULTIPLE_REGS, FRAME_PDU);
+	run(filter, "pdu_fc10_large_dense_ix", op_pdu, 2000u);
+	s_inst.hold_regs_kern = s_large_kern;
+	build_reqs(MBFC_READ_HOLDING_REGS, FRAME_PDU);
+	run(filter, "pdu_fc03_large_kern", op_pdu, 2000u);
+	build_reqs(MBFC_WRITE_MULTIPLE_REGS, FRAME_PDU);
+	run(filter, "pdu_fc10_large_kern", op_pdu, 2000u);
+
+	/* The same poll cycle read through recorded plans */
+	mbplan_init(&s_plan);
+	s_inst.plan = &s_plan;
+	build_reqs(MBFC_READ_HOLDING_REGS, FRAME_PDU);
+	run(filter, "pdu_fc03_large_kern_plan", op_pdu, 2000u);
+
+	/* Reads copied from a published image of the whole map */
+	s_large_image = (struct mbimage_s){.start=0u, .n_regs=n_large,
+		.bufs={s_large_image_bufs[0], s_large_image_bufs[1]}, .n_bufs=2u};
+	(void)mbimage_init(&s_large_image);
+	(void)mbimage_capture(&s_large_image, s_large, N_LARGE, 0);
+	mbimage_publish(&s_large_image);
+	use_map(s_large, N_LARGE, &s_large_dense);
+	s_inst.hold_regs_image = &s_large_image;
+	build_reqs(MBFC_READ_HOLDING_REGS, FRAME_PDU);
+	run(filter, "pdu_fc03_large_image", op_pdu, 2000u);
+
+	/* Framing of FC 0x03 on the medium map */
+	use_map(s_medium, N_MEDIUM, NULL);
+	pick_addrs(n_medium);
+	build_reqs(MBFC_READ_HOLDING_REGS, FRAME_RTU);
+	run(filter, "adu_rtu_fc03", op_rtu, 2000u);
+	build_reqs(MBFC_READ_HOLDING_REGS, FRAME_ASCII);
+	run(filter, "adu_ascii_fc03", op_ascii, 2000u);
+	build_reqs(MBFC_READ_HOLDING_REGS, FRAME_TCP);
+	run(filter, "adu_tcp_fc03", op_tcp, 2000u);
+
+	/* Function code sweep of a scanner */
+	build_reqs(0x41u, FRAME_RTU);
+	run(filter, "adu_rtu_illegal_fn", op_rtu, 2000u);
+	mbadu_exc_table_init(&s_exc_table, 1u);
+	s_inst.serial.exc_table = &s_exc_table;
+	run(filter, "adu_rtu_illegal_fn_exc_table", op_rtu, 2000u);
+
+	return 0;
+}
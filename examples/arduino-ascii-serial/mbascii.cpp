@@ -12,51 +12,85 @@
 #include <stdint.h>
 #include <stddef.h>
 
-extern "C" {
-#include <mbadu_ascii.h>
-}
+#include <mbserial.hpp>
+
+enum {TIMEOUT_US=1000000};
+
+/**
+ * Serial port for mbserial, transmission is left to the interrupt driven
+ * TX buffer of HardwareSerial instead of waiting in Serial.flush()
+ */
+struct arduino_port {
+	unsigned long char_us; /* Time of one character, at most 11 bits */
+	int tx_room; /* availableForWrite() with an empty TX buffer */
+	bool tx_empty; /* TX buffer seen empty since the last write */
+	unsigned long tx_empty_us; /* Time the TX buffer was seen empty */
+
+	void begin(unsigned long baud)
+	{
+		char_us = 11000000ul/baud + 1ul;
+		tx_room = Serial.availableForWrite();
+		tx_empty = false;
+		if (MODBUS_DE_PIN >= 0) pinMode(MODBUS_DE_PIN, OUTPUT);
+	}
+
+	size_t read(uint8_t *buf, size_t n)
+	{
+		size_t i;
+		for (i=0; (i<n) && (Serial.available()>0); ++i) {
+			buf[i] = (uint8_t)Serial.read();
+		}
+		return i;
+	}
+
+	size_t write(const uint8_t *buf, size_t n)
+	{
+		size_t room = (size_t)Serial.availableForWrite();
+		if (n > room) n = room;
+		if (n > 0) {
+			Serial.write(buf, n); /* Fits, does not block */
+			tx_empty = false;
+		}
+		return n;
+	}
 
-enum {TIMEOUT_MS=1000};
+	bool tx_done(void)
+	{
+		if (Serial.availableForWrite() < tx_room) return false;
+		if (!tx_empty) {
+			tx_empty = true;
+			tx_empty_us = micros();
+		}
+		return (micros() - tx_empty_us) >= 2ul*char_us; /* Data and shift register */
+	}
+
+	void set_de(bool on)
+	{
+		if (MODBUS_DE_PIN >= 0) digitalWrite(MODBUS_DE_PIN, on ? HIGH : LOW);
+	}
+
+	uint32_t now_us(void)
+	{
+		return (uint32_t)micros();
+	}
+};
+
+static struct arduino_port s_port;
+static mbserial::ascii_slave<arduino_port> *s_slave;
 
 extern void mbascii_init(unsigned long baud)
 {
 	/* Initialize serial port with Modbus ASCII standard settings:
 	   1 start bit, 7 data bits, even parity, 1 stop bit */
 	Serial.begin(baud, SERIAL_7E1);
+	s_port.begin(baud);
+
+	static mbserial::ascii_slave<arduino_port> slave(s_port, *modbus_get(), TIMEOUT_US);
+
+	s_slave = &slave;
 }
 
 extern void mbascii_proc(void)
 {
-	static uint8_t s_rx[MBADU_ASCII_SIZE_MAX];
-	static uint8_t s_tx[MBADU_ASCII_SIZE_MAX];
-	static size_t s_rx_n = 0;
-
-	static unsigned long s_last_recv_ms;
-
-	struct mbinst_s *inst;
-	size_t tx_n;
-
-	if (Serial.available()) {
-		if (s_rx_n >= MBADU_ASCII_SIZE_MAX) { /* Prevent buffer overflow */
-			s_rx_n = 0;
-		}
-		s_rx[s_rx_n++] = (uint8_t)Serial.read();
-		s_last_recv_ms = millis();
-
-		inst = modbus_get();
-		if (s_rx_n>MBADU_ASCII_HEADER_SIZE
-				&& s_rx[s_rx_n-2]=='\r'
-				&& s_rx[s_rx_n-1]==inst->state.ascii_delimiter) { /* Full request received */
-			tx_n = mbadu_ascii_handle_req(inst, s_rx, s_rx_n, s_tx);
-
-			if (tx_n) {
-				Serial.write(s_tx, tx_n); /* Send response */
-				Serial.flush(); /* Wait for transmission to complete */
-			}
-
-			s_rx_n = 0; /* Reset for next frame */
-		}
-	} else if (s_rx_n && (millis()-s_last_recv_ms) > TIMEOUT_MS) { /* Timeout */
-		s_rx_n = 0;
-	}
+	(void)s_slave->poll(); /* Never waits for the response to be sent */
 }
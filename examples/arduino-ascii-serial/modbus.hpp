@@ -8,6 +8,7 @@ extern "C" {
 enum { /* These values should probably be user configurable at runtime */
 	MODBUS_SLAVE_ADDRESS=1u, /* Modbus slave address (1-247) */
 	MODBUS_BAUD=19200u, /* Serial communication baud rate */
+	MODBUS_DE_PIN=-1, /* RS-485 driver enable pin, -1 for RS-232 */
 };
 
 /**
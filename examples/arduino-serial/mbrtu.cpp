@@ -12,46 +12,83 @@
 #include <stdint.h>
 #include <stddef.h>
 
-extern "C" {
-#include <mbadu.h>
-#include <mbsupp.h>
-}
+#include <mbserial.hpp>
+
+/**
+ * Serial port for mbserial, transmission is left to the interrupt driven
+ * TX buffer of HardwareSerial instead of waiting in Serial.flush()
+ */
+struct arduino_port {
+	unsigned long char_us; /* Time of one character, at most 11 bits */
+	int tx_room; /* availableForWrite() with an empty TX buffer */
+	bool tx_empty; /* TX buffer seen empty since the last write */
+	unsigned long tx_empty_us; /* Time the TX buffer was seen empty */
+
+	void begin(unsigned long baud)
+	{
+		char_us = 11000000ul/baud + 1ul;
+		tx_room = Serial.availableForWrite();
+		tx_empty = false;
+		if (MODBUS_DE_PIN >= 0) pinMode(MODBUS_DE_PIN, OUTPUT);
+	}
+
+	size_t read(uint8_t *buf, size_t n)
+	{
+		size_t i;
+		for (i=0; (i<n) && (Serial.available()>0); ++i) {
+			buf[i] = (uint8_t)Serial.read();
+		}
+		return i;
+	}
 
-static size_t s_break_us = 0; /* Frame break time in microseconds */
+	size_t write(const uint8_t *buf, size_t n)
+	{
+		size_t room = (size_t)Serial.availableForWrite();
+		if (n > room) n = room;
+		if (n > 0) {
+			Serial.write(buf, n); /* Fits, does not block */
+			tx_empty = false;
+		}
+		return n;
+	}
+
+	bool tx_done(void)
+	{
+		if (Serial.availableForWrite() < tx_room) return false;
+		if (!tx_empty) {
+			tx_empty = true;
+			tx_empty_us = micros();
+		}
+		return (micros() - tx_empty_us) >= 2ul*char_us; /* Data and shift register */
+	}
+
+	void set_de(bool on)
+	{
+		if (MODBUS_DE_PIN >= 0) digitalWrite(MODBUS_DE_PIN, on ? HIGH : LOW);
+	}
+
+	uint32_t now_us(void)
+	{
+		return (uint32_t)micros();
+	}
+};
+
+static struct arduino_port s_port;
+static mbserial::rtu_slave<arduino_port> *s_slave;
 
 extern void mbrtu_init(unsigned long baud)
 {
 	/* Initialize serial port with Modbus RTU standard settings:
 	   8 data bits, even parity, 1 stop bit */
 	Serial.begin(baud, SERIAL_8E1);
+	s_port.begin(baud);
+
+	static mbserial::rtu_slave<arduino_port> slave(s_port, *modbus_get(), (uint32_t)baud);
 
-	s_break_us = mbsupp_break_us(baud);
+	s_slave = &slave;
 }
 
 extern void mbrtu_proc(void)
 {
-	static uint8_t s_rx[MBADU_SIZE_MAX];
-	static uint8_t s_tx[MBADU_SIZE_MAX];
-	static size_t s_rx_n = 0;
-
-	static unsigned long s_last_recv_us;
-
-	size_t tx_n;
-
-	if (Serial.available()) {
-		if (s_rx_n >= MBADU_SIZE_MAX) { /* Prevent buffer overflow */
-			s_rx_n = 0;
-		}
-		s_rx[s_rx_n++] = (uint8_t)Serial.read();
-		s_last_recv_us = micros();
-	} else if (s_rx_n && (micros()-s_last_recv_us) >= s_break_us) { /* Check for frame completion (no data for break time) */
-		tx_n = mbadu_handle_req(modbus_get(), s_rx, s_rx_n, s_tx);
-
-		if (tx_n) {
-			Serial.write(s_tx, tx_n); /* Send response */
-			Serial.flush(); /* Wait for transmission to complete */
-		}
-
-		s_rx_n = 0; /* Reset for next frame */
-	}
+	(void)s_slave->poll(); /* Never waits for the response to be sent */
 }
@@ -0,0 +1,68 @@
+#include "conns.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Connection slots in order of their last activity, least recent at the tail.
+ *
+ * All connections share one idle timeout, so the tail is always the next one
+ * to expire and the list works as a timer wheel with one slot per
+ * connection: activity moves a connection to the head, and each tick only
+ * looks at the tail. Both are O(1) however many masters are connected. The
+ * tail is also the connection given up when the pool is full.
+ */
+
+extern int conns_init(struct conns_s *l, size_t n)
+{
+	size_t i;
+
+	if (!(l->prev=calloc(n, sizeof l->prev[0]))
+			|| !(l->next=calloc(n, sizeof l->next[0]))
+			|| !(l->last_us=calloc(n, sizeof l->last_us[0]))) {
+		return -1;
+	}
+
+	/* Slots not in the list link to themselves */
+	for (i=0; i<n; ++i) {
+		l->prev[i] = l->next[i] = i;
+	}
+	l->head = l->tail = CONNS_NONE;
+
+	return 0;
+}
+
+extern void conns_remove(struct conns_s *l, size_t i)
+{
+	if (l->next[i]==i) return; /* Not listed */
+
+	if (l->prev[i]!=CONNS_NONE) l->next[l->prev[i]] = l->next[i];
+	else l->head = l->next[i];
+	if (l->next[i]!=CONNS_NONE) l->prev[l->next[i]] = l->prev[i];
+	else l->tail = l->prev[i];
+
+	l->prev[i] = l->next[i] = i;
+}
+
+extern void conns_touch(struct conns_s *l, size_t i, uint64_t now_us)
+{
+	l->last_us[i] = now_us;
+	if (l->head==i) return;
+
+	conns_remove(l, i);
+	l->prev[i] = CONNS_NONE;
+	l->next[i] = l->head;
+	if (l->head!=CONNS_NONE) l->prev[l->head] = i;
+	else l->tail = i;
+	l->head = i;
+}
+
+/* Least recently active slot if it was idle for at least idle_us */
+extern size_t conns_idle(const struct conns_s *l, uint64_t now_us, uint64_t idle_us)
+{
+	if (l->tail==CONNS_NONE) return CONNS_NONE;
+	if (now_us - l->last_us[l->tail] < idle_us) return CONNS_NONE;
+
+	return l->tail;
+}
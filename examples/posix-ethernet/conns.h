@@ -0,0 +1,21 @@
+#ifndef CONNS_H_INCLUDED
+#define CONNS_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONNS_NONE ((size_t)-1)
+
+/* Connection slots ordered by their last activity */
+struct conns_s {
+	size_t *prev, *next;
+	uint64_t *last_us;
+	size_t head, tail; /* Most and least recently active */
+};
+
+extern int conns_init(struct conns_s *l, size_t n);
+extern void conns_touch(struct conns_s *l, size_t i, uint64_t now_us);
+extern void conns_remove(struct conns_s *l, size_t i);
+extern size_t conns_idle(const struct conns_s *l, uint64_t now_us, uint64_t idle_us);
+
+#endif /* CONNS_H_INCLUDED */
@@ -0,0 +1,38 @@
+#define _DEFAULT_SOURCE
+
+#include "keepalive.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+enum {KEEPALIVE_INTVL_S=5, KEEPALIVE_CNT=3};
+
+/*
+ * Detect masters that went away without closing (power loss, cable pulled,
+ * NAT timeout). Probes start after idle_s seconds without traffic, and
+ * unacknowledged sends fail after the same time as the probes, so a half-open
+ * connection frees its slot on its own.
+ */
+extern void keepalive_set(int s, int idle_s)
+{
+	int one=1;
+	int intvl=KEEPALIVE_INTVL_S, cnt=KEEPALIVE_CNT;
+
+	(void)setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof one);
+#if defined(TCP_KEEPIDLE)
+	(void)setsockopt(s, IPPROTO_TCP, TCP_KEEPIDLE, &idle_s, sizeof idle_s);
+	(void)setsockopt(s, IPPROTO_TCP, TCP_KEEPINTVL, &intvl, sizeof intvl);
+	(void)setsockopt(s, IPPROTO_TCP, TCP_KEEPCNT, &cnt, sizeof cnt);
+#else
+	(void)idle_s;
+	(void)intvl;
+	(void)cnt;
+#endif
+#if defined(TCP_USER_TIMEOUT)
+	{
+		unsigned int timeout_ms=(unsigned int)(idle_s + intvl*cnt)*1000u;
+		(void)setsockopt(s, IPPROTO_TCP, TCP_USER_TIMEOUT, &timeout_ms, sizeof timeout_ms);
+	}
+#endif
+}
@@ -0,0 +1,6 @@
+#ifndef KEEPALIVE_H_INCLUDED
+#define KEEPALIVE_H_INCLUDED
+
+extern void keepalive_set(int s, int idle_s);
+
+#endif /* KEEPALIVE_H_INCLUDED */
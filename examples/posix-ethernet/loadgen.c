@@ -0,0 +1,415 @@
+/*
+ * Load generator and latency harness for Modbus TCP servers
+ *
+ * Opens N client connections, keeps up to D requests in flight on each
+ * (pipelining) at an optional fixed rate, and reports throughput and
+ * response latency percentiles. Requests are synthesized (FC 0x03) or
+ * replayed from a text trace with one request PDU per line in hex, e.g.
+ *
+ *   # Read 10 holding registers from address 0
+ *   03 0000 000A
+ *   06 0000 1234
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <endian.h>
+#include <mbadu_tcp.h>
+#include <mbdef.h>
+#include <mbpdu.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+enum {
+	DEFAULT_PORT=MBTCP_PORT,
+	DEFAULT_CLIENTS=1,
+	DEFAULT_DEPTH=1,
+	DEFAULT_SECONDS=5,
+	MAX_DEPTH=256,
+	BUF_SIZE=MAX_DEPTH*MBADU_TCP_SIZE_MAX,
+};
+
+struct req_s {
+	uint8_t pdu[MBPDU_SIZE_MAX];
+	size_t len;
+};
+
+struct client_s {
+	int s;
+	uint16_t next_tid; /* Transaction id of next request */
+	size_t n_in_flight;
+	uint64_t sent_at[MAX_DEPTH]; /* Send time by transaction id % MAX_DEPTH */
+	uint64_t next_send; /* Rate limiting: earliest time of next request */
+	size_t trace_pos;
+
+	uint8_t rxbuf[BUF_SIZE];
+	size_t nrxbuf;
+};
+
+static struct req_s *s_reqs;
+static size_t s_n_reqs;
+
+static uint64_t *s_lat; /* Latencies in ns */
+static size_t s_n_lat, s_lat_cap;
+static size_t s_n_exceptions, s_n_errors;
+
+static void fatal(const char *fmt, ...)
+{
+	va_list args;
+
+	fprintf(stderr, "Error: ");
+
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fprintf(stderr, "\n");
+
+	exit(EXIT_FAILURE);
+}
+
+static void usage(const char *cmd)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n", cmd);
+	fprintf(stderr, "OPTIONS:\n");
+	fprintf(stderr, " -h              Print this help message and exit\n");
+	fprintf(stderr, " -H <host>       Server host (default localhost)\n");
+	fprintf(stderr, " -p <port>       Server TCP port (default %d)\n", DEFAULT_PORT);
+	fprintf(stderr, " -c <num>        Number of client connections (default %d)\n", DEFAULT_CLIENTS);
+	fprintf(stderr, " -d <num>        Requests in flight per connection, 1-%d (default %d)\n", MAX_DEPTH, DEFAULT_DEPTH);
+	fprintf(stderr, " -r <rate>       Requests per second per connection, 0 for unlimited (default 0)\n");
+	fprintf(stderr, " -t <seconds>    Duration of the run (default %d)\n", DEFAULT_SECONDS);
+	fprintf(stderr, " -f <file>       Replay request PDUs from a text trace (default FC 0x03)\n");
+	fprintf(stderr, " -a <addr>       Start address of synthesized requests (default 0)\n");
+	fprintf(stderr, " -q <num>        Quantity of synthesized requests (default 1)\n");
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void add_req(const uint8_t *pdu, size_t len)
+{
+	if (!(s_reqs=realloc(s_reqs, (s_n_reqs+1) * sizeof s_reqs[0]))) {
+		fatal("Out of memory");
+	}
+	memcpy(s_reqs[s_n_reqs].pdu, pdu, len);
+	s_reqs[s_n_reqs].len = len;
+	++s_n_reqs;
+}
+
+static int hex_val(int c)
+{
+	if (c>='0' && c<='9') return c-'0';
+	if (c>='a' && c<='f') return c-'a'+10;
+	if (c>='A' && c<='F') return c-'A'+10;
+	return -1;
+}
+
+static void load_trace(const char *path)
+{
+	FILE *f;
+	char line[4*MBPDU_SIZE_MAX];
+	uint8_t pdu[MBPDU_SIZE_MAX];
+	size_t len, lineno = 0, i;
+	int hi, v;
+
+	if (!(f=fopen(path, "r"))) {
+		fatal("Cannot open trace %s", path);
+	}
+
+	while (fgets(line, sizeof line, f)) {
+		++lineno;
+		len = 0;
+		hi = -1;
+		for (i=0; line[i] && line[i]!='#'; ++i) {
+			if ((v=hex_val(line[i]))<0) continue; /* Separator */
+			if (hi<0) {
+				hi = v;
+			} else {
+				if (len>=MBPDU_SIZE_MAX) fatal("%s:%zu: Request too long", path, lineno);
+				pdu[len++] = (uint8_t)(hi<<4 | v);
+				hi = -1;
+			}
+		}
+		if (hi>=0) fatal("%s:%zu: Odd number of hex digits", path, lineno);
+		if (len>0) add_req(pdu, len);
+	}
+
+	fclose(f);
+	if (s_n_reqs==0) fatal("No requests in trace %s", path);
+}
+
+static int connect_to(const char *host, int port)
+{
+	struct addrinfo hints={0}, *res, *ai;
+	char service[16];
+	int s = -1, one = 1;
+
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(service, sizeof service, "%d", port);
+
+	if (getaddrinfo(host, service, &hints, &res)!=0) return -1;
+
+	for (ai=res; ai; ai=ai->ai_next) {
+		if ((s=socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol))<0) continue;
+		if (connect(s, ai->ai_addr, ai->ai_addrlen)==0) break;
+		close(s);
+		s = -1;
+	}
+	freeaddrinfo(res);
+
+	if (s>=0) {
+		(void)setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+		(void)fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+	}
+
+	return s;
+}
+
+/* Send requests until the pipelining depth is reached or the rate limit applies */
+static int send_reqs(struct client_s *c, size_t depth, uint64_t interval, uint64_t now)
+{
+	uint8_t txbuf[BUF_SIZE];
+	size_t ntxbuf = 0;
+	const struct req_s *req;
+	ssize_t n;
+
+	while (c->n_in_flight<depth && now>=c->next_send) {
+		req = &s_reqs[c->trace_pos];
+		c->trace_pos = (c->trace_pos+1) % s_n_reqs;
+
+		u16tobe(c->next_tid, txbuf+ntxbuf);
+		u16tobe(MBADU_TCP_PROT_ID, txbuf+ntxbuf+2);
+		u16tobe((uint16_t)(1+req->len), txbuf+ntxbuf+4);
+		txbuf[ntxbuf+6] = 1; /* Unit id */
+		memcpy(txbuf+ntxbuf+7, req->pdu, req->len);
+		ntxbuf += 7+req->len;
+
+		c->sent_at[c->next_tid % MAX_DEPTH] = now;
+		++c->next_tid;
+		++c->n_in_flight;
+		c->next_send = interval ? c->next_send+interval : now;
+	}
+
+	if (ntxbuf==0) return 0;
+
+	/* Partial sends are not expected for this little data, treat as an error */
+	n = send(c->s, txbuf, ntxbuf, 0);
+	return (n==(ssize_t)ntxbuf) ? 0 : -1;
+}
+
+static void add_latency(uint64_t ns)
+{
+	if (s_n_lat>=s_lat_cap) {
+		s_lat_cap = s_lat_cap ? 2*s_lat_cap : 65536;
+		if (!(s_lat=realloc(s_lat, s_lat_cap * sizeof s_lat[0]))) {
+			fatal("Out of memory");
+		}
+	}
+	s_lat[s_n_lat++] = ns;
+}
+
+/* Consume complete responses, returns -1 on a protocol error */
+static int recv_resps(struct client_s *c, uint64_t now)
+{
+	ssize_t n;
+	size_t pos = 0, adu_len;
+	uint16_t tid;
+
+	n = recv(c->s, c->rxbuf+c->nrxbuf, sizeof c->rxbuf - c->nrxbuf, 0);
+	if (n==0) return -1;
+	if (n<0) return (errno==EAGAIN || errno==EWOULDBLOCK) ? 0 : -1;
+	c->nrxbuf += (size_t)n;
+
+	while (c->nrxbuf-pos>=MBAP_SIZE) {
+		adu_len = 6 + betou16(c->rxbuf+pos+4);
+		if (adu_len<MBAP_SIZE+1 || adu_len>MBADU_TCP_SIZE_MAX) return -1;
+		if (c->nrxbuf-pos<adu_len) break;
+
+		tid = betou16(c->rxbuf+pos);
+		if (c->n_in_flight==0 || (uint16_t)(c->next_tid-tid)>c->n_in_flight) return -1;
+		if (c->rxbuf[pos+7] & MB_ERR_FLG) ++s_n_exceptions;
+		add_latency(now - c->sent_at[tid % MAX_DEPTH]);
+		--c->n_in_flight;
+		pos += adu_len;
+	}
+
+	memmove(c->rxbuf, c->rxbuf+pos, c->nrxbuf-pos);
+	c->nrxbuf -= pos;
+
+	return 0;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x>y) - (x<y);
+}
+
+static double percentile_us(double p)
+{
+	size_t i;
+
+	if (s_n_lat==0) return 0.0;
+	i = (size_t)(p * (double)(s_n_lat-1) + 0.5);
+	return (double)s_lat[i] / 1000.0;
+}
+
+int main(int argc, char *argv[])
+{
+	(void)argc;
+
+	const char *cmd = *argv;
+	const char *host = "localhost";
+	const char *trace = NULL;
+	int port = DEFAULT_PORT;
+	size_t n_clients = DEFAULT_CLIENTS, depth = DEFAULT_DEPTH, i;
+	double rate = 0.0, seconds = DEFAULT_SECONDS, elapsed;
+	uint16_t addr = 0, qty = 1;
+	uint64_t interval, start, end, now;
+	uint8_t pdu[5];
+
+	struct client_s *clients;
+	struct pollfd *pfds;
+	size_t n_open;
+	int timeout_ms;
+
+	while (*++argv) {
+		const char *opt = *argv;
+		if (!strcmp(opt, "-h")) {
+			usage(cmd);
+			exit(EXIT_SUCCESS);
+		}
+		if (strlen(opt)!=2 || opt[0]!='-' || !strchr("Hpcdrtfaq", opt[1])) {
+			usage(cmd);
+			fatal("Unknown option %s", opt);
+		}
+		if (!*++argv) {
+			usage(cmd);
+			fatal("Option %s must be followed by a value", opt);
+		}
+		switch (opt[1]) {
+		case 'H': host = *argv; break;
+		case 'p': port = atoi(*argv); break;
+		case 'c': n_clients = (size_t)atol(*argv); break;
+		case 'd': depth = (size_t)atol(*argv); break;
+		case 'r': rate = atof(*argv); break;
+		case 't': seconds = atof(*argv); break;
+		case 'f': trace = *argv; break;
+		case 'a': addr = (uint16_t)strtoul(*argv, NULL, 0); break;
+		case 'q': qty = (uint16_t)strtoul(*argv, NULL, 0); break;
+		}
+	}
+	if (n_clients==0) fatal("Need at least one client");
+	if (depth==0 || depth>MAX_DEPTH) fatal("Depth must be 1-%d", MAX_DEPTH);
+
+	if (trace) {
+		load_trace(trace);
+	} else {
+		pdu[0] = MBFC_READ_HOLDING_REGS;
+		u16tobe(addr, pdu+1);
+		u16tobe(qty, pdu+3);
+		add_req(pdu, sizeof pdu);
+	}
+
+	if (!(clients=calloc(n_clients, sizeof clients[0]))
+			|| !(pfds=calloc(n_clients, sizeof pfds[0]))) {
+		fatal("Out of memory");
+	}
+
+	for (i=0; i<n_clients; ++i) {
+		if ((clients[i].s=connect_to(host, port))<0) {
+			fatal("Cannot connect to %s:%d", host, port);
+		}
+		clients[i].trace_pos = i % s_n_reqs; /* Clients replay at different offsets */
+	}
+
+	interval = (rate>0.0) ? (uint64_t)(1e9/rate) : 0;
+	start = now_ns();
+	end = start + (uint64_t)(seconds*1e9);
+	for (i=0; i<n_clients; ++i) {
+		clients[i].next_send = start;
+	}
+
+	n_open = n_clients;
+	while (n_open>0) {
+		now = now_ns();
+		n_open = 0;
+		for (i=0; i<n_clients; ++i) {
+			struct client_s *c = &clients[i];
+			if (c->s<0) continue;
+
+			/* After the run only drain requests in flight */
+			if (now<end && send_reqs(c, depth, interval, now)<0) {
+				++s_n_errors;
+				close(c->s);
+				c->s = -1;
+				continue;
+			}
+			if (now>=end && c->n_in_flight==0) {
+				close(c->s);
+				c->s = -1;
+				continue;
+			}
+
+			pfds[n_open].fd = c->s;
+			pfds[n_open].events = POLLIN;
+			pfds[n_open].revents = 0;
+			++n_open;
+		}
+		if (n_open==0) break;
+
+		/* Wake up for the next rate limited send, or to notice the end of the run */
+		timeout_ms = 10;
+		if (interval) {
+			for (i=0; i<n_clients; ++i) {
+				if (clients[i].s>=0 && clients[i].next_send<=now) timeout_ms = 0;
+				else if (clients[i].s>=0 && (int)((clients[i].next_send-now)/1000000u)<timeout_ms) {
+					timeout_ms = (int)((clients[i].next_send-now)/1000000u);
+				}
+			}
+		}
+		if (poll(pfds, n_open, timeout_ms)<0 && errno!=EINTR) {
+			fatal("poll: %s", strerror(errno));
+		}
+
+		now = now_ns();
+		for (i=0; i<n_clients; ++i) {
+			struct client_s *c = &clients[i];
+			if (c->s<0) continue;
+			if (recv_resps(c, now)<0) {
+				++s_n_errors;
+				close(c->s);
+				c->s = -1;
+			}
+		}
+		if (now>end+1000000000u) break; /* Give up on responses after 1 s */
+	}
+	elapsed = (double)(now_ns()-start) / 1e9;
+
+	qsort(s_lat, s_n_lat, sizeof s_lat[0], cmp_u64);
+
+	printf("clients %zu depth %zu rate %s\n", n_clients, depth, rate>0.0 ? "limited" : "unlimited");
+	printf("responses %zu (exceptions %zu, errors %zu) in %.2f s\n", s_n_lat, s_n_exceptions, s_n_errors, elapsed);
+	printf("throughput %.0f req/s\n", (double)s_n_lat / elapsed);
+	printf("latency us p50 %.1f p99 %.1f p999 %.1f max %.1f\n",
+		percentile_us(0.5), percentile_us(0.99), percentile_us(0.999), percentile_us(1.0));
+
+	return s_n_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,15 +1,33 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "conns.h"
+#include "keepalive.h"
 #include "modbus.h"
+#include "sendq.h"
 #include "server.h"
+#include "tls.h"
+#include "udp.h"
 
+#include <mbadu_stream.h>
 #include <mbadu_tcp.h>
+#include <mbrate.h>
 
+#include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <time.h>
 
 enum {DEFAULT_MAX_NUM_CONNS=4};
+enum {DEFAULT_IDLE_S=60};
+/* Keepalive probes start after this long without traffic */
+enum {KEEPALIVE_IDLE_S=10};
+/* A full pool only gives up a connection that was idle at least this long */
+enum {EVICT_MIN_IDLE_MS=1000};
+
+enum {RXBUF_SIZE=4*MBADU_TCP_SIZE_MAX};
 
 void fatal(const char *fmt, ...)
 {
@@ -29,9 +47,51 @@ void usage(const char *cmd)
 	fprintf(stderr, "Usage: %s [OPTIONS]\n", cmd);
 	fprintf(stderr, "OPTIONS:\n");
 	fprintf(stderr, " -h              Print this help message and exit\n");
-	fprintf(stderr, " -p <port>       Use <port> as TCP port (default %d)\n", MBTCP_PORT);
+	fprintf(stderr, " -p <port>       Use <port> as TCP port (default %d, %d with TLS)\n", MBTCP_PORT, MBTCP_SECURE_PORT);
 	fprintf(stderr, " -n <num>        Maximum number of simultaneous connections (default %d)\n", DEFAULT_MAX_NUM_CONNS);
+	fprintf(stderr, " -i <sec>        Close connections idle for <sec> seconds, 0 to keep them (default %d)\n", DEFAULT_IDLE_S);
 	fprintf(stderr, " -s              Do not print action logs\n");
+	fprintf(stderr, " -r              Serve RTU frames over TCP instead of Modbus TCP\n");
+	fprintf(stderr, " -u              Serve Modbus UDP instead of Modbus TCP\n");
+	fprintf(stderr, " -l <num>        Limit each connection to <num> requests per second, others get MB_BUSY\n");
+	fprintf(stderr, " -L <num>        Limit the unit to <num> requests per second, others get MB_BUSY\n");
+	fprintf(stderr, " -c <file>       Serve Modbus/TCP Security (TLS) with the PEM certificate chain <file>\n");
+	fprintf(stderr, " -k <file>       PEM private key of the certificate (default: the -c file)\n");
+	fprintf(stderr, " -a <file>       Require client certificates issued by the PEM CA <file>\n");
+	fprintf(stderr, " -K              Use kernel TLS offload when available\n");
+}
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000u + (uint64_t)ts.tv_nsec/1000u;
+}
+
+/* Bucket of <per_s> requests per second, allowing bursts of 100 ms worth */
+static void rate_setup(struct mbrate_s *rate, long per_s)
+{
+	rate->clock_cb = now_us;
+	rate->ticks_per_token = (uint64_t)(1000000/per_s);
+	rate->burst = (per_s>=10) ? (uint32_t)(per_s/10) : 1;
+	mbrate_init(rate);
+}
+
+static void conn_flush(struct sendq_s *q, int s, struct tls_conn_s *tls)
+{
+	if (tls) {
+		(void)sendq_flush_tls(q, tls);
+	} else {
+		(void)sendq_flush(q, s);
+	}
+}
+
+static void conn_close(int *cs, struct tls_conn_s **tls)
+{
+	tls_close(*tls);
+	*tls = NULL;
+	server_close(*cs);
+	*cs = 0;
 }
 
 int main(int argc, char *argv[])
@@ -40,18 +100,33 @@ int main(int argc, char *argv[])
 
 	const char *cmd = *argv;
 
-	int port = MBTCP_PORT;
+	int port = -1;
 	size_t max_ncs = DEFAULT_MAX_NUM_CONNS;
+	long idle_s = DEFAULT_IDLE_S;
 	int silent = 0;
+	int use_udp = 0;
+	long conn_rate = 0, unit_rate = 0;
+	struct mbrate_s unit_bucket;
+	enum mbadu_stream_status_e (*proc)(struct mbadu_stream_s *, struct mbinst_s *,
+		const uint8_t *, size_t, size_t *, uint8_t *, size_t, size_t *) = mbadu_stream_tcp_proc;
 
 	int ss, s;
 	int is_new_conn;
 
 	int *cs;
+	struct mbadu_stream_s *streams;
+	struct mbrate_s *buckets;
+	struct sendq_s *queues;
+	struct tls_conn_s **tlss;
+	struct tls_conf_s tls_conf = {0};
+	struct conns_s conns;
 	size_t ncs;
+	uint64_t now;
 
-	uint8_t rxbuf[MBADU_TCP_SIZE_MAX], txbuf[MBADU_TCP_SIZE_MAX];
-	ssize_t nrxbuf, ntxbuf;
+	uint8_t rxbuf[RXBUF_SIZE];
+	ssize_t nrxbuf;
+	size_t nrxused, ntxbuf, nconsumed;
+	enum mbadu_stream_status_e status;
 
 	while (*++argv) {
 		if (!strcmp(*argv, "-h")) {
@@ -69,15 +144,86 @@ int main(int argc, char *argv[])
 				fatal("Option -n must be followed by a number");
 			}
 			max_ncs = (size_t)atol(*argv);
+		} else if (!strcmp(*argv, "-i")) {
+			if (!*++argv) {
+				usage(cmd);
+				fatal("Option -i must be followed by a number");
+			}
+			idle_s = atol(*argv);
 		} else if (!strcmp(*argv, "-s")) {
 			silent = 1;
+		} else if (!strcmp(*argv, "-r")) {
+			proc = mbadu_stream_rtu_proc;
+		} else if (!strcmp(*argv, "-u")) {
+			use_udp = 1;
+		} else if (!strcmp(*argv, "-l")) {
+			if (!*++argv) {
+				usage(cmd);
+				fatal("Option -l must be followed by a number");
+			}
+			conn_rate = atol(*argv);
+		} else if (!strcmp(*argv, "-L")) {
+			if (!*++argv) {
+				usage(cmd);
+				fatal("Option -L must be followed by a number");
+			}
+			unit_rate = atol(*argv);
+		} else if (!strcmp(*argv, "-c") || !strcmp(*argv, "-k") || !strcmp(*argv, "-a")) {
+			const char *opt = *argv;
+			if (!*++argv) {
+				usage(cmd);
+				fatal("Option %s must be followed by a file", opt);
+			}
+			if (opt[1]=='c') tls_conf.cert = *argv;
+			else if (opt[1]=='k') tls_conf.key = *argv;
+			else tls_conf.ca = *argv;
+		} else if (!strcmp(*argv, "-K")) {
+			tls_conf.ktls = 1;
 		} else {
 			usage(cmd);
 			fatal("Unknown option %s", *argv);
 		}
 	}
 
-	if (!(cs=calloc(max_ncs, sizeof cs[0]))) {
+	if (port<0) {
+		port = tls_conf.cert ? MBTCP_SECURE_PORT : MBTCP_PORT;
+	}
+
+	if (tls_conf.cert) {
+		if (use_udp) {
+			fatal("TLS is not available over UDP");
+		}
+		if (!tls_conf.key) {
+			tls_conf.key = tls_conf.cert;
+		}
+		if (tls_init(&tls_conf)<0) {
+			fatal("Failed setting up TLS");
+		}
+	}
+
+	if (use_udp) {
+		if (!silent) printf("Starting UDP server on port %d.\n", port);
+		ss = udp_init(port);
+		if (ss<0) {
+			fatal("Failed starting UDP server on port %d", port);
+		}
+
+		modbus_init();
+		if (unit_rate>0) {
+			rate_setup(&unit_bucket, unit_rate);
+			modbus_get()->rate = &unit_bucket;
+		}
+
+		while (udp_poll(ss, modbus_get())>=0);
+		fatal("Communication problem on UDP socket");
+	}
+
+	if (!(cs=calloc(max_ncs, sizeof cs[0]))
+			|| !(streams=calloc(max_ncs, sizeof streams[0]))
+			|| !(buckets=calloc(max_ncs, sizeof buckets[0]))
+			|| !(queues=calloc(max_ncs, sizeof queues[0]))
+			|| !(tlss=calloc(max_ncs, sizeof tlss[0]))
+			|| conns_init(&conns, max_ncs)<0) {
 		fatal("Out of memory");
 	}
 
@@ -88,46 +234,98 @@ int main(int argc, char *argv[])
 	}
 
 	modbus_init();
+	if (unit_rate>0) {
+		rate_setup(&unit_bucket, unit_rate);
+		modbus_get()->rate = &unit_bucket;
+	}
 
 	while (1) {
 		s = server_poll(ss, cs, max_ncs, &is_new_conn);
+		now = now_us();
+
+		/* Idle connections expire from the least recently active one on */
+		while (idle_s>0 && (ncs=conns_idle(&conns, now, (uint64_t)idle_s*1000000u))!=CONNS_NONE) {
+			conns_remove(&conns, ncs);
+			conn_close(&cs[ncs], &tlss[ncs]);
+			if (!silent) printf("Connection idle for %ld s. Closing connection.\n", idle_s);
+		}
 
 		if (is_new_conn) {
 			for (ncs = 0; ncs<max_ncs; ++ncs) {
-				if (!cs[ncs]) {
-					cs[ncs] = s;
+				if (!cs[ncs]) break;
+			}
+			/* A full pool makes room by closing the least recently active
+			   connection, dead masters give way to reconnecting ones */
+			if (ncs>=max_ncs
+					&& (ncs=conns_idle(&conns, now, EVICT_MIN_IDLE_MS*1000u))!=CONNS_NONE) {
+				conns_remove(&conns, ncs);
+				conn_close(&cs[ncs], &tlss[ncs]);
+				if (!silent) printf("Maximum number of connections (%zu) reached. Closing least recently active connection.\n", max_ncs);
+			}
+			if (ncs<max_ncs) {
+				cs[ncs] = s;
+				keepalive_set(s, KEEPALIVE_IDLE_S);
+				mbadu_stream_init(&streams[ncs]);
+				if (conn_rate>0) {
+					rate_setup(&buckets[ncs], conn_rate);
+					streams[ncs].rate = &buckets[ncs];
+				}
+				sendq_init(&queues[ncs]);
+				if (tls_conf.cert && !(tlss[ncs]=tls_accept(s))) {
+					server_close(s);
+					cs[ncs] = 0;
+					if (!silent) printf("TLS setup failed. Closing connection.\n");
+				} else {
+					conns_touch(&conns, ncs, now);
 					if (!silent) printf("New connection.\n");
-					break;
 				}
-			}
-			if (ncs>=max_ncs) {
+			} else {
 				server_close(s);
 				if (!silent) printf("New connection rejected. Maximum number of connections (%zu) reached.\n", max_ncs);
 			}
 		} else if (s>0) {
-			nrxbuf = server_recv(s, rxbuf, sizeof rxbuf);
+			for (ncs = 0; ncs<max_ncs; ++ncs) {
+				if (cs[ncs]==s) break;
+			}
+			if (ncs>=max_ncs) continue;
 
-			if (nrxbuf>0) {
-				if ((ntxbuf=mbadu_tcp_handle_req(modbus_get(), rxbuf, (size_t)nrxbuf, txbuf))>0) {
-					(void)server_send(s, txbuf, ntxbuf);
-				} else {
-					server_close(s);
-					for (ncs = 0; ncs<max_ncs; ++ncs) {
-						if (cs[ncs]==s) {
-							cs[ncs] = 0;
-							break;
-						}
+			/* A TLS connection is drained here, as records already read by
+			   the library don't wake up the poll again */
+			do {
+				nrxbuf = tlss[ncs] ? tls_recv(tlss[ncs], rxbuf, sizeof rxbuf)
+					: server_recv(s, rxbuf, sizeof rxbuf);
+				if (nrxbuf<=0) break;
+				conns_touch(&conns, ncs, now);
+
+				/* A single read may hold several pipelined requests, their
+				   responses are queued and sent with one sendmsg() (or TLS record) */
+				nrxused = 0;
+				do {
+					status = proc(&streams[ncs], modbus_get(),
+						rxbuf+nrxused, (size_t)nrxbuf-nrxused, &nconsumed,
+						sendq_next(&queues[ncs]), SENDQ_SEG_SIZE, &ntxbuf);
+					nrxused += nconsumed;
+					sendq_commit(&queues[ncs], ntxbuf);
+					if (sendq_full(&queues[ncs])) {
+						conn_flush(&queues[ncs], s, tlss[ncs]);
 					}
+				} while (status==MBADU_STREAM_RES_FULL);
+				conn_flush(&queues[ncs], s, tlss[ncs]);
+
+				if (status==MBADU_STREAM_MALFORMED) {
+					conns_remove(&conns, ncs);
+					conn_close(&cs[ncs], &tlss[ncs]);
 					if (!silent) printf("Malformed packet received. Closing connection.\n");
 				}
+			} while (tlss[ncs]);
+
+			if (nrxbuf>0) {
+				/* Handled */
+			} else if (nrxbuf<0 && (errno==EAGAIN || errno==EWOULDBLOCK)) {
+				/* Non-blocking socket drained */
 			} else {
-				server_close(s);
-				for (ncs = 0; ncs<max_ncs; ++ncs) {
-					if (cs[ncs]==s) {
-						cs[ncs] = 0;
-						break;
-					}
-				}
+				conns_remove(&conns, ncs);
+				conn_close(&cs[ncs], &tlss[ncs]);
 				if (!silent) printf("Communication problem. Closing connection.\n");
 			}
 		}
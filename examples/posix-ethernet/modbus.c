@@ -18,7 +18,8 @@ static struct mbreg_desc_s s_holding_regs[] = {
 
 static struct mbinst_s s_mbinst = {
 	.hold_regs = s_holding_regs,
-	.n_hold_regs = sizeof s_holding_regs / sizeof s_holding_regs[0]
+	.n_hold_regs = sizeof s_holding_regs / sizeof s_holding_regs[0],
+	.serial = {.slave_addr = 1} /* RTU over TCP (-r) */
 };
 
 extern void modbus_init(void)
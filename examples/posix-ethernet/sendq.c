@@ -0,0 +1,88 @@
+#include "sendq.h"
+#include "server.h"
+
+#include <sys/uio.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Send queue of one connection.
+ *
+ * Responses are built straight into the next free segment, a batch of
+ * segments is then handed to the kernel with one sendmsg(). A partial send
+ * continues from where the kernel stopped. Over TLS the batch is sealed in one
+ * record.
+ */
+
+extern void sendq_init(struct sendq_s *q)
+{
+	q->n = 0;
+}
+
+extern uint8_t *sendq_next(struct sendq_s *q)
+{
+	return q->segs[q->n];
+}
+
+extern void sendq_commit(struct sendq_s *q, size_t len)
+{
+	if (len>0 && q->n<SENDQ_N_SEGS) {
+		q->lens[q->n] = len;
+		++q->n;
+	}
+}
+
+extern int sendq_full(const struct sendq_s *q)
+{
+	return q->n>=SENDQ_N_SEGS;
+}
+
+extern int sendq_flush(struct sendq_s *q, int s)
+{
+	struct iovec iov[SENDQ_N_SEGS];
+	size_t i, first, niov;
+	size_t sent;
+	ssize_t n;
+
+	for (i=0; i<q->n; ++i) {
+		iov[i].iov_base = q->segs[i];
+		iov[i].iov_len = q->lens[i];
+	}
+	niov = q->n;
+	q->n = 0;
+
+	first = 0;
+	while (first<niov) {
+		n = server_sendv(s, iov+first, niov-first);
+		if (n<0) return -1;
+
+		/* Skip what was sent, the first unsent segment may be partial */
+		for (sent=(size_t)n; first<niov && sent>=iov[first].iov_len; ++first) {
+			sent -= iov[first].iov_len;
+		}
+		if (first<niov) {
+			iov[first].iov_base = (uint8_t *)iov[first].iov_base + sent;
+			iov[first].iov_len -= sent;
+		}
+	}
+
+	return 0;
+}
+
+extern int sendq_flush_tls(struct sendq_s *q, struct tls_conn_s *c)
+{
+	struct iovec iov[SENDQ_N_SEGS];
+	size_t i, niov;
+
+	for (i=0; i<q->n; ++i) {
+		iov[i].iov_base = q->segs[i];
+		iov[i].iov_len = q->lens[i];
+	}
+	niov = q->n;
+	q->n = 0;
+
+	if (niov==0) return 0;
+
+	return (tls_sendv(c, iov, niov)<0) ? -1 : 0;
+}
@@ -0,0 +1,29 @@
+#ifndef SENDQ_H_INCLUDED
+#define SENDQ_H_INCLUDED
+
+#include "tls.h"
+
+#include <mbadu_tcp.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Segments of one connection gathered into one sendmsg() */
+enum {SENDQ_N_SEGS=8};
+/* Room for several pipelined responses per segment */
+enum {SENDQ_SEG_SIZE=4*MBADU_TCP_SIZE_MAX};
+
+struct sendq_s {
+	uint8_t segs[SENDQ_N_SEGS][SENDQ_SEG_SIZE];
+	size_t lens[SENDQ_N_SEGS];
+	size_t n;
+};
+
+extern void sendq_init(struct sendq_s *q);
+extern uint8_t *sendq_next(struct sendq_s *q);
+extern void sendq_commit(struct sendq_s *q, size_t len);
+extern int sendq_full(const struct sendq_s *q);
+extern int sendq_flush(struct sendq_s *q, int s);
+extern int sendq_flush_tls(struct sendq_s *q, struct tls_conn_s *c);
+
+#endif /* SENDQ_H_INCLUDED */
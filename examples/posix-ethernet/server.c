@@ -4,11 +4,21 @@
 #include <sys/time.h>
 #include <sys/select.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
 #include <netinet/ip.h>
+#include <netinet/tcp.h>
 
 #include <stdint.h>
 #include <stdlib.h>
 
+/* Responses are sent in whole batches, don't hold back the last segment */
+static void set_nodelay(int s)
+{
+	int one=1;
+
+	(void)setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+}
+
 extern int server_init(int port)
 {
 	int ss;
@@ -22,7 +32,7 @@ extern int server_init(int port)
 	sin.sin_addr.s_addr=INADDR_ANY;
 	sin.sin_port=htons(port);
 
-	if (bind(ss, (struct sockaddr*)&sin, sizeof sin)==-1 || listen(ss, 3)==-1) {
+	if (bind(ss, (struct sockaddr*)&sin, sizeof sin)==-1 || listen(ss, SOMAXCONN)==-1) {
 		close(ss);
 		return -1;
 	}
@@ -61,6 +71,7 @@ extern int server_poll(int ss, const int *cs, size_t ncss, int *is_new_conn)
 
 	if (FD_ISSET(ss, &read_fds)) {
 		if ((s=accept(ss, NULL, NULL))!=-1) {
+			set_nodelay(s);
 			if (is_new_conn) *is_new_conn=1;
 			return s;
 		}
@@ -85,6 +96,16 @@ extern ssize_t server_send(int s, const uint8_t *buf, size_t len)
 	return send(s, buf, len, 0);
 }
 
+extern ssize_t server_sendv(int s, const struct iovec *iov, size_t niov)
+{
+	struct msghdr msg={0};
+
+	msg.msg_iov = (struct iovec *)iov;
+	msg.msg_iovlen = niov;
+
+	return sendmsg(s, &msg, MSG_NOSIGNAL);
+}
+
 extern int server_close(int s)
 {
 	return close(s);
@@ -4,11 +4,13 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 extern int server_init(int port);
 extern int server_poll(int ss, const int *cs, size_t ncss, int *is_new_conn);
 extern ssize_t server_recv(int s, uint8_t *buf, size_t len);
 extern ssize_t server_send(int s, const uint8_t *buf, size_t len);
+extern ssize_t server_sendv(int s, const struct iovec *iov, size_t niov);
 extern int server_close(int s);
 
 #endif /* SERVER_H_INCLUDED */
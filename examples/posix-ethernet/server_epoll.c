@@ -0,0 +1,262 @@
+#include"server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Edge-triggered epoll backend implementing the interface in server.h.
+ *
+ * Ready sockets reported by one epoll_wait() are queued and handed out one
+ * per server_poll() call without further syscalls. With edge-triggered
+ * notifications a socket must be drained, so a socket stays queued as long
+ * as server_recv() (or accept for the listening socket) returns data. It is
+ * dropped once the call reports EAGAIN.
+ */
+
+enum {MAX_EVENTS=64};
+enum {SEND_TIMEOUT_MS=1000};
+/* Longest wait without events, so idle connections still expire */
+enum {TICK_MS=100};
+
+static int s_ep = -1;
+static int s_ss = -1;
+
+/* FIFO of ready sockets, never holds more than MAX_EVENTS entries */
+static int s_ready[MAX_EVENTS];
+static size_t s_head, s_nready;
+
+static void ready_push(int s)
+{
+	if (s_nready<MAX_EVENTS) {
+		s_ready[(s_head+s_nready)%MAX_EVENTS] = s;
+		++s_nready;
+	}
+}
+
+static int ready_pop(void)
+{
+	int s;
+
+	while (s_nready>0u) {
+		s = s_ready[s_head];
+		s_head = (s_head+1u)%MAX_EVENTS;
+		--s_nready;
+		if (s>=0) return s;
+	}
+
+	return -1;
+}
+
+static void ready_remove(int s)
+{
+	size_t n;
+
+	for (n=0u; n<s_nready; ++n) {
+		if (s_ready[(s_head+n)%MAX_EVENTS]==s) {
+			s_ready[(s_head+n)%MAX_EVENTS] = -1;
+		}
+	}
+}
+
+static int set_nonblock(int s)
+{
+	int flags;
+
+	if ((flags=fcntl(s, F_GETFL, 0))==-1) {
+		return -1;
+	}
+
+	return fcntl(s, F_SETFL, flags|O_NONBLOCK);
+}
+
+/* Responses are sent in whole batches, don't hold back the last segment */
+static void set_nodelay(int s)
+{
+	int one=1;
+
+	(void)setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+}
+
+static int watch(int s)
+{
+	struct epoll_event ev={0};
+
+	ev.events = EPOLLIN|EPOLLRDHUP|EPOLLET;
+	ev.data.fd = s;
+
+	return epoll_ctl(s_ep, EPOLL_CTL_ADD, s, &ev);
+}
+
+extern int server_init(int port)
+{
+	int ss;
+	int opt=1;
+	struct sockaddr_in sin={0};
+
+	if ((ss=socket(AF_INET, SOCK_STREAM, 0))==-1) {
+		return -1;
+	}
+
+	(void)setsockopt(ss, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof opt);
+
+	sin.sin_family=AF_INET;
+	sin.sin_addr.s_addr=INADDR_ANY;
+	sin.sin_port=htons(port);
+
+	if (bind(ss, (struct sockaddr*)&sin, sizeof sin)==-1
+			|| listen(ss, SOMAXCONN)==-1
+			|| set_nonblock(ss)==-1
+			|| (s_ep=epoll_create1(0))==-1
+			|| watch(ss)==-1) {
+		if (s_ep!=-1) close(s_ep);
+		s_ep = -1;
+		close(ss);
+		return -1;
+	}
+
+	s_ss = ss;
+	s_head = 0u;
+	s_nready = 0u;
+
+	return ss;
+}
+
+extern int server_poll(int ss, const int *cs, size_t ncss, int *is_new_conn)
+{
+	struct epoll_event evs[MAX_EVENTS];
+	int n, i, s;
+
+	(void)cs;
+	(void)ncss;
+
+	if (is_new_conn) *is_new_conn=0;
+
+	if (ss!=s_ss) {
+		return -1;
+	}
+
+	if (s_nready==0u) {
+		/* Block until something happens or the next idle tick */
+		n = epoll_wait(s_ep, evs, MAX_EVENTS, TICK_MS);
+		if (n==-1) {
+			return (errno==EINTR) ? 0 : -1;
+		}
+		for (i=0; i<n; ++i) {
+			ready_push(evs[i].data.fd);
+		}
+	}
+
+	if ((s=ready_pop())<0) {
+		return 0;
+	}
+
+	if (s!=ss) {
+		return s;
+	}
+
+	/* Listening socket, accept one connection per call until drained */
+	if ((s=accept(ss, NULL, NULL))==-1) {
+		/* Edge triggered, the backlog gives no new wakeup. Only a drained
+		   backlog ends it, on other errors (EMFILE, ECONNABORTED, ...) the
+		   next call tries again */
+		if (errno!=EAGAIN && errno!=EWOULDBLOCK) ready_push(ss);
+		return 0;
+	}
+	ready_push(ss);
+
+	if (set_nonblock(s)==-1 || watch(s)==-1) {
+		close(s);
+		return 0;
+	}
+	set_nodelay(s);
+
+	if (is_new_conn) *is_new_conn=1;
+	return s;
+}
+
+extern ssize_t server_recv(int s, uint8_t *buf, size_t len)
+{
+	ssize_t n;
+
+	do {
+		n = recv(s, buf, len, 0);
+	} while (n==-1 && errno==EINTR);
+
+	/* More may be pending, keep the socket queued until EAGAIN */
+	if (n>0) ready_push(s);
+
+	return n;
+}
+
+extern ssize_t server_send(int s, const uint8_t *buf, size_t len)
+{
+	struct pollfd pfd={0};
+	size_t sent=0u;
+	ssize_t n;
+
+	pfd.fd = s;
+	pfd.events = POLLOUT;
+
+	while (sent<len) {
+		n = send(s, buf+sent, len-sent, MSG_NOSIGNAL);
+		if (n>0) {
+			sent += (size_t)n;
+		} else if (n==-1 && errno==EINTR) {
+			continue;
+		} else if (n==-1 && (errno==EAGAIN || errno==EWOULDBLOCK)) {
+			/* Socket buffer full, wait for the peer to catch up */
+			if (poll(&pfd, 1, SEND_TIMEOUT_MS)<=0) {
+				return -1;
+			}
+		} else {
+			return -1;
+		}
+	}
+
+	return (ssize_t)sent;
+}
+
+extern ssize_t server_sendv(int s, const struct iovec *iov, size_t niov)
+{
+	struct msghdr msg={0};
+	struct pollfd pfd={0};
+	ssize_t n;
+
+	msg.msg_iov = (struct iovec *)iov;
+	msg.msg_iovlen = niov;
+
+	pfd.fd = s;
+	pfd.events = POLLOUT;
+
+	while (1) {
+		n = sendmsg(s, &msg, MSG_NOSIGNAL);
+		if (n>=0) {
+			return n;
+		} else if (errno==EINTR) {
+			continue;
+		} else if (errno==EAGAIN || errno==EWOULDBLOCK) {
+			/* Socket buffer full, wait for the peer to catch up */
+			if (poll(&pfd, 1, SEND_TIMEOUT_MS)<=0) {
+				return -1;
+			}
+		} else {
+			return -1;
+		}
+	}
+}
+
+extern int server_close(int s)
+{
+	ready_remove(s);
+	return close(s);
+}
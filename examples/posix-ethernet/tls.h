@@ -0,0 +1,41 @@
+#ifndef TLS_H_INCLUDED
+#define TLS_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/*
+ * TLS transport of the server (Modbus/TCP Security).
+ *
+ * Implemented by one backend chosen in the Makefile, tls_openssl.c or
+ * tls_none.c for builds without a TLS library. A backend for another library
+ * (e.g. mbedTLS) only has to provide these functions.
+ */
+
+struct tls_conf_s {
+	const char *cert; /* Server certificate chain, PEM */
+	const char *key; /* Private key of cert, PEM */
+	const char *ca; /* CA of the client certificates, NULL to not require one */
+	int ktls; /* Hand the record layer to the kernel (Linux kTLS) when possible */
+};
+
+struct tls_conn_s;
+
+/* Returns 0, or -1 with a reason printed to stderr */
+extern int tls_init(const struct tls_conf_s *conf);
+
+/* Starts the handshake on accepted socket <s>, made non-blocking. NULL on failure */
+extern struct tls_conn_s *tls_accept(int s);
+
+/* As server_recv(), -1 with errno EAGAIN while the handshake or a record is incomplete */
+extern ssize_t tls_recv(struct tls_conn_s *c, uint8_t *buf, size_t len);
+
+/* Sends all of iov in as few records as possible, returns the number of bytes or -1 */
+extern ssize_t tls_sendv(struct tls_conn_s *c, const struct iovec *iov, size_t niov);
+
+/* Frees the connection, the socket is closed with server_close() */
+extern void tls_close(struct tls_conn_s *c);
+
+#endif /* TLS_H_INCLUDED */
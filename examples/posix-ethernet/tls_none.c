@@ -0,0 +1,44 @@
+#include "tls.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+/*
+ * TLS backend of builds without a TLS library, every call fails.
+ */
+
+extern int tls_init(const struct tls_conf_s *conf)
+{
+	(void)conf;
+	fprintf(stderr, "Built without TLS support, use make TLS=openssl\n");
+	return -1;
+}
+
+extern struct tls_conn_s *tls_accept(int s)
+{
+	(void)s;
+	return NULL;
+}
+
+extern ssize_t tls_recv(struct tls_conn_s *c, uint8_t *buf, size_t len)
+{
+	(void)c;
+	(void)buf;
+	(void)len;
+	errno = ENOTSUP;
+	return -1;
+}
+
+extern ssize_t tls_sendv(struct tls_conn_s *c, const struct iovec *iov, size_t niov)
+{
+	(void)c;
+	(void)iov;
+	(void)niov;
+	errno = ENOTSUP;
+	return -1;
+}
+
+extern void tls_close(struct tls_conn_s *c)
+{
+	(void)c;
+}
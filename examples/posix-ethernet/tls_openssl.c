@@ -0,0 +1,220 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tls.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * OpenSSL backend implementing the interface in tls.h.
+ *
+ * Sessions can be resumed from TLS 1.3 tickets or the server session cache,
+ * so a reconnecting master skips the certificate exchange. The responses of
+ * one flush are gathered into one buffer and written with one SSL_write(),
+ * which makes one record of them instead of one per response. With kTLS the
+ * kernel encrypts the records and OpenSSL only runs the handshake.
+ */
+
+enum {SEND_TIMEOUT_MS=1000};
+enum {RECORD_SIZE=16384}; /* Maximum TLS record payload */
+
+struct tls_conn_s {
+	SSL *ssl;
+	int s;
+};
+
+static SSL_CTX *s_ctx;
+
+/* Gathered responses of one SSL_write(), shared as connections are served one at a time */
+static uint8_t s_record[RECORD_SIZE];
+
+static void print_errors(const char *what)
+{
+	unsigned long err;
+
+	fprintf(stderr, "%s failed\n", what);
+	while ((err=ERR_get_error())!=0) {
+		fprintf(stderr, "  %s\n", ERR_error_string(err, NULL));
+	}
+}
+
+static int set_nonblock(int s)
+{
+	int flags;
+
+	if ((flags=fcntl(s, F_GETFL, 0))==-1) {
+		return -1;
+	}
+
+	return fcntl(s, F_SETFL, flags|O_NONBLOCK);
+}
+
+/* Waits for the socket as asked by the last failed call, 0 on timeout or error */
+static int wait_io(struct tls_conn_s *c, int ret)
+{
+	struct pollfd pfd={0};
+
+	switch (SSL_get_error(c->ssl, ret)) {
+	case SSL_ERROR_WANT_READ: pfd.events = POLLIN; break;
+	case SSL_ERROR_WANT_WRITE: pfd.events = POLLOUT; break;
+	default: return 0;
+	}
+	pfd.fd = c->s;
+
+	return poll(&pfd, 1, SEND_TIMEOUT_MS)>0;
+}
+
+extern int tls_init(const struct tls_conf_s *conf)
+{
+	static const unsigned char sid_ctx[] = "mbslave";
+
+	if ((s_ctx=SSL_CTX_new(TLS_server_method()))==NULL) {
+		print_errors("SSL_CTX_new");
+		return -1;
+	}
+
+	/* Modbus/TCP Security requires TLS 1.2 or later */
+	(void)SSL_CTX_set_min_proto_version(s_ctx, TLS1_2_VERSION);
+
+	if (SSL_CTX_use_certificate_chain_file(s_ctx, conf->cert)!=1
+			|| SSL_CTX_use_PrivateKey_file(s_ctx, conf->key, SSL_FILETYPE_PEM)!=1
+			|| SSL_CTX_check_private_key(s_ctx)!=1) {
+		print_errors("Loading the certificate");
+		return -1;
+	}
+
+	if (conf->ca) {
+		if (SSL_CTX_load_verify_locations(s_ctx, conf->ca, NULL)!=1) {
+			print_errors("Loading the CA");
+			return -1;
+		}
+		SSL_CTX_set_verify(s_ctx, SSL_VERIFY_PEER|SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+	}
+
+	/* Resumption, from the session cache (TLS 1.2) or tickets (TLS 1.2 and 1.3) */
+	(void)SSL_CTX_set_session_id_context(s_ctx, sid_ctx, sizeof sid_ctx - 1u);
+	(void)SSL_CTX_set_session_cache_mode(s_ctx, SSL_SESS_CACHE_SERVER);
+
+	if (conf->ktls) {
+#ifdef SSL_OP_ENABLE_KTLS
+		(void)SSL_CTX_set_options(s_ctx, SSL_OP_ENABLE_KTLS);
+#else
+		fprintf(stderr, "OpenSSL built without kTLS, records are encrypted in user space\n");
+#endif
+	}
+
+	/* Writes to a closed peer fail with EPIPE instead of killing the server */
+	(void)signal(SIGPIPE, SIG_IGN);
+
+	return 0;
+}
+
+extern struct tls_conn_s *tls_accept(int s)
+{
+	struct tls_conn_s *c;
+
+	if (set_nonblock(s)==-1 || (c=calloc(1, sizeof *c))==NULL) {
+		return NULL;
+	}
+
+	if ((c->ssl=SSL_new(s_ctx))==NULL || SSL_set_fd(c->ssl, s)!=1) {
+		SSL_free(c->ssl);
+		free(c);
+		return NULL;
+	}
+	c->s = s;
+	SSL_set_accept_state(c->ssl);
+
+	return c;
+}
+
+extern ssize_t tls_recv(struct tls_conn_s *c, uint8_t *buf, size_t len)
+{
+	int n;
+
+	if (len>INT32_MAX) len = INT32_MAX;
+
+	/* The handshake runs as part of the first reads */
+	if ((n=SSL_read(c->ssl, buf, (int)len))>0) {
+		return n;
+	}
+
+	switch (SSL_get_error(c->ssl, n)) {
+	case SSL_ERROR_WANT_READ:
+	case SSL_ERROR_WANT_WRITE:
+		errno = EAGAIN;
+		return -1;
+	case SSL_ERROR_ZERO_RETURN:
+		return 0;
+	default:
+		ERR_clear_error();
+		errno = EIO;
+		return -1;
+	}
+}
+
+/* Writes one record, retrying with the same buffer as OpenSSL requires */
+static int write_record(struct tls_conn_s *c, size_t len)
+{
+	int n;
+
+	while ((n=SSL_write(c->ssl, s_record, (int)len))<=0) {
+		if (!wait_io(c, n)) {
+			ERR_clear_error();
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+extern ssize_t tls_sendv(struct tls_conn_s *c, const struct iovec *iov, size_t niov)
+{
+	size_t i, off, n, len=0u, total=0u;
+
+	for (i=0u; i<niov; ++i) {
+		for (off=0u; off<iov[i].iov_len; off+=n) {
+			n = iov[i].iov_len - off;
+			if (n > RECORD_SIZE-len) n = RECORD_SIZE-len;
+
+			(void)memcpy(s_record+len, (const uint8_t *)iov[i].iov_base+off, n);
+			len += n;
+
+			if (len==RECORD_SIZE) {
+				if (write_record(c, len)) return -1;
+				total += len;
+				len = 0u;
+			}
+		}
+	}
+
+	if (len>0u) {
+		if (write_record(c, len)) return -1;
+		total += len;
+	}
+
+	return (ssize_t)total;
+}
+
+extern void tls_close(struct tls_conn_s *c)
+{
+	if (c==NULL) return;
+
+	/* Best effort close_notify, the socket is non-blocking */
+	if (SSL_is_init_finished(c->ssl)) {
+		(void)SSL_shutdown(c->ssl);
+	}
+	SSL_free(c->ssl);
+	free(c);
+}
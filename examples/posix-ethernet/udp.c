@@ -0,0 +1,97 @@
+#define _GNU_SOURCE /* recvmmsg() and sendmmsg() */
+
+#include "udp.h"
+
+#include <mbadu_tcp.h>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Modbus UDP, one MBAP framed ADU per datagram.
+ *
+ * Datagrams are received in batches with one recvmmsg() and handled in place
+ * with mbadu_tcp_handle_req(), the responses go back to their senders with
+ * one sendmmsg(). No stream reassembly is needed as a datagram is always a
+ * complete frame.
+ */
+
+static uint8_t s_rx[UDP_BATCH][MBADU_TCP_SIZE_MAX];
+static uint8_t s_tx[UDP_BATCH][MBADU_TCP_SIZE_MAX];
+static struct sockaddr_storage s_addrs[UDP_BATCH];
+
+extern int udp_init(int port)
+{
+	int s;
+	struct sockaddr_in sin={0};
+
+	if ((s=socket(AF_INET, SOCK_DGRAM, 0))==-1) {
+		return -1;
+	}
+
+	sin.sin_family=AF_INET;
+	sin.sin_addr.s_addr=INADDR_ANY;
+	sin.sin_port=htons(port);
+
+	if (bind(s, (struct sockaddr*)&sin, sizeof sin)==-1) {
+		close(s);
+		return -1;
+	}
+
+	return s;
+}
+
+extern int udp_poll(int s, struct mbinst_s *inst)
+{
+	struct mmsghdr rx[UDP_BATCH]={0};
+	struct mmsghdr tx[UDP_BATCH]={0};
+	struct iovec rx_iov[UDP_BATCH];
+	struct iovec tx_iov[UDP_BATCH];
+	int i, n, nres=0, nsent=0, r;
+	size_t len;
+
+	for (i=0; i<UDP_BATCH; ++i) {
+		rx_iov[i].iov_base = s_rx[i];
+		rx_iov[i].iov_len = sizeof s_rx[i];
+		rx[i].msg_hdr.msg_name = &s_addrs[i];
+		rx[i].msg_hdr.msg_namelen = sizeof s_addrs[i];
+		rx[i].msg_hdr.msg_iov = &rx_iov[i];
+		rx[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	/* Blocks for the first datagram, then takes what is already queued */
+	n = recvmmsg(s, rx, UDP_BATCH, MSG_WAITFORONE, NULL);
+	if (n<0) {
+		return errno==EINTR ? 0 : -1;
+	}
+
+	for (i=0; i<n; ++i) {
+		len = mbadu_tcp_handle_req(inst, s_rx[i], rx[i].msg_len, s_tx[nres]);
+		if (len==0) continue; /* Invalid MBAP header, datagram dropped */
+
+		tx_iov[nres].iov_base = s_tx[nres];
+		tx_iov[nres].iov_len = len;
+		tx[nres].msg_hdr.msg_name = &s_addrs[i];
+		tx[nres].msg_hdr.msg_namelen = rx[i].msg_hdr.msg_namelen;
+		tx[nres].msg_hdr.msg_iov = &tx_iov[nres];
+		tx[nres].msg_hdr.msg_iovlen = 1;
+		++nres;
+	}
+
+	while (nsent<nres) {
+		r = sendmmsg(s, tx+nsent, (unsigned)(nres-nsent), 0);
+		if (r<0) {
+			if (errno==EINTR) continue;
+			return -1;
+		}
+		nsent += r;
+	}
+
+	return n;
+}
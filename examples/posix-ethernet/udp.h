@@ -0,0 +1,12 @@
+#ifndef UDP_H_INCLUDED
+#define UDP_H_INCLUDED
+
+#include <mbinst.h>
+
+/* Datagrams received and answered per recvmmsg()/sendmmsg() pair */
+enum {UDP_BATCH=16};
+
+extern int udp_init(int port);
+extern int udp_poll(int s, struct mbinst_s *inst);
+
+#endif /* UDP_H_INCLUDED */
@@ -0,0 +1,353 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "modbus.h"
+#include "port.h"
+
+#include <mbadu.h>
+#include <mbroute.h>
+#include <mbrtu_rx.h>
+
+#include <errno.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * RTU gateway serving several serial ports from one epoll loop.
+ *
+ * Each port has its own mbrtu_rx_s receiver, a timerfd for t3.5 (and for
+ * waiting on the transmitter of a half-duplex bus), and a routing table of the
+ * slave addresses it answers for. All slaves share the map in modbus.c.
+ */
+
+enum {MAX_PORTS=16};
+enum {MAX_SLAVES=8};
+enum {MAX_EVENTS=2*MAX_PORTS};
+enum {RXBUF_SIZE=256};
+
+enum phase_e {
+	PHASE_RX, /* Receiving requests */
+	PHASE_TX, /* Writing a response */
+	PHASE_DRAIN, /* Response written, waiting for the transmitter before releasing RTS */
+};
+
+struct port_s {
+	const char *path;
+	int fd, tfd;
+	enum port_dir_e dir;
+	enum phase_e phase;
+	uint32_t char_us;
+
+	struct mbrtu_rx_s rx;
+	struct mbroute_s route;
+	struct mbinst_s slaves[MAX_SLAVES];
+	size_t n_slaves;
+
+	uint8_t tx[MBADU_SIZE_MAX];
+	size_t tx_len, tx_off;
+};
+
+static struct port_s s_ports[MAX_PORTS];
+static size_t s_nports;
+static int s_ep = -1;
+static int s_silent;
+
+void fatal(const char *fmt, ...)
+{
+	va_list args;
+
+	fprintf(stderr, "Error: ");
+
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+
+	exit(EXIT_FAILURE);
+}
+
+void usage(const char *cmd)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS] <tty>:<baud>[:<addr>[,<addr>...]] ...\n", cmd);
+	fprintf(stderr, "OPTIONS:\n");
+	fprintf(stderr, " -h              Print this help message and exit\n");
+	fprintf(stderr, " -k              Let the driver switch RTS of RS-485 ports (TIOCSRS485)\n");
+	fprintf(stderr, " -R              Switch RTS around each response from the gateway\n");
+	fprintf(stderr, " -s              Do not print action logs\n");
+	fprintf(stderr, "Ports are 8E1, slaves answer as address 1 unless given (at most %d per port).\n", MAX_SLAVES);
+}
+
+static uint32_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec*1000000u + (uint64_t)ts.tv_nsec/1000u);
+}
+
+/* Epoll data of a port: index, and whether it is the timer */
+static uint64_t ev_data(size_t idx, int is_timer)
+{
+	return ((uint64_t)idx<<1) | (is_timer ? 1u : 0u);
+}
+
+static int watch(int fd, uint32_t events, uint64_t data, int op)
+{
+	struct epoll_event ev={0};
+
+	ev.events = events;
+	ev.data.u64 = data;
+
+	return epoll_ctl(s_ep, op, fd, &ev);
+}
+
+/* One-shot timer <us> from now */
+static void arm(struct port_s *p, uint32_t us)
+{
+	struct itimerspec its={0};
+
+	if (us==0u) us = 1u; /* 0 disarms */
+	its.it_value.tv_sec = us/1000000u;
+	its.it_value.tv_nsec = (long)(us%1000000u)*1000;
+
+	(void)timerfd_settime(p->tfd, 0, &its, NULL);
+}
+
+static void set_writable_watch(struct port_s *p, int on)
+{
+	(void)watch(p->fd, EPOLLIN|(on ? EPOLLOUT : 0u), ev_data((size_t)(p-s_ports), 0), EPOLL_CTL_MOD);
+}
+
+static void send_more(struct port_s *p)
+{
+	ssize_t n;
+
+	while (p->tx_off<p->tx_len) {
+		n = write(p->fd, p->tx+p->tx_off, p->tx_len-p->tx_off);
+		if (n<0) {
+			if (errno==EINTR) continue;
+			if (errno==EAGAIN || errno==EWOULDBLOCK) {
+				set_writable_watch(p, 1);
+				return;
+			}
+			fprintf(stderr, "%s: write: %s\n", p->path, strerror(errno));
+			break;
+		}
+		p->tx_off += (size_t)n;
+	}
+
+	set_writable_watch(p, 0);
+
+	if (p->dir==PORT_DIR_RTS) {
+		p->phase = PHASE_DRAIN;
+		arm(p, p->char_us);
+	} else {
+		p->phase = PHASE_RX;
+	}
+}
+
+static void on_frame(struct port_s *p)
+{
+	size_t len;
+
+	if (!s_silent) {
+		printf("%s: slave %u, function 0x%02X\n", p->path, p->rx.buf[0], p->rx.buf[1]);
+	}
+
+	len = mbroute_rtu_rx_handle(&p->route, &p->rx, p->tx);
+	if (len==0u) return;
+
+	p->tx_len = len;
+	p->tx_off = 0u;
+	p->phase = PHASE_TX;
+	if (p->dir==PORT_DIR_RTS) port_set_tx(p->fd, 1);
+
+	send_more(p);
+}
+
+static void on_readable(struct port_s *p)
+{
+	uint8_t buf[RXBUF_SIZE];
+	ssize_t n;
+
+	for (;;) {
+		n = read(p->fd, buf, sizeof buf);
+		if (n<0 && errno==EINTR) continue;
+		if (n<=0) break;
+
+		/* Echo of our own response on a half-duplex bus */
+		if (p->phase!=PHASE_RX) continue;
+
+		if (mbrtu_rx_recv(&p->rx, buf, (size_t)n, now_us())) {
+			on_frame(p);
+		}
+
+		/* t3.5 closes a frame of unknown length, and ends the silence after any frame */
+		arm(p, p->rx.t35_us);
+	}
+}
+
+static void on_timer(struct port_s *p)
+{
+	uint64_t expirations;
+	int empty;
+
+	(void)read(p->tfd, &expirations, sizeof expirations);
+
+	if (p->phase==PHASE_DRAIN) {
+		empty = port_tx_empty(p->fd);
+		if (empty==0) {
+			arm(p, p->char_us);
+			return;
+		}
+		if (empty<0) (void)tcdrain(p->fd); /* No LSR access, wait blocking */
+		port_set_tx(p->fd, 0);
+		p->phase = PHASE_RX;
+		return;
+	}
+
+	if (p->phase!=PHASE_RX) return;
+
+	if (mbrtu_rx_poll(&p->rx, now_us())) {
+		on_frame(p);
+	} else if (p->rx.state!=MBRTU_RX_IDLE || p->rx.wait_silence) {
+		arm(p, p->rx.t35_us/4u); /* Timer fired a bit early */
+	}
+}
+
+static void add_slave(struct port_s *p, long addr)
+{
+	struct mbinst_s *inst;
+
+	if (addr<MBADU_SLAVE_ADDR_MIN || addr>MBADU_SLAVE_ADDR_MAX) {
+		fatal("%s: invalid slave address %ld\n", p->path, addr);
+	}
+	if (mbroute_get(&p->route, (uint8_t)addr)!=NULL) {
+		fatal("%s: slave address %ld given twice\n", p->path, addr);
+	}
+	if (p->n_slaves>=MAX_SLAVES) {
+		fatal("%s: at most %d slaves per port\n", p->path, MAX_SLAVES);
+	}
+
+	inst = &p->slaves[p->n_slaves++];
+	modbus_init_slave(inst, (uint8_t)addr);
+	(void)mbroute_set(&p->route, (uint8_t)addr, inst);
+}
+
+/* <tty>:<baud>[:<addr>[,<addr>...]], modifies <spec> */
+static void add_port(char *spec, enum port_dir_e dir)
+{
+	struct port_s *p;
+	char *baud, *addrs, *end;
+	unsigned long rate;
+
+	if (s_nports>=MAX_PORTS) fatal("at most %d ports\n", MAX_PORTS);
+	p = &s_ports[s_nports];
+
+	if ((baud=strchr(spec, ':'))==NULL) fatal("missing baud rate in %s\n", spec);
+	*baud++ = '\0';
+	if ((addrs=strchr(baud, ':'))!=NULL) *addrs++ = '\0';
+
+	rate = strtoul(baud, &end, 10);
+	if (*end!='\0' || rate==0u || rate>UINT32_MAX) fatal("invalid baud rate %s\n", baud);
+
+	p->path = spec;
+	p->dir = dir;
+	p->phase = PHASE_RX;
+	p->char_us = (uint32_t)(11000000u/rate) + 1u;
+
+	mbrtu_rx_init(&p->rx, (uint32_t)rate);
+	p->rx.t15_us = 0u; /* The driver hands over bytes in chunks, inter-character gaps can't be measured */
+
+	mbroute_init(&p->route);
+	if (addrs==NULL) {
+		add_slave(p, 1);
+	} else {
+		do {
+			add_slave(p, strtol(addrs, &end, 10));
+			addrs = end+1;
+		} while (*end==',');
+		if (*end!='\0') fatal("invalid slave address list for %s\n", p->path);
+	}
+
+	if ((p->fd=port_open(p->path, (uint32_t)rate, dir))==-1) {
+		fatal("%s: %s\n", p->path, strerror(errno));
+	}
+	if ((p->tfd=timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK))==-1
+			|| watch(p->fd, EPOLLIN, ev_data(s_nports, 0), EPOLL_CTL_ADD)==-1
+			|| watch(p->tfd, EPOLLIN, ev_data(s_nports, 1), EPOLL_CTL_ADD)==-1) {
+		fatal("%s: %s\n", p->path, strerror(errno));
+	}
+
+	++s_nports;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *cmd = *argv;
+	enum port_dir_e dir = PORT_DIR_NONE;
+	struct epoll_event evs[MAX_EVENTS];
+	struct port_s *p;
+	int i, n;
+
+	if ((s_ep=epoll_create1(0))==-1) {
+		fatal("epoll: %s\n", strerror(errno));
+	}
+
+	modbus_init();
+
+	for (i=1; i<argc; ++i) {
+		if (strcmp(argv[i], "-h")==0) {
+			usage(cmd);
+			return EXIT_SUCCESS;
+		} else if (strcmp(argv[i], "-k")==0) {
+			dir = PORT_DIR_KERNEL;
+		} else if (strcmp(argv[i], "-R")==0) {
+			dir = PORT_DIR_RTS;
+		} else if (strcmp(argv[i], "-s")==0) {
+			s_silent = 1;
+		} else if (argv[i][0]=='-') {
+			usage(cmd);
+			return EXIT_FAILURE;
+		} else {
+			add_port(argv[i], dir);
+		}
+	}
+
+	if (s_nports==0u) {
+		usage(cmd);
+		return EXIT_FAILURE;
+	}
+
+	for (;;) {
+		n = epoll_wait(s_ep, evs, MAX_EVENTS, -1);
+		if (n<0) {
+			if (errno==EINTR) continue;
+			fatal("epoll_wait: %s\n", strerror(errno));
+		}
+
+		for (i=0; i<n; ++i) {
+			p = &s_ports[evs[i].data.u64>>1];
+
+			if (evs[i].data.u64 & 1u) {
+				on_timer(p);
+				continue;
+			}
+			if (evs[i].events & EPOLLOUT) {
+				send_more(p);
+			}
+			if (evs[i].events & EPOLLIN) {
+				on_readable(p);
+			}
+			if (evs[i].events & (EPOLLERR|EPOLLHUP)) {
+				fatal("%s: port closed\n", p->path);
+			}
+		}
+	}
+}
@@ -0,0 +1,12 @@
+#ifndef MODBUS_H_INCLUDED
+#define MODBUS_H_INCLUDED
+
+#include <mbinst.h>
+#include <stdint.h>
+
+extern void modbus_init(void);
+
+/* Instance answering as <addr>, sharing the map of all other instances */
+extern void modbus_init_slave(struct mbinst_s *inst, uint8_t addr);
+
+#endif /* MODBUS_H_INCLUDED */
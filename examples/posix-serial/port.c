@@ -0,0 +1,101 @@
+#define _DEFAULT_SOURCE
+
+#include "port.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+#include <stdint.h>
+#include <string.h>
+
+static speed_t baud_speed(uint32_t baud)
+{
+	switch (baud) {
+	case 1200u: return B1200;
+	case 2400u: return B2400;
+	case 4800u: return B4800;
+	case 9600u: return B9600;
+	case 19200u: return B19200;
+	case 38400u: return B38400;
+	case 57600u: return B57600;
+	case 115200u: return B115200;
+	case 230400u: return B230400;
+	default: return B0;
+	}
+}
+
+static int set_rs485(int fd)
+{
+	struct serial_rs485 conf;
+
+	(void)memset(&conf, 0, sizeof conf);
+	conf.flags = SER_RS485_ENABLED|SER_RS485_RTS_ON_SEND;
+
+	return ioctl(fd, TIOCSRS485, &conf);
+}
+
+extern int port_open(const char *path, uint32_t baud, enum port_dir_e dir)
+{
+	int fd;
+	struct termios tio;
+	speed_t speed = baud_speed(baud);
+
+	if (speed==B0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((fd=open(path, O_RDWR|O_NOCTTY|O_NONBLOCK))==-1) {
+		return -1;
+	}
+
+	if (tcgetattr(fd, &tio)==-1) {
+		close(fd);
+		return -1;
+	}
+
+	/* 8E1, the Modbus default framing */
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL|CREAD|PARENB;
+	tio.c_cflag &= ~(tcflag_t)(PARODD|CSTOPB|CRTSCTS);
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	(void)cfsetispeed(&tio, speed);
+	(void)cfsetospeed(&tio, speed);
+
+	if (tcsetattr(fd, TCSANOW, &tio)==-1
+			|| (dir==PORT_DIR_KERNEL && set_rs485(fd)==-1)) {
+		close(fd);
+		return -1;
+	}
+
+	if (dir==PORT_DIR_RTS) {
+		port_set_tx(fd, 0);
+	}
+
+	(void)tcflush(fd, TCIOFLUSH);
+
+	return fd;
+}
+
+extern void port_set_tx(int fd, int on)
+{
+	int bits = TIOCM_RTS;
+
+	(void)ioctl(fd, on ? TIOCMBIS : TIOCMBIC, &bits);
+}
+
+extern int port_tx_empty(int fd)
+{
+	unsigned int lsr = 0;
+
+	if (ioctl(fd, TIOCSERGETLSR, &lsr)==-1) {
+		return -1;
+	}
+
+	return (lsr & TIOCSER_TEMT) ? 1 : 0;
+}
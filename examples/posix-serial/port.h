@@ -0,0 +1,26 @@
+#ifndef PORT_H_INCLUDED
+#define PORT_H_INCLUDED
+
+#include <stdint.h>
+
+/*
+ * Serial port helpers of the gateway (Linux).
+ */
+
+/* Direction control of a half-duplex RS-485 transceiver */
+enum port_dir_e {
+	PORT_DIR_NONE, /* Full-duplex or automatic transceiver */
+	PORT_DIR_KERNEL, /* Driver switches RTS (TIOCSRS485) */
+	PORT_DIR_RTS, /* RTS is switched by the gateway around each response */
+};
+
+/* Open <path> non-blocking in raw mode at <baud> 8E1, returns the fd or -1 */
+extern int port_open(const char *path, uint32_t baud, enum port_dir_e dir);
+
+/* Drive the transmitter (RTS) for PORT_DIR_RTS */
+extern void port_set_tx(int fd, int on);
+
+/* 1 when the last written bit has left the shift register, 0 if not, -1 if unknown */
+extern int port_tx_empty(int fd);
+
+#endif /* PORT_H_INCLUDED */
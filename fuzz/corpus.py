@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""
+Writes the seed corpus of the fuzz harnesses to corpus/<harness>/
+
+Every seed is a request the parsers must handle, wrapped in the input format
+of each harness (see the header of the harness sources). Inputs found by the
+fuzzer that crashed a harness are kept next to the seeds, named after the
+issue they reproduce, so make regress runs them on every change.
+
+Usage: python3 corpus.py
+"""
+import os
+import struct
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# (name, PDU) pairs against the map of src/fuzz_map.c
+PDUS = [
+    ("read_coils", bytes([0x01, 0x00, 0x00, 0x00, 0x40])),
+    ("read_coils_single", bytes([0x01, 0x01, 0x00, 0x00, 0x08])),
+    ("read_disc_inputs", bytes([0x02, 0x00, 0x00, 0x00, 0x20])),
+    ("read_hold_regs", bytes([0x03, 0x00, 0x00, 0x00, 0x20])),
+    ("read_hold_regs_mixed", bytes([0x03, 0x01, 0x00, 0x00, 0x05])),
+    ("read_hold_regs_bulk", bytes([0x03, 0x02, 0x00, 0x00, 0x10])),
+    ("read_hold_regs_max", bytes([0x03, 0x00, 0x00, 0x00, 0x7D])),
+    ("read_input_regs", bytes([0x04, 0x00, 0x00, 0x00, 0x10])),
+    ("read_input_regs_u64", bytes([0x04, 0x00, 0x20, 0x00, 0x04])),
+    ("write_coil", bytes([0x05, 0x01, 0x03, 0xFF, 0x00])),
+    ("write_reg", bytes([0x06, 0x00, 0x05, 0x12, 0x34])),
+    ("write_reg_fn", bytes([0x06, 0x01, 0x10, 0xBE, 0xEF])),
+    ("write_reg_cb", bytes([0x06, 0x03, 0x00, 0x00, 0x01])),
+    ("read_exc_status", bytes([0x07])),
+    ("diag_return_query", bytes([0x08, 0x00, 0x00, 0xA5, 0x37])),
+    ("diag_bus_msg_count", bytes([0x08, 0x00, 0x0B, 0x00, 0x00])),
+    ("comm_event_counter", bytes([0x0B])),
+    ("comm_event_log", bytes([0x0C])),
+    ("write_coils", bytes([0x0F, 0x00, 0xFE, 0x00, 0x0C, 0x02, 0xCD, 0x01])),
+    ("write_coils_single", bytes([0x0F, 0x01, 0x00, 0x00, 0x08, 0x01, 0x5A])),
+    ("write_regs", bytes([0x10, 0x00, 0x00, 0x00, 0x02, 0x04, 0x00, 0x0A, 0x01, 0x02])),
+    ("write_regs_u32_f32", bytes([0x10, 0x01, 0x00, 0x00, 0x04, 0x08]) + bytes(range(8))),
+    ("write_regs_bulk", bytes([0x10, 0x02, 0x0E, 0x00, 0x02, 0x04, 0xAA, 0xBB, 0xCC, 0xDD])),
+    ("report_slave_id", bytes([0x11])),
+    ("read_file", bytes([0x14, 0x07, 0x06, 0x00, 0x01, 0x00, 0x02, 0x00, 0x04])),
+    ("read_file_flat", bytes([0x14, 0x07, 0x06, 0x00, 0x04, 0x07, 0xC0, 0x00, 0x10])),
+    # Record number plus length past 0xFFFF, the overflow fixed in 1.6.3
+    ("read_file_record_wrap", bytes([0x14, 0x07, 0x06, 0x00, 0x04, 0xFF, 0xFE, 0x00, 0x04])),
+    ("write_file", bytes([0x15, 0x0B, 0x06, 0x00, 0x01, 0x00, 0x03, 0x00, 0x02, 0x12, 0x34, 0x56, 0x78])),
+    ("mask_write_reg", bytes([0x16, 0x00, 0x04, 0x00, 0xF2, 0x00, 0x25])),
+    ("read_write_regs", bytes([0x17, 0x00, 0x00, 0x00, 0x04, 0x00, 0x10, 0x00, 0x02, 0x04, 0x00, 0x01, 0x00, 0x02])),
+    # Write byte count beyond the request, the out-of-bounds read fixed in 1.6.2
+    ("read_write_regs_short", bytes([0x17, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x7B, 0xF6, 0x00])),
+    ("read_fifo", bytes([0x18, 0x04, 0xDE])),
+    ("read_devid", bytes([0x2B, 0x0E, 0x01, 0x00])),
+    ("illegal_function", bytes([0x41, 0x00])),
+    ("empty", bytes([])),
+]
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return struct.pack("<H", crc)
+
+
+def mbap(pdu, trans_id=1):
+    return struct.pack(">HHHB", trans_id, 0, len(pdu) + 1, 1) + pdu
+
+
+def write(harness, name, data):
+    d = os.path.join(HERE, "corpus", harness)
+    os.makedirs(d, exist_ok=True)
+    with open(os.path.join(d, name), "wb") as f:
+        f.write(data)
+
+
+def main():
+    for name, pdu in PDUS:
+        adu = bytes([0x01]) + pdu
+        write("fuzz_rtu", name, bytes([0x01]) + adu)
+        write("fuzz_ascii", name, bytes([0x01]) + adu)
+        write("fuzz_tcp", name, bytes([0x00]) + mbap(pdu))
+        write("fuzz_diff", name, bytes([len(pdu)]) + pdu)
+
+    # Raw frames, checked by the ADU layer itself
+    write("fuzz_rtu", "broadcast_write", bytes([0x00, 0x00]) + bytes([0x06, 0x00, 0x01, 0x00, 0x02]) + crc16(bytes([0x00, 0x06, 0x00, 0x01, 0x00, 0x02])))
+    write("fuzz_rtu", "bad_crc", bytes([0x00, 0x01, 0x03, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00]))
+    write("fuzz_ascii", "bad_lrc", bytes([0x00]) + b":010300000001FF\r\n")
+    write("fuzz_tcp", "bad_length", bytes([0x00]) + struct.pack(">HHHB", 1, 0, 200, 1) + bytes([0x03, 0x00, 0x00, 0x00, 0x01]))
+
+    # Pipelined frames in every chunk size class
+    reqs = [pdu for _, pdu in PDUS if pdu and pdu[0] in (0x01, 0x03, 0x06, 0x10, 0x17)]
+    tcp = b"".join(mbap(pdu, i) for i, pdu in enumerate(reqs))
+    rtu = b"".join(bytes([0x01]) + pdu + crc16(bytes([0x01]) + pdu) for pdu in reqs)
+    for chunk in (1, 7, 64, 128):
+        flags = (chunk - 1) << 1
+        write("fuzz_stream", "tcp_chunk%d" % chunk, bytes([flags]) + tcp)
+        write("fuzz_stream", "rtu_chunk%d" % chunk, bytes([flags | 1]) + rtu)
+
+    # Cache hits and invalidation: read, write, read again
+    seq = [PDUS[3][1], PDUS[10][1], PDUS[3][1], PDUS[22][1], PDUS[5][1], PDUS[5][1], PDUS[19][1], PDUS[1][1]]
+    write("fuzz_diff", "read_write_read", b"".join(bytes([len(p)]) + p for p in seq))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,63 @@
+/*
+ * Fuzz harness of mbadu_ascii_handle_req(), Modbus ASCII
+ *
+ * Input: flags byte, then the frame. With bit 0 of the flags set the rest is
+ * binary (slave address and PDU) and the harness encodes it as a frame with
+ * a valid LRC, so the input reaches the PDU handlers.
+ */
+#include "fuzz_map.h"
+#include <mbadu_ascii.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char s_hex[] = "0123456789ABCDEF";
+
+/**
+ * @brief Encode a binary ADU as an ASCII frame, returns its size
+ */
+static size_t encode(const uint8_t *bin, size_t n, uint8_t *frame)
+{
+	size_t i, len = 0u;
+	uint8_t lrc = 0u;
+
+	frame[len++] = ':';
+	for (i=0u; i<=n; ++i) {
+		uint8_t b = (i<n) ? bin[i] : (uint8_t)(0u - lrc);
+		if (i<n) lrc = (uint8_t)(lrc + b);
+		frame[len++] = (uint8_t)s_hex[b>>4];
+		frame[len++] = (uint8_t)s_hex[b & 0x0Fu];
+	}
+	frame[len++] = '\r';
+	frame[len++] = '\n';
+	return len;
+}
+
+extern int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static struct mbinst_s s_inst;
+	uint8_t res[MBADU_ASCII_SIZE_MAX];
+	uint8_t *req;
+	size_t req_len, res_size;
+
+	if (size < 1u) return 0;
+	req_len = ((data[0] & 1u) != 0u) ? (2u*size + 3u) : (size - 1u);
+
+	/* Exact size copy, reads past the request are caught by ASan */
+	req = malloc(req_len + 1u);
+	if (req==NULL) return 0;
+	if ((data[0] & 1u) != 0u) {
+		req_len = encode(data+1u, size-1u, req);
+	} else {
+		(void)memcpy(req, data+1u, req_len);
+	}
+
+	fuzz_inst_init(&s_inst, FUZZ_SIDE_REF);
+	res_size = mbadu_ascii_handle_req(&s_inst, req, req_len, res);
+	FUZZ_CHECK(res_size <= sizeof res);
+	FUZZ_CHECK((res_size==0u) || ((res[0]==':') && (res[res_size-1u]=='\n')));
+
+	free(req);
+	return 0;
+}
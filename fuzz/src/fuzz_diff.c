@@ -0,0 +1,46 @@
+/*
+ * Differential fuzz harness of the optimized request paths
+ *
+ * Input: a sequence of PDUs, each a length byte followed by that many bytes.
+ * Every PDU is handled by a reference instance (binary search only) and by
+ * an optimized instance on an identical map (indices, kernels and a response
+ * cache). Responses, and the storage after every request, must be the same.
+ */
+#include "fuzz_map.h"
+#include <mbpdu.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static struct mbinst_s s_ref, s_opt;
+	uint8_t res_ref[MBPDU_SIZE_MAX], res_opt[MBPDU_SIZE_MAX];
+	size_t pos, len, n_ref, n_opt;
+	uint8_t *req;
+
+	fuzz_inst_init(&s_ref, FUZZ_SIDE_REF);
+	fuzz_inst_init(&s_opt, FUZZ_SIDE_OPT);
+
+	for (pos=0u; pos<size; pos+=len) {
+		len = data[pos++];
+		if (len > (size - pos)) len = size - pos;
+
+		/* Exact size copy, reads past the request are caught by ASan */
+		req = malloc(len + 1u);
+		if (req==NULL) return 0;
+		(void)memcpy(req, data+pos, len);
+
+		n_ref = mbpdu_handle_req(&s_ref, req, len, res_ref);
+		n_opt = mbpdu_handle_req(&s_opt, req, len, res_opt);
+		free(req);
+
+		FUZZ_CHECK(n_ref <= MBPDU_SIZE_MAX);
+		FUZZ_CHECK(n_ref == n_opt);
+		FUZZ_CHECK(memcmp(res_ref, res_opt, n_ref) == 0);
+		FUZZ_CHECK(fuzz_storage_equal());
+	}
+
+	return 0;
+}
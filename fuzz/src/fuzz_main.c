@@ -0,0 +1,127 @@
+/*
+ * Standalone driver for the fuzz harnesses, without libFuzzer
+ *
+ * Usage: fuzz_<name> [-r rounds] [file|dir]...
+ *
+ * Runs every file (directories one level deep) through the harness, rounds
+ * times, and reports the throughput in execs/s. Without paths a single input
+ * is read from stdin, which is how AFL runs a harness built with afl-cc.
+ * Regressions are the corpus failing under the sanitizers, or execs/s of a
+ * change dropping against the same corpus and build flags.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "fuzz_map.h"
+#include <dirent.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+enum {
+	MAX_INPUT=1u<<16,
+	MAX_INPUTS=4096u,
+};
+
+struct input_s {
+	uint8_t *data;
+	size_t size;
+};
+
+static struct input_s s_inputs[MAX_INPUTS];
+static size_t s_n_inputs;
+
+static int load(FILE *f)
+{
+	uint8_t *data;
+	size_t size;
+
+	if (s_n_inputs >= MAX_INPUTS) return 0;
+	if ((data = malloc(MAX_INPUT)) == NULL) return 0;
+	size = fread(data, 1u, MAX_INPUT, f);
+	s_inputs[s_n_inputs].data = data;
+	s_inputs[s_n_inputs].size = size;
+	++s_n_inputs;
+	return 1;
+}
+
+static int load_file(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	int ok;
+
+	if (f==NULL) {
+		fprintf(stderr, "cannot open %s\n", path);
+		return 0;
+	}
+	ok = load(f);
+	fclose(f);
+	return ok;
+}
+
+static int load_path(const char *path)
+{
+	struct stat st;
+	struct dirent *ent;
+	DIR *dir;
+	char buf[4096];
+	int ok = 1;
+
+	if (stat(path, &st)!=0) {
+		fprintf(stderr, "cannot open %s\n", path);
+		return 0;
+	}
+	if (!S_ISDIR(st.st_mode)) return load_file(path);
+
+	if ((dir = opendir(path)) == NULL) return 0;
+	while (ok && ((ent = readdir(dir)) != NULL)) {
+		if (ent->d_name[0]=='.') continue;
+		snprintf(buf, sizeof buf, "%s/%s", path, ent->d_name);
+		if ((stat(buf, &st)==0) && S_ISREG(st.st_mode)) ok = load_file(buf);
+	}
+	closedir(dir);
+	return ok;
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec*1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long rounds = 1u, r;
+	size_t i, n_execs = 0u;
+	double t_start, t;
+	int argi = 1;
+
+	if ((argc > 2) && (strcmp(argv[1], "-r")==0)) {
+		rounds = strtoul(argv[2], NULL, 10);
+		argi = 3;
+	}
+
+	if (argi >= argc) {
+		if (!load(stdin)) return 1;
+	}
+	for (; argi<argc; ++argi) {
+		if (!load_path(argv[argi])) return 1;
+	}
+
+	t_start = now_s();
+	for (r=0u; r<rounds; ++r) {
+		for (i=0u; i<s_n_inputs; ++i) {
+			(void)LLVMFuzzerTestOneInput(s_inputs[i].data, s_inputs[i].size);
+			++n_execs;
+		}
+	}
+	t = now_s() - t_start;
+
+	printf("%s: %zu inputs, %zu execs, %.0f execs/s\n",
+		argv[0], s_n_inputs, n_execs, (t > 0.0) ? ((double)n_execs / t) : 0.0);
+	return 0;
+}
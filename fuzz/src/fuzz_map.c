@@ -0,0 +1,202 @@
+/*
+ * Register, coil and file maps shared by the fuzz harnesses
+ */
+#include "fuzz_map.h"
+#include <endian.h>
+#include <mbcache.h>
+#include <mbcoil.h>
+#include <mbfile.h>
+#include <mbplan.h>
+#include <mbreg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {
+	N_REGS=32u,
+	N_BULK=16u,
+	N_INPUT_REGS=16u,
+	N_COIL_BYTES=8u,
+	N_DISC_BYTES=4u,
+	N_FILE_REGS=64u,
+	N_FLAT_WORDS=2000u,
+	N_HOLD_DESCS=8u,
+	N_INPUT_DESCS=2u,
+	N_COIL_DESCS=10u,
+	N_CACHE_ENTRIES=4u,
+	N_PLAN_ENTRIES=4u,
+};
+
+struct storage_s {
+	uint16_t regs[N_REGS];
+	uint32_t u32;
+	float f32;
+	uint16_t fn_reg;
+	uint16_t bulk[N_BULK];
+	uint16_t cb_reg;
+	uint32_t n_post_writes;
+	uint16_t input_regs[N_INPUT_REGS];
+	uint64_t input_u64;
+	uint8_t coils[N_COIL_BYTES];
+	uint8_t coil_byte;
+	uint8_t disc[N_DISC_BYTES];
+	uint16_t file_regs[N_FILE_REGS];
+	uint16_t flat_words[N_FLAT_WORDS];
+};
+
+static struct storage_s s_st[FUZZ_N_SIDES];
+
+static struct mbreg_desc_s s_hold[FUZZ_N_SIDES][N_HOLD_DESCS];
+static struct mbreg_desc_s s_input[FUZZ_N_SIDES][N_INPUT_DESCS];
+static struct mbcoil_desc_s s_coils[FUZZ_N_SIDES][N_COIL_DESCS];
+static struct mbcoil_desc_s s_disc[FUZZ_N_SIDES][1];
+static struct mbreg_desc_s s_file_recs[FUZZ_N_SIDES][1];
+static struct mbfile_desc_s s_files[FUZZ_N_SIDES][2];
+
+static uint16_t s_ix_buf[4096];
+static struct mbreg_kernel_s s_kern_buf[N_HOLD_DESCS + N_INPUT_DESCS];
+static struct mbinst_prep_s s_prep;
+static struct mbcache_entry_s s_cache_entries[N_CACHE_ENTRIES];
+static struct mbcache_s s_cache;
+static struct mbplan_entry_s s_plan_entries[N_PLAN_ENTRIES];
+static struct mbplan_s s_plan;
+
+/* Callbacks only see their own side */
+#define SIDE_CALLBACKS(k) \
+	static uint16_t fn_read_##k(void) { return s_st[k].fn_reg; } \
+	static enum mbstatus_e fn_write_##k(uint16_t v) \
+	{ \
+		if (v==0xDEADu) return MB_ILLEGAL_DATA_VAL; \
+		s_st[k].fn_reg = v; \
+		return MB_OK; \
+	} \
+	static enum mbstatus_e bulk_read_##k(uint16_t addr, size_t n, uint8_t *buf) \
+	{ \
+		size_t i; \
+		for (i=0u; i<n; ++i) u16tobe(s_st[k].bulk[(addr - 0x200u) + i], buf + (2u*i)); \
+		return MB_OK; \
+	} \
+	static enum mbstatus_e bulk_write_##k(uint16_t addr, size_t n, const uint8_t *buf) \
+	{ \
+		size_t i; \
+		for (i=0u; i<n; ++i) s_st[k].bulk[(addr - 0x200u) + i] = betou16(buf + (2u*i)); \
+		return MB_OK; \
+	} \
+	static void post_write_##k(void) { ++s_st[k].n_post_writes; }
+
+SIDE_CALLBACKS(0)
+SIDE_CALLBACKS(1)
+
+static uint16_t (*const s_fn_read[FUZZ_N_SIDES])(void) = {fn_read_0, fn_read_1};
+static enum mbstatus_e (*const s_fn_write[FUZZ_N_SIDES])(uint16_t) = {fn_write_0, fn_write_1};
+static enum mbstatus_e (*const s_bulk_read[FUZZ_N_SIDES])(uint16_t, size_t, uint8_t *) = {bulk_read_0, bulk_read_1};
+static enum mbstatus_e (*const s_bulk_write[FUZZ_N_SIDES])(uint16_t, size_t, const uint8_t *) = {bulk_write_0, bulk_write_1};
+#if MBCFG_COMPACT_REGS
+/* Policy 1+k holds the callbacks of side k */
+const struct mbreg_policy_s mbreg_policies[1u+FUZZ_N_SIDES] = {
+	{0},
+	{.post_write_cb=post_write_0},
+	{.post_write_cb=post_write_1},
+};
+#else
+static void (*const s_post_write[FUZZ_N_SIDES])(void) = {post_write_0, post_write_1};
+#endif
+
+static void build_maps(unsigned k)
+{
+	struct storage_s *st = &s_st[k];
+	size_t i;
+
+	(void)memset(st, 0, sizeof *st);
+	for (i=0u; i<N_REGS; ++i) st->regs[i] = (uint16_t)(0x1000u + i);
+	for (i=0u; i<N_FLAT_WORDS; ++i) st->flat_words[i] = (uint16_t)i;
+	st->coils[0] = 0xA5u;
+	st->disc[1] = 0x3Cu;
+
+	s_hold[k][0] = (struct mbreg_desc_s){.address=0x000u, .type=MRTYPE_U16 | MRTYPE_BLOCK, .n_block_entries=N_REGS,
+		.access=MRACC_RW_PTR, .read={.pu16=st->regs}, .write={.pu16=st->regs}};
+	s_hold[k][1] = (struct mbreg_desc_s){.address=0x100u, .type=MRTYPE_U32,
+		.access=MRACC_RW_PTR, .read={.pu32=&st->u32}, .write={.pu32=&st->u32}};
+	s_hold[k][2] = (struct mbreg_desc_s){.address=0x102u, .type=MRTYPE_F32,
+		.access=MRACC_RW_PTR, .read={.pf32=&st->f32}, .write={.pf32=&st->f32}};
+	s_hold[k][3] = (struct mbreg_desc_s){.address=0x104u, .type=MRTYPE_I16,
+		.access=MRACC_R_VAL, .read={.i16=-2}};
+	s_hold[k][4] = (struct mbreg_desc_s){.address=0x110u, .type=MRTYPE_U16,
+		.access=MRACC_R_FN | MRACC_W_FN, .read={.fu16=s_fn_read[k]}, .write={.fu16=s_fn_write[k]}};
+	s_hold[k][5] = (struct mbreg_desc_s){.address=0x200u, .type=MRTYPE_U16 | MRTYPE_BLOCK, .n_block_entries=N_BULK,
+		.access=MRACC_RW_BULK, .read={.bulk=s_bulk_read[k]}, .write={.bulk=s_bulk_write[k]}};
+	s_hold[k][6] = (struct mbreg_desc_s){.address=0x300u, .type=MRTYPE_U16,
+		.access=MRACC_RW_PTR, .read={.pu16=&st->cb_reg}, .write={.pu16=&st->cb_reg},
+#if MBCFG_COMPACT_REGS
+		.policy=(uint8_t)(1u+k)};
+#else
+		.post_write_cb=s_post_write[k]};
+#endif
+	s_hold[k][7] = (struct mbreg_desc_s){.address=0x301u, .type=MRTYPE_U16,
+		.access=MRACC_R_PTR, .read={.pu16=&st->cb_reg}};
+
+	s_input[k][0] = (struct mbreg_desc_s){.address=0x000u, .type=MRTYPE_U16 | MRTYPE_BLOCK, .n_block_entries=N_INPUT_REGS,
+		.access=MRACC_R_PTR, .read={.pu16=st->input_regs}};
+	s_input[k][1] = (struct mbreg_desc_s){.address=0x020u, .type=MRTYPE_U64,
+		.access=MRACC_R_PTR, .read={.pu64=&st->input_u64}};
+
+	s_coils[k][0] = (struct mbcoil_desc_s){.address=0x000u, .access=MCACC_RW_PTR, .n_block_entries=8u*N_COIL_BYTES,
+		.read={.ptr=st->coils, .ix=0u}, .write={.ptr=st->coils, .ix=0u}};
+	for (i=0u; i<8u; ++i) {
+		s_coils[k][1u+i] = (struct mbcoil_desc_s){.address=(uint16_t)(0x100u + i), .access=MCACC_RW_PTR,
+			.read={.ptr=&st->coil_byte, .ix=(uint8_t)i}, .write={.ptr=&st->coil_byte, .ix=(uint8_t)i}};
+	}
+	s_coils[k][9] = (struct mbcoil_desc_s){.address=0x200u, .access=MCACC_R_VAL, .read={.val=1u}};
+
+	s_disc[k][0] = (struct mbcoil_desc_s){.address=0x000u, .access=MCACC_R_PTR, .n_block_entries=8u*N_DISC_BYTES,
+		.read={.ptr=st->disc, .ix=0u}};
+
+	s_file_recs[k][0] = (struct mbreg_desc_s){.address=0x000u, .type=MRTYPE_U16 | MRTYPE_BLOCK, .n_block_entries=N_FILE_REGS,
+		.access=MRACC_RW_PTR, .read={.pu16=st->file_regs}, .write={.pu16=st->file_regs}};
+	s_files[k][0] = (struct mbfile_desc_s){.file_no=1u, .records=s_file_recs[k], .n_records=1u};
+	s_files[k][1] = (struct mbfile_desc_s){.file_no=4u, .words=st->flat_words, .n_words=N_FLAT_WORDS};
+}
+
+extern void fuzz_inst_init(struct mbinst_s *inst, unsigned side)
+{
+	if (side >= FUZZ_N_SIDES) side = FUZZ_SIDE_REF;
+	build_maps(side);
+
+	(void)memset(inst, 0, sizeof *inst);
+	inst->hold_regs = s_hold[side];
+	inst->n_hold_regs = N_HOLD_DESCS;
+	inst->input_regs = s_input[side];
+	inst->n_input_regs = N_INPUT_DESCS;
+	inst->coils = s_coils[side];
+	inst->n_coils = N_COIL_DESCS;
+	inst->disc_inputs = s_disc[side];
+	inst->n_disc_inputs = 1u;
+	inst->files = s_files[side];
+	inst->n_files = 2u;
+	inst->serial.slave_addr = 1u;
+	mbinst_init(inst);
+
+	if (side!=FUZZ_SIDE_OPT) return;
+
+	(void)memset(&s_prep, 0, sizeof s_prep);
+	s_prep.ix_buf = s_ix_buf;
+	s_prep.ix_buf_len = sizeof s_ix_buf / sizeof s_ix_buf[0];
+	s_prep.kern_buf = s_kern_buf;
+	s_prep.kern_buf_len = sizeof s_kern_buf / sizeof s_kern_buf[0];
+	(void)mbinst_prepare(inst, &s_prep);
+
+	s_cache.entries = s_cache_entries;
+	s_cache.n_entries = N_CACHE_ENTRIES;
+	mbcache_init(&s_cache);
+	inst->cache = &s_cache;
+
+	s_plan.entries = s_plan_entries;
+	s_plan.n_entries = N_PLAN_ENTRIES;
+	mbplan_init(&s_plan);
+	inst->plan = &s_plan;
+}
+
+extern int fuzz_storage_equal(void)
+{
+	return memcmp(&s_st[FUZZ_SIDE_REF], &s_st[FUZZ_SIDE_OPT], sizeof s_st[0]) == 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * Register, coil and file maps shared by the fuzz harnesses
+ *
+ * Two identical sides with storage of their own, so a reference instance and
+ * an optimized instance can handle the same requests side by side. The maps
+ * use every access method whose result only depends on the storage, so the
+ * response cache and read plans of the optimized side can not legitimately
+ * differ.
+ */
+#ifndef FUZZ_MAP_H_INCLUDED
+#define FUZZ_MAP_H_INCLUDED
+
+#include <mbinst.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Findings the sanitizers do not catch on their own end the run like a crash */
+#define FUZZ_CHECK(cond) do { if (!(cond)) abort(); } while (0)
+
+/* Entry point of every harness, called by libFuzzer, AFL or fuzz_main.c */
+extern int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+enum {
+	FUZZ_SIDE_REF=0u, /**< Binary search, no indices, kernels or cache */
+	FUZZ_SIDE_OPT=1u, /**< Indices and kernels from mbinst_prepare(), a response cache and read plans */
+	FUZZ_N_SIDES=2u,
+};
+
+/**
+ * @brief Reset the storage of a side and set up an instance on its maps
+ *
+ * @param inst Instance to initialize
+ * @param side FUZZ_SIDE_REF or FUZZ_SIDE_OPT
+ */
+extern void fuzz_inst_init(struct mbinst_s *inst, unsigned side);
+
+/**
+ * @brief Compare the storage of both sides
+ *
+ * @return Non-zero if equal
+ */
+extern int fuzz_storage_equal(void);
+
+#endif /* FUZZ_MAP_H_INCLUDED */
@@ -0,0 +1,66 @@
+/*
+ * Fuzz harness of the stream reassembler, mbadu_stream_tcp_proc() and
+ * mbadu_stream_rtu_proc()
+ *
+ * Input: flags byte, then the received byte stream. Bit 0 of the flags
+ * selects RTU over TCP framing, the upper bits the size of the chunks the
+ * stream is delivered in (1 to 128 bytes), so frames are split at every
+ * possible position. The response buffer holds two responses, so full
+ * buffers are exercised as well.
+ */
+#include "fuzz_map.h"
+#include <mbadu_stream.h>
+#include <mbadu_tcp.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static struct mbinst_s s_inst;
+	static struct mbadu_stream_s s_stream;
+	uint8_t res[2u*MBADU_TCP_SIZE_MAX];
+	enum mbadu_stream_status_e status;
+	size_t pos, chunk, n_consumed, res_len;
+	int is_rtu;
+
+	if (size < 1u) return 0;
+	is_rtu = (data[0] & 1u) != 0u;
+	chunk = (size_t)(data[0] >> 1) + 1u;
+
+	fuzz_inst_init(&s_inst, FUZZ_SIDE_REF);
+	mbadu_stream_init(&s_stream);
+
+	for (pos=1u; pos<size; ) {
+		size_t len = (size - pos < chunk) ? (size - pos) : chunk;
+		uint8_t *buf = malloc(len); /* Exact size, reads past the chunk are caught by ASan */
+
+		if (buf==NULL) return 0;
+		(void)memcpy(buf, data+pos, len);
+
+		do {
+			n_consumed = 0u;
+			res_len = 0u;
+			if (is_rtu) {
+				status = mbadu_stream_rtu_proc(&s_stream, &s_inst, buf, len, &n_consumed, res, sizeof res, &res_len);
+			} else {
+				status = mbadu_stream_tcp_proc(&s_stream, &s_inst, buf, len, &n_consumed, res, sizeof res, &res_len);
+			}
+			FUZZ_CHECK(n_consumed <= len);
+			FUZZ_CHECK(res_len <= sizeof res);
+			FUZZ_CHECK((status!=MBADU_STREAM_RES_FULL) || (n_consumed!=0u) || (res_len!=0u)); /* Progress */
+			FUZZ_CHECK(s_stream.n <= sizeof s_stream.buf);
+
+			(void)memmove(buf, buf+n_consumed, len-n_consumed);
+			len -= n_consumed;
+		} while (status==MBADU_STREAM_RES_FULL);
+
+		free(buf);
+		if (status==MBADU_STREAM_MALFORMED) break; /* Connection closed */
+		FUZZ_CHECK(len==0u);
+		pos += chunk;
+	}
+
+	return 0;
+}
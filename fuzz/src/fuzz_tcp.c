@@ -0,0 +1,43 @@
+/*
+ * Fuzz harness of mbadu_tcp_handle_req(), Modbus TCP/IP
+ *
+ * Input: flags byte, then the ADU. With bit 0 of the flags set the harness
+ * fixes the protocol id and length of the MBAP header, so the input reaches
+ * the PDU handlers.
+ */
+#include "fuzz_map.h"
+#include <endian.h>
+#include <mbadu_tcp.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static struct mbinst_s s_inst;
+	uint8_t res[MBADU_TCP_SIZE_MAX];
+	uint8_t *req;
+	size_t req_len, res_size;
+
+	if (size < 1u) return 0;
+	req_len = size - 1u;
+
+	/* Exact size copy, reads past the request are caught by ASan */
+	req = malloc(req_len + 1u);
+	if (req==NULL) return 0;
+	(void)memcpy(req, data+1u, req_len);
+	if (((data[0] & 1u) != 0u) && (req_len > MBAP_SIZE) && (req_len <= MBADU_TCP_SIZE_MAX)) {
+		u16tobe(MBADU_TCP_PROT_ID, req + MBAP_POS_PROT_ID);
+		u16tobe((uint16_t)(req_len - MBAP_POS_UNIT_ID), req + MBAP_POS_LEN);
+	}
+
+	fuzz_inst_init(&s_inst, FUZZ_SIDE_REF);
+	res_size = mbadu_tcp_handle_req(&s_inst, req, req_len, res);
+	FUZZ_CHECK(res_size <= sizeof res);
+	FUZZ_CHECK((res_size==0u) || (res_size > MBAP_SIZE));
+	FUZZ_CHECK((res_size==0u) || (betou16(res + MBAP_POS_LEN) == (res_size - MBAP_POS_UNIT_ID)));
+
+	free(req);
+	return 0;
+}
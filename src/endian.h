@@ -2,6 +2,9 @@
  * @file endian.h
  * @brief Endian Conversion Utilities - Platform-independent byte order conversion
  * @author Jonas Almås
+ *
+ * @details The conversions are compiled in endian.c, or defined as static
+ * inline functions in every including file when MBCFG_ENDIAN_INLINE is set.
  */
 
 /*
@@ -31,8 +34,15 @@
 #ifndef ENDIAN_H_INCLUDED
 #define ENDIAN_H_INCLUDED
 
+#include "mbconfig.h"
 #include <stdint.h>
 
+#if MBCFG_ENDIAN_INLINE
+#define ENDIAN_API static inline
+#else
+#define ENDIAN_API extern
+#endif
+
 /**
  * @brief Converts a big-endian byte array to a 16-bit unsigned integer.
  *
@@ -42,7 +52,7 @@
  *
  * @return 16-bit unsigned integer representation of the byte array.
  */
-extern uint16_t betou16(const uint8_t *buf);
+ENDIAN_API uint16_t betou16(const uint8_t *buf);
 
 /**
  * @brief Converts a big-endian byte array to a 32-bit unsigned integer.
@@ -53,7 +63,7 @@ extern uint16_t betou16(const uint8_t *buf);
  *
  * @return 32-bit unsigned integer representation of the byte array.
  */
-extern uint32_t betou32(const uint8_t *buf);
+ENDIAN_API uint32_t betou32(const uint8_t *buf);
 
 /**
  * @brief Converts a big-endian byte array to a 64-bit unsigned integer.
@@ -64,7 +74,7 @@ extern uint32_t betou32(const uint8_t *buf);
  *
  * @return 64-bit unsigned integer representation of the byte array.
  */
-extern uint64_t betou64(const uint8_t *buf);
+ENDIAN_API uint64_t betou64(const uint8_t *buf);
 
 /**
  * @brief Converts a big-endian byte array to a 16-bit signed integer.
@@ -75,7 +85,7 @@ extern uint64_t betou64(const uint8_t *buf);
  *
  * @return 16-bit signed integer representation of the byte array.
  */
-extern int16_t betoi16(const uint8_t *buf);
+ENDIAN_API int16_t betoi16(const uint8_t *buf);
 
 /**
  * @brief Converts a big-endian byte array to a 32-bit signed integer.
@@ -86,7 +96,7 @@ extern int16_t betoi16(const uint8_t *buf);
  *
  * @return 32-bit signed integer representation of the byte array.
  */
-extern int32_t betoi32(const uint8_t *buf);
+ENDIAN_API int32_t betoi32(const uint8_t *buf);
 
 /**
  * @brief Converts a big-endian byte array to a 64-bit signed integer.
@@ -97,7 +107,7 @@ extern int32_t betoi32(const uint8_t *buf);
  *
  * @return 64-bit signed integer representation of the byte array.
  */
-extern int64_t betoi64(const uint8_t *buf);
+ENDIAN_API int64_t betoi64(const uint8_t *buf);
 
 /**
  * @brief Converts a big-endian byte array to a 32-bit single-precision float.
@@ -108,7 +118,7 @@ extern int64_t betoi64(const uint8_t *buf);
  *
  * @return 32-bit single-precision float representation of the byte array.
  */
-extern float betof32(const uint8_t *buf);
+ENDIAN_API float betof32(const uint8_t *buf);
 
 /**
  * @brief Converts a big-endian byte array to a 64-bit double-precision float.
@@ -119,7 +129,7 @@ extern float betof32(const uint8_t *buf);
  *
  * @return 64-bit double-precision float representation of the byte array.
  */
-extern double betof64(const uint8_t *buf);
+ENDIAN_API double betof64(const uint8_t *buf);
 
 /**
  * @brief Converts a little-endian byte array to a 16-bit unsigned integer.
@@ -130,7 +140,7 @@ extern double betof64(const uint8_t *buf);
  *
  * @return 16-bit unsigned integer representation of the byte array.
  */
-extern uint16_t letou16(const uint8_t *buf);
+ENDIAN_API uint16_t letou16(const uint8_t *buf);
 
 /**
  * @brief Converts a little-endian byte array to a 32-bit unsigned integer.
@@ -141,7 +151,7 @@ extern uint16_t letou16(const uint8_t *buf);
  *
  * @return 32-bit unsigned integer representation of the byte array.
  */
-extern uint32_t letou32(const uint8_t *buf);
+ENDIAN_API uint32_t letou32(const uint8_t *buf);
 
 /**
  * @brief Converts a little-endian byte array to a 64-bit unsigned integer.
@@ -152,7 +162,7 @@ extern uint32_t letou32(const uint8_t *buf);
  *
  * @return 64-bit unsigned integer representation of the byte array.
  */
-extern uint64_t letou64(const uint8_t *buf);
+ENDIAN_API uint64_t letou64(const uint8_t *buf);
 
 /**
  * @brief Converts a little-endian byte array to a 16-bit signed integer.
@@ -163,7 +173,7 @@ extern uint64_t letou64(const uint8_t *buf);
  *
  * @return 16-bit signed integer representation of the byte array.
  */
-extern int16_t letoi16(const uint8_t *buf);
+ENDIAN_API int16_t letoi16(const uint8_t *buf);
 
 /**
  * @brief Converts a little-endian byte array to a 32-bit signed integer.
@@ -174,7 +184,7 @@ extern int16_t letoi16(const uint8_t *buf);
  *
  * @return 32-bit signed integer representation of the byte array.
  */
-extern int32_t letoi32(const uint8_t *buf);
+ENDIAN_API int32_t letoi32(const uint8_t *buf);
 
 /**
  * @brief Converts a little-endian byte array to a 64-bit signed integer.
@@ -185,7 +195,7 @@ extern int32_t letoi32(const uint8_t *buf);
  *
  * @return 64-bit signed integer representation of the byte array.
  */
-extern int64_t letoi64(const uint8_t *buf);
+ENDIAN_API int64_t letoi64(const uint8_t *buf);
 
 /**
  * @brief Converts a little-endian byte array to a 32-bit single-precision float.
@@ -196,7 +206,7 @@ extern int64_t letoi64(const uint8_t *buf);
  *
  * @return 32-bit single-precision float representation of the byte array.
  */
-extern float letof32(const uint8_t *buf);
+ENDIAN_API float letof32(const uint8_t *buf);
 
 /**
  * @brief Converts a little-endian byte array to a 64-bit double-precision float.
@@ -207,7 +217,7 @@ extern float letof32(const uint8_t *buf);
  *
  * @return 64-bit double-precision float representation of the byte array.
  */
-extern double letof64(const uint8_t *buf);
+ENDIAN_API double letof64(const uint8_t *buf);
 
 /**
  * @brief Converts a uint16 to its big-endian representation.
@@ -217,7 +227,7 @@ extern double letof64(const uint8_t *buf);
  *        Must not be NULL.
  *        Must have at least 2 bytes of space.
  */
-extern void u16tobe(uint16_t val, uint8_t *dst);
+ENDIAN_API void u16tobe(uint16_t val, uint8_t *dst);
 
 /**
  * @brief Converts a uint32 to its big-endian representation.
@@ -227,7 +237,7 @@ extern void u16tobe(uint16_t val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 4 bytes of space.
  */
-extern void u32tobe(uint32_t val, uint8_t *dst);
+ENDIAN_API void u32tobe(uint32_t val, uint8_t *dst);
 
 /**
  * @brief Converts a uint64 to its big-endian representation.
@@ -237,7 +247,7 @@ extern void u32tobe(uint32_t val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 8 bytes of space.
  */
-extern void u64tobe(uint64_t val, uint8_t *dst);
+ENDIAN_API void u64tobe(uint64_t val, uint8_t *dst);
 
 /**
  * @brief Converts a int16 to its big-endian representation.
@@ -247,7 +257,7 @@ extern void u64tobe(uint64_t val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 2 bytes of space.
  */
-extern void i16tobe(int16_t val, uint8_t *dst);
+ENDIAN_API void i16tobe(int16_t val, uint8_t *dst);
 
 /**
  * @brief Converts a int32 to its big-endian representation.
@@ -257,7 +267,7 @@ extern void i16tobe(int16_t val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 4 bytes of space.
  */
-extern void i32tobe(int32_t val, uint8_t *dst);
+ENDIAN_API void i32tobe(int32_t val, uint8_t *dst);
 
 /**
  * @brief Converts a int64 to its big-endian representation.
@@ -267,7 +277,7 @@ extern void i32tobe(int32_t val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 8 bytes of space.
  */
-extern void i64tobe(int64_t val, uint8_t *dst);
+ENDIAN_API void i64tobe(int64_t val, uint8_t *dst);
 
 /**
  * @brief Converts a float to its big-endian representation.
@@ -277,7 +287,7 @@ extern void i64tobe(int64_t val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 4 bytes of space.
  */
-extern void f32tobe(float val, uint8_t *dst);
+ENDIAN_API void f32tobe(float val, uint8_t *dst);
 
 /**
  * @brief Converts a double to its big-endian representation.
@@ -287,7 +297,7 @@ extern void f32tobe(float val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 8 bytes of space.
  */
-extern void f64tobe(double val, uint8_t *dst);
+ENDIAN_API void f64tobe(double val, uint8_t *dst);
 
 /**
  * @brief Converts a uint16 to its little-endian representation.
@@ -297,7 +307,7 @@ extern void f64tobe(double val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 2 bytes of space.
  */
-extern void u16tole(uint16_t val, uint8_t *dst);
+ENDIAN_API void u16tole(uint16_t val, uint8_t *dst);
 
 /**
  * @brief Converts a uint32 to its little-endian representation.
@@ -307,7 +317,7 @@ extern void u16tole(uint16_t val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 4 bytes of space.
  */
-extern void u32tole(uint32_t val, uint8_t *dst);
+ENDIAN_API void u32tole(uint32_t val, uint8_t *dst);
 
 /**
  * @brief Converts a uint64 to its little-endian representation.
@@ -317,7 +327,7 @@ extern void u32tole(uint32_t val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 8 bytes of space.
  */
-extern void u64tole(uint64_t val, uint8_t *dst);
+ENDIAN_API void u64tole(uint64_t val, uint8_t *dst);
 
 /**
  * @brief Converts a int16 to its little-endian representation.
@@ -327,7 +337,7 @@ extern void u64tole(uint64_t val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 2 bytes of space.
  */
-extern void i16tole(int16_t val, uint8_t *dst);
+ENDIAN_API void i16tole(int16_t val, uint8_t *dst);
 
 /**
  * @brief Converts a int32 to its little-endian representation.
@@ -337,7 +347,7 @@ extern void i16tole(int16_t val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 4 bytes of space.
  */
-extern void i32tole(int32_t val, uint8_t *dst);
+ENDIAN_API void i32tole(int32_t val, uint8_t *dst);
 
 /**
  * @brief Converts a int64 to its little-endian representation.
@@ -347,7 +357,7 @@ extern void i32tole(int32_t val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 8 bytes of space.
  */
-extern void i64tole(int64_t val, uint8_t *dst);
+ENDIAN_API void i64tole(int64_t val, uint8_t *dst);
 
 /**
  * @brief Converts a float to its little-endian representation.
@@ -357,7 +367,7 @@ extern void i64tole(int64_t val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 4 bytes of space.
  */
-extern void f32tole(float val, uint8_t *dst);
+ENDIAN_API void f32tole(float val, uint8_t *dst);
 
 /**
  * @brief Converts a double to its little-endian representation.
@@ -367,6 +377,10 @@ extern void f32tole(float val, uint8_t *dst);
  *        Must not be NULL.
  *        Must have at least 8 bytes of space.
  */
-extern void f64tole(double val, uint8_t *dst);
+ENDIAN_API void f64tole(double val, uint8_t *dst);
+
+#if MBCFG_ENDIAN_INLINE
+#include "endian_impl.h"
+#endif
 
 #endif /* ENDIAN_H_INCLUDED */
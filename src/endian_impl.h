@@ -0,0 +1,363 @@
+/**
+ * @file endian_impl.h
+ * @brief Endian Conversion Utilities - Shared implementation
+ * @author Jonas Almås
+ *
+ * @details Function bodies of endian.h. Compiled once in endian.c, or
+ * included by endian.h as static inline functions when MBCFG_ENDIAN_INLINE
+ * is set, so that targets without LTO do not pay a call per conversion.
+ *
+ * With GCC compatible compilers the conversions are a (possibly unaligned)
+ * load or store plus __builtin_bswap*() where the host order differs, other
+ * compilers use the portable shifts.
+ *
+ * @note Not to be included directly, include endian.h
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef ENDIAN_IMPL_H_INCLUDED
+#define ENDIAN_IMPL_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define ENDIAN_BSWAP 1
+#define ENDIAN_BE16(v) __builtin_bswap16(v)
+#define ENDIAN_BE32(v) __builtin_bswap32(v)
+#define ENDIAN_BE64(v) __builtin_bswap64(v)
+#define ENDIAN_LE16(v) (v)
+#define ENDIAN_LE32(v) (v)
+#define ENDIAN_LE64(v) (v)
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define ENDIAN_BSWAP 1
+#define ENDIAN_BE16(v) (v)
+#define ENDIAN_BE32(v) (v)
+#define ENDIAN_BE64(v) (v)
+#define ENDIAN_LE16(v) __builtin_bswap16(v)
+#define ENDIAN_LE32(v) __builtin_bswap32(v)
+#define ENDIAN_LE64(v) __builtin_bswap64(v)
+#else
+#define ENDIAN_BSWAP 0
+#endif
+
+ENDIAN_API uint16_t betou16(const uint8_t *buf)
+{
+#if ENDIAN_BSWAP
+	uint16_t v;
+	(void)memcpy(&v, buf, sizeof v);
+	return ENDIAN_BE16(v);
+#else
+	return (uint16_t)(((uint16_t)buf[0] << 8)
+		| ((uint16_t)buf[1]));
+#endif
+}
+
+ENDIAN_API uint32_t betou32(const uint8_t *buf)
+{
+#if ENDIAN_BSWAP
+	uint32_t v;
+	(void)memcpy(&v, buf, sizeof v);
+	return ENDIAN_BE32(v);
+#else
+	return ((uint32_t)buf[0] << 24)
+		| ((uint32_t)buf[1] << 16)
+		| ((uint32_t)buf[2] << 8)
+		| ((uint32_t)buf[3]);
+#endif
+}
+
+ENDIAN_API uint64_t betou64(const uint8_t *buf)
+{
+#if ENDIAN_BSWAP
+	uint64_t v;
+	(void)memcpy(&v, buf, sizeof v);
+	return ENDIAN_BE64(v);
+#else
+	return ((uint64_t)buf[0] << 56)
+		| ((uint64_t)buf[1] << 48)
+		| ((uint64_t)buf[2] << 40)
+		| ((uint64_t)buf[3] << 32)
+		| ((uint64_t)buf[4] << 24)
+		| ((uint64_t)buf[5] << 16)
+		| ((uint64_t)buf[6] << 8)
+		| ((uint64_t)buf[7]);
+#endif
+}
+
+ENDIAN_API int16_t betoi16(const uint8_t *buf)
+{
+	uint16_t tmp = betou16(buf);
+	return *(int16_t *)&tmp;
+}
+
+ENDIAN_API int32_t betoi32(const uint8_t *buf)
+{
+	uint32_t tmp = betou32(buf);
+	return *(int32_t *)&tmp;
+}
+
+ENDIAN_API int64_t betoi64(const uint8_t *buf)
+{
+	uint64_t tmp = betou64(buf);
+	return *(int64_t *)&tmp;
+}
+
+ENDIAN_API float betof32(const uint8_t *buf)
+{
+	float f;
+	uint32_t u32 = betou32(buf);
+	(void)memcpy(&f, &u32, sizeof f);
+	return f;
+}
+
+ENDIAN_API double betof64(const uint8_t *buf)
+{
+	double f;
+	uint64_t u64 = betou64(buf);
+	(void)memcpy(&f, &u64, sizeof f);
+	return f;
+}
+
+ENDIAN_API uint16_t letou16(const uint8_t *buf)
+{
+#if ENDIAN_BSWAP
+	uint16_t v;
+	(void)memcpy(&v, buf, sizeof v);
+	return ENDIAN_LE16(v);
+#else
+	return (uint16_t)(((uint16_t)buf[0])
+		| ((uint16_t)buf[1] << 8));
+#endif
+}
+
+ENDIAN_API uint32_t letou32(const uint8_t *buf)
+{
+#if ENDIAN_BSWAP
+	uint32_t v;
+	(void)memcpy(&v, buf, sizeof v);
+	return ENDIAN_LE32(v);
+#else
+	return ((uint32_t)buf[0])
+		| ((uint32_t)buf[1] << 8)
+		| ((uint32_t)buf[2] << 16)
+		| ((uint32_t)buf[3] << 24);
+#endif
+}
+
+ENDIAN_API uint64_t letou64(const uint8_t *buf)
+{
+#if ENDIAN_BSWAP
+	uint64_t v;
+	(void)memcpy(&v, buf, sizeof v);
+	return ENDIAN_LE64(v);
+#else
+	return ((uint64_t)buf[0])
+		| ((uint64_t)buf[1] << 8)
+		| ((uint64_t)buf[2] << 16)
+		| ((uint64_t)buf[3] << 24)
+		| ((uint64_t)buf[4] << 32)
+		| ((uint64_t)buf[5] << 40)
+		| ((uint64_t)buf[6] << 48)
+		| ((uint64_t)buf[7] << 56);
+#endif
+}
+
+ENDIAN_API int16_t letoi16(const uint8_t *buf)
+{
+	uint16_t tmp = letou16(buf);
+	return *(int16_t *)&tmp;
+}
+
+ENDIAN_API int32_t letoi32(const uint8_t *buf)
+{
+	uint32_t tmp = letou32(buf);
+	return *(int32_t *)&tmp;
+}
+
+ENDIAN_API int64_t letoi64(const uint8_t *buf)
+{
+	uint64_t tmp = letou64(buf);
+	return *(int64_t *)&tmp;
+}
+
+ENDIAN_API float letof32(const uint8_t *buf)
+{
+	float f;
+	uint32_t u32 = letou32(buf);
+	(void)memcpy(&f, &u32, sizeof f);
+	return f;
+}
+
+ENDIAN_API double letof64(const uint8_t *buf)
+{
+	double f;
+	uint64_t u64 = letou64(buf);
+	(void)memcpy(&f, &u64, sizeof f);
+	return f;
+}
+
+ENDIAN_API void u16tobe(uint16_t val, uint8_t *dst)
+{
+#if ENDIAN_BSWAP
+	val = ENDIAN_BE16(val);
+	(void)memcpy(dst, &val, sizeof val);
+#else
+	dst[0] = (uint8_t)((val >> 8) & 0xFFu);
+	dst[1] = (uint8_t)(val & 0xFFu);
+#endif
+}
+
+ENDIAN_API void u32tobe(uint32_t val, uint8_t *dst)
+{
+#if ENDIAN_BSWAP
+	val = ENDIAN_BE32(val);
+	(void)memcpy(dst, &val, sizeof val);
+#else
+	dst[0] = (uint8_t)((val >> 24) & 0xFFu);
+	dst[1] = (uint8_t)((val >> 16) & 0xFFu);
+	dst[2] = (uint8_t)((val >> 8) & 0xFFu);
+	dst[3] = (uint8_t)(val & 0xFFu);
+#endif
+}
+
+ENDIAN_API void u64tobe(uint64_t val, uint8_t *dst)
+{
+#if ENDIAN_BSWAP
+	val = ENDIAN_BE64(val);
+	(void)memcpy(dst, &val, sizeof val);
+#else
+	dst[0] = (uint8_t)((val >> 56) & 0xFFu);
+	dst[1] = (uint8_t)((val >> 48) & 0xFFu);
+	dst[2] = (uint8_t)((val >> 40) & 0xFFu);
+	dst[3] = (uint8_t)((val >> 32) & 0xFFu);
+	dst[4] = (uint8_t)((val >> 24) & 0xFFu);
+	dst[5] = (uint8_t)((val >> 16) & 0xFFu);
+	dst[6] = (uint8_t)((val >> 8) & 0xFFu);
+	dst[7] = (uint8_t)(val & 0xFFu);
+#endif
+}
+
+ENDIAN_API void i16tobe(int16_t val, uint8_t *dst)
+{
+	u16tobe(*(uint16_t *)&val, dst);
+}
+
+ENDIAN_API void i32tobe(int32_t val, uint8_t *dst)
+{
+	u32tobe(*(uint32_t *)&val, dst);
+}
+
+ENDIAN_API void i64tobe(int64_t val, uint8_t *dst)
+{
+	u64tobe(*(uint64_t *)&val, dst);
+}
+
+ENDIAN_API void f32tobe(float val, uint8_t *dst)
+{
+	uint32_t u32;
+	(void)memcpy(&u32, &val, sizeof u32);
+	u32tobe(u32, dst);
+}
+
+ENDIAN_API void f64tobe(double val, uint8_t *dst)
+{
+	uint64_t u64;
+	(void)memcpy(&u64, &val, sizeof u64);
+	u64tobe(u64, dst);
+}
+
+ENDIAN_API void u16tole(uint16_t val, uint8_t *dst)
+{
+#if ENDIAN_BSWAP
+	val = ENDIAN_LE16(val);
+	(void)memcpy(dst, &val, sizeof val);
+#else
+	dst[0] = (uint8_t)(val & 0xFFu);
+	dst[1] = (uint8_t)((val >> 8) & 0xFFu);
+#endif
+}
+
+ENDIAN_API void u32tole(uint32_t val, uint8_t *dst)
+{
+#if ENDIAN_BSWAP
+	val = ENDIAN_LE32(val);
+	(void)memcpy(dst, &val, sizeof val);
+#else
+	dst[0] = (uint8_t)(val & 0xFFu);
+	dst[1] = (uint8_t)((val >> 8) & 0xFFu);
+	dst[2] = (uint8_t)((val >> 16) & 0xFFu);
+	dst[3] = (uint8_t)((val >> 24) & 0xFFu);
+#endif
+}
+
+ENDIAN_API void u64tole(uint64_t val, uint8_t *dst)
+{
+#if ENDIAN_BSWAP
+	val = ENDIAN_LE64(val);
+	(void)memcpy(dst, &val, sizeof val);
+#else
+	dst[0] = (uint8_t)(val & 0xFFu);
+	dst[1] = (uint8_t)((val >> 8) & 0xFFu);
+	dst[2] = (uint8_t)((val >> 16) & 0xFFu);
+	dst[3] = (uint8_t)((val >> 24) & 0xFFu);
+	dst[4] = (uint8_t)((val >> 32) & 0xFFu);
+	dst[5] = (uint8_t)((val >> 40) & 0xFFu);
+	dst[6] = (uint8_t)((val >> 48) & 0xFFu);
+	dst[7] = (uint8_t)((val >> 56) & 0xFFu);
+#endif
+}
+
+ENDIAN_API void i16tole(int16_t val, uint8_t *dst)
+{
+	u16tole(*(uint16_t *)&val, dst);
+}
+
+ENDIAN_API void i32tole(int32_t val, uint8_t *dst)
+{
+	u32tole(*(uint32_t *)&val, dst);
+}
+
+ENDIAN_API void i64tole(int64_t val, uint8_t *dst)
+{
+	u64tole(*(uint64_t *)&val, dst);
+}
+
+ENDIAN_API void f32tole(float val, uint8_t *dst)
+{
+	uint32_t u32;
+	(void)memcpy(&u32, &val, sizeof u32);
+	u32tole(u32, dst);
+}
+
+ENDIAN_API void f64tole(double val, uint8_t *dst)
+{
+	uint64_t u64;
+	(void)memcpy(&u64, &val, sizeof u64);
+	u64tole(u64, dst);
+}
+
+#endif /* ENDIAN_IMPL_H_INCLUDED */
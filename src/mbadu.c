@@ -40,49 +40,65 @@
 #include "endian.h"
 #include "mbpdu.h"
 #include "mbcrc.h"
+#include "mbdef.h"
+#include "mbstats.h"
+#include "mbtrace.h"
 
 /**
  * @brief Add Slave address and CRC to response ADU
  */
-static size_t prep_res(uint8_t slave_addr, uint8_t *res, size_t pdu_size)
+static size_t prep_res(struct mbinst_s *inst, uint8_t slave_addr, uint8_t *res, size_t pdu_size)
 {
+	const struct mbadu_exc_table_s *exc;
 	size_t res_size;
 	uint16_t crc;
 
 	res[0] = slave_addr;
 	res_size = 1u + pdu_size;
 
-	crc = mbcrc16(res, res_size);
+	exc = inst->serial.exc_table;
+	if ((pdu_size==2u) && (exc!=NULL) && (exc->slave_addr==slave_addr)
+			&& ((res[1] & MB_ERR_FLG)!=0u) && (res[2] < MBADU_N_EXC)) {
+		crc = (uint16_t)(exc->fc_crc[res[1] & 0x7Fu] ^ exc->code_crc[res[2]]);
+	} else {
+		crc = mbcrc16(res, res_size);
+	}
 	u16tole(crc, res+res_size);
 	res_size += 2u;
 
+	mbstats_count_bytes(inst->stats, MBSTATS_TR_RTU, 0u, res_size);
 	return res_size;
 }
 
-extern size_t mbadu_handle_req(
+/**
+ * @brief Handle a request whose CRC has already been checked
+ *
+ * @param crc_ok Non-zero if the received CRC matched the frame
+ */
+static size_t handle_req(
 	struct mbinst_s *inst,
 	const uint8_t *req,
 	size_t req_len,
+	int crc_ok,
+	uint64_t t_trace,
 	uint8_t *res)
 {
 	uint8_t recv_event;
 	uint8_t recv_slave_addr;
-	uint16_t recv_crc;
 	size_t pdu_size;
+	int was_pending;
 
-	if ((inst==NULL) || (req==NULL) || (res==NULL)) return 0u;
-	if ((req_len<MBADU_SIZE_MIN) || (req_len>MBADU_SIZE_MAX)) return 0u;
-
-	++inst->state.bus_msg_counter;
+	mbatomic_inc(&inst->state.bus_msg_counter);
+	mbstats_count_bytes(inst->stats, MBSTATS_TR_RTU, req_len, 0u);
 
 	recv_event = 0u;
-	if (inst->state.is_listen_only!=0) {recv_event |= MB_COMM_EVENT_RECV_LISTEN_MODE;}
+	if (mbatomic_load(&inst->state.is_listen_only)!=0) {recv_event |= MB_COMM_EVENT_RECV_LISTEN_MODE;}
 
 	/* Check CRC before slave address to monitor the overall health of the
 	   bus, not just this device */
-	recv_crc = letou16(req + req_len - 2u); /* CRC is in the last two bytes, little endian */
-	if (recv_crc != mbcrc16(req, req_len - 2u)) {
-		++inst->state.bus_comm_err_counter;
+	if (!crc_ok) {
+		mbatomic_inc(&inst->state.bus_comm_err_counter);
+		mbstats_count_crc_err(inst->stats);
 		recv_event |= MB_COMM_EVENT_RECV_COMM_ERR;
 		mb_add_comm_event(inst, MB_COMM_EVENT_IS_RECV | recv_event);
 		return 0u;
@@ -100,17 +116,180 @@ extern size_t mbadu_handle_req(
 	if (recv_slave_addr==MBADU_ADDR_BROADCAST) {recv_event |= MB_COMM_EVENT_RECV_BROADCAST;}
 	if (recv_event!=0u) {mb_add_comm_event(inst, MB_COMM_EVENT_IS_RECV | recv_event);}
 
-	pdu_size = mbpdu_handle_req(
-		inst,
-		req+1u, /* Skip slave address */
-		req_len-3u, /* - Slave address and crc */
-		res+1u);
+	mbtrace_emit(inst->trace, MBTRACE_EV_ADU, req[1], recv_slave_addr, t_trace);
+
+	was_pending = inst->state.pending.is_active;
+	if (recv_slave_addr==MBADU_ADDR_BROADCAST) {
+		/* No response is built, reads are dropped */
+		mbpdu_handle_broadcast(inst, req+1u, req_len-3u, res+1u);
+		pdu_size = 0u;
+	} else {
+		pdu_size = mbpdu_handle_req(
+			inst,
+			req+1u, /* Skip slave address */
+			req_len-3u, /* - Slave address and crc */
+			res+1u);
+	}
+
+	if ((pdu_size==0u) && !was_pending && inst->state.pending.is_active) {
+		inst->state.pending.slave_addr = recv_slave_addr; /* For mbadu_complete() */
+		return 0u;
+	}
 
 	/* Requests sent to the broadcast address shall never get a response */
 	if ((pdu_size==0u) || (recv_slave_addr==MBADU_ADDR_BROADCAST)) {
-		++inst->state.no_resp_counter;
+		mbatomic_inc(&inst->state.no_resp_counter);
 		return 0u;
 	}
 
-	return prep_res(recv_slave_addr, res, pdu_size);
+	return prep_res(inst, recv_slave_addr, res, pdu_size);
+}
+
+extern size_t mbadu_handle_req(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *res)
+{
+	uint16_t recv_crc;
+	uint64_t t_trace;
+
+	if ((inst==NULL) || (req==NULL) || (res==NULL)) return 0u;
+	if ((req_len<MBADU_SIZE_MIN) || (req_len>MBADU_SIZE_MAX)) return 0u;
+
+	t_trace = mbtrace_now(inst->trace);
+	recv_crc = letou16(req + req_len - 2u); /* CRC is in the last two bytes, little endian */
+
+	return handle_req(inst, req, req_len, recv_crc == mbcrc16(req, req_len - 2u), t_trace, res);
+}
+
+extern size_t mbadu_handle_req_crc(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	uint16_t crc,
+	uint8_t *res)
+{
+	if ((inst==NULL) || (req==NULL) || (res==NULL)) return 0u;
+	if ((req_len<MBADU_SIZE_MIN) || (req_len>MBADU_SIZE_MAX)) return 0u;
+
+	/* The CRC of a frame including its own CRC is zero when intact */
+	return handle_req(inst, req, req_len, crc == 0u, mbtrace_now(inst->trace), res);
+}
+
+extern size_t mbadu_complete(
+	struct mbinst_s *inst,
+	enum mbstatus_e status,
+	const uint8_t *data,
+	size_t data_len,
+	uint8_t *res)
+{
+	uint8_t slave_addr;
+	size_t pdu_size;
+
+	if ((inst==NULL) || (res==NULL)) return 0u;
+
+	slave_addr = inst->state.pending.slave_addr;
+
+	pdu_size = mbpdu_complete(inst, status, data, data_len, res+1u);
+
+	/* Requests sent to the broadcast address shall never get a response */
+	if ((pdu_size==0u) || (slave_addr==MBADU_ADDR_BROADCAST)) {
+		mbatomic_inc(&inst->state.no_resp_counter);
+		return 0u;
+	}
+
+	return prep_res(inst, slave_addr, res, pdu_size);
+}
+
+extern size_t mbadu_handle_req_buf(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbadu_buf_s *res)
+{
+	uint8_t *adu;
+
+	if ((adu=mbadu_buf_reserve(res, MBADU_SIZE_MAX))==NULL) return 0u;
+
+	res->len = mbadu_handle_req(inst, req, req_len, adu);
+	return res->len;
+}
+
+extern void mbadu_exc_table_init(struct mbadu_exc_table_s *table, uint8_t slave_addr)
+{
+	uint8_t frame[3];
+	uint16_t zero_crc;
+	size_t i;
+
+	if (table==NULL) return;
+
+	frame[0] = 0u;
+	frame[1] = 0u;
+	frame[2] = 0u;
+	zero_crc = mbcrc16(frame, sizeof frame);
+
+	table->slave_addr = slave_addr;
+	frame[0] = slave_addr;
+	for (i=0u; i<MBPDU_N_FN; ++i) {
+		frame[1] = (uint8_t)(i | MB_ERR_FLG);
+		table->fc_crc[i] = (uint16_t)(mbcrc16(frame, sizeof frame) ^ zero_crc);
+	}
+
+	frame[0] = 0u;
+	frame[1] = 0u;
+	for (i=0u; i<MBADU_N_EXC; ++i) {
+		frame[2] = (uint8_t)i;
+		table->code_crc[i] = mbcrc16(frame, sizeof frame);
+	}
+}
+
+extern size_t mbadu_expected_len(const uint8_t *partial, size_t n)
+{
+	if ((partial==NULL) || (n < 2u)) return 0u;
+
+	switch (partial[1]) {
+	case MBFC_READ_EXCEPTION_STATUS:
+	case MBFC_COMM_EVENT_COUNTER:
+	case MBFC_COMM_EVENT_LOG:
+	case MBFC_REPORT_SLAVE_ID:
+		return 4u;
+	case MBFC_READ_FIFO_QUEUE:
+		return 6u;
+	case MBFC_READ_COILS:
+	case MBFC_READ_DISC_INPUTS:
+	case MBFC_READ_HOLDING_REGS:
+	case MBFC_READ_INPUT_REGS:
+	case MBFC_WRITE_SINGLE_COIL:
+	case MBFC_WRITE_SINGLE_REG:
+	case MBFC_DIAGNOSTICS:
+		return 8u;
+	case MBFC_MASK_WRITE_REG:
+		return 10u;
+	case MBFC_READ_FILE_RECORD:
+	case MBFC_WRITE_FILE_RECORD:
+		return (n > 2u) ? (5u + partial[2]) : 0u;
+	case MBFC_WRITE_MULTIPLE_COILS:
+	case MBFC_WRITE_MULTIPLE_REGS:
+		return (n > 6u) ? (9u + partial[6]) : 0u;
+	case MBFC_READ_WRITE_REGS:
+		return (n > 10u) ? (13u + partial[10]) : 0u;
+	case MBFC_ENCAP_IFACE_TRANSPORT:
+		return ((n > 2u) && (partial[2]==MBMEI_READ_DEV_ID)) ? 7u : 0u;
+	default:
+		return 0u;
+	}
+}
+
+extern uint8_t *mbadu_buf_reserve(struct mbadu_buf_s *buf, size_t adu_size_max)
+{
+	if (buf==NULL) return NULL;
+
+	buf->len = 0u;
+	if ((buf->p==NULL) || (buf->head > buf->size)
+			|| ((buf->size - buf->head) < adu_size_max)) {
+		return NULL;
+	}
+
+	return buf->p + buf->head;
 }
@@ -74,6 +74,44 @@ enum {
 	MBADU_ADDR_DEFAULT_RESP = 248u,
 };
 
+/** @brief Exception codes covered by mbadu_exc_table_s, 0x00 to 0x0B */
+enum {MBADU_N_EXC=0x0Cu};
+
+/**
+ * @brief Precomputed CRCs of the exception responses of one slave address
+ *
+ * An exception response {slave_addr, fc|0x80, code} always has three bytes,
+ * and for a fixed length the CRC-16 of the XOR of three messages is the XOR of
+ * their CRCs. The CRC of a response is therefore fc_crc[fc] ^ code_crc[code],
+ * two loads instead of a CRC over the frame, whatever MBCRC_SLICE_BY is.
+ *
+ * @note Build with mbadu_exc_table_init(), read only afterwards so it can be
+ *       shared by workers using the same slave address
+ */
+struct mbadu_exc_table_s {
+	uint8_t slave_addr; /**< Slave address of the responses */
+	uint16_t fc_crc[MBPDU_N_FN]; /**< CRC of {slave_addr, fc|0x80, 0} xor CRC of {0, 0, 0} */
+	uint16_t code_crc[MBADU_N_EXC]; /**< CRC of {0, 0, code} */
+};
+
+/**
+ * @brief Modbus ADU response buffer
+ *
+ * Describes a buffer owned by the port (e.g. a DMA or socket buffer) that a
+ * response ADU is built into directly. The ADU starts head bytes into the
+ * buffer, leaving headroom in front of it and tailroom after it for framing
+ * added by the port.
+ *
+ * @note The PDU handlers write straight into the buffer, header and trailer of
+ *       the ADU are added in place, no intermediate copy is made
+ */
+struct mbadu_buf_s {
+	uint8_t *p; /**< Pointer to start of buffer */
+	size_t size; /**< Total buffer capacity in bytes */
+	size_t head; /**< Offset of the first ADU byte (Headroom) */
+	size_t len; /**< Out parameter with number of ADU bytes written at p+head */
+};
+
 /**
  * @brief Handle Modbus ADU request
  *
@@ -100,4 +138,107 @@ extern size_t mbadu_handle_req(
 	size_t req_len,
 	uint8_t *res);
 
+/**
+ * @brief Handle Modbus ADU request with a precomputed CRC
+ *
+ * Same as mbadu_handle_req(), but the CRC has already been computed while the
+ * bytes arrived (e.g. with mbcrc16_update() in the UART interrupt), so no CRC
+ * pass over the request is needed after the inter-frame gap.
+ *
+ * @param inst Pointer to the Modbus instance containing coil/register maps and configuration
+ * @param req Pointer to received ADU data (slave_addr + PDU + CRC)
+ * @param req_len Size of received ADU data in bytes (expected between MBADU_SIZE_MIN and MBADU_SIZE_MAX)
+ * @param crc CRC-16 accumulated over all req_len bytes, including the two received CRC bytes
+ * @param res Pointer to response buffer (must be at least MBADU_SIZE_MAX bytes)
+ *
+ * @return Size of response data in bytes, or 0 if no response should be sent
+ *
+ * @note An intact frame has a CRC of 0 when its own CRC bytes are included
+ */
+extern size_t mbadu_handle_req_crc(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	uint16_t crc,
+	uint8_t *res);
+
+/**
+ * @brief Complete a deferred Modbus RTU request
+ *
+ * Builds the RTU ADU response of the request for which a handler returned
+ * MB_PENDING, see mbpdu_complete().
+ *
+ * @param inst Pointer to the Modbus instance with a pending request
+ * @param status Final status of the request (MB_OK or exception code)
+ * @param data Response data following the function code (NULL to echo the request)
+ * @param data_len Length of data in bytes
+ * @param res Pointer to response buffer (must be at least MBADU_SIZE_MAX bytes)
+ *
+ * @return Size of response ADU in bytes, or 0 if no response should be sent
+ */
+extern size_t mbadu_complete(
+	struct mbinst_s *inst,
+	enum mbstatus_e status,
+	const uint8_t *data,
+	size_t data_len,
+	uint8_t *res);
+
+/**
+ * @brief Handle Modbus ADU request into a port owned response buffer
+ *
+ * Same as mbadu_handle_req(), but the response ADU is built directly at res->p+res->head,
+ * e.g. inside a DMA or socket buffer with headroom for port framing.
+ *
+ * @param inst Pointer to the Modbus instance containing coil/register maps and configuration
+ * @param req Pointer to received ADU data
+ * @param req_len Size of received ADU data in bytes
+ * @param res Response buffer, at least MBADU_SIZE_MAX bytes must be available after head
+ *
+ * @return Size of response data in bytes (also stored in res->len), or 0 if no response should be sent
+ */
+extern size_t mbadu_handle_req_buf(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbadu_buf_s *res);
+
+/**
+ * @brief Build the exception response CRCs of a slave address
+ *
+ * @param table Table to fill
+ * @param slave_addr Slave address of the instance using the table
+ *
+ * @note Attach through mbinst_s::serial.exc_table
+ */
+extern void mbadu_exc_table_init(struct mbadu_exc_table_s *table, uint8_t slave_addr);
+
+/**
+ * @brief Predict the length of a Modbus RTU request from its first bytes
+ *
+ * Lets a receiver hand over a request as soon as its last byte arrives instead
+ * of after the t3.5 silence. Fixed size requests are known from the function
+ * code, the others once their byte count has arrived (byte 2 for function codes
+ * 0x14 and 0x15, byte 6 for 0x0F and 0x10, byte 10 for 0x17). Function code
+ * 0x2B is known for MEI type 0x0E only.
+ *
+ * @param partial Received bytes of the request, starting with the slave address
+ * @param n Number of bytes received so far
+ *
+ * @return Request length including slave address and CRC, or 0 if not known (yet),
+ *         e.g. for custom function codes which must wait for the t3.5 silence
+ */
+extern size_t mbadu_expected_len(const uint8_t *partial, size_t n);
+
+/**
+ * @brief Reserve room for a response ADU in a response buffer
+ *
+ * @param buf Response buffer
+ * @param adu_size_max Largest ADU the transport may produce
+ *
+ * @return Pointer to where the ADU shall be written, or NULL if buf is invalid or too small
+ *
+ * @note Library internal function
+ */
+extern uint8_t *mbadu_buf_reserve(struct mbadu_buf_s *buf, size_t adu_size_max);
+
 #endif /* MBADU_H_INCLUDED */
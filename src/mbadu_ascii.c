@@ -46,115 +46,201 @@
 
 #include "mbadu_ascii.h"
 #include "mbadu.h"
+#include "mbconfig.h"
 #include "mbpdu.h"
-#include <ctype.h>
+#include "mbstats.h"
+#include "mbtrace.h"
+#include <stddef.h>
+#include <stdint.h>
 
-static int xtoi(int c)
+#if MBCFG_ASCII
+
+enum {NIBBLE_INVALID=0xFFu};
+
+/**
+ * @brief Hex digit to nibble value, NIBBLE_INVALID for non hex characters
+ */
+static const uint8_t s_nibble[256] = {
+	0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0x00u, 0x01u, 0x02u, 0x03u, 0x04u, 0x05u, 0x06u, 0x07u, 0x08u, 0x09u, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0x0Au, 0x0Bu, 0x0Cu, 0x0Du, 0x0Eu, 0x0Fu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0x0Au, 0x0Bu, 0x0Cu, 0x0Du, 0x0Eu, 0x0Fu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+	0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+};
+
+static const uint8_t s_hex_digits[16] = {
+	'0', '1', '2', '3', '4', '5', '6', '7',
+	'8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
+};
+
+/**
+ * @brief Validate and decode ascii hex pairs while summing the LRC
+ *
+ * @param hex Ascii hex characters, 2*n_bin of them
+ * @param n_bin Number of binary bytes to decode
+ * @param bin Decoded binary bytes (Can be the same as hex, decoding in place)
+ * @param lrc_ok Out parameter, set to 1 if the LRC (last decoded byte) matches
+ *
+ * @retval 1 All characters were valid hex
+ * @retval 0 Invalid hex character found
+ */
+static int decode(const uint8_t *hex, size_t n_bin, uint8_t *bin, int *lrc_ok)
 {
-	if ((c>='0') && (c<='9')) return c - '0';
-	if ((c>='A') && (c<='F')) return c - 'A' + 10;
-	if ((c>='a') && (c<='f')) return c - 'a' + 10;
-	return -1; /* Invalid hex char */
+	size_t i;
+	uint8_t hi, lo, sum;
+
+	sum = 0u;
+	for (i=0u; i<n_bin; ++i) {
+		hi = s_nibble[hex[2u*i]];
+		lo = s_nibble[hex[(2u*i)+1u]];
+		if (((hi|lo) & 0xF0u) != 0u) return 0; /* NIBBLE_INVALID */
+
+		bin[i] = (uint8_t)((hi << 4) | lo);
+		sum = (uint8_t)(sum + bin[i]);
+	}
+
+	/* Sum of all bytes including the LRC is zero when intact */
+	*lrc_ok = (sum == 0u);
+	return 1;
 }
 
-static void u8tox(uint8_t v, uint8_t *out)
+extern int mbadu_ascii_hex_byte(const uint8_t *hex, uint8_t *byte)
 {
-	const char *hex_digits = "0123456789ABCDEF";
-	out[0] = (uint8_t)hex_digits[(v >> 4) & 0x0Fu];
-	out[1] = (uint8_t)hex_digits[v & 0x0Fu];
+	uint8_t hi, lo;
+
+	hi = s_nibble[hex[0]];
+	lo = s_nibble[hex[1]];
+	if (((hi|lo) & 0xF0u) != 0u) return 0; /* NIBBLE_INVALID */
+
+	*byte = (uint8_t)((hi << 4) | lo);
+	return 1;
 }
 
-static uint8_t calc_lrc(const uint8_t *data, size_t len)
+/**
+ * @brief Encode binary bytes in place as ascii hex followed by their LRC
+ *
+ * Expands back to front, so every binary byte is read before its position is
+ * overwritten by the hex characters of later bytes.
+ *
+ * @param buf Binary bytes on input, ascii hex on output (room for 2*(n_bin+1) bytes)
+ * @param n_bin Number of binary bytes
+ *
+ * @return Number of characters written, 2*(n_bin+1)
+ */
+static size_t encode(uint8_t *buf, size_t n_bin)
 {
 	size_t i;
-	int sum;
+	uint8_t sum, v;
+
+	sum = 0u;
+	for (i=0u; i<n_bin; ++i) {
+		sum = (uint8_t)(sum + buf[i]);
+	}
 
-	/* Calculate sum of all bytes */
-	sum = 0;
-	for (i=0u; i<len; ++i) {
-		sum += (int)data[i];
+	for (i=n_bin; i>0u; --i) {
+		v = buf[i-1u];
+		buf[(2u*i)-2u] = s_hex_digits[v >> 4];
+		buf[(2u*i)-1u] = s_hex_digits[v & 0x0Fu];
 	}
 
-	/* Get two's complement and trim to 8 bits */
-	return (uint8_t)(-sum);
+	/* Two's complement of the sum */
+	sum = (uint8_t)(0u - sum);
+	buf[2u*n_bin] = s_hex_digits[sum >> 4];
+	buf[(2u*n_bin)+1u] = s_hex_digits[sum & 0x0Fu];
+
+	return 2u*(n_bin+1u);
 }
 
+/**
+ * @brief Turn the binary response at res+1 into an ascii ADU
+ */
 static size_t prep_res(
 	const struct mbinst_s *inst,
-	const uint8_t *bin_res,
 	size_t bin_res_len,
 	uint8_t *res)
 {
-	size_t i, res_size;
-
-	res_size = 0;
-	res[res_size++] = MBADU_ASCII_START_CHAR;
+	size_t res_size;
 
-	/* Convert binary PDU to ascii  */
-	for (i=0; i<bin_res_len; ++i) {
-		u8tox(bin_res[i], res+res_size);
-		res_size += 2u;
-	}
-
-	u8tox(calc_lrc(bin_res, bin_res_len), res+res_size);
-	res_size += 2u;
+	res[0] = MBADU_ASCII_START_CHAR;
+	res_size = 1u + encode(res+1u, bin_res_len);
 
 	res[res_size++] = (uint8_t)'\r';
-	res[res_size++] = inst->state.ascii_delimiter;
+	res[res_size++] = mbatomic_load(&inst->state.ascii_delimiter);
 
+	mbstats_count_bytes(inst->stats, MBSTATS_TR_ASCII, 0u, res_size);
 	return res_size;
 }
 
+/*
+ * Layout of the response buffer while handling a request, no other buffer is needed:
+ *
+ * [0] Start char
+ * [1..MBPDU_SIZE_MAX+1] Binary response (slave address and PDU), hex expanded in place
+ * [MBADU_ASCII_SIZE_MAX-REQ_BIN_SIZE_MAX..] Binary request (slave address, PDU and LRC)
+ */
+enum {
+	REQ_BIN_SIZE_MAX=(MBADU_ASCII_SIZE_MAX-3u)/2u,
+	REQ_BIN_OFFS=MBADU_ASCII_SIZE_MAX-REQ_BIN_SIZE_MAX,
+};
+
 extern size_t mbadu_ascii_handle_req(
 	struct mbinst_s *inst,
 	const uint8_t *req,
 	size_t req_len,
 	uint8_t *res)
 {
-	size_t i, req_bin_len, res_pdu_len;
-	uint8_t recv_slave_addr, recv_lrc;
+	size_t req_bin_len, res_pdu_len;
+	uint8_t recv_slave_addr;
 	uint8_t recv_event;
+	int lrc_ok, was_pending;
+	uint64_t t_trace;
 
-	/* Use response buffer to store temporary binary request */
-	uint8_t *req_bin = res;
-	uint8_t res_bin[1u+MBPDU_SIZE_MAX];
+	uint8_t *req_bin;
 
 	if ((inst==NULL) || (req==NULL) || (res==NULL)) return 0u;
 	if ((req_len<MBADU_ASCII_SIZE_MIN) || (req_len>MBADU_ASCII_SIZE_MAX)) return 0u;
 
-	++inst->state.bus_msg_counter;
+	t_trace = mbtrace_now(inst->trace);
+	mbatomic_inc(&inst->state.bus_msg_counter);
+	mbstats_count_bytes(inst->stats, MBSTATS_TR_ASCII, req_len, 0u);
 
 	recv_event = 0u;
-	if (inst->state.is_listen_only!=0) {recv_event |= MB_COMM_EVENT_RECV_LISTEN_MODE;}
+	if (mbatomic_load(&inst->state.is_listen_only)!=0) {recv_event |= MB_COMM_EVENT_RECV_LISTEN_MODE;}
 
 	/* Ensure correct start and end chars, and length without start char is divisible by two (ascii hex) */
 	if ((req[0] != MBADU_ASCII_START_CHAR)
 			|| (req[req_len-2u] != (uint8_t)'\r')
-			|| (req[req_len-1u] != inst->state.ascii_delimiter)
+			|| (req[req_len-1u] != mbatomic_load(&inst->state.ascii_delimiter))
 			|| (((req_len-1u)%2u) != 0u)) {
 		if (recv_event!=0u) {mb_add_comm_event(inst, MB_COMM_EVENT_IS_RECV | recv_event);}
 		return 0u;
 	}
 
-	/* Ensure entire request (excluding start and end chars) are hex */
-	for (i=1u; i<(req_len-2u); ++i) {
-		if (!isxdigit(req[i])) {
-			if (recv_event!=0u) {mb_add_comm_event(inst, MB_COMM_EVENT_IS_RECV | recv_event);}
-			return 0u;
-		}
-	}
-
-	/* Convert ascii request to binary */
-	req_bin_len = 0u;
-	for (i=1u; i<(req_len-2u); i+=2u) { /* Excluding start char and crlf */
-		req_bin[req_bin_len++] = (uint8_t)(xtoi(req[i])*16 + xtoi(req[i+1u]));
+	/* Decode request (excluding start char and crlf) to binary in one pass,
+	   ensuring it is all hex */
+	req_bin = res + REQ_BIN_OFFS;
+	req_bin_len = (req_len-3u)/2u;
+	if (!decode(req+1u, req_bin_len, req_bin, &lrc_ok)) {
+		if (recv_event!=0u) {mb_add_comm_event(inst, MB_COMM_EVENT_IS_RECV | recv_event);}
+		return 0u;
 	}
 
 	/* Check LRC before slave address to monitor the overall health of the
 	   bus, not just this device */
-	recv_lrc = req_bin[req_bin_len-1u];
-	if (recv_lrc != calc_lrc(req_bin, req_bin_len-1u)) {
-		++inst->state.bus_comm_err_counter;
+	if (!lrc_ok) {
+		mbatomic_inc(&inst->state.bus_comm_err_counter);
+		mbstats_count_crc_err(inst->stats);
 		recv_event |= MB_COMM_EVENT_RECV_COMM_ERR;
 		mb_add_comm_event(inst, MB_COMM_EVENT_IS_RECV | recv_event);
 		return 0u;
@@ -172,18 +258,71 @@ extern size_t mbadu_ascii_handle_req(
 	if (recv_slave_addr==MBADU_ADDR_BROADCAST) {recv_event |= MB_COMM_EVENT_RECV_BROADCAST;}
 	if (recv_event!=0u) {mb_add_comm_event(inst, MB_COMM_EVENT_IS_RECV | recv_event);}
 
-	res_bin[0] = req_bin[0];
-	res_pdu_len = mbpdu_handle_req(
-		inst,
-		req_bin+1u, /* Skip slave address */
-		req_bin_len-2u, /* - Slave address and lrc */
-		res_bin+1u);
+	mbtrace_emit(inst->trace, MBTRACE_EV_ADU, req_bin[1], recv_slave_addr, t_trace);
+
+	res[1] = recv_slave_addr;
+	was_pending = inst->state.pending.is_active;
+	if (recv_slave_addr==MBADU_ADDR_BROADCAST) {
+		/* No response is built, reads are dropped */
+		mbpdu_handle_broadcast(inst, req_bin+1u, req_bin_len-2u, res+2u);
+		res_pdu_len = 0u;
+	} else {
+		res_pdu_len = mbpdu_handle_req(
+			inst,
+			req_bin+1u, /* Skip slave address */
+			req_bin_len-2u, /* - Slave address and lrc */
+			res+2u);
+	}
+
+	if ((res_pdu_len==0u) && !was_pending && inst->state.pending.is_active) {
+		inst->state.pending.slave_addr = recv_slave_addr; /* For mbadu_ascii_complete() */
+		return 0u;
+	}
 
 	/* Requests sent to the broadcast address shall never get a response */
 	if ((res_pdu_len==0u) || (recv_slave_addr==MBADU_ADDR_BROADCAST)) {
-		++inst->state.no_resp_counter;
+		mbatomic_inc(&inst->state.no_resp_counter);
 		return 0u;
 	}
 
-	return prep_res(inst, res_bin, 1u+res_pdu_len, res);
+	return prep_res(inst, 1u+res_pdu_len, res);
 }
+
+extern size_t mbadu_ascii_complete(
+	struct mbinst_s *inst,
+	enum mbstatus_e status,
+	const uint8_t *data,
+	size_t data_len,
+	uint8_t *res)
+{
+	size_t res_pdu_len;
+
+	if ((inst==NULL) || (res==NULL)) return 0u;
+
+	res[1] = inst->state.pending.slave_addr;
+	res_pdu_len = mbpdu_complete(inst, status, data, data_len, res+2u);
+
+	/* Requests sent to the broadcast address shall never get a response */
+	if ((res_pdu_len==0u) || (res[1]==MBADU_ADDR_BROADCAST)) {
+		mbatomic_inc(&inst->state.no_resp_counter);
+		return 0u;
+	}
+
+	return prep_res(inst, 1u+res_pdu_len, res);
+}
+
+extern size_t mbadu_ascii_handle_req_buf(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbadu_buf_s *res)
+{
+	uint8_t *adu;
+
+	if ((adu=mbadu_buf_reserve(res, MBADU_ASCII_SIZE_MAX))==NULL) return 0u;
+
+	res->len = mbadu_ascii_handle_req(inst, req, req_len, adu);
+	return res->len;
+}
+
+#endif /* MBCFG_ASCII */
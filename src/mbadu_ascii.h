@@ -34,6 +34,7 @@
 #ifndef MBADU_ASCII_H_INCLUDED
 #define MBADU_ASCII_H_INCLUDED
 
+#include "mbadu.h"
 #include "mbinst.h"
 #include <stddef.h>
 #include <stdint.h>
@@ -98,4 +99,55 @@ extern size_t mbadu_ascii_handle_req(
 	size_t req_len,
 	uint8_t *res);
 
+/**
+ * @brief Complete a deferred Modbus ASCII request
+ *
+ * Builds the ASCII ADU response of the request for which a handler returned
+ * MB_PENDING, see mbpdu_complete().
+ *
+ * @param inst Pointer to the Modbus instance with a pending request
+ * @param status Final status of the request (MB_OK or exception code)
+ * @param data Response data following the function code (NULL to echo the request)
+ * @param data_len Length of data in bytes
+ * @param res Pointer to response buffer (must be at least MBADU_ASCII_SIZE_MAX bytes)
+ *
+ * @return Size of response ADU in bytes, or 0 if no response should be sent
+ */
+extern size_t mbadu_ascii_complete(
+	struct mbinst_s *inst,
+	enum mbstatus_e status,
+	const uint8_t *data,
+	size_t data_len,
+	uint8_t *res);
+
+/**
+ * @brief Handle Modbus ASCII ADU request into a port owned response buffer
+ *
+ * Same as mbadu_ascii_handle_req(), but the response ADU is built directly at res->p+res->head,
+ * e.g. inside a DMA or socket buffer with headroom for port framing.
+ *
+ * @param inst Pointer to the Modbus instance containing coil/register maps and configuration
+ * @param req Pointer to received ADU data
+ * @param req_len Size of received ADU data in bytes
+ * @param res Response buffer, at least MBADU_ASCII_SIZE_MAX bytes must be available after head
+ *
+ * @return Size of response data in bytes (also stored in res->len), or 0 if no response should be sent
+ */
+extern size_t mbadu_ascii_handle_req_buf(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbadu_buf_s *res);
+
+/**
+ * @brief Only for internal use, decode one ascii hex pair (e.g. the slave address of a frame)
+ *
+ * @param hex Two ascii hex characters
+ * @param byte Decoded byte, unchanged if not a valid hex pair
+ *
+ * @retval 1 Byte decoded
+ * @retval 0 Not a valid hex pair
+ */
+extern int mbadu_ascii_hex_byte(const uint8_t *hex, uint8_t *byte);
+
 #endif /* MBADU_ASCII_H_INCLUDED */
@@ -0,0 +1,355 @@
+/**
+ * @file mbadu_stream.c
+ * @brief Implementation of Modbus ADU stream reassembly
+ * @author Jonas Almås
+ *
+ * MISRA Deviations:
+ * - Rule 15.5: A function should have a single point of exit at the end
+ *   Rationale: Multiple returns improve readability and reduce nesting for error conditions
+ * - Rule 18.4: The +, -, += and -= operators should not be applied to an expression of pointer type
+ *   Rationale: Pointer arithmetic necessary for efficient buffer parsing and generation
+ *   Mitigation: Bounds checking performed, arithmetic limited to validated buffer operations
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbadu_stream.h"
+#include "endian.h"
+#include "mbadu.h"
+#include "mbadu_tcp.h"
+#include "mbcrc.h"
+#include "mbdef.h"
+#include "mbpdu.h"
+#include "mbrate.h"
+#include "mbstats.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {RTU_N_SIZE_MAX=11u}; /* Bytes after which mbadu_expected_len() knows the size of any request it can size */
+
+static size_t min(size_t a, size_t b)
+{
+	return (a < b) ? a : b;
+}
+
+/**
+ * @brief Append received bytes to the buffered partial frame
+ */
+static void buffer_append(struct mbadu_stream_s *stream, const uint8_t *data, size_t n)
+{
+	if (n > 0u) {
+		(void)memcpy(stream->buf + stream->n, data, n);
+		stream->n += n;
+	}
+}
+
+/**
+ * @brief Framing of one transport carried over a stream
+ */
+struct framing_s {
+	/**
+	 * @brief Total size of the frame starting at adu
+	 *
+	 * @return Size of the frame in bytes, 0 if more bytes are needed to tell,
+	 *         or SIZE_MAX if the frame is invalid
+	 */
+	size_t (*frame_size)(const uint8_t *adu, size_t n);
+
+	/**
+	 * @brief Handle one complete frame
+	 *
+	 * @return Size of the response, or SIZE_MAX if the frame is invalid
+	 */
+	size_t (*handle)(struct mbinst_s *inst, const uint8_t *req, size_t req_len, uint8_t *res);
+
+	/**
+	 * @brief Answer one complete frame with an MB_BUSY exception, without handling it
+	 *
+	 * @return Size of the response, or SIZE_MAX if the frame is invalid
+	 */
+	size_t (*busy)(struct mbinst_s *inst, const uint8_t *req, size_t req_len, uint8_t *res);
+
+	size_t n_min; /**< Bytes that can always be buffered, the frame size is known from them or they are part of the frame */
+	size_t res_max; /**< Maximum size of one response */
+};
+
+/**
+ * @brief Get total size of a Modbus TCP/IP ADU from its MBAP header
+ */
+static size_t tcp_frame_size(const uint8_t *mbap, size_t n)
+{
+	uint16_t length;
+
+	if (n < MBAP_SIZE) return 0u;
+
+	if (betou16(mbap + MBAP_POS_PROT_ID) != MBADU_TCP_PROT_ID) {
+		return SIZE_MAX;
+	}
+
+	/* Length includes unit id, and at least a function code must follow */
+	length = betou16(mbap + MBAP_POS_LEN);
+	if ((length < (1u+MBPDU_SIZE_MIN)) || ((length-1u) > MBPDU_SIZE_MAX)) {
+		return SIZE_MAX;
+	}
+
+	return (MBAP_SIZE - 1u) + (size_t)length;
+}
+
+/**
+ * @brief Handle a Modbus TCP/IP ADU
+ */
+static size_t tcp_handle(struct mbinst_s *inst, const uint8_t *req, size_t req_len, uint8_t *res)
+{
+	return mbadu_tcp_handle_req(inst, req, req_len, res);
+}
+
+/**
+ * @brief MB_BUSY exception response, transaction id, unit id and function code are filled in
+ */
+static const uint8_t s_tcp_busy[MBAP_SIZE+2u] = {
+	0x00u, 0x00u, /* Transaction id */
+	(uint8_t)(MBADU_TCP_PROT_ID>>8), (uint8_t)MBADU_TCP_PROT_ID,
+	0x00u, 0x03u, /* Length of unit id and exception PDU */
+	0x00u, /* Unit id */
+	MB_ERR_FLG, (uint8_t)MB_BUSY,
+};
+
+/**
+ * @brief Count a request shed with an MB_BUSY exception response
+ */
+static void count_busy(struct mbinst_s *inst, enum mbstats_transport_e tr, size_t req_len, size_t res_len)
+{
+	mbatomic_inc(&inst->state.busy_counter);
+	mbatomic_inc(&inst->state.exception_counter);
+	mbstats_count_bytes(inst->stats, tr, req_len, res_len);
+}
+
+/**
+ * @brief Answer a Modbus TCP/IP ADU with an MB_BUSY exception
+ */
+static size_t tcp_busy(struct mbinst_s *inst, const uint8_t *req, size_t req_len, uint8_t *res)
+{
+	if (mbatomic_load(&inst->state.is_listen_only)) return 0u;
+
+	(void)memcpy(res, s_tcp_busy, sizeof s_tcp_busy);
+	res[MBAP_POS_TRANS_ID] = req[MBAP_POS_TRANS_ID];
+	res[MBAP_POS_TRANS_ID+1u] = req[MBAP_POS_TRANS_ID+1u];
+	res[MBAP_POS_UNIT_ID] = req[MBAP_POS_UNIT_ID];
+	res[MBAP_SIZE] |= req[MBAP_SIZE];
+
+	count_busy(inst, MBSTATS_TR_TCP, req_len, sizeof s_tcp_busy);
+	return sizeof s_tcp_busy;
+}
+
+static const struct framing_s s_tcp = {tcp_frame_size, tcp_handle, tcp_busy, MBAP_SIZE, MBADU_TCP_SIZE_MAX};
+
+/**
+ * @brief Get total size of a Modbus RTU ADU from its first bytes
+ *
+ * Function codes mbadu_expected_len() cannot size are invalid, as the end of
+ * the frame is lost without the t3.5 silence of a serial line.
+ */
+static size_t rtu_frame_size(const uint8_t *adu, size_t n)
+{
+	size_t size = mbadu_expected_len(adu, n);
+
+	if (size == 0u) return (n < RTU_N_SIZE_MAX) ? 0u : SIZE_MAX;
+	if (size > MBADU_SIZE_MAX) return SIZE_MAX;
+
+	return size;
+}
+
+/**
+ * @brief Handle a Modbus RTU ADU, a CRC error means the stream lost its framing
+ */
+static size_t rtu_handle(struct mbinst_s *inst, const uint8_t *req, size_t req_len, uint8_t *res)
+{
+	uint16_t crc = mbcrc16(req, req_len);
+
+	if (crc != 0u) return SIZE_MAX;
+
+	return mbadu_handle_req_crc(inst, req, req_len, crc, res);
+}
+
+/**
+ * @brief Answer a Modbus RTU ADU with an MB_BUSY exception, broadcasts and other slaves get none
+ */
+static size_t rtu_busy(struct mbinst_s *inst, const uint8_t *req, size_t req_len, uint8_t *res)
+{
+	if (mbcrc16(req, req_len) != 0u) return SIZE_MAX;
+	if ((req[0]!=inst->serial.slave_addr) || mbatomic_load(&inst->state.is_listen_only)) return 0u;
+
+	res[0] = req[0];
+	res[1] = (uint8_t)(req[1] | MB_ERR_FLG);
+	res[2] = (uint8_t)MB_BUSY;
+	u16tole(mbcrc16(res, 3u), res+3u);
+
+	count_busy(inst, MBSTATS_TR_RTU, req_len, 5u);
+	return 5u;
+}
+
+static const struct framing_s s_rtu = {rtu_frame_size, rtu_handle, rtu_busy, MBADU_SIZE_MIN, MBADU_SIZE_MAX};
+
+extern void mbadu_stream_init(struct mbadu_stream_s *stream)
+{
+	if (stream==NULL) return;
+
+	stream->n = 0u;
+	stream->rate = NULL;
+}
+
+/**
+ * @brief Split received bytes into frames of one framing and handle them
+ */
+static enum mbadu_stream_status_e stream_proc(
+	const struct framing_s *f,
+	struct mbadu_stream_s *stream,
+	struct mbinst_s *inst,
+	const uint8_t *data,
+	size_t data_len,
+	size_t *n_consumed,
+	uint8_t *res,
+	size_t res_size,
+	size_t *res_len)
+{
+	size_t consumed, frame_size, n_copy, n_res;
+
+	if (n_consumed!=NULL) *n_consumed = 0u;
+	if (res_len!=NULL) *res_len = 0u;
+
+	if ((stream==NULL) || (inst==NULL) || (n_consumed==NULL)
+			|| (res==NULL) || (res_len==NULL)) {
+		return MBADU_STREAM_MALFORMED;
+	}
+	if ((data==NULL) && (data_len!=0u)) return MBADU_STREAM_MALFORMED;
+
+	consumed = 0u;
+
+	for (;;) {
+		if (stream->n == 0u) {
+			/* Nothing buffered, handle complete frames in place */
+			if (consumed == data_len) break;
+
+			frame_size = f->frame_size(data + consumed, data_len - consumed);
+			if (frame_size == SIZE_MAX) {
+				*n_consumed = consumed;
+				return MBADU_STREAM_MALFORMED;
+			}
+
+			if ((frame_size != 0u) && ((data_len - consumed) >= frame_size)) {
+				if ((res_size - *res_len) < f->res_max) {
+					*n_consumed = consumed;
+					return MBADU_STREAM_RES_FULL;
+				}
+
+				n_res = mbrate_take(stream->rate)
+					? f->handle(inst, data + consumed, frame_size, res + *res_len)
+					: f->busy(inst, data + consumed, frame_size, res + *res_len);
+				if (n_res == SIZE_MAX) {
+					*n_consumed = consumed;
+					return MBADU_STREAM_MALFORMED;
+				}
+				*res_len += n_res;
+				consumed += frame_size;
+				continue;
+			}
+
+			/* Trailing partial frame, always fits in the buffer */
+			n_copy = data_len - consumed;
+			buffer_append(stream, data + consumed, n_copy);
+			consumed += n_copy;
+			break;
+		}
+
+		/* Buffer until the size of the frame is known */
+		frame_size = f->frame_size(stream->buf, stream->n);
+		while (frame_size == 0u) {
+			n_copy = (stream->n < f->n_min) ? (f->n_min - stream->n) : 1u;
+			n_copy = min(n_copy, data_len - consumed);
+			if (n_copy == 0u) break;
+			buffer_append(stream, data + consumed, n_copy);
+			consumed += n_copy;
+			frame_size = f->frame_size(stream->buf, stream->n);
+		}
+		if (frame_size == 0u) break;
+		if (frame_size == SIZE_MAX) {
+			*n_consumed = consumed;
+			return MBADU_STREAM_MALFORMED;
+		}
+
+		/* Complete the buffered frame */
+		n_copy = min(frame_size - stream->n, data_len - consumed);
+		if (n_copy > 0u) {
+			buffer_append(stream, data + consumed, n_copy);
+			consumed += n_copy;
+		}
+		if (stream->n < frame_size) break;
+
+		if ((res_size - *res_len) < f->res_max) {
+			*n_consumed = consumed;
+			return MBADU_STREAM_RES_FULL;
+		}
+
+		n_res = mbrate_take(stream->rate)
+			? f->handle(inst, stream->buf, frame_size, res + *res_len)
+			: f->busy(inst, stream->buf, frame_size, res + *res_len);
+		if (n_res == SIZE_MAX) {
+			*n_consumed = consumed;
+			return MBADU_STREAM_MALFORMED;
+		}
+		*res_len += n_res;
+		stream->n = 0u;
+	}
+
+	*n_consumed = consumed;
+	return MBADU_STREAM_OK;
+}
+
+extern enum mbadu_stream_status_e mbadu_stream_tcp_proc(
+	struct mbadu_stream_s *stream,
+	struct mbinst_s *inst,
+	const uint8_t *data,
+	size_t data_len,
+	size_t *n_consumed,
+	uint8_t *res,
+	size_t res_size,
+	size_t *res_len)
+{
+	return stream_proc(&s_tcp, stream, inst, data, data_len, n_consumed, res, res_size, res_len);
+}
+
+extern enum mbadu_stream_status_e mbadu_stream_rtu_proc(
+	struct mbadu_stream_s *stream,
+	struct mbinst_s *inst,
+	const uint8_t *data,
+	size_t data_len,
+	size_t *n_consumed,
+	uint8_t *res,
+	size_t res_size,
+	size_t *res_len)
+{
+	return stream_proc(&s_rtu, stream, inst, data, data_len, n_consumed, res, res_size, res_len);
+}
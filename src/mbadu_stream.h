@@ -0,0 +1,150 @@
+/**
+ * @file mbadu_stream.h
+ * @brief Modbus ADU stream reassembly - Splits a byte stream into Modbus ADUs
+ * @author Jonas Almås
+ *
+ * @details This module reassembles Modbus TCP/IP ADUs from a byte stream.
+ * TCP does not preserve message boundaries, so one received segment may hold
+ * several pipelined requests, or only part of one. The stream object buffers
+ * partial frames in fixed storage, hands every complete ADU to
+ * mbadu_tcp_handle_req() and collects the responses in one contiguous output
+ * buffer, so they can be sent with a single call. RTU frames carried over
+ * TCP are split the same way with mbadu_stream_rtu_proc().
+ *
+ * @see mbadu_tcp.h for single frame handling
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBADU_STREAM_H_INCLUDED
+#define MBADU_STREAM_H_INCLUDED
+
+#include "mbadu_tcp.h"
+#include "mbinst.h"
+#include "mbrate.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Stream processing result
+ */
+enum mbadu_stream_status_e {
+	MBADU_STREAM_OK=0, /**< All input consumed, partial frames are buffered */
+	MBADU_STREAM_RES_FULL, /**< Response buffer full, send responses and call again with the remaining input */
+	MBADU_STREAM_MALFORMED, /**< Invalid framing, the connection should be closed */
+};
+
+/**
+ * @brief Per connection stream reassembly state
+ *
+ * @note Initialize with mbadu_stream_init() when the connection is opened
+ * @note Shall not be accessed by client code directly, except for setting rate
+ */
+struct mbadu_stream_s {
+	uint8_t buf[MBADU_TCP_SIZE_MAX]; /**< Partially received frame */
+	size_t n; /**< Number of bytes in buf */
+
+	/**
+	 * @brief Optional request rate limit of the connection, see mbrate_s
+	 *
+	 * Complete frames above the rate are answered with an MB_BUSY exception
+	 * response built from a template, without handing them to the instance.
+	 * The instance only counts them in mbinst_state_s::busy_counter and
+	 * mbinst_state_s::exception_counter.
+	 *
+	 * @note Can be left as NULL to handle every frame, cleared by mbadu_stream_init() so set it afterwards
+	 */
+	struct mbrate_s *rate;
+};
+
+/**
+ * @brief Initialize (or reset) stream reassembly state
+ *
+ * @param stream Stream state to initialize
+ */
+extern void mbadu_stream_init(struct mbadu_stream_s *stream);
+
+/**
+ * @brief Process received Modbus TCP/IP bytes
+ *
+ * Splits the received bytes into Modbus TCP/IP ADUs, handles every complete
+ * ADU and appends the responses to res. Bytes of an incomplete trailing frame
+ * are kept in the stream state until more data arrives. Complete frames are
+ * handled directly from data without copying.
+ *
+ * @param stream Stream state of the connection
+ * @param inst Pointer to the Modbus instance
+ * @param data Received bytes (Can be NULL if data_len is 0)
+ * @param data_len Number of received bytes
+ * @param n_consumed Out parameter with number of bytes consumed from data
+ * @param res Response buffer
+ * @param res_size Size of the response buffer (at least MBADU_TCP_SIZE_MAX bytes)
+ * @param res_len Out parameter with number of response bytes written to res
+ *
+ * @retval MBADU_STREAM_OK All data consumed
+ * @retval MBADU_STREAM_RES_FULL Not enough room for another response,
+ *         send res_len bytes and call again with data+n_consumed
+ * @retval MBADU_STREAM_MALFORMED Invalid MBAP header, state must be reset
+ *         with mbadu_stream_init() before reuse
+ *
+ * @note A response slot of MBADU_TCP_SIZE_MAX bytes must be free before each frame is handled
+ */
+extern enum mbadu_stream_status_e mbadu_stream_tcp_proc(
+	struct mbadu_stream_s *stream,
+	struct mbinst_s *inst,
+	const uint8_t *data,
+	size_t data_len,
+	size_t *n_consumed,
+	uint8_t *res,
+	size_t res_size,
+	size_t *res_len);
+
+/**
+ * @brief Process received Modbus RTU over TCP bytes
+ *
+ * Same as mbadu_stream_tcp_proc() for RTU frames (slave address, PDU and CRC)
+ * carried over a stream, as sent by gateways and masters using RTU over TCP
+ * encapsulation. Frame ends are found from the function code and byte counts
+ * (see mbadu_expected_len()) and responses are RTU frames.
+ *
+ * @retval MBADU_STREAM_OK All data consumed
+ * @retval MBADU_STREAM_RES_FULL Not enough room for another response,
+ *         send res_len bytes and call again with data+n_consumed
+ * @retval MBADU_STREAM_MALFORMED Function code without a known request size or
+ *         CRC error, the framing is lost and the connection should be closed
+ *
+ * @note A response slot of MBADU_SIZE_MAX bytes must be free before each frame is handled
+ */
+extern enum mbadu_stream_status_e mbadu_stream_rtu_proc(
+	struct mbadu_stream_s *stream,
+	struct mbinst_s *inst,
+	const uint8_t *data,
+	size_t data_len,
+	size_t *n_consumed,
+	uint8_t *res,
+	size_t res_size,
+	size_t *res_len);
+
+#endif /* MBADU_STREAM_H_INCLUDED */
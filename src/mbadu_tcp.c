@@ -38,10 +38,32 @@
 
 #include "mbadu_tcp.h"
 #include "endian.h"
+#include "mbinst.h"
+#include "mbstats.h"
+#include "mbtrace.h"
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
+/**
+ * @brief Add MBAP header to response PDU at res+MBAP_SIZE
+ */
+static size_t prep_res(
+	struct mbinst_s *inst,
+	uint16_t transaction_id,
+	uint8_t unit_id,
+	uint8_t *res,
+	size_t pdu_size)
+{
+	u16tobe(transaction_id, res + MBAP_POS_TRANS_ID);
+	u16tobe(MBADU_TCP_PROT_ID, res + MBAP_POS_PROT_ID);
+	u16tobe((uint16_t)(1u+pdu_size), res + MBAP_POS_LEN);
+	res[MBAP_POS_UNIT_ID] = unit_id;
+
+	mbstats_count_bytes(inst->stats, MBSTATS_TR_TCP, 0u, MBAP_SIZE + pdu_size);
+	return MBAP_SIZE + pdu_size;
+}
+
 extern size_t mbadu_tcp_handle_req(
 	struct mbinst_s *inst,
 	const uint8_t *req,
@@ -51,9 +73,13 @@ extern size_t mbadu_tcp_handle_req(
 	size_t pdu_size;
 	uint16_t transaction_id, protocol_id, length;
 	uint8_t unit_id;
+	int was_pending;
+	uint64_t t_trace;
 
 	if ((inst==NULL) || (req==NULL) || (res==NULL)) return 0u;
 
+	t_trace = mbtrace_now(inst->trace);
+	mbstats_count_bytes(inst->stats, MBSTATS_TR_TCP, req_len, 0u);
 	if (req_len<MBADU_TCP_SIZE_MIN || req_len>MBADU_TCP_SIZE_MAX) {
 		return 0u;
 	}
@@ -74,6 +100,9 @@ extern size_t mbadu_tcp_handle_req(
 		return 0u;
 	}
 
+	mbtrace_emit(inst->trace, MBTRACE_EV_ADU, req[MBAP_SIZE], unit_id, t_trace);
+
+	was_pending = inst->state.pending.is_active;
 	pdu_size = mbpdu_handle_req(
 		inst,
 		req + MBAP_SIZE,
@@ -81,14 +110,52 @@ extern size_t mbadu_tcp_handle_req(
 		res + MBAP_SIZE);
 
 	if (pdu_size==0u) {
+		if (!was_pending && inst->state.pending.is_active) {
+			/* Keep the MBAP fields for mbadu_tcp_complete() */
+			inst->state.pending.transaction_id = transaction_id;
+			inst->state.pending.unit_id = unit_id;
+		}
 		return 0u;
 	}
 
-	/* Build response MBAP */
-	u16tobe(transaction_id, res + MBAP_POS_TRANS_ID);
-	u16tobe(protocol_id, res + MBAP_POS_PROT_ID);
-	u16tobe((uint16_t)(1u+pdu_size), res + MBAP_POS_LEN);
-	res[MBAP_POS_UNIT_ID] = unit_id;
+	return prep_res(inst, transaction_id, unit_id, res, pdu_size);
+}
 
-	return MBAP_SIZE + pdu_size;
+extern size_t mbadu_tcp_complete(
+	struct mbinst_s *inst,
+	enum mbstatus_e status,
+	const uint8_t *data,
+	size_t data_len,
+	uint8_t *res)
+{
+	uint16_t transaction_id;
+	uint8_t unit_id;
+	size_t pdu_size;
+
+	if ((inst==NULL) || (res==NULL)) return 0u;
+
+	transaction_id = inst->state.pending.transaction_id;
+	unit_id = inst->state.pending.unit_id;
+
+	pdu_size = mbpdu_complete(inst, status, data, data_len, res + MBAP_SIZE);
+	if (pdu_size==0u) {
+		mbatomic_inc(&inst->state.no_resp_counter);
+		return 0u;
+	}
+
+	return prep_res(inst, transaction_id, unit_id, res, pdu_size);
+}
+
+extern size_t mbadu_tcp_handle_req_buf(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbadu_buf_s *res)
+{
+	uint8_t *adu;
+
+	if ((adu=mbadu_buf_reserve(res, MBADU_TCP_SIZE_MAX))==NULL) return 0u;
+
+	res->len = mbadu_tcp_handle_req(inst, req, req_len, adu);
+	return res->len;
 }
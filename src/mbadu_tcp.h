@@ -7,6 +7,9 @@
  * It wraps the Protocol Data Unit (PDU) with the Modbus Application Protocol
  * (MBAP) header for use in Modbus TCP/IP communications.
  *
+ * Modbus UDP uses the same MBAP framing with exactly one ADU per datagram, a
+ * received datagram can be passed to mbadu_tcp_handle_req() as is.
+ *
  * @see mbpdu.h for the underlying PDU implementation
  */
 
@@ -37,6 +40,7 @@
 #ifndef MBADU_TCP_H_INCLUDED
 #define MBADU_TCP_H_INCLUDED
 
+#include "mbadu.h"
 #include "mbpdu.h"
 #include <stddef.h>
 #include <stdint.h>
@@ -76,6 +80,7 @@ enum {
 };
 
 enum {MBTCP_PORT=502u};
+enum {MBTCP_SECURE_PORT=802u}; /**< Modbus/TCP Security (TLS) */
 
 /**
  * @brief Handle Modbus TCP/IP ADU request
@@ -104,4 +109,44 @@ extern size_t mbadu_tcp_handle_req(
 	size_t req_len,
 	uint8_t *res);
 
+/**
+ * @brief Complete a deferred Modbus TCP/IP request
+ *
+ * Builds the MBAP framed response of the request for which a handler returned
+ * MB_PENDING, see mbpdu_complete().
+ *
+ * @param inst Pointer to the Modbus instance with a pending request
+ * @param status Final status of the request (MB_OK or exception code)
+ * @param data Response data following the function code (NULL to echo the request)
+ * @param data_len Length of data in bytes
+ * @param res Pointer to response buffer (must be at least MBADU_TCP_SIZE_MAX bytes)
+ *
+ * @return Size of response ADU in bytes, or 0 if no response should be sent
+ */
+extern size_t mbadu_tcp_complete(
+	struct mbinst_s *inst,
+	enum mbstatus_e status,
+	const uint8_t *data,
+	size_t data_len,
+	uint8_t *res);
+
+/**
+ * @brief Handle Modbus TCP/IP ADU request into a port owned response buffer
+ *
+ * Same as mbadu_tcp_handle_req(), but the response ADU is built directly at res->p+res->head,
+ * e.g. inside a DMA or socket buffer with headroom for port framing.
+ *
+ * @param inst Pointer to the Modbus instance containing coil/register maps and configuration
+ * @param req Pointer to received ADU data
+ * @param req_len Size of received ADU data in bytes
+ * @param res Response buffer, at least MBADU_TCP_SIZE_MAX bytes must be available after head
+ *
+ * @return Size of response data in bytes (also stored in res->len), or 0 if no response should be sent
+ */
+extern size_t mbadu_tcp_handle_req_buf(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbadu_buf_s *res);
+
 #endif /* MBADU_TCP_H_INCLUDED */
@@ -0,0 +1,65 @@
+/**
+ * @file mbarena.c
+ * @brief Modbus Scratch Arena - Per-request bump allocation for handler temporaries
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbarena.h"
+#include <stddef.h>
+#include <stdint.h>
+
+extern void mbarena_init(struct mbarena_s *arena)
+{
+	if (arena==NULL) return;
+
+	arena->used = 0u;
+	arena->peak = 0u;
+}
+
+extern void mbarena_reset(struct mbarena_s *arena)
+{
+	if (arena==NULL) return;
+
+	arena->used = 0u;
+}
+
+extern void *mbarena_alloc(struct mbarena_s *arena, size_t size)
+{
+	size_t offs;
+
+	if ((arena==NULL) || (arena->buf==NULL)) return NULL;
+
+	offs = (arena->used + (MBARENA_ALIGN - 1u)) & ~(size_t)(MBARENA_ALIGN - 1u);
+	if ((offs > arena->size) || (size > (arena->size - offs))) return NULL;
+
+	arena->used = offs + size;
+	if (arena->used > arena->peak) {
+		arena->peak = arena->used;
+	}
+
+	return arena->buf + offs;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file mbarena.h
+ * @brief Modbus Scratch Arena - Per-request bump allocation for handler temporaries
+ * @author Jonas Almås
+ *
+ * @details Scratch memory for handler temporaries, such as the descriptors
+ * found while validating a write. The application supplies one buffer per
+ * instance, allocations bump a position and are all released when the next
+ * request starts. Handlers use their stack-free fallback when no arena is set
+ * or it is exhausted, so the worst case stack use does not depend on the
+ * request.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBARENA_H_INCLUDED
+#define MBARENA_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+enum {MBARENA_ALIGN = alignof(max_align_t)}; /**< Alignment of each allocation */
+#else
+enum {MBARENA_ALIGN = _Alignof(max_align_t)}; /**< Alignment of each allocation */
+#endif
+
+/**
+ * @brief Scratch arena of an instance
+ *
+ * @note Configuration fields are set by the application, the others are cleared by mbarena_init()
+ * @note Mutable, each instance (and worker) needs an arena of its own
+ */
+struct mbarena_s {
+	uint8_t *buf; /**< Caller supplied memory, aligned to MBARENA_ALIGN */
+	size_t size; /**< Size of buf in bytes */
+
+	size_t used; /**< Bytes allocated by the current request */
+	size_t peak; /**< Most bytes allocated by one request, to size buf */
+};
+
+/**
+ * @brief Initialize an arena as empty
+ *
+ * @param arena Arena with configuration fields set
+ */
+extern void mbarena_init(struct mbarena_s *arena);
+
+/**
+ * @brief Release all allocations
+ *
+ * @param arena Arena (Can be NULL)
+ *
+ * @note Called by the library when a request starts
+ */
+extern void mbarena_reset(struct mbarena_s *arena);
+
+/**
+ * @brief Allocate scratch memory until the next reset
+ *
+ * @param arena Arena (Can be NULL)
+ * @param size Bytes to allocate
+ *
+ * @return Memory aligned to MBARENA_ALIGN, or NULL without an arena or when it is exhausted
+ */
+extern void *mbarena_alloc(struct mbarena_s *arena, size_t size);
+
+#endif /* MBARENA_H_INCLUDED */
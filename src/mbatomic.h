@@ -0,0 +1,94 @@
+/**
+ * @file mbatomic.h
+ * @brief Modbus Atomic State - Relaxed atomic access to mbinst_state_s
+ * @author Jonas Almås
+ *
+ * @details With MBCFG_ATOMIC_STATE the counters, flags and event log position
+ * of mbinst_state_s are C11 atomics updated with relaxed ordering, so one
+ * instance can handle requests from several threads at once. Without it the
+ * macros are plain accesses and compile to the same code as before.
+ *
+ * @note Internal header, the library accesses the state only through these macros
+ */
+
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+#ifndef MBATOMIC_H_INCLUDED
+#define MBATOMIC_H_INCLUDED
+
+#include "mbconfig.h"
+#include <stdint.h>
+
+#if MBCFG_ATOMIC_STATE && !defined(__cplusplus)
+
+#if defined(__STDC_NO_ATOMICS__)
+#error "MBCFG_ATOMIC_STATE requires a compiler with C11 atomics"
+#endif
+
+#include <stdatomic.h>
+
+/** @brief Type of a state member shared between threads */
+#define MBATOMIC(type) _Atomic(type)
+
+/* C++ sees the plain types, the atomics must share their layout */
+_Static_assert(sizeof(_Atomic(uint8_t))==sizeof(uint8_t), "Atomic uint8_t differs in size");
+_Static_assert(sizeof(_Atomic(uint16_t))==sizeof(uint16_t), "Atomic uint16_t differs in size");
+
+#define mbatomic_load(p) atomic_load_explicit((p), memory_order_relaxed)
+#define mbatomic_store(p, v) atomic_store_explicit((p), (v), memory_order_relaxed)
+#define mbatomic_inc(p) ((void)atomic_fetch_add_explicit((p), 1u, memory_order_relaxed))
+#define mbatomic_fetch_inc(p) atomic_fetch_add_explicit((p), 1u, memory_order_relaxed)
+
+#else
+
+/** @brief Type of a state member shared between threads */
+#define MBATOMIC(type) type
+
+#define mbatomic_load(p) (*(p))
+#define mbatomic_store(p, v) ((void)(*(p) = (v)))
+#define mbatomic_inc(p) ((void)++*(p))
+#define mbatomic_fetch_inc(p) ((*(p))++)
+
+#endif
+
+#if !defined(__cplusplus)
+/**
+ * @brief Full memory fence of the lock free modules, only for internal use
+ *
+ * Orders the stores and loads publishing data between a writer and its
+ * readers (mbseqlock, mbimage, mbfifo, mbswap, mbtrace and mbshm).
+ *
+ * @note Without C11 atomics only the order between volatile accesses is
+ *       kept, which is sufficient on a single core (e.g. an ISR as writer)
+ */
+#if defined(__STDC_NO_ATOMICS__)
+#define MBATOMIC_FENCE() ((void)0)
+#else
+#include <stdatomic.h>
+#define MBATOMIC_FENCE() atomic_thread_fence(memory_order_seq_cst)
+#endif
+#endif
+
+#endif /* MBATOMIC_H_INCLUDED */
@@ -0,0 +1,182 @@
+/**
+ * @file mbcache.c
+ * @brief Modbus Response Cache - Cached responses of repeated read requests
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbcache.h"
+#include "endian.h"
+#include "mbdef.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {READ_REQ_SIZE=5u}; /* Function code, start address and quantity */
+
+/**
+ * @brief Whether a request is a read whose response can be cached
+ */
+static int is_cacheable(const uint8_t *req, size_t req_len)
+{
+	if (req_len!=READ_REQ_SIZE) return 0;
+
+	switch (req[0]) {
+	case MBFC_READ_COILS:
+	case MBFC_READ_DISC_INPUTS:
+	case MBFC_READ_HOLDING_REGS:
+	case MBFC_READ_INPUT_REGS:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+extern int mbcache_is_write(uint8_t fc)
+{
+	switch (fc) {
+	case MBFC_WRITE_SINGLE_COIL:
+	case MBFC_WRITE_SINGLE_REG:
+	case MBFC_WRITE_MULTIPLE_COILS:
+	case MBFC_WRITE_MULTIPLE_REGS:
+	case MBFC_WRITE_FILE_RECORD:
+	case MBFC_MASK_WRITE_REG:
+	case MBFC_READ_WRITE_REGS:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief Whether an entry holds a response that may still be used
+ */
+static int is_fresh(const struct mbcache_s *cache, const struct mbcache_entry_s *entry)
+{
+	if ((entry->len==0u) || (entry->epoch!=cache->epoch)) return 0;
+	if ((cache->clock_cb!=NULL) && (cache->max_age_ticks!=0u)) {
+		return (cache->clock_cb() - entry->stored_at) < cache->max_age_ticks;
+	}
+	return 1;
+}
+
+extern void mbcache_init(struct mbcache_s *cache)
+{
+	size_t i;
+
+	if (cache==NULL) return;
+
+	if (cache->entries==NULL) cache->n_entries = 0u;
+	for (i=0u; i<cache->n_entries; ++i) {
+		cache->entries[i].len = 0u;
+	}
+	cache->epoch = 0u;
+	cache->next = 0u;
+	cache->n_hits = 0u;
+	cache->n_misses = 0u;
+}
+
+extern void mbcache_invalidate(struct mbcache_s *cache)
+{
+	if (cache==NULL) return;
+	++cache->epoch;
+}
+
+extern size_t mbcache_lookup(
+	struct mbcache_s *cache,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *res)
+{
+	const struct mbcache_entry_s *entry;
+	uint16_t start, n;
+	size_t i;
+
+	if ((cache==NULL) || (req==NULL) || (res==NULL)) return 0u;
+	if (!is_cacheable(req, req_len)) return 0u;
+
+	start = betou16(req+1u);
+	n = betou16(req+3u);
+	for (i=0u; i<cache->n_entries; ++i) {
+		entry = &cache->entries[i];
+		if ((entry->fc==req[0])
+				&& (entry->start==start)
+				&& (entry->n==n)
+				&& is_fresh(cache, entry)) {
+			(void)memcpy(res, entry->res, entry->len);
+			++cache->n_hits;
+			return entry->len;
+		}
+	}
+
+	++cache->n_misses;
+	return 0u;
+}
+
+extern void mbcache_store(
+	struct mbcache_s *cache,
+	const uint8_t *req,
+	size_t req_len,
+	const uint8_t *res,
+	size_t res_len,
+	enum mbstatus_e status)
+{
+	struct mbcache_entry_s *entry;
+	uint16_t start, n;
+	size_t i;
+
+	if ((cache==NULL) || (req==NULL) || (req_len==0u)) return;
+
+	/* Also when failed, a multiple write might have been applied in part */
+	if (mbcache_is_write(req[0])) {
+		mbcache_invalidate(cache);
+		return;
+	}
+
+	if ((status!=MB_OK) || (res==NULL) || (res_len==0u) || (res_len>MBPDU_SIZE_MAX)) return;
+	if ((cache->n_entries==0u) || !is_cacheable(req, req_len)) return;
+
+	/* Refresh a stale entry of the same request before replacing others */
+	start = betou16(req+1u);
+	n = betou16(req+3u);
+	for (i=0u; i<cache->n_entries; ++i) {
+		entry = &cache->entries[i];
+		if ((entry->len!=0u) && (entry->fc==req[0]) && (entry->start==start) && (entry->n==n)) break;
+	}
+	if (i==cache->n_entries) {
+		if (cache->next>=cache->n_entries) cache->next = 0u;
+		entry = &cache->entries[cache->next];
+		++cache->next;
+	}
+
+	entry->fc = req[0];
+	entry->start = start;
+	entry->n = n;
+	entry->epoch = cache->epoch;
+	entry->stored_at = (cache->clock_cb!=NULL) ? cache->clock_cb() : 0u;
+	(void)memcpy(entry->res, res, res_len);
+	entry->len = (uint8_t)res_len;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file mbcache.h
+ * @brief Modbus Response Cache - Cached responses of repeated read requests
+ * @author Jonas Almås
+ *
+ * @details Optional cache of read responses (function codes 0x01 to 0x04) keyed
+ * by function code, start address and quantity. A repeated read is answered by
+ * copying the stored response instead of reading the descriptors again. Entries
+ * are dropped by write requests, by mbcache_invalidate() when the application
+ * updated its data, and optionally after a maximum age.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+#ifndef MBCACHE_H_INCLUDED
+#define MBCACHE_H_INCLUDED
+
+#include "mbpdu.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief One cached read response
+ *
+ * @note Shall not be accessed by client code directly
+ */
+struct mbcache_entry_s {
+	uint8_t fc; /**< Function code of the request */
+	uint8_t len; /**< Size of res in bytes, 0 if the entry is empty */
+	uint16_t start; /**< Start address of the request */
+	uint16_t n; /**< Quantity of the request */
+	uint32_t epoch; /**< Value of mbcache_s::epoch when stored */
+	uint64_t stored_at; /**< Time stored, in clock_cb units */
+	uint8_t res[MBPDU_SIZE_MAX]; /**< Response PDU */
+};
+
+/**
+ * @brief Response cache of one instance
+ *
+ * Attached to an instance through mbinst_s::cache. Only successful responses
+ * are stored, a full cache replaces its entries in round robin order. Write
+ * requests (function codes 0x05, 0x06, 0x0F, 0x10, 0x15, 0x16 and 0x17) drop
+ * all entries, as a write may change other addresses through callbacks.
+ *
+ * @note Configuration fields are set by the application, the remaining
+ *       fields are state cleared by mbcache_init()
+ * @note Values changed by the application or read through callbacks are only
+ *       seen once mbcache_invalidate() is called or max_age_ticks elapsed
+ * @note Reads covering a descriptor with rlock_cb are never stored, so a lock
+ *       is consulted on every such read. Locks and policies changed without
+ *       a rlock_cb (E.g. by swapping maps) need mbcache_invalidate()
+ * @note Not thread safe, invalidate from the thread handling requests or lock around both
+ */
+struct mbcache_s {
+	struct mbcache_entry_s *entries; /**< Caller supplied storage */
+	size_t n_entries; /**< Number of entries */
+
+	/**
+	 * @brief Monotonic clock used for the maximum age
+	 *
+	 * @note Can be left as NULL, entries then live until invalidated
+	 */
+	uint64_t (*clock_cb)(void);
+
+	uint64_t max_age_ticks; /**< Drop entries older than this, 0 to disable */
+
+	uint32_t epoch; /**< Entries stored before the last invalidation are stale */
+	size_t next; /**< Entry replaced by the next store */
+	uint32_t n_hits; /**< Requests answered from the cache */
+	uint32_t n_misses; /**< Cacheable requests that were handled */
+};
+
+/**
+ * @brief Empty the cache, the configuration is kept
+ *
+ * @param cache Cache to initialize (entries and n_entries set)
+ */
+extern void mbcache_init(struct mbcache_s *cache);
+
+/**
+ * @brief Drop all cached responses, e.g. after the application updated its data
+ *
+ * @param cache Cache (Can be NULL)
+ */
+extern void mbcache_invalidate(struct mbcache_s *cache);
+
+/**
+ * @brief Whether a function code may change data, dropping cached values
+ *
+ * @param fc Function code
+ *
+ * @retval 1 Write request (0x05, 0x06, 0x0F, 0x10, 0x15, 0x16 or 0x17)
+ * @retval 0 Otherwise
+ */
+extern int mbcache_is_write(uint8_t fc);
+
+/**
+ * @brief Copy the cached response of a read request
+ *
+ * @param cache Cache (Can be NULL)
+ * @param req Request PDU
+ * @param req_len Size of request in bytes
+ * @param res Response PDU buffer, at least MBPDU_SIZE_MAX bytes
+ *
+ * @return Size of the response copied to res, 0 if not cached
+ *
+ * @note Called by the library while handling requests
+ */
+extern size_t mbcache_lookup(
+	struct mbcache_s *cache,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *res);
+
+/**
+ * @brief Store the response of a handled request
+ *
+ * Stores successful read responses and drops all entries on write requests.
+ *
+ * @param cache Cache (Can be NULL)
+ * @param req Request PDU
+ * @param req_len Size of request in bytes
+ * @param res Response PDU
+ * @param res_len Size of response in bytes
+ * @param status Status the request was handled with
+ *
+ * @note Called by the library while handling requests
+ */
+extern void mbcache_store(
+	struct mbcache_s *cache,
+	const uint8_t *req,
+	size_t req_len,
+	const uint8_t *res,
+	size_t res_len,
+	enum mbstatus_e status);
+
+#endif /* MBCACHE_H_INCLUDED */
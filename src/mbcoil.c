@@ -37,9 +37,205 @@
  */
 
 #include "mbcoil.h"
+#include "mbpage.h"
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
-enum {BSEARCH_THRESHOLD=16u};
+enum {
+	BSEARCH_THRESHOLD=16u,
+	BULK_CHUNK_SIZE=32u, /* Bytes of scratch for bulk callbacks at unaligned bit offsets */
+};
+
+/**
+ * @brief Get number of addresses covered by a descriptor
+ */
+static size_t coil_span(const struct mbcoil_desc_s *coil)
+{
+	return (coil->n_block_entries > 1u) ? coil->n_block_entries : 1u;
+}
+
+/**
+ * @brief Check if a descriptor covers addresses after addr only
+ */
+static int coil_after(const struct mbcoil_desc_s *coil, uint16_t addr)
+{
+	return coil->address > addr;
+}
+
+/**
+ * @brief Check if a descriptor covers addresses before addr only
+ */
+static int coil_before(const struct mbcoil_desc_s *coil, uint16_t addr)
+{
+	return ((size_t)coil->address + coil_span(coil)) <= (size_t)addr;
+}
+
+/**
+ * @brief Get k (<= 8) bits starting at a bit offset of a packed bitmap
+ */
+static uint8_t get_bits(const volatile uint8_t *p, size_t bit, size_t k)
+{
+	size_t offs = bit % 8u;
+	unsigned v;
+
+	v = (unsigned)p[bit/8u] >> offs;
+	if ((offs + k) > 8u) {
+		v |= (unsigned)p[(bit/8u)+1u] << (8u-offs);
+	}
+
+	return (uint8_t)(v & ((1u<<k)-1u));
+}
+
+/**
+ * @brief OR n bits of src starting at src_bit into dst starting at dst_bit
+ */
+static void or_bits(uint8_t *dst, size_t dst_bit, const volatile uint8_t *src, size_t src_bit, size_t n)
+{
+	size_t k;
+
+	/* Up to one destination byte per step */
+	while (n > 0u) {
+		k = 8u - (dst_bit%8u);
+		if (k > n) k = n;
+
+		dst[dst_bit/8u] |= (uint8_t)(get_bits(src, src_bit, k) << (dst_bit%8u));
+
+		src_bit += k;
+		dst_bit += k;
+		n -= k;
+	}
+}
+
+/**
+ * @brief Replace n bits of dst starting at dst_bit with bits of src starting at src_bit
+ */
+static void put_bits(volatile uint8_t *dst, size_t dst_bit, const uint8_t *src, size_t src_bit, size_t n)
+{
+	size_t k;
+	uint8_t mask;
+
+	/* Up to one destination byte per step, preserving other bits */
+	while (n > 0u) {
+		k = 8u - (dst_bit%8u);
+		if (k > n) k = n;
+
+		mask = (uint8_t)(((1u<<k)-1u) << (dst_bit%8u));
+		dst[dst_bit/8u] = (uint8_t)((dst[dst_bit/8u] & (uint8_t)~mask)
+			| ((unsigned)get_bits(src, src_bit, k) << (dst_bit%8u)));
+
+		src_bit += k;
+		dst_bit += k;
+		n -= k;
+	}
+}
+
+/**
+ * @brief Get number of coils from addr to the end of a descriptor, limited to n_max
+ *
+ * @return Number of coils, 0 if addr is not inside the descriptor
+ */
+static size_t coil_remaining(const struct mbcoil_desc_s *coil, uint16_t addr, size_t n_max)
+{
+	size_t n;
+
+	if ((addr < coil->address) || coil_before(coil, addr)) return 0u;
+
+	n = coil_span(coil) - (size_t)(addr - coil->address);
+	return (n > n_max) ? n_max : n;
+}
+
+/**
+ * @brief Check if a descriptor is handled by the multi coil paths
+ */
+static int is_multi(const struct mbcoil_desc_s *coil)
+{
+	return (coil->n_block_entries > 1u)
+		|| ((coil->access & (MCACC_R_BULK|MCACC_W_BULK)) != 0u);
+}
+
+/**
+ * @brief Get number of single pointer coils at the cursor sharing the byte of the first, limited to n_max
+ *
+ * @return Length of the run, 0 if the descriptor at pos can not start one
+ */
+static size_t ptr_run(const struct mbcoil_cursor_s *cur, uint16_t addr, size_t n_max)
+{
+	const struct mbcoil_desc_s *first = cur->coils + cur->pos;
+	const struct mbcoil_desc_s *coil;
+	size_t n, n_avail;
+
+	if ((first->write.ptr==NULL) || (first->write.ix>7u)) return 0u;
+
+	n_avail = 8u - first->write.ix;
+	if (n_avail > n_max) n_avail = n_max;
+	if (n_avail > (cur->n_coils - cur->pos)) n_avail = cur->n_coils - cur->pos;
+
+	for (n=0u; n<n_avail; ++n) {
+		coil = first + n;
+		if (is_multi(coil)
+				|| ((coil->access & MCACC_W_MASK) != MCACC_W_PTR)
+				|| (coil->post_write_cb!=NULL)
+				|| (coil->address != (uint16_t)(addr + n))
+				|| (coil->write.ptr != first->write.ptr)
+				|| ((size_t)coil->write.ix != ((size_t)first->write.ix + n))) {
+			break;
+		}
+	}
+
+	return n;
+}
+
+/**
+ * @brief Check the access configuration of one descriptor
+ */
+static int coil_ok(const struct mbcoil_desc_s *coil)
+{
+	const int is_block = coil->n_block_entries > 1u;
+
+	if (coil->access==0) return 0;
+
+	switch (coil->access & MCACC_R_MASK) {
+	case 0: break;
+	case MCACC_R_VAL: if (is_block) return 0; break;
+	case MCACC_R_PTR: if ((coil->read.ptr==NULL) || (coil->read.ix > 7u)) return 0; break;
+	case MCACC_R_FN: if (is_block || (coil->read.fn==NULL)) return 0; break;
+	case MCACC_R_BULK: if (coil->read.bulk==NULL) return 0; break;
+	default: return 0; /* One access method per direction */
+	}
+
+	switch (coil->access & MCACC_W_MASK) {
+	case 0: break;
+	case MCACC_W_PTR: if ((coil->write.ptr==NULL) || (coil->write.ix > 7u)) return 0; break;
+	case MCACC_W_FN: if (is_block || (coil->write.fn==NULL)) return 0; break;
+	case MCACC_W_BULK: if (coil->write.bulk==NULL) return 0; break;
+	default: return 0;
+	}
+
+	return 1;
+}
+
+extern int mbcoil_validate(
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils,
+	uint16_t *issue_addr)
+{
+	size_t i, prev_end, end;
+
+	if ((coils==NULL) || (n_coils==0u)) return 1;
+
+	prev_end = 0u;
+	for (i=0u; i<n_coils; ++i) {
+		end = (size_t)coils[i].address + coil_span(coils+i);
+		if (((i > 0u) && (coils[i].address < prev_end)) || (end > 0x10000u) || !coil_ok(coils+i)) {
+			if (issue_addr!=NULL) *issue_addr = coils[i].address;
+			return 0;
+		}
+		prev_end = end;
+	}
+
+	return 1;
+}
 
 extern const struct mbcoil_desc_s *mbcoil_find_desc(
 	const struct mbcoil_desc_s *coils,
@@ -60,9 +256,9 @@ extern const struct mbcoil_desc_s *mbcoil_find_desc(
 			m = l + (r - l) / 2u;
 			coil = coils + m;
 
-			if (coil->address < addr) {
+			if (coil_before(coil, addr)) {
 				l = m + 1u;
-			} else if (coil->address > addr) {
+			} else if (coil_after(coil, addr)) {
 				if (m == 0u) { /* Prevent underflow */
 					break;
 				}
@@ -74,7 +270,7 @@ extern const struct mbcoil_desc_s *mbcoil_find_desc(
 	} else {
 		for (i=0u; i<n_coils; ++i) {
 			coil = coils + i;
-			if (coil->address == addr) {
+			if (!coil_before(coil, addr) && !coil_after(coil, addr)) {
 				return coil;
 			}
 		}
@@ -83,6 +279,137 @@ extern const struct mbcoil_desc_s *mbcoil_find_desc(
 	return NULL;
 }
 
+/**
+ * @brief Addresses covered by a descriptor of a coil map, see mbpage_build()
+ */
+static size_t coil_keys(const void *map, size_t i, uint16_t *first)
+{
+	const struct mbcoil_desc_s *coil = (const struct mbcoil_desc_s *)map + i;
+
+	*first = coil->address;
+	return coil_span(coil);
+}
+
+extern size_t mbcoil_index_size(
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils)
+{
+	return mbpage_size(coils, n_coils, coil_keys);
+}
+
+extern int mbcoil_index_build(
+	struct mbcoil_index_s *ix,
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils,
+	uint16_t *storage,
+	size_t storage_len)
+{
+	if (ix==NULL) return 0;
+
+	ix->coils = NULL;
+	ix->n_coils = 0u;
+
+	if (!coils || (n_coils==0u)) {
+		ix->pages.dir = NULL;
+		ix->pages.leaves = NULL;
+		return 0;
+	}
+	if (!mbpage_build(&ix->pages, coils, n_coils, coil_keys, storage, storage_len)) return 0;
+
+	ix->coils = coils;
+	ix->n_coils = n_coils;
+
+	return 1;
+}
+
+extern const struct mbcoil_desc_s *mbcoil_index_find(
+	const struct mbcoil_index_s *ix,
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils,
+	uint16_t addr)
+{
+	uint16_t pos;
+
+	if ((ix==NULL) || (ix->pages.dir==NULL) || (ix->coils!=coils) || (ix->n_coils!=n_coils)) {
+		return mbcoil_find_desc(coils, n_coils, addr);
+	}
+
+	pos = mbpage_find(&ix->pages, addr);
+	return (pos!=0u) ? (coils + (pos - 1u)) : NULL;
+}
+
+extern void mbcoil_cursor_init(
+	struct mbcoil_cursor_s *cur,
+	const struct mbcoil_index_s *ix,
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils,
+	uint16_t addr)
+{
+	const struct mbcoil_desc_s *coil;
+	size_t l, m, r;
+
+	if (cur==NULL) return;
+
+	cur->coils = coils;
+	cur->n_coils = (coils!=NULL) ? n_coils : 0u;
+	cur->pos = 0u;
+
+	if (cur->n_coils==0u) return;
+
+	if ((ix!=NULL) && ((coil = mbcoil_index_find(ix, coils, n_coils, addr)) != NULL)) {
+		cur->pos = (size_t)(coil - coils);
+		return;
+	}
+
+	/* Find first descriptor not before addr */
+	l = 0u;
+	r = cur->n_coils;
+	while (l < r) {
+		m = l + (r - l) / 2u;
+		if (coil_before(coils + m, addr)) {
+			l = m + 1u;
+		} else {
+			r = m;
+		}
+	}
+
+	cur->pos = l;
+}
+
+extern const struct mbcoil_desc_s *mbcoil_cursor_find(
+	struct mbcoil_cursor_s *cur,
+	uint16_t addr)
+{
+	if (cur==NULL) return NULL;
+
+	while ((cur->pos < cur->n_coils) && coil_before(cur->coils + cur->pos, addr)) {
+		++cur->pos;
+	}
+
+	if ((cur->pos < cur->n_coils) && !coil_after(cur->coils + cur->pos, addr)) {
+		return cur->coils + cur->pos;
+	}
+
+	return NULL;
+}
+
+extern size_t mbcoil_cursor_gap(
+	const struct mbcoil_cursor_s *cur,
+	uint16_t addr,
+	size_t n_max)
+{
+	size_t n;
+
+	if (cur==NULL) return n_max;
+
+	/* The cursor rests on the first descriptor not before addr */
+	if (cur->pos >= cur->n_coils) return n_max;
+	if (!coil_after(cur->coils + cur->pos, addr)) return 0u;
+
+	n = (size_t)(cur->coils[cur->pos].address - addr);
+	return (n < n_max) ? n : n_max;
+}
+
 extern int mbcoil_read(const struct mbcoil_desc_s *coil)
 {
 	if (!coil) return MBCOIL_READ_DEV_FAIL;
@@ -108,6 +435,77 @@ extern int mbcoil_read(const struct mbcoil_desc_s *coil)
 	}
 }
 
+extern enum mbstatus_e mbcoil_read_bits(
+	const struct mbcoil_desc_s *coil,
+	uint16_t addr,
+	size_t n_max,
+	uint8_t *dst,
+	size_t dst_bit,
+	size_t *n_read)
+{
+	uint8_t chunk[BULK_CHUNK_SIZE];
+	enum mbstatus_e status;
+	size_t n, k;
+	int val;
+
+	if ((coil==NULL) || (dst==NULL) || (n_read==NULL) || (n_max==0u)) return MB_DEV_FAIL;
+	*n_read = 0u;
+
+	if (!is_multi(coil)) {
+		val = mbcoil_read(coil);
+		switch (val) {
+		case MBCOIL_READ_OFF: break;
+		case MBCOIL_READ_ON:
+			dst[dst_bit/8u] |= (uint8_t)(1u << (dst_bit%8u));
+			break;
+		case MBCOIL_READ_LOCKED: return MB_ILLEGAL_DATA_ADDR;
+		case MBCOIL_READ_NO_ACCESS: break; /* Leave coils without read access as 0 */
+		default: return MB_DEV_FAIL;
+		}
+		*n_read = 1u;
+		return MB_OK;
+	}
+
+	if ((n = coil_remaining(coil, addr, n_max)) == 0u) return MB_DEV_FAIL;
+
+	if ((coil->rlock_cb!=NULL) && coil->rlock_cb()) {
+		return MB_ILLEGAL_DATA_ADDR;
+	}
+
+	switch (coil->access & MCACC_R_MASK) {
+	case MCACC_R_PTR:
+		if (coil->read.ptr==NULL) return MB_DEV_FAIL;
+		or_bits(dst, dst_bit, coil->read.ptr,
+			(size_t)coil->read.ix + (size_t)(addr - coil->address), n);
+		break;
+	case MCACC_R_BULK:
+		if (coil->read.bulk==NULL) return MB_DEV_FAIL;
+		if ((dst_bit%8u) == 0u) {
+			/* Byte aligned, the callback fills the destination directly */
+			status = coil->read.bulk(addr, n, dst + (dst_bit/8u));
+			if (status!=MB_OK) return status;
+		} else {
+			for (k=0u; k<n; k+=BULK_CHUNK_SIZE*8u) {
+				size_t n_chunk = n-k;
+				if (n_chunk > (BULK_CHUNK_SIZE*8u)) n_chunk = BULK_CHUNK_SIZE*8u;
+
+				(void)memset(chunk, 0, sizeof chunk);
+				status = coil->read.bulk((uint16_t)(addr+k), n_chunk, chunk);
+				if (status!=MB_OK) return status;
+				or_bits(dst, dst_bit+k, chunk, 0u, n_chunk);
+			}
+		}
+		break;
+	case 0:
+		break; /* Leave coils without read access as 0 */
+	default:
+		return MB_DEV_FAIL;
+	}
+
+	*n_read = n;
+	return MB_OK;
+}
+
 extern int mbcoil_write_allowed(const struct mbcoil_desc_s *coil)
 {
 	if (!coil) return 0;
@@ -145,3 +543,101 @@ extern enum mbstatus_e mbcoil_write(const struct mbcoil_desc_s *coil, uint8_t va
 		return MB_DEV_FAIL;
 	}
 }
+
+extern enum mbstatus_e mbcoil_write_bits(
+	const struct mbcoil_desc_s *coil,
+	uint16_t addr,
+	size_t n_max,
+	const uint8_t *src,
+	size_t src_bit,
+	size_t *n_written)
+{
+	uint8_t chunk[BULK_CHUNK_SIZE];
+	enum mbstatus_e status, res_status;
+	size_t n, k, n_chunk;
+
+	if ((coil==NULL) || (src==NULL) || (n_written==NULL) || (n_max==0u)) return MB_DEV_FAIL;
+	*n_written = 0u;
+
+	if (!is_multi(coil)) {
+		*n_written = 1u;
+		return mbcoil_write(coil, get_bits(src, src_bit, 1u));
+	}
+
+	if ((n = coil_remaining(coil, addr, n_max)) == 0u) return MB_DEV_FAIL;
+
+	switch (coil->access & MCACC_W_MASK) {
+	case MCACC_W_PTR:
+		if (coil->write.ptr==NULL) return MB_DEV_FAIL;
+		put_bits(coil->write.ptr,
+			(size_t)coil->write.ix + (size_t)(addr - coil->address),
+			src, src_bit, n);
+		break;
+	case MCACC_W_BULK:
+		if (coil->write.bulk==NULL) return MB_DEV_FAIL;
+		*n_written = n;
+		if ((src_bit%8u) == 0u) {
+			/* Byte aligned, the callback reads the request directly */
+			return coil->write.bulk(addr, n, src + (src_bit/8u));
+		}
+
+		/* Chunks through scratch, completion may be deferred for one chunk */
+		res_status = MB_OK;
+		for (k=0u; k<n; k+=n_chunk) {
+			n_chunk = n-k;
+			if (n_chunk > (BULK_CHUNK_SIZE*8u)) n_chunk = BULK_CHUNK_SIZE*8u;
+
+			(void)memset(chunk, 0, sizeof chunk);
+			put_bits(chunk, 0u, src, src_bit+k, n_chunk);
+			status = coil->write.bulk((uint16_t)(addr+k), n_chunk, chunk);
+			if (status==MB_PENDING) {
+				if (res_status==MB_PENDING) {
+					*n_written = 0u;
+					return MB_DEV_FAIL;
+				}
+				res_status = MB_PENDING;
+			} else if (status!=MB_OK) {
+				*n_written = 0u;
+				return status;
+			}
+		}
+		return res_status;
+	default:
+		return MB_DEV_FAIL;
+	}
+
+	*n_written = n;
+	return MB_OK;
+}
+
+extern enum mbstatus_e mbcoil_cursor_write_bits(
+	struct mbcoil_cursor_s *cur,
+	uint16_t addr,
+	size_t n_max,
+	const uint8_t *src,
+	size_t src_bit,
+	size_t *n_written)
+{
+	const struct mbcoil_desc_s *coil;
+	volatile uint8_t *p;
+	size_t n;
+	uint8_t mask;
+
+	if ((src==NULL) || (n_written==NULL) || (n_max==0u)) return MB_DEV_FAIL;
+	*n_written = 0u;
+
+	if ((coil = mbcoil_cursor_find(cur, addr)) == NULL) return MB_DEV_FAIL;
+
+	if ((n = ptr_run(cur, addr, n_max)) < 2u) {
+		return mbcoil_write_bits(coil, addr, n_max, src, src_bit, n_written);
+	}
+
+	/* One masked merge for the whole run */
+	p = coil->write.ptr;
+	mask = (uint8_t)(((1u<<n)-1u) << coil->write.ix);
+	*p = (uint8_t)((*p & (uint8_t)~mask)
+		| ((unsigned)get_bits(src, src_bit, n) << coil->write.ix));
+
+	*n_written = n;
+	return MB_OK;
+}
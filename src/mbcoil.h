@@ -43,6 +43,7 @@
 #define MBCOIL_H_INCLUDED
 
 #include "mbdef.h"
+#include "mbpage.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -63,8 +64,12 @@ enum mbcoil_access_e {
 	MCACC_W_FN = 1u<<4, /**< Write via function callback */
 	MCACC_RW_FN = MCACC_R_FN | MCACC_W_FN, /**< Read/write via function callbacks */
 
-	MCACC_R_MASK = MCACC_R_VAL | MCACC_R_PTR | MCACC_R_FN, /**< Mask for read access methods */
-	MCACC_W_MASK = MCACC_W_PTR | MCACC_W_FN, /**< Mask for write access methods */
+	MCACC_R_BULK = 1u<<5, /**< Read consecutive coils via bulk callback */
+	MCACC_W_BULK = 1u<<6, /**< Write consecutive coils via bulk callback */
+	MCACC_RW_BULK = MCACC_R_BULK | MCACC_W_BULK, /**< Read/write via bulk callbacks */
+
+	MCACC_R_MASK = MCACC_R_VAL | MCACC_R_PTR | MCACC_R_FN | MCACC_R_BULK, /**< Mask for read access methods */
+	MCACC_W_MASK = MCACC_W_PTR | MCACC_W_FN | MCACC_W_BULK, /**< Mask for write access methods */
 };
 
 /**
@@ -111,6 +116,7 @@ struct mbcoil_desc_s {
 	 * @note For MCACC_R_VAL: Use val member (0 or 1, normalized automatically)
 	 * @note For MCACC_R_PTR: Use ptr and ix members for bit-level access
 	 * @note For MCACC_R_FN: Use fn member (function returning 0 or 1)
+	 * @note For MCACC_R_BULK: Use bulk member (function filling a packed bitmap)
 	 */
 	union {
 		/**
@@ -144,6 +150,25 @@ struct mbcoil_desc_s {
 		 * @note Should be fast and non-blocking
 		 */
 		int (*fn)(void);
+
+		/**
+		 * @brief Bulk read function callback
+		 *
+		 * Function called to read n consecutive coils starting at addr.
+		 * The coils are packed LSB first from bit 0 of bits, which is cleared
+		 * beforehand. Bits beyond n shall be left as 0.
+		 *
+		 * @param addr First coil address to read
+		 * @param n Number of coils to read
+		 * @param bits Destination bitmap of at least (n+7)/8 bytes
+		 *
+		 * @return Modbus status code
+		 *
+		 * @note Used with MCACC_R_BULK access method
+		 * @note May be called more than once per request for parts of the block
+		 * @note Should be fast and non-blocking
+		 */
+		enum mbstatus_e (*bulk)(uint16_t addr, size_t n, uint8_t *bits);
 	} read;
 
 	/**
@@ -154,6 +179,12 @@ struct mbcoil_desc_s {
 	 *
 	 * @note For MCACC_W_PTR: Use ptr and ix members for bit-level access
 	 * @note For MCACC_W_FN: Use fn member (function accepting 0 or 1)
+	 * @note For MCACC_W_BULK: Use bulk member (function taking a packed bitmap)
+	 * @note Write callbacks may return MB_PENDING to defer the response, see mbpdu_complete().
+	 *       One callback per request may defer, a second one ends the request with
+	 *       MB_DEV_FAIL. If a later write fails the request ends with its exception
+	 *       and nothing is pending, mbpdu_complete() then returns 0 and the deferred
+	 *       operation shall be dropped.
 	 */
 	union {
 		/**
@@ -181,6 +212,24 @@ struct mbcoil_desc_s {
 		 * @note Return value determines if the write operation succeeds
 		 */
 		enum mbstatus_e (*fn)(int value);
+
+		/**
+		 * @brief Bulk write function callback
+		 *
+		 * Function called to write n consecutive coils starting at addr.
+		 * The coils are packed LSB first from bit 0 of bits.
+		 *
+		 * @param addr First coil address to write
+		 * @param n Number of coils to write
+		 * @param bits Source bitmap of at least (n+7)/8 bytes
+		 *
+		 * @return Modbus status code
+		 *
+		 * @note Used with MCACC_W_BULK access method
+		 * @note May be called more than once per request for parts of the block
+		 * @note Bits beyond n are unspecified and shall be ignored
+		 */
+		enum mbstatus_e (*bulk)(uint16_t addr, size_t n, const uint8_t *bits);
 	} write;
 
 	/**
@@ -223,6 +272,22 @@ struct mbcoil_desc_s {
 	 * @note Should not perform time-consuming operations
 	 */
 	void (*post_write_cb)(void);
+
+	/**
+	 * @brief Number of consecutive coils in a block descriptor
+	 *
+	 * A block descriptor maps addresses [address, address+n_block_entries) to
+	 * consecutive bits of a packed bitmap, starting at bit ix of ptr. Bits are
+	 * packed LSB first, so bit n of the block is (ptr[(ix+n)/8] >> ((ix+n)%8)) & 1.
+	 * With bulk access the range is instead handed to the bulk callbacks.
+	 *
+	 * @note 0 or 1 describes a single coil
+	 * @note Only pointer (MCACC_R_PTR, MCACC_W_PTR) and bulk (MCACC_R_BULK,
+	 *       MCACC_W_BULK) access are supported for blocks
+	 * @note A uint32_t bitmap can be used on little-endian targets
+	 * @note rlock_cb, wlock_cb and post_write_cb are called once per request for the whole block
+	 */
+	size_t n_block_entries;
 };
 
 /** @brief Only for internal use */
@@ -237,8 +302,8 @@ enum {
 /**
  * @brief Find coil descriptor by address
  *
- * Searches for a coil descriptor that matches the specified address using binary search
- * for efficient lookup in large coil maps.
+ * Searches for a coil descriptor that matches (or as a block contains) the
+ * specified address using binary search for efficient lookup in large coil maps.
  *
  * @param coils Array of coil descriptors (must be sorted in ascending address order)
  * @param n_coils Number of entries in the coils array
@@ -254,6 +319,155 @@ extern const struct mbcoil_desc_s *mbcoil_find_desc(
 	size_t n_coils,
 	uint16_t addr);
 
+/**
+ * @brief Check a coil map in one pass
+ *
+ * Checks what mbtest_coils_validate_all() checks: ascending addresses without
+ * overlap (blocks included), one access method per direction with its
+ * pointer or callback set, bit indices of pointer access, and pointer or bulk
+ * access for blocks.
+ *
+ * @param coils Array of coil descriptors
+ * @param n_coils Number of entries in the coils array
+ * @param issue_addr Out parameter with the address of the first invalid descriptor (Can be NULL)
+ *
+ * @retval 1 Valid (or empty) map
+ * @retval 0 Invalid descriptor at issue_addr
+ *
+ * @note Time complexity: O(n_coils)
+ */
+extern int mbcoil_validate(
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils,
+	uint16_t *issue_addr);
+
+/**
+ * @brief Paged address index for a coil map, see mbpage_s
+ *
+ * Built once into caller supplied storage, lookups have constant cost
+ * regardless of the size of the map and how sparse its addresses are.
+ *
+ * @note The index must be rebuilt if the coil map it was built for changes
+ */
+struct mbcoil_index_s {
+	const struct mbcoil_desc_s *coils; /**< Coil map the index was built for */
+	size_t n_coils; /**< Number of descriptors in coils */
+	struct mbpage_s pages; /**< Page table of descriptor positions */
+};
+
+/**
+ * @brief Get number of storage entries required by mbcoil_index_build()
+ *
+ * @param coils Array of coil descriptors (must be sorted in ascending address order)
+ * @param n_coils Number of entries in the coils array
+ *
+ * @return Number of uint16_t storage entries, 0 for an unsorted or overlapping map
+ */
+extern size_t mbcoil_index_size(
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils);
+
+/**
+ * @brief Build a paged index for a coil map
+ *
+ * @param ix Index to initialize
+ * @param coils Array of coil descriptors (must be sorted in ascending address order)
+ * @param n_coils Number of entries in the coils array
+ * @param storage Caller supplied storage of mbcoil_index_size() entries
+ * @param storage_len Number of entries in storage
+ *
+ * @retval 1 Index built
+ * @retval 0 Index could not be built (Too little storage, unsorted/overlapping map etc.)
+ *
+ * @note On failure the index is left empty and lookups fall back to mbcoil_find_desc()
+ * @note Time complexity: O(n_coils + mapped addresses). Lookups: O(1)
+ */
+extern int mbcoil_index_build(
+	struct mbcoil_index_s *ix,
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils,
+	uint16_t *storage,
+	size_t storage_len);
+
+/**
+ * @brief Find coil descriptor by address using an index if available
+ *
+ * @param ix Index for the coil map (Can be NULL)
+ * @param coils Array of coil descriptors (must be sorted in ascending address order)
+ * @param n_coils Number of entries in the coils array
+ * @param addr Modbus coil address to search for
+ *
+ * @return Pointer to the coil descriptor if found, NULL if no match
+ */
+extern const struct mbcoil_desc_s *mbcoil_index_find(
+	const struct mbcoil_index_s *ix,
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils,
+	uint16_t addr);
+
+/**
+ * @brief Cursor for walking a coil map in ascending address order
+ *
+ * Locates the start descriptor once and then only moves forward through the
+ * map, making a walk over n addresses O(log n_coils + n).
+ *
+ * @note Shall not be accessed by client code directly
+ */
+struct mbcoil_cursor_s {
+	const struct mbcoil_desc_s *coils; /**< Coil map being walked */
+	size_t n_coils; /**< Number of descriptors in coils */
+	size_t pos; /**< Position of first descriptor not before the last looked up address */
+};
+
+/**
+ * @brief Position a cursor at the given start address
+ *
+ * @param cur Cursor to initialize
+ * @param ix Index for the coil map (Can be NULL)
+ * @param coils Array of coil descriptors (must be sorted in ascending address order)
+ * @param n_coils Number of entries in the coils array
+ * @param addr First address that will be looked up
+ */
+extern void mbcoil_cursor_init(
+	struct mbcoil_cursor_s *cur,
+	const struct mbcoil_index_s *ix,
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils,
+	uint16_t addr);
+
+/**
+ * @brief Find coil descriptor by address using a cursor
+ *
+ * @param cur Cursor positioned with mbcoil_cursor_init()
+ * @param addr Modbus coil address to look up
+ *
+ * @return Pointer to the coil descriptor if found, NULL if no match
+ *
+ * @note Addresses must be looked up in non-decreasing order
+ * @note Amortized time complexity: O(1)
+ */
+extern const struct mbcoil_desc_s *mbcoil_cursor_find(
+	struct mbcoil_cursor_s *cur,
+	uint16_t addr);
+
+/**
+ * @brief Number of addresses without coil from addr on
+ *
+ * Lets a read skip a gap of the map in one step, to the next present coil.
+ *
+ * @param cur Cursor positioned with mbcoil_cursor_init()
+ * @param addr Address mbcoil_cursor_find() found no coil at
+ * @param n_max Maximum number of addresses to skip
+ *
+ * @return Addresses up to the next coil, at most n_max
+ *
+ * @note Time complexity: O(1)
+ */
+extern size_t mbcoil_cursor_gap(
+	const struct mbcoil_cursor_s *cur,
+	uint16_t addr,
+	size_t n_max);
+
 /**
  * @brief Read a coil value
  *
@@ -274,6 +488,33 @@ extern const struct mbcoil_desc_s *mbcoil_find_desc(
  */
 extern int mbcoil_read(const struct mbcoil_desc_s *coil);
 
+/**
+ * @brief Read consecutive coils from a descriptor into a packed bitmap
+ *
+ * Reads the coils from addr up to the end of the descriptor (at most n_max)
+ * and ORs them into dst starting at bit dst_bit. Block descriptors are copied
+ * a byte at a time with shift/mask operations. Bulk descriptors fill dst
+ * directly when dst_bit is byte aligned, otherwise through a small scratch buffer.
+ *
+ * @param coil Pointer to the coil descriptor containing addr
+ * @param addr First coil address to read
+ * @param n_max Maximum number of coils to read
+ * @param dst Destination bitmap (Bits to be set must be cleared beforehand)
+ * @param dst_bit Bit offset in dst of the first coil
+ * @param n_read Out parameter with number of coils covered (also for coils without read access)
+ *
+ * @retval MB_OK Success, coils without read access are left as 0
+ * @retval MB_ILLEGAL_DATA_ADDR Coil read locked
+ * @retval MB_DEV_FAIL Invalid coil descriptor configuration
+ */
+extern enum mbstatus_e mbcoil_read_bits(
+	const struct mbcoil_desc_s *coil,
+	uint16_t addr,
+	size_t n_max,
+	uint8_t *dst,
+	size_t dst_bit,
+	size_t *n_read);
+
 /**
  * @brief Check if writing to this coil is allowed
  *
@@ -308,4 +549,56 @@ extern int mbcoil_write_allowed(const struct mbcoil_desc_s *coil);
  */
 extern enum mbstatus_e mbcoil_write(const struct mbcoil_desc_s *coil, uint8_t value);
 
+/**
+ * @brief Write consecutive coils of a descriptor from a packed bitmap
+ *
+ * Writes the coils from addr up to the end of the descriptor (at most n_max),
+ * taking the values from src starting at bit src_bit.
+ *
+ * @param coil Pointer to the coil descriptor containing addr
+ * @param addr First coil address to write
+ * @param n_max Maximum number of coils to write
+ * @param src Source bitmap
+ * @param src_bit Bit offset in src of the first value
+ * @param n_written Out parameter with number of coils written
+ *
+ * @return Modbus status code
+ *
+ * @warning This function does not check write permissions - call mbcoil_write_allowed() first
+ */
+extern enum mbstatus_e mbcoil_write_bits(
+	const struct mbcoil_desc_s *coil,
+	uint16_t addr,
+	size_t n_max,
+	const uint8_t *src,
+	size_t src_bit,
+	size_t *n_written);
+
+/**
+ * @brief Write consecutive coils at the cursor from a packed bitmap
+ *
+ * Like mbcoil_write_bits() for the descriptor containing addr, but a run of
+ * single pointer coils at consecutive addresses and consecutive bits of the
+ * same byte is written with one masked merge instead of one read-modify-write
+ * per coil. Coils with post_write_cb end a run.
+ *
+ * @param cur Cursor positioned with mbcoil_cursor_find() at addr
+ * @param addr First coil address to write
+ * @param n_max Maximum number of coils to write
+ * @param src Source bitmap
+ * @param src_bit Bit offset in src of the first value
+ * @param n_written Out parameter with number of coils written
+ *
+ * @return Modbus status code
+ *
+ * @warning This function does not check write permissions - call mbcoil_write_allowed() first
+ */
+extern enum mbstatus_e mbcoil_cursor_write_bits(
+	struct mbcoil_cursor_s *cur,
+	uint16_t addr,
+	size_t n_max,
+	const uint8_t *src,
+	size_t src_bit,
+	size_t *n_written);
+
 #endif /* MBCOIL_H_INCLUDED */
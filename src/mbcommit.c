@@ -0,0 +1,167 @@
+/**
+ * @file mbcommit.c
+ * @brief Modbus Commit - Write coalescing and batched commit of holding registers
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+#include "mbcommit.h"
+#include "mbinst.h"
+#include "mbtrace.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Exclusive end address of a range
+ */
+static size_t range_end(const struct mbcommit_range_s *range)
+{
+	return (size_t)range->start + range->n;
+}
+
+extern void mbcommit_init(struct mbcommit_s *commit)
+{
+	if (commit==NULL) return;
+
+	commit->n_ranges = 0u;
+	commit->last_write = 0u;
+}
+
+extern void mbcommit_mark(struct mbcommit_s *commit, uint16_t start, size_t n)
+{
+	struct mbcommit_range_s tmp[MBCOMMIT_N_RANGES+1u];
+	size_t i, k, end, gap, min_gap, min_i;
+	int is_inserted;
+
+	if ((commit==NULL) || (n==0u)) return;
+
+	end = (size_t)start + n;
+
+	/* Absorb ranges overlapping or adjacent to the new one, keep the rest sorted */
+	k = 0u;
+	is_inserted = 0;
+	for (i=0u; i<commit->n_ranges; ++i) {
+		if ((commit->ranges[i].start <= end) && (range_end(commit->ranges+i) >= start)) {
+			if (commit->ranges[i].start < start) start = commit->ranges[i].start;
+			if (range_end(commit->ranges+i) > end) end = range_end(commit->ranges+i);
+			continue;
+		}
+		if (!is_inserted && (commit->ranges[i].start > end)) {
+			tmp[k].start = start;
+			tmp[k++].n = end - start;
+			is_inserted = 1;
+		}
+		tmp[k++] = commit->ranges[i];
+	}
+	if (!is_inserted) {
+		tmp[k].start = start;
+		tmp[k++].n = end - start;
+	}
+
+	/* Out of ranges, merge the closest pair of neighbours */
+	if (k > MBCOMMIT_N_RANGES) {
+		min_gap = SIZE_MAX;
+		min_i = 0u;
+		for (i=0u; (i+1u)<k; ++i) {
+			gap = (size_t)tmp[i+1u].start - range_end(tmp+i);
+			if (gap < min_gap) {
+				min_gap = gap;
+				min_i = i;
+			}
+		}
+		tmp[min_i].n = range_end(tmp+min_i+1u) - tmp[min_i].start;
+		for (i=min_i+1u; (i+1u)<k; ++i) tmp[i] = tmp[i+1u];
+		--k;
+	}
+
+	for (i=0u; i<k; ++i) commit->ranges[i] = tmp[i];
+	commit->n_ranges = k;
+
+	if (commit->clock_cb!=NULL) {
+		commit->last_write = commit->clock_cb();
+	}
+}
+
+extern size_t mbcommit_dirty_bytes(const struct mbcommit_s *commit)
+{
+	size_t i, n;
+
+	if (commit==NULL) return 0u;
+
+	for (i=0u, n=0u; i<commit->n_ranges; ++i) {
+		n += commit->ranges[i].n * 2u;
+	}
+
+	return n;
+}
+
+extern void mbcommit_flush(const struct mbinst_s *inst)
+{
+	struct mbcommit_s *commit;
+
+	if ((inst==NULL) || (inst->commit==NULL)) return;
+
+	commit = inst->commit;
+	if (commit->n_ranges==0u) return;
+
+	if (commit->commit_cb!=NULL) {
+		commit->commit_cb(inst, commit->ranges, commit->n_ranges);
+	}
+	commit->n_ranges = 0u;
+}
+
+extern void mbcommit_poll(const struct mbinst_s *inst)
+{
+	const struct mbcommit_s *commit;
+
+	if ((inst==NULL) || (inst->commit==NULL)) return;
+
+	commit = inst->commit;
+	if ((commit->n_ranges==0u) || (commit->quiet_ticks==0u) || (commit->clock_cb==NULL)) return;
+
+	if ((commit->clock_cb() - commit->last_write) >= commit->quiet_ticks) {
+		mbcommit_flush(inst);
+	}
+}
+
+extern void mbcommit_regs_written(const struct mbinst_s *inst, uint16_t start, size_t n)
+{
+	uint64_t t_trace;
+
+	if (inst->commit==NULL) {
+		if (inst->commit_regs_write_cb!=NULL) {
+			t_trace = mbtrace_now(inst->trace);
+			inst->commit_regs_write_cb(inst);
+			mbtrace_emit(inst->trace, MBTRACE_EV_CB, 0u, start, t_trace);
+		}
+		return;
+	}
+
+	mbcommit_mark(inst->commit, start, n);
+	if ((inst->commit->max_dirty_bytes!=0u)
+			&& (mbcommit_dirty_bytes(inst->commit) >= inst->commit->max_dirty_bytes)) {
+		mbcommit_flush(inst);
+	}
+}
@@ -0,0 +1,148 @@
+/**
+ * @file mbcommit.h
+ * @brief Modbus Commit - Write coalescing and batched commit of holding registers
+ * @author Jonas Almås
+ *
+ * @details Coalesces holding register writes of several requests into dirty
+ * address ranges and commits them in one callback, e.g. to persist a recipe
+ * written as many FC 0x10 frames with a single flash write. The commit fires
+ * after a quiet period without writes, when the dirty size reaches a limit,
+ * or when requested explicitly.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+#ifndef MBCOMMIT_H_INCLUDED
+#define MBCOMMIT_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct mbinst_s;
+
+/** @brief Number of dirty ranges tracked before the closest ranges are merged */
+enum {MBCOMMIT_N_RANGES=8u};
+
+/**
+ * @brief A range of dirty holding register addresses
+ */
+struct mbcommit_range_s {
+	uint16_t start; /**< First dirty address */
+	size_t n; /**< Number of dirty addresses */
+};
+
+/**
+ * @brief Commit policy and dirty ranges of holding register writes
+ *
+ * Attached to an instance through mbinst_s::commit. While attached, holding
+ * register writes mark their addresses dirty instead of calling
+ * mbinst_s::commit_regs_write_cb, and commit_cb receives the dirty ranges
+ * once the policy triggers.
+ *
+ * @note Configuration fields are set by the application, the remaining
+ *       fields are state cleared by mbcommit_init()
+ * @note Ranges are merged when more than MBCOMMIT_N_RANGES are dirty, so a
+ *       range might include addresses in between that were not written
+ * @note Not thread safe, one block per instance
+ */
+struct mbcommit_s {
+	/**
+	 * @brief Commit callback
+	 *
+	 * @param inst Instance the writes were made on
+	 * @param ranges Dirty ranges in ascending address order
+	 * @param n_ranges Number of ranges (1 to MBCOMMIT_N_RANGES)
+	 */
+	void (*commit_cb)(
+		const struct mbinst_s *inst,
+		const struct mbcommit_range_s *ranges,
+		size_t n_ranges);
+
+	/**
+	 * @brief Monotonic clock used for the quiet period
+	 *
+	 * @note Can be left as NULL, the quiet period trigger is then disabled
+	 */
+	uint64_t (*clock_cb)(void);
+
+	uint64_t quiet_ticks; /**< Commit from mbcommit_poll() after this long without writes, 0 to disable */
+	size_t max_dirty_bytes; /**< Commit once this many bytes are dirty, 0 to disable */
+
+	struct mbcommit_range_s ranges[MBCOMMIT_N_RANGES]; /**< Dirty ranges, sorted and disjoint */
+	size_t n_ranges; /**< Number of entries in ranges */
+	uint64_t last_write; /**< Time of the last write, in clock_cb units */
+};
+
+/**
+ * @brief Clear the dirty ranges, the configuration is kept
+ *
+ * @param commit Commit policy to initialize
+ */
+extern void mbcommit_init(struct mbcommit_s *commit);
+
+/**
+ * @brief Mark a range of holding register addresses dirty
+ *
+ * @param commit Commit policy
+ * @param start First address written
+ * @param n Number of addresses written
+ *
+ * @note Does not commit, see mbcommit_regs_written() for the library side
+ */
+extern void mbcommit_mark(struct mbcommit_s *commit, uint16_t start, size_t n);
+
+/**
+ * @brief Number of dirty bytes (2 per register address)
+ */
+extern size_t mbcommit_dirty_bytes(const struct mbcommit_s *commit);
+
+/**
+ * @brief Commit the dirty ranges of an instance now
+ *
+ * Calls commit_cb if any range is dirty and clears the ranges.
+ *
+ * @param inst Instance with a commit policy attached (No-op if none)
+ */
+extern void mbcommit_flush(const struct mbinst_s *inst);
+
+/**
+ * @brief Commit if the quiet period has elapsed since the last write
+ *
+ * Call periodically, e.g. from the main loop or the Modbus task.
+ *
+ * @param inst Instance with a commit policy attached (No-op if none)
+ */
+extern void mbcommit_poll(const struct mbinst_s *inst);
+
+/**
+ * @brief Handle a completed holding register write of a request
+ *
+ * Marks the range dirty and applies the dirty size trigger when a commit
+ * policy is attached, otherwise calls mbinst_s::commit_regs_write_cb.
+ *
+ * @note Library internal function
+ */
+extern void mbcommit_regs_written(const struct mbinst_s *inst, uint16_t start, size_t n);
+
+#endif /* MBCOMMIT_H_INCLUDED */
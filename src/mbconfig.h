@@ -0,0 +1,244 @@
+/**
+ * @file mbconfig.h
+ * @brief Modbus Configuration - Compile time feature selection
+ * @author Jonas Almås
+ *
+ * @details Compile time configuration of the library. Every option has a
+ * default and can be overridden with a compiler definition (e.g.
+ * -DMBCFG_FILES=0), or all at once from a port specific header named by
+ * MBCFG_USER_FILE (e.g. -DMBCFG_USER_FILE='"mbconfig_port.h"').
+ *
+ * Disabled function codes are answered with MB_ILLEGAL_FN (or passed on to
+ * mbinst_s::handle_fn_cb), and their handlers are not compiled, so they take
+ * up no flash.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBCONFIG_H_INCLUDED
+#define MBCONFIG_H_INCLUDED
+
+#if defined(MBCFG_USER_FILE)
+#include MBCFG_USER_FILE
+#endif
+
+/**
+ * @brief Coils: Function codes 0x01, 0x05 and 0x0F
+ */
+#ifndef MBCFG_COILS
+#define MBCFG_COILS 1
+#endif
+
+/**
+ * @brief Discrete inputs: Function code 0x02
+ */
+#ifndef MBCFG_DISC_INPUTS
+#define MBCFG_DISC_INPUTS 1
+#endif
+
+/**
+ * @brief Holding registers: Function codes 0x03, 0x06 and 0x10
+ */
+#ifndef MBCFG_HOLD_REGS
+#define MBCFG_HOLD_REGS 1
+#endif
+
+/**
+ * @brief Input registers: Function code 0x04
+ */
+#ifndef MBCFG_INPUT_REGS
+#define MBCFG_INPUT_REGS 1
+#endif
+
+/**
+ * @brief Mask write register: Function code 0x16
+ *
+ * @note Defaults to MBCFG_HOLD_REGS, requires holding registers
+ */
+#ifndef MBCFG_MASK_WRITE_REG
+#define MBCFG_MASK_WRITE_REG MBCFG_HOLD_REGS
+#endif
+
+/**
+ * @brief Read/write multiple registers: Function code 0x17
+ *
+ * @note Defaults to MBCFG_HOLD_REGS, requires holding registers
+ */
+#ifndef MBCFG_READ_WRITE_REGS
+#define MBCFG_READ_WRITE_REGS MBCFG_HOLD_REGS
+#endif
+
+/**
+ * @brief File records: Function codes 0x14 and 0x15 (mbfile.c and mbfn_files.c)
+ */
+#ifndef MBCFG_FILES
+#define MBCFG_FILES 1
+#endif
+
+/**
+ * @brief FIFO queues: Function code 0x18 (mbfifo.c and mbfn_fifo.c)
+ */
+#ifndef MBCFG_FIFO
+#define MBCFG_FIFO 1
+#endif
+
+/**
+ * @brief Device identification: Function code 0x2B / MEI type 0x0E (mbdevid.c and mbfn_devid.c)
+ */
+#ifndef MBCFG_DEVID
+#define MBCFG_DEVID 1
+#endif
+
+/**
+ * @brief Serial diagnostics: Function codes 0x07, 0x08, 0x0B and 0x0C (mbfn_diag.c and mbfn_serial.c)
+ *
+ * @note The diagnostic counters of mbinst_state_s are still maintained
+ * @note When 0, mbinst_state_s carries no communication event log
+ */
+#ifndef MBCFG_SERIAL_DIAG
+#define MBCFG_SERIAL_DIAG 1
+#endif
+
+/**
+ * @brief Record communication events for function code 0x0C
+ *
+ * When 0, no events are recorded and mb_add_comm_event() compiles to nothing,
+ * e.g. for gateways seeing every bus frame that never serve the event log.
+ * Function code 0x0C is still answered, with an empty log.
+ *
+ * @note Defaults to MBCFG_SERIAL_DIAG, requires serial diagnostics
+ */
+#ifndef MBCFG_EVENT_LOG
+#define MBCFG_EVENT_LOG MBCFG_SERIAL_DIAG
+#endif
+
+#if MBCFG_EVENT_LOG && !MBCFG_SERIAL_DIAG
+#error "MBCFG_EVENT_LOG requires MBCFG_SERIAL_DIAG"
+#endif
+
+/**
+ * @brief Keep the communication event log outside of mbinst_s
+ *
+ * When 1, the event log is a buffer of MB_COMM_EVENT_LOG_LEN bytes owned by the
+ * application and attached with mbinst_set_event_log(). Instances without a
+ * buffer (e.g. TCP only) log no events and save the space of the log.
+ */
+#ifndef MBCFG_EVENT_LOG_EXTERN
+#define MBCFG_EVENT_LOG_EXTERN 0
+#endif
+
+#if MBCFG_EVENT_LOG_EXTERN && !MBCFG_EVENT_LOG
+#error "MBCFG_EVENT_LOG_EXTERN requires MBCFG_EVENT_LOG"
+#endif
+
+/**
+ * @brief Modbus ASCII transport (mbadu_ascii.c)
+ */
+#ifndef MBCFG_ASCII
+#define MBCFG_ASCII 1
+#endif
+
+/**
+ * @brief Trace hooks recording request, lookup, callback and ADU timing (mbtrace.c)
+ *
+ * When 1, mbinst_s has a trace field for an mbtrace_s ring. When 0, the hooks
+ * compile to nothing.
+ */
+#ifndef MBCFG_TRACE
+#define MBCFG_TRACE 0
+#endif
+
+/**
+ * @brief Atomic updates of the instance state (mbatomic.h)
+ *
+ * When 1, the counters, listen only flag, ASCII delimiter and event log
+ * position of mbinst_state_s are C11 atomics updated with relaxed ordering,
+ * and events are appended to the log without a lock. One instance can then
+ * handle requests from several threads at once, e.g. an RTU and a TCP
+ * transport, see mbinst_s for the members that stay single threaded.
+ */
+#ifndef MBCFG_ATOMIC_STATE
+#define MBCFG_ATOMIC_STATE 0
+#endif
+
+/**
+ * @brief Compact register descriptors for 8 and 16-bit targets
+ *
+ * When 1, mbreg_desc_s keeps type and access in one byte each and the
+ * number of block entries in 16 bits, and its lock and post-write callbacks
+ * move to a policy table shared by all descriptors (mbreg_policies), which
+ * a descriptor refers to by index. Handlers behave the same.
+ *
+ * @note The application defines mbreg_policies, entry 0 without callbacks
+ * @note Not supported by mbmap.hpp
+ */
+#ifndef MBCFG_COMPACT_REGS
+#define MBCFG_COMPACT_REGS 0
+#endif
+
+/**
+ * @brief Define the endian conversions of endian.h as static inline functions
+ *
+ * When 1, endian.h carries the function bodies and endian.c compiles to
+ * nothing, for toolchains without link time optimization. When 0, the
+ * conversions are ordinary functions in endian.c (e.g. for MISRA builds).
+ */
+#ifndef MBCFG_ENDIAN_INLINE
+#define MBCFG_ENDIAN_INLINE 0
+#endif
+
+/**
+ * @brief Number of bytes processed per CRC-16 table step
+ *
+ * 0: No table, bit by bit (smallest, slowest)
+ * 1: One 256-entry table (512 bytes)
+ * 4: Slicing-by-4, four 256-entry tables (2 KiB)
+ * 8: Slicing-by-8, eight 256-entry tables (4 KiB)
+ *
+ * @note Ignored when MBCRC_HW is defined
+ */
+#ifndef MBCRC_SLICE_BY
+#define MBCRC_SLICE_BY 1
+#endif
+
+/**
+ * @brief Number of attempts to take a snapshot before giving up
+ *
+ * A request that cannot get a consistent snapshot within this many attempts
+ * is answered with MB_BUSY.
+ */
+#ifndef MBSEQLOCK_READ_ATTEMPTS
+#define MBSEQLOCK_READ_ATTEMPTS 8
+#endif
+
+#if (MBCFG_MASK_WRITE_REG || MBCFG_READ_WRITE_REGS) && !MBCFG_HOLD_REGS
+#error "MBCFG_MASK_WRITE_REG and MBCFG_READ_WRITE_REGS require MBCFG_HOLD_REGS"
+#endif
+
+#if (MBCRC_SLICE_BY != 0) && (MBCRC_SLICE_BY != 1) && (MBCRC_SLICE_BY != 4) && (MBCRC_SLICE_BY != 8)
+#error "MBCRC_SLICE_BY must be 0, 1, 4 or 8"
+#endif
+
+#endif /* MBCONFIG_H_INCLUDED */
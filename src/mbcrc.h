@@ -5,6 +5,9 @@
  *
  * @details Fast CRC-16 implementation for Modbus using lookup table.
  * Provides optimized checksum calculation for Modbus RTU serial communications.
+ * The table layout (No table, one table or slicing-by-4/8) is selected at compile
+ * time with MBCRC_SLICE_BY (mbconfig.h), or a port can provide a hardware
+ * backend by defining MBCRC_HW.
  */
 
 /*
@@ -34,9 +37,27 @@
 #ifndef MBCRC_H_INCLUDED
 #define MBCRC_H_INCLUDED
 
+#include "mbconfig.h"
 #include <stddef.h>
 #include <stdint.h>
 
+#if defined(MBCRC_HW)
+/**
+ * @brief Port provided CRC-16 calculation (Hardware CRC unit etc.)
+ *
+ * Defining MBCRC_HW makes mbcrc16() forward to this function, which must be
+ * implemented by the port. It must compute the Modbus CRC-16 (Polynomial 0xA001
+ * reflected) over data, continuing from the given CRC.
+ *
+ * @param crc CRC to continue from (0xFFFF for a new calculation)
+ * @param data Pointer to data buffer to calculate CRC for
+ * @param size Number of bytes in the data buffer
+ *
+ * @return Updated 16-bit CRC value
+ */
+extern uint16_t mbcrc16_hw(uint16_t crc, const uint8_t *data, size_t size);
+#endif
+
 /**
  * @brief Calculate Modbus CRC-16
  *
@@ -47,7 +68,44 @@
  * @param size Number of bytes in the data buffer
  *
  * @return 16-bit CRC value for Modbus
+ *
+ * @note Table size and speed is selected at compile time with MBCRC_SLICE_BY
  */
 extern uint16_t mbcrc16(const uint8_t *data, size_t size);
 
+/**
+ * @brief Start an incremental Modbus CRC-16 calculation
+ *
+ * @return Initial CRC value (0xFFFF)
+ */
+extern uint16_t mbcrc16_init(void);
+
+/**
+ * @brief Continue an incremental Modbus CRC-16 calculation
+ *
+ * Processes more data, e.g. bytes as they arrive in a UART interrupt.
+ * mbcrc16_update(mbcrc16_init(), data, size) equals mbcrc16(data, size).
+ *
+ * @param crc CRC from mbcrc16_init() or a previous mbcrc16_update()
+ * @param data Pointer to data buffer to calculate CRC for
+ * @param size Number of bytes in the data buffer
+ *
+ * @return Updated 16-bit CRC value
+ *
+ * @note Running the CRC over a complete frame including its received CRC
+ *       bytes yields 0 for an intact frame
+ */
+extern uint16_t mbcrc16_update(uint16_t crc, const uint8_t *data, size_t size);
+
+/**
+ * @brief Finish an incremental Modbus CRC-16 calculation
+ *
+ * @param crc CRC from mbcrc16_update()
+ *
+ * @return 16-bit CRC value for Modbus
+ *
+ * @note Modbus CRC-16 has no final XOR, the value is returned as is
+ */
+extern uint16_t mbcrc16_final(uint16_t crc);
+
 #endif /* MBCRC_H_INCLUDED */
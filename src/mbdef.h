@@ -47,6 +47,12 @@ enum mbstatus_e {
 	   master should request diagnostic or error information from slave */
 	MB_NEG_ACK = 0x07u,
 	MB_MEM_PAR_ERR = 0x08u, /* Slave detected a parity error in memory; master can retry the request */
+	MB_GW_PATH_UNAVAIL = 0x0Au, /* Gateway could not allocate a path to the target device */
+	MB_GW_TARGET_FAILED = 0x0Bu, /* Gateway got no response from the target device */
+
+	/* Not a protocol exception code: Handling of the request is deferred and the response
+	   is produced later through mbpdu_complete() (or the ADU level complete functions) */
+	MB_PENDING = 0x100u,
 };
 
 /** Modbus function code */
@@ -69,6 +75,13 @@ enum mbfc_e {
 	MBFC_MASK_WRITE_REG = 0x16u,
 	MBFC_READ_WRITE_REGS = 0x17u,
 	MBFC_READ_FIFO_QUEUE = 0x18u,
+	MBFC_ENCAP_IFACE_TRANSPORT = 0x2Bu,
+};
+
+/** Modbus Encapsulated Interface (MEI) type of function code 0x2B */
+enum mbmei_e {
+	MBMEI_CANOPEN = 0x0Du, /* CANopen General Reference */
+	MBMEI_READ_DEV_ID = 0x0Eu, /* Read Device Identification */
 };
 
 /** Modbus diagnostics sub function code */
@@ -101,7 +114,10 @@ enum {
 	MB_ERR_FLG=0x80u
 };
 
-enum {MB_COMM_EVENT_LOG_LEN=64};
+enum {
+	MB_COMM_EVENT_LOG_LEN=64u, /* Power of two, positions wrap with the mask */
+	MB_COMM_EVENT_LOG_MASK=MB_COMM_EVENT_LOG_LEN-1u,
+};
 
 enum { /* Communication log event */
 	/* Receive event*/
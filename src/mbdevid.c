@@ -0,0 +1,94 @@
+/**
+ * @file mbdevid.c
+ * @brief Modbus Device Identification - Precomputed object tables for MEI type 0x0E
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbdevid.h"
+#include "mbconfig.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if MBCFG_DEVID
+
+extern size_t mbdevid_size(const struct mbdevid_obj_s *objs, size_t n_objs)
+{
+	size_t i, size=0u;
+
+	if (objs==NULL) return 0u;
+
+	for (i=0u; i<n_objs; ++i) {
+		size += 2u + objs[i].len;
+	}
+
+	return size;
+}
+
+extern int mbdevid_init(struct mbdevid_s *devid)
+{
+	const struct mbdevid_obj_s *obj;
+	uint8_t *p;
+	size_t i;
+
+	if ((devid==NULL) || (devid->objs==NULL) || (devid->buf==NULL)) return 0;
+	if (devid->n_objs < 3u) return 0;
+	if (mbdevid_size(devid->objs, devid->n_objs) > devid->buf_size) return 0;
+
+	for (i=0u; i<devid->n_objs; ++i) {
+		obj = &devid->objs[i];
+		if ((i < 3u) && (obj->id != i)) return 0; /* Basic objects are mandatory */
+		if ((i > 0u) && (obj->id <= devid->objs[i-1u].id)) return 0;
+		if (obj->len > MBDEVID_OBJ_SIZE_MAX) return 0;
+		if ((obj->len > 0u) && (obj->value==NULL)) return 0;
+	}
+
+	p = devid->buf;
+	for (i=0u; i<devid->n_objs; ++i) {
+		obj = &devid->objs[i];
+		*p++ = obj->id;
+		*p++ = obj->len;
+		if (obj->len > 0u) {
+			(void)memcpy(p, obj->value, obj->len);
+			p += obj->len;
+		}
+	}
+	devid->len = (size_t)(p - devid->buf);
+
+	obj = &devid->objs[devid->n_objs - 1u];
+	if (obj->id >= MBDEVID_EXTENDED_FIRST) {
+		devid->conformity = 0x83u;
+	} else if (obj->id > MBDEVID_MAJOR_MINOR_REV) {
+		devid->conformity = 0x82u;
+	} else {
+		devid->conformity = 0x81u;
+	}
+
+	return 1;
+}
+
+#endif /* MBCFG_DEVID */
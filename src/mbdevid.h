@@ -0,0 +1,118 @@
+/**
+ * @file mbdevid.h
+ * @brief Modbus Device Identification - Precomputed object tables for MEI type 0x0E
+ * @author Jonas Almås
+ *
+ * @details Device identification objects served by function code 0x2B with
+ * MEI type 0x0E (Read Device Identification). The objects are declared by the
+ * application, typically as const tables in ROM. mbdevid_init() serializes
+ * them once into the wire format of the response, so a request only copies a
+ * run of serialized objects behind a 6 byte header.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBDEVID_H_INCLUDED
+#define MBDEVID_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+	MBDEVID_OBJ_SIZE_MAX = 244u, /**< Longest object value, an object must fit in one response */
+};
+
+/** Read Device ID code of the request */
+enum mbdevid_code_e {
+	MBDEVID_BASIC = 0x01u, /**< Stream access to the basic objects (0x00 to 0x02) */
+	MBDEVID_REGULAR = 0x02u, /**< Stream access to the basic and regular objects (up to 0x7F) */
+	MBDEVID_EXTENDED = 0x03u, /**< Stream access to all objects (up to 0xFF) */
+	MBDEVID_INDIVIDUAL = 0x04u, /**< One specific object */
+};
+
+/** Object ids defined by the specification */
+enum mbdevid_obj_e {
+	MBDEVID_VENDOR_NAME = 0x00u, /**< Basic, mandatory */
+	MBDEVID_PRODUCT_CODE = 0x01u, /**< Basic, mandatory */
+	MBDEVID_MAJOR_MINOR_REV = 0x02u, /**< Basic, mandatory */
+	MBDEVID_VENDOR_URL = 0x03u, /**< Regular, optional */
+	MBDEVID_PRODUCT_NAME = 0x04u, /**< Regular, optional */
+	MBDEVID_MODEL_NAME = 0x05u, /**< Regular, optional */
+	MBDEVID_USER_APP_NAME = 0x06u, /**< Regular, optional */
+	/* 0x07..0x7F - Reserved regular objects */
+	MBDEVID_EXTENDED_FIRST = 0x80u, /**< First private (extended) object */
+};
+
+/**
+ * @brief Device identification object
+ */
+struct mbdevid_obj_s {
+	uint8_t id; /**< Object id */
+	uint8_t len; /**< Length of value in bytes, at most MBDEVID_OBJ_SIZE_MAX */
+	const char *value; /**< Object value, ASCII strings by the specification (No terminator sent) */
+};
+
+/**
+ * @brief Device identification of an instance
+ *
+ * @note Configuration fields are set by the application, the others by mbdevid_init()
+ * @note Not modified while handling requests, can be shared between instances and workers
+ */
+struct mbdevid_s {
+	/**
+	 * @brief Objects in ascending id order
+	 *
+	 * @note Must contain the basic objects 0x00, 0x01 and 0x02
+	 */
+	const struct mbdevid_obj_s *objs;
+	size_t n_objs; /**< Number of objects */
+	uint8_t *buf; /**< Caller supplied, receives the serialized objects, see mbdevid_size() */
+	size_t buf_size; /**< Size of buf in bytes */
+
+	size_t len; /**< Serialized bytes in buf */
+	uint8_t conformity; /**< Conformity level sent in responses (0x81, 0x82 or 0x83) */
+};
+
+/**
+ * @brief Size of the serialized objects
+ *
+ * @param objs Objects
+ * @param n_objs Number of objects
+ *
+ * @return Bytes needed in mbdevid_s::buf, 2 bytes per object plus the values
+ */
+extern size_t mbdevid_size(const struct mbdevid_obj_s *objs, size_t n_objs);
+
+/**
+ * @brief Validate the objects and serialize them into buf
+ *
+ * @param devid Device identification with configuration fields set
+ *
+ * @retval 1 Success
+ * @retval 0 Invalid objects (order, missing basic object, too long value) or buf too small
+ */
+extern int mbdevid_init(struct mbdevid_s *devid);
+
+#endif /* MBDEVID_H_INCLUDED */
@@ -0,0 +1,121 @@
+/**
+ * @file mbdirty.c
+ * @brief Modbus Dirty - Change tracking of written addresses
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+#include "mbdirty.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+extern int mbdirty_init(
+	struct mbdirty_s *dirty,
+	uint8_t *bits,
+	size_t bits_len,
+	uint16_t base,
+	size_t n_addrs)
+{
+	if (dirty==NULL) return 0;
+
+	dirty->bits = NULL;
+	dirty->base = base;
+	dirty->n_addrs = 0u;
+
+	if ((bits==NULL) || (bits_len < MBDIRTY_BITMAP_SIZE(n_addrs))) return 0;
+	if (((size_t)base + n_addrs) > 0x10000u) return 0;
+
+	(void)memset(bits, 0, MBDIRTY_BITMAP_SIZE(n_addrs));
+	dirty->bits = bits;
+	dirty->n_addrs = n_addrs;
+
+	return 1;
+}
+
+extern void mbdirty_mark(struct mbdirty_s *dirty, uint16_t addr, size_t n)
+{
+	size_t i, end;
+
+	if ((dirty==NULL) || (dirty->bits==NULL)) return;
+
+	/* Clip to the tracked range */
+	if (addr < dirty->base) {
+		if (((size_t)addr + n) <= dirty->base) return;
+		n -= (size_t)(dirty->base - addr);
+		addr = dirty->base;
+	}
+	i = (size_t)(addr - dirty->base);
+	if (i >= dirty->n_addrs) return;
+	end = i + n;
+	if (end > dirty->n_addrs) end = dirty->n_addrs;
+
+	/* Leading bits, whole bytes, trailing bits */
+	for (; (i<end) && ((i%8u)!=0u); ++i) {
+		dirty->bits[i/8u] |= (uint8_t)(1u << (i%8u));
+	}
+	if ((end-i) >= 8u) {
+		(void)memset(dirty->bits + (i/8u), 0xFF, (end-i)/8u);
+		i += ((end-i)/8u)*8u;
+	}
+	for (; i<end; ++i) {
+		dirty->bits[i/8u] |= (uint8_t)(1u << (i%8u));
+	}
+}
+
+extern size_t mbdirty_consume(
+	struct mbdirty_s *dirty,
+	struct mbdirty_range_s *ranges,
+	size_t max_ranges)
+{
+	size_t i, start, n_ranges;
+
+	if ((dirty==NULL) || (dirty->bits==NULL) || (ranges==NULL)) return 0u;
+
+	n_ranges = 0u;
+	for (i=0u; (i<dirty->n_addrs) && (n_ranges<max_ranges); ) {
+		if (dirty->bits[i/8u]==0u) { /* Skip clean bytes */
+			i = (i/8u + 1u)*8u;
+			continue;
+		}
+		if ((dirty->bits[i/8u] & (1u << (i%8u)))==0u) {
+			++i;
+			continue;
+		}
+
+		/* Take the run of set bits, clearing them */
+		start = i;
+		while ((i<dirty->n_addrs) && ((dirty->bits[i/8u] & (1u << (i%8u)))!=0u)) {
+			dirty->bits[i/8u] &= (uint8_t)~(1u << (i%8u));
+			++i;
+		}
+
+		ranges[n_ranges].start = (uint16_t)(dirty->base + start);
+		ranges[n_ranges].n = i - start;
+		++n_ranges;
+	}
+
+	return n_ranges;
+}
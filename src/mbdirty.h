@@ -0,0 +1,113 @@
+/**
+ * @file mbdirty.h
+ * @brief Modbus Dirty - Change tracking of written addresses
+ * @author Jonas Almås
+ *
+ * @details Optional tracking of the coil and holding register addresses written
+ * by a master. Writes set bits in an application supplied bitmap, and the
+ * application consumes them as merged address ranges, e.g. to apply only the
+ * setpoints changed since the last control cycle.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+#ifndef MBDIRTY_H_INCLUDED
+#define MBDIRTY_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Number of bitmap bytes needed to track n_addrs addresses */
+#define MBDIRTY_BITMAP_SIZE(n_addrs) (((n_addrs)+7u)/8u)
+
+/**
+ * @brief A range of written addresses
+ */
+struct mbdirty_range_s {
+	uint16_t start; /**< First written address */
+	size_t n; /**< Number of written addresses */
+};
+
+/**
+ * @brief Dirty bitmap of one map (coils or holding registers)
+ *
+ * Attached to an instance through mbinst_s::coils_dirty or
+ * mbinst_s::hold_regs_dirty. Bit i is set when address base+i is written,
+ * writes outside [base, base+n_addrs) are not tracked.
+ *
+ * @note Initialize with mbdirty_init()
+ * @note Not thread safe, consume from the thread handling requests or lock around both
+ */
+struct mbdirty_s {
+	uint8_t *bits; /**< Bitmap of MBDIRTY_BITMAP_SIZE(n_addrs) bytes */
+	uint16_t base; /**< First tracked address */
+	size_t n_addrs; /**< Number of tracked addresses */
+};
+
+/**
+ * @brief Initialize a dirty bitmap with nothing dirty
+ *
+ * @param dirty Bitmap to initialize
+ * @param bits Caller supplied storage
+ * @param bits_len Size of bits in bytes, at least MBDIRTY_BITMAP_SIZE(n_addrs)
+ * @param base First tracked address
+ * @param n_addrs Number of tracked addresses
+ *
+ * @retval 1 Initialized
+ * @retval 0 Storage too small or range past the address space, nothing is tracked
+ */
+extern int mbdirty_init(
+	struct mbdirty_s *dirty,
+	uint8_t *bits,
+	size_t bits_len,
+	uint16_t base,
+	size_t n_addrs);
+
+/**
+ * @brief Mark a range of addresses as written
+ *
+ * @param dirty Bitmap (Can be NULL)
+ * @param addr First address written
+ * @param n Number of addresses written
+ */
+extern void mbdirty_mark(struct mbdirty_s *dirty, uint16_t addr, size_t n);
+
+/**
+ * @brief Take the written addresses as merged ranges and clear them
+ *
+ * Ranges are returned in ascending address order. When there are more ranges
+ * than max_ranges, the remaining ones stay dirty for the next call.
+ *
+ * @param dirty Bitmap (Can be NULL)
+ * @param ranges Out parameter with the written ranges
+ * @param max_ranges Number of entries in ranges
+ *
+ * @return Number of ranges returned, 0 if nothing was written
+ */
+extern size_t mbdirty_consume(
+	struct mbdirty_s *dirty,
+	struct mbdirty_range_s *ranges,
+	size_t max_ranges);
+
+#endif /* MBDIRTY_H_INCLUDED */
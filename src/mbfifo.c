@@ -0,0 +1,89 @@
+/**
+ * @file mbfifo.c
+ * @brief Modbus FIFO Queue - Lock-free ring buffers read with function code 0x18
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbfifo.h"
+#include "mbatomic.h"
+#include "endian.h"
+#include "mbconfig.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#if MBCFG_FIFO
+
+extern int mbfifo_init(struct mbfifo_s *fifo)
+{
+	if ((fifo==NULL) || (fifo->buf==NULL)) return 0;
+	if ((fifo->size==0u) || (fifo->size > MBFIFO_SIZE_MAX)) return 0;
+	if ((fifo->size & (fifo->size - 1u)) != 0u) return 0;
+
+	fifo->head = 0u;
+	fifo->tail = 0u;
+
+	return 1;
+}
+
+extern int mbfifo_push(struct mbfifo_s *fifo, uint16_t val)
+{
+	uint16_t head = fifo->head;
+
+	if ((uint16_t)(head - fifo->tail) >= fifo->size) return 0;
+
+	fifo->buf[head & (fifo->size - 1u)] = val;
+	MBATOMIC_FENCE(); /* Entry stored before it is published */
+	fifo->head = (uint16_t)(head + 1u);
+
+	return 1;
+}
+
+extern size_t mbfifo_count(const struct mbfifo_s *fifo)
+{
+	return (uint16_t)(fifo->head - fifo->tail);
+}
+
+extern size_t mbfifo_drain(struct mbfifo_s *fifo, uint8_t *dst, size_t n_max)
+{
+	uint16_t tail = fifo->tail;
+	size_t i, n;
+
+	n = (uint16_t)(fifo->head - tail);
+	if (n > n_max) n = n_max;
+	MBATOMIC_FENCE(); /* Entries read after the head they were published with */
+
+	for (i=0u; i<n; ++i) {
+		u16tobe(fifo->buf[(tail + i) & (fifo->size - 1u)], dst + (2u*i));
+	}
+
+	MBATOMIC_FENCE(); /* Entries read before their slots are given back */
+	fifo->tail = (uint16_t)(tail + n);
+
+	return n;
+}
+
+#endif /* MBCFG_FIFO */
@@ -0,0 +1,112 @@
+/**
+ * @file mbfifo.h
+ * @brief Modbus FIFO Queue - Lock-free ring buffers read with function code 0x18
+ * @author Jonas Almås
+ *
+ * @details FIFO queues served by function code 0x18 (Read FIFO Queue). Each
+ * queue is a single-producer/single-consumer ring of 16-bit entries. The
+ * application, e.g. an ISR, pushes entries with mbfifo_push() and a master
+ * drains up to MBFIFO_READ_MAX entries per request. Neither side takes a lock,
+ * the producer only writes head and the consumer only writes tail.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBFIFO_H_INCLUDED
+#define MBFIFO_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+	MBFIFO_READ_MAX = 31u, /**< Maximum number of entries per Read FIFO Queue response */
+	MBFIFO_SIZE_MAX = 0x8000u, /**< Maximum number of entries of a ring */
+};
+
+/**
+ * @brief FIFO queue at one FIFO pointer address
+ *
+ * head and tail run freely and wrap at 2^16, the number of queued entries is
+ * head - tail. A slot is therefore never left unused, all size entries can be
+ * queued.
+ *
+ * @note Supports a single producer and a single consumer (one instance handling requests)
+ * @note Configuration fields are set by the application, head and tail are cleared by mbfifo_init()
+ */
+struct mbfifo_s {
+	uint16_t address; /**< FIFO pointer address of the request */
+	uint16_t *buf; /**< Caller supplied ring of size entries */
+	uint16_t size; /**< Number of entries in buf, power of two up to MBFIFO_SIZE_MAX */
+
+	volatile uint16_t head; /**< Next entry pushed, written by the producer only */
+	volatile uint16_t tail; /**< Next entry read, written by the consumer only */
+};
+
+/**
+ * @brief Initialize a FIFO queue as empty
+ *
+ * @param fifo FIFO with configuration fields set
+ *
+ * @retval 1 Success
+ * @retval 0 Invalid configuration
+ */
+extern int mbfifo_init(struct mbfifo_s *fifo);
+
+/**
+ * @brief Queue an entry (producer side)
+ *
+ * @param fifo FIFO
+ * @param val Entry value
+ *
+ * @retval 1 Entry queued
+ * @retval 0 FIFO full, entry dropped
+ *
+ * @note Safe to call from an ISR while requests are handled
+ */
+extern int mbfifo_push(struct mbfifo_s *fifo, uint16_t val);
+
+/**
+ * @brief Number of queued entries
+ *
+ * @param fifo FIFO
+ *
+ * @return Entries queued, a snapshot when called concurrently with either side
+ */
+extern size_t mbfifo_count(const struct mbfifo_s *fifo);
+
+/**
+ * @brief Remove entries and store them as big-endian words (consumer side)
+ *
+ * @param fifo FIFO
+ * @param dst Destination, 2*n_max bytes
+ * @param n_max Maximum number of entries to remove
+ *
+ * @return Number of entries removed
+ *
+ * @note Called by the library while handling requests
+ */
+extern size_t mbfifo_drain(struct mbfifo_s *fifo, uint8_t *dst, size_t n_max);
+
+#endif /* MBFIFO_H_INCLUDED */
@@ -45,7 +45,12 @@
  */
 
 #include "mbfile.h"
+#include "mbconfig.h"
+#include "mbpage.h"
 #include "mbreg.h"
+#include <string.h>
+
+#if MBCFG_FILES
 
 enum {BSEARCH_THRESHOLD=16u};
 
@@ -91,28 +96,210 @@ extern const struct mbfile_desc_s *mbfile_find(
 	return NULL;
 }
 
+/**
+ * @brief File number of a descriptor of a file map, see mbpage_build()
+ */
+static size_t file_keys(const void *map, size_t i, uint16_t *first)
+{
+	*first = ((const struct mbfile_desc_s *)map)[i].file_no;
+	return 1u;
+}
+
+extern size_t mbfile_index_size(
+	const struct mbfile_desc_s *files,
+	size_t n_files)
+{
+	return mbpage_size(files, n_files, file_keys);
+}
+
+extern int mbfile_index_build(
+	struct mbfile_index_s *ix,
+	const struct mbfile_desc_s *files,
+	size_t n_files,
+	uint16_t *storage,
+	size_t storage_len)
+{
+	if (ix==NULL) return 0;
+
+	ix->files = NULL;
+	ix->n_files = 0u;
+
+	if (!files || (n_files==0u)) {
+		ix->pages.dir = NULL;
+		ix->pages.leaves = NULL;
+		return 0;
+	}
+	if (!mbpage_build(&ix->pages, files, n_files, file_keys, storage, storage_len)) return 0;
+
+	ix->files = files;
+	ix->n_files = n_files;
+
+	return 1;
+}
+
+extern const struct mbfile_desc_s *mbfile_index_find(
+	const struct mbfile_index_s *ix,
+	const struct mbfile_desc_s *files,
+	size_t n_files,
+	uint16_t file_no)
+{
+	uint16_t pos;
+
+	if ((ix==NULL) || (ix->pages.dir==NULL) || (ix->files!=files) || (ix->n_files!=n_files)) {
+		return mbfile_find(files, n_files, file_no);
+	}
+
+	pos = mbpage_find(&ix->pages, file_no);
+	return (pos!=0u) ? (files + (pos - 1u)) : NULL;
+}
+
+/**
+ * @brief Read records of a file backed by a flat word array
+ */
+static enum mbfile_read_status_e read_words(
+	const struct mbfile_desc_s *file,
+	uint16_t record_no,
+	uint16_t record_length,
+	struct mbpdu_buf_s *res)
+{
+	const volatile uint16_t *src;
+	uint8_t *dst;
+	size_t i, n;
+	uint16_t v;
+
+	if ((size_t)record_no >= file->n_words) return MBFILE_READ_ILLEGAL_ADDR;
+	if (res==NULL) return MBFILE_READ_OK;
+
+	n = file->n_words - record_no;
+	if (n > record_length) n = record_length;
+
+	src = file->words + record_no;
+	dst = res->p + res->size;
+	for (i=0u; i<n; ++i) {
+		v = src[i];
+		dst[2u*i] = (uint8_t)(v >> 8);
+		dst[(2u*i)+1u] = (uint8_t)v;
+	}
+	(void)memset(dst + (2u*n), 0, 2u*(record_length-n)); /* Past the end of the file */
+	res->size += 2u*(size_t)record_length;
+
+	return MBFILE_READ_OK;
+}
+
+/**
+ * @brief Number of records in a region
+ */
+static size_t region_n_records(const struct mbfile_region_s *region)
+{
+	size_t n = region->size / 2u;
+	return (n > 0x10000u) ? 0x10000u : n;
+}
+
+/**
+ * @brief Read records of a file backed by a raw byte region, converting to big endian
+ */
+static enum mbfile_read_status_e read_region(
+	const struct mbfile_region_s *region,
+	uint16_t record_no,
+	uint16_t record_length,
+	struct mbpdu_buf_s *res)
+{
+	const volatile uint8_t *src;
+	uint8_t *dst;
+	size_t i, n, n_records;
+	uint8_t b;
+
+	if ((region->p==NULL) && (region->read_cb==NULL)) return MBFILE_READ_DEVICE_ERR;
+
+	n_records = region_n_records(region);
+	if ((size_t)record_no >= n_records) return MBFILE_READ_ILLEGAL_ADDR;
+	if (res==NULL) return MBFILE_READ_OK;
+
+	n = n_records - record_no;
+	if (n > record_length) n = record_length;
+
+	dst = res->p + res->size;
+	if (region->p==NULL) { /* Read into the response, then converted in place */
+		if (region->read_cb(record_no, n, dst)!=MB_OK) return MBFILE_READ_DEVICE_ERR;
+		if (!region->is_be) {
+			for (i=0u; i<(2u*n); i+=2u) {
+				b = dst[i];
+				dst[i] = dst[i+1u];
+				dst[i+1u] = b;
+			}
+		}
+	} else {
+		src = region->p + (2u*(size_t)record_no);
+		if (region->is_be) {
+			for (i=0u; i<(2u*n); ++i) {
+				dst[i] = src[i];
+			}
+		} else {
+			for (i=0u; i<(2u*n); i+=2u) {
+				dst[i] = src[i+1u];
+				dst[i+1u] = src[i];
+			}
+		}
+	}
+	(void)memset(dst + (2u*n), 0, 2u*(record_length-n)); /* Past the end of the file */
+	res->size += 2u*(size_t)record_length;
+
+	return MBFILE_READ_OK;
+}
+
+extern size_t mbfile_span_n_records(const struct mbfile_desc_s *file)
+{
+	const struct mbfile_region_s *region = file->region;
+
+	if ((region==NULL) || (region->p!=NULL) || (region->read_cb==NULL)) return 0u;
+	return region_n_records(region);
+}
+
 extern enum mbfile_read_status_e mbfile_read(
 	const struct mbfile_desc_s *file,
 	uint16_t record_no,
 	uint16_t record_length,
 	struct mbpdu_buf_s *res)
+{
+	struct mbreg_memo_s memo;
+
+	mbreg_memo_init(&memo);
+	return mbfile_read_memo(&memo, file, record_no, record_length, res);
+}
+
+extern enum mbfile_read_status_e mbfile_read_memo(
+	struct mbreg_memo_s *memo,
+	const struct mbfile_desc_s *file,
+	uint16_t record_no,
+	uint16_t record_length,
+	struct mbpdu_buf_s *res)
 {
 	uint16_t addr, reg_offs;
 	const struct mbreg_desc_s *reg;
+	struct mbreg_cursor_s cur;
 	size_t n_read_regs;
 
+	if (file->region!=NULL) {
+		return read_region(file->region, record_no, record_length, res);
+	}
+	if (file->words!=NULL) {
+		return read_words(file, record_no, record_length, res);
+	}
+
 	/* If we read multiple records and one of them doesn't exist,
 	   we just fill that with zero.
 	   We don't want to do this if the first record is missing.
 	 */
-	if (!mbreg_find_desc(file->records, file->n_records, record_no)) {
+	mbreg_cursor_init(&cur, NULL, file->records, file->n_records, record_no);
+	if (!mbreg_cursor_find(&cur, record_no)) {
 		return MBFILE_READ_ILLEGAL_ADDR;
 	}
 
 	for (reg_offs=0u; reg_offs < record_length; ) {
 		addr = record_no + reg_offs;
-		if ((reg = mbreg_find_desc(file->records, file->n_records, addr)) != NULL) {
-			n_read_regs = mbreg_read(
+		if ((reg = mbreg_cursor_find(&cur, addr)) != NULL) {
+			n_read_regs = mbreg_read_memo(
+				memo,
 				reg,
 				addr,
 				record_length-reg_offs,
@@ -155,18 +342,38 @@ extern int mbfile_write_allowed(
 	uint16_t record_no,
 	uint16_t record_length,
 	const uint8_t *val)
+{
+	return mbfile_write_plan(file, record_no, record_length, val, NULL);
+}
+
+extern int mbfile_write_plan(
+	const struct mbfile_desc_s *file,
+	uint16_t record_no,
+	uint16_t record_length,
+	const uint8_t *val,
+	uint16_t *plan)
 {
 	const struct mbreg_desc_s *reg;
+	struct mbreg_memo_s memo;
+	struct mbreg_cursor_s cur;
 	uint16_t addr, reg_offs;
 	size_t n_regs_written;
 
+	if (file->region!=NULL) {
+		return (file->region->write_cb!=NULL)
+			&& (((size_t)record_no + record_length) <= region_n_records(file->region));
+	}
+
+	mbreg_memo_init(&memo);
+	mbreg_cursor_init(&cur, NULL, file->records, file->n_records, record_no);
 	for (reg_offs=0u; reg_offs<record_length; ) {
 		addr = record_no + reg_offs;
-		if ((reg = mbreg_find_desc(file->records, file->n_records, addr)) == NULL) {
+		if ((reg = mbreg_cursor_find(&cur, addr)) == NULL) {
 			return 0;
 		}
 
-		n_regs_written = mbreg_write_allowed(
+		n_regs_written = mbreg_write_allowed_memo(
+			&memo,
 			reg,
 			addr,
 			record_no,
@@ -175,6 +382,9 @@ extern int mbfile_write_allowed(
 		if (n_regs_written == 0u) {
 			return 0;
 		}
+		if (plan!=NULL) {
+			plan[reg_offs] = (uint16_t)(reg - file->records);
+		}
 
 		/* Advance by the actual written register size to handle
 		   sub-registers correctly */
@@ -189,15 +399,35 @@ extern enum mbstatus_e mbfile_write(
 	uint16_t record_no,
 	uint16_t record_length,
 	const uint8_t *val)
+{
+	return mbfile_write_planned(file, record_no, record_length, val, NULL);
+}
+
+extern enum mbstatus_e mbfile_write_planned(
+	const struct mbfile_desc_s *file,
+	uint16_t record_no,
+	uint16_t record_length,
+	const uint8_t *val,
+	const uint16_t *plan)
 {
 	const struct mbreg_desc_s *reg;
+	struct mbreg_cursor_s cur;
 	enum mbstatus_e status;
 	uint16_t addr, reg_offs;
 	size_t n_regs_written;
 
+	if (file->region!=NULL) {
+		if (file->region->write_cb==NULL) return MB_DEV_FAIL;
+		return file->region->write_cb(record_no, record_length, val);
+	}
+
+	mbreg_cursor_init(&cur, NULL, file->records, file->n_records, record_no);
 	for (reg_offs=0u; reg_offs<record_length; ) {
 		addr = record_no + reg_offs;
-		reg = mbreg_find_desc(file->records, file->n_records, addr);
+		reg = (plan!=NULL)
+			? &file->records[plan[reg_offs]]
+			: mbreg_cursor_find(&cur, addr);
+		if (reg==NULL) return MB_DEV_FAIL;
 
 		status = mbreg_write(
 			reg,
@@ -208,8 +438,8 @@ extern enum mbstatus_e mbfile_write(
 		if (status!=MB_OK) return status;
 		if (n_regs_written==0u) return MB_DEV_FAIL;
 
-		if (reg->post_write_cb!=NULL) {
-			reg->post_write_cb();
+		if (MBREG_CB(reg, post_write_cb)!=NULL) {
+			MBREG_CB(reg, post_write_cb)();
 		}
 
 		/* Advance by the actual written register size to handle
@@ -219,3 +449,5 @@ extern enum mbstatus_e mbfile_write(
 
 	return MB_OK;
 }
+
+#endif /* MBCFG_FILES */
@@ -40,11 +40,62 @@
 #ifndef MBFILE_H_INCLUDED
 #define MBFILE_H_INCLUDED
 
+#include "mbpage.h"
 #include "mbreg.h"
 #include "mbpdu.h"
 #include <stddef.h>
 #include <stdint.h>
 
+/**
+ * @brief Raw byte region backing a file, e.g. a memory mapped file or flash window
+ *
+ * Record n of the file is the 16-bit word at byte offset 2*n of the region.
+ * Reads convert the words to big endian on the fly, no record descriptors
+ * are needed.
+ *
+ * @note A file covers at most 0x10000 records (128 KiB), larger regions are
+ *       split over several file numbers (see mbfile_desc_s::region)
+ * @note Records above 0x270F need mbinst_s::allow_ext_file_recs
+ */
+struct mbfile_region_s {
+	const volatile uint8_t *p; /**< Start of the region, or NULL to read through read_cb */
+	size_t size; /**< Size of the region in bytes, a trailing odd byte is not addressable */
+	int is_be; /**< Non-zero if words are stored big endian, little endian otherwise */
+
+	/**
+	 * @brief Write callback (optional)
+	 *
+	 * Called once per write sub-request with all of its records, so the
+	 * application can combine them into one flash or file write.
+	 *
+	 * @param record_no First record written
+	 * @param n Number of records
+	 * @param val Record values (big endian, n*2 bytes)
+	 *
+	 * @retval MB_OK Success
+	 * @retval mbstatus_e Exception code for failure
+	 *
+	 * @note The region is read only if NULL
+	 */
+	enum mbstatus_e (*write_cb)(uint16_t record_no, size_t n, const uint8_t *val);
+
+	/**
+	 * @brief Read callback for a region not mapped into memory (optional)
+	 *
+	 * Used when p is NULL, e.g. for a log in serial flash. Adjacent
+	 * sub-requests of one request are read with one call, so a log download
+	 * becomes one sequential read per request.
+	 *
+	 * @param record_no First record read
+	 * @param n Number of records
+	 * @param dst Record values as stored (byte order of is_be, n*2 bytes)
+	 *
+	 * @retval MB_OK Success
+	 * @retval mbstatus_e Failure, answered with a device failure exception
+	 */
+	enum mbstatus_e (*read_cb)(uint16_t record_no, size_t n, uint8_t *dst);
+};
+
 /**
  * @brief Modbus file descriptor for file record operations
  *
@@ -84,6 +135,31 @@ struct mbfile_desc_s {
 	 * Specifies the count of register record descriptors in the records array.
 	 */
 	size_t n_records;
+
+	/**
+	 * @brief Flat word array backing the file (optional)
+	 *
+	 * When set, record n of the file is words[n] and reads are served with one
+	 * copy from the array instead of searching records. Suited for large, read
+	 * only files such as event histories.
+	 *
+	 * @note Records past n_words read as zero, the first record must exist
+	 * @note Flat files are read only, records is used for writes
+	 */
+	const volatile uint16_t *words;
+
+	/**
+	 * @brief Number of entries in words
+	 */
+	size_t n_words;
+
+	/**
+	 * @brief Raw byte region backing the file (optional)
+	 *
+	 * When set, records and words are not used. Several file numbers can share
+	 * one mapping through regions at different offsets.
+	 */
+	const struct mbfile_region_s *region;
 };
 
 enum mbfile_read_status_e {
@@ -113,19 +189,81 @@ extern const struct mbfile_desc_s *mbfile_find(
 	size_t n_files,
 	uint16_t file_no);
 
+/**
+ * @brief Paged file number index for a file map, see mbpage_s
+ *
+ * @note The index must be rebuilt if the file map it was built for changes
+ */
+struct mbfile_index_s {
+	const struct mbfile_desc_s *files; /**< File map the index was built for */
+	size_t n_files; /**< Number of descriptors in files */
+	struct mbpage_s pages; /**< Page table of descriptor positions */
+};
+
+/**
+ * @brief Get number of storage entries required by mbfile_index_build()
+ *
+ * @param files Array of file descriptors (must be sorted by file_no in ascending order)
+ * @param n_files Number of entries in the files array
+ *
+ * @return Number of uint16_t storage entries, 0 for an unsorted map
+ */
+extern size_t mbfile_index_size(
+	const struct mbfile_desc_s *files,
+	size_t n_files);
+
+/**
+ * @brief Build a paged index for a file map
+ *
+ * @param ix Index to initialize
+ * @param files Array of file descriptors (must be sorted by file_no in ascending order)
+ * @param n_files Number of entries in the files array
+ * @param storage Caller supplied storage of mbfile_index_size() entries
+ * @param storage_len Number of entries in storage
+ *
+ * @retval 1 Index built
+ * @retval 0 Index could not be built (Too little storage, unsorted map etc.)
+ *
+ * @note On failure the index is left empty and lookups fall back to mbfile_find()
+ * @note Time complexity: O(n_files). Lookups: O(1)
+ */
+extern int mbfile_index_build(
+	struct mbfile_index_s *ix,
+	const struct mbfile_desc_s *files,
+	size_t n_files,
+	uint16_t *storage,
+	size_t storage_len);
+
+/**
+ * @brief Find a file descriptor by file number using an index if available
+ *
+ * @param ix Index for the file map (Can be NULL)
+ * @param files Array of file descriptors (must be sorted by file_no in ascending order)
+ * @param n_files Number of entries in the files array
+ * @param file_no Modbus file number to search for
+ *
+ * @return Pointer to matching file descriptor, or NULL if not found
+ */
+extern const struct mbfile_desc_s *mbfile_index_find(
+	const struct mbfile_index_s *ix,
+	const struct mbfile_desc_s *files,
+	size_t n_files,
+	uint16_t file_no);
+
 /**
  * @brief Read data from a file record
  *
  * @param file Pointer to the file descriptor containing the target record
  * @param record_no Starting record number within the file (0-based index)
  * @param record_length Number of 16-bit registers to read from the record
- * @param res Pointer to response buffer structure to populate with read data
+ * @param res Pointer to response buffer structure to populate with read data (NULL to only validate)
  *
  * @retval MBFILE_READ_OK Success - data copied to response buffer
  * @retval MBFILE_READ_ILLEGAL_ADDR Invalid record number or length
  * @retval MBFILE_READ_DEVICE_ERR Internal error during read operation
  *
  * @note The response buffer (res) must have sufficient space for the requested data
+ * @note Record descriptors are looked up with a cursor, once per descriptor spanned
  */
 extern enum mbfile_read_status_e mbfile_read(
 	const struct mbfile_desc_s *file,
@@ -133,6 +271,33 @@ extern enum mbfile_read_status_e mbfile_read(
 	uint16_t record_length,
 	struct mbpdu_buf_s *res);
 
+/**
+ * @brief Read data from a file record, with the lock and function results of the current request
+ *
+ * Same as mbfile_read(), records of several sub-requests sharing memo call
+ * each lock and read function once.
+ *
+ * @param memo Memo of the current request (Can be NULL)
+ */
+extern enum mbfile_read_status_e mbfile_read_memo(
+	struct mbreg_memo_s *memo,
+	const struct mbfile_desc_s *file,
+	uint16_t record_no,
+	uint16_t record_length,
+	struct mbpdu_buf_s *res);
+
+/**
+ * @brief Number of records of a file read through mbfile_region_s::read_cb
+ *
+ * Adjacent sub-requests of such files are read together with one
+ * mbfile_read() of their whole span.
+ *
+ * @param file File descriptor
+ *
+ * @return Number of records, 0 for files read otherwise
+ */
+extern size_t mbfile_span_n_records(const struct mbfile_desc_s *file);
+
 /**
  * @brief Validate whether a file record write operation is allowed
  *
@@ -173,4 +338,47 @@ extern enum mbstatus_e mbfile_write(
 	uint16_t record_length,
 	const uint8_t *val);
 
+/**
+ * @brief Validate a file record write and record the descriptors to write
+ *
+ * Same as mbfile_write_allowed(), also storing the index into
+ * mbfile_desc_s::records of the descriptor written at each validated register
+ * offset, so mbfile_write_planned() does not search for them again.
+ *
+ * @param file Pointer to the file descriptor containing the target record
+ * @param record_no Starting record number within the file (0-based index)
+ * @param record_length Number of 16-bit registers to write to the record
+ * @param val Pointer to the data values to be written (for validation purposes)
+ * @param plan Out parameter of record_length entries (Can be NULL)
+ *
+ * @retval 1 Write allowed
+ * @retval 0 Write not allowed
+ *
+ * @note The plan is not used by files with a region
+ */
+extern int mbfile_write_plan(
+	const struct mbfile_desc_s *file,
+	uint16_t record_no,
+	uint16_t record_length,
+	const uint8_t *val,
+	uint16_t *plan);
+
+/**
+ * @brief Write data to a file record validated by mbfile_write_plan()
+ *
+ * @param file Pointer to the file descriptor containing the target record
+ * @param record_no Starting record number within the file (0-based index)
+ * @param record_length Number of 16-bit registers to write to the record
+ * @param val Pointer to the data values to write (in big endian)
+ * @param plan Plan filled by mbfile_write_plan() for the same write, or NULL to search the descriptors
+ *
+ * @note Calls post_write_cb callbacks if defined on the target registers
+ */
+extern enum mbstatus_e mbfile_write_planned(
+	const struct mbfile_desc_s *file,
+	uint16_t record_no,
+	uint16_t record_length,
+	const uint8_t *val,
+	const uint16_t *plan);
+
 #endif /* MBFILE_H_INCLUDED */
@@ -41,15 +41,33 @@
 
 #include "mbfn_coils.h"
 #include "endian.h"
+#include "mbconfig.h"
+#include "mbdirty.h"
+#include "mbstats.h"
+#include "mbtrace.h"
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
+#if MBCFG_COILS || MBCFG_DISC_INPUTS
+
 enum {
 	MBCOIL_N_READ_MAX=0x07D0u,
 	MBCOIL_N_WRITE_MAX=0x07B0u,
 };
 
+/**
+ * @brief Get the index of a coil map of the instance, if any
+ */
+static const struct mbcoil_index_s *map_index(
+	const struct mbinst_s *inst,
+	const struct mbcoil_desc_s *coils)
+{
+	if (coils==inst->coils) return inst->coils_ix;
+	if (coils==inst->disc_inputs) return inst->disc_inputs_ix;
+	return NULL;
+}
+
 extern enum mbstatus_e mbfn_read_coils(
 	const struct mbinst_s *inst,
 	const struct mbcoil_desc_s *coils,
@@ -60,8 +78,11 @@ extern enum mbstatus_e mbfn_read_coils(
 {
 	uint16_t start_addr, quantity, addr;
 	uint8_t byte_count;
-	size_t i;
+	size_t i, n;
+	enum mbstatus_e status;
+	struct mbcoil_cursor_s cur;
 	const struct mbcoil_desc_s *coil;
+	uint64_t t_trace;
 
 	if ((inst==NULL) || (coils==NULL) || (req==NULL) || (res==NULL)) {
 		return MB_DEV_FAIL;
@@ -86,7 +107,13 @@ extern enum mbstatus_e mbfn_read_coils(
 	   we just leave it as zero.
 	   We don't want to do this if the first coil is missing.
 	 */
-	if (!mbcoil_find_desc(coils, n_coils, start_addr)) {
+	t_trace = mbtrace_now(inst->trace);
+	mbcoil_cursor_init(&cur, map_index(inst, coils), coils, n_coils, start_addr);
+	mbstats_count_lookup(inst->stats,
+		(req[0]==MBFC_READ_DISC_INPUTS) ? MBSTATS_MAP_DISC_INPUTS : MBSTATS_MAP_COILS);
+	coil = mbcoil_cursor_find(&cur, start_addr);
+	mbtrace_emit(inst->trace, MBTRACE_EV_LOOKUP, req[0], start_addr, t_trace);
+	if (coil==NULL) {
 		return MB_ILLEGAL_DATA_ADDR;
 	}
 
@@ -96,27 +123,25 @@ extern enum mbstatus_e mbfn_read_coils(
 
 	(void)memset(res->p+2u, 0, byte_count); /* Clear all response bytes */
 
-	/* Read coils */
-	for (i=0u; i<quantity; ++i) {
+	/* Read coils, whole blocks at a time */
+	for (i=0u; i<quantity; ) {
 		addr = start_addr + (uint16_t)i;
-		if ((coil = mbcoil_find_desc(coils, n_coils, addr)) != NULL) {
-			switch (mbcoil_read(coil)) {
-			case MBCOIL_READ_OFF: break;
-			case MBCOIL_READ_ON:
-				res->p[2u + (i/8u)] |= (uint8_t)(1u << (i % 8u));
-				break;
-			case MBCOIL_READ_LOCKED: return MB_ILLEGAL_DATA_ADDR;
-			case MBCOIL_READ_NO_ACCESS: break; /* Leave coils without read access as 0 */
-			case MBCOIL_READ_DEV_FAIL: return MB_DEV_FAIL;
-			default: return MB_DEV_FAIL;
+		if ((coil = mbcoil_cursor_find(&cur, addr)) != NULL) {
+			status = mbcoil_read_bits(coil, addr, quantity-i, res->p+2u, i, &n);
+			if (status!=MB_OK) {
+				return status;
 			}
+			i += n;
+		} else {
+			/* Missing coils are left as 0 (already cleared above), the gap up to the next coil is skipped at once */
+			i += mbcoil_cursor_gap(&cur, addr, quantity-i);
 		}
-		/* If coil doesn't exist, it's left as 0 (already cleared above) */
 	}
 
 	return MB_OK;
 }
 
+#if MBCFG_COILS
 extern enum mbstatus_e mbfn_write_coil(
 	const struct mbinst_s *inst,
 	const struct mbcoil_desc_s *coils,
@@ -126,8 +151,11 @@ extern enum mbstatus_e mbfn_write_coil(
 	struct mbpdu_buf_s *res)
 {
 	uint16_t coil_addr, coil_value;
+	uint8_t value;
+	size_t n_written;
 	enum mbstatus_e status;
 	const struct mbcoil_desc_s *coil;
+	uint64_t t_trace;
 
 	if ((inst==NULL) || (coils==NULL) || (req==NULL) || (res==NULL)) {
 		return MB_DEV_FAIL;
@@ -149,7 +177,10 @@ extern enum mbstatus_e mbfn_write_coil(
 		return MB_ILLEGAL_DATA_VAL;
 	}
 
-	coil = mbcoil_find_desc(coils, n_coils, coil_addr);
+	value = (coil_value==MBCOIL_ON) ? 1u : 0u;
+
+	coil = mbcoil_index_find(map_index(inst, coils), coils, n_coils, coil_addr);
+	mbstats_count_lookup(inst->stats, MBSTATS_MAP_COILS);
 	if (coil==NULL) {
 		return MB_ILLEGAL_DATA_ADDR;
 	}
@@ -158,16 +189,19 @@ extern enum mbstatus_e mbfn_write_coil(
 		return MB_ILLEGAL_DATA_ADDR;
 	}
 
-	status = mbcoil_write(coil, !!coil_value);
-	if (status!=MB_OK) {
+	status = mbcoil_write_bits(coil, coil_addr, 1u, &value, 0u, &n_written);
+	if ((status!=MB_OK) && (status!=MB_PENDING)) {
 		return status;
 	}
+	mbdirty_mark(inst->coils_dirty, coil_addr, 1u);
 
 	if (coil->post_write_cb!=NULL) {
-		coil->post_write_cb();
+		mbtrace_call(inst->trace, req[0], coil_addr, coil->post_write_cb);
 	}
 	if (inst->commit_coils_write_cb!=NULL) {
+		t_trace = mbtrace_now(inst->trace);
 		inst->commit_coils_write_cb(inst);
+		mbtrace_emit(inst->trace, MBTRACE_EV_CB, req[0], coil_addr, t_trace);
 	}
 
 	/* Prepare response (echo the request) */
@@ -177,7 +211,7 @@ extern enum mbstatus_e mbfn_write_coil(
 	res->p[4] = req[4];
 	res->size = 5u;
 
-	return MB_OK;
+	return status;
 }
 
 extern enum mbstatus_e mbfn_write_coils(
@@ -190,9 +224,11 @@ extern enum mbstatus_e mbfn_write_coils(
 {
 	uint16_t start_addr, quantity, addr;
 	uint8_t byte_count;
-	size_t i;
-	enum mbstatus_e status;
+	size_t i, n;
+	enum mbstatus_e status, res_status;
+	struct mbcoil_cursor_s cur;
 	const struct mbcoil_desc_s *coil;
+	uint64_t t_trace;
 
 	if ((inst==NULL) || (coils==NULL) || (req==NULL) || (res==NULL)) {
 		return MB_DEV_FAIL;
@@ -225,35 +261,55 @@ extern enum mbstatus_e mbfn_write_coils(
 	}
 
 	/* Ensure all coils exist and can be written to before writing anything */
-	for (i=0u; i<quantity; ++i) {
+	t_trace = mbtrace_now(inst->trace);
+	mbcoil_cursor_init(&cur, map_index(inst, coils), coils, n_coils, start_addr);
+	mbstats_count_lookup(inst->stats, MBSTATS_MAP_COILS);
+	mbtrace_emit(inst->trace, MBTRACE_EV_LOOKUP, req[0], start_addr, t_trace);
+	for (i=0u; i<quantity; ) {
 		addr = start_addr + (uint16_t)i;
-		if ((coil = mbcoil_find_desc(coils, n_coils, addr)) == NULL) {
+		if ((coil = mbcoil_cursor_find(&cur, addr)) == NULL) {
 			return MB_ILLEGAL_DATA_ADDR;
 		}
 
 		if (!mbcoil_write_allowed(coil)) {
 			return MB_ILLEGAL_DATA_ADDR;
 		}
+
+		/* Skip the rest of a block */
+		i += (coil->n_block_entries > 1u)
+			? ((size_t)coil->address + coil->n_block_entries - (size_t)addr)
+			: 1u;
 	}
 
-	/* Write coils */
-	for (i=0u; i<quantity; ++i) {
+	/* Write coils, whole blocks and runs sharing a byte at a time. A write callback may defer completion (MB_PENDING) */
+	res_status = MB_OK;
+	mbcoil_cursor_init(&cur, map_index(inst, coils), coils, n_coils, start_addr);
+	mbstats_count_lookup(inst->stats, MBSTATS_MAP_COILS);
+	for (i=0u; i<quantity; ) {
 		addr = start_addr + (uint16_t)i;
-		coil = mbcoil_find_desc(coils, n_coils, addr);
+		coil = mbcoil_cursor_find(&cur, addr);
 
-		status = mbcoil_write(coil, !!(req[6u + (i/8u)] & (uint8_t)(1u << (i%8u))));
-		if (status!=MB_OK) {
+		status = mbcoil_cursor_write_bits(&cur, addr, quantity-i, req+6u, i, &n);
+		if (status==MB_PENDING) {
+			if (res_status==MB_PENDING) return MB_DEV_FAIL; /* One deferred callback per request */
+			res_status = MB_PENDING;
+		} else if (status!=MB_OK) {
 			return status;
 		}
+		mbdirty_mark(inst->coils_dirty, addr, n);
 
 		if (coil->post_write_cb!=NULL) {
-			coil->post_write_cb();
+			mbtrace_call(inst->trace, req[0], addr, coil->post_write_cb);
 		}
+
+		i += n;
 	}
 
 	/* Call commit callback if it exists */
 	if (inst->commit_coils_write_cb!=NULL) {
+		t_trace = mbtrace_now(inst->trace);
 		inst->commit_coils_write_cb(inst);
+		mbtrace_emit(inst->trace, MBTRACE_EV_CB, req[0], start_addr, t_trace);
 	}
 
 	/* Prepare response */
@@ -261,5 +317,8 @@ extern enum mbstatus_e mbfn_write_coils(
 	u16tobe(quantity, res->p+3u);
 	res->size = 5u;
 
-	return MB_OK;
+	return res_status;
 }
+#endif /* MBCFG_COILS */
+
+#endif /* MBCFG_COILS || MBCFG_DISC_INPUTS */
@@ -0,0 +1,134 @@
+/**
+ * @file mbfn_devid.c
+ * @brief Implementation of the Modbus device identification function handler
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbfn_devid.h"
+#include "mbconfig.h"
+#include "mbdevid.h"
+#include "mbpdu.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if MBCFG_DEVID
+
+enum {
+	/**
+	 * Function code (1 byte)
+	 * MEI type (1 byte)
+	 * Read Device ID code (1 byte)
+	 * Object id (1 byte)
+	 */
+	REQ_SIZE=4u,
+
+	/**
+	 * Function code (1 byte)
+	 * MEI type (1 byte)
+	 * Read Device ID code (1 byte)
+	 * Conformity level (1 byte)
+	 * More follows (1 byte)
+	 * Next object id (1 byte)
+	 * Number of objects (1 byte)
+	 */
+	RES_HEADER_SIZE=7u,
+	RES_OBJS_SIZE_MAX=MBPDU_SIZE_MAX-RES_HEADER_SIZE,
+
+	MORE_FOLLOWS=0xFFu,
+};
+
+/**
+ * @brief Offset of a serialized object
+ *
+ * @return Offset in mbdevid_s::buf, or mbdevid_s::len if there is no object with the id
+ */
+static size_t find_obj(const struct mbdevid_s *devid, uint8_t id)
+{
+	size_t offs=0u;
+
+	while ((offs < devid->len) && (devid->buf[offs] < id)) {
+		offs += 2u + devid->buf[offs+1u];
+	}
+
+	return ((offs < devid->len) && (devid->buf[offs]==id)) ? offs : devid->len;
+}
+
+extern enum mbstatus_e mbfn_read_dev_id(
+	const struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbpdu_buf_s *res)
+{
+	const struct mbdevid_s *devid;
+	uint8_t last, n_objs=0u, more=0u, next=0u;
+	size_t start, end, obj_size;
+
+	if ((inst==NULL) || (inst->devid==NULL) || (req==NULL) || (res==NULL)) return MB_DEV_FAIL;
+	if (req_len != REQ_SIZE) return MB_ILLEGAL_DATA_VAL;
+
+	devid = inst->devid;
+	switch (req[2]) {
+	case MBDEVID_BASIC: last = MBDEVID_MAJOR_MINOR_REV; break;
+	case MBDEVID_REGULAR: last = MBDEVID_EXTENDED_FIRST - 1u; break;
+	case MBDEVID_EXTENDED: last = 0xFFu; break;
+	case MBDEVID_INDIVIDUAL: last = req[3]; break;
+	default: return MB_ILLEGAL_DATA_VAL;
+	}
+
+	start = find_obj(devid, req[3]);
+	if (start >= devid->len) {
+		if (req[2]==MBDEVID_INDIVIDUAL) return MB_ILLEGAL_DATA_ADDR;
+		start = 0u; /* Unknown object id, restart the stream */
+	} else if (devid->buf[start] > last) {
+		start = 0u;
+	}
+
+	/* Run of whole objects of the category fitting in the response */
+	for (end=start; (end < devid->len) && (devid->buf[end] <= last); end+=obj_size) {
+		obj_size = 2u + devid->buf[end+1u];
+		if (((end - start) + obj_size) > RES_OBJS_SIZE_MAX) {
+			more = MORE_FOLLOWS;
+			next = devid->buf[end];
+			break;
+		}
+		++n_objs;
+	}
+
+	res->p[1] = MBMEI_READ_DEV_ID;
+	res->p[2] = req[2];
+	res->p[3] = devid->conformity;
+	res->p[4] = more;
+	res->p[5] = next;
+	res->p[6] = n_objs;
+	(void)memcpy(res->p+RES_HEADER_SIZE, devid->buf+start, end-start);
+	res->size = RES_HEADER_SIZE + (end - start);
+
+	return MB_OK;
+}
+
+#endif /* MBCFG_DEVID */
@@ -0,0 +1,75 @@
+/**
+ * @file mbfn_devid.h
+ * @brief Modbus device identification function handler - Read device identification
+ * @author Jonas Almås
+ *
+ * @details This module implements Modbus function code 0x2B with MEI type 0x0E
+ * (Read Device Identification) on the precomputed objects of an instance, see
+ * mbdevid.h.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBFN_DEVID_H_INCLUDED
+#define MBFN_DEVID_H_INCLUDED
+
+#include "mbdef.h"
+#include "mbinst.h"
+#include "mbpdu.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Reads device identification objects
+ *
+ * Implements Modbus function code 0x2B / MEI type 0x0E (Read Device
+ * Identification). Stream access (codes 0x01 to 0x03) returns the objects of
+ * the category from the requested object id on, as many as fit in the
+ * response. When objects are left, "more follows" is set and the next object
+ * id tells the master where to continue. An object id without an object
+ * restarts the stream at object 0x00. Individual access (code 0x04) returns
+ * one object.
+ *
+ * @param inst Modbus instance containing the device identification
+ * @param req Pointer to the request PDU
+ * @param req_len Length of the request PDU in bytes
+ * @param res Pointer to the response PDU structure to populate
+ *
+ * @retval MB_OK Success - response data populated with the objects
+ * @retval MB_DEV_FAIL Invalid parameters
+ * @retval MB_ILLEGAL_DATA_VAL Invalid request length or Read Device ID code
+ * @retval MB_ILLEGAL_DATA_ADDR No object with the id of an individual access
+ *
+ * @note Request format: [function_code][mei_type][read_dev_id_code][object_id]
+ * @note Response format: [function_code][mei_type][read_dev_id_code][conformity][more_follows][next_object_id][n_objects][objects...]
+ * @note Object format: [object_id][object_length][value...]
+ */
+extern enum mbstatus_e mbfn_read_dev_id(
+	const struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbpdu_buf_s *res);
+
+#endif /* MBFN_DEVID_H_INCLUDED */
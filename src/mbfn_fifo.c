@@ -0,0 +1,83 @@
+/**
+ * @file mbfn_fifo.c
+ * @brief Implementation of the Modbus FIFO function handler
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbfn_fifo.h"
+#include "mbconfig.h"
+#include "endian.h"
+#include "mbfifo.h"
+#include "mbpdu.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#if MBCFG_FIFO
+
+enum {
+	/**
+	 * Function code (1 byte)
+	 * FIFO pointer address (2 bytes)
+	 */
+	REQ_SIZE=3u,
+
+	/**
+	 * Function code (1 byte)
+	 * Byte count (2 bytes)
+	 * FIFO count (2 bytes)
+	 */
+	RES_HEADER_SIZE=5u,
+};
+
+extern enum mbstatus_e mbfn_read_fifo(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbpdu_buf_s *res)
+{
+	uint16_t addr;
+	size_t i, n;
+
+	if ((inst==NULL) || (req==NULL) || (res==NULL)) return MB_DEV_FAIL;
+	if (req_len != REQ_SIZE) return MB_ILLEGAL_DATA_VAL;
+
+	addr = betou16(req+1u);
+	for (i=0u; i<inst->n_fifos; ++i) {
+		if (inst->fifos[i].address==addr) break;
+	}
+	if (i>=inst->n_fifos) return MB_ILLEGAL_DATA_ADDR;
+
+	n = mbfifo_drain(&inst->fifos[i], res->p+RES_HEADER_SIZE, MBFIFO_READ_MAX);
+
+	u16tobe((uint16_t)(2u + (2u*n)), res->p+1u);
+	u16tobe((uint16_t)n, res->p+3u);
+	res->size = RES_HEADER_SIZE + (2u*n);
+
+	return MB_OK;
+}
+
+#endif /* MBCFG_FIFO */
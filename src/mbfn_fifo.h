@@ -0,0 +1,74 @@
+/**
+ * @file mbfn_fifo.h
+ * @brief Modbus FIFO function handler - Read FIFO queue
+ * @author Jonas Almås
+ *
+ * @details This module implements Modbus function code 0x18 (Read FIFO Queue)
+ * on the FIFO queues of an instance, see mbfifo.h.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBFN_FIFO_H_INCLUDED
+#define MBFN_FIFO_H_INCLUDED
+
+#include "mbdef.h"
+#include "mbinst.h"
+#include "mbpdu.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Drains entries from a FIFO queue
+ *
+ * Implements Modbus function code 0x18 (Read FIFO Queue). Up to
+ * MBFIFO_READ_MAX queued entries are removed from the FIFO at the requested
+ * FIFO pointer address and returned, oldest first. Entries left in the queue
+ * are returned by the next request.
+ *
+ * @param inst Modbus instance containing the FIFO queues
+ * @param req Pointer to the request PDU
+ * @param req_len Length of the request PDU in bytes
+ * @param res Pointer to the response PDU structure to populate
+ *
+ * @retval MB_OK Success - response data populated with the entries
+ * @retval MB_DEV_FAIL Invalid parameters
+ * @retval MB_ILLEGAL_DATA_VAL Invalid request length
+ * @retval MB_ILLEGAL_DATA_ADDR No FIFO at the FIFO pointer address
+ *
+ * @note Request format: [function_code][fifo_addr_hi][fifo_addr_lo]
+ * @note Response format: [function_code][byte_count_hi][byte_count_lo][fifo_count_hi][fifo_count_lo][values...]
+ * @note Entries are removed when the response is built, a response lost on the way to the master loses them
+ * @note Rather than the exception of the specification for more than 31 queued
+ *       entries, the oldest 31 are returned so a FIFO filled faster than it is
+ *       polled is still drained
+ */
+extern enum mbstatus_e mbfn_read_fifo(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbpdu_buf_s *res);
+
+#endif /* MBFN_FIFO_H_INCLUDED */
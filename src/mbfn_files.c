@@ -39,13 +39,19 @@
  */
 
 #include "mbfn_files.h"
+#include "mbconfig.h"
 #include "endian.h"
+#include "mbarena.h"
 #include "mbfile.h"
 #include "mbpdu.h"
+#include "mbstats.h"
+#include "mbtrace.h"
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
+#if MBCFG_FILES
+
 enum {
 	/**
 	 * Function code (1 byte)
@@ -69,6 +75,8 @@ enum {
 	 * (252 - 2) - ((252 - 2) % 7)
 	 */
 	READ_REQ_MAX_BYTE_COUNT=0xF5,
+
+	READ_MAX_SUB_REQS = READ_REQ_MAX_BYTE_COUNT / READ_SUB_REQ_SIZE,
 };
 
 enum {
@@ -126,6 +134,9 @@ enum {
 	WRITE_REQ_MIN_SIZE = WRITE_REQ_HEADER_SIZE + WRITE_SUB_REQ_MIN_SIZE,
 
 	WRITE_REQ_MAX_BYTE_COUNT = MBPDU_DATA_SIZE_MAX - WRITE_REQ_HEADER_SIZE,
+
+	WRITE_MAX_SUB_REQS = WRITE_REQ_MAX_BYTE_COUNT / WRITE_SUB_REQ_MIN_SIZE,
+	WRITE_PLAN_MAX = (WRITE_REQ_MAX_BYTE_COUNT - WRITE_SUB_REQ_HEADER_SIZE) / 2u, /* Registers of all sub requests */
 };
 
 enum {
@@ -138,6 +149,102 @@ enum {
 enum {REF_TYPE=0x06u};
 enum {MAX_REC_NO=0x270Fu};
 
+/**
+ * @brief Find a file, reusing the previous result when the file number repeats
+ */
+static const struct mbfile_desc_s *find_file(
+	const struct mbinst_s *inst,
+	uint8_t fc,
+	uint16_t file_no,
+	const struct mbfile_desc_s *prev)
+{
+	const struct mbfile_desc_s *file;
+	uint64_t t_trace;
+
+	if ((prev!=NULL) && (prev->file_no==file_no)) return prev;
+
+	t_trace = mbtrace_now(inst->trace);
+	mbstats_count_lookup(inst->stats, MBSTATS_MAP_FILES);
+	file = mbfile_index_find(inst->files_ix, inst->files, inst->n_files, file_no);
+	mbtrace_emit(inst->trace, MBTRACE_EV_LOOKUP, fc, file_no, t_trace);
+	return file;
+}
+
+/**
+ * @brief Number of sub-requests continuing the records of the sub-request at p, see mbfile_span_n_records()
+ *
+ * @param p First sub-request of the run
+ * @param n_left Sub-requests from p to the end of the request
+ * @param span_length Set to the records of the whole run
+ */
+static size_t span_run(
+	const struct mbfile_desc_s *file,
+	const uint8_t *p,
+	size_t n_left,
+	uint16_t *span_length)
+{
+	size_t n_run, n_records;
+	uint32_t next_no;
+
+	n_records = mbfile_span_n_records(file);
+	next_no = (uint32_t)betou16(p + READ_SUB_REQ_REC_NO_POS) + betou16(p + READ_SUB_REQ_REC_LEN_POS);
+	*span_length = betou16(p + READ_SUB_REQ_REC_LEN_POS);
+	if (n_records==0u) return 1u;
+
+	/* A sub-request starting past the end fails on its own */
+	for (n_run=1u; n_run<n_left; ++n_run) {
+		p += READ_SUB_REQ_SIZE;
+		if ((betou16(p + READ_SUB_REQ_FILE_NO_POS) != file->file_no)
+				|| (betou16(p + READ_SUB_REQ_REC_NO_POS) != next_no)
+				|| (next_no >= n_records)) {
+			break;
+		}
+		next_no += betou16(p + READ_SUB_REQ_REC_LEN_POS);
+		*span_length = (uint16_t)(*span_length + betou16(p + READ_SUB_REQ_REC_LEN_POS));
+	}
+	return n_run;
+}
+
+/**
+ * @brief Read a run of adjacent sub-requests with one read of the file
+ *
+ * The records of the whole run are read after the first sub-response header,
+ * then moved apart, starting from the last sub-request, to make room for the
+ * headers of the others.
+ *
+ * @param p First sub-request of the run
+ */
+static enum mbfile_read_status_e read_run(
+	const struct mbfile_desc_s *file,
+	const uint8_t *p,
+	size_t n_run,
+	uint16_t span_length,
+	struct mbpdu_buf_s *res)
+{
+	enum mbfile_read_status_e status;
+	size_t k, len, src, dst;
+
+	res->size += READ_SUB_RESP_HEADER_SIZE;
+	status = mbfile_read(file, betou16(p + READ_SUB_REQ_REC_NO_POS), span_length, res);
+	if (status!=MBFILE_READ_OK) return status;
+
+	src = res->size;
+	dst = res->size + ((n_run - 1u) * READ_SUB_RESP_HEADER_SIZE);
+	res->size = dst;
+	for (k=n_run; k-->0u; ) {
+		len = 2u * (size_t)betou16(p + (k*READ_SUB_REQ_SIZE) + READ_SUB_REQ_REC_LEN_POS);
+		src -= len;
+		dst -= len;
+		if (dst!=src) {
+			(void)memmove(res->p + dst, res->p + src, len);
+		}
+		dst -= READ_SUB_RESP_HEADER_SIZE;
+		res->p[dst + READ_SUB_RESP_LEN_POS] = (uint8_t)(1u + len); /* File resp. length */
+		res->p[dst + READ_SUB_RESP_REF_TYPE_POS] = REF_TYPE;
+	}
+	return MBFILE_READ_OK;
+}
+
 extern enum mbstatus_e mbfn_file_read(
 	const struct mbinst_s *inst,
 	const uint8_t *req,
@@ -146,10 +253,12 @@ extern enum mbstatus_e mbfn_file_read(
 {
 	uint8_t byte_count;
 	size_t resp_byte_count;
-	size_t i, n_sub_reqs;
+	size_t i, n_sub_reqs, n_run;
 	const uint8_t *p;
 	uint16_t file_no, record_no, record_length;
 	const struct mbfile_desc_s *file;
+	struct mbreg_memo_s memo;
+	enum mbfile_read_status_e status;
 
 	if ((inst==NULL) || (req==NULL) || (res==NULL)) return MB_DEV_FAIL;
 	if (req[0]!=MBFC_READ_FILE_RECORD) return MB_DEV_FAIL;
@@ -203,23 +312,37 @@ extern enum mbstatus_e mbfn_file_read(
 	res->p[1] = (uint8_t)resp_byte_count;
 	res->size = 2u;
 
-	for (i=0u; i<n_sub_reqs; ++i) {
+	/* Sub-requests often read the same records, so read functions and locks
+	   are called once per request */
+	mbreg_memo_init(&memo);
+	memo.fn_cache = inst->fn_cache;
+
+	file = NULL;
+	for (i=0u; i<n_sub_reqs; i+=n_run) {
 		p = req + READ_REQ_HEADER_SIZE + (i*READ_SUB_REQ_SIZE);
 
-		file_no = betou16(p + READ_SUB_REQ_FILE_NO_POS);
 		record_no = betou16(p + READ_SUB_REQ_REC_NO_POS);
 		record_length = betou16(p + READ_SUB_REQ_REC_LEN_POS);
 
-		file = mbfile_find(inst->files, inst->n_files, file_no);
+		/* Files are resolved once the whole request is valid, an unknown
+		   file only fails after all sub-requests passed the format checks */
+		file = find_file(inst, MBFC_READ_FILE_RECORD, betou16(p + READ_SUB_REQ_FILE_NO_POS), file);
 		if (file==NULL) {
 			return MB_ILLEGAL_DATA_ADDR;
 		}
 
-		res->p[res->size + READ_SUB_RESP_LEN_POS] = (uint8_t)(1u + (record_length * 2u)); /* File resp. length */
-		res->p[res->size + READ_SUB_RESP_REF_TYPE_POS] = REF_TYPE;
-		res->size += READ_SUB_RESP_HEADER_SIZE;
+		/* Adjacent sub-requests of a file in serial flash (E.g. a log download) are read as one span */
+		n_run = span_run(file, p, n_sub_reqs - i, &record_length);
+		if (n_run > 1u) {
+			status = read_run(file, p, n_run, record_length, res);
+		} else {
+			res->p[res->size + READ_SUB_RESP_LEN_POS] = (uint8_t)(1u + (record_length * 2u)); /* File resp. length */
+			res->p[res->size + READ_SUB_RESP_REF_TYPE_POS] = REF_TYPE;
+			res->size += READ_SUB_RESP_HEADER_SIZE;
+			status = mbfile_read_memo(&memo, file, record_no, record_length, res);
+		}
 
-		switch (mbfile_read(file, record_no, record_length, res)) {
+		switch (status) {
 		case MBFILE_READ_OK: break;
 		case MBFILE_READ_ILLEGAL_ADDR: return MB_ILLEGAL_DATA_ADDR;
 		case MBFILE_READ_DEVICE_ERR: return MB_DEV_FAIL;
@@ -241,6 +364,10 @@ extern enum mbstatus_e mbfn_file_write(
 	const uint8_t *p, *base;
 	uint16_t file_no, record_no, record_length;
 	const struct mbfile_desc_s *file;
+	const struct mbfile_desc_s **files; /* Resolved while validating (Can be NULL) */
+	uint16_t *plan; /* Record descriptors of all sub requests, see mbfile_write_plan() (Can be NULL) */
+	size_t i, n_sub_reqs, plan_pos;
+	uint64_t t_trace;
 	enum mbstatus_e status;
 
 	if ((inst==NULL) || (req==NULL) || (res==NULL)) return MB_DEV_FAIL;
@@ -258,10 +385,20 @@ extern enum mbstatus_e mbfn_file_write(
 		return MB_ILLEGAL_DATA_VAL;
 	}
 
+	/* Without scratch memory for both, files and descriptors are searched again when writing */
+	files = mbarena_alloc(inst->arena, (byte_count / WRITE_SUB_REQ_MIN_SIZE) * sizeof files[0]);
+	plan = (files!=NULL) ? mbarena_alloc(inst->arena, (byte_count / 2u) * sizeof plan[0]) : NULL;
+	if (plan==NULL) {
+		files = NULL;
+	}
+
 	/* Validate request and ensure all registers in all files can be written
 	   to before writing anything. */
 	base = req + WRITE_REQ_HEADER_SIZE;
 	p = base;
+	file = NULL;
+	n_sub_reqs = 0u;
+	plan_pos = 0u;
 	while ((p-base) < byte_count) {
 		remaining_bytes = (size_t)byte_count - (size_t)(p-base);
 		if (remaining_bytes < WRITE_SUB_REQ_MIN_SIZE) {
@@ -287,18 +424,23 @@ extern enum mbstatus_e mbfn_file_write(
 			return MB_ILLEGAL_DATA_VAL;
 		}
 
-		file = mbfile_find(inst->files, inst->n_files, file_no);
+		file = find_file(inst, MBFC_WRITE_FILE_RECORD, file_no, file);
 		if (file==NULL) {
 			return MB_ILLEGAL_DATA_ADDR;
 		}
+		if (files!=NULL) {
+			files[n_sub_reqs] = file;
+		}
+		++n_sub_reqs;
 
 		p += WRITE_SUB_REQ_HEADER_SIZE;
 
-		if (!mbfile_write_allowed(file, record_no, record_length, p)) {
+		if (!mbfile_write_plan(file, record_no, record_length, p, (plan!=NULL) ? (plan+plan_pos) : NULL)) {
 			return MB_ILLEGAL_DATA_ADDR;
 		}
 
 		p += record_length * 2u;
+		plan_pos += record_length;
 	}
 
 	res->p[1] = byte_count;
@@ -307,14 +449,22 @@ extern enum mbstatus_e mbfn_file_write(
 	/* Write the actual data */
 	base = req + WRITE_REQ_HEADER_SIZE;
 	p = base;
-	while ((p-base) < byte_count) {
+	file = NULL;
+	plan_pos = 0u;
+	for (i=0u; i<n_sub_reqs; ++i) {
 		file_no = betou16(p + WRITE_SUB_REQ_FILE_NO_POS);
 		record_no = betou16(p + WRITE_SUB_REQ_REC_NO_POS);
 		record_length = betou16(p + WRITE_SUB_REQ_REC_LEN_POS);
 		p += WRITE_SUB_REQ_HEADER_SIZE;
 
-		file = mbfile_find(inst->files, inst->n_files, file_no);
-		status = mbfile_write(file, record_no, record_length, p);
+		if (files!=NULL) {
+			file = files[i];
+			status = mbfile_write_planned(file, record_no, record_length, p, plan+plan_pos);
+		} else {
+			file = find_file(inst, MBFC_WRITE_FILE_RECORD, file_no, file);
+			status = mbfile_write_planned(file, record_no, record_length, p, NULL);
+		}
+		plan_pos += record_length;
 		if (status != MB_OK) { /* Request might be incomplete, not ideal... */
 			return status;
 		}
@@ -333,8 +483,12 @@ extern enum mbstatus_e mbfn_file_write(
 	}
 
 	if (inst->commit_regs_write_cb!=NULL) {
+		t_trace = mbtrace_now(inst->trace);
 		inst->commit_regs_write_cb(inst);
+		mbtrace_emit(inst->trace, MBTRACE_EV_CB, MBFC_WRITE_FILE_RECORD, 0u, t_trace);
 	}
 
 	return MB_OK;
 }
+
+#endif /* MBCFG_FILES */
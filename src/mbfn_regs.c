@@ -45,9 +45,21 @@
 
 #include "mbfn_regs.h"
 #include "endian.h"
+#include "mbarena.h"
+#include "mbcommit.h"
+#include "mbconfig.h"
+#include "mbdirty.h"
+#include "mbimage.h"
+#include "mbplan.h"
 #include "mbreg.h"
+#include "mbseqlock.h"
+#include "mbstats.h"
+#include "mbtrace.h"
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+
+#if MBCFG_HOLD_REGS || MBCFG_INPUT_REGS
 
 enum {
 	MBREG_N_READ_MAX=0x7Du,
@@ -55,18 +67,115 @@ enum {
 	MBREG_N_RW_WRITE_MAX=0x79u, /* Fc 0x17 */
 };
 
-static enum mbstatus_e read_regs(
+/**
+ * @brief Get the precompiled index for a register map, if any
+ */
+static const struct mbreg_index_s *map_index(
+	const struct mbinst_s *inst,
+	int is_hold_reg)
+{
+	return is_hold_reg ? inst->hold_regs_ix : inst->input_regs_ix;
+}
+
+/**
+ * @brief Kernel table of a register map, NULL if regs is not the map of the instance
+ */
+static const struct mbreg_kernel_s *map_kernels(
+	const struct mbinst_s *inst,
+	const struct mbreg_desc_s *regs,
+	int is_hold_reg)
+{
+	if (is_hold_reg) {
+		return (regs==inst->hold_regs) ? inst->hold_regs_kern : NULL;
+	} else {
+		return (regs==inst->input_regs) ? inst->input_regs_kern : NULL;
+	}
+}
+
+/**
+ * @brief Read the registers of one descriptor, or of a run of bulk descriptors
+ *
+ * @return Number of registers read, or one of the MBREG_READ_* values
+ */
+static size_t read_desc(
+	struct mbreg_memo_s *memo,
+	const struct mbinst_s *inst,
+	const struct mbreg_kernel_s *kern,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	const struct mbreg_desc_s *reg,
+	uint16_t addr,
+	uint16_t n_left,
+	uint8_t *dst,
+	int is_hold_reg)
+{
+	const uint8_t fc = is_hold_reg ? MBFC_READ_HOLDING_REGS : MBFC_READ_INPUT_REGS;
+	uint64_t t_trace = mbtrace_now(inst->trace);
+	size_t n_read_regs;
+
+	if ((reg->access & MRACC_R_MASK) == MRACC_R_BULK) { /* Merge adjacent bulk registers */
+		n_read_regs = mbreg_read_bulk_run(
+			memo,
+			reg,
+			n_regs - (size_t)(reg - regs) - 1u,
+			addr,
+			n_left,
+			dst);
+	} else {
+		n_read_regs = mbreg_read_kernel(
+			memo,
+			(kern!=NULL) ? &kern[reg - regs] : NULL,
+			reg,
+			addr,
+			n_left,
+			dst,
+			inst->swap_words && !is_hold_reg);
+	}
+	if ((reg->access & (MRACC_R_FN|MRACC_R_BULK)) != 0u) {
+		mbtrace_emit(inst->trace, MBTRACE_EV_CB, fc, addr, t_trace);
+	}
+
+	return n_read_regs;
+}
+
+/**
+ * @brief Status of a read_desc() result, MB_OK when registers were read
+ */
+static enum mbstatus_e read_status(size_t n_read_regs)
+{
+	if (n_read_regs==MBREG_READ_DEV_FAIL) {
+		return MB_DEV_FAIL;
+	} else if (n_read_regs==MBREG_READ_LOCKED) {
+		return MB_ILLEGAL_DATA_ADDR;
+	}
+	return MB_OK;
+}
+
+/**
+ * @brief Walk the map for a read, recording the descriptors into rec
+ *
+ * @param rec Plan being recorded (Can be NULL)
+ */
+static enum mbstatus_e read_regs_once(
+	struct mbreg_memo_s *memo,
 	const struct mbinst_s *inst,
 	const struct mbreg_desc_s *regs,
 	size_t n_regs,
 	uint16_t start_addr,
 	uint16_t n_req_regs,
 	struct mbpdu_buf_s *res,
-	int is_hold_reg)
+	int is_hold_reg,
+	const struct mbreg_cursor_s *at,
+	struct mbplan_entry_s *rec)
 {
+	const struct mbreg_kernel_s *kern = map_kernels(inst, regs, is_hold_reg);
+	const uint8_t fc = is_hold_reg ? MBFC_READ_HOLDING_REGS : MBFC_READ_INPUT_REGS;
+	struct mbreg_cursor_s cur;
 	const struct mbreg_desc_s *reg;
+	enum mbstatus_e status;
 	uint16_t addr, reg_offs;
 	size_t n_read_regs;
+	uint64_t t_trace;
 
 	if ((n_req_regs==0u) || (n_req_regs>MBREG_N_READ_MAX)) {
 		return MB_ILLEGAL_DATA_VAL;
@@ -76,7 +185,17 @@ static enum mbstatus_e read_regs(
 	   we just fill that with zero.
 	   We don't want to do this if the first register is missing.
 	 */
-	if (!mbreg_find_desc(regs, n_regs, start_addr)) {
+	if (at!=NULL) {
+		cur = *at;
+		reg = mbreg_cursor_find(&cur, start_addr);
+	} else {
+		t_trace = mbtrace_now(inst->trace);
+		mbreg_cursor_init(&cur, map_index(inst, is_hold_reg), regs, n_regs, start_addr);
+		mbstats_count_lookup(inst->stats, is_hold_reg ? MBSTATS_MAP_HOLD_REGS : MBSTATS_MAP_INPUT_REGS);
+		reg = mbreg_cursor_find(&cur, start_addr);
+		mbtrace_emit(inst->trace, MBTRACE_EV_LOOKUP, fc, start_addr, t_trace);
+	}
+	if (reg==NULL) {
 		return MB_ILLEGAL_DATA_ADDR;
 	}
 
@@ -85,23 +204,29 @@ static enum mbstatus_e read_regs(
 		res->size = 2u;
 	}
 
+	mbplan_rewind(rec);
+
 	/* Read register value into response data */
 	for (reg_offs=0u; reg_offs < n_req_regs; ) {
 		addr = start_addr + reg_offs;
-		if ((reg = mbreg_find_desc(regs, n_regs, addr)) != NULL) {
-			n_read_regs = mbreg_read(
+		if ((reg = mbreg_cursor_find(&cur, addr)) != NULL) {
+			n_read_regs = read_desc(
+				memo,
+				inst,
+				kern,
+				regs,
+				n_regs,
 				reg,
 				addr,
 				n_req_regs-reg_offs,
 				res ? (res->p + res->size) : NULL,
-				inst->swap_words && !is_hold_reg);
-			if (n_read_regs==MBREG_READ_DEV_FAIL) {
-				return MB_DEV_FAIL;
-			} else if (n_read_regs==MBREG_READ_LOCKED) {
-				return MB_ILLEGAL_DATA_ADDR;
+				is_hold_reg);
+			if ((status=read_status(n_read_regs))!=MB_OK) {
+				return status;
 			} else if (n_read_regs!=MBREG_READ_NO_ACCESS) {
 				if (res!=NULL) {res->size += n_read_regs*2u;}
 			}
+			mbplan_step(rec, (size_t)(reg - regs), n_read_regs);
 
 			reg_offs += (uint16_t)n_read_regs;
 		} else {
@@ -110,6 +235,7 @@ static enum mbstatus_e read_regs(
 				res->p[res->size+1u] = 0x00u;
 				res->size += 2u;
 			}
+			mbplan_hole(rec);
 			++reg_offs;
 		}
 	}
@@ -117,6 +243,175 @@ static enum mbstatus_e read_regs(
 	return MB_OK;
 }
 
+/**
+ * @brief Read through a recorded plan, without searching the map
+ *
+ * @param stale Set when a descriptor read a different number of registers
+ *              than recorded, the read is then to be walked again
+ */
+static enum mbstatus_e read_regs_planned(
+	struct mbreg_memo_s *memo,
+	const struct mbinst_s *inst,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	const struct mbplan_entry_s *plan,
+	struct mbpdu_buf_s *res,
+	int is_hold_reg,
+	int *stale)
+{
+	const struct mbreg_kernel_s *kern = map_kernels(inst, regs, is_hold_reg);
+	const struct mbplan_step_s *step;
+	enum mbstatus_e status;
+	uint16_t reg_offs;
+	size_t i, n_read_regs;
+
+	res->p[1] = (uint8_t)(2u * plan->n); /* Byte count */
+	res->size = 2u;
+
+	for (i=0u, reg_offs=0u; i<plan->n_steps; ++i) {
+		step = &plan->steps[i];
+		if (step->reg_ix==MBPLAN_HOLE) {
+			(void)memset(res->p + res->size, 0, 2u * (size_t)step->n);
+			res->size += 2u * (size_t)step->n;
+			reg_offs += step->n;
+			continue;
+		}
+
+		n_read_regs = read_desc(
+			memo,
+			inst,
+			kern,
+			regs,
+			n_regs,
+			&regs[step->reg_ix],
+			(uint16_t)(plan->start + reg_offs),
+			(uint16_t)(plan->n - reg_offs),
+			res->p + res->size,
+			is_hold_reg);
+		if ((status=read_status(n_read_regs))!=MB_OK) {
+			return status;
+		} else if (n_read_regs!=step->n) {
+			*stale = 1;
+			return MB_OK;
+		}
+		res->size += n_read_regs*2u;
+		reg_offs += step->n;
+	}
+
+	return MB_OK;
+}
+
+/**
+ * @brief Read once, through the plan when there is one and else by walking the map
+ */
+static enum mbstatus_e read_regs_walk(
+	struct mbreg_memo_s *memo,
+	const struct mbinst_s *inst,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t start_addr,
+	uint16_t n_req_regs,
+	struct mbpdu_buf_s *res,
+	int is_hold_reg,
+	const struct mbreg_cursor_s *at,
+	struct mbplan_entry_s **plan,
+	struct mbplan_entry_s *rec)
+{
+	enum mbstatus_e status;
+	int stale = 0;
+
+	if (*plan!=NULL) {
+		status = read_regs_planned(memo, inst, regs, n_regs, *plan, res, is_hold_reg, &stale);
+		if (!stale) return status;
+		mbplan_done(*plan, regs, 0);
+		*plan = NULL;
+	}
+
+	return read_regs_once(memo, inst, regs, n_regs, start_addr, n_req_regs, res, is_hold_reg, at, rec);
+}
+
+/**
+ * @brief Read registers, from the image or as a seqlock snapshot when configured
+ *
+ * @param at Cursor positioned at or before start_addr, searched for when NULL
+ */
+static enum mbstatus_e read_regs(
+	const struct mbinst_s *inst,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t start_addr,
+	uint16_t n_req_regs,
+	struct mbpdu_buf_s *res,
+	int is_hold_reg,
+	const struct mbreg_cursor_s *at)
+{
+	const struct mbseqlock_s *lock = is_hold_reg ? inst->hold_regs_lock : inst->input_regs_lock;
+	const struct mbimage_s *img = is_hold_reg ? inst->hold_regs_image : inst->input_regs_image;
+	const uint8_t fc = is_hold_reg ? MBFC_READ_HOLDING_REGS : MBFC_READ_INPUT_REGS;
+	struct mbplan_entry_s *plan, *rec;
+	struct mbreg_memo_s memo;
+	enum mbstatus_e status;
+	uint32_t seq;
+	int attempt;
+
+	/* Ranges inside the published image are copied from it */
+	if ((res!=NULL)
+			&& (n_req_regs!=0u)
+			&& (n_req_regs<=MBREG_N_READ_MAX)
+			&& mbimage_covers(img, start_addr, n_req_regs)) {
+		status = mbimage_read(img, start_addr, n_req_regs, res->p+2u);
+		if (status!=MB_OK) return status;
+		res->p[1] = (uint8_t)(2u * n_req_regs); /* Byte count */
+		res->size = 2u + (2u * (size_t)n_req_regs);
+		return MB_OK;
+	}
+
+	/* Read locks and functions are evaluated once for the whole span,
+	   function values are only kept across requests without a snapshot */
+	mbreg_memo_init(&memo);
+	if (lock==NULL) {memo.fn_cache = inst->fn_cache;}
+
+	/* Dry runs only check access and take no snapshot */
+	if (res==NULL) {
+		return read_regs_once(&memo, inst, regs, n_regs, start_addr, n_req_regs, res, is_hold_reg, at, NULL);
+	}
+
+	/* A repeated read of a range follows its plan, others record one */
+	plan = NULL;
+	rec = NULL;
+	if ((at==NULL) && (n_req_regs!=0u) && (n_req_regs<=MBREG_N_READ_MAX)) {
+		plan = mbplan_find(inst->plan, fc, regs, n_regs, start_addr, n_req_regs);
+		if (plan==NULL) {
+			rec = mbplan_record(inst->plan, fc, regs, n_regs, start_addr, n_req_regs);
+		}
+	}
+
+	if (lock==NULL) {
+		status = read_regs_walk(&memo, inst, regs, n_regs, start_addr, n_req_regs, res, is_hold_reg, at, &plan, rec);
+		mbplan_done(rec, regs, status==MB_OK);
+		return status;
+	}
+
+	for (attempt=0; attempt<MBSEQLOCK_READ_ATTEMPTS; ++attempt) {
+		seq = mbseqlock_read_begin(lock);
+		mbreg_memo_drop_vals(&memo);
+		status = read_regs_walk(&memo, inst, regs, n_regs, start_addr, n_req_regs, res, is_hold_reg, at, &plan, rec);
+		if (!mbseqlock_read_retry(lock, seq)) {
+			mbplan_done(rec, regs, status==MB_OK);
+			return status;
+		}
+	}
+
+	mbplan_done(rec, regs, 0);
+	return MB_BUSY;
+}
+
+#if MBCFG_HOLD_REGS
+/**
+ * @brief Validate and then write holding registers
+ *
+ * @param at Cursor positioned at or before start_addr, searched for when NULL
+ */
 static enum mbstatus_e write_regs(
 	const struct mbinst_s *inst,
 	const struct mbreg_desc_s *regs,
@@ -124,21 +419,42 @@ static enum mbstatus_e write_regs(
 	uint16_t start_addr,
 	uint16_t n_req_regs,
 	const uint8_t *req_write_data,
-	struct mbpdu_buf_s *res)
+	struct mbpdu_buf_s *res,
+	const struct mbreg_cursor_s *at)
 {
+	const struct mbreg_index_s *ix = map_index(inst, 1);
+	const struct mbreg_kernel_s *kern = map_kernels(inst, regs, 1);
+	struct mbreg_memo_s memo;
+	struct mbreg_cursor_s cur;
 	const struct mbreg_desc_s *reg;
-	enum mbstatus_e status;
+	enum mbstatus_e status, res_status;
 	uint16_t reg_offs, addr;
-	size_t n_regs_written;
-
-	/* Ensure all registers exist and can be written to before writing anything */
+	size_t n_regs_written, reg_ix;
+	uint16_t *plan; /* Descriptor index by register offset, set while validating (Can be NULL) */
+	uint64_t t_trace;
+
+	if (n_req_regs>MBREG_N_WRITE_MAX) return MB_ILLEGAL_DATA_VAL;
+	plan = mbarena_alloc(inst->arena, n_req_regs * sizeof plan[0]);
+
+	/* Ensure all registers exist and can be written to before writing anything,
+	   write locks are evaluated once per lock callback for the whole span */
+	mbreg_memo_init(&memo);
+	if (at!=NULL) {
+		cur = *at;
+	} else {
+		t_trace = mbtrace_now(inst->trace);
+		mbreg_cursor_init(&cur, ix, regs, n_regs, start_addr);
+		mbstats_count_lookup(inst->stats, MBSTATS_MAP_HOLD_REGS);
+		mbtrace_emit(inst->trace, MBTRACE_EV_LOOKUP, MBFC_WRITE_MULTIPLE_REGS, start_addr, t_trace);
+	}
 	for (reg_offs=0u; reg_offs < n_req_regs; ) {
 		addr = start_addr + reg_offs;
-		if ((reg = mbreg_find_desc(regs, n_regs, addr)) == NULL) {
+		if ((reg = mbreg_cursor_find(&cur, addr)) == NULL) {
 			return MB_ILLEGAL_DATA_ADDR;
 		}
 
-		n_regs_written = mbreg_write_allowed(
+		n_regs_written = mbreg_write_allowed_memo(
+			&memo,
 			reg,
 			addr,
 			start_addr,
@@ -147,28 +463,59 @@ static enum mbstatus_e write_regs(
 		if (n_regs_written == 0u) {
 			return MB_ILLEGAL_DATA_ADDR;
 		}
+		if (plan!=NULL) {
+			plan[reg_offs] = (uint16_t)(reg - regs);
+		}
 
 		/* Advance by the actual written register size to handle
 		   sub-registers correctly */
 		reg_offs += (uint16_t)n_regs_written;
 	}
 
-	/* Write registers */
+	/* Write registers, a write callback may defer completion (MB_PENDING).
+	   Offsets reached here are the ones validated above, so the descriptors
+	   are taken from the plan instead of searched again. Without scratch
+	   memory for the plan they are found again with the cursor. */
+	res_status = MB_OK;
+	if (at!=NULL) {
+		cur = *at;
+	} else {
+		mbreg_cursor_init(&cur, ix, regs, n_regs, start_addr);
+	}
 	for (reg_offs=0u; reg_offs < n_req_regs; ) {
 		addr = start_addr + reg_offs;
-		reg = mbreg_find_desc(regs, n_regs, addr);
+		reg = (plan!=NULL) ? &regs[plan[reg_offs]] : mbreg_cursor_find(&cur, addr);
+		if (reg==NULL) return MB_DEV_FAIL;
+		reg_ix = (size_t)(reg - regs);
 
-		status = mbreg_write(
-			reg,
-			addr,
-			n_req_regs-reg_offs,
-			req_write_data + (reg_offs*2u),
-			&n_regs_written);
-		if (status!=MB_OK) return status;
+		if ((reg->access & MRACC_W_MASK) == MRACC_W_BULK) { /* Merge adjacent bulk registers */
+			status = mbreg_write_bulk_run(
+				reg,
+				n_regs - reg_ix - 1u,
+				addr,
+				n_req_regs-reg_offs,
+				req_write_data + (reg_offs*2u),
+				&n_regs_written);
+		} else {
+			status = mbreg_write_kernel(
+				(kern!=NULL) ? &kern[reg_ix] : NULL,
+				reg,
+				addr,
+				n_req_regs-reg_offs,
+				req_write_data + (reg_offs*2u),
+				&n_regs_written);
+		}
+		if (status==MB_PENDING) {
+			if (res_status==MB_PENDING) return MB_DEV_FAIL; /* One deferred callback per request */
+			res_status = MB_PENDING;
+		} else if (status!=MB_OK) {
+			return status;
+		}
 		if (n_regs_written==0u) return MB_DEV_FAIL;
+		mbdirty_mark(inst->hold_regs_dirty, addr, n_regs_written);
 
-		if (reg->post_write_cb!=NULL) {
-			reg->post_write_cb();
+		if (MBREG_CB(reg, post_write_cb)!=NULL) {
+			mbtrace_call(inst->trace, MBFC_WRITE_MULTIPLE_REGS, addr, MBREG_CB(reg, post_write_cb));
 		}
 
 		/* Advance by the actual written register size to handle
@@ -176,9 +523,7 @@ static enum mbstatus_e write_regs(
 		reg_offs += (uint16_t)n_regs_written;
 	}
 
-	if (inst->commit_regs_write_cb!=NULL) {
-		inst->commit_regs_write_cb(inst);
-	}
+	mbcommit_regs_written(inst, start_addr, n_req_regs);
 
 	/* Prepare response */
 	if (res!=NULL) {
@@ -187,8 +532,9 @@ static enum mbstatus_e write_regs(
 		res->size = 5u;
 	}
 
-	return MB_OK;
+	return res_status;
 }
+#endif /* MBCFG_HOLD_REGS */
 
 extern enum mbstatus_e mbfn_read_regs(
 	const struct mbinst_s *inst,
@@ -220,9 +566,11 @@ extern enum mbstatus_e mbfn_read_regs(
 		start_addr,
 		n_req_regs,
 		res,
-		req[0] == MBFC_READ_HOLDING_REGS);
+		req[0] == MBFC_READ_HOLDING_REGS,
+		NULL);
 }
 
+#if MBCFG_HOLD_REGS
 extern enum mbstatus_e mbfn_write_reg(
 	const struct mbinst_s *inst,
 	const struct mbreg_desc_s *regs,
@@ -248,7 +596,8 @@ extern enum mbstatus_e mbfn_write_reg(
 
 	addr = betou16(req+1u);
 
-	if ((reg = mbreg_find_desc(regs, n_regs, addr)) == NULL) {
+	mbstats_count_lookup(inst->stats, MBSTATS_MAP_HOLD_REGS);
+	if ((reg = mbreg_index_find(map_index(inst, 1), regs, n_regs, addr)) == NULL) {
 		return MB_ILLEGAL_DATA_ADDR;
 	}
 
@@ -257,15 +606,14 @@ extern enum mbstatus_e mbfn_write_reg(
 	}
 
 	status = mbreg_write(reg, addr, 1u, req+3u, &n_written);
-	if (status!=MB_OK) return status;
+	if ((status!=MB_OK) && (status!=MB_PENDING)) return status;
 	if (n_written!=1u) return MB_DEV_FAIL;
+	mbdirty_mark(inst->hold_regs_dirty, addr, 1u);
 
-	if (reg->post_write_cb!=NULL) {
-		reg->post_write_cb();
-	}
-	if (inst->commit_regs_write_cb!=NULL) {
-		inst->commit_regs_write_cb(inst);
+	if (MBREG_CB(reg, post_write_cb)!=NULL) {
+		mbtrace_call(inst->trace, req[0], addr, MBREG_CB(reg, post_write_cb));
 	}
+	mbcommit_regs_written(inst, addr, 1u);
 
 	/* Prepare response */
 	res->p[1] = req[1];
@@ -274,7 +622,7 @@ extern enum mbstatus_e mbfn_write_reg(
 	res->p[4] = req[4];
 	res->size = 5u;
 
-	return MB_OK;
+	return status;
 }
 
 extern enum mbstatus_e mbfn_write_regs(
@@ -324,9 +672,12 @@ extern enum mbstatus_e mbfn_write_regs(
 		start_addr,
 		n_req_regs,
 		req+6u,
-		res);
+		res,
+		NULL);
 }
+#endif /* MBCFG_HOLD_REGS */
 
+#if MBCFG_MASK_WRITE_REG
 extern enum mbstatus_e mb_fn_mask_write_reg(
 	const struct mbinst_s *inst,
 	const struct mbreg_desc_s *regs,
@@ -353,7 +704,8 @@ extern enum mbstatus_e mb_fn_mask_write_reg(
 	and_mask = betou16(req+3u);
 	or_mask = betou16(req+5u);
 
-	if ((reg = mbreg_find_desc(regs, n_regs, addr)) == NULL) {
+	mbstats_count_lookup(inst->stats, MBSTATS_MAP_HOLD_REGS);
+	if ((reg = mbreg_index_find(map_index(inst, 1), regs, n_regs, addr)) == NULL) {
 		return MB_ILLEGAL_DATA_ADDR;
 	}
 
@@ -362,14 +714,13 @@ extern enum mbstatus_e mb_fn_mask_write_reg(
 	}
 
 	status = mbreg_mask_write(reg, addr, and_mask, or_mask);
-	if (status!=MB_OK) return status;
+	if ((status!=MB_OK) && (status!=MB_PENDING)) return status;
+	mbdirty_mark(inst->hold_regs_dirty, addr, 1u);
 
-	if (reg->post_write_cb!=NULL) {
-		reg->post_write_cb();
-	}
-	if (inst->commit_regs_write_cb!=NULL) {
-		inst->commit_regs_write_cb(inst);
+	if (MBREG_CB(reg, post_write_cb)!=NULL) {
+		mbtrace_call(inst->trace, req[0], addr, MBREG_CB(reg, post_write_cb));
 	}
+	mbcommit_regs_written(inst, addr, 1u);
 
 	/* Prepare success response */
 	u16tobe(addr, res->p+1u);
@@ -377,10 +728,28 @@ extern enum mbstatus_e mb_fn_mask_write_reg(
 	u16tobe(or_mask, res->p+5u);
 	res->size = 7u;
 
-	return MB_OK;
+	return status;
 }
+#endif /* MBCFG_MASK_WRITE_REG */
 
-extern enum mbstatus_e mbfn_read_write_regs(
+#if MBCFG_READ_WRITE_REGS
+/**
+ * @brief Enter or leave the application scope of a read/write request, see mbinst_s::read_write_scope_cb
+ */
+static void rw_scope(const struct mbinst_s *inst, int begin)
+{
+	if (inst->read_write_scope_cb!=NULL) inst->read_write_scope_cb(inst, begin);
+}
+
+/**
+ * @brief Validate, write and read of a read/write request, inside the scope
+ *
+ * Both ranges are resolved from one lookup of the lower start address when
+ * they overlap or are adjacent, as in handshakes (write command, read status).
+ * The dry run, the write and the read then continue the walk from that
+ * cursor instead of searching the map again.
+ */
+static enum mbstatus_e read_write_regs(
 	const struct mbinst_s *inst,
 	const struct mbreg_desc_s *regs,
 	size_t n_regs,
@@ -388,22 +757,15 @@ extern enum mbstatus_e mbfn_read_write_regs(
 	size_t req_len,
 	struct mbpdu_buf_s *res)
 {
+	struct mbreg_cursor_s cur;
+	const struct mbreg_cursor_s *at;
 	enum mbstatus_e status;
 	uint16_t read_start_addr, n_read_regs;
 	uint16_t write_start_addr, n_write_regs;
+	uint16_t first_addr;
+	uint32_t first_end, second_addr;
 	uint8_t write_byte_count;
-
-	if ((inst==NULL) || (regs==NULL) || (req==NULL) || (res==NULL)) return MB_DEV_FAIL;
-
-	if (req[0]!=MBFC_READ_WRITE_REGS) {
-		return MB_DEV_FAIL;
-	}
-
-	/* Check that request data is at least big enough for 'read start addr', 'read n regs', 'write addr',
-	   'write n regs' and 'write byte count' */
-	if (req_len < 10u) {
-		return MB_ILLEGAL_DATA_VAL;
-	}
+	uint64_t t_trace;
 
 	read_start_addr = betou16(req+1u);
 	n_read_regs = betou16(req+3u);
@@ -412,6 +774,25 @@ extern enum mbstatus_e mbfn_read_write_regs(
 	n_write_regs = betou16(req+7u);
 	write_byte_count = req[9];
 
+	if (read_start_addr <= write_start_addr) {
+		first_addr = read_start_addr;
+		first_end = (uint32_t)read_start_addr + n_read_regs;
+		second_addr = write_start_addr;
+	} else {
+		first_addr = write_start_addr;
+		first_end = (uint32_t)write_start_addr + n_write_regs;
+		second_addr = read_start_addr;
+	}
+
+	at = NULL;
+	if (second_addr <= first_end) {
+		t_trace = mbtrace_now(inst->trace);
+		mbreg_cursor_init(&cur, map_index(inst, 1), regs, n_regs, first_addr);
+		mbstats_count_lookup(inst->stats, MBSTATS_MAP_HOLD_REGS);
+		mbtrace_emit(inst->trace, MBTRACE_EV_LOOKUP, MBFC_READ_WRITE_REGS, first_addr, t_trace);
+		at = &cur;
+	}
+
 	/* Perform a dry run read to ensure this read is valid (No locks etc.) */
 	status = read_regs(
 		inst,
@@ -420,7 +801,8 @@ extern enum mbstatus_e mbfn_read_write_regs(
 		read_start_addr,
 		n_read_regs,
 		NULL, /* Dry run */
-		1); /* is_hold_reg = 1 since function 0x17 only operates on holding registers */
+		1, /* is_hold_reg = 1 since function 0x17 only operates on holding registers */
+		at);
 	if (status != MB_OK) {
 		return status;
 	}
@@ -446,7 +828,13 @@ extern enum mbstatus_e mbfn_read_write_regs(
 		write_start_addr,
 		n_write_regs,
 		req+10u,
-		NULL); /* No response needed for write part */
+		NULL, /* No response needed for write part */
+		at);
+	if (status == MB_PENDING) {
+		/* The response carries the registers read after the write, which
+		   do not exist until it completes */
+		return MB_DEV_FAIL;
+	}
 	if (status != MB_OK) {
 		return status;
 	}
@@ -459,5 +847,38 @@ extern enum mbstatus_e mbfn_read_write_regs(
 		read_start_addr,
 		n_read_regs,
 		res,
-		1); /* is_hold_reg = 1 since function 0x17 only operates on holding registers */
+		1,
+		at);
 }
+
+extern enum mbstatus_e mbfn_read_write_regs(
+	const struct mbinst_s *inst,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbpdu_buf_s *res)
+{
+	enum mbstatus_e status;
+
+	if ((inst==NULL) || (regs==NULL) || (req==NULL) || (res==NULL)) return MB_DEV_FAIL;
+
+	if (req[0]!=MBFC_READ_WRITE_REGS) {
+		return MB_DEV_FAIL;
+	}
+
+	/* Check that request data is at least big enough for 'read start addr', 'read n regs', 'write addr',
+	   'write n regs' and 'write byte count' */
+	if (req_len < 10u) {
+		return MB_ILLEGAL_DATA_VAL;
+	}
+
+	rw_scope(inst, 1);
+	status = read_write_regs(inst, regs, n_regs, req, req_len, res);
+	rw_scope(inst, 0);
+
+	return status;
+}
+#endif /* MBCFG_READ_WRITE_REGS */
+
+#endif /* MBCFG_HOLD_REGS || MBCFG_INPUT_REGS */
@@ -34,9 +34,12 @@
  */
 
 #include "mbfn_serial.h"
+#include "mbconfig.h"
 #include <stddef.h>
 #include <stdint.h>
 
+#if MBCFG_SERIAL_DIAG
+
 extern enum mbstatus_e mbfn_read_exception_status(
 	const struct mbinst_s *inst,
 	const uint8_t *req,
@@ -60,3 +63,5 @@ extern enum mbstatus_e mbfn_read_exception_status(
 
 	return MB_OK;
 }
+
+#endif /* MBCFG_SERIAL_DIAG */
@@ -0,0 +1,158 @@
+/**
+ * @file mbframeq.c
+ * @brief Modbus Frame Queue - Interrupt safe handoff of frames to a Modbus task
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbframeq.h"
+#include "mbadu.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__STDC_NO_ATOMICS__)
+#define LOAD_ACQ(p) (*(p))
+#define STORE_REL(p, v) ((void)(*(p) = (v)))
+#define INC_RELAXED(p) ((void)++*(p))
+#else
+#define LOAD_ACQ(p) atomic_load_explicit((p), memory_order_acquire)
+#define STORE_REL(p, v) atomic_store_explicit((p), (v), memory_order_release)
+#define INC_RELAXED(p) ((void)atomic_fetch_add_explicit((p), 1u, memory_order_relaxed))
+#endif
+
+enum {MAX_SLOTS=0x8000u};
+
+enum slot_state_e {
+	SLOT_FREE=0u, /* Reservable, or being received into */
+	SLOT_READY, /* Committed, waiting for the task */
+};
+
+extern int mbframeq_init(struct mbframeq_s *q, struct mbframeq_slot_s *slots, size_t n_slots)
+{
+	size_t i;
+
+	if ((q==NULL) || (slots==NULL)) return 0;
+	if ((n_slots==0u) || (n_slots>MAX_SLOTS) || ((n_slots & (n_slots-1u))!=0u)) return 0;
+
+	q->slots = slots;
+	q->n_slots = (uint32_t)n_slots;
+	for (i=0u; i<n_slots; ++i) {
+		slots[i].req_len = 0u;
+		slots[i].res_len = 0u;
+		STORE_REL(&slots[i].state, (uint8_t)SLOT_FREE);
+	}
+	STORE_REL(&q->head, 0u);
+	STORE_REL(&q->next, 0u);
+	STORE_REL(&q->tail, 0u);
+	STORE_REL(&q->n_dropped, 0u);
+	return 1;
+}
+
+extern struct mbframeq_slot_s *mbframeq_reserve(struct mbframeq_s *q)
+{
+	uint32_t head;
+
+	head = LOAD_ACQ(&q->head);
+#if defined(__STDC_NO_ATOMICS__)
+	if ((uint32_t)(head - q->tail) >= q->n_slots) {
+		INC_RELAXED(&q->n_dropped);
+		return NULL;
+	}
+	q->head = head + 1u;
+#else
+	/* A producer interrupting this one between the load and the exchange
+	   makes the exchange fail, the next slot is tried */
+	do {
+		if ((uint32_t)(head - LOAD_ACQ(&q->tail)) >= q->n_slots) {
+			INC_RELAXED(&q->n_dropped);
+			return NULL;
+		}
+	} while (!atomic_compare_exchange_weak_explicit(&q->head, &head, head + 1u,
+			memory_order_acq_rel, memory_order_acquire));
+#endif
+
+	return &q->slots[head & (q->n_slots-1u)];
+}
+
+extern void mbframeq_commit(struct mbframeq_s *q, struct mbframeq_slot_s *slot, size_t req_len)
+{
+	(void)q;
+	slot->req_len = (req_len<=MBADU_SIZE_MAX) ? (uint16_t)req_len : 0u;
+	STORE_REL(&slot->state, (uint8_t)SLOT_READY);
+}
+
+extern struct mbframeq_slot_s *mbframeq_pop(struct mbframeq_s *q)
+{
+	uint32_t next;
+	struct mbframeq_slot_s *slot;
+
+	if (q==NULL) return NULL;
+
+	next = LOAD_ACQ(&q->next);
+	if (next==LOAD_ACQ(&q->head)) return NULL;
+
+	/* Frames are popped in reservation order, a slot still being received
+	   into holds back the slots reserved after it */
+	slot = &q->slots[next & (q->n_slots-1u)];
+	if (LOAD_ACQ(&slot->state)!=SLOT_READY) return NULL;
+
+	slot->res_len = 0u;
+	STORE_REL(&q->next, next + 1u);
+	return slot;
+}
+
+extern struct mbframeq_slot_s *mbframeq_handle(struct mbframeq_s *q, struct mbinst_s *inst)
+{
+	struct mbframeq_slot_s *slot;
+
+	if ((slot = mbframeq_pop(q)) == NULL) return NULL;
+
+	if (slot->req_len!=0u) {
+		slot->res_len = (uint16_t)mbadu_handle_req(inst, slot->req, slot->req_len, slot->res);
+	}
+	return slot;
+}
+
+extern void mbframeq_release(struct mbframeq_s *q)
+{
+	uint32_t tail;
+
+	if (q==NULL) return;
+
+	tail = LOAD_ACQ(&q->tail);
+	if (tail==LOAD_ACQ(&q->next)) return; /* Nothing popped */
+
+	/* Freed before the slot is handed back, a producer reserving it sees it free */
+	STORE_REL(&q->slots[tail & (q->n_slots-1u)].state, (uint8_t)SLOT_FREE);
+	STORE_REL(&q->tail, tail + 1u);
+}
+
+extern size_t mbframeq_pending(const struct mbframeq_s *q)
+{
+	if (q==NULL) return 0u;
+
+	return (uint32_t)(LOAD_ACQ(&q->head) - LOAD_ACQ(&q->next));
+}
@@ -0,0 +1,167 @@
+/**
+ * @file mbframeq.h
+ * @brief Modbus Frame Queue - Interrupt safe handoff of frames to a Modbus task
+ * @author Jonas Almås
+ *
+ * @details Fixed capacity queue of preallocated frame slots between the
+ * receive interrupts of a port and the task handling the requests, e.g. on an
+ * RTOS. An interrupt reserves a slot, receives the frame straight into it
+ * (by DMA or byte by byte) and commits it. The task pops the slot, builds the
+ * response into the response buffer of the same slot, and releases it once
+ * the response is sent, which may be from the DMA TX complete interrupt.
+ * Slots change owner by index only, frames are never copied.
+ *
+ * Reserving takes a compare exchange, so interrupts of different priorities
+ * may share a queue, including one interrupting another while it reserves.
+ * Slots are handed to the task in reservation order. Without C11 atomics only
+ * a single producer is supported, see MBATOMIC_FENCE() in mbatomic.h.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+#ifndef MBFRAMEQ_H_INCLUDED
+#define MBFRAMEQ_H_INCLUDED
+
+#include "mbadu.h"
+#include "mbinst.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__STDC_NO_ATOMICS__) || defined(__cplusplus)
+#define MBFRAMEQ_ATOMIC(type) volatile type
+#else
+#include <stdatomic.h>
+#define MBFRAMEQ_ATOMIC(type) _Atomic(type)
+/* C++ sees the plain types, the atomics must share their layout (See mbatomic.h) */
+_Static_assert(sizeof(_Atomic(uint8_t))==sizeof(uint8_t), "Atomic uint8_t differs in size");
+_Static_assert(sizeof(_Atomic(uint32_t))==sizeof(uint32_t), "Atomic uint32_t differs in size");
+#endif
+
+/**
+ * @brief Frame slot
+ *
+ * Owned by the producer between mbframeq_reserve() and mbframeq_commit(), and
+ * by the task between mbframeq_pop() and mbframeq_release().
+ */
+struct mbframeq_slot_s {
+	uint8_t req[MBADU_SIZE_MAX]; /**< Received request ADU */
+	uint8_t res[MBADU_SIZE_MAX]; /**< Response ADU, sent from here (E.g. by DMA) */
+	uint16_t req_len; /**< Size of the request, 0 for a dropped frame */
+	uint16_t res_len; /**< Size of the response, set by mbframeq_handle() */
+	MBFRAMEQ_ATOMIC(uint8_t) state; /**< Shall not be accessed by client code */
+};
+
+/**
+ * @brief Frame queue
+ *
+ * Each index only moves forward and is written by one side: head by the
+ * producers, next by the task and tail by whoever releases slots.
+ *
+ * @note Initialize with mbframeq_init()
+ * @note Shall not be accessed by client code directly, except n_dropped
+ */
+struct mbframeq_s {
+	struct mbframeq_slot_s *slots; /**< Caller supplied slots */
+	uint32_t n_slots; /**< Number of slots, a power of two */
+
+	MBFRAMEQ_ATOMIC(uint32_t) head; /**< Next slot reserved */
+	MBFRAMEQ_ATOMIC(uint32_t) next; /**< Next slot popped */
+	MBFRAMEQ_ATOMIC(uint32_t) tail; /**< Next slot released */
+
+	MBFRAMEQ_ATOMIC(uint32_t) n_dropped; /**< Frames not received because all slots were in use */
+};
+
+/**
+ * @brief Initialize a frame queue
+ *
+ * @param q Queue to initialize
+ * @param slots Slots of the queue
+ * @param n_slots Number of slots, a power of two up to 0x8000
+ *
+ * @retval 1 Success
+ * @retval 0 Invalid parameters
+ */
+extern int mbframeq_init(struct mbframeq_s *q, struct mbframeq_slot_s *slots, size_t n_slots);
+
+/**
+ * @brief Reserve a slot to receive a frame into (Producer, interrupt safe)
+ *
+ * @param q Queue
+ *
+ * @return Slot to fill, or NULL if all slots are in use (counted in n_dropped)
+ *
+ * @note Every reserved slot must be committed, also when the frame turns out bad
+ */
+extern struct mbframeq_slot_s *mbframeq_reserve(struct mbframeq_s *q);
+
+/**
+ * @brief Hand a received frame to the task (Producer, interrupt safe)
+ *
+ * @param q Queue
+ * @param slot Slot returned by mbframeq_reserve()
+ * @param req_len Size of the frame in slot->req, 0 to drop it
+ */
+extern void mbframeq_commit(struct mbframeq_s *q, struct mbframeq_slot_s *slot, size_t req_len);
+
+/**
+ * @brief Take the oldest received frame (Task)
+ *
+ * @param q Queue
+ *
+ * @return Slot of the frame, or NULL if none is committed yet
+ *
+ * @note Slots are released in the order they were popped
+ */
+extern struct mbframeq_slot_s *mbframeq_pop(struct mbframeq_s *q);
+
+/**
+ * @brief Take the oldest received frame and handle it as a Modbus RTU request (Task)
+ *
+ * The response is built into slot->res, slot->res_len is 0 when nothing is
+ * to be sent (Broadcasts, bad frames). The slot is not released.
+ *
+ * @param q Queue
+ * @param inst Modbus instance handling the request
+ *
+ * @return Slot of the handled frame, or NULL if none is committed yet
+ */
+extern struct mbframeq_slot_s *mbframeq_handle(struct mbframeq_s *q, struct mbinst_s *inst);
+
+/**
+ * @brief Return the oldest popped slot to the producers (Task or TX complete interrupt)
+ *
+ * @param q Queue
+ *
+ * @note Only one context may release slots of a queue
+ */
+extern void mbframeq_release(struct mbframeq_s *q);
+
+/**
+ * @brief Number of reserved slots not yet popped
+ *
+ * @param q Queue
+ */
+extern size_t mbframeq_pending(const struct mbframeq_s *q);
+
+#endif /* MBFRAMEQ_H_INCLUDED */
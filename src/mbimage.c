@@ -0,0 +1,154 @@
+/**
+ * @file mbimage.c
+ * @brief Modbus Register Image - Double buffered register images published atomically
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbimage.h"
+#include "mbatomic.h"
+#include "mbconfig.h"
+#include "mbdef.h"
+#include "mbreg.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {
+	STATE_IX_MASK = 0x3u, /* Published image */
+	STATE_GEN_SHIFT = 2u, /* Generation, counts publishes */
+};
+
+/**
+ * @brief Index of the image following ix
+ */
+static uint32_t next_ix(const struct mbimage_s *img, uint32_t ix)
+{
+	return ((ix + 1u) < img->n_bufs) ? (ix + 1u) : 0u;
+}
+
+extern int mbimage_init(struct mbimage_s *img)
+{
+	size_t i;
+
+	if (img==NULL) return 0;
+	if ((img->n_bufs < 2u) || (img->n_bufs > MBIMAGE_N_BUFS_MAX)) return 0;
+	if (((size_t)img->start + img->n_regs) > 0x10000u) return 0;
+
+	for (i=0u; i<img->n_bufs; ++i) {
+		if (img->bufs[i]==NULL) return 0;
+		(void)memset(img->bufs[i], 0, 2u*(size_t)img->n_regs);
+	}
+	img->state = 0u;
+
+	return 1;
+}
+
+extern uint8_t *mbimage_back(struct mbimage_s *img)
+{
+	return img->bufs[next_ix(img, img->state & STATE_IX_MASK)];
+}
+
+extern enum mbstatus_e mbimage_capture(
+	struct mbimage_s *img,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	int swap_words)
+{
+	uint8_t *dst = mbimage_back(img);
+	const struct mbreg_desc_s *reg;
+	struct mbreg_cursor_s cur;
+	uint16_t addr;
+	size_t offs, n_read;
+
+	mbreg_cursor_init(&cur, NULL, regs, n_regs, img->start);
+	for (offs=0u; offs<img->n_regs; ) {
+		addr = (uint16_t)(img->start + offs);
+		reg = mbreg_cursor_find(&cur, addr);
+		n_read = (reg!=NULL)
+			? mbreg_read(reg, addr, img->n_regs - offs, dst + (2u*offs), swap_words)
+			: MBREG_READ_NO_ACCESS;
+
+		switch (n_read) {
+		case MBREG_READ_DEV_FAIL:
+			return MB_DEV_FAIL;
+		case MBREG_READ_LOCKED:
+		case MBREG_READ_NO_ACCESS:
+			dst[2u*offs] = 0u;
+			dst[(2u*offs)+1u] = 0u;
+			++offs;
+			break;
+		default:
+			offs += n_read;
+			break;
+		}
+	}
+
+	return MB_OK;
+}
+
+extern void mbimage_publish(struct mbimage_s *img)
+{
+	uint32_t state = img->state;
+	uint32_t gen = (state >> STATE_GEN_SHIFT) + 1u;
+
+	MBATOMIC_FENCE(); /* Back image complete before it is published */
+	img->state = (gen << STATE_GEN_SHIFT) | next_ix(img, state & STATE_IX_MASK);
+	MBATOMIC_FENCE();
+}
+
+extern int mbimage_covers(const struct mbimage_s *img, uint16_t addr, size_t n)
+{
+	if (img==NULL) return 0;
+
+	return (addr >= img->start) && (((size_t)addr + n) <= ((size_t)img->start + img->n_regs));
+}
+
+extern enum mbstatus_e mbimage_read(
+	const struct mbimage_s *img,
+	uint16_t addr,
+	size_t n,
+	uint8_t *dst)
+{
+	const size_t offs = 2u*(size_t)(addr - img->start);
+	uint32_t state, n_published;
+	int attempt;
+
+	for (attempt=0; attempt<MBSEQLOCK_READ_ATTEMPTS; ++attempt) {
+		state = img->state;
+		MBATOMIC_FENCE();
+		(void)memcpy(dst, img->bufs[state & STATE_IX_MASK] + offs, 2u*n);
+		MBATOMIC_FENCE();
+
+		/* The writer reaches the copied image again after n_bufs-1 publishes */
+		n_published = ((img->state >> STATE_GEN_SHIFT) - (state >> STATE_GEN_SHIFT)) & (UINT32_MAX >> STATE_GEN_SHIFT);
+		if (n_published < (uint32_t)(img->n_bufs - 1u)) {
+			return MB_OK;
+		}
+	}
+
+	return MB_BUSY;
+}
@@ -0,0 +1,151 @@
+/**
+ * @file mbimage.h
+ * @brief Modbus Register Image - Double buffered register images published atomically
+ * @author Jonas Almås
+ *
+ * @details Register images served in place of the descriptors of a map. The
+ * library keeps two or three flat big-endian word images of an address range,
+ * the application fills the back image (directly or with mbimage_capture())
+ * and publishes it with one store. Reads are copied from the last published
+ * image, so a response never mixes values of two application scans and no lock
+ * is taken.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBIMAGE_H_INCLUDED
+#define MBIMAGE_H_INCLUDED
+
+#include "mbdef.h"
+#include "mbreg.h"
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+	MBIMAGE_N_BUFS_MAX = 3u, /**< Maximum number of images per map */
+};
+
+/**
+ * @brief Published images of a register range
+ *
+ * Images hold the register values as sent on the wire (big-endian, 2 bytes per
+ * register from start). The published image is state & 3, the generation
+ * counts publishes in the remaining bits. With two images a reader copies
+ * again when a publish happened during its copy, with three images only when
+ * the writer published twice, the writer never waits.
+ *
+ * @note Supports a single writer, concurrent writers must be serialized by the application
+ * @note Configuration fields are set by the application, state is cleared by mbimage_init()
+ */
+struct mbimage_s {
+	uint16_t start; /**< First register address of the images */
+	uint16_t n_regs; /**< Number of registers per image */
+	uint8_t *bufs[MBIMAGE_N_BUFS_MAX]; /**< Caller supplied images, 2*n_regs bytes each */
+	uint8_t n_bufs; /**< Number of images in bufs, 2 or 3 */
+
+	volatile uint32_t state; /**< Generation << 2 | index of the published image */
+};
+
+/**
+ * @brief Initialize images, the first image is published
+ *
+ * @param img Image with configuration fields set
+ *
+ * @retval 1 Success
+ * @retval 0 Invalid configuration
+ */
+extern int mbimage_init(struct mbimage_s *img);
+
+/**
+ * @brief Image the application fills before the next publish
+ *
+ * @param img Image
+ *
+ * @return Back image, 2*n_regs bytes of big-endian register values
+ *
+ * @note Not visible to reads until mbimage_publish()
+ * @note The content is left from an earlier publish, unchanged registers must be written again
+ */
+extern uint8_t *mbimage_back(struct mbimage_s *img);
+
+/**
+ * @brief Fill the back image by reading the descriptors of a map
+ *
+ * Registers without a descriptor, locked or without read access are zero.
+ *
+ * @param img Image
+ * @param regs Register map covering the image (any order of coverage)
+ * @param n_regs Number of descriptors in regs
+ * @param swap_words Word order of the map, see mbreg_read()
+ *
+ * @return MB_OK, or MB_DEV_FAIL if a descriptor failed
+ *
+ * @note Called from the task owning the data, e.g. at the end of a control scan
+ */
+extern enum mbstatus_e mbimage_capture(
+	struct mbimage_s *img,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	int swap_words);
+
+/**
+ * @brief Make the back image the one served to reads
+ *
+ * @param img Image
+ */
+extern void mbimage_publish(struct mbimage_s *img);
+
+/**
+ * @brief Check whether an image covers a register range
+ *
+ * @param img Image (Can be NULL)
+ * @param addr First register address
+ * @param n Number of registers
+ *
+ * @retval 1 Range inside the image
+ * @retval 0 Otherwise
+ */
+extern int mbimage_covers(const struct mbimage_s *img, uint16_t addr, size_t n);
+
+/**
+ * @brief Copy registers from the published image
+ *
+ * @param img Image covering the range, see mbimage_covers()
+ * @param addr First register address
+ * @param n Number of registers
+ * @param dst Destination, 2*n bytes
+ *
+ * @return MB_OK, or MB_BUSY if the writer kept publishing during
+ *         MBSEQLOCK_READ_ATTEMPTS copies
+ *
+ * @note Called by the library while handling requests
+ */
+extern enum mbstatus_e mbimage_read(
+	const struct mbimage_s *img,
+	uint16_t addr,
+	size_t n,
+	uint8_t *dst);
+
+#endif /* MBIMAGE_H_INCLUDED */
@@ -29,33 +29,344 @@
  */
 
 #include "mbinst.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 extern void mbinst_init(struct mbinst_s *inst)
 {
-	inst->state.is_listen_only = 0;
+	mbatomic_store(&inst->state.is_listen_only, 0u);
 	inst->state.status = 0u;
-	inst->state.comm_event_counter = 0u;
+	mbatomic_store(&inst->state.comm_event_counter, 0u);
 
-	inst->state.event_log_write_pos = 0;
-	inst->state.event_log_count = 0;
+#if MBCFG_EVENT_LOG
+	mbatomic_store(&inst->state.event_log_write_pos, 0u);
+	mbatomic_store(&inst->state.event_log_count, 0u);
+#if MBCFG_EVENT_LOG_EXTERN
+	inst->state.event_log = NULL;
+#endif
+#endif
 
-	inst->state.bus_msg_counter = 0u;
-	inst->state.bus_comm_err_counter = 0u;
-	inst->state.exception_counter = 0u;
-	inst->state.msg_counter = 0u;
-	inst->state.no_resp_counter = 0u;
-	inst->state.nak_counter = 0u;
-	inst->state.busy_counter = 0u;
-	inst->state.bus_char_overrun_counter = 0u;
+	mbatomic_store(&inst->state.bus_msg_counter, 0u);
+	mbatomic_store(&inst->state.bus_comm_err_counter, 0u);
+	mbatomic_store(&inst->state.exception_counter, 0u);
+	mbatomic_store(&inst->state.msg_counter, 0u);
+	mbatomic_store(&inst->state.no_resp_counter, 0u);
+	mbatomic_store(&inst->state.nak_counter, 0u);
+	mbatomic_store(&inst->state.busy_counter, 0u);
+	mbatomic_store(&inst->state.bus_char_overrun_counter, 0u);
 
-	inst->state.ascii_delimiter = '\n';
+	mbatomic_store(&inst->state.ascii_delimiter, '\n');
+
+	(void)memset(&inst->state.pending, 0, sizeof inst->state.pending);
 }
 
-extern void mb_add_comm_event(struct mbinst_s *inst, uint8_t event)
+extern void mbinst_init_worker(struct mbinst_s *worker, const struct mbinst_s *base)
+{
+	if ((worker==NULL) || (base==NULL)) return;
+
+	*worker = *base;
+	worker->stats = NULL;
+#if MBCFG_TRACE
+	worker->trace = NULL;
+#endif
+	worker->commit = NULL;
+	worker->coils_dirty = NULL;
+	worker->hold_regs_dirty = NULL;
+	worker->cache = NULL;
+	worker->plan = NULL;
+	worker->fn_cache = NULL;
+	worker->arena = NULL;
+	worker->rate = NULL;
+	worker->fifos = NULL;
+	worker->n_fifos = 0u;
+	mbinst_init(worker);
+}
+
+/**
+ * @brief Check that files are ascending by file number, see mbinst_prepare()
+ */
+static int files_valid(const struct mbfile_desc_s *files, size_t n_files, uint16_t *issue_file_no)
 {
-	inst->state.event_log[inst->state.event_log_write_pos] = event;
-	inst->state.event_log_write_pos = (inst->state.event_log_write_pos + 1) % MB_COMM_EVENT_LOG_LEN;
-	if (inst->state.event_log_count < MB_COMM_EVENT_LOG_LEN) {
-		++inst->state.event_log_count;
+	size_t i;
+
+	for (i=1u; (files!=NULL) && (i<n_files); ++i) {
+		if (files[i].file_no <= files[i-1u].file_no) {
+			*issue_file_no = files[i].file_no;
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Storage left in ix_buf, see mbinst_prep_s
+ */
+static uint16_t *ix_storage(const struct mbinst_prep_s *prep, size_t *n_left)
+{
+	*n_left = prep->ix_buf_len - prep->n_ix_used;
+	return (prep->ix_buf!=NULL) ? (prep->ix_buf + prep->n_ix_used) : NULL;
+}
+
+/**
+ * @brief Build the index of a register map dense or paged, as ranges or not at all, see mbinst_prep_s
+ */
+static const struct mbreg_index_s *prepare_index(
+	struct mbinst_prep_s *prep,
+	struct mbreg_index_s *ix,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs)
+{
+	size_t n_left;
+	uint16_t *storage = ix_storage(prep, &n_left);
+	const size_t span = mbreg_index_span(regs, n_regs);
+	const size_t paged = mbreg_index_paged_size(regs, n_regs);
+
+	if ((paged!=0u) && ((span==0u) || (paged < span)) && (paged<=n_left)
+			&& mbreg_index_build_paged(ix, regs, n_regs, storage, n_left)) {
+		prep->n_ix_used += paged;
+		return ix;
+	}
+	if ((span!=0u) && (span<=n_left) && mbreg_index_build(ix, regs, n_regs, storage, n_left)) {
+		prep->n_ix_used += span;
+		return ix;
 	}
+	if (!prep->const_time && mbreg_index_build_ranges(ix, regs, n_regs, storage, n_left)) {
+		prep->n_ix_used += MBREG_RANGE_INDEX_SIZE(n_regs);
+		return ix;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Build the paged index of a coil map if it fits, see mbinst_prep_s
+ */
+static const struct mbcoil_index_s *prepare_coil_index(
+	struct mbinst_prep_s *prep,
+	struct mbcoil_index_s *ix,
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils)
+{
+	size_t n_left;
+	uint16_t *storage = ix_storage(prep, &n_left);
+
+	if (!mbcoil_index_build(ix, coils, n_coils, storage, n_left)) return NULL;
+
+	prep->n_ix_used += mbcoil_index_size(coils, n_coils);
+	return ix;
+}
+
+#if MBCFG_FILES
+/**
+ * @brief Build the paged index of a file map if it fits, see mbinst_prep_s
+ */
+static const struct mbfile_index_s *prepare_file_index(
+	struct mbinst_prep_s *prep,
+	struct mbfile_index_s *ix,
+	const struct mbfile_desc_s *files,
+	size_t n_files)
+{
+	size_t n_left;
+	uint16_t *storage = ix_storage(prep, &n_left);
+
+	if (!mbfile_index_build(ix, files, n_files, storage, n_left)) return NULL;
+
+	prep->n_ix_used += mbfile_index_size(files, n_files);
+	return ix;
+}
+#endif
+
+/**
+ * @brief Resolve the kernels of a register map if they fit, see mbinst_prep_s
+ */
+static const struct mbreg_kernel_s *prepare_kernels(
+	struct mbinst_prep_s *prep,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	int swap_words)
+{
+	struct mbreg_kernel_s *kernels;
+
+	if ((prep->kern_buf==NULL) || (regs==NULL) || (n_regs==0u)) return NULL;
+	if (n_regs > (prep->kern_buf_len - prep->n_kern_used)) return NULL;
+
+	kernels = prep->kern_buf + prep->n_kern_used;
+	mbreg_kernels_build(kernels, regs, n_regs, swap_words);
+	prep->n_kern_used += n_regs;
+
+	return kernels;
+}
+
+/**
+ * @brief Report a map left without an index, see mbinst_prep_s::const_time
+ */
+static int no_index(struct mbinst_prep_s *prep, uint16_t first_addr)
+{
+	prep->issue_addr = first_addr;
+	prep->n_ix_used = 0u;
+	prep->n_kern_used = 0u;
+	return 0;
+}
+
+extern int mbinst_prepare(struct mbinst_s *inst, struct mbinst_prep_s *prep)
+{
+	const uint64_t t0 = ((prep!=NULL) && (prep->clock_cb!=NULL)) ? prep->clock_cb() : 0u;
+	const struct mbreg_index_s *hold_regs_ix, *input_regs_ix;
+	const struct mbcoil_index_s *coils_ix, *disc_inputs_ix;
+#if MBCFG_FILES
+	const struct mbfile_index_s *files_ix;
+#endif
+
+	if ((inst==NULL) || (prep==NULL)) return 0;
+
+	prep->n_ix_used = 0u;
+	prep->n_kern_used = 0u;
+	prep->n_bytes = 0u;
+	prep->ticks = 0u;
+	prep->issue_addr = 0u;
+
+	prep->issue_map = MBINST_MAP_COILS;
+	if (!mbcoil_validate(inst->coils, inst->n_coils, &prep->issue_addr)) return 0;
+	prep->issue_map = MBINST_MAP_DISC_INPUTS;
+	if (!mbcoil_validate(inst->disc_inputs, inst->n_disc_inputs, &prep->issue_addr)) return 0;
+	prep->issue_map = MBINST_MAP_HOLD_REGS;
+	if (!mbreg_validate(inst->hold_regs, inst->n_hold_regs, &prep->issue_addr)) return 0;
+	prep->issue_map = MBINST_MAP_INPUT_REGS;
+	if (!mbreg_validate(inst->input_regs, inst->n_input_regs, &prep->issue_addr)) return 0;
+	prep->issue_map = MBINST_MAP_FILES;
+	if (!files_valid(inst->files, inst->n_files, &prep->issue_addr)) return 0;
+
+	hold_regs_ix = prepare_index(prep, &prep->hold_regs_ix, inst->hold_regs, inst->n_hold_regs);
+	input_regs_ix = prepare_index(prep, &prep->input_regs_ix, inst->input_regs, inst->n_input_regs);
+	coils_ix = prepare_coil_index(prep, &prep->coils_ix, inst->coils, inst->n_coils);
+	disc_inputs_ix = prepare_coil_index(prep, &prep->disc_inputs_ix, inst->disc_inputs, inst->n_disc_inputs);
+#if MBCFG_FILES
+	files_ix = prepare_file_index(prep, &prep->files_ix, inst->files, inst->n_files);
+#endif
+
+	if (prep->const_time) {
+		/* Every lookup of a non-empty map must go through an index */
+		prep->issue_map = MBINST_MAP_COILS;
+		if ((coils_ix==NULL) && (inst->n_coils!=0u)) return no_index(prep, inst->coils[0].address);
+		prep->issue_map = MBINST_MAP_DISC_INPUTS;
+		if ((disc_inputs_ix==NULL) && (inst->n_disc_inputs!=0u)) return no_index(prep, inst->disc_inputs[0].address);
+		prep->issue_map = MBINST_MAP_HOLD_REGS;
+		if ((hold_regs_ix==NULL) && (inst->n_hold_regs!=0u)) return no_index(prep, inst->hold_regs[0].address);
+		prep->issue_map = MBINST_MAP_INPUT_REGS;
+		if ((input_regs_ix==NULL) && (inst->n_input_regs!=0u)) return no_index(prep, inst->input_regs[0].address);
+#if MBCFG_FILES
+		prep->issue_map = MBINST_MAP_FILES;
+		if ((files_ix==NULL) && (inst->n_files!=0u)) return no_index(prep, inst->files[0].file_no);
+#endif
+	}
+
+	inst->hold_regs_ix = hold_regs_ix;
+	inst->input_regs_ix = input_regs_ix;
+	inst->coils_ix = coils_ix;
+	inst->disc_inputs_ix = disc_inputs_ix;
+#if MBCFG_FILES
+	inst->files_ix = files_ix;
+#endif
+	inst->hold_regs_kern = prepare_kernels(prep, inst->hold_regs, inst->n_hold_regs, 0);
+	inst->input_regs_kern = prepare_kernels(prep, inst->input_regs, inst->n_input_regs, inst->swap_words);
+
+	prep->n_bytes = (prep->n_ix_used * sizeof prep->ix_buf[0]) + (prep->n_kern_used * sizeof prep->kern_buf[0]);
+	if (prep->clock_cb!=NULL) {
+		prep->ticks = prep->clock_cb() - t0;
+	}
+
+	return 1;
+}
+
+extern void mbinst_sum_counters(struct mbinst_state_s *sum, const struct mbinst_s *insts, size_t n_insts)
+{
+	size_t i;
+	const struct mbinst_state_s *st;
+
+	if (sum==NULL) return;
+
+	(void)memset(sum, 0, sizeof *sum);
+	if (insts==NULL) return;
+
+	/* Loads are relaxed with MBCFG_ATOMIC_STATE, the sum is local */
+#define SUM_COUNTER(f) mbatomic_store(&sum->f, (uint16_t)(mbatomic_load(&sum->f) + mbatomic_load(&st->f)))
+	for (i=0u; i<n_insts; ++i) {
+		st = &insts[i].state;
+		SUM_COUNTER(comm_event_counter);
+		SUM_COUNTER(bus_msg_counter);
+		SUM_COUNTER(bus_comm_err_counter);
+		SUM_COUNTER(exception_counter);
+		SUM_COUNTER(msg_counter);
+		SUM_COUNTER(no_resp_counter);
+		SUM_COUNTER(nak_counter);
+		SUM_COUNTER(busy_counter);
+		SUM_COUNTER(bus_char_overrun_counter);
+	}
+#undef SUM_COUNTER
+}
+
+extern size_t mbinst_consume_dirty(
+	const struct mbinst_s *inst,
+	enum mbinst_dirty_map_e map,
+	struct mbdirty_range_s *ranges,
+	size_t max_ranges)
+{
+	if (inst==NULL) return 0u;
+
+	switch (map) {
+	case MBINST_DIRTY_COILS: return mbdirty_consume(inst->coils_dirty, ranges, max_ranges);
+	case MBINST_DIRTY_HOLD_REGS: return mbdirty_consume(inst->hold_regs_dirty, ranges, max_ranges);
+	default: return 0u;
+	}
+}
+
+#if MBCFG_EVENT_LOG_EXTERN
+extern void mbinst_set_event_log(struct mbinst_s *inst, uint8_t *event_log)
+{
+	if (inst==NULL) return;
+
+	inst->state.event_log = event_log;
+	mbatomic_store(&inst->state.event_log_write_pos, 0u);
+	mbatomic_store(&inst->state.event_log_count, 0u);
+}
+#endif
+
+#if MBCFG_EVENT_LOG
+#if MBCFG_ATOMIC_STATE
+/* Each writer reserves its own slot by advancing the position, the count then
+   saturates at the length of the log. A failed exchange reloads the value. */
+extern void mb_add_comm_event(struct mbinst_s *inst, uint8_t event)
+{
+	uint8_t pos;
+	uint8_t count;
+
+#if MBCFG_EVENT_LOG_EXTERN
+	if (inst->state.event_log==NULL) return;
+#endif
+	pos = mbatomic_load(&inst->state.event_log_write_pos);
+	while (!atomic_compare_exchange_weak_explicit(&inst->state.event_log_write_pos, &pos,
+		(uint8_t)((pos + 1u) & MB_COMM_EVENT_LOG_MASK), memory_order_relaxed, memory_order_relaxed)) {}
+	inst->state.event_log[pos] = event;
+
+	count = mbatomic_load(&inst->state.event_log_count);
+	while ((count<MB_COMM_EVENT_LOG_LEN)
+		&& !atomic_compare_exchange_weak_explicit(&inst->state.event_log_count, &count, (uint8_t)(count + 1u),
+			memory_order_relaxed, memory_order_relaxed)) {}
+}
+#else
+extern void mb_add_comm_event(struct mbinst_s *inst, uint8_t event)
+{
+	uint8_t pos = inst->state.event_log_write_pos;
+	uint8_t count = inst->state.event_log_count;
+
+#if MBCFG_EVENT_LOG_EXTERN
+	if (inst->state.event_log==NULL) return;
+#endif
+	inst->state.event_log[pos] = event;
+	inst->state.event_log_write_pos = (uint8_t)((pos + 1u) & MB_COMM_EVENT_LOG_MASK);
+	inst->state.event_log_count = (uint8_t)(count + (uint8_t)(count < MB_COMM_EVENT_LOG_LEN)); /* Saturates without a branch */
 }
+#endif /* MBCFG_ATOMIC_STATE */
+#endif
@@ -41,19 +41,140 @@
 #define MBINST_H_INCLUDED
 
 #include "mbdef.h"
+#include "mbatomic.h"
+#include "mbcache.h"
 #include "mbcoil.h"
+#include "mbarena.h"
+#include "mbconfig.h"
+#include "mbdevid.h"
+#include "mbfifo.h"
 #include "mbfile.h"
+#include "mbimage.h"
 #include "mbpdu.h"
+#include "mbplan.h"
+#include "mbrate.h"
 #include "mbreg.h"
+#include "mbseqlock.h"
+#include "mbcommit.h"
+#include "mbdirty.h"
+#include "mbstats.h"
+#include "mbtrace.h"
 #include <stddef.h>
 #include <stdint.h>
 
+/** @brief Maximum number of request bytes echoed by a deferred response, see mbpending_s */
+enum {MBPENDING_ECHO_MAX=7u};
+
+/**
+ * @brief Context of a deferred (pending) request
+ *
+ * Kept by the library while a request is pending, after a handler returned
+ * MB_PENDING, until the application completes it.
+ *
+ * @note Shall not be accessed by client code directly
+ */
+struct mbpending_s {
+	uint8_t is_active; /**< Non-zero while a request is pending */
+	uint8_t was_listen_only; /**< Listen only state when the request was received */
+	uint8_t echo_len; /**< Number of valid bytes in echo */
+	uint8_t echo[MBPENDING_ECHO_MAX]; /**< Function code and request fields echoed by write responses */
+
+	uint8_t slave_addr; /**< Serial only: Slave address of the request */
+	uint8_t unit_id; /**< TCP only: MBAP unit id of the request */
+	uint16_t transaction_id; /**< TCP only: MBAP transaction id of the request */
+};
+
+/**
+ * @brief Internal state for diagnostics and status tracking
+ *
+ * Contains internal state variables used by the library for tracking
+ * device status and communication events. These fields are automatically
+ * maintained by the library and support diagnostic function codes.
+ *
+ * @note Serial only
+ *
+ * @note Shall not be accessed by client code directly, see mbinst_sum_counters()
+ * @note State is automatically updated during Modbus request processing
+ * @note The event log is left out when MBCFG_EVENT_LOG is 0, and kept outside
+ *       the instance when MBCFG_EVENT_LOG_EXTERN is 1 (see mbinst_set_event_log())
+ * @note With MBCFG_ATOMIC_STATE the counters, flags and event log position are
+ *       relaxed atomics, requests may then be handled from several threads as
+ *       long as the pending request and the mutable members of mbinst_s (stats,
+ *       trace, commit, cache, plan, fn_cache, ...) are left NULL or per thread, see
+ *       mbinst_init_worker()
+ */
+struct mbinst_state_s {
+	MBATOMIC(uint8_t) is_listen_only; /**< Whether the device is in a listen only mode or not */
+
+	/**
+	 * @brief ASCII frame delimiter character for Modbus ASCII
+	 *
+	 * Character used to delimit the end of Modbus ASCII frames. The Modbus ASCII
+	 * specification defines that frames should end with CR LF (\r\n), but this
+	 * field allows customization of the line ending character.
+	 *
+	 * @note Default value is '\n' (0x0A - Line Feed)
+	 * @note Set through function 0x08 with sub function 0x0003
+	 *
+	 * @note Modbus ASCII only
+	 */
+	MBATOMIC(uint8_t) ascii_delimiter;
+
+	uint16_t status; /**< Device status word (Not implemented) */
+
+	/**
+	 * @brief Communication event counter
+	 *
+	 * Incremented for each successful message completion.
+	 * Provides a simple metric for monitoring communication activity.
+	 *
+	 * @note Automatically incremented on successful message processing
+	 */
+	MBATOMIC(uint16_t) comm_event_counter;
+
+#if MBCFG_EVENT_LOG
+	MBATOMIC(uint8_t) event_log_write_pos; /**< Write position in ring buffer (0 to MB_COMM_EVENT_LOG_LEN-1) */
+	MBATOMIC(uint8_t) event_log_count; /**< Number of events currently in buffer (0 to MB_COMM_EVENT_LOG_LEN) */
+
+	/**
+	 * @brief Communication event log ring buffer
+	 *
+	 * Ring buffer for storing communication events and diagnostic information.
+	 * Automatically overwrites oldest events when buffer is full.
+	 */
+#if MBCFG_EVENT_LOG_EXTERN
+	uint8_t *event_log; /**< MB_COMM_EVENT_LOG_LEN bytes, or NULL to not log events */
+#else
+	uint8_t event_log[MB_COMM_EVENT_LOG_LEN];
+#endif
+#endif /* MBCFG_EVENT_LOG */
+
+	MBATOMIC(uint16_t) bus_msg_counter; /**< Total messages on bus (all devices, including CRC errors) */
+	MBATOMIC(uint16_t) bus_comm_err_counter; /**< CRC/LRC error count */
+	MBATOMIC(uint16_t) exception_counter; /**< Exception responses sent by this device */
+	MBATOMIC(uint16_t) msg_counter; /**< Messages addressed to this device */
+	MBATOMIC(uint16_t) no_resp_counter; /**< Messages to this device with no response sent */
+	MBATOMIC(uint16_t) nak_counter; /**< NAK exception responses sent */
+	MBATOMIC(uint16_t) busy_counter; /**< BUSY exception responses sent */
+	MBATOMIC(uint16_t) bus_char_overrun_counter; /**< Character overrun errors (not currently tracked - Could be incremented by implementation rtu) */
+
+	/**
+	 * @brief Deferred request, see MB_PENDING
+	 *
+	 * @note While a request is pending, new requests get an MB_BUSY exception response
+	 */
+	struct mbpending_s pending;
+};
+
+struct mbadu_exc_table_s; /* Forward declaration, see "mbadu.h" */
+
 /**
  * @brief Modbus slave instance configuration and data mappings
  *
  * This structure contains all the configuration and data mappings for a Modbus slave device.
  *
- * @note The instance is stateless and thread-safe - multiple instances can coexist
+ * @note Multiple instances can coexist, mutable data is kept in state only
+ * @note Use mbinst_init_worker() to share one configuration between threads
  * @note All descriptor arrays must be sorted in ascending address order
  * @note NULL pointers are allowed for unused data types
  */
@@ -71,6 +192,14 @@ struct mbinst_s {
 	const struct mbcoil_desc_s *disc_inputs;
 	size_t n_disc_inputs; /**< Number of discrete input descriptors */
 
+	/**
+	 * @brief Optional paged address index for disc_inputs
+	 *
+	 * @note Can be left as NULL, lookups then use mbcoil_find_desc()
+	 * @note Build with mbcoil_index_build() before handling requests
+	 */
+	const struct mbcoil_index_s *disc_inputs_ix;
+
 	/**
 	 * @brief Coil descriptor map (Read/write single bit values)
 	 *
@@ -84,6 +213,14 @@ struct mbinst_s {
 	const struct mbcoil_desc_s *coils;
 	size_t n_coils; /**< Number of coil descriptors */
 
+	/**
+	 * @brief Optional paged address index for coils
+	 *
+	 * @note Can be left as NULL, lookups then use mbcoil_find_desc()
+	 * @note Build with mbcoil_index_build() before handling requests
+	 */
+	const struct mbcoil_index_s *coils_ix;
+
 	/**
 	 * @brief Input register descriptor map (Read-only 16-bit values)
 	 *
@@ -99,6 +236,45 @@ struct mbinst_s {
 	const struct mbreg_desc_s *input_regs;
 	size_t n_input_regs; /**< Number of input register descriptors */
 
+	/**
+	 * @brief Optional precompiled address index for input_regs
+	 *
+	 * @note Can be left as NULL, lookups then use mbreg_find_desc()
+	 * @note Build with mbreg_index_build(), mbreg_index_build_ranges() or
+	 *       mbreg_index_build_paged() before handling requests
+	 */
+	const struct mbreg_index_s *input_regs_ix;
+
+	/**
+	 * @brief Optional kernels of input_regs, see mbreg_kernel_s
+	 *
+	 * @note Can be left as NULL, registers are then read through mbreg_read()
+	 * @note Build with mbreg_kernels_build() and swap_words of the instance
+	 */
+	const struct mbreg_kernel_s *input_regs_kern;
+
+	/**
+	 * @brief Optional sequence lock making input register reads consistent snapshots
+	 *
+	 * When set, all registers of one read request are read under the lock and
+	 * read again if the application published new values meanwhile.
+	 *
+	 * @note Can be left as NULL for plain reads
+	 * @note Read callbacks may be called more than once per request
+	 */
+	const struct mbseqlock_s *input_regs_lock;
+
+	/**
+	 * @brief Optional published image serving input register reads, see mbimage_s
+	 *
+	 * Reads inside the image are copied from the last published image, other
+	 * reads use the descriptors.
+	 *
+	 * @note Can be left as NULL to read the descriptors
+	 * @note Read lock callbacks are not called for reads served from the image
+	 */
+	const struct mbimage_s *input_regs_image;
+
 	/**
 	 * @brief Holding register descriptor map (Read/write 16-bit values)
 	 *
@@ -113,6 +289,42 @@ struct mbinst_s {
 	const struct mbreg_desc_s *hold_regs;
 	size_t n_hold_regs; /**< Number of holding register descriptors */
 
+	/**
+	 * @brief Optional precompiled address index for hold_regs
+	 *
+	 * @note Can be left as NULL, lookups then use mbreg_find_desc()
+	 * @note Build with mbreg_index_build(), mbreg_index_build_ranges() or
+	 *       mbreg_index_build_paged() before handling requests
+	 */
+	const struct mbreg_index_s *hold_regs_ix;
+
+	/**
+	 * @brief Optional kernels of hold_regs, see mbreg_kernel_s
+	 *
+	 * @note Can be left as NULL, registers are then accessed through mbreg_read() and mbreg_write()
+	 * @note Build with mbreg_kernels_build() and swap_words 0
+	 */
+	const struct mbreg_kernel_s *hold_regs_kern;
+
+	/**
+	 * @brief Optional sequence lock making holding register reads consistent snapshots
+	 *
+	 * @note Can be left as NULL for plain reads
+	 * @note Read callbacks may be called more than once per request
+	 * @note Only protects reads, writes are applied as without the lock
+	 */
+	const struct mbseqlock_s *hold_regs_lock;
+
+	/**
+	 * @brief Optional published image serving holding register reads, see mbimage_s
+	 *
+	 * @note Can be left as NULL to read the descriptors
+	 * @note Read lock callbacks are not called for reads served from the image
+	 * @note Writes go to the descriptors and are read back once the application
+	 *       published an image with them
+	 */
+	const struct mbimage_s *hold_regs_image;
+
 	/**
 	 * @brief File record descriptor map (Read/write file record access)
 	 *
@@ -129,6 +341,33 @@ struct mbinst_s {
 	const struct mbfile_desc_s *files;
 	size_t n_files; /**< Number of file descriptors */
 
+	/**
+	 * @brief Optional paged file number index for files
+	 *
+	 * @note Can be left as NULL, lookups then use mbfile_find()
+	 * @note Build with mbfile_index_build() before handling requests
+	 */
+	const struct mbfile_index_s *files_ix;
+
+	/**
+	 * @brief Device identification objects read with function code 0x2B / MEI type 0x0E, see mbdevid_s
+	 *
+	 * @note Can be left as NULL to pass device identification requests on to handle_fn_cb
+	 * @note Initialized with mbdevid_init() before use
+	 */
+	const struct mbdevid_s *devid;
+
+	/**
+	 * @brief Optional function code dispatch table
+	 *
+	 * Replaces the built-in handlers, e.g. to override a standard function code
+	 * or to add vendor function codes handled without going through handle_fn_cb.
+	 *
+	 * @note Can be left as NULL to use the built-in handlers
+	 * @note Start from mbpdu_fn_table_init(), the table is const and can be shared between instances
+	 */
+	const struct mbpdu_fn_table_s *fn_table;
+
 	/**
 	 * @brief Custom function handler for unsupported or missing function codes
 	 *
@@ -143,6 +382,7 @@ struct mbinst_s {
 	 * @param res Pointer to response PDU structure to populate
 	 *
 	 * @retval MB_OK Success
+	 * @retval MB_PENDING Response is produced later with mbpdu_complete()
 	 * @retval mbstatus_e Error codes for failure
 	 *
 	 * @note Can be left as NULL if custom functions are not needed
@@ -184,9 +424,28 @@ struct mbinst_s {
 	 * @note Called only once per request, even if multiple registers are written
 	 * @note Called after all individual post_write_cb callbacks have executed
 	 * @note Not called if any register write operation fails
+	 * @note Holding register writes use the commit policy instead when one is
+	 *       attached, see commit
 	 */
 	void (*commit_regs_write_cb)(const struct mbinst_s *inst);
 
+	/**
+	 * @brief Scope around a read/write multiple registers request (0x17)
+	 *
+	 * Called with begin 1 before the request is validated and with begin 0
+	 * once its write and read are done, including on failure. Taking the lock
+	 * the application holds while it updates the holding registers makes the
+	 * write and the following read one transaction, e.g. for handshakes
+	 * (write command, read status).
+	 *
+	 * @param inst Pointer to this Modbus instance
+	 * @param begin 1 when entering the scope, 0 when leaving it
+	 *
+	 * @note Can be left as NULL
+	 * @note Write, post_write_cb and commit callbacks run inside the scope
+	 */
+	void (*read_write_scope_cb)(const struct mbinst_s *inst, int begin);
+
 	/**
 	 * @brief Allow extended file record numbers
 	 *
@@ -294,6 +553,17 @@ struct mbinst_s {
 		 * @note Address 248 responses can help identify devices in large networks
 		 */
 		int enable_def_resp;
+
+		/**
+		 * @brief Precomputed CRCs of exception responses, see mbadu_exc_table_s
+		 *
+		 * Saves the CRC over exception responses sent at slave_addr, e.g. to a
+		 * scanner sweeping function codes.
+		 *
+		 * @note Can be left as NULL, exception responses are then CRC'd like others
+		 * @note Build for slave_addr with mbadu_exc_table_init()
+		 */
+		const struct mbadu_exc_table_s *exc_table;
 	} serial;
 
 	/**
@@ -309,65 +579,124 @@ struct mbinst_s {
 	int swap_words;
 
 	/**
-	 * @brief Internal state for diagnostics and status tracking
+	 * @brief Optional performance counters, see mbstats_s
 	 *
-	 * Contains internal state variables used by the library for tracking
-	 * device status and communication events. These fields are automatically
-	 * maintained by the library and support diagnostic function codes.
+	 * @note Can be left as NULL to skip instrumentation
+	 * @note Mutable, cleared by mbinst_init_worker() as each worker needs its own
+	 */
+	struct mbstats_s *stats;
+
+#if MBCFG_TRACE
+	/**
+	 * @brief Optional trace ring, see mbtrace_s
 	 *
-	 * @note Serial only
+	 * @note Can be left as NULL to record nothing
+	 * @note Mutable, cleared by mbinst_init_worker() as each worker needs its own
+	 */
+	struct mbtrace_s *trace;
+#endif
+
+	/**
+	 * @brief Optional commit policy coalescing holding register writes across requests, see mbcommit_s
 	 *
-	 * @note Shall not be accessed by client code directly
-	 * @note State is automatically updated during Modbus request processing
+	 * @note Can be left as NULL to call commit_regs_write_cb once per request
+	 * @note Mutable, cleared by mbinst_init_worker() as each worker needs its own
 	 */
-	struct {
-		int is_listen_only; /**< Whether the device is in a listen only mode or not */
+	struct mbcommit_s *commit;
 
-		uint16_t status; /**< Device status word (Not implemented) */
+	/**
+	 * @brief Optional dirty tracking of written coils, see mbdirty_s
+	 *
+	 * @note Can be left as NULL to not track written coils
+	 * @note Mutable, cleared by mbinst_init_worker() as each worker needs its own
+	 */
+	struct mbdirty_s *coils_dirty;
 
-		/**
-		 * @brief Communication event counter
-		 *
-		 * Incremented for each successful message completion.
-		 * Provides a simple metric for monitoring communication activity.
-		 *
-		 * @note Automatically incremented on successful message processing
-		 */
-		uint16_t comm_event_counter;
+	/**
+	 * @brief Optional dirty tracking of written holding registers, see mbdirty_s
+	 *
+	 * @note Can be left as NULL to not track written holding registers
+	 * @note Whole registers are marked, e.g. both addresses of a 32-bit register
+	 * @note Mutable, cleared by mbinst_init_worker() as each worker needs its own
+	 */
+	struct mbdirty_s *hold_regs_dirty;
 
-		/**
-		 * @brief Communication event log ring buffer
-		 *
-		 * Ring buffer for storing communication events and diagnostic information.
-		 * Automatically overwrites oldest events when buffer is full.
-		 */
-		uint8_t event_log[MB_COMM_EVENT_LOG_LEN];
-		int event_log_write_pos; /**< Write position in ring buffer (0 to MB_COMM_EVENT_LOG_LEN-1) */
-		int event_log_count; /**< Number of events currently in buffer (0 to MB_COMM_EVENT_LOG_LEN) */
-
-		uint16_t bus_msg_counter; /**< Total messages on bus (all devices, including CRC errors) */
-		uint16_t bus_comm_err_counter; /**< CRC/LRC error count */
-		uint16_t exception_counter; /**< Exception responses sent by this device */
-		uint16_t msg_counter; /**< Messages addressed to this device */
-		uint16_t no_resp_counter; /**< Messages to this device with no response sent */
-		uint16_t nak_counter; /**< NAK exception responses sent */
-		uint16_t busy_counter; /**< BUSY exception responses sent */
-		uint16_t bus_char_overrun_counter; /**< Character overrun errors (not currently tracked - Could be incremented by implementation rtu) */
+	/**
+	 * @brief Optional cache of read responses, see mbcache_s
+	 *
+	 * @note Can be left as NULL to handle every read request
+	 * @note Mutable, cleared by mbinst_init_worker() as each worker needs its own
+	 */
+	struct mbcache_s *cache;
 
-		/**
-		 * @brief ASCII frame delimiter character for Modbus ASCII
-		 *
-		 * Character used to delimit the end of Modbus ASCII frames. The Modbus ASCII
-		 * specification defines that frames should end with CR LF (\r\n), but this
-		 * field allows customization of the line ending character.
-		 *
-		 * @note Default value is '\n' (0x0A - Line Feed)
-		 * @note Set through function 0x08 with sub function 0x0003
-		 *
-		 * @note Modbus ASCII only
-		 */
-		uint8_t ascii_delimiter;
-	} state;
+	/**
+	 * @brief Optional plans of repeated register reads, see mbplan_s
+	 *
+	 * @note Can be left as NULL to search the map for every read
+	 * @note Mutable, cleared by mbinst_init_worker() as each worker needs its own
+	 */
+	struct mbplan_s *plan;
+
+	/**
+	 * @brief Optional cache of function register values across requests, see mbreg_fn_cache_s
+	 *
+	 * @note Can be left as NULL, read functions are then called once per request
+	 * @note Mutable, cleared by mbinst_init_worker() as each worker needs its own
+	 */
+	struct mbreg_fn_cache_s *fn_cache;
+
+	/**
+	 * @brief Optional scratch arena for handler temporaries, see mbarena_s
+	 *
+	 * Holds the descriptors found while validating multiple register and file
+	 * record requests, reset when each request starts.
+	 *
+	 * @note Can be left as NULL, descriptors are then searched again when writing
+	 * @note Mutable, cleared by mbinst_init_worker() as each worker needs its own
+	 */
+	struct mbarena_s *arena;
+
+	/**
+	 * @brief Optional request rate limit of this slave / unit id, see mbrate_s
+	 *
+	 * Requests above the rate get an MB_BUSY exception response without being
+	 * handled, counted by mbinst_state_s::busy_counter.
+	 *
+	 * @note Can be left as NULL to handle every request
+	 * @note Mutable, cleared by mbinst_init_worker() as each worker needs its own
+	 */
+	struct mbrate_s *rate;
+
+	/**
+	 * @brief Optional limit of descriptor operations per request
+	 *
+	 * Requests asking for more coils, registers or FIFO entries than this
+	 * (see mbpdu_req_work()) get an MB_BUSY exception response before any
+	 * descriptor is looked at, counted by mbinst_state_s::busy_counter.
+	 * Bounds the time of handling a request to fit a time slot.
+	 *
+	 * @note 0 for no limit
+	 */
+	uint32_t work_budget;
+
+	/**
+	 * @brief FIFO queues read with function code 0x18 (Read FIFO Queue), see mbfifo_s
+	 *
+	 * @note Can be left as NULL if FIFO queues are not needed
+	 * @note Mutable, cleared by mbinst_init_worker() as a FIFO has a single consumer
+	 */
+	struct mbfifo_s *fifos;
+	size_t n_fifos; /**< Number of FIFO queues */
+
+	/**
+	 * @brief Internal state for diagnostics and status tracking
+	 *
+	 * @note Written while handling requests, like the optional attachments
+	 *       marked Mutable, everything else is configuration that may be
+	 *       shared between workers
+	 * @note Shall not be accessed by client code directly
+	 */
+	struct mbinst_state_s state;
 };
 
 /**
@@ -379,11 +708,167 @@ struct mbinst_s {
  */
 extern void mbinst_init(struct mbinst_s *inst);
 
+/**
+ * @brief Initialize a worker instance sharing the configuration of base
+ *
+ * Copies the configuration and descriptor map pointers of base and gives the
+ * worker its own freshly initialized state. The optional attachments marked
+ * Mutable are not copied. Workers can then handle requests in parallel (e.g.
+ * one per thread) as long as the descriptor data accessed through pointers and
+ * callbacks is safe to use concurrently.
+ *
+ * @param worker Worker instance to initialize
+ * @param base Instance holding the shared configuration (Not modified)
+ */
+extern void mbinst_init_worker(struct mbinst_s *worker, const struct mbinst_s *base);
+
+/**
+ * @brief Descriptor maps of an instance, see mbinst_prep_s::issue_map
+ */
+enum mbinst_map_e {
+	MBINST_MAP_COILS,
+	MBINST_MAP_DISC_INPUTS,
+	MBINST_MAP_HOLD_REGS,
+	MBINST_MAP_INPUT_REGS,
+	MBINST_MAP_FILES,
+};
+
+/**
+ * @brief Storage and report of mbinst_prepare()
+ *
+ * The indices are built into ix_buf in the order holding registers, input
+ * registers, coils, discrete inputs and files. A register index is dense or
+ * paged, whichever is smaller, when it fits in the storage left, as ranges
+ * otherwise, and none when not even the ranges fit. Coil and file indices are
+ * paged when they fit. Kernels are resolved into kern_buf for each register
+ * map that fits, holding registers first.
+ *
+ * @note Storage fields are set by the application, the remaining fields are
+ *       set by mbinst_prepare()
+ * @note Must outlive the instance, which points into it
+ */
+struct mbinst_prep_s {
+	uint16_t *ix_buf; /**< Storage for the register indices (Can be NULL) */
+	size_t ix_buf_len; /**< Number of entries in ix_buf */
+	struct mbreg_kernel_s *kern_buf; /**< Storage for the register kernels (Can be NULL) */
+	size_t kern_buf_len; /**< Number of entries in kern_buf */
+
+	/**
+	 * @brief Monotonic clock timing the preparation
+	 *
+	 * @note Can be left as NULL, ticks is then 0
+	 */
+	uint64_t (*clock_cb)(void);
+
+	/**
+	 * @brief Nonzero to only accept constant time lookups
+	 *
+	 * Register maps get a dense or paged index but no range index, and
+	 * preparing fails if a non-empty map is left without an index, so the
+	 * time of every descriptor lookup is bounded independently of the map.
+	 */
+	int const_time;
+
+	struct mbreg_index_s hold_regs_ix; /**< Index of the holding registers, attached when built */
+	struct mbreg_index_s input_regs_ix; /**< Index of the input registers, attached when built */
+	struct mbcoil_index_s coils_ix; /**< Index of the coils, attached when built */
+	struct mbcoil_index_s disc_inputs_ix; /**< Index of the discrete inputs, attached when built */
+	struct mbfile_index_s files_ix; /**< Index of the files, attached when built */
+
+	size_t n_ix_used; /**< Entries of ix_buf used */
+	size_t n_kern_used; /**< Entries of kern_buf used */
+	size_t n_bytes; /**< Bytes of ix_buf and kern_buf used */
+	uint64_t ticks; /**< Time taken, in clock_cb units */
+
+	enum mbinst_map_e issue_map; /**< Map of the first invalid descriptor */
+	uint16_t issue_addr; /**< Address (File number for files) of the first invalid descriptor */
+};
+
+/**
+ * @brief Validate the maps of an instance and build their lookup structures
+ *
+ * Checks every map in one pass each (see mbcoil_validate() and
+ * mbreg_validate(), files ascending by file number), then builds the
+ * indices and register kernels into the storage of prep and attaches them
+ * through the *_ix and *_kern fields of the instance.
+ * The instance state is not touched, so maps can be reloaded at runtime.
+ *
+ * @param inst Instance with its maps set
+ * @param prep Storage, report on return
+ *
+ * @retval 1 Maps valid, prep reports the storage used and time taken
+ * @retval 0 Invalid descriptor at prep->issue_addr of prep->issue_map, or
+ *           with prep->const_time no index for that map (issue_addr is its
+ *           first address), the instance is left unchanged
+ *
+ * @note Time complexity: O(n) in the number of descriptors, plus the span of
+ *       dense indices
+ * @note Must not run while the instance (or a worker copied from it) handles requests
+ * @note Workers initialized afterwards share the index and kernels
+ */
+extern int mbinst_prepare(struct mbinst_s *inst, struct mbinst_prep_s *prep);
+
+/**
+ * @brief Sum diagnostic counters of several instances
+ *
+ * Counters wrap at 16 bits, like the counters of a single instance.
+ *
+ * @param sum Out parameter with the summed counters, other state fields are cleared
+ * @param insts Instances (e.g. workers) to sum the counters of
+ * @param n_insts Number of instances
+ *
+ * @note Values may be slightly out of date when workers are running concurrently
+ */
+extern void mbinst_sum_counters(struct mbinst_state_s *sum, const struct mbinst_s *insts, size_t n_insts);
+
+#if MBCFG_EVENT_LOG_EXTERN
+/**
+ * @brief Attach the communication event log buffer of an instance
+ *
+ * @param inst Instance, after mbinst_init() or mbinst_init_worker()
+ * @param event_log Buffer of MB_COMM_EVENT_LOG_LEN bytes, or NULL to not log events
+ *
+ * @note Each instance (and worker) needs a buffer of its own
+ */
+extern void mbinst_set_event_log(struct mbinst_s *inst, uint8_t *event_log);
+#endif
+
+/**
+ * @brief Maps with dirty tracking, see mbinst_consume_dirty()
+ */
+enum mbinst_dirty_map_e {
+	MBINST_DIRTY_COILS,
+	MBINST_DIRTY_HOLD_REGS,
+};
+
+/**
+ * @brief Take the coils or holding registers written since the last call
+ *
+ * @param inst Instance with dirty tracking attached
+ * @param map Map to consume
+ * @param ranges Out parameter with the written address ranges, merged and in ascending order
+ * @param max_ranges Number of entries in ranges
+ *
+ * @return Number of ranges returned, 0 if nothing was written or the map is not tracked
+ *
+ * @note Ranges that do not fit stay dirty for the next call, see mbdirty_consume()
+ */
+extern size_t mbinst_consume_dirty(
+	const struct mbinst_s *inst,
+	enum mbinst_dirty_map_e map,
+	struct mbdirty_range_s *ranges,
+	size_t max_ranges);
+
 /**
  * @brief Add a communication event to the log
  *
  * @note Library internal function
+ * @note Nothing is recorded, at no cost, when MBCFG_EVENT_LOG is 0
  */
+#if MBCFG_EVENT_LOG
 extern void mb_add_comm_event(struct mbinst_s *inst, uint8_t event);
+#else
+#define mb_add_comm_event(inst, event) ((void)(inst), (void)(event))
+#endif
 
 #endif /* MBINST_H_INCLUDED */
@@ -0,0 +1,366 @@
+/**
+ * @file mbmap.hpp
+ * @brief Modbus Map - Compile time register descriptor tables for C++
+ * @author Jonas Almås
+ *
+ * @details C++17 helpers building register descriptor tables as constexpr
+ * arrays. The register type is deduced from the pointer, value or callback
+ * type, so type and access method cannot disagree. The tables are checked with
+ * static_assert for ascending order and overlap, and the precompiled address
+ * index (mbreg_index_s) is emitted at compile time. Tables and index are
+ * constant data, no validation or index build runs at startup.
+ *
+ * @note Uses designated initializers for the descriptor unions, supported as
+ *       an extension by GCC and Clang in C++17
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+#ifndef MBMAP_HPP_INCLUDED
+#define MBMAP_HPP_INCLUDED
+
+extern "C" {
+#include "mbdef.h"
+#include "mbreg.h"
+}
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if MBCFG_COMPACT_REGS
+#error "mbmap.hpp does not support MBCFG_COMPACT_REGS"
+#endif
+
+namespace mbmap {
+
+namespace detail {
+
+using read_u = decltype(mbreg_desc_s::read);
+using write_u = decltype(mbreg_desc_s::write);
+
+/**
+ * @brief Register type and descriptor union members of a C type
+ */
+template <typename T>
+struct reg_type;
+
+#define MBMAP_REG_TYPE(T, TYPE, SFX) \
+	template <> \
+	struct reg_type<T> { \
+		static constexpr unsigned type = TYPE; \
+		static constexpr read_u val(T v) { return __extension__ read_u{.SFX=v}; } \
+		static constexpr read_u ptr_r(const volatile T *p) { return __extension__ read_u{.p##SFX=const_cast<volatile T *>(p)}; } \
+		static constexpr write_u ptr_w(volatile T *p) { return __extension__ write_u{.p##SFX=p}; } \
+		static constexpr read_u fn_r(T (*fn)(void)) { return __extension__ read_u{.f##SFX=fn}; } \
+		static constexpr write_u fn_w(enum mbstatus_e (*fn)(T)) { return __extension__ write_u{.f##SFX=fn}; } \
+	}
+
+MBMAP_REG_TYPE(uint8_t, MRTYPE_U8, u8);
+MBMAP_REG_TYPE(uint16_t, MRTYPE_U16, u16);
+MBMAP_REG_TYPE(uint32_t, MRTYPE_U32, u32);
+MBMAP_REG_TYPE(uint64_t, MRTYPE_U64, u64);
+MBMAP_REG_TYPE(int8_t, MRTYPE_I8, i8);
+MBMAP_REG_TYPE(int16_t, MRTYPE_I16, i16);
+MBMAP_REG_TYPE(int32_t, MRTYPE_I32, i32);
+MBMAP_REG_TYPE(int64_t, MRTYPE_I64, i64);
+MBMAP_REG_TYPE(float, MRTYPE_F32, f32);
+MBMAP_REG_TYPE(double, MRTYPE_F64, f64);
+
+#undef MBMAP_REG_TYPE
+
+/**
+ * @brief Descriptor with all members initialized
+ */
+constexpr mbreg_desc_s desc(
+	uint16_t address,
+	unsigned type,
+	unsigned access,
+	read_u read,
+	write_u write,
+	size_t n_block_entries = 0u)
+{
+	return __extension__ mbreg_desc_s{
+		.address=address,
+		.byte_order=MBREG_ORDER_DEFAULT,
+		.type=static_cast<enum mbreg_type_e>(type),
+		.access=static_cast<enum mbreg_access_e>(access),
+		.read=read,
+		.write=write,
+		.rlock_cb=nullptr,
+		.wlock_cb=nullptr,
+		.wlock_override_cb=nullptr,
+		.n_block_entries=n_block_entries,
+		.post_write_cb=nullptr,
+	};
+}
+
+/**
+ * @brief Exclusive end address of a descriptor, see reg_end() in mbreg.c
+ */
+constexpr size_t reg_end(const mbreg_desc_s &reg)
+{
+	size_t size_w = (static_cast<unsigned>(reg.type) & MRTYPE_SIZE_MASK) / 16u;
+
+	if (size_w == 0u) size_w = 1u; /* 8-bit values use one register */
+	if ((static_cast<unsigned>(reg.type) & MRTYPE_BLOCK) != 0u) {
+		return static_cast<size_t>(reg.address) + (reg.n_block_entries * size_w);
+	}
+	return static_cast<size_t>(reg.address) + size_w;
+}
+
+/**
+ * @brief Whether access has at most one read and one write method
+ */
+constexpr bool is_single_method(unsigned access, unsigned mask)
+{
+	unsigned m = access & mask;
+	return (m & (m - 1u)) == 0u;
+}
+
+} /* namespace detail */
+
+/**
+ * @brief Read only register backed by a variable (MRACC_R_PTR)
+ */
+template <typename T>
+constexpr mbreg_desc_s ro(uint16_t address, const volatile T *p)
+{
+	return detail::desc(address, detail::reg_type<T>::type, MRACC_R_PTR,
+		detail::reg_type<T>::ptr_r(p), detail::write_u{});
+}
+
+/**
+ * @brief Read/write register backed by a variable (MRACC_RW_PTR)
+ */
+template <typename T>
+constexpr mbreg_desc_s rw(uint16_t address, volatile T *p)
+{
+	return detail::desc(address, detail::reg_type<T>::type, MRACC_RW_PTR,
+		detail::reg_type<T>::ptr_r(p), detail::reg_type<T>::ptr_w(p));
+}
+
+/**
+ * @brief Register with a constant value (MRACC_R_VAL)
+ */
+template <typename T>
+constexpr mbreg_desc_s val(uint16_t address, T v)
+{
+	return detail::desc(address, detail::reg_type<T>::type, MRACC_R_VAL,
+		detail::reg_type<T>::val(v), detail::write_u{});
+}
+
+/**
+ * @brief Read only register backed by a function (MRACC_R_FN)
+ */
+template <typename T>
+constexpr mbreg_desc_s fn(uint16_t address, T (*read)(void))
+{
+	return detail::desc(address, detail::reg_type<T>::type, MRACC_R_FN,
+		detail::reg_type<T>::fn_r(read), detail::write_u{});
+}
+
+/**
+ * @brief Read/write register backed by functions (MRACC_RW_FN)
+ */
+template <typename T>
+constexpr mbreg_desc_s fn(uint16_t address, T (*read)(void), enum mbstatus_e (*write)(T))
+{
+	return detail::desc(address, detail::reg_type<T>::type, MRACC_RW_FN,
+		detail::reg_type<T>::fn_r(read), detail::reg_type<T>::fn_w(write));
+}
+
+/**
+ * @brief Read only block backed by an array (MRTYPE_BLOCK, MRACC_R_PTR)
+ */
+template <typename T, size_t N>
+constexpr mbreg_desc_s block_ro(uint16_t address, const volatile T (&arr)[N])
+{
+	return detail::desc(address, detail::reg_type<T>::type | MRTYPE_BLOCK, MRACC_R_PTR,
+		detail::reg_type<T>::ptr_r(arr), detail::write_u{}, N);
+}
+
+/**
+ * @brief Read/write block backed by an array (MRTYPE_BLOCK, MRACC_RW_PTR)
+ */
+template <typename T, size_t N>
+constexpr mbreg_desc_s block_rw(uint16_t address, volatile T (&arr)[N])
+{
+	return detail::desc(address, detail::reg_type<T>::type | MRTYPE_BLOCK, MRACC_RW_PTR,
+		detail::reg_type<T>::ptr_r(arr), detail::reg_type<T>::ptr_w(arr), N);
+}
+
+/**
+ * @brief Copy of a descriptor with a post write callback
+ */
+constexpr mbreg_desc_s post_write(mbreg_desc_s reg, void (*cb)(void))
+{
+	reg.post_write_cb = cb;
+	return reg;
+}
+
+/**
+ * @brief Copy of a descriptor with a byte order
+ */
+constexpr mbreg_desc_s ordered(mbreg_desc_s reg, enum mbreg_order_e order)
+{
+	reg.byte_order = static_cast<uint8_t>(order);
+	return reg;
+}
+
+/**
+ * @brief Copy of a descriptor with read and write lock callbacks
+ */
+constexpr mbreg_desc_s locked(mbreg_desc_s reg, int (*rlock_cb)(void), int (*wlock_cb)(void))
+{
+	reg.rlock_cb = rlock_cb;
+	reg.wlock_cb = wlock_cb;
+	return reg;
+}
+
+/**
+ * @brief Register descriptor table from descriptors in ascending address order
+ */
+template <typename... D>
+constexpr std::array<mbreg_desc_s, sizeof...(D)> regs(D... descs)
+{
+	return {{descs...}};
+}
+
+/**
+ * @brief Whether addresses are strictly ascending
+ */
+template <size_t N>
+constexpr bool is_ascending(const std::array<mbreg_desc_s, N> &map)
+{
+	for (size_t i=1u; i<N; ++i) {
+		if (map[i].address <= map[i-1u].address) return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Whether no descriptor starts before the previous one ends
+ */
+template <size_t N>
+constexpr bool is_non_overlapping(const std::array<mbreg_desc_s, N> &map)
+{
+	for (size_t i=1u; i<N; ++i) {
+		if (map[i].address < detail::reg_end(map[i-1u])) return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Whether every descriptor has a valid type and access combination
+ *
+ * Mirrors mbtest_regs_valid_data_type(), mbtest_regs_valid_access() and
+ * mbtest_regs_valid_block_access() for the access and type fields.
+ */
+template <size_t N>
+constexpr bool is_valid_access(const std::array<mbreg_desc_s, N> &map)
+{
+	for (size_t i=0u; i<N; ++i) {
+		const unsigned access = static_cast<unsigned>(map[i].access);
+		const unsigned type = static_cast<unsigned>(map[i].type);
+
+		switch (type & MRTYPE_MASK) {
+		case MRTYPE_U8: case MRTYPE_U16: case MRTYPE_U32: case MRTYPE_U64:
+		case MRTYPE_I8: case MRTYPE_I16: case MRTYPE_I32: case MRTYPE_I64:
+		case MRTYPE_F32: case MRTYPE_F64:
+			break;
+		default:
+			return false;
+		}
+
+		if (access == 0u) return false;
+		if (!detail::is_single_method(access, MRACC_R_MASK)) return false;
+		if (!detail::is_single_method(access, MRACC_W_MASK)) return false;
+
+		if ((type & MRTYPE_BLOCK) != 0u) {
+			if (map[i].n_block_entries == 0u) return false;
+			if (((access & MRACC_R_MASK) != 0u) && ((access & (MRACC_R_PTR|MRACC_R_BULK)) == 0u)) return false;
+			if (((access & MRACC_W_MASK) != 0u) && ((access & (MRACC_W_PTR|MRACC_W_BULK)) == 0u)) return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief All compile time checks of a table, for use with static_assert
+ */
+template <size_t N>
+constexpr bool is_valid(const std::array<mbreg_desc_s, N> &map)
+{
+	return is_ascending(map) && is_non_overlapping(map) && is_valid_access(map);
+}
+
+/**
+ * @brief Number of index slots of a table, see mbreg_index_span()
+ */
+template <size_t N>
+constexpr size_t index_span(const std::array<mbreg_desc_s, N> &map)
+{
+	size_t end = 0u;
+
+	for (size_t i=0u; i<N; ++i) {
+		if (detail::reg_end(map[i]) > end) end = detail::reg_end(map[i]);
+	}
+	return ((N > 0u) && (end > map[0].address)) ? (end - map[0].address) : 0u;
+}
+
+/**
+ * @brief Index slots of a table, as built by mbreg_index_build()
+ *
+ * @tparam N_SLOTS index_span() of the table
+ */
+template <size_t N_SLOTS, size_t N>
+constexpr std::array<uint16_t, N_SLOTS> index_slots(const std::array<mbreg_desc_s, N> &map)
+{
+	static_assert(N < 0xFFFFu, "Positions are stored as u16");
+
+	std::array<uint16_t, N_SLOTS> slots{};
+	for (size_t i=0u; i<N; ++i) {
+		for (size_t slot=map[i].address-map[0].address; slot<(detail::reg_end(map[i])-map[0].address); ++slot) {
+			slots[slot] = static_cast<uint16_t>(i + 1u);
+		}
+	}
+	return slots;
+}
+
+/**
+ * @brief Precompiled index of a table, for mbinst_s::hold_regs_ix or mbinst_s::input_regs_ix
+ *
+ * @note map and slots must have static storage duration
+ */
+template <size_t N_SLOTS, size_t N>
+constexpr mbreg_index_s index(
+	const std::array<mbreg_desc_s, N> &map,
+	const std::array<uint16_t, N_SLOTS> &slots)
+{
+	return mbreg_index_s{map.data(), N, map[0].address, N_SLOTS, slots.data(), nullptr, nullptr};
+}
+
+} /* namespace mbmap */
+
+#endif /* MBMAP_HPP_INCLUDED */
@@ -0,0 +1,139 @@
+/**
+ * @file mbpage.c
+ * @brief Modbus Page Table - Constant time lookups for sparse maps
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbpage.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {
+	PAGE_SHIFT = 8u, /* log2(MBPAGE_SIZE) */
+	KEY_SPACE = MBPAGE_N_PAGES * MBPAGE_SIZE,
+};
+
+/**
+ * @brief Mark the pages covered by a map, counting them
+ *
+ * @return Number of populated pages, or KEY_SPACE for an unsorted, overlapping or too large map
+ */
+static size_t mark_pages(
+	uint8_t *used,
+	const void *map,
+	size_t n,
+	size_t (*span_cb)(const void *map, size_t i, uint16_t *first))
+{
+	size_t i, span, end, prev_end, page, n_pages;
+	uint16_t first;
+
+	(void)memset(used, 0, MBPAGE_N_PAGES);
+	n_pages = 0u;
+	prev_end = 0u;
+	for (i=0u; i<n; ++i) {
+		span = span_cb(map, i, &first);
+		if (span==0u) continue;
+
+		end = (size_t)first + span;
+		if ((first < prev_end) || (end > KEY_SPACE)) return KEY_SPACE;
+		prev_end = end;
+
+		for (page=(size_t)first >> PAGE_SHIFT; page<=((end - 1u) >> PAGE_SHIFT); ++page) {
+			if (used[page]==0u) {
+				used[page] = 1u;
+				++n_pages;
+			}
+		}
+	}
+
+	return n_pages;
+}
+
+extern size_t mbpage_size(
+	const void *map,
+	size_t n,
+	size_t (*span_cb)(const void *map, size_t i, uint16_t *first))
+{
+	uint8_t used[MBPAGE_N_PAGES];
+	size_t n_pages;
+
+	if ((map==NULL) || (span_cb==NULL)) return 0u;
+
+	n_pages = mark_pages(used, map, n, span_cb);
+	return (n_pages > MBPAGE_N_PAGES) ? 0u : MBPAGE_STORAGE_SIZE(n_pages);
+}
+
+extern int mbpage_build(
+	struct mbpage_s *pt,
+	const void *map,
+	size_t n,
+	size_t (*span_cb)(const void *map, size_t i, uint16_t *first),
+	uint16_t *storage,
+	size_t storage_len)
+{
+	uint8_t used[MBPAGE_N_PAGES];
+	uint16_t *dir, *leaves;
+	size_t i, key, span, n_pages, page, leaf;
+	uint16_t first;
+
+	if (pt==NULL) return 0;
+
+	pt->dir = NULL;
+	pt->leaves = NULL;
+
+	if ((map==NULL) || (span_cb==NULL) || (storage==NULL) || (n >= 0xFFFFu)) return 0;
+
+	n_pages = mark_pages(used, map, n, span_cb);
+	if ((n_pages > MBPAGE_N_PAGES) || (storage_len < MBPAGE_STORAGE_SIZE(n_pages))) return 0;
+
+	/* Leaf 0 is the empty leaf shared by all pages without descriptors */
+	dir = storage;
+	leaves = storage + MBPAGE_N_PAGES;
+	(void)memset(leaves, 0, (n_pages + 1u) * MBPAGE_SIZE * sizeof leaves[0]);
+	leaf = 0u;
+	for (page=0u; page<MBPAGE_N_PAGES; ++page) {
+		dir[page] = (used[page]!=0u) ? (uint16_t)++leaf : 0u;
+	}
+
+	for (i=0u; i<n; ++i) {
+		span = span_cb(map, i, &first);
+		for (key=first; key<((size_t)first + span); ++key) {
+			leaves[((size_t)dir[key >> PAGE_SHIFT] * MBPAGE_SIZE) + (key & (MBPAGE_SIZE - 1u))] = (uint16_t)(i + 1u);
+		}
+	}
+
+	pt->dir = dir;
+	pt->leaves = leaves;
+
+	return 1;
+}
+
+extern uint16_t mbpage_find(const struct mbpage_s *pt, uint16_t key)
+{
+	return pt->leaves[((size_t)pt->dir[key >> PAGE_SHIFT] * MBPAGE_SIZE) + (key & (MBPAGE_SIZE - 1u))];
+}
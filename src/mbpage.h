@@ -0,0 +1,112 @@
+/**
+ * @file mbpage.h
+ * @brief Modbus Page Table - Constant time lookups for sparse maps
+ * @author Jonas Almås
+ *
+ * @details Two-level lookup table from a 16-bit key (register or coil address,
+ * file number) to the position of the descriptor containing it. The directory
+ * holds one leaf number per 256 keys, pages without descriptors share one empty
+ * leaf, so storage grows with the populated pages only and a lookup is two
+ * loads regardless of how sparse the map is.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBPAGE_H_INCLUDED
+#define MBPAGE_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+	MBPAGE_N_PAGES = 256u, /**< Directory entries, pages of the key space */
+	MBPAGE_SIZE = 256u, /**< Keys per page */
+};
+
+/**
+ * @brief Number of uint16_t storage entries for a table with n_pages populated pages
+ *
+ * The directory, the shared empty leaf and one leaf per populated page.
+ */
+#define MBPAGE_STORAGE_SIZE(n_pages) (MBPAGE_N_PAGES + (((size_t)(n_pages) + 1u) * MBPAGE_SIZE))
+
+/**
+ * @brief Page table built by mbpage_build()
+ *
+ * @note Shall not be accessed by client code directly
+ */
+struct mbpage_s {
+	const uint16_t *dir; /**< Leaf number of each page, 0 for the shared empty leaf. NULL if not built */
+	const uint16_t *leaves; /**< Leaves of MBPAGE_SIZE entries, descriptor position+1 or 0 if unmapped */
+};
+
+/**
+ * @brief Get the storage required to build a page table
+ *
+ * @param map Descriptor array
+ * @param n Number of descriptors in map
+ * @param span_cb Keys covered by descriptor i, first key returned through first
+ *
+ * @return Number of uint16_t storage entries, see MBPAGE_STORAGE_SIZE()
+ */
+extern size_t mbpage_size(
+	const void *map,
+	size_t n,
+	size_t (*span_cb)(const void *map, size_t i, uint16_t *first));
+
+/**
+ * @brief Build a page table into caller supplied storage
+ *
+ * @param pt Table to initialize
+ * @param map Descriptor array, keys ascending and not overlapping
+ * @param n Number of descriptors in map, below 0xFFFF
+ * @param span_cb Keys covered by each descriptor
+ * @param storage Storage of at least mbpage_size() entries
+ * @param storage_len Number of entries in storage
+ *
+ * @retval 1 Table built
+ * @retval 0 Too little storage, unsorted or overlapping map, table left empty
+ *
+ * @note Time complexity: O(n + keys covered)
+ */
+extern int mbpage_build(
+	struct mbpage_s *pt,
+	const void *map,
+	size_t n,
+	size_t (*span_cb)(const void *map, size_t i, uint16_t *first),
+	uint16_t *storage,
+	size_t storage_len);
+
+/**
+ * @brief Look up the descriptor containing a key
+ *
+ * @param pt Table built with mbpage_build()
+ * @param key Key to look up
+ *
+ * @return Descriptor position+1, 0 if the key is not mapped
+ */
+extern uint16_t mbpage_find(const struct mbpage_s *pt, uint16_t key);
+
+#endif /* MBPAGE_H_INCLUDED */
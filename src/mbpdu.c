@@ -34,112 +34,537 @@
 
 #include "mbpdu.h"
 #include "endian.h"
+#include "mbarena.h"
+#include "mbcache.h"
+#include "mbcoil.h"
+#include "mbconfig.h"
 #include "mbdef.h"
 #include "mbfn_coils.h"
+#include "mbfn_devid.h"
 #include "mbfn_diag.h"
+#include "mbfn_fifo.h"
 #include "mbfn_files.h"
 #include "mbfn_regs.h"
 #include "mbfn_serial.h"
+#include "mbrate.h"
+#include "mbreg.h"
+#include "mbstats.h"
+#include "mbtrace.h"
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
-static enum mbstatus_e handle(
+/**
+ * @brief Pass a request on to mbinst_s::handle_fn_cb, if any
+ */
+static enum mbstatus_e fallback(
 	struct mbinst_s *inst,
 	const uint8_t *req,
 	size_t req_len,
 	struct mbpdu_buf_s *res)
 {
-	switch (req[0]) {
+	if (inst->handle_fn_cb!=NULL) {
+		return inst->handle_fn_cb(inst, req, req_len, res);
+	} else {
+		return MB_ILLEGAL_FN;
+	}
+}
+
+/*
+ * Default handlers, binding the function code handlers to the maps of the
+ * instance. Without the map the request is passed on to handle_fn_cb.
+ */
+#if MBCFG_COILS
+static enum mbstatus_e fn_read_coils(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->coils==NULL) return fallback(inst, req, req_len, res);
+	return mbfn_read_coils(inst, inst->coils, inst->n_coils, req, req_len, res);
+}
+
+static enum mbstatus_e fn_write_coil(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->coils==NULL) return fallback(inst, req, req_len, res);
+	return mbfn_write_coil(inst, inst->coils, inst->n_coils, req, req_len, res);
+}
+
+static enum mbstatus_e fn_write_coils(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->coils==NULL) return fallback(inst, req, req_len, res);
+	return mbfn_write_coils(inst, inst->coils, inst->n_coils, req, req_len, res);
+}
+#endif
+
+#if MBCFG_DISC_INPUTS
+static enum mbstatus_e fn_read_disc_inputs(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->disc_inputs==NULL) return fallback(inst, req, req_len, res);
+	return mbfn_read_coils(inst, inst->disc_inputs, inst->n_disc_inputs, req, req_len, res);
+}
+#endif
+
+#if MBCFG_HOLD_REGS
+static enum mbstatus_e fn_read_hold_regs(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->hold_regs==NULL) return fallback(inst, req, req_len, res);
+	return mbfn_read_regs(inst, inst->hold_regs, inst->n_hold_regs, req, req_len, res);
+}
+
+static enum mbstatus_e fn_write_reg(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->hold_regs==NULL) return fallback(inst, req, req_len, res);
+	return mbfn_write_reg(inst, inst->hold_regs, inst->n_hold_regs, req, req_len, res);
+}
+
+static enum mbstatus_e fn_write_regs(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->hold_regs==NULL) return fallback(inst, req, req_len, res);
+	return mbfn_write_regs(inst, inst->hold_regs, inst->n_hold_regs, req, req_len, res);
+}
+#endif
+
+#if MBCFG_INPUT_REGS
+static enum mbstatus_e fn_read_input_regs(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->input_regs==NULL) return fallback(inst, req, req_len, res);
+	return mbfn_read_regs(inst, inst->input_regs, inst->n_input_regs, req, req_len, res);
+}
+#endif
+
+#if MBCFG_MASK_WRITE_REG
+static enum mbstatus_e fn_mask_write_reg(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->hold_regs==NULL) return fallback(inst, req, req_len, res);
+	return mb_fn_mask_write_reg(inst, inst->hold_regs, inst->n_hold_regs, req, req_len, res);
+}
+#endif
+
+#if MBCFG_READ_WRITE_REGS
+static enum mbstatus_e fn_read_write_regs(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->hold_regs==NULL) return fallback(inst, req, req_len, res);
+	return mbfn_read_write_regs(inst, inst->hold_regs, inst->n_hold_regs, req, req_len, res);
+}
+#endif
+
+#if MBCFG_SERIAL_DIAG
+static enum mbstatus_e fn_read_exception_status(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->serial.read_exception_status_cb==NULL) return fallback(inst, req, req_len, res);
+	return mbfn_read_exception_status(inst, req, req_len, res);
+}
+
+static enum mbstatus_e fn_comm_event_counter(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	return mbfn_comm_event_counter(inst, req, req_len, res);
+}
+
+static enum mbstatus_e fn_comm_event_log(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	return mbfn_comm_event_log(inst, req, req_len, res);
+}
+#endif
+
+#if MBCFG_FILES
+static enum mbstatus_e fn_read_file(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->files==NULL) return fallback(inst, req, req_len, res);
+	return mbfn_file_read(inst, req, req_len, res);
+}
+
+static enum mbstatus_e fn_write_file(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->files==NULL) return fallback(inst, req, req_len, res);
+	return mbfn_file_write(inst, req, req_len, res);
+}
+#endif
+
+#if MBCFG_DEVID
+static enum mbstatus_e fn_encap_iface(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if ((inst->devid==NULL) || (req_len < 2u) || (req[1]!=MBMEI_READ_DEV_ID)) {
+		return fallback(inst, req, req_len, res);
+	}
+	return mbfn_read_dev_id(inst, req, req_len, res);
+}
+#endif
+
+#if MBCFG_FIFO
+static enum mbstatus_e fn_read_fifo(struct mbinst_s *inst, const uint8_t *req, size_t req_len, struct mbpdu_buf_s *res)
+{
+	if (inst->fifos==NULL) return fallback(inst, req, req_len, res);
+	return mbfn_read_fifo(inst, req, req_len, res);
+}
+#endif
+
+/*
+ * Function codes without an entry, e.g. 0x11 (Report Slave ID), are passed
+ * on to handle_fn_cb.
+ */
+static const struct mbpdu_fn_table_s s_default_fn_table = {.fn={
+#if MBCFG_COILS
+	[MBFC_READ_COILS] = fn_read_coils,
+	[MBFC_WRITE_SINGLE_COIL] = fn_write_coil,
+	[MBFC_WRITE_MULTIPLE_COILS] = fn_write_coils,
+#endif
+#if MBCFG_DISC_INPUTS
+	[MBFC_READ_DISC_INPUTS] = fn_read_disc_inputs,
+#endif
+#if MBCFG_HOLD_REGS
+	[MBFC_READ_HOLDING_REGS] = fn_read_hold_regs,
+	[MBFC_WRITE_SINGLE_REG] = fn_write_reg,
+	[MBFC_WRITE_MULTIPLE_REGS] = fn_write_regs,
+#endif
+#if MBCFG_INPUT_REGS
+	[MBFC_READ_INPUT_REGS] = fn_read_input_regs,
+#endif
+#if MBCFG_MASK_WRITE_REG
+	[MBFC_MASK_WRITE_REG] = fn_mask_write_reg,
+#endif
+#if MBCFG_READ_WRITE_REGS
+	[MBFC_READ_WRITE_REGS] = fn_read_write_regs,
+#endif
+#if MBCFG_SERIAL_DIAG
+	[MBFC_READ_EXCEPTION_STATUS] = fn_read_exception_status,
+	[MBFC_DIAGNOSTICS] = mbfn_diag,
+	[MBFC_COMM_EVENT_COUNTER] = fn_comm_event_counter,
+	[MBFC_COMM_EVENT_LOG] = fn_comm_event_log,
+#endif
+#if MBCFG_FILES
+	[MBFC_READ_FILE_RECORD] = fn_read_file,
+	[MBFC_WRITE_FILE_RECORD] = fn_write_file,
+#endif
+#if MBCFG_DEVID
+	[MBFC_ENCAP_IFACE_TRANSPORT] = fn_encap_iface,
+#endif
+#if MBCFG_FIFO
+	[MBFC_READ_FIFO_QUEUE] = fn_read_fifo,
+#endif
+}};
+
+/**
+ * @brief Check if a function code has a handler in the table or handle_fn_cb
+ */
+static int is_handled(const struct mbinst_s *inst, uint8_t fc)
+{
+	const struct mbpdu_fn_table_s *table;
+
+	if (inst->handle_fn_cb!=NULL) return 1;
+
+	table = (inst->fn_table!=NULL) ? inst->fn_table : &s_default_fn_table;
+	return (fc < MBPDU_N_FN) && (table->fn[fc]!=NULL);
+}
+
+/**
+ * @brief Check if a function code only reads, and so has no effect without its response
+ */
+static int is_read_only(uint8_t fc)
+{
+	switch (fc) {
 	case MBFC_READ_COILS:
-		if (inst->coils!=NULL) {
-			return mbfn_read_coils(inst, inst->coils, inst->n_coils, req, req_len, res);
-		}
-		break;
 	case MBFC_READ_DISC_INPUTS:
-		if (inst->disc_inputs!=NULL) {
-			return mbfn_read_coils(inst, inst->disc_inputs, inst->n_disc_inputs, req, req_len, res);
-		}
-		break;
 	case MBFC_READ_HOLDING_REGS:
-		if (inst->hold_regs!=NULL) {
-			return mbfn_read_regs(inst, inst->hold_regs, inst->n_hold_regs, req, req_len, res);
-		}
-		break;
 	case MBFC_READ_INPUT_REGS:
-		if (inst->input_regs!=NULL) {
-			return mbfn_read_regs(inst, inst->input_regs, inst->n_input_regs, req, req_len, res);
-		}
-		break;
-	case MBFC_WRITE_SINGLE_COIL:
-		if (inst->coils!=NULL) {
-			return mbfn_write_coil(inst, inst->coils, inst->n_coils, req, req_len, res);
-		}
-		break;
-	case MBFC_WRITE_SINGLE_REG:
-		if (inst->hold_regs!=NULL) {
-			return mbfn_write_reg(inst, inst->hold_regs, inst->n_hold_regs, req, req_len, res);
-		}
-		break;
 	case MBFC_READ_EXCEPTION_STATUS:
-		if (inst->serial.read_exception_status_cb!=NULL) {
-			return mbfn_read_exception_status(inst, req, req_len, res);
-		}
-		break;
-	case MBFC_DIAGNOSTICS: return mbfn_diag(inst, req, req_len, res);
-	case MBFC_COMM_EVENT_COUNTER: return mbfn_comm_event_counter(inst, req, req_len, res);
-	case MBFC_COMM_EVENT_LOG: return mbfn_comm_event_log(inst, req, req_len, res);
-	case MBFC_WRITE_MULTIPLE_COILS:
-		if (inst->coils!=NULL) {
-			return mbfn_write_coils(inst, inst->coils, inst->n_coils, req, req_len, res);
-		}
-		break;
-	case MBFC_WRITE_MULTIPLE_REGS:
-		if (inst->hold_regs!=NULL) {
-			return mbfn_write_regs(inst, inst->hold_regs, inst->n_hold_regs, req, req_len, res);
-		}
-		break;
-	case MBFC_REPORT_SLAVE_ID: break; /* Should be implemented through mbinst_s::handle_fn_cb */
+	case MBFC_COMM_EVENT_COUNTER:
+	case MBFC_COMM_EVENT_LOG:
+	case MBFC_REPORT_SLAVE_ID:
 	case MBFC_READ_FILE_RECORD:
-		if (inst->files!=NULL) {
-			return mbfn_file_read(inst, req, req_len, res);
-		}
-		break;
-	case MBFC_WRITE_FILE_RECORD:
-		if (inst->files!=NULL) {
-			return mbfn_file_write(inst, req, req_len, res);
+	case MBFC_READ_FIFO_QUEUE:
+	case MBFC_ENCAP_IFACE_TRANSPORT: return 1;
+	default: return 0;
+	}
+}
+
+/**
+ * @brief Check if a read covers a descriptor with a read lock callback
+ *
+ * The cache is searched before dispatch, so a stored response would be
+ * served after the lock engaged. Such reads are never stored.
+ */
+static int reads_locked(const struct mbinst_s *inst, const uint8_t *req, size_t req_len)
+{
+	struct mbreg_cursor_s reg_cur;
+	struct mbcoil_cursor_s coil_cur;
+	const struct mbreg_desc_s *reg;
+	const struct mbcoil_desc_s *coil;
+	uint32_t addr, end;
+	size_t gap;
+	int is_hold_reg=0, is_coil=0;
+
+	if (req_len<5u) return 0;
+	addr = betou16(req+1u);
+	end = addr + betou16(req+3u);
+	if (end>0x10000u) end = 0x10000u;
+
+	switch (req[0]) {
+	case MBFC_READ_COILS: is_coil = 1; /* fallthrough */
+	case MBFC_READ_DISC_INPUTS:
+		mbcoil_cursor_init(&coil_cur,
+			is_coil ? inst->coils_ix : inst->disc_inputs_ix,
+			is_coil ? inst->coils : inst->disc_inputs,
+			is_coil ? inst->n_coils : inst->n_disc_inputs,
+			(uint16_t)addr);
+		while (addr<end) {
+			if ((coil=mbcoil_cursor_find(&coil_cur, (uint16_t)addr))==NULL) {
+				gap = mbcoil_cursor_gap(&coil_cur, (uint16_t)addr, end-addr);
+				addr += (gap!=0u) ? (uint32_t)gap : 1u;
+			} else if (coil->rlock_cb!=NULL) {
+				return 1;
+			} else {
+				++addr;
+			}
 		}
-		break;
-	case MBFC_MASK_WRITE_REG:
-		if (inst->hold_regs!=NULL) {
-			return mb_fn_mask_write_reg(inst, inst->hold_regs, inst->n_hold_regs, req, req_len, res);
+		return 0;
+	case MBFC_READ_HOLDING_REGS: is_hold_reg = 1; /* fallthrough */
+	case MBFC_READ_INPUT_REGS:
+		mbreg_cursor_init(&reg_cur,
+			is_hold_reg ? inst->hold_regs_ix : inst->input_regs_ix,
+			is_hold_reg ? inst->hold_regs : inst->input_regs,
+			is_hold_reg ? inst->n_hold_regs : inst->n_input_regs,
+			(uint16_t)addr);
+		for (; addr<end; ++addr) {
+			reg = mbreg_cursor_find(&reg_cur, (uint16_t)addr);
+			if ((reg!=NULL) && (MBREG_CB(reg, rlock_cb)!=NULL)) return 1;
 		}
-		break;
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief Store a response in the cache, unless a read lock decides it
+ */
+static void cache_store(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	const uint8_t *res,
+	size_t res_len,
+	enum mbstatus_e status)
+{
+	if ((inst->cache==NULL) || ((status==MB_OK) && reads_locked(inst, req, req_len))) return;
+	mbcache_store(inst->cache, req, req_len, res, res_len, status);
+}
+
+/**
+ * @brief Largest number of descriptor operations per request, by function code
+ *
+ * The quantity limits checked by the built-in handlers, see mbpdu_work_max()
+ */
+enum {
+	WORK_COILS_READ_MAX=2000u, /* 0x01, 0x02 */
+	WORK_COILS_WRITE_MAX=1968u, /* 0x0F */
+	WORK_REGS_READ_MAX=125u, /* 0x03, 0x04, read part of 0x17 */
+	WORK_REGS_WRITE_MAX=123u, /* 0x10 */
+	WORK_REGS_RW_WRITE_MAX=121u, /* Write part of 0x17 */
+	WORK_FILE_REGS_MAX=121u, /* 0x14 and 0x15, registers of all sub requests */
+	WORK_FIFO_MAX=31u, /* 0x18, MBFIFO_READ_MAX */
+	FILE_SUB_REQ_HEADER_SIZE=7u,
+};
+
+/**
+ * @brief Quantity field at pos, 0 if the request is too short or it is above max
+ *
+ * A quantity above the limit is rejected by the handler without descriptor
+ * work, it is not refused as busy.
+ */
+static uint32_t quantity(const uint8_t *req, size_t req_len, size_t pos, uint32_t max)
+{
+	uint32_t n;
+
+	if (req_len < pos+2u) return 0u;
+	n = betou16(req+pos);
+	return (n<=max) ? n : 0u;
+}
+
+/**
+ * @brief Sum of the record lengths of a file record request, 0 if it is above the limit
+ *
+ * @param with_data Nonzero if the record data follows each sub request (0x15)
+ */
+static uint32_t file_regs(const uint8_t *req, size_t req_len, int with_data)
+{
+	size_t pos = 2u;
+	uint32_t n = 0u, rec_len;
+
+	while ((pos+FILE_SUB_REQ_HEADER_SIZE) <= req_len) {
+		rec_len = betou16(req+pos+5u);
+		n += rec_len;
+		if (n>WORK_FILE_REGS_MAX) return 0u; /* Does not fit a response, rejected */
+		pos += FILE_SUB_REQ_HEADER_SIZE + (with_data ? (2u*rec_len) : 0u);
+	}
+
+	return n;
+}
+
+extern uint32_t mbpdu_req_work(const uint8_t *req, size_t req_len)
+{
+	uint32_t n_read, n_write;
+
+	if ((req==NULL) || (req_len<MBPDU_SIZE_MIN)) return 0u;
+
+	switch (req[0]) {
+	case MBFC_READ_COILS:
+	case MBFC_READ_DISC_INPUTS: return quantity(req, req_len, 3u, WORK_COILS_READ_MAX);
+	case MBFC_READ_HOLDING_REGS:
+	case MBFC_READ_INPUT_REGS: return quantity(req, req_len, 3u, WORK_REGS_READ_MAX);
+	case MBFC_WRITE_MULTIPLE_COILS: return quantity(req, req_len, 3u, WORK_COILS_WRITE_MAX);
+	case MBFC_WRITE_MULTIPLE_REGS: return quantity(req, req_len, 3u, WORK_REGS_WRITE_MAX);
 	case MBFC_READ_WRITE_REGS:
-		if (inst->hold_regs!=NULL) {
-			return mbfn_read_write_regs(inst, inst->hold_regs, inst->n_hold_regs, req, req_len, res);
+		n_read = quantity(req, req_len, 3u, WORK_REGS_READ_MAX);
+		n_write = quantity(req, req_len, 7u, WORK_REGS_RW_WRITE_MAX);
+		return ((n_read==0u) || (n_write==0u)) ? 0u : (n_read + n_write);
+	case MBFC_READ_FILE_RECORD: return file_regs(req, req_len, 0);
+	case MBFC_WRITE_FILE_RECORD: return file_regs(req, req_len, 1);
+	default: return mbpdu_work_max(req[0]);
+	}
+}
+
+extern uint32_t mbpdu_work_max(uint8_t fc)
+{
+	switch (fc) {
+	case MBFC_READ_COILS:
+	case MBFC_READ_DISC_INPUTS: return WORK_COILS_READ_MAX;
+	case MBFC_READ_HOLDING_REGS:
+	case MBFC_READ_INPUT_REGS: return WORK_REGS_READ_MAX;
+	case MBFC_WRITE_SINGLE_COIL:
+	case MBFC_WRITE_SINGLE_REG:
+	case MBFC_MASK_WRITE_REG: return 1u;
+	case MBFC_WRITE_MULTIPLE_COILS: return WORK_COILS_WRITE_MAX;
+	case MBFC_WRITE_MULTIPLE_REGS: return WORK_REGS_WRITE_MAX;
+	case MBFC_READ_FILE_RECORD:
+	case MBFC_WRITE_FILE_RECORD: return WORK_FILE_REGS_MAX;
+	case MBFC_READ_WRITE_REGS: return WORK_REGS_READ_MAX + WORK_REGS_RW_WRITE_MAX;
+	case MBFC_READ_FIFO_QUEUE: return WORK_FIFO_MAX;
+	default: return 0u; /* No descriptors, or an application handler */
+	}
+}
+
+/**
+ * @brief Dispatch a request through the function code table of the instance
+ */
+static enum mbstatus_e handle(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbpdu_buf_s *res)
+{
+	const struct mbpdu_fn_table_s *table;
+
+	table = (inst->fn_table!=NULL) ? inst->fn_table : &s_default_fn_table;
+	if ((req[0] < MBPDU_N_FN) && (table->fn[req[0]]!=NULL)) {
+		return table->fn[req[0]](inst, req, req_len, res);
+	}
+
+	return fallback(inst, req, req_len, res);
+}
+
+/**
+ * @brief Turn a failed status into an exception response and update diagnostics
+ *
+ * @return Size of response data in bytes, or 0 if no response should be sent
+ */
+static size_t finish(
+	struct mbinst_s *inst,
+	uint8_t fc,
+	enum mbstatus_e status,
+	int was_listen_only,
+	struct mbpdu_buf_s *res)
+{
+	uint8_t send_event = MB_COMM_EVENT_IS_SEND;
+
+	if (status!=MB_OK) {
+		/* Prepare exception response */
+		res->p[0] |= MB_ERR_FLG;
+		res->p[1] = (uint8_t)status;
+		res->size = 2u;
+
+		/* Set send communication event flags */
+		if ((status==MB_ILLEGAL_FN)
+				|| (status==MB_ILLEGAL_DATA_ADDR)
+				|| (status==MB_ILLEGAL_DATA_VAL)) {
+			send_event |= MB_COMM_EVENT_SEND_READ_EX;
 		}
-		break;
-	case MBFC_READ_FIFO_QUEUE: break; /* Not implemented */
-	default: break;
+		if (status==MB_DEV_FAIL) {send_event |= MB_COMM_EVENT_SEND_ABORT_EX;}
+		if ((status==MB_ACK) || (status==MB_BUSY)) {send_event |= MB_COMM_EVENT_SEND_BUSY_EX;}
+		if (status==MB_NEG_ACK) {send_event |= MB_COMM_EVENT_SEND_NAK_EX;}
 	}
 
-	if (inst->handle_fn_cb!=NULL) {
-		return inst->handle_fn_cb(inst, req, req_len, res);
-	} else {
-		return MB_ILLEGAL_FN;
+	/* Listen only mode changes "takes effect" after the response is sent,
+	   therefore we report the state as before handling the request. */
+	if (was_listen_only != 0) {send_event |= MB_COMM_EVENT_SEND_LISTEN_ONLY;}
+	mb_add_comm_event(inst, send_event);
+
+	/* Increment diagnostic counters */
+	if ((status==MB_OK)
+			&& (fc!=MBFC_DIAGNOSTICS)
+			&& (fc!=MBFC_COMM_EVENT_COUNTER)
+			&& (fc!=MBFC_COMM_EVENT_LOG)) {
+		mbatomic_inc(&inst->state.comm_event_counter);
 	}
+	if (status!=MB_OK) {
+		mbatomic_inc(&inst->state.exception_counter);
+		if (inst->stats!=NULL) {++inst->stats->exception_count;}
+	}
+	if (status==MB_NEG_ACK) {mbatomic_inc(&inst->state.nak_counter);}
+	if (status==MB_BUSY) {mbatomic_inc(&inst->state.busy_counter);}
+
+	/* If the device is in listen only mode, or was prior to this request;
+	   we don't want to send a response. */
+	return (mbatomic_load(&inst->state.is_listen_only) || was_listen_only)
+		? 0u
+		: res->size;
 }
 
-extern size_t mbpdu_handle_req(
+/**
+ * @brief Keep the context of a request whose handler returned MB_PENDING
+ */
+static void defer(
 	struct mbinst_s *inst,
 	const uint8_t *req,
 	size_t req_len,
-	uint8_t *res)
+	int was_listen_only)
 {
+	struct mbpending_s *pending = &inst->state.pending;
+	size_t echo_len;
+
+	/* Responses of the write function codes echo the start of the request */
+	switch (req[0]) {
+	case MBFC_WRITE_SINGLE_COIL:
+	case MBFC_WRITE_SINGLE_REG:
+	case MBFC_WRITE_MULTIPLE_COILS:
+	case MBFC_WRITE_MULTIPLE_REGS: echo_len = 5u; break;
+	case MBFC_MASK_WRITE_REG: echo_len = 7u; break;
+	default: echo_len = 1u; break;
+	}
+	if (echo_len > req_len) echo_len = req_len;
+
+	(void)memcpy(pending->echo, req, echo_len);
+	pending->echo_len = (uint8_t)echo_len;
+	pending->was_listen_only = (uint8_t)(was_listen_only != 0);
+	pending->is_active = 1u;
+}
+
+/**
+ * @brief Handle a request, see mbpdu_handle_req() and mbpdu_handle_broadcast()
+ *
+ * @param no_res Nonzero if no response will be sent, read only requests are
+ *        then dropped before dispatch and the cache is not searched
+ */
+static size_t handle_req(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *res,
+	int no_res)
+{
+	size_t res_size;
 	int was_listen_only;
 	uint8_t send_event;
 	enum mbstatus_e status;
 	struct mbpdu_buf_s res_pdu;
+	uint64_t t_start, t_trace;
 
 	if ((inst==NULL) || (req==NULL) || (res==NULL)) return 0u;
 	if (req_len<MBPDU_SIZE_MIN || req_len>MBPDU_SIZE_MAX) return 0u;
@@ -148,7 +573,7 @@ extern size_t mbpdu_handle_req(
 
 	/* If we are in listen mode we don't handle any requests,
 	   other than reset communication. */
-	if (inst->state.is_listen_only
+	if (mbatomic_load(&inst->state.is_listen_only)
 			&& ((req_len<3u)
 				|| (req[0]!=MBFC_DIAGNOSTICS)
 				|| (betou16(req+1u)!=MBFC_DIAG_RESTART_COMMS_OPT))) {
@@ -159,9 +584,12 @@ extern size_t mbpdu_handle_req(
 
 	/* Increment count of messages addressed to this device.
 	   Should not get incremented when in listen only mode. */
-	++inst->state.msg_counter;
+	mbatomic_inc(&inst->state.msg_counter);
+
+	was_listen_only = mbatomic_load(&inst->state.is_listen_only);
 
-	was_listen_only = inst->state.is_listen_only;
+	/* A read without its response has no effect, drop it before any work */
+	if (no_res && is_read_only(req[0])) return 0u;
 
 	/* Copy function code from request to response */
 	res[0] = req[0];
@@ -169,44 +597,95 @@ extern size_t mbpdu_handle_req(
 	res_pdu.p = res;
 	res_pdu.size = 1u;
 
-	status = handle(inst, req, req_len, &res_pdu);
+	/* Only one request can be pending at a time, requests over the rate are shed */
+	t_start = mbstats_now(inst->stats);
+	t_trace = mbtrace_now(inst->trace);
+	if (inst->state.pending.is_active || !mbrate_take(inst->rate)) {
+		status = MB_BUSY;
+	} else if (!is_handled(inst, req[0])) {
+		/* Unsupported function code, skip the cache, arena and dispatch */
+		status = MB_ILLEGAL_FN;
+	} else if (!no_res && ((res_pdu.size=mbcache_lookup(inst->cache, req, req_len, res))!=0u)) {
+		status = MB_OK;
+	} else if ((inst->work_budget!=0u) && (mbpdu_req_work(req, req_len) > inst->work_budget)) {
+		/* Refused whole before any descriptor work, writes are never left partial */
+		res_pdu.size = 1u;
+		status = MB_BUSY;
+	} else {
+		res_pdu.size = 1u;
+		mbarena_reset(inst->arena);
+		if (mbcache_is_write(req[0])) {mbreg_fn_cache_invalidate(inst->fn_cache);} /* Reads after the write see new values */
+		status = handle(inst, req, req_len, &res_pdu);
+		cache_store(inst, req, req_len, res, res_pdu.size, status);
+	}
+	mbstats_count_req(inst->stats, req[0], t_start);
+	mbtrace_emit(inst->trace, MBTRACE_EV_REQ, req[0], (req_len>=3u) ? betou16(req+1u) : 0u, t_trace);
+
+	if (status==MB_PENDING) {
+		defer(inst, req, req_len, was_listen_only);
+		return 0u;
+	}
 
-	if (status!=MB_OK) {
-		/* Prepare exception response */
-		res[0] |= MB_ERR_FLG;
-		res[1] = (uint8_t)status;
-		res_pdu.size = 2u;
+	res_size = finish(inst, req[0], status, was_listen_only, &res_pdu);
+	return no_res ? 0u : res_size;
+}
 
-		/* Set send communication event flags */
-		if ((status==MB_ILLEGAL_FN)
-				|| (status==MB_ILLEGAL_DATA_ADDR)
-				|| (status==MB_ILLEGAL_DATA_VAL)) {
-			send_event |= MB_COMM_EVENT_SEND_READ_EX;
+extern size_t mbpdu_handle_req(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *res)
+{
+	return handle_req(inst, req, req_len, res, 0);
+}
+
+extern void mbpdu_handle_broadcast(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *res)
+{
+	(void)handle_req(inst, req, req_len, res, 1);
+}
+
+extern size_t mbpdu_complete(
+	struct mbinst_s *inst,
+	enum mbstatus_e status,
+	const uint8_t *data,
+	size_t data_len,
+	uint8_t *res)
+{
+	struct mbpending_s *pending;
+	struct mbpdu_buf_s res_pdu;
+
+	if ((inst==NULL) || (res==NULL)) return 0u;
+
+	pending = &inst->state.pending;
+	if (!pending->is_active || (status==MB_PENDING)) return 0u;
+	if ((status==MB_OK) && (data!=NULL) && (data_len>MBPDU_DATA_SIZE_MAX)) return 0u;
+
+	res_pdu.p = res;
+	if ((status==MB_OK) && (data==NULL)) { /* Echo request fields */
+		(void)memcpy(res, pending->echo, pending->echo_len);
+		res_pdu.size = pending->echo_len;
+	} else {
+		res[0] = pending->echo[0];
+		if ((status==MB_OK) && (data_len>0u)) {
+			(void)memcpy(res+1u, data, data_len);
 		}
-		if (status==MB_DEV_FAIL) {send_event |= MB_COMM_EVENT_SEND_ABORT_EX;}
-		if ((status==MB_ACK) || (status==MB_BUSY)) {send_event |= MB_COMM_EVENT_SEND_BUSY_EX;}
-		if (status==MB_NEG_ACK) {send_event |= MB_COMM_EVENT_SEND_NAK_EX;}
+		res_pdu.size = 1u + data_len;
 	}
 
-	/* Listen only mode changes "takes effect" after the response is sent,
-	   therefore we report the state as before handling the request. */
-	if (was_listen_only != 0) {send_event |= MB_COMM_EVENT_SEND_LISTEN_ONLY;}
-	mb_add_comm_event(inst, send_event);
+	/* A deferred write is applied by the application before completing */
+	cache_store(inst, pending->echo, pending->echo_len, res, res_pdu.size, status);
+	pending->is_active = 0u;
 
-	/* Increment diagnostic counters */
-	if ((status==MB_OK)
-			&& (req[0]!=MBFC_DIAGNOSTICS)
-			&& (req[0]!=MBFC_COMM_EVENT_COUNTER)
-			&& (req[0]!=MBFC_COMM_EVENT_LOG)) {
-		++inst->state.comm_event_counter;
-	}
-	if (status!=MB_OK) {++inst->state.exception_counter;}
-	if (status==MB_NEG_ACK) {++inst->state.nak_counter;}
-	if (status==MB_BUSY) {++inst->state.busy_counter;}
+	return finish(inst, pending->echo[0], status, pending->was_listen_only, &res_pdu);
+}
 
-	/* If the device is in listen only mode, or was prior to this request;
-	   we don't want to send a response. */
-	return (inst->state.is_listen_only || was_listen_only)
-		? 0u
-		: res_pdu.size;
+extern void mbpdu_fn_table_init(struct mbpdu_fn_table_s *table)
+{
+	if (table==NULL) return;
+
+	*table = s_default_fn_table;
 }
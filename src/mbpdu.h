@@ -39,6 +39,7 @@
 #ifndef MBPDU_H_INCLUDED
 #define MBPDU_H_INCLUDED
 
+#include "mbdef.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -76,6 +77,26 @@ struct mbpdu_buf_s {
 
 struct mbinst_s; /* Forward declaration, see "mbinst.h" */
 
+/** @brief Number of entries in a function code table, function codes 0 to 127 */
+enum {MBPDU_N_FN=128u};
+
+/**
+ * @brief Function code dispatch table
+ *
+ * Maps each function code to its handler, see mbinst_s::fn_table. Handlers
+ * get the complete request PDU and populate the response PDU like
+ * mbinst_s::handle_fn_cb, they may also return MB_PENDING.
+ *
+ * @note NULL entries are passed on to mbinst_s::handle_fn_cb
+ */
+struct mbpdu_fn_table_s {
+	enum mbstatus_e (*fn[MBPDU_N_FN])(
+		struct mbinst_s *inst,
+		const uint8_t *req,
+		size_t req_len,
+		struct mbpdu_buf_s *res);
+};
+
 /**
  * @brief Handle Modbus PDU request
  *
@@ -102,4 +123,103 @@ extern size_t mbpdu_handle_req(
 	size_t req_len,
 	uint8_t *res);
 
+/**
+ * @brief Handle a Modbus PDU request that gets no response
+ *
+ * Like mbpdu_handle_req() for requests sent to the broadcast address. Read
+ * only function codes (0x01-0x04, 0x07, 0x0B, 0x0C, 0x11, 0x14, 0x18 and
+ * 0x2B) are dropped before dispatch, as they have no effect without their
+ * response, and the response cache is not searched. Other requests are handled
+ * as usual with diagnostics updated, res is only used as scratch.
+ *
+ * @param inst Pointer to the Modbus instance containing coil/register maps and configuration
+ * @param req Pointer to the complete PDU data (function code + request data)
+ * @param req_len Length of the PDU data in bytes (expected >= 1)
+ * @param res Pointer to scratch for the response PDU (must be at least MBPDU_SIZE_MAX bytes)
+ *
+ * @note A handler may still defer the request (MB_PENDING), see mbpdu_complete()
+ */
+extern void mbpdu_handle_broadcast(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *res);
+
+/**
+ * @brief Complete a deferred request with its final response
+ *
+ * Produces the response of a request for which a handler returned MB_PENDING.
+ * On success with data==NULL the response echoes the request fields, which is
+ * the complete response of the write function codes (0x05, 0x06, 0x0F, 0x10
+ * and 0x16). Other function codes must pass the response data.
+ *
+ * @param inst Pointer to the Modbus instance with a pending request
+ * @param status Final status of the request (MB_OK or exception code)
+ * @param data Response data following the function code (NULL to echo the request)
+ * @param data_len Length of data in bytes
+ * @param res Pointer to response PDU data to populate (must be at least MBPDU_SIZE_MAX bytes)
+ *
+ * @return Size of response data in bytes, or 0 if no response should be sent
+ *
+ * @note Returns 0 and leaves the instance unchanged if no request is pending
+ * @note Diagnostic counters and communication events are updated on completion
+ */
+extern size_t mbpdu_complete(
+	struct mbinst_s *inst,
+	enum mbstatus_e status,
+	const uint8_t *data,
+	size_t data_len,
+	uint8_t *res);
+
+/**
+ * @brief Fill a function code table with the built-in handlers
+ *
+ * Start of a custom table. Entries can then be replaced with application
+ * handlers, e.g. to override a built-in function code for one instance or to
+ * add vendor function codes.
+ *
+ * @param table Table to fill
+ *
+ * @note Built-in entries of function codes disabled in mbconfig.h are NULL
+ * @note Built-in handlers pass the request on to mbinst_s::handle_fn_cb when the instance has no map for it
+ */
+extern void mbpdu_fn_table_init(struct mbpdu_fn_table_s *table);
+
+/**
+ * @brief Number of descriptor operations a request asks for
+ *
+ * The number of coils, registers or FIFO entries the request addresses (both
+ * quantities of 0x17, the record lengths of all file sub requests), an upper
+ * bound of the descriptors the built-in handler reads or writes. Quantities
+ * above the limit of the function code (see mbpdu_work_max()) count as 0, so
+ * the handler rejects them as illegal without descriptor work.
+ *
+ * @param req Pointer to the complete PDU data (function code + request data)
+ * @param req_len Length of the PDU data in bytes
+ *
+ * @return Descriptor operations, 0 for function codes without descriptors or
+ *         invalid quantities
+ *
+ * @note Used to check requests against mbinst_s::work_budget
+ * @note Time complexity: O(1), O(n) in the sub requests of 0x14 and 0x15
+ */
+extern uint32_t mbpdu_req_work(const uint8_t *req, size_t req_len);
+
+/**
+ * @brief Largest number of descriptor operations of any request of a function code
+ *
+ * Static loop bound of the built-in handler, e.g. 2000 for 0x01 and 0x02 or
+ * 125 for 0x03 and 0x04. Together with a constant time index of every map
+ * (see mbinst_prep_s::const_time) it bounds the work of handling a request.
+ *
+ * @param fc Function code
+ *
+ * @return Descriptor operations, 0 for function codes without descriptors
+ *         and for function codes handled by the application
+ *
+ * @note Application callbacks are called at most once per descriptor
+ *       operation, their own execution time is not included
+ */
+extern uint32_t mbpdu_work_max(uint8_t fc);
+
 #endif /* MBPDU_H_INCLUDED */
@@ -0,0 +1,161 @@
+/**
+ * @file mbplan.c
+ * @brief Modbus Read Plans - Resolved descriptors of repeated read requests
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbplan.h"
+#include "mbreg.h"
+#include <stddef.h>
+#include <stdint.h>
+
+extern void mbplan_init(struct mbplan_s *plan)
+{
+	size_t i;
+
+	if (plan==NULL) return;
+
+	if (plan->entries==NULL) plan->n_entries = 0u;
+	for (i=0u; i<plan->n_entries; ++i) {
+		plan->entries[i].regs = NULL;
+	}
+	plan->next = 0u;
+	plan->n_hits = 0u;
+	plan->n_misses = 0u;
+}
+
+extern struct mbplan_entry_s *mbplan_find(
+	struct mbplan_s *plan,
+	uint8_t fc,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t start,
+	uint16_t n)
+{
+	struct mbplan_entry_s *entry;
+	size_t i;
+
+	if ((plan==NULL) || (regs==NULL)) return NULL;
+
+	for (i=0u; i<plan->n_entries; ++i) {
+		entry = &plan->entries[i];
+		if ((entry->regs==regs)
+				&& (entry->start==start)
+				&& (entry->n==n)
+				&& (entry->fc==fc)
+				&& (entry->n_regs==n_regs)) {
+			++plan->n_hits;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+extern struct mbplan_entry_s *mbplan_record(
+	struct mbplan_s *plan,
+	uint8_t fc,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t start,
+	uint16_t n)
+{
+	struct mbplan_entry_s *entry;
+
+	if ((plan==NULL) || (regs==NULL) || (plan->n_entries==0u)) return NULL;
+
+	if (plan->next>=plan->n_entries) plan->next = 0u;
+	entry = &plan->entries[plan->next];
+	++plan->next;
+	++plan->n_misses;
+
+	entry->regs = NULL; /* Empty until done */
+	entry->n_regs = n_regs;
+	entry->fc = fc;
+	entry->start = start;
+	entry->n = n;
+	entry->n_steps = 0u;
+
+	return entry;
+}
+
+extern void mbplan_rewind(struct mbplan_entry_s *entry)
+{
+	if (entry==NULL) return;
+	entry->n_steps = 0u;
+}
+
+/**
+ * @brief Append a step, or mark the walk as too long to plan
+ */
+static void append(struct mbplan_entry_s *entry, uint16_t reg_ix, uint16_t n)
+{
+	if (entry->n_steps>=MBPLAN_N_STEPS) {
+		entry->n_steps = MBPLAN_N_STEPS+1u;
+		return;
+	}
+
+	entry->steps[entry->n_steps].reg_ix = reg_ix;
+	entry->steps[entry->n_steps].n = n;
+	++entry->n_steps;
+}
+
+extern void mbplan_step(struct mbplan_entry_s *entry, size_t reg_ix, size_t n)
+{
+	if ((entry==NULL) || (entry->n_steps>MBPLAN_N_STEPS)) return;
+
+	if ((reg_ix>=MBPLAN_HOLE) || (n>UINT16_MAX)) {
+		entry->n_steps = MBPLAN_N_STEPS+1u;
+		return;
+	}
+
+	append(entry, (uint16_t)reg_ix, (uint16_t)n);
+}
+
+extern void mbplan_hole(struct mbplan_entry_s *entry)
+{
+	struct mbplan_step_s *last;
+
+	if ((entry==NULL) || (entry->n_steps>MBPLAN_N_STEPS)) return;
+
+	if (entry->n_steps>0u) {
+		last = &entry->steps[entry->n_steps-1u];
+		if ((last->reg_ix==MBPLAN_HOLE) && (last->n<UINT16_MAX)) {
+			++last->n;
+			return;
+		}
+	}
+
+	append(entry, MBPLAN_HOLE, 1u);
+}
+
+extern void mbplan_done(struct mbplan_entry_s *entry, const struct mbreg_desc_s *regs, int ok)
+{
+	if (entry==NULL) return;
+
+	entry->regs = (ok && (entry->n_steps<=MBPLAN_N_STEPS)) ? regs : NULL;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file mbplan.h
+ * @brief Modbus Read Plans - Resolved descriptors of repeated read requests
+ * @author Jonas Almås
+ *
+ * @details Optional plans of register read requests (function codes 0x03 and
+ * 0x04, and the read of 0x17) keyed by function code, start address and
+ * quantity. The first request walks the map as usual and records which
+ * descriptor serves each part of the range, a repeated request then reads the
+ * recorded descriptors without searching the map. Unlike mbcache_s the data
+ * is still read on every request, locks and callbacks included.
+ */
+
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+#ifndef MBPLAN_H_INCLUDED
+#define MBPLAN_H_INCLUDED
+
+#include "mbreg.h"
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+	MBPLAN_N_STEPS = 32u, /**< Descriptors per plan, longer walks are not planned */
+	MBPLAN_HOLE = 0xFFFFu, /**< Step of unmapped addresses, read as zero */
+};
+
+/**
+ * @brief One descriptor (or run of bulk descriptors) of a plan
+ *
+ * @note Shall not be accessed by client code directly
+ */
+struct mbplan_step_s {
+	uint16_t reg_ix; /**< Index of the descriptor in the map, MBPLAN_HOLE for unmapped addresses */
+	uint16_t n; /**< Number of registers read from it */
+};
+
+/**
+ * @brief Plan of one request shape
+ *
+ * @note Shall not be accessed by client code directly
+ */
+struct mbplan_entry_s {
+	const struct mbreg_desc_s *regs; /**< Map the plan was recorded in, NULL if the entry is empty */
+	size_t n_regs; /**< Number of descriptors in regs */
+	uint8_t fc; /**< Function code of the request */
+	uint8_t n_steps; /**< Recorded steps, above MBPLAN_N_STEPS when the walk did not fit */
+	uint16_t start; /**< Start address of the request */
+	uint16_t n; /**< Quantity of the request */
+	struct mbplan_step_s steps[MBPLAN_N_STEPS];
+};
+
+/**
+ * @brief Read plans of one instance
+ *
+ * Attached to an instance through mbinst_s::plan. A full table replaces its
+ * entries in round robin order. Masters polling a fixed cycle of requests
+ * need one entry per request of the cycle, give each master (or connection)
+ * a worker instance with a table of its own.
+ *
+ * @note n_entries is set by the application, the remaining fields are state
+ *       cleared by mbplan_init()
+ * @note Plans only depend on the map, they stay valid when data changes.
+ *       mbswap_enter() empties the table when it applies another set, call
+ *       mbplan_init() after changing the descriptors of a map in place
+ */
+struct mbplan_s {
+	struct mbplan_entry_s *entries; /**< Caller supplied storage */
+	size_t n_entries; /**< Number of entries */
+
+	size_t next; /**< Entry replaced by the next recording */
+	uint32_t n_hits; /**< Requests read through a plan */
+	uint32_t n_misses; /**< Requests recorded, as no plan matched */
+};
+
+/**
+ * @brief Empty the table, the storage is kept
+ *
+ * @param plan Table to initialize (entries and n_entries set)
+ */
+extern void mbplan_init(struct mbplan_s *plan);
+
+/**
+ * @brief Find the plan of a request
+ *
+ * @param plan Table (Can be NULL)
+ * @param fc Function code
+ * @param regs Map the request is read from
+ * @param n_regs Number of descriptors in regs
+ * @param start Start address
+ * @param n Quantity
+ *
+ * @return Plan, or NULL if none matches
+ *
+ * @note Called by the library while handling requests
+ */
+extern struct mbplan_entry_s *mbplan_find(
+	struct mbplan_s *plan,
+	uint8_t fc,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t start,
+	uint16_t n);
+
+/**
+ * @brief Claim an entry to record the plan of a request
+ *
+ * The entry stays empty until mbplan_done() completes it.
+ *
+ * @return Entry to record into, or NULL if the table has no entries
+ *
+ * @note Called by the library while handling requests
+ */
+extern struct mbplan_entry_s *mbplan_record(
+	struct mbplan_s *plan,
+	uint8_t fc,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t start,
+	uint16_t n);
+
+/**
+ * @brief Restart a recording, e.g. when a snapshot read is retried
+ *
+ * @param entry Entry being recorded (Can be NULL)
+ */
+extern void mbplan_rewind(struct mbplan_entry_s *entry);
+
+/**
+ * @brief Record the next descriptor of the walk
+ *
+ * @param entry Entry being recorded (Can be NULL)
+ * @param reg_ix Index of the descriptor in the map
+ * @param n Number of registers read from it
+ */
+extern void mbplan_step(struct mbplan_entry_s *entry, size_t reg_ix, size_t n);
+
+/**
+ * @brief Record the next address of the walk as unmapped
+ *
+ * Consecutive unmapped addresses are merged into one step.
+ *
+ * @param entry Entry being recorded (Can be NULL)
+ */
+extern void mbplan_hole(struct mbplan_entry_s *entry);
+
+/**
+ * @brief Complete a recording, or drop a plan found stale
+ *
+ * @param entry Entry (Can be NULL)
+ * @param regs Map the plan was recorded in
+ * @param ok Non-zero to keep the plan, zero to leave the entry empty
+ */
+extern void mbplan_done(struct mbplan_entry_s *entry, const struct mbreg_desc_s *regs, int ok);
+
+#endif /* MBPLAN_H_INCLUDED */
@@ -0,0 +1,70 @@
+/**
+ * @file mbrate.c
+ * @brief Modbus Rate Limiter - Token bucket for overload shedding
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbrate.h"
+#include <stddef.h>
+#include <stdint.h>
+
+extern void mbrate_init(struct mbrate_s *rate)
+{
+	if (rate==NULL) return;
+
+	rate->tokens = rate->burst;
+	rate->last = (rate->clock_cb!=NULL) ? rate->clock_cb() : 0u;
+	rate->n_limited = 0u;
+}
+
+extern int mbrate_take(struct mbrate_s *rate)
+{
+	uint64_t t, n;
+
+	if ((rate==NULL) || (rate->clock_cb==NULL) || (rate->ticks_per_token==0u)) return 1;
+
+	t = rate->clock_cb();
+	if (rate->tokens < rate->burst) {
+		n = (t - rate->last) / rate->ticks_per_token;
+		if (n > 0u) {
+			rate->tokens = (n >= (uint64_t)(rate->burst - rate->tokens))
+				? rate->burst
+				: rate->tokens + (uint32_t)n;
+			rate->last += n * rate->ticks_per_token;
+		}
+	} else {
+		/* A full bucket starts refilling from now */
+		rate->last = t;
+	}
+
+	if (rate->tokens==0u) {
+		++rate->n_limited;
+		return 0;
+	}
+	--rate->tokens;
+	return 1;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file mbrate.h
+ * @brief Modbus Rate Limiter - Token bucket for overload shedding
+ * @author Jonas Almås
+ *
+ * @details Token bucket limiting the request rate of a connection
+ * (mbadu_stream_s::rate) or of a slave instance (mbinst_s::rate). Requests above
+ * the rate are answered with an MB_BUSY exception before any descriptor is
+ * looked at, so a master polling far too fast costs little more than the framing
+ * of its requests.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBRATE_H_INCLUDED
+#define MBRATE_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Token bucket of one connection or instance
+ *
+ * A request takes one token, tokens are added every ticks_per_token up to
+ * burst. With a microsecond clock, ticks_per_token=1000 and burst=20 allow
+ * 1000 requests per second with bursts of 20.
+ *
+ * @note Configuration fields are set by the application, the remaining
+ *       fields are state set by mbrate_init()
+ * @note Not thread safe, give each connection or worker instance its own bucket
+ */
+struct mbrate_s {
+	/**
+	 * @brief Monotonic clock
+	 *
+	 * @note Can be left as NULL, requests are then never limited
+	 */
+	uint64_t (*clock_cb)(void);
+
+	uint64_t ticks_per_token; /**< Clock ticks per added token, 0 to disable limiting */
+	uint32_t burst; /**< Bucket size, requests allowed back to back */
+
+	uint32_t tokens; /**< Tokens left */
+	uint64_t last; /**< Time tokens were last added, in clock_cb units */
+	uint32_t n_limited; /**< Requests refused */
+};
+
+/**
+ * @brief Fill the bucket
+ *
+ * @param rate Bucket with configuration fields set
+ */
+extern void mbrate_init(struct mbrate_s *rate);
+
+/**
+ * @brief Take a token for a request
+ *
+ * @param rate Bucket (Can be NULL)
+ *
+ * @retval 1 Request allowed
+ * @retval 0 Over the rate, answer with MB_BUSY
+ *
+ * @note Called by the library while handling requests
+ */
+extern int mbrate_take(struct mbrate_s *rate);
+
+#endif /* MBRATE_H_INCLUDED */
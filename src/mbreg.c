@@ -38,6 +38,7 @@
 
 #include "mbreg.h"
 #include "endian.h"
+#include "mbpage.h"
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
@@ -49,47 +50,114 @@ static size_t min(size_t a, size_t b)
 	return (a < b) ? a : b;
 }
 
-/**
- * @brief Swaps the word order of a 32-bit value in-place
- * @param data Pointer to 4 bytes representing the value to swap
+/*
+ * Encoding and decoding of register values in the byte order of a register.
+ * Byte i of the big-endian (ABCD) encoding is stored at position i^mask, see
+ * order_mask(), so every order is encoded directly without a second pass.
  */
-static void swap_words_u32(uint8_t *data)
+static void put16(uint16_t v, uint8_t *dst, size_t mask)
+{
+	dst[0u^mask] = (uint8_t)(v >> 8);
+	dst[1u^mask] = (uint8_t)v;
+}
+
+static void put32(uint32_t v, uint8_t *dst, size_t mask)
+{
+	dst[0u^mask] = (uint8_t)(v >> 24);
+	dst[1u^mask] = (uint8_t)(v >> 16);
+	dst[2u^mask] = (uint8_t)(v >> 8);
+	dst[3u^mask] = (uint8_t)v;
+}
+
+static void put64(uint64_t v, uint8_t *dst, size_t mask)
 {
-	uint8_t tmp;
+	size_t i;
+
+	for (i=0u; i<8u; ++i) {
+		dst[i^mask] = (uint8_t)(v >> (56u - (8u*i)));
+	}
+}
 
-	tmp = data[0];
-	data[0] = data[2];
-	data[2] = tmp;
+static void puti16(int16_t v, uint8_t *dst, size_t mask) {put16((uint16_t)v, dst, mask);}
+static void puti32(int32_t v, uint8_t *dst, size_t mask) {put32((uint32_t)v, dst, mask);}
+static void puti64(int64_t v, uint8_t *dst, size_t mask) {put64((uint64_t)v, dst, mask);}
 
-	tmp = data[1];
-	data[1] = data[3];
-	data[3] = tmp;
+static void putf32(float v, uint8_t *dst, size_t mask)
+{
+	uint32_t u32;
+	(void)memcpy(&u32, &v, sizeof u32);
+	put32(u32, dst, mask);
 }
 
-/**
- * @brief Swaps the word order of a 64-bit value in-place
- *
- * @param data Pointer to 8 bytes representing the value to swap
- */
-static void swap_words_u64(uint8_t *data)
+static void putf64(double v, uint8_t *dst, size_t mask)
+{
+	uint64_t u64;
+	(void)memcpy(&u64, &v, sizeof u64);
+	put64(u64, dst, mask);
+}
+
+static uint16_t get16(const uint8_t *src, size_t mask)
+{
+	return (uint16_t)(((uint16_t)src[0u^mask] << 8) | src[1u^mask]);
+}
+
+static uint32_t get32(const uint8_t *src, size_t mask)
+{
+	return ((uint32_t)src[0u^mask] << 24)
+		| ((uint32_t)src[1u^mask] << 16)
+		| ((uint32_t)src[2u^mask] << 8)
+		| ((uint32_t)src[3u^mask]);
+}
+
+static uint64_t get64(const uint8_t *src, size_t mask)
+{
+	uint64_t v = 0u;
+	size_t i;
+
+	for (i=0u; i<8u; ++i) {
+		v = (v << 8) | src[i^mask];
+	}
+	return v;
+}
+
+static int16_t geti16(const uint8_t *src, size_t mask)
 {
-	uint8_t tmp;
+	uint16_t u16 = get16(src, mask);
+	int16_t v;
+	(void)memcpy(&v, &u16, sizeof v);
+	return v;
+}
 
-	tmp = data[0];
-	data[0] = data[6];
-	data[6] = tmp;
+static int32_t geti32(const uint8_t *src, size_t mask)
+{
+	uint32_t u32 = get32(src, mask);
+	int32_t v;
+	(void)memcpy(&v, &u32, sizeof v);
+	return v;
+}
 
-	tmp = data[1];
-	data[1] = data[7];
-	data[7] = tmp;
+static int64_t geti64(const uint8_t *src, size_t mask)
+{
+	uint64_t u64 = get64(src, mask);
+	int64_t v;
+	(void)memcpy(&v, &u64, sizeof v);
+	return v;
+}
 
-	tmp = data[2];
-	data[2] = data[4];
-	data[4] = tmp;
+static float getf32(const uint8_t *src, size_t mask)
+{
+	uint32_t u32 = get32(src, mask);
+	float v;
+	(void)memcpy(&v, &u32, sizeof v);
+	return v;
+}
 
-	tmp = data[3];
-	data[3] = data[5];
-	data[5] = tmp;
+static double getf64(const uint8_t *src, size_t mask)
+{
+	uint64_t u64 = get64(src, mask);
+	double v;
+	(void)memcpy(&v, &u64, sizeof v);
+	return v;
 }
 
 extern size_t mbreg_size(const struct mbreg_desc_s *reg)
@@ -163,6 +231,296 @@ extern const struct mbreg_desc_s *mbreg_find_desc(
 	return NULL;
 }
 
+/**
+ * @brief Get the address following the last address of a register (exclusive end)
+ */
+static size_t reg_end(const struct mbreg_desc_s *reg)
+{
+	size_t reg_size_w = mbreg_size(reg) / 2u;
+
+	if ((reg->type & MRTYPE_BLOCK) != 0) {
+		return (size_t)reg->address + reg->n_block_entries*reg_size_w;
+	}
+	return (size_t)reg->address + reg_size_w;
+}
+
+extern size_t mbreg_index_span(
+	const struct mbreg_desc_s *regs,
+	size_t n_regs)
+{
+	size_t end, i;
+
+	if (!regs || (n_regs==0u)) return 0u;
+
+	/* Blocks may end past later descriptors in invalid maps, so use the maximum */
+	end = 0u;
+	for (i=0u; i<n_regs; ++i) {
+		if (reg_end(regs+i) > end) {
+			end = reg_end(regs+i);
+		}
+	}
+
+	return (end > regs[0].address) ? (end - regs[0].address) : 0u;
+}
+
+/**
+ * @brief Reset an index to empty, lookups fall back to mbreg_find_desc()
+ */
+static void index_clear(struct mbreg_index_s *ix)
+{
+	ix->regs = NULL;
+	ix->n_regs = 0u;
+	ix->base = 0u;
+	ix->n_slots = 0u;
+	ix->slots = NULL;
+	ix->starts = NULL;
+	ix->lasts = NULL;
+	ix->pages.dir = NULL;
+	ix->pages.leaves = NULL;
+}
+
+extern int mbreg_index_build(
+	struct mbreg_index_s *ix,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t *storage,
+	size_t storage_len)
+{
+	size_t n_slots, i, slot, end;
+
+	if (ix==NULL) return 0;
+
+	index_clear(ix);
+
+	if (!regs || (n_regs==0u) || (storage==NULL)) return 0;
+	if (n_regs >= 0xFFFFu) return 0; /* Positions are stored as u16 */
+
+	n_slots = mbreg_index_span(regs, n_regs);
+	if ((n_slots==0u) || (n_slots > storage_len)) return 0;
+
+	for (slot=0u; slot<n_slots; ++slot) {
+		storage[slot] = 0u;
+	}
+
+	for (i=0u; i<n_regs; ++i) {
+		if ((i > 0u) && (regs[i].address < reg_end(regs+i-1u))) {
+			return 0; /* Unsorted or overlapping map */
+		}
+		if (mbreg_size(regs+i) == 0u) { /* Invalid type, matched on exact address only */
+			slot = regs[i].address - regs[0].address;
+			if (slot < n_slots) {
+				storage[slot] = (uint16_t)(i + 1u);
+			}
+			continue;
+		}
+
+		end = reg_end(regs+i);
+		for (slot=regs[i].address-regs[0].address; slot<(end-regs[0].address); ++slot) {
+			storage[slot] = (uint16_t)(i + 1u);
+		}
+	}
+
+	ix->regs = regs;
+	ix->n_regs = n_regs;
+	ix->base = regs[0].address;
+	ix->n_slots = n_slots;
+	ix->slots = storage;
+
+	return 1;
+}
+
+extern int mbreg_index_build_ranges(
+	struct mbreg_index_s *ix,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t *storage,
+	size_t storage_len)
+{
+	uint16_t *starts, *lasts;
+	size_t i, end;
+
+	if (ix==NULL) return 0;
+
+	index_clear(ix);
+
+	if (!regs || (n_regs==0u) || (storage==NULL)) return 0;
+	if (storage_len < MBREG_RANGE_INDEX_SIZE(n_regs)) return 0;
+
+	starts = storage;
+	lasts = storage + n_regs;
+	for (i=0u; i<n_regs; ++i) {
+		if ((i > 0u) && (regs[i].address < reg_end(regs+i-1u))) {
+			return 0; /* Unsorted or overlapping map */
+		}
+
+		/* Invalid types are matched on exact address only */
+		end = (mbreg_size(regs+i) == 0u) ? (regs[i].address + 1u) : reg_end(regs+i);
+		if ((end <= regs[i].address) || (end > 0x10000u)) return 0;
+
+		starts[i] = regs[i].address;
+		lasts[i] = (uint16_t)(end - 1u);
+	}
+
+	ix->regs = regs;
+	ix->n_regs = n_regs;
+	ix->base = regs[0].address;
+	ix->starts = starts;
+	ix->lasts = lasts;
+
+	return 1;
+}
+
+/**
+ * @brief Addresses covered by a descriptor of a register map, see mbpage_build()
+ */
+static size_t reg_span(const void *map, size_t i, uint16_t *first)
+{
+	const struct mbreg_desc_s *reg = (const struct mbreg_desc_s *)map + i;
+
+	*first = reg->address;
+	/* Invalid types are matched on exact address only */
+	return (mbreg_size(reg) == 0u) ? 1u : (reg_end(reg) - reg->address);
+}
+
+extern size_t mbreg_index_paged_size(
+	const struct mbreg_desc_s *regs,
+	size_t n_regs)
+{
+	return mbpage_size(regs, n_regs, reg_span);
+}
+
+extern int mbreg_index_build_paged(
+	struct mbreg_index_s *ix,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t *storage,
+	size_t storage_len)
+{
+	if (ix==NULL) return 0;
+
+	index_clear(ix);
+
+	if (!regs || (n_regs==0u)) return 0;
+	if (!mbpage_build(&ix->pages, regs, n_regs, reg_span, storage, storage_len)) return 0;
+
+	ix->regs = regs;
+	ix->n_regs = n_regs;
+	ix->base = regs[0].address;
+
+	return 1;
+}
+
+/**
+ * @brief Find descriptor in a range index
+ */
+static const struct mbreg_desc_s *find_range(const struct mbreg_index_s *ix, uint16_t addr)
+{
+	size_t l, m, r;
+
+	/* Find first descriptor starting after addr, only the start array is touched */
+	l = 0u;
+	r = ix->n_regs;
+	while (l < r) {
+		m = l + (r - l) / 2u;
+		if (ix->starts[m] <= addr) {
+			l = m + 1u;
+		} else {
+			r = m;
+		}
+	}
+
+	if ((l == 0u) || (ix->lasts[l-1u] < addr)) return NULL;
+
+	return ix->regs + (l - 1u);
+}
+
+extern const struct mbreg_desc_s *mbreg_index_find(
+	const struct mbreg_index_s *ix,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t addr)
+{
+	size_t slot;
+
+	if ((ix==NULL) || ((ix->slots==NULL) && (ix->starts==NULL) && (ix->pages.dir==NULL))
+			|| (ix->regs!=regs) || (ix->n_regs!=n_regs)) {
+		return mbreg_find_desc(regs, n_regs, addr);
+	}
+
+	if (ix->pages.dir!=NULL) {
+		slot = mbpage_find(&ix->pages, addr);
+		return (slot!=0u) ? (regs + (slot - 1u)) : NULL;
+	}
+	if (ix->slots==NULL) return find_range(ix, addr);
+
+	if (addr < ix->base) return NULL;
+
+	slot = (size_t)(addr - ix->base);
+	if ((slot >= ix->n_slots) || (ix->slots[slot]==0u)) return NULL;
+
+	return regs + (ix->slots[slot] - 1u);
+}
+
+extern void mbreg_cursor_init(
+	struct mbreg_cursor_s *cur,
+	const struct mbreg_index_s *ix,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t addr)
+{
+	const struct mbreg_desc_s *reg;
+	size_t l, m, r;
+
+	if (cur==NULL) return;
+
+	cur->regs = regs;
+	cur->n_regs = (regs!=NULL) ? n_regs : 0u;
+	cur->pos = 0u;
+
+	if (cur->n_regs==0u) return;
+
+	if ((reg = mbreg_index_find(ix, regs, n_regs, addr)) != NULL) {
+		cur->pos = (size_t)(reg - regs);
+		return;
+	}
+
+	/* Find first descriptor starting after addr */
+	l = 0u;
+	r = n_regs;
+	while (l < r) {
+		m = l + (r - l) / 2u;
+		if (regs[m].address <= addr) {
+			l = m + 1u;
+		} else {
+			r = m;
+		}
+	}
+
+	/* The previous descriptor may still contain addr */
+	cur->pos = ((l > 0u) && is_addr_desc_match(regs+l-1u, addr)) ? (l - 1u) : l;
+}
+
+extern const struct mbreg_desc_s *mbreg_cursor_find(
+	struct mbreg_cursor_s *cur,
+	uint16_t addr)
+{
+	const struct mbreg_desc_s *reg;
+
+	if (cur==NULL) return NULL;
+
+	/* Skip descriptors ending before addr */
+	while ((cur->pos < cur->n_regs)
+			&& (cur->regs[cur->pos].address < addr)
+			&& !is_addr_desc_match(cur->regs+cur->pos, addr)) {
+		++cur->pos;
+	}
+
+	if (cur->pos >= cur->n_regs) return NULL;
+
+	reg = cur->regs + cur->pos;
+	return is_addr_desc_match(reg, addr) ? reg : NULL;
+}
+
 /**
  * @brief Check if register is configured correctly for reading from pointer
  */
@@ -243,22 +601,82 @@ static int write_fn_ok(const struct mbreg_desc_s *reg)
 	}
 }
 
+/**
+ * @brief Check the type and access configuration of one descriptor
+ */
+static int desc_ok(const struct mbreg_desc_s *reg)
+{
+	const int is_block = (reg->type & MRTYPE_BLOCK) != 0;
+
+	switch (reg->type & MRTYPE_MASK) {
+	case MRTYPE_U8: case MRTYPE_U16: case MRTYPE_U32: case MRTYPE_U64:
+	case MRTYPE_I8: case MRTYPE_I16: case MRTYPE_I32: case MRTYPE_I64:
+	case MRTYPE_F32: case MRTYPE_F64:
+		break;
+	default: /* One and only one type */
+		return 0;
+	}
+	if ((reg->access==0) || (is_block && (reg->n_block_entries==0u))) return 0;
+
+	switch (reg->access & MRACC_R_MASK) {
+	case 0: if (reg->read.pu8!=NULL) return 0; break;
+	case MRACC_R_VAL: if (is_block) return 0; break;
+	case MRACC_R_PTR: if (!read_ptr_ok(reg)) return 0; break;
+	case MRACC_R_FN: if (is_block || !read_fn_ok(reg)) return 0; break;
+	case MRACC_R_BULK: if (reg->read.bulk==NULL) return 0; break;
+	default: return 0; /* One access method per direction */
+	}
+
+	switch (reg->access & MRACC_W_MASK) {
+	case 0: if (reg->write.pu8!=NULL) return 0; break;
+	case MRACC_W_PTR: if (!write_ptr_ok(reg)) return 0; break;
+	case MRACC_W_FN: if (is_block || !write_fn_ok(reg)) return 0; break;
+	case MRACC_W_BULK: if (reg->write.bulk==NULL) return 0; break;
+	default: return 0;
+	}
+
+	return 1;
+}
+
+extern int mbreg_validate(
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t *issue_addr)
+{
+	size_t i, prev_end;
+
+	if ((regs==NULL) || (n_regs==0u)) return 1;
+
+	prev_end = 0u;
+	for (i=0u; i<n_regs; ++i) {
+		if (((i > 0u) && (regs[i].address < prev_end))
+				|| !desc_ok(regs+i)
+				|| (reg_end(regs+i) > 0x10000u)) {
+			if (issue_addr!=NULL) *issue_addr = regs[i].address;
+			return 0;
+		}
+		prev_end = reg_end(regs+i);
+	}
+
+	return 1;
+}
+
 /**
  * @return n 16-bit registers read
  */
-static int read_val(const struct mbreg_desc_s *reg, uint8_t *res)
+static int read_val(const struct mbreg_desc_s *reg, uint8_t *res, size_t mask)
 {
 	switch (reg->type & MRTYPE_MASK) {
-	case MRTYPE_U8: u16tobe((uint16_t)reg->read.u8, res); break;
-	case MRTYPE_U16: u16tobe(reg->read.u16, res); break;
-	case MRTYPE_U32: u32tobe(reg->read.u32, res); break;
-	case MRTYPE_U64: u64tobe(reg->read.u64, res); break;
-	case MRTYPE_I8: i16tobe((int16_t)reg->read.i8, res); break;
-	case MRTYPE_I16: i16tobe(reg->read.i16, res); break;
-	case MRTYPE_I32: i32tobe(reg->read.i32, res); break;
-	case MRTYPE_I64: i64tobe(reg->read.i64, res); break;
-	case MRTYPE_F32: f32tobe(reg->read.f32, res); break;
-	case MRTYPE_F64: f64tobe(reg->read.f64, res); break;
+	case MRTYPE_U8: put16((uint16_t)reg->read.u8, res, mask); break;
+	case MRTYPE_U16: put16(reg->read.u16, res, mask); break;
+	case MRTYPE_U32: put32(reg->read.u32, res, mask); break;
+	case MRTYPE_U64: put64(reg->read.u64, res, mask); break;
+	case MRTYPE_I8: puti16((int16_t)reg->read.i8, res, mask); break;
+	case MRTYPE_I16: puti16(reg->read.i16, res, mask); break;
+	case MRTYPE_I32: puti32(reg->read.i32, res, mask); break;
+	case MRTYPE_I64: puti64(reg->read.i64, res, mask); break;
+	case MRTYPE_F32: putf32(reg->read.f32, res, mask); break;
+	case MRTYPE_F64: putf64(reg->read.f64, res, mask); break;
 	default: return 0;
 	}
 
@@ -268,21 +686,21 @@ static int read_val(const struct mbreg_desc_s *reg, uint8_t *res)
 /**
  * @return n 16-bit registers read
  */
-static int read_ptr(const struct mbreg_desc_s *reg, uint8_t *res)
+static int read_ptr(const struct mbreg_desc_s *reg, uint8_t *res, size_t mask)
 {
 	if (!read_ptr_ok(reg)) return 0;
 
 	switch (reg->type & MRTYPE_MASK) {
-	case MRTYPE_U8: u16tobe((uint16_t)*reg->read.pu8, res); break;
-	case MRTYPE_U16: u16tobe(*reg->read.pu16, res); break;
-	case MRTYPE_U32: u32tobe(*reg->read.pu32, res); break;
-	case MRTYPE_U64: u64tobe(*reg->read.pu64, res); break;
-	case MRTYPE_I8: i16tobe((int16_t)*reg->read.pi8, res); break;
-	case MRTYPE_I16: i16tobe(*reg->read.pi16, res); break;
-	case MRTYPE_I32: i32tobe(*reg->read.pi32, res); break;
-	case MRTYPE_I64: i64tobe(*reg->read.pi64, res); break;
-	case MRTYPE_F32: f32tobe(*reg->read.pf32, res); break;
-	case MRTYPE_F64: f64tobe(*reg->read.pf64, res); break;
+	case MRTYPE_U8: put16((uint16_t)*reg->read.pu8, res, mask); break;
+	case MRTYPE_U16: put16(*reg->read.pu16, res, mask); break;
+	case MRTYPE_U32: put32(*reg->read.pu32, res, mask); break;
+	case MRTYPE_U64: put64(*reg->read.pu64, res, mask); break;
+	case MRTYPE_I8: puti16((int16_t)*reg->read.pi8, res, mask); break;
+	case MRTYPE_I16: puti16(*reg->read.pi16, res, mask); break;
+	case MRTYPE_I32: puti32(*reg->read.pi32, res, mask); break;
+	case MRTYPE_I64: puti64(*reg->read.pi64, res, mask); break;
+	case MRTYPE_F32: putf32(*reg->read.pf32, res, mask); break;
+	case MRTYPE_F64: putf64(*reg->read.pf64, res, mask); break;
 	default: return 0;
 	}
 
@@ -292,7 +710,7 @@ static int read_ptr(const struct mbreg_desc_s *reg, uint8_t *res)
 /**
  * @return n 16-bit registers read
  */
-static int read_block(const struct mbreg_desc_s *reg, uint16_t addr, uint8_t *res)
+static int read_block(const struct mbreg_desc_s *reg, uint16_t addr, uint8_t *res, size_t mask)
 {
 	size_t reg_size_w, ix;
 	uint16_t start_addr;
@@ -308,16 +726,16 @@ static int read_block(const struct mbreg_desc_s *reg, uint16_t addr, uint8_t *re
 	}
 
 	switch (reg->type & MRTYPE_MASK) {
-	case MRTYPE_U8: u16tobe((uint16_t)*(reg->read.pu8 + ix), res); break;
-	case MRTYPE_U16: u16tobe(*(reg->read.pu16 + ix), res); break;
-	case MRTYPE_U32: u32tobe(*(reg->read.pu32 + ix), res); break;
-	case MRTYPE_U64: u64tobe(*(reg->read.pu64 + ix), res); break;
-	case MRTYPE_I8: i16tobe((int16_t)*(reg->read.pi8 + ix), res); break;
-	case MRTYPE_I16: i16tobe(*(reg->read.pi16 + ix), res); break;
-	case MRTYPE_I32: i32tobe(*(reg->read.pi32 + ix), res); break;
-	case MRTYPE_I64: i64tobe(*(reg->read.pi64 + ix), res); break;
-	case MRTYPE_F32: f32tobe(*(reg->read.pf32 + ix), res); break;
-	case MRTYPE_F64: f64tobe(*(reg->read.pf64 + ix), res); break;
+	case MRTYPE_U8: put16((uint16_t)*(reg->read.pu8 + ix), res, mask); break;
+	case MRTYPE_U16: put16(*(reg->read.pu16 + ix), res, mask); break;
+	case MRTYPE_U32: put32(*(reg->read.pu32 + ix), res, mask); break;
+	case MRTYPE_U64: put64(*(reg->read.pu64 + ix), res, mask); break;
+	case MRTYPE_I8: puti16((int16_t)*(reg->read.pi8 + ix), res, mask); break;
+	case MRTYPE_I16: puti16(*(reg->read.pi16 + ix), res, mask); break;
+	case MRTYPE_I32: puti32(*(reg->read.pi32 + ix), res, mask); break;
+	case MRTYPE_I64: puti64(*(reg->read.pi64 + ix), res, mask); break;
+	case MRTYPE_F32: putf32(*(reg->read.pf32 + ix), res, mask); break;
+	case MRTYPE_F64: putf64(*(reg->read.pf64 + ix), res, mask); break;
 	default: return 0;
 	}
 
@@ -327,37 +745,329 @@ static int read_block(const struct mbreg_desc_s *reg, uint16_t addr, uint8_t *re
 /**
  * @return n 16-bit registers read
  */
-static int read_fn(const struct mbreg_desc_s *reg, uint8_t *res)
+static int read_fn(const struct mbreg_desc_s *reg, uint8_t *res, size_t mask)
 {
 	if (!read_fn_ok(reg)) return 0;
 
 	switch (reg->type & MRTYPE_MASK) {
-	case MRTYPE_U8: u16tobe((uint16_t)reg->read.fu8(), res); break;
-	case MRTYPE_U16: u16tobe(reg->read.fu16(), res); break;
-	case MRTYPE_U32: u32tobe(reg->read.fu32(), res); break;
-	case MRTYPE_U64: u64tobe(reg->read.fu64(), res); break;
-	case MRTYPE_I8: i16tobe((int16_t)reg->read.fi8(), res); break;
-	case MRTYPE_I16: i16tobe(reg->read.fi16(), res); break;
-	case MRTYPE_I32: i32tobe(reg->read.fi32(), res); break;
-	case MRTYPE_I64: i64tobe(reg->read.fi64(), res); break;
-	case MRTYPE_F32: f32tobe(reg->read.ff32(), res); break;
-	case MRTYPE_F64: f64tobe(reg->read.ff64(), res); break;
+	case MRTYPE_U8: put16((uint16_t)reg->read.fu8(), res, mask); break;
+	case MRTYPE_U16: put16(reg->read.fu16(), res, mask); break;
+	case MRTYPE_U32: put32(reg->read.fu32(), res, mask); break;
+	case MRTYPE_U64: put64(reg->read.fu64(), res, mask); break;
+	case MRTYPE_I8: puti16((int16_t)reg->read.fi8(), res, mask); break;
+	case MRTYPE_I16: puti16(reg->read.fi16(), res, mask); break;
+	case MRTYPE_I32: puti32(reg->read.fi32(), res, mask); break;
+	case MRTYPE_I64: puti64(reg->read.fi64(), res, mask); break;
+	case MRTYPE_F32: putf32(reg->read.ff32(), res, mask); break;
+	case MRTYPE_F64: putf64(reg->read.ff64(), res, mask); break;
 	default: return 0;
 	}
 
 	return 1;
 }
 
+/**
+ * @brief Whether the value of a register may be remembered, see mbreg_memo_s
+ */
+static int is_memo_fn(const struct mbreg_desc_s *reg)
+{
+	return ((reg->access & MRACC_R_MASK) == MRACC_R_FN)
+		&& ((reg->type & MRTYPE_BLOCK) == 0)
+		&& (mbreg_size(reg) <= (MRTYPE_SIZE_MAX/8));
+}
+
+/**
+ * @brief Value of a function register cached across requests, or NULL
+ */
+static const uint8_t *fn_cache_find(struct mbreg_fn_cache_s *cache, const struct mbreg_desc_s *reg)
+{
+	size_t i;
+	const struct mbreg_fn_cache_entry_s *entry;
+
+	if ((cache==NULL) || (cache->entries==NULL)) return NULL;
+
+	for (i=0u; i<cache->n_entries; ++i) {
+		entry = &cache->entries[i];
+		if (entry->reg!=reg) continue;
+		if ((cache->clock_cb!=NULL)
+				&& (cache->max_age_ticks!=0u)
+				&& ((cache->clock_cb() - entry->stored_at) > cache->max_age_ticks)) {
+			return NULL; /* Too old, replaced by the next store */
+		}
+		++cache->n_hits;
+		return entry->val;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Keep the value of a function register, replacing an older value of it when present
+ */
+static void fn_cache_store(struct mbreg_fn_cache_s *cache, const struct mbreg_desc_s *reg, const uint8_t *val)
+{
+	size_t i;
+	struct mbreg_fn_cache_entry_s *entry;
+
+	if ((cache==NULL) || (cache->entries==NULL) || (cache->n_entries==0u)) return;
+
+	++cache->n_misses;
+	entry = NULL;
+	for (i=0u; i<cache->n_entries; ++i) {
+		if (cache->entries[i].reg==reg) {
+			entry = &cache->entries[i];
+			break;
+		}
+	}
+	if (entry==NULL) {
+		if (cache->next >= cache->n_entries) cache->next = 0u;
+		entry = &cache->entries[cache->next++];
+	}
+
+	entry->reg = reg;
+	entry->stored_at = (cache->clock_cb!=NULL) ? cache->clock_cb() : 0u;
+	(void)memcpy(entry->val, val, sizeof entry->val);
+}
+
+/**
+ * @brief Read a function register once per memo, and once per max age with a fn_cache
+ *
+ * @return 1 if read, 0 if the register has no read function
+ */
+static int read_fn_memo(struct mbreg_memo_s *memo, const struct mbreg_desc_s *reg, uint8_t *res, size_t mask)
+{
+	uint8_t buf[MRTYPE_SIZE_MAX/8];
+	const uint8_t *val;
+	uint8_t *slot;
+	size_t i, size;
+
+	if ((memo==NULL) || !is_memo_fn(reg)) return read_fn(reg, res, mask);
+
+	val = NULL;
+	for (i=0u; i<memo->n_vals; ++i) {
+		if (memo->val_reg[i]==reg) {
+			val = memo->val[i];
+			break;
+		}
+	}
+
+	if (val==NULL) {
+		slot = (memo->n_vals < MBREG_MEMO_N_VALS) ? memo->val[memo->n_vals] : buf; /* Read every time when full */
+		val = fn_cache_find(memo->fn_cache, reg);
+		if (val!=NULL) {
+			(void)memcpy(slot, val, sizeof buf);
+		} else {
+			(void)memset(slot, 0, sizeof buf);
+			if (!read_fn(reg, slot, 0u)) return 0;
+			fn_cache_store(memo->fn_cache, reg, slot);
+		}
+		if (slot!=buf) {
+			memo->val_reg[memo->n_vals++] = reg;
+		}
+		val = slot;
+	}
+
+	size = mbreg_size(reg);
+	for (i=0u; i<size; ++i) {
+		res[i^mask] = val[i];
+	}
+	return 1;
+}
+
+/**
+ * @brief Byte order a register is encoded in
+ *
+ * The order of the descriptor, or the order of the map when left as
+ * MBREG_ORDER_DEFAULT.
+ */
+static enum mbreg_order_e effective_order(const struct mbreg_desc_s *reg, int swap_words)
+{
+	if (reg->byte_order != MBREG_ORDER_DEFAULT) return (enum mbreg_order_e)reg->byte_order;
+	return swap_words ? MBREG_ORDER_CDAB : MBREG_ORDER_ABCD;
+}
+
+/**
+ * @brief Index mask mapping big-endian byte positions of a value of size bytes to its byte order
+ */
+static size_t order_mask(const struct mbreg_desc_s *reg, int swap_words, size_t size)
+{
+	switch (effective_order(reg, swap_words)) {
+	case MBREG_ORDER_BADC: return 1u;
+	case MBREG_ORDER_CDAB: return (size >= 4u) ? (size - 2u) : 0u;
+	case MBREG_ORDER_DCBA: return size - 1u;
+	default: return 0u;
+	}
+}
+
+/**
+ * @brief Check if a register is a plain 16-bit pointer block eligible for bulk copy
+ *
+ * Blocks of 16-bit elements without lock or post-write callbacks map one
+ * address to one element, so a whole span can be copied in one pass.
+ * Byte swapped blocks are left to the per-element path.
+ */
+static int is_bulk_u16_block(const struct mbreg_desc_s *reg)
+{
+	if ((reg->byte_order==MBREG_ORDER_BADC) || (reg->byte_order==MBREG_ORDER_DCBA)) return 0;
+
+	switch (reg->type & (MRTYPE_MASK | MRTYPE_BLOCK)) {
+	case MRTYPE_U16 | MRTYPE_BLOCK:
+	case MRTYPE_I16 | MRTYPE_BLOCK:
+		return (MBREG_CB(reg, rlock_cb)==NULL) && (MBREG_CB(reg, wlock_cb)==NULL) && (MBREG_CB(reg, post_write_cb)==NULL);
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief Number of block elements from addr to the end of the block, limited by n
+ */
+static size_t bulk_span(const struct mbreg_desc_s *reg, uint16_t addr, size_t n)
+{
+	size_t ix = (size_t)(addr - reg->address);
+
+	return (ix < reg->n_block_entries) ? min(reg->n_block_entries - ix, n) : 0u;
+}
+
+/**
+ * @brief Copy a span of a 16-bit block to big-endian protocol data
+ *
+ * @note The source is volatile, so every element is loaded exactly once
+ */
+static size_t read_bulk_u16(
+	const struct mbreg_desc_s *reg,
+	uint16_t addr,
+	size_t n_remaining_regs,
+	uint8_t *res)
+{
+	const volatile uint16_t *src;
+	size_t n, i;
+	uint16_t v;
+
+	if (reg->read.pu16==NULL) return MBREG_READ_DEV_FAIL;
+
+	n = bulk_span(reg, addr, n_remaining_regs);
+	if (n==0u) return MBREG_READ_DEV_FAIL;
+
+	if (res!=NULL) {
+		src = reg->read.pu16 + (addr - reg->address);
+		for (i=0u; i<n; ++i) {
+			v = src[i];
+			res[2u*i] = (uint8_t)(v >> 8);
+			res[(2u*i)+1u] = (uint8_t)v;
+		}
+	}
+
+	return n;
+}
+
+/**
+ * @brief Copy big-endian protocol data into a span of a 16-bit block
+ */
+static enum mbstatus_e write_bulk_u16(
+	const struct mbreg_desc_s *reg,
+	uint16_t addr,
+	size_t n_remaining_regs,
+	const uint8_t *val,
+	size_t *n_written)
+{
+	volatile uint16_t *dst;
+	size_t n, i;
+
+	if (reg->write.pu16==NULL) return MB_DEV_FAIL;
+
+	n = bulk_span(reg, addr, n_remaining_regs);
+	if (n==0u) return MB_DEV_FAIL;
+
+	dst = reg->write.pu16 + (addr - reg->address);
+	for (i=0u; i<n; ++i) {
+		dst[i] = (uint16_t)(((uint16_t)val[2u*i] << 8) | val[(2u*i)+1u]);
+	}
+
+	if (n_written) *n_written = n;
+
+	return MB_OK;
+}
+
+/**
+ * @brief Number of registers from addr covered by one bulk callback invocation, limited by n_max
+ *
+ * Extends the span of reg over following adjacent descriptors using the same
+ * bulk callback. For reads, a locked descriptor ends the run. For writes,
+ * descriptors with a post-write callback are not merged.
+ */
+static size_t bulk_run(
+	struct mbreg_memo_s *memo,
+	const struct mbreg_desc_s *reg,
+	size_t n_next,
+	uint16_t addr,
+	size_t n_max,
+	int is_write)
+{
+	const struct mbreg_desc_s *next;
+	size_t end;
+
+	end = reg_end(reg);
+	if (end <= (size_t)addr) return 0u;
+
+	for (next=reg+1; (n_next > 0u) && ((end - addr) < n_max); ++next, --n_next) {
+		if ((size_t)next->address != end) break;
+
+		if (is_write) {
+			if (((next->access & MRACC_W_MASK) != MRACC_W_BULK)
+					|| (next->write.bulk != reg->write.bulk)
+					|| (MBREG_CB(next, post_write_cb) != NULL)) {
+				break;
+			}
+		} else {
+			if (((next->access & MRACC_R_MASK) != MRACC_R_BULK)
+					|| (next->read.bulk != reg->read.bulk)) {
+				break;
+			}
+			if (mbreg_memo_locked(memo, MBREG_CB(next, rlock_cb))) break;
+		}
+
+		end = reg_end(next);
+	}
+
+	return min(end - addr, n_max);
+}
+
+/**
+ * @brief Read a bulk run, access and read lock of reg already checked
+ */
+static size_t read_bulk(
+	struct mbreg_memo_s *memo,
+	const struct mbreg_desc_s *reg,
+	size_t n_next,
+	uint16_t addr,
+	size_t n_max,
+	uint8_t *res)
+{
+	size_t n;
+
+	if (reg->read.bulk==NULL) return MBREG_READ_DEV_FAIL;
+
+	n = bulk_run(memo, reg, n_next, addr, n_max, 0);
+	if (n==0u) return MBREG_READ_DEV_FAIL;
+
+	if ((res!=NULL) && (reg->read.bulk(addr, n, res) != MB_OK)) {
+		return MBREG_READ_DEV_FAIL;
+	}
+
+	return n;
+}
+
 /**
  * @retval Number of 16-bit words actually read
  * @retval MBREG_READ_DEV_FAIL (SIZE_MAX) Device fault
  */
 static size_t read_partial(
+	struct mbreg_memo_s *memo,
 	const struct mbreg_desc_s *reg,
 	uint16_t addr,
 	size_t n_remaining_regs,
 	uint8_t *res,
-	int swap_words)
+	size_t mask)
 {
 	uint8_t buf[MRTYPE_SIZE_MAX/8];
 	size_t reg_size, buf_offset, n_copy;
@@ -366,30 +1076,22 @@ static size_t read_partial(
 	reg_size = mbreg_size(reg);
 
 	if ((reg->type & MRTYPE_BLOCK) != 0) {
-		ok=read_block(reg, addr, buf);
+		ok=read_block(reg, addr, buf, mask);
 	} else {
 		if (((addr - reg->address)*2u) >= (uint16_t)reg_size) {
 			return MBREG_READ_DEV_FAIL;
 		}
 
 		switch (reg->access & MRACC_R_MASK) {
-		case MRACC_R_VAL: ok=read_val(reg, buf); break;
-		case MRACC_R_PTR: ok=read_ptr(reg, buf); break;
-		case MRACC_R_FN: ok=read_fn(reg, buf); break;
+		case MRACC_R_VAL: ok=read_val(reg, buf, mask); break;
+		case MRACC_R_PTR: ok=read_ptr(reg, buf, mask); break;
+		case MRACC_R_FN: ok=read_fn_memo(memo, reg, buf, mask); break;
 		default: return MBREG_READ_DEV_FAIL;
 		}
 	}
 
 	if (!ok) return MBREG_READ_DEV_FAIL;
 
-	if (swap_words) {
-		switch (reg_size) {
-		case 4u: swap_words_u32(buf); break;
-		case 8u: swap_words_u64(buf); break;
-		default: break;
-		}
-	}
-
 	buf_offset = (size_t)(addr - reg->address) * 2u;
 	n_copy = min(reg_size-buf_offset, n_remaining_regs*2u);
 
@@ -401,35 +1103,84 @@ static size_t read_partial(
 }
 
 static int read_full(
+	struct mbreg_memo_s *memo,
 	const struct mbreg_desc_s *reg,
 	uint16_t addr,
 	uint8_t *res,
-	int swap_words)
+	size_t mask)
 {
 	int ok;
 
 	if ((reg->type & MRTYPE_BLOCK) != 0) {
-		ok=read_block(reg, addr, res);
+		ok=read_block(reg, addr, res, mask);
 	} else {
 		switch (reg->access & MRACC_R_MASK) {
-		case MRACC_R_VAL: ok=read_val(reg, res); break;
-		case MRACC_R_PTR: ok=read_ptr(reg, res); break;
-		case MRACC_R_FN: ok=read_fn(reg, res); break;
+		case MRACC_R_VAL: ok=read_val(reg, res, mask); break;
+		case MRACC_R_PTR: ok=read_ptr(reg, res, mask); break;
+		case MRACC_R_FN: ok=read_fn_memo(memo, reg, res, mask); break;
 		default: ok=0; break;
 		}
 	}
 
-	if (!ok) return 0;
+	return ok;
+}
 
-	if (swap_words) {
-		switch (mbreg_size(reg)) {
-		case 4u: swap_words_u32(res); break;
-		case 8u: swap_words_u64(res); break;
-		default: break;
-		}
+extern void mbreg_fn_cache_init(struct mbreg_fn_cache_s *cache)
+{
+	if (cache==NULL) return;
+
+	mbreg_fn_cache_invalidate(cache);
+	cache->n_hits = 0u;
+	cache->n_misses = 0u;
+}
+
+extern void mbreg_fn_cache_invalidate(struct mbreg_fn_cache_s *cache)
+{
+	size_t i;
+
+	if ((cache==NULL) || (cache->entries==NULL)) return;
+
+	for (i=0u; i<cache->n_entries; ++i) {
+		cache->entries[i].reg = NULL;
 	}
+	cache->next = 0u;
+}
 
-	return ok;
+extern void mbreg_memo_init(struct mbreg_memo_s *memo)
+{
+	if (memo==NULL) return;
+
+	memo->n_locks = 0u;
+	memo->n_vals = 0u;
+	memo->fn_cache = NULL;
+}
+
+extern void mbreg_memo_drop_vals(struct mbreg_memo_s *memo)
+{
+	if (memo==NULL) return;
+
+	memo->n_vals = 0u;
+}
+
+extern int mbreg_memo_locked(struct mbreg_memo_s *memo, int (*lock_cb)(void))
+{
+	size_t i;
+	int locked;
+
+	if (lock_cb==NULL) return 0;
+	if (memo==NULL) return lock_cb() != 0;
+
+	for (i=0u; i<memo->n_locks; ++i) {
+		if (memo->lock_cb[i]==lock_cb) return memo->locked[i];
+	}
+
+	locked = lock_cb() != 0;
+	if (memo->n_locks < MBREG_MEMO_N_LOCKS) { /* Evaluated every time when full */
+		memo->lock_cb[memo->n_locks] = lock_cb;
+		memo->locked[memo->n_locks] = (uint8_t)locked;
+		++memo->n_locks;
+	}
+	return locked;
 }
 
 extern size_t mbreg_read(
@@ -439,34 +1190,83 @@ extern size_t mbreg_read(
 	uint8_t *res,
 	int swap_words)
 {
-	size_t reg_size_w;
+	return mbreg_read_memo(NULL, reg, addr, n_remaining_regs, res, swap_words);
+}
+
+extern size_t mbreg_read_memo(
+	struct mbreg_memo_s *memo,
+	const struct mbreg_desc_s *reg,
+	uint16_t addr,
+	size_t n_remaining_regs,
+	uint8_t *res,
+	int swap_words)
+{
+	size_t reg_size_w, mask;
 
 	if (reg==NULL) return MBREG_READ_DEV_FAIL;
 	if (n_remaining_regs == 0u) return MBREG_READ_DEV_FAIL;
 	if (addr < reg->address) return MBREG_READ_DEV_FAIL;
 
 	if (!(reg->access & MRACC_R_MASK)) return MBREG_READ_NO_ACCESS; /* Check if read is allowed */
-	if (reg->rlock_cb && reg->rlock_cb()) return MBREG_READ_LOCKED; /* Check if read locked */
+	if (mbreg_memo_locked(memo, MBREG_CB(reg, rlock_cb))) return MBREG_READ_LOCKED; /* Check if read locked */
+
+	if (((reg->access & MRACC_R_MASK) == MRACC_R_PTR) && is_bulk_u16_block(reg)) {
+		return read_bulk_u16(reg, addr, n_remaining_regs, res);
+	}
+
+	if ((reg->access & MRACC_R_MASK) == MRACC_R_BULK) {
+		return read_bulk(memo, reg, 0u, addr, n_remaining_regs, res);
+	}
 
 	reg_size_w = mbreg_size(reg) / 2u;
 	if (reg_size_w == 0u) return MBREG_READ_DEV_FAIL;
+	mask = order_mask(reg, swap_words, reg_size_w*2u);
 
 	if ((n_remaining_regs < reg_size_w) || ((addr - reg->address) % reg_size_w)) {
-		return read_partial(reg, addr, n_remaining_regs, res, swap_words);
+		return read_partial(memo, reg, addr, n_remaining_regs, res, mask);
 	} else {
 		if (res!=NULL) { /* Not dry run */
-			if (!read_full(reg, addr, res, swap_words)) return MBREG_READ_DEV_FAIL;
+			if (!read_full(memo, reg, addr, res, mask)) return MBREG_READ_DEV_FAIL;
 		}
 		return reg_size_w;
 	}
 }
 
+extern size_t mbreg_read_bulk_run(
+	struct mbreg_memo_s *memo,
+	const struct mbreg_desc_s *reg,
+	size_t n_next,
+	uint16_t addr,
+	size_t n_max,
+	uint8_t *res)
+{
+	if (reg==NULL) return MBREG_READ_DEV_FAIL;
+	if (n_max == 0u) return MBREG_READ_DEV_FAIL;
+	if (addr < reg->address) return MBREG_READ_DEV_FAIL;
+
+	if ((reg->access & MRACC_R_MASK) != MRACC_R_BULK) return MBREG_READ_DEV_FAIL;
+	if (mbreg_memo_locked(memo, MBREG_CB(reg, rlock_cb))) return MBREG_READ_LOCKED; /* Check if read locked */
+
+	return read_bulk(memo, reg, n_next, addr, n_max, res);
+}
+
 extern size_t mbreg_write_allowed(
 	const struct mbreg_desc_s *reg,
 	uint16_t addr,
 	uint16_t start_addr,
 	size_t n_remaining_regs,
 	const uint8_t *val)
+{
+	return mbreg_write_allowed_memo(NULL, reg, addr, start_addr, n_remaining_regs, val);
+}
+
+extern size_t mbreg_write_allowed_memo(
+	struct mbreg_memo_s *memo,
+	const struct mbreg_desc_s *reg,
+	uint16_t addr,
+	uint16_t start_addr,
+	size_t n_remaining_regs,
+	const uint8_t *val)
 {
 	size_t reg_size_w, offset, n_write_bytes;
 
@@ -478,10 +1278,10 @@ extern size_t mbreg_write_allowed(
 	/* Check if write is allowed */
 	if (!(reg->access & MRACC_W_MASK)) return 0u;
 
-	/* Check if write is locked */
-	if (reg->wlock_cb && reg->wlock_cb()) {
-		if (!reg->wlock_override_cb
-				|| !reg->wlock_override_cb(
+	/* Check if write is locked, the override is asked for every locked register */
+	if (mbreg_memo_locked(memo, MBREG_CB(reg, wlock_cb))) {
+		if (!MBREG_CB(reg, wlock_override_cb)
+				|| !MBREG_CB(reg, wlock_override_cb)(
 					reg,
 					start_addr,
 					n_remaining_regs,
@@ -490,6 +1290,14 @@ extern size_t mbreg_write_allowed(
 		}
 	}
 
+	if (((reg->access & MRACC_W_MASK) == MRACC_W_PTR) && is_bulk_u16_block(reg)) {
+		return bulk_span(reg, addr, n_remaining_regs);
+	}
+
+	if ((reg->access & MRACC_W_MASK) == MRACC_W_BULK) {
+		return bulk_run(memo, reg, 0u, addr, n_remaining_regs, 1);
+	}
+
 	reg_size_w = mbreg_size(reg) / 2u;
 	if (reg_size_w == 0u) return 0u;
 
@@ -505,21 +1313,22 @@ extern size_t mbreg_write_allowed(
 
 static enum mbstatus_e write_ptr(
 	const struct mbreg_desc_s *reg,
-	const uint8_t *val)
+	const uint8_t *val,
+	size_t mask)
 {
 	if (!write_ptr_ok(reg)) return MB_DEV_FAIL;
 
 	switch (reg->type & MRTYPE_MASK) {
-	case MRTYPE_U8: *reg->write.pu8 = (uint8_t)betou16(val); break;
-	case MRTYPE_U16: *reg->write.pu16 = betou16(val); break;
-	case MRTYPE_U32: *reg->write.pu32 = betou32(val); break;
-	case MRTYPE_U64: *reg->write.pu64 = betou64(val); break;
-	case MRTYPE_I8: *reg->write.pi8 = (int8_t)betoi16(val); break;
-	case MRTYPE_I16: *reg->write.pi16 = betoi16(val); break;
-	case MRTYPE_I32: *reg->write.pi32 = betoi32(val); break;
-	case MRTYPE_I64: *reg->write.pi64 = betoi64(val); break;
-	case MRTYPE_F32: *reg->write.pf32 = betof32(val); break;
-	case MRTYPE_F64: *reg->write.pf64 = betof64(val); break;
+	case MRTYPE_U8: *reg->write.pu8 = (uint8_t)get16(val, mask); break;
+	case MRTYPE_U16: *reg->write.pu16 = get16(val, mask); break;
+	case MRTYPE_U32: *reg->write.pu32 = get32(val, mask); break;
+	case MRTYPE_U64: *reg->write.pu64 = get64(val, mask); break;
+	case MRTYPE_I8: *reg->write.pi8 = (int8_t)geti16(val, mask); break;
+	case MRTYPE_I16: *reg->write.pi16 = geti16(val, mask); break;
+	case MRTYPE_I32: *reg->write.pi32 = geti32(val, mask); break;
+	case MRTYPE_I64: *reg->write.pi64 = geti64(val, mask); break;
+	case MRTYPE_F32: *reg->write.pf32 = getf32(val, mask); break;
+	case MRTYPE_F64: *reg->write.pf64 = getf64(val, mask); break;
 	default: return MB_DEV_FAIL;
 	}
 
@@ -531,7 +1340,8 @@ static enum mbstatus_e write_ptr_partial(
 	uint16_t addr,
 	size_t n_remaining_regs,
 	const uint8_t *val,
-	size_t *n_written)
+	size_t *n_written,
+	size_t mask)
 {
 	uint8_t buf[MRTYPE_SIZE_MAX/8];
 	size_t reg_size, buf_offset, n_copy;
@@ -546,16 +1356,16 @@ static enum mbstatus_e write_ptr_partial(
 
 	/* Read the current value into a buffer */
 	switch (reg->type & MRTYPE_MASK) {
-	case MRTYPE_U8: u16tobe((uint16_t)*reg->write.pu8, buf); break;
-	case MRTYPE_U16: u16tobe(*reg->write.pu16, buf); break;
-	case MRTYPE_U32: u32tobe(*reg->write.pu32, buf); break;
-	case MRTYPE_U64: u64tobe(*reg->write.pu64, buf); break;
-	case MRTYPE_I8: i16tobe((int16_t)*reg->write.pi8, buf); break;
-	case MRTYPE_I16: i16tobe(*reg->write.pi16, buf); break;
-	case MRTYPE_I32: i32tobe(*reg->write.pi32, buf); break;
-	case MRTYPE_I64: i64tobe(*reg->write.pi64, buf); break;
-	case MRTYPE_F32: f32tobe(*reg->write.pf32, buf); break;
-	case MRTYPE_F64: f64tobe(*reg->write.pf64, buf); break;
+	case MRTYPE_U8: put16((uint16_t)*reg->write.pu8, buf, mask); break;
+	case MRTYPE_U16: put16(*reg->write.pu16, buf, mask); break;
+	case MRTYPE_U32: put32(*reg->write.pu32, buf, mask); break;
+	case MRTYPE_U64: put64(*reg->write.pu64, buf, mask); break;
+	case MRTYPE_I8: puti16((int16_t)*reg->write.pi8, buf, mask); break;
+	case MRTYPE_I16: puti16(*reg->write.pi16, buf, mask); break;
+	case MRTYPE_I32: puti32(*reg->write.pi32, buf, mask); break;
+	case MRTYPE_I64: puti64(*reg->write.pi64, buf, mask); break;
+	case MRTYPE_F32: putf32(*reg->write.pf32, buf, mask); break;
+	case MRTYPE_F64: putf64(*reg->write.pf64, buf, mask); break;
 	default: return MB_DEV_FAIL;
 	}
 
@@ -567,27 +1377,28 @@ static enum mbstatus_e write_ptr_partial(
 	if (n_written) *n_written = n_copy / 2u;
 
 	/* Write the modified value */
-	return write_ptr(reg, buf);
+	return write_ptr(reg, buf, mask);
 }
 
 static enum mbstatus_e write_block(
 	const struct mbreg_desc_s *reg,
 	uint16_t addr,
-	const uint8_t *val)
+	const uint8_t *val,
+	size_t mask)
 {
 	size_t ix = (addr - reg->address) / (mbreg_size(reg) / 2u);
 
 	switch (reg->type & MRTYPE_MASK) {
-	case MRTYPE_U8: *(reg->write.pu8 + ix) = (uint8_t)betoi16(val); break;
-	case MRTYPE_U16: *(reg->write.pu16 + ix) = betou16(val); break;
-	case MRTYPE_U32: *(reg->write.pu32 + ix) = betou32(val); break;
-	case MRTYPE_U64: *(reg->write.pu64 + ix) = betou64(val); break;
-	case MRTYPE_I8: *(reg->write.pi8 + ix) = (int8_t)betoi16(val); break;
-	case MRTYPE_I16: *(reg->write.pi16 + ix) = betoi16(val); break;
-	case MRTYPE_I32: *(reg->write.pi32 + ix) = betoi32(val); break;
-	case MRTYPE_I64: *(reg->write.pi64 + ix) = betoi64(val); break;
-	case MRTYPE_F32: *(reg->write.pf32 + ix) = betof32(val); break;
-	case MRTYPE_F64: *(reg->write.pf64 + ix) = betof64(val); break;
+	case MRTYPE_U8: *(reg->write.pu8 + ix) = (uint8_t)geti16(val, mask); break;
+	case MRTYPE_U16: *(reg->write.pu16 + ix) = get16(val, mask); break;
+	case MRTYPE_U32: *(reg->write.pu32 + ix) = get32(val, mask); break;
+	case MRTYPE_U64: *(reg->write.pu64 + ix) = get64(val, mask); break;
+	case MRTYPE_I8: *(reg->write.pi8 + ix) = (int8_t)geti16(val, mask); break;
+	case MRTYPE_I16: *(reg->write.pi16 + ix) = geti16(val, mask); break;
+	case MRTYPE_I32: *(reg->write.pi32 + ix) = geti32(val, mask); break;
+	case MRTYPE_I64: *(reg->write.pi64 + ix) = geti64(val, mask); break;
+	case MRTYPE_F32: *(reg->write.pf32 + ix) = getf32(val, mask); break;
+	case MRTYPE_F64: *(reg->write.pf64 + ix) = getf64(val, mask); break;
 	default: return MB_DEV_FAIL;
 	}
 
@@ -599,7 +1410,8 @@ static enum mbstatus_e write_block_partial(
 	uint16_t addr,
 	size_t n_remaining_regs,
 	const uint8_t *val,
-	size_t *n_written)
+	size_t *n_written,
+	size_t mask)
 {
 	uint8_t buf[MRTYPE_SIZE_MAX/8];
 	uint16_t start_addr;
@@ -616,16 +1428,16 @@ static enum mbstatus_e write_block_partial(
 
 	/* Read the current value into a buffer */
 	switch (reg->type & MRTYPE_MASK) {
-	case MRTYPE_U8: u16tobe((uint16_t)*(reg->write.pu8 + ix), buf); break;
-	case MRTYPE_U16: u16tobe(*(reg->write.pu16 + ix), buf); break;
-	case MRTYPE_U32: u32tobe(*(reg->write.pu32 + ix), buf); break;
-	case MRTYPE_U64: u64tobe(*(reg->write.pu64 + ix), buf); break;
-	case MRTYPE_I8: i16tobe((int16_t)*(reg->write.pi8 + ix), buf); break;
-	case MRTYPE_I16: i16tobe(*(reg->write.pi16 + ix), buf); break;
-	case MRTYPE_I32: i32tobe(*(reg->write.pi32 + ix), buf); break;
-	case MRTYPE_I64: i64tobe(*(reg->write.pi64 + ix), buf); break;
-	case MRTYPE_F32: f32tobe(*(reg->write.pf32 + ix), buf); break;
-	case MRTYPE_F64: f64tobe(*(reg->write.pf64 + ix), buf); break;
+	case MRTYPE_U8: put16((uint16_t)*(reg->write.pu8 + ix), buf, mask); break;
+	case MRTYPE_U16: put16(*(reg->write.pu16 + ix), buf, mask); break;
+	case MRTYPE_U32: put32(*(reg->write.pu32 + ix), buf, mask); break;
+	case MRTYPE_U64: put64(*(reg->write.pu64 + ix), buf, mask); break;
+	case MRTYPE_I8: puti16((int16_t)*(reg->write.pi8 + ix), buf, mask); break;
+	case MRTYPE_I16: puti16(*(reg->write.pi16 + ix), buf, mask); break;
+	case MRTYPE_I32: puti32(*(reg->write.pi32 + ix), buf, mask); break;
+	case MRTYPE_I64: puti64(*(reg->write.pi64 + ix), buf, mask); break;
+	case MRTYPE_F32: putf32(*(reg->write.pf32 + ix), buf, mask); break;
+	case MRTYPE_F64: putf64(*(reg->write.pf64 + ix), buf, mask); break;
 	default: return MB_DEV_FAIL;
 	}
 
@@ -637,26 +1449,27 @@ static enum mbstatus_e write_block_partial(
 	if (n_written) *n_written = n_copy / 2u;
 
 	/* Write the modified value */
-	return write_block(reg, addr, buf);
+	return write_block(reg, addr, buf, mask);
 }
 
 static enum mbstatus_e write_fn(
 	const struct mbreg_desc_s *reg,
-	const uint8_t *val)
+	const uint8_t *val,
+	size_t mask)
 {
 	if (!write_fn_ok(reg)) return MB_DEV_FAIL;
 
 	switch (reg->type & MRTYPE_MASK) {
-	case MRTYPE_U8: return reg->write.fu8((uint8_t)betou16(val));
-	case MRTYPE_U16: return reg->write.fu16(betou16(val));
-	case MRTYPE_U32: return reg->write.fu32(betou32(val));
-	case MRTYPE_U64: return reg->write.fu64(betou64(val));
-	case MRTYPE_I8: return reg->write.fi8((int8_t)betoi16(val));
-	case MRTYPE_I16: return reg->write.fi16(betoi16(val));
-	case MRTYPE_I32: return reg->write.fi32(betoi32(val));
-	case MRTYPE_I64: return reg->write.fi64(betoi64(val));
-	case MRTYPE_F32: return reg->write.ff32(betof32(val));
-	case MRTYPE_F64: return reg->write.ff64(betof64(val));
+	case MRTYPE_U8: return reg->write.fu8((uint8_t)get16(val, mask));
+	case MRTYPE_U16: return reg->write.fu16(get16(val, mask));
+	case MRTYPE_U32: return reg->write.fu32(get32(val, mask));
+	case MRTYPE_U64: return reg->write.fu64(get64(val, mask));
+	case MRTYPE_I8: return reg->write.fi8((int8_t)geti16(val, mask));
+	case MRTYPE_I16: return reg->write.fi16(geti16(val, mask));
+	case MRTYPE_I32: return reg->write.fi32(geti32(val, mask));
+	case MRTYPE_I64: return reg->write.fi64(geti64(val, mask));
+	case MRTYPE_F32: return reg->write.ff32(getf32(val, mask));
+	case MRTYPE_F64: return reg->write.ff64(getf64(val, mask));
 	default: return MB_DEV_FAIL;
 	}
 }
@@ -666,7 +1479,8 @@ static enum mbstatus_e write_partial_fn(
 	uint16_t addr,
 	size_t n_remaining_regs,
 	const uint8_t *val,
-	size_t *n_written)
+	size_t *n_written,
+	size_t mask)
 {
 	uint8_t buf[MRTYPE_SIZE_MAX/8];
 	size_t reg_size, buf_offset, n_copy;
@@ -693,7 +1507,7 @@ static enum mbstatus_e write_partial_fn(
 	if (n_written) *n_written = n_copy / 2u;
 
 	/* Write the modified value */
-	return write_fn(reg, buf);
+	return write_fn(reg, buf, mask);
 }
 
 extern enum mbstatus_e mbreg_write(
@@ -703,39 +1517,75 @@ extern enum mbstatus_e mbreg_write(
 	const uint8_t *val,
 	size_t *n_written)
 {
-	size_t reg_size_w;
+	size_t reg_size_w, mask;
 
 	if (!reg || !val) return MB_DEV_FAIL;
 
 	if (n_remaining_regs == 0u) return MB_DEV_FAIL;
 	if (addr < reg->address) return MB_DEV_FAIL;
 
+	if (((reg->access & MRACC_W_MASK) == MRACC_W_PTR) && is_bulk_u16_block(reg)) {
+		return write_bulk_u16(reg, addr, n_remaining_regs, val, n_written);
+	}
+
+	if ((reg->access & MRACC_W_MASK) == MRACC_W_BULK) {
+		return mbreg_write_bulk_run(reg, 0u, addr, n_remaining_regs, val, n_written);
+	}
+
 	reg_size_w = mbreg_size(reg) / 2u;
 	if (reg_size_w == 0u) return MB_DEV_FAIL;
+	mask = order_mask(reg, 0, reg_size_w*2u);
 
 	if ((n_remaining_regs < reg_size_w) || ((addr - reg->address) % reg_size_w)) { /* Partial reg write*/
 		if ((reg->type & MRTYPE_BLOCK) != 0) {
-			return write_block_partial(reg, addr, n_remaining_regs, val, n_written);
+			return write_block_partial(reg, addr, n_remaining_regs, val, n_written, mask);
 		} else if ((reg->access & MRACC_W_MASK) == MRACC_W_PTR) {
-			return write_ptr_partial(reg, addr, n_remaining_regs, val, n_written);
+			return write_ptr_partial(reg, addr, n_remaining_regs, val, n_written, mask);
 		} else {
-			return write_partial_fn(reg, addr, n_remaining_regs, val, n_written);
+			return write_partial_fn(reg, addr, n_remaining_regs, val, n_written, mask);
 		}
 	} else { /* Full reg write */
 		if (n_written) *n_written = reg_size_w;
 
 		if ((reg->type & MRTYPE_BLOCK) != 0) {
-			return write_block(reg, addr, val);
+			return write_block(reg, addr, val, mask);
 		} else {
 			switch (reg->access & MRACC_W_MASK) {
-			case MRACC_W_PTR: return write_ptr(reg, val);
-			case MRACC_W_FN: return write_fn(reg, val);
+			case MRACC_W_PTR: return write_ptr(reg, val, mask);
+			case MRACC_W_FN: return write_fn(reg, val, mask);
 			default: return MB_DEV_FAIL;
 			}
 		}
 	}
 }
 
+extern enum mbstatus_e mbreg_write_bulk_run(
+	const struct mbreg_desc_s *reg,
+	size_t n_next,
+	uint16_t addr,
+	size_t n_max,
+	const uint8_t *val,
+	size_t *n_written)
+{
+	size_t n;
+
+	if (!reg || !val) return MB_DEV_FAIL;
+
+	if (n_max == 0u) return MB_DEV_FAIL;
+	if (addr < reg->address) return MB_DEV_FAIL;
+
+	if (((reg->access & MRACC_W_MASK) != MRACC_W_BULK) || (reg->write.bulk==NULL)) {
+		return MB_DEV_FAIL;
+	}
+
+	n = bulk_run(NULL, reg, n_next, addr, n_max, 1);
+	if (n==0u) return MB_DEV_FAIL;
+
+	if (n_written) *n_written = n;
+
+	return reg->write.bulk(addr, n, val);
+}
+
 extern enum mbstatus_e mbreg_mask_write(
 	const struct mbreg_desc_s *reg,
 	uint16_t addr,
@@ -759,3 +1609,189 @@ extern enum mbstatus_e mbreg_mask_write(
 
 	return mbreg_write(reg, addr, 1u, buf, NULL);
 }
+
+/*
+ * Kernels, one per type and access method. Reads of 32 and 64-bit registers
+ * also come with the word order swapped (CDAB).
+ */
+#define READ_KERNELS(sfx, conv, cast) \
+	static void kread_val_##sfx(const struct mbreg_desc_s *reg, uint8_t *res) {conv(cast reg->read.sfx, res);} \
+	static void kread_ptr_##sfx(const struct mbreg_desc_s *reg, uint8_t *res) {conv(cast *reg->read.p##sfx, res);} \
+	static void kread_fn_##sfx(const struct mbreg_desc_s *reg, uint8_t *res) {conv(cast reg->read.f##sfx(), res);}
+
+#define READ_KERNELS_SWAPPED(sfx, put, mask) \
+	static void kread_val_##sfx##_sw(const struct mbreg_desc_s *reg, uint8_t *res) {put(reg->read.sfx, res, mask);} \
+	static void kread_ptr_##sfx##_sw(const struct mbreg_desc_s *reg, uint8_t *res) {put(*reg->read.p##sfx, res, mask);} \
+	static void kread_fn_##sfx##_sw(const struct mbreg_desc_s *reg, uint8_t *res) {put(reg->read.f##sfx(), res, mask);}
+
+#define WRITE_KERNELS(sfx, conv, cast) \
+	static enum mbstatus_e kwrite_ptr_##sfx(const struct mbreg_desc_s *reg, const uint8_t *val) {*reg->write.p##sfx = cast conv(val); return MB_OK;} \
+	static enum mbstatus_e kwrite_fn_##sfx(const struct mbreg_desc_s *reg, const uint8_t *val) {return reg->write.f##sfx(cast conv(val));}
+
+READ_KERNELS(u8, u16tobe, (uint16_t))
+READ_KERNELS(u16, u16tobe, )
+READ_KERNELS(u32, u32tobe, )
+READ_KERNELS(u64, u64tobe, )
+READ_KERNELS(i8, i16tobe, (int16_t))
+READ_KERNELS(i16, i16tobe, )
+READ_KERNELS(i32, i32tobe, )
+READ_KERNELS(i64, i64tobe, )
+READ_KERNELS(f32, f32tobe, )
+READ_KERNELS(f64, f64tobe, )
+
+READ_KERNELS_SWAPPED(u32, put32, 2u)
+READ_KERNELS_SWAPPED(u64, put64, 6u)
+READ_KERNELS_SWAPPED(i32, puti32, 2u)
+READ_KERNELS_SWAPPED(i64, puti64, 6u)
+READ_KERNELS_SWAPPED(f32, putf32, 2u)
+READ_KERNELS_SWAPPED(f64, putf64, 6u)
+
+WRITE_KERNELS(u8, betou16, (uint8_t))
+WRITE_KERNELS(u16, betou16, )
+WRITE_KERNELS(u32, betou32, )
+WRITE_KERNELS(u64, betou64, )
+WRITE_KERNELS(i8, betoi16, (int8_t))
+WRITE_KERNELS(i16, betoi16, )
+WRITE_KERNELS(i32, betoi32, )
+WRITE_KERNELS(i64, betoi64, )
+WRITE_KERNELS(f32, betof32, )
+WRITE_KERNELS(f64, betof64, )
+
+/**
+ * @brief Kernels of one type, by access method and word order
+ */
+struct kernel_set_s {
+	uint16_t type;
+	void (*read_val)(const struct mbreg_desc_s *reg, uint8_t *res);
+	void (*read_ptr)(const struct mbreg_desc_s *reg, uint8_t *res);
+	void (*read_fn)(const struct mbreg_desc_s *reg, uint8_t *res);
+	void (*read_val_sw)(const struct mbreg_desc_s *reg, uint8_t *res);
+	void (*read_ptr_sw)(const struct mbreg_desc_s *reg, uint8_t *res);
+	void (*read_fn_sw)(const struct mbreg_desc_s *reg, uint8_t *res);
+	enum mbstatus_e (*write_ptr)(const struct mbreg_desc_s *reg, const uint8_t *val);
+	enum mbstatus_e (*write_fn)(const struct mbreg_desc_s *reg, const uint8_t *val);
+};
+
+static const struct kernel_set_s s_kernel_sets[] = {
+	{MRTYPE_U8, kread_val_u8, kread_ptr_u8, kread_fn_u8, kread_val_u8, kread_ptr_u8, kread_fn_u8, kwrite_ptr_u8, kwrite_fn_u8},
+	{MRTYPE_U16, kread_val_u16, kread_ptr_u16, kread_fn_u16, kread_val_u16, kread_ptr_u16, kread_fn_u16, kwrite_ptr_u16, kwrite_fn_u16},
+	{MRTYPE_U32, kread_val_u32, kread_ptr_u32, kread_fn_u32, kread_val_u32_sw, kread_ptr_u32_sw, kread_fn_u32_sw, kwrite_ptr_u32, kwrite_fn_u32},
+	{MRTYPE_U64, kread_val_u64, kread_ptr_u64, kread_fn_u64, kread_val_u64_sw, kread_ptr_u64_sw, kread_fn_u64_sw, kwrite_ptr_u64, kwrite_fn_u64},
+	{MRTYPE_I8, kread_val_i8, kread_ptr_i8, kread_fn_i8, kread_val_i8, kread_ptr_i8, kread_fn_i8, kwrite_ptr_i8, kwrite_fn_i8},
+	{MRTYPE_I16, kread_val_i16, kread_ptr_i16, kread_fn_i16, kread_val_i16, kread_ptr_i16, kread_fn_i16, kwrite_ptr_i16, kwrite_fn_i16},
+	{MRTYPE_I32, kread_val_i32, kread_ptr_i32, kread_fn_i32, kread_val_i32_sw, kread_ptr_i32_sw, kread_fn_i32_sw, kwrite_ptr_i32, kwrite_fn_i32},
+	{MRTYPE_I64, kread_val_i64, kread_ptr_i64, kread_fn_i64, kread_val_i64_sw, kread_ptr_i64_sw, kread_fn_i64_sw, kwrite_ptr_i64, kwrite_fn_i64},
+	{MRTYPE_F32, kread_val_f32, kread_ptr_f32, kread_fn_f32, kread_val_f32_sw, kread_ptr_f32_sw, kread_fn_f32_sw, kwrite_ptr_f32, kwrite_fn_f32},
+	{MRTYPE_F64, kread_val_f64, kread_ptr_f64, kread_fn_f64, kread_val_f64_sw, kread_ptr_f64_sw, kread_fn_f64_sw, kwrite_ptr_f64, kwrite_fn_f64},
+};
+
+/**
+ * @brief Resolve the kernels of one descriptor, NULL where mbreg_read()/mbreg_write() must be used
+ */
+static void kernel_resolve(struct mbreg_kernel_s *kernel, const struct mbreg_desc_s *reg, int swap_words)
+{
+	const struct kernel_set_s *set = NULL;
+	enum mbreg_order_e order;
+	int swapped;
+	size_t i;
+
+	kernel->read = NULL;
+	kernel->write = NULL;
+	kernel->n_words = (uint8_t)(mbreg_size(reg) / 2u);
+	kernel->swap_words = (uint8_t)(swap_words != 0);
+
+	if ((reg->type & MRTYPE_BLOCK) != 0) return;
+
+	for (i=0u; i<(sizeof s_kernel_sets / sizeof s_kernel_sets[0]); ++i) {
+		if (s_kernel_sets[i].type==(reg->type & MRTYPE_MASK)) {
+			set = &s_kernel_sets[i];
+			break;
+		}
+	}
+	if (set==NULL) return;
+
+	/* Kernels cover the big-endian and word swapped orders, the rest goes through mbreg_read()/mbreg_write() */
+	order = effective_order(reg, swap_words);
+	swapped = (order==MBREG_ORDER_CDAB);
+
+	/* Same access dispatch and configuration checks as read_full() and mbreg_write() */
+	if ((order==MBREG_ORDER_ABCD) || swapped) {
+		switch (reg->access & MRACC_R_MASK) {
+		case MRACC_R_VAL: kernel->read = swapped ? set->read_val_sw : set->read_val; break;
+		case MRACC_R_PTR: if (read_ptr_ok(reg)) {kernel->read = swapped ? set->read_ptr_sw : set->read_ptr;} break;
+		case MRACC_R_FN: if (read_fn_ok(reg)) {kernel->read = swapped ? set->read_fn_sw : set->read_fn;} break;
+		default: break;
+		}
+	}
+
+	if (effective_order(reg, 0) != MBREG_ORDER_ABCD) return;
+
+	switch (reg->access & MRACC_W_MASK) {
+	case MRACC_W_PTR: if (write_ptr_ok(reg)) {kernel->write = set->write_ptr;} break;
+	case MRACC_W_FN: if (write_fn_ok(reg)) {kernel->write = set->write_fn;} break;
+	default: break;
+	}
+}
+
+extern void mbreg_kernels_build(
+	struct mbreg_kernel_s *kernels,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	int swap_words)
+{
+	size_t i;
+
+	if ((kernels==NULL) || (regs==NULL)) return;
+
+	for (i=0u; i<n_regs; ++i) {
+		kernel_resolve(&kernels[i], &regs[i], swap_words);
+	}
+}
+
+extern size_t mbreg_read_kernel(
+	struct mbreg_memo_s *memo,
+	const struct mbreg_kernel_s *kernel,
+	const struct mbreg_desc_s *reg,
+	uint16_t addr,
+	size_t n_remaining_regs,
+	uint8_t *res,
+	int swap_words)
+{
+	if ((kernel==NULL)
+			|| (kernel->read==NULL)
+			|| (reg==NULL)
+			|| (addr!=reg->address)
+			|| (n_remaining_regs < kernel->n_words)
+			|| (kernel->swap_words != (uint8_t)(swap_words != 0))
+			|| ((memo!=NULL) && (memo->fn_cache!=NULL) && is_memo_fn(reg))) {
+		return mbreg_read_memo(memo, reg, addr, n_remaining_regs, res, swap_words);
+	}
+
+	if (mbreg_memo_locked(memo, MBREG_CB(reg, rlock_cb))) return MBREG_READ_LOCKED; /* Check if read locked */
+
+	if (res!=NULL) { /* Not dry run */
+		kernel->read(reg, res);
+	}
+	return kernel->n_words;
+}
+
+extern enum mbstatus_e mbreg_write_kernel(
+	const struct mbreg_kernel_s *kernel,
+	const struct mbreg_desc_s *reg,
+	uint16_t addr,
+	size_t n_remaining_regs,
+	const uint8_t *val,
+	size_t *n_written)
+{
+	if ((kernel==NULL)
+			|| (kernel->write==NULL)
+			|| (reg==NULL)
+			|| (val==NULL)
+			|| (addr!=reg->address)
+			|| (n_remaining_regs < kernel->n_words)) {
+		return mbreg_write(reg, addr, n_remaining_regs, val, n_written);
+	}
+
+	if (n_written) *n_written = kernel->n_words;
+	return kernel->write(reg, val);
+}
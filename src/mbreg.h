@@ -42,7 +42,9 @@
 #ifndef MBREG_H_INCLUDED
 #define MBREG_H_INCLUDED
 
+#include "mbconfig.h"
 #include "mbdef.h"
+#include "mbpage.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -74,8 +76,13 @@ enum mbreg_type_e {
 	 *
 	 * @note 7-bit values are handled as one per 16-bit register
 	 * @note Use n_block_entries to specify array size
+	 * @note Bit 7 with MBCFG_COMPACT_REGS, to fit the one byte type
 	 */
+#if MBCFG_COMPACT_REGS
+	MRTYPE_BLOCK = 1u<<7,
+#else
 	MRTYPE_BLOCK = 512u,
+#endif
 
 	MRTYPE_U8 = MRTYPE_SIZE_8 | MRTYPE_UNSIGNED, /**< padded to 16-bit for protocol */
 	MRTYPE_U16 = MRTYPE_SIZE_16 | MRTYPE_UNSIGNED,
@@ -107,10 +114,58 @@ enum mbreg_access_e {
 	MRACC_W_FN = 1u<<4, /**< Write via function callback */
 	MRACC_RW_FN = MRACC_R_FN | MRACC_W_FN, /**< Read/write via function callbacks */
 
-	MRACC_R_MASK = MRACC_R_VAL | MRACC_R_PTR | MRACC_R_FN, /**< Mask for read access methods */
-	MRACC_W_MASK = MRACC_W_PTR | MRACC_W_FN, /**< Mask for write access methods */
+	MRACC_R_BULK = 1u<<5, /**< Read a span of registers via bulk callback */
+	MRACC_W_BULK = 1u<<6, /**< Write a span of registers via bulk callback */
+	MRACC_RW_BULK = MRACC_R_BULK | MRACC_W_BULK, /**< Read/write via bulk callbacks */
+
+	MRACC_R_MASK = MRACC_R_VAL | MRACC_R_PTR | MRACC_R_FN | MRACC_R_BULK, /**< Mask for read access methods */
+	MRACC_W_MASK = MRACC_W_PTR | MRACC_W_FN | MRACC_W_BULK, /**< Mask for write access methods */
 };
 
+/**
+ * @brief Byte order of a register on the wire
+ *
+ * Letters name the bytes of the big-endian encoding, A being the most
+ * significant. 16-bit registers only tell apart ABCD and BADC (AB/BA).
+ */
+enum mbreg_order_e {
+	MBREG_ORDER_DEFAULT = 0u, /**< Order of the map: ABCD, or CDAB for reads with swap_words */
+	MBREG_ORDER_ABCD, /**< Big-endian, most significant word first (Modbus default) */
+	MBREG_ORDER_CDAB, /**< Big-endian words, least significant word first */
+	MBREG_ORDER_BADC, /**< Little-endian words, most significant word first */
+	MBREG_ORDER_DCBA, /**< Little-endian */
+};
+
+struct mbreg_desc_s;
+
+/**
+ * @brief Lock and post-write callbacks shared by register descriptors
+ *
+ * With MBCFG_COMPACT_REGS, descriptors refer to an entry of mbreg_policies
+ * through mbreg_desc_s::policy instead of carrying the callbacks, see
+ * mbreg_desc_s for their meaning. Descriptors with the same callbacks share
+ * one entry.
+ */
+struct mbreg_policy_s {
+	int (*rlock_cb)(void); /**< See mbreg_desc_s::rlock_cb */
+	int (*wlock_cb)(void); /**< See mbreg_desc_s::wlock_cb */
+	int (*wlock_override_cb)(
+		const struct mbreg_desc_s *reg,
+		uint16_t reg_start_addr,
+		size_t n_remaining_regs,
+		const uint8_t *val); /**< See mbreg_desc_s::wlock_override_cb */
+	void (*post_write_cb)(void); /**< See mbreg_desc_s::post_write_cb */
+};
+
+#if MBCFG_COMPACT_REGS
+/**
+ * @brief Policy table of all register maps, defined by the application
+ *
+ * @note Entry 0 is used by descriptors without callbacks and must be all NULL
+ */
+extern const struct mbreg_policy_s mbreg_policies[];
+#endif
+
 /**
  * @brief Modbus Register Descriptor
  *
@@ -132,13 +187,28 @@ struct mbreg_desc_s {
 	 */
 	uint16_t address;
 
+	/**
+	 * @brief Byte order of the register value, see mbreg_order_e
+	 *
+	 * Applies to reads, writes and file records alike, and overrides the
+	 * word order of the map (mbinst_s::swap_words).
+	 *
+	 * @note Can be left as 0 (MBREG_ORDER_DEFAULT)
+	 * @note Not applied to bulk callbacks, which handle the wire data as is
+	 */
+	uint8_t byte_order;
+
 	/**
 	 * @brief Register data type and block flag
 	 *
 	 * Specifies the data type (U8, U16, U32, U64, I8, I16, I32, I64, F32, F64)
 	 * and optionally the MRTYPE_BLOCK flag for array access.
 	 */
+#if MBCFG_COMPACT_REGS
+	uint8_t type;
+#else
 	enum mbreg_type_e type;
+#endif
 
 	/**
 	 * @brief Access method configuration
@@ -149,7 +219,23 @@ struct mbreg_desc_s {
 	 * @note Must specify only one read method for readable registers
 	 * @note Must specify only one write method for writable registers
 	 */
+#if MBCFG_COMPACT_REGS
+	uint8_t access;
+
+	/**
+	 * @brief Index of the callbacks of this register in mbreg_policies
+	 *
+	 * @note Can be left as 0 (No callbacks)
+	 */
+	uint8_t policy;
+
+	/**
+	 * @brief Number of elements in block registers, see the full descriptor
+	 */
+	uint16_t n_block_entries;
+#else
 	enum mbreg_access_e access;
+#endif
 
 	/**
 	 * @brief Read access configuration
@@ -160,6 +246,7 @@ struct mbreg_desc_s {
 	 * @note For MRACC_R_VAL: Use value members (u8, u16, u32, etc.)
 	 * @note For MRACC_R_PTR: Use pointer members (pu8, pu16, pu32, etc.)
 	 * @note For MRACC_R_FN: Use function members (fu8, fu16, fu32, etc.)
+	 * @note For MRACC_R_BULK: Use bulk member
 	 */
 	union {
 		uint8_t u8;
@@ -192,6 +279,19 @@ struct mbreg_desc_s {
 		int64_t (*fi64)(void);
 		float (*ff32)(void);
 		double (*ff64)(void);
+
+		/**
+		 * @brief Bulk read callback
+		 *
+		 * Called to read n consecutive 16-bit registers starting at addr into
+		 * buf as big-endian protocol data (2*n bytes). Adjacent descriptors
+		 * sharing the same callback are merged into one call.
+		 *
+		 * @note The type field only defines the number of addresses covered,
+		 *       the callback owns the data representation (No word swapping)
+		 * @note Any status other than MB_OK fails the request with MB_DEV_FAIL
+		 */
+		enum mbstatus_e (*bulk)(uint16_t addr, size_t n, uint8_t *buf);
 	} read;
 
 	/**
@@ -202,6 +302,13 @@ struct mbreg_desc_s {
 	 *
 	 * @note For MRACC_W_PTR: Use pointer members (pu8, pu16, pu32, etc.)
 	 * @note For MRACC_W_FN: Use function members (fu8, fu16, fu32, etc.)
+	 * @note For MRACC_W_BULK: Use bulk member
+	 * @note Write callbacks may return MB_PENDING to defer the response, see mbpdu_complete().
+	 *       One callback per request may defer, a second one ends the request with
+	 *       MB_DEV_FAIL. If a later write fails the request ends with its exception
+	 *       and nothing is pending, mbpdu_complete() then returns 0 and the deferred
+	 *       operation shall be dropped. The write part of function code 0x17 cannot
+	 *       defer, as its response holds the registers read afterwards (MB_DEV_FAIL).
 	 */
 	union {
 		volatile uint8_t *pu8;
@@ -224,8 +331,21 @@ struct mbreg_desc_s {
 		enum mbstatus_e (*fi64)(int64_t);
 		enum mbstatus_e (*ff32)(float);
 		enum mbstatus_e (*ff64)(double);
+
+		/**
+		 * @brief Bulk write callback
+		 *
+		 * Called to write n consecutive 16-bit registers starting at addr from
+		 * buf as big-endian protocol data (2*n bytes). Adjacent descriptors
+		 * sharing the same callback and without post_write_cb are merged into
+		 * one call.
+		 *
+		 * @return Modbus status code, returned to the client on failure
+		 */
+		enum mbstatus_e (*bulk)(uint16_t addr, size_t n, const uint8_t *buf);
 	} write;
 
+#if !MBCFG_COMPACT_REGS
 	/**
 	 * @brief Dynamic read lock callback
 	 *
@@ -302,6 +422,7 @@ struct mbreg_desc_s {
 	 * @note Should not perform time-consuming operations
 	 */
 	void (*post_write_cb)(void);
+#endif
 };
 
 /** @brief Only for internal use */
@@ -309,6 +430,13 @@ struct mbreg_desc_s {
 #define MBREG_READ_LOCKED (SIZE_MAX-1u) /* Register is locked */
 #define MBREG_READ_DEV_FAIL SIZE_MAX /* Invalid coil descriptor configuration */
 
+/** @brief Only for internal use, callback of a descriptor or of its policy */
+#if MBCFG_COMPACT_REGS
+#define MBREG_CB(reg, cb) (mbreg_policies[(reg)->policy].cb)
+#else
+#define MBREG_CB(reg, cb) ((reg)->cb)
+#endif
+
 /**
  * @brief Get size of Modbus register in bytes
  *
@@ -346,6 +474,342 @@ extern const struct mbreg_desc_s *mbreg_find_desc(
 	size_t n_regs,
 	uint16_t addr);
 
+/**
+ * @brief Check a register map in one pass
+ *
+ * Checks what mbtest_regs_validate_all() checks: ascending addresses without
+ * overlap (blocks included), one valid type, one access method per direction
+ * with its pointer or callback set, and pointer or bulk access for blocks.
+ *
+ * @param regs Array of register descriptors
+ * @param n_regs Number of entries in the regs array
+ * @param issue_addr Out parameter with the address of the first invalid descriptor (Can be NULL)
+ *
+ * @retval 1 Valid (or empty) map
+ * @retval 0 Invalid descriptor at issue_addr
+ *
+ * @note Time complexity: O(n_regs)
+ */
+extern int mbreg_validate(
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t *issue_addr);
+
+/**
+ * @brief Precompiled address index for a register map
+ *
+ * One of three layouts, built once into caller supplied storage so no heap is used:
+ *
+ * - Dense (mbreg_index_build()): Lookup table mapping every address in
+ *   [base, base+n_slots) to the descriptor containing it. Lookups have constant
+ *   cost regardless of the size of the register map.
+ * - Ranges (mbreg_index_build_ranges()): Sorted arrays of the first and last
+ *   address of each descriptor, parallel to the descriptor array. Lookups
+ *   binary search 2 bytes per descriptor instead of whole descriptors, so the
+ *   search stays in cache for large maps with sparse addresses.
+ * - Paged (mbreg_index_build_paged()): Two-level page table, see mbpage_s.
+ *   Lookups have constant cost like dense indices, storage grows with the
+ *   pages of 256 addresses holding descriptors instead of the address span.
+ *
+ * @note The index must be rebuilt if the register map it was built for changes
+ * @note Dense storage requirement is one uint16_t per address between the first
+ *       and the last address of the map, see mbreg_index_span()
+ * @note Range storage requirement is two uint16_t per descriptor, see MBREG_RANGE_INDEX_SIZE()
+ * @note Paged storage requirement is 256 uint16_t per populated page plus 512, see mbreg_index_paged_size()
+ */
+struct mbreg_index_s {
+	const struct mbreg_desc_s *regs; /**< Register map the index was built for */
+	size_t n_regs; /**< Number of descriptors in regs */
+	uint16_t base; /**< First address covered by the index */
+	size_t n_slots; /**< Number of addresses covered by the index */
+	const uint16_t *slots; /**< Dense only: Descriptor position+1 for each address, 0 if the address is not mapped */
+	const uint16_t *starts; /**< Ranges only: First address of each descriptor */
+	const uint16_t *lasts; /**< Ranges only: Last address of each descriptor */
+	struct mbpage_s pages; /**< Paged only: Page table of descriptor positions */
+};
+
+/**
+ * @brief Number of uint16_t storage entries required by mbreg_index_build_ranges()
+ */
+#define MBREG_RANGE_INDEX_SIZE(n_regs) (2u*(n_regs))
+
+/**
+ * @brief Get number of index slots required to index a register map
+ *
+ * @param regs Array of register descriptors (must be sorted in ascending address order)
+ * @param n_regs Number of entries in the regs array
+ *
+ * @return Number of uint16_t storage entries required by mbreg_index_build(), 0 for an empty map
+ */
+extern size_t mbreg_index_span(
+	const struct mbreg_desc_s *regs,
+	size_t n_regs);
+
+/**
+ * @brief Build a precompiled address index for a register map
+ *
+ * @param ix Index to initialize
+ * @param regs Array of register descriptors (must be sorted in ascending address order)
+ * @param n_regs Number of entries in the regs array
+ * @param storage Caller supplied storage for the index slots
+ * @param storage_len Number of entries in storage
+ *
+ * @retval 1 Index built
+ * @retval 0 Index could not be built (Too little storage, unsorted/overlapping map etc.)
+ *
+ * @note On failure the index is left empty and lookups fall back to mbreg_find_desc()
+ * @note Time complexity: O(n_slots)
+ */
+extern int mbreg_index_build(
+	struct mbreg_index_s *ix,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t *storage,
+	size_t storage_len);
+
+/**
+ * @brief Build a range index for a register map
+ *
+ * Converts the register map to sorted start and last address arrays searched
+ * by mbreg_index_find(), the descriptors themselves are only read on a match.
+ *
+ * @param ix Index to initialize
+ * @param regs Array of register descriptors (must be sorted in ascending address order)
+ * @param n_regs Number of entries in the regs array
+ * @param storage Caller supplied storage of MBREG_RANGE_INDEX_SIZE(n_regs) entries
+ * @param storage_len Number of entries in storage
+ *
+ * @retval 1 Index built
+ * @retval 0 Index could not be built (Too little storage, unsorted/overlapping map etc.)
+ *
+ * @note On failure the index is left empty and lookups fall back to mbreg_find_desc()
+ * @note Time complexity: O(n_regs). Lookups: O(log n_regs)
+ */
+extern int mbreg_index_build_ranges(
+	struct mbreg_index_s *ix,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t *storage,
+	size_t storage_len);
+
+/**
+ * @brief Get number of storage entries required by mbreg_index_build_paged()
+ *
+ * @param regs Array of register descriptors (must be sorted in ascending address order)
+ * @param n_regs Number of entries in the regs array
+ *
+ * @return Number of uint16_t storage entries, 0 for an unsorted or overlapping map
+ */
+extern size_t mbreg_index_paged_size(
+	const struct mbreg_desc_s *regs,
+	size_t n_regs);
+
+/**
+ * @brief Build a paged index for a register map
+ *
+ * Suited for sparse maps over a large part of the address space, where a
+ * dense index would be mostly empty.
+ *
+ * @param ix Index to initialize
+ * @param regs Array of register descriptors (must be sorted in ascending address order)
+ * @param n_regs Number of entries in the regs array
+ * @param storage Caller supplied storage of mbreg_index_paged_size() entries
+ * @param storage_len Number of entries in storage
+ *
+ * @retval 1 Index built
+ * @retval 0 Index could not be built (Too little storage, unsorted/overlapping map etc.)
+ *
+ * @note On failure the index is left empty and lookups fall back to mbreg_find_desc()
+ * @note Time complexity: O(n_regs + mapped addresses). Lookups: O(1)
+ */
+extern int mbreg_index_build_paged(
+	struct mbreg_index_s *ix,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t *storage,
+	size_t storage_len);
+
+/**
+ * @brief Finds a Modbus register descriptor by address using an index if available
+ *
+ * Uses the index for a constant time lookup when it was built for the given
+ * register map, otherwise falls back to mbreg_find_desc().
+ *
+ * @param ix Index for the register map (Can be NULL)
+ * @param regs Array of register descriptors (must be sorted in ascending address order)
+ * @param n_regs Number of entries in the regs array
+ * @param addr Modbus address to search for
+ *
+ * @return Pointer to the register descriptor containing the address, or NULL if not found
+ */
+extern const struct mbreg_desc_s *mbreg_index_find(
+	const struct mbreg_index_s *ix,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t addr);
+
+/**
+ * @brief Cursor for walking a register map in ascending address order
+ *
+ * Multi-register requests cover a contiguous address range of a sorted map.
+ * The cursor locates the start descriptor once and then only moves forward
+ * through the map, making a walk over n addresses O(log n_regs + n).
+ *
+ * @note Shall not be accessed by client code directly
+ */
+struct mbreg_cursor_s {
+	const struct mbreg_desc_s *regs; /**< Register map being walked */
+	size_t n_regs; /**< Number of descriptors in regs */
+	size_t pos; /**< Position of first descriptor not ending before the last looked up address */
+};
+
+/**
+ * @brief Position a cursor at the given start address
+ *
+ * @param cur Cursor to initialize
+ * @param ix Index for the register map (Can be NULL)
+ * @param regs Array of register descriptors (must be sorted in ascending address order)
+ * @param n_regs Number of entries in the regs array
+ * @param addr First address that will be looked up
+ */
+extern void mbreg_cursor_init(
+	struct mbreg_cursor_s *cur,
+	const struct mbreg_index_s *ix,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	uint16_t addr);
+
+/**
+ * @brief Find the register descriptor containing an address using a cursor
+ *
+ * @param cur Cursor positioned with mbreg_cursor_init()
+ * @param addr Modbus address to look up
+ *
+ * @return Pointer to the register descriptor containing the address, or NULL if not found
+ *
+ * @note Addresses must be looked up in non-decreasing order
+ * @note Amortized time complexity: O(1)
+ */
+extern const struct mbreg_desc_s *mbreg_cursor_find(
+	struct mbreg_cursor_s *cur,
+	uint16_t addr);
+
+enum {
+	MBREG_MEMO_N_LOCKS = 8u, /**< Distinct lock callbacks remembered per request */
+	MBREG_MEMO_N_VALS = 8u, /**< Function register values remembered per request */
+};
+
+/**
+ * @brief Value of a function register kept across requests
+ *
+ * @note Shall not be accessed by client code directly
+ */
+struct mbreg_fn_cache_entry_s {
+	const struct mbreg_desc_s *reg; /**< Descriptor read, NULL if the entry is empty */
+	uint64_t stored_at; /**< Time stored, in clock_cb units */
+	uint8_t val[MRTYPE_SIZE_MAX/8]; /**< Value, big-endian */
+};
+
+/**
+ * @brief Function register values of one instance
+ *
+ * Attached to an instance through mbinst_s::fn_cache. Values of non-block
+ * MRACC_R_FN registers are kept for max_age_ticks, so expensive derived
+ * values read by several requests (E.g. the two halves of an MRTYPE_F64 read
+ * separately) are computed once per poll. A full cache replaces its entries
+ * in round robin order, write requests drop all entries.
+ *
+ * @note Configuration fields are set by the application, the remaining
+ *       fields are state cleared by mbreg_fn_cache_init()
+ * @note Not used for maps read with a sequence lock (mbinst_s::hold_regs_lock)
+ * @note Not thread safe, see mbinst_init_worker()
+ */
+struct mbreg_fn_cache_s {
+	struct mbreg_fn_cache_entry_s *entries; /**< Caller supplied storage */
+	size_t n_entries; /**< Number of entries */
+
+	/**
+	 * @brief Monotonic clock used for the maximum age
+	 *
+	 * @note Can be left as NULL, values then live until invalidated or a write request
+	 */
+	uint64_t (*clock_cb)(void);
+
+	uint64_t max_age_ticks; /**< Drop values older than this, 0 to disable */
+
+	size_t next; /**< Entry replaced by the next store */
+	uint32_t n_hits; /**< Function reads answered from the cache */
+	uint32_t n_misses; /**< Function callbacks called */
+};
+
+/**
+ * @brief Empty the cache, the configuration is kept
+ *
+ * @param cache Cache to initialize (entries and n_entries set)
+ */
+extern void mbreg_fn_cache_init(struct mbreg_fn_cache_s *cache);
+
+/**
+ * @brief Drop all cached values, e.g. after the application changed what its read functions return
+ *
+ * @param cache Cache (Can be NULL)
+ */
+extern void mbreg_fn_cache_invalidate(struct mbreg_fn_cache_s *cache);
+
+/**
+ * @brief Lock callback and function register results of one request
+ *
+ * Maps often share one lock function between many descriptors (E.g. a
+ * calibration mode flag). A memo lives for one request, on the stack of the
+ * request handler, and calls each distinct rlock_cb/wlock_cb once, later
+ * descriptors with the same callback reuse the result. Callbacks beyond
+ * MBREG_MEMO_N_LOCKS are called each time.
+ *
+ * The read function of a non-block MRACC_R_FN register is also called once
+ * per memo, reads of the same descriptor (E.g. partial reads, file record
+ * sub-requests) reuse the value. Registers beyond MBREG_MEMO_N_VALS are
+ * read each time, or from fn_cache.
+ *
+ * @note wlock_override_cb is not remembered, it is called for every locked register
+ * @note Shall not be accessed by client code directly
+ */
+struct mbreg_memo_s {
+	int (*lock_cb[MBREG_MEMO_N_LOCKS])(void); /**< Lock callbacks called so far */
+	uint8_t locked[MBREG_MEMO_N_LOCKS]; /**< Result of each callback */
+	size_t n_locks; /**< Number of remembered callbacks */
+
+	const struct mbreg_desc_s *val_reg[MBREG_MEMO_N_VALS]; /**< Function registers read so far */
+	uint8_t val[MBREG_MEMO_N_VALS][MRTYPE_SIZE_MAX/8]; /**< Value of each register, big-endian */
+	size_t n_vals; /**< Number of remembered values */
+
+	struct mbreg_fn_cache_s *fn_cache; /**< Values kept across requests (Can be NULL) */
+};
+
+/**
+ * @brief Start a new request with an empty memo
+ *
+ * @param memo Memo to clear, fn_cache is set to NULL
+ */
+extern void mbreg_memo_init(struct mbreg_memo_s *memo);
+
+/**
+ * @brief Forget the function register values of a memo, e.g. before a retried snapshot
+ *
+ * @param memo Memo (Can be NULL)
+ */
+extern void mbreg_memo_drop_vals(struct mbreg_memo_s *memo);
+
+/**
+ * @brief Result of a lock callback, called at most once per memo
+ *
+ * @param memo Memo of the current request (Can be NULL, lock_cb is then always called)
+ * @param lock_cb rlock_cb or wlock_cb of a descriptor (Can be NULL)
+ *
+ * @retval 1 Locked
+ * @retval 0 Not locked, or no lock callback
+ */
+extern int mbreg_memo_locked(struct mbreg_memo_s *memo, int (*lock_cb)(void));
+
 /**
  * @brief Read the value of a Modbus register
  *
@@ -357,6 +821,7 @@ extern const struct mbreg_desc_s *mbreg_find_desc(
  * @param n_remaining_regs Maximum number of 16-bit words to read
  * @param res Pointer to buffer where read data will be stored (big-endian). If NULL, dry run (Check read allowed)
  * @param swap_words If non-zero, swaps word order for multi-word values (U32, U64, F32, F64)
+ *                   of registers left as MBREG_ORDER_DEFAULT
  *
  * @retval Number of 16-bit words actually read
  * @retval MBREG_READ_NO_ACCESS (0) No read access method (Ignored when reading)
@@ -374,6 +839,50 @@ extern size_t mbreg_read(
 	uint8_t *res,
 	int swap_words);
 
+/**
+ * @brief Read the value of a Modbus register, with the lock results of the current request
+ *
+ * Same as mbreg_read(), the read lock is taken from memo.
+ *
+ * @param memo Memo of the current request (Can be NULL)
+ */
+extern size_t mbreg_read_memo(
+	struct mbreg_memo_s *memo,
+	const struct mbreg_desc_s *reg,
+	uint16_t addr,
+	size_t n_remaining_regs,
+	uint8_t *res,
+	int swap_words);
+
+/**
+ * @brief Read a run of bulk registers with one callback invocation
+ *
+ * Starting at the descriptor containing addr, merges following adjacent
+ * descriptors using the same bulk read callback and calls it once for the
+ * whole run (At most n_max registers). Read locks of merged descriptors are
+ * checked, a locked descriptor ends the run.
+ *
+ * @param memo Memo of the current request (Can be NULL)
+ * @param reg Descriptor containing addr, with MRACC_R_BULK access
+ * @param n_next Number of descriptors following reg in its register map
+ * @param addr First address to read
+ * @param n_max Maximum number of 16-bit registers to read
+ * @param res Buffer for big-endian data. If NULL, dry run (Check read allowed)
+ *
+ * @retval Number of 16-bit registers read
+ * @retval MBREG_READ_LOCKED (SIZE_MAX-1) Register locked
+ * @retval MBREG_READ_DEV_FAIL (SIZE_MAX) Device fault
+ *
+ * @note Library internal function
+ */
+extern size_t mbreg_read_bulk_run(
+	struct mbreg_memo_s *memo,
+	const struct mbreg_desc_s *reg,
+	size_t n_next,
+	uint16_t addr,
+	size_t n_max,
+	uint8_t *res);
+
 /**
  * @brief Check if a Modbus register can be written to
  *
@@ -400,6 +909,21 @@ extern size_t mbreg_write_allowed(
 	size_t n_remaining_regs,
 	const uint8_t *val);
 
+/**
+ * @brief Check if a Modbus register can be written to, with the lock results of the current request
+ *
+ * Same as mbreg_write_allowed(), the write lock is taken from memo.
+ *
+ * @param memo Memo of the current request (Can be NULL)
+ */
+extern size_t mbreg_write_allowed_memo(
+	struct mbreg_memo_s *memo,
+	const struct mbreg_desc_s *reg,
+	uint16_t addr,
+	uint16_t start_addr,
+	size_t n_remaining_regs,
+	const uint8_t *val);
+
 /**
  * @brief Write to a Modbus register
  *
@@ -427,6 +951,108 @@ extern enum mbstatus_e mbreg_write(
 	const uint8_t *val,
 	size_t *n_written);
 
+/**
+ * @brief Write a run of bulk registers with one callback invocation
+ *
+ * Counterpart to mbreg_read_bulk_run(). Descriptors after the first are only
+ * merged if they have no post_write_cb.
+ *
+ * @param reg Descriptor containing addr, with MRACC_W_BULK access
+ * @param n_next Number of descriptors following reg in its register map
+ * @param addr First address to write
+ * @param n_max Maximum number of 16-bit registers to write
+ * @param val Big-endian data to write
+ * @param n_written Out parameter with number of 16-bit registers written
+ *
+ * @return Modbus status code
+ *
+ * @warning This function does not check write permissions - call mbreg_write_allowed() first
+ * @note Library internal function
+ */
+extern enum mbstatus_e mbreg_write_bulk_run(
+	const struct mbreg_desc_s *reg,
+	size_t n_next,
+	uint16_t addr,
+	size_t n_max,
+	const uint8_t *val,
+	size_t *n_written);
+
+/**
+ * @brief Read and write kernels of one descriptor, resolved by mbreg_kernels_build()
+ *
+ * A kernel moves one whole register between its source and the big-endian
+ * request/response data, specialized for the type, access method and word order
+ * of the descriptor, so reads and writes take one indirect call instead of the
+ * switches on type and access. Kept in a table parallel to the register map and
+ * attached through mbinst_s::hold_regs_kern or mbinst_s::input_regs_kern.
+ *
+ * @note Blocks, bulk callbacks and partial register accesses have no kernel
+ *       and are handled by mbreg_read() and mbreg_write()
+ */
+struct mbreg_kernel_s {
+	void (*read)(const struct mbreg_desc_s *reg, uint8_t *res); /**< Read the whole register, NULL if none */
+	enum mbstatus_e (*write)(const struct mbreg_desc_s *reg, const uint8_t *val); /**< Write the whole register, NULL if none */
+	uint8_t n_words; /**< Size of the register in 16-bit words */
+	uint8_t swap_words; /**< Whether read swaps the word order of 32 and 64-bit registers */
+};
+
+/**
+ * @brief Resolve the kernels of a register map
+ *
+ * @param kernels Table of n_regs entries, kernels[i] is resolved for regs[i]
+ * @param regs Array of register descriptors
+ * @param n_regs Number of entries in the regs array
+ * @param swap_words Word order the reads are done with: mbinst_s::swap_words for
+ *        input registers, 0 for holding registers
+ *
+ * @note The table must be rebuilt if the register map it was built for changes
+ */
+extern void mbreg_kernels_build(
+	struct mbreg_kernel_s *kernels,
+	const struct mbreg_desc_s *regs,
+	size_t n_regs,
+	int swap_words);
+
+/**
+ * @brief Read a Modbus register through its kernel
+ *
+ * Same as mbreg_read(), a whole register with a kernel read for the same word
+ * order is read with one call, everything else is passed on to mbreg_read().
+ * Function registers are passed on as well while memo has a fn_cache.
+ *
+ * @param memo Memo of the current request (Can be NULL)
+ * @param kernel Kernel of reg (Can be NULL)
+ *
+ * @note Library internal function, see mbreg_read() for the other parameters and return values
+ */
+extern size_t mbreg_read_kernel(
+	struct mbreg_memo_s *memo,
+	const struct mbreg_kernel_s *kernel,
+	const struct mbreg_desc_s *reg,
+	uint16_t addr,
+	size_t n_remaining_regs,
+	uint8_t *res,
+	int swap_words);
+
+/**
+ * @brief Write a Modbus register through its kernel
+ *
+ * Same as mbreg_write(), a whole register with a kernel write is written with
+ * one call, everything else is passed on to mbreg_write().
+ *
+ * @param kernel Kernel of reg (Can be NULL)
+ *
+ * @warning This function does not check write permissions - call mbreg_write_allowed() first
+ * @note Library internal function, see mbreg_write() for the other parameters
+ */
+extern enum mbstatus_e mbreg_write_kernel(
+	const struct mbreg_kernel_s *kernel,
+	const struct mbreg_desc_s *reg,
+	uint16_t addr,
+	size_t n_remaining_regs,
+	const uint8_t *val,
+	size_t *n_written);
+
 /**
  * @brief Write masked Modbus register
  *
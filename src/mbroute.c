@@ -0,0 +1,201 @@
+/**
+ * @file mbroute.c
+ * @brief Modbus Router - Multiple slaves on one transport
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbroute.h"
+#include "endian.h"
+#include "mbadu.h"
+#include "mbadu_ascii.h"
+#include "mbadu_tcp.h"
+#include "mbconfig.h"
+#include "mbcrc.h"
+#include "mbdef.h"
+#include "mbinst.h"
+#include "mbpdu.h"
+#include "mbrtu_rx.h"
+#include <stddef.h>
+#include <stdint.h>
+
+extern void mbroute_init(struct mbroute_s *route)
+{
+	size_t i;
+
+	if (route==NULL) return;
+
+	for (i=0u; i<MBROUTE_N_ADDRS; ++i) {
+		route->insts[i] = NULL;
+	}
+	route->n_addrs = 0u;
+}
+
+extern int mbroute_set(struct mbroute_s *route, uint8_t addr, struct mbinst_s *inst)
+{
+	size_t i;
+
+	if (route==NULL) return 0;
+
+	if ((route->insts[addr]==NULL) && (inst!=NULL)) {
+		route->addrs[route->n_addrs++] = addr;
+	} else if ((route->insts[addr]!=NULL) && (inst==NULL)) {
+		for (i=0u; route->addrs[i]!=addr; ++i) {}
+		route->addrs[i] = route->addrs[--route->n_addrs];
+	}
+	route->insts[addr] = inst;
+
+	return 1;
+}
+
+extern struct mbinst_s *mbroute_get(const struct mbroute_s *route, uint8_t addr)
+{
+	return (route!=NULL) ? route->insts[addr] : NULL;
+}
+
+/**
+ * @brief Hand an RTU frame with a known CRC to the routed instances
+ */
+static size_t route_rtu(
+	const struct mbroute_s *route,
+	const uint8_t *req,
+	size_t req_len,
+	uint16_t crc,
+	uint8_t *res)
+{
+	struct mbinst_s *inst;
+	size_t i;
+
+	if ((req[0]==MBADU_ADDR_BROADCAST) && (crc==0u)) {
+		for (i=0u; i<route->n_addrs; ++i) {
+			(void)mbadu_handle_req_crc(route->insts[route->addrs[i]], req, req_len, crc, res);
+		}
+		return 0u;
+	}
+
+	inst = route->insts[req[0]];
+	if (inst==NULL) return 0u;
+
+	return mbadu_handle_req_crc(inst, req, req_len, crc, res);
+}
+
+extern size_t mbroute_handle_req(
+	const struct mbroute_s *route,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *res)
+{
+	if ((route==NULL) || (req==NULL) || (res==NULL)) return 0u;
+	if ((req_len<MBADU_SIZE_MIN) || (req_len>MBADU_SIZE_MAX)) return 0u;
+
+	/* The CRC of a frame including its own CRC is zero when intact */
+	return route_rtu(route, req, req_len, mbcrc16(req, req_len), res);
+}
+
+extern size_t mbroute_rtu_rx_handle(
+	const struct mbroute_s *route,
+	struct mbrtu_rx_s *rx,
+	uint8_t *res)
+{
+	size_t res_len = 0u;
+
+	if ((rx==NULL) || (rx->state!=MBRTU_RX_READY)) return 0u;
+
+	if ((route!=NULL) && (res!=NULL) && (rx->len>=MBADU_SIZE_MIN)) {
+		res_len = route_rtu(route, rx->buf, rx->len, mbcrc16_final(rx->crc), res);
+	}
+
+	rx->state = MBRTU_RX_IDLE;
+	rx->len = 0u;
+
+	return res_len;
+}
+
+#if MBCFG_ASCII
+extern size_t mbroute_ascii_handle_req(
+	const struct mbroute_s *route,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *res)
+{
+	struct mbinst_s *inst;
+	uint8_t addr;
+	size_t i;
+
+	if ((route==NULL) || (req==NULL) || (res==NULL)) return 0u;
+	if ((req_len<MBADU_ASCII_SIZE_MIN) || (req_len>MBADU_ASCII_SIZE_MAX)) return 0u;
+	if ((req[0]!=MBADU_ASCII_START_CHAR) || !mbadu_ascii_hex_byte(req+1u, &addr)) return 0u;
+
+	if (addr==MBADU_ADDR_BROADCAST) {
+		for (i=0u; i<route->n_addrs; ++i) {
+			(void)mbadu_ascii_handle_req(route->insts[route->addrs[i]], req, req_len, res);
+		}
+		return 0u;
+	}
+
+	inst = route->insts[addr];
+	if (inst==NULL) return 0u;
+
+	return mbadu_ascii_handle_req(inst, req, req_len, res);
+}
+#endif /* MBCFG_ASCII */
+
+extern size_t mbroute_tcp_handle_req(
+	const struct mbroute_s *route,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *res)
+{
+	struct mbinst_s *inst;
+	uint16_t length;
+
+	if ((route==NULL) || (req==NULL) || (res==NULL)) return 0u;
+	if ((req_len<MBADU_TCP_SIZE_MIN) || (req_len>MBADU_TCP_SIZE_MAX)) return 0u;
+
+	inst = route->insts[req[MBAP_POS_UNIT_ID]];
+	if (inst!=NULL) {
+		return mbadu_tcp_handle_req(inst, req, req_len, res);
+	}
+
+	/* No route, answer like a gateway if the request is well formed */
+	length = betou16(req + MBAP_POS_LEN);
+	if ((betou16(req + MBAP_POS_PROT_ID) != MBADU_TCP_PROT_ID)
+			|| (length < 2u)
+			|| ((length-1u) > MBPDU_SIZE_MAX)
+			|| (req_len < (length-1u+MBAP_SIZE))) {
+		return 0u;
+	}
+
+	res[MBAP_POS_TRANS_ID] = req[MBAP_POS_TRANS_ID];
+	res[MBAP_POS_TRANS_ID+1u] = req[MBAP_POS_TRANS_ID+1u];
+	u16tobe(MBADU_TCP_PROT_ID, res + MBAP_POS_PROT_ID);
+	u16tobe(3u, res + MBAP_POS_LEN);
+	res[MBAP_POS_UNIT_ID] = req[MBAP_POS_UNIT_ID];
+	res[MBAP_SIZE] = (uint8_t)(req[MBAP_SIZE] | MB_ERR_FLG);
+	res[MBAP_SIZE+1u] = (uint8_t)MB_GW_PATH_UNAVAIL;
+
+	return MBAP_SIZE + 2u;
+}
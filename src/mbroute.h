@@ -0,0 +1,174 @@
+/**
+ * @file mbroute.h
+ * @brief Modbus Router - Multiple slaves on one transport
+ * @author Jonas Almås
+ *
+ * @details Routes the requests of one transport to one of many slave instances
+ * by slave address (serial) or unit id (TCP), through a 256 entry table. The
+ * frame is checked once (CRC) and handled by the addressed instance only, so the
+ * cost per frame does not grow with the number of hosted slaves. Serial broadcasts
+ * are handed to every routed instance.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+#ifndef MBROUTE_H_INCLUDED
+#define MBROUTE_H_INCLUDED
+
+#include "mbinst.h"
+#include "mbrtu_rx.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Number of slave addresses / unit ids */
+enum {MBROUTE_N_ADDRS=256u};
+
+/**
+ * @brief Routing table of one transport
+ *
+ * @note Initialize with mbroute_init() and add instances with mbroute_set()
+ * @note Shall not be accessed by client code directly
+ */
+struct mbroute_s {
+	struct mbinst_s *insts[MBROUTE_N_ADDRS]; /**< Instance by slave address / unit id, NULL if not routed */
+	uint8_t addrs[MBROUTE_N_ADDRS]; /**< Routed addresses, for broadcast fan-out */
+	size_t n_addrs; /**< Number of valid entries in addrs */
+};
+
+/**
+ * @brief Initialize a routing table with no routes
+ *
+ * @param route Routing table to initialize
+ */
+extern void mbroute_init(struct mbroute_s *route);
+
+/**
+ * @brief Route a slave address / unit id to an instance
+ *
+ * @param route Routing table
+ * @param addr Slave address (serial) or unit id (TCP)
+ * @param inst Initialized instance, NULL to remove the route
+ *
+ * @retval 1 Route updated
+ * @retval 0 route is NULL
+ *
+ * @note For serial transports addr must equal inst->serial.slave_addr, as the
+ *       instance still checks the address of the frame it is handed. A route at
+ *       the broadcast address (0) is only used for TCP unit id 0
+ * @note Route each instance at one address only, broadcasts are handed to every route
+ */
+extern int mbroute_set(struct mbroute_s *route, uint8_t addr, struct mbinst_s *inst);
+
+/**
+ * @brief Get the instance routed at an address
+ *
+ * @param route Routing table
+ * @param addr Slave address (serial) or unit id (TCP)
+ *
+ * @return Routed instance, or NULL if addr is not routed
+ */
+extern struct mbinst_s *mbroute_get(const struct mbroute_s *route, uint8_t addr);
+
+/**
+ * @brief Handle a Modbus RTU request for any routed slave
+ *
+ * Computes the CRC once and hands the frame to the instance routed at its
+ * slave address, see mbadu_handle_req(). Broadcasts are handled by every routed
+ * instance and never get a response.
+ *
+ * @param route Routing table
+ * @param req Pointer to RTU request ADU data
+ * @param req_len Length of RTU request ADU in bytes
+ * @param res Pointer to response buffer (must be at least MBADU_SIZE_MAX bytes)
+ *
+ * @return Size of response ADU in bytes, or 0 if no response should be sent
+ *
+ * @note Frames with a CRC error are counted by the instance routed at their
+ *       (possibly corrupt) slave address only
+ */
+extern size_t mbroute_handle_req(
+	const struct mbroute_s *route,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *res);
+
+/**
+ * @brief Handle the frame of an RTU receiver for any routed slave
+ *
+ * Same as mbroute_handle_req() for a frame completed by mbrtu_rx_s, using the
+ * CRC accumulated while receiving, so a port hosting several slaves is
+ * handled like mbrtu_rx_handle() handles a single one.
+ *
+ * @param route Routing table
+ * @param rx Receiver with a frame ready, made ready for the next frame
+ * @param res Pointer to response buffer (must be at least MBADU_SIZE_MAX bytes)
+ *
+ * @return Size of response ADU in bytes, or 0 if no response should be sent (or no frame is ready)
+ */
+extern size_t mbroute_rtu_rx_handle(
+	const struct mbroute_s *route,
+	struct mbrtu_rx_s *rx,
+	uint8_t *res);
+
+/**
+ * @brief Handle a Modbus ASCII request for any routed slave
+ *
+ * Decodes the slave address and hands the frame to the instance routed at it,
+ * which checks the LRC, see mbadu_ascii_handle_req(). Broadcasts are handled by
+ * every routed instance and never get a response.
+ *
+ * @param route Routing table
+ * @param req Pointer to ASCII request ADU data
+ * @param req_len Length of ASCII request ADU in bytes
+ * @param res Pointer to response buffer (must be at least MBADU_ASCII_SIZE_MAX bytes)
+ *
+ * @return Size of response ADU in bytes, or 0 if no response should be sent
+ */
+extern size_t mbroute_ascii_handle_req(
+	const struct mbroute_s *route,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *res);
+
+/**
+ * @brief Handle a Modbus TCP/IP request for any routed unit id
+ *
+ * Hands the request to the instance routed at the MBAP unit id, see
+ * mbadu_tcp_handle_req(). Requests for unit ids without a route get an
+ * MB_GW_PATH_UNAVAIL exception response, as from a gateway.
+ *
+ * @param route Routing table
+ * @param req Pointer to TCP request ADU data
+ * @param req_len Length of TCP request ADU in bytes
+ * @param res Pointer to response buffer (must be at least MBADU_TCP_SIZE_MAX bytes)
+ *
+ * @return Size of response ADU in bytes, or 0 if no response should be sent
+ */
+extern size_t mbroute_tcp_handle_req(
+	const struct mbroute_s *route,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *res);
+
+#endif /* MBROUTE_H_INCLUDED */
@@ -0,0 +1,177 @@
+/**
+ * @file mbrtu_rx.c
+ * @brief Modbus RTU Receiver - Frame detection state machine
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbrtu_rx.h"
+#include "mbadu.h"
+#include "mbcrc.h"
+#include "mbinst.h"
+#include "mbsupp.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {
+	MICRO=1000000u, /* Seconds to microseconds */
+	BITS_IN_CHAR=11u, /* 1 start + 8 data + 1 parity + 1 stop */
+	MIN_T15_US=750u, /* Fixed t1.5 above 19200 baud */
+};
+
+extern void mbrtu_rx_init(struct mbrtu_rx_s *rx, uint32_t baud)
+{
+	uint32_t t15_us;
+
+	if (rx==NULL) return;
+
+	if (baud==0u) baud = 1u;
+	t15_us = (MICRO * BITS_IN_CHAR * 3u / 2u) / baud;
+
+	rx->len = 0u;
+	rx->expected_len = 0u;
+	rx->crc = mbcrc16_init();
+	rx->state = MBRTU_RX_IDLE;
+	rx->wait_silence = 0u;
+	rx->char_us = (MICRO * BITS_IN_CHAR) / baud;
+	rx->t15_us = (t15_us > MIN_T15_US) ? t15_us : MIN_T15_US;
+	rx->t35_us = mbsupp_break_us(baud);
+	rx->last_us = 0u;
+	rx->n_overruns = 0u;
+	rx->n_gap_errors = 0u;
+}
+
+/**
+ * @brief Silence before the first of n bytes whose last byte arrived at now_us
+ */
+static uint32_t silence_before(const struct mbrtu_rx_s *rx, size_t n, uint32_t now_us)
+{
+	uint32_t gap = now_us - rx->last_us;
+	uint32_t span;
+
+	/* The bytes of a chunk took time to arrive */
+	span = (n > 1u) ? (uint32_t)((n-1u) * rx->char_us) : 0u;
+	return (gap > span) ? (gap - span) : 0u;
+}
+
+extern int mbrtu_rx_recv(struct mbrtu_rx_s *rx, const uint8_t *data, size_t n, uint32_t now_us)
+{
+	uint32_t gap;
+
+	if ((rx==NULL) || (data==NULL) || (n==0u)) return 0;
+
+	gap = silence_before(rx, n, now_us);
+	rx->last_us = now_us;
+
+	if (rx->state==MBRTU_RX_READY) return 1; /* Dropped */
+
+	if (gap >= rx->t35_us) {
+		/* New frame. A frame not completed by mbrtu_rx_poll() in time is lost */
+		rx->state = MBRTU_RX_IDLE;
+		rx->wait_silence = 0u;
+	} else if ((rx->state==MBRTU_RX_DISCARD) || rx->wait_silence) {
+		return 0; /* No t3.5 silence yet */
+	} else if ((rx->state==MBRTU_RX_RECV) && (rx->t15_us!=0u) && (gap > rx->t15_us)) {
+		++rx->n_gap_errors;
+		rx->state = MBRTU_RX_DISCARD;
+		return 0;
+	}
+
+	if (rx->state==MBRTU_RX_IDLE) {
+		rx->state = MBRTU_RX_RECV;
+		rx->len = 0u;
+		rx->expected_len = 0u;
+		rx->crc = mbcrc16_init();
+	}
+
+	if (n > (MBADU_SIZE_MAX - rx->len)) {
+		++rx->n_overruns;
+		rx->state = MBRTU_RX_DISCARD;
+		return 0;
+	}
+
+	(void)memcpy(rx->buf + rx->len, data, n);
+	rx->crc = mbcrc16_update(rx->crc, data, n);
+	rx->len += n;
+
+	if (rx->expected_len==0u) {
+		rx->expected_len = mbadu_expected_len(rx->buf, rx->len);
+	}
+
+	/* Complete without waiting for t3.5 when the length is known */
+	if ((rx->len==rx->expected_len) && (mbcrc16_final(rx->crc)==0u)) {
+		rx->state = MBRTU_RX_READY;
+		rx->wait_silence = 1u;
+		return 1;
+	}
+
+	return 0;
+}
+
+extern int mbrtu_rx_poll(struct mbrtu_rx_s *rx, uint32_t now_us)
+{
+	if (rx==NULL) return 0;
+	if (rx->state==MBRTU_RX_READY) return 1;
+	if ((rx->state==MBRTU_RX_IDLE) && !rx->wait_silence) return 0;
+	if ((uint32_t)(now_us - rx->last_us) < rx->t35_us) return 0;
+
+	rx->wait_silence = 0u;
+	if ((rx->state==MBRTU_RX_RECV) && (rx->len >= MBADU_SIZE_MIN)) {
+		rx->state = MBRTU_RX_READY;
+		return 1;
+	}
+
+	rx->state = MBRTU_RX_IDLE;
+	return 0;
+}
+
+extern int mbrtu_rx_idle(struct mbrtu_rx_s *rx)
+{
+	if (rx==NULL) return 0;
+	if (rx->state==MBRTU_RX_READY) return 1;
+	if ((rx->state!=MBRTU_RX_RECV) || (rx->len < MBADU_SIZE_MIN)) return 0;
+	if (mbcrc16_final(rx->crc)!=0u) return 0;
+	if ((rx->expected_len!=0u) && (rx->len!=rx->expected_len)) return 0;
+
+	rx->state = MBRTU_RX_READY;
+	rx->wait_silence = 1u;
+	return 1;
+}
+
+extern size_t mbrtu_rx_handle(struct mbrtu_rx_s *rx, struct mbinst_s *inst, uint8_t *res)
+{
+	size_t res_len;
+
+	if ((rx==NULL) || (rx->state!=MBRTU_RX_READY)) return 0u;
+
+	res_len = mbadu_handle_req_crc(inst, rx->buf, rx->len, mbcrc16_final(rx->crc), res);
+
+	rx->state = MBRTU_RX_IDLE;
+	rx->len = 0u;
+
+	return res_len;
+}
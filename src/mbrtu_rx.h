@@ -0,0 +1,148 @@
+/**
+ * @file mbrtu_rx.h
+ * @brief Modbus RTU Receiver - Frame detection state machine
+ * @author Jonas Almås
+ *
+ * @details Portable receiver turning the bytes of a serial port into RTU frames.
+ * Bytes are fed one at a time or in chunks (UART interrupt or DMA), with the
+ * time the last byte arrived. Frames end after the t3.5 silence, which is found
+ * by mbrtu_rx_poll() from a timer or the main loop. A frame also ends as soon as
+ * its last byte arrives when the length follows from the function code, or on a
+ * UART idle-line event, so the response is not delayed by t3.5. The CRC is
+ * accumulated while the bytes arrive.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+#ifndef MBRTU_RX_H_INCLUDED
+#define MBRTU_RX_H_INCLUDED
+
+#include "mbadu.h"
+#include "mbinst.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Receiver state
+ */
+enum mbrtu_rx_state_e {
+	MBRTU_RX_IDLE, /**< Waiting for the first byte of a frame */
+	MBRTU_RX_RECV, /**< Receiving a frame */
+	MBRTU_RX_READY, /**< Complete frame received, handle it with mbrtu_rx_handle() */
+	MBRTU_RX_DISCARD, /**< Bad frame (Overrun, t1.5 gap), ignored until t3.5 silence */
+};
+
+/**
+ * @brief RTU receiver of one serial port
+ *
+ * @note Initialize with mbrtu_rx_init()
+ * @note Shall not be accessed by client code directly, except the counters
+ */
+struct mbrtu_rx_s {
+	uint8_t buf[MBADU_SIZE_MAX]; /**< Frame being received */
+	size_t len; /**< Number of bytes in buf */
+	size_t expected_len; /**< Frame length predicted from the function code, 0 if not known yet */
+	uint16_t crc; /**< CRC of the bytes in buf, 0 for an intact frame */
+	uint8_t state; /**< See mbrtu_rx_state_e */
+	uint8_t wait_silence; /**< Non-zero after a frame completed early, until t3.5 silence */
+
+	uint32_t char_us; /**< Time of one character */
+	uint32_t t15_us; /**< Maximum gap between characters of a frame, 0 to not check */
+	uint32_t t35_us; /**< Minimum silence between frames */
+	uint32_t last_us; /**< Time of the last received byte */
+
+	uint32_t n_overruns; /**< Frames longer than MBADU_SIZE_MAX */
+	uint32_t n_gap_errors; /**< Frames with a gap above t1.5 between characters */
+};
+
+/**
+ * @brief Initialize a receiver for a baud rate
+ *
+ * Uses 11 bit characters, t1.5 and t3.5 as given by the Modbus specification,
+ * with the fixed 750 us and 1750 us above 19200 baud.
+ *
+ * @param rx Receiver to initialize
+ * @param baud Serial baud rate in bits per second
+ *
+ * @note Set rx->t15_us to 0 after init to accept any gap below t3.5 within a
+ *       frame, e.g. behind USB serial adapters
+ */
+extern void mbrtu_rx_init(struct mbrtu_rx_s *rx, uint32_t baud);
+
+/**
+ * @brief Feed received bytes
+ *
+ * @param rx Receiver
+ * @param data Received bytes
+ * @param n Number of received bytes
+ * @param now_us Time the last of the bytes was received, in microseconds (May wrap)
+ *
+ * @retval 1 A complete frame is ready for mbrtu_rx_handle()
+ * @retval 0 No complete frame yet
+ *
+ * @note Bytes received while a frame is ready are dropped
+ */
+extern int mbrtu_rx_recv(struct mbrtu_rx_s *rx, const uint8_t *data, size_t n, uint32_t now_us);
+
+/**
+ * @brief Check for the end of a frame by t3.5 silence
+ *
+ * Call periodically, e.g. from a timer interrupt firing t3.5 after the last
+ * byte, or from the main loop.
+ *
+ * @param rx Receiver
+ * @param now_us Current time in microseconds (May wrap)
+ *
+ * @retval 1 A complete frame is ready for mbrtu_rx_handle()
+ * @retval 0 No complete frame
+ */
+extern int mbrtu_rx_poll(struct mbrtu_rx_s *rx, uint32_t now_us);
+
+/**
+ * @brief Signal a UART idle-line event
+ *
+ * The idle line is detected after about one character of silence, well before
+ * t3.5. The frame is taken as complete if its CRC matches, and its length
+ * matches the length predicted from the function code when that is known.
+ * Otherwise the frame is left to mbrtu_rx_poll().
+ *
+ * @param rx Receiver
+ *
+ * @retval 1 A complete frame is ready for mbrtu_rx_handle()
+ * @retval 0 No complete frame
+ */
+extern int mbrtu_rx_idle(struct mbrtu_rx_s *rx);
+
+/**
+ * @brief Handle the complete frame and make room for the next
+ *
+ * @param rx Receiver with a frame ready
+ * @param inst Modbus instance handling the frame
+ * @param res Pointer to response buffer (must be at least MBADU_SIZE_MAX bytes)
+ *
+ * @return Size of response ADU in bytes, or 0 if no response should be sent (or no frame is ready)
+ */
+extern size_t mbrtu_rx_handle(struct mbrtu_rx_s *rx, struct mbinst_s *inst, uint8_t *res);
+
+#endif /* MBRTU_RX_H_INCLUDED */
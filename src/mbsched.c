@@ -0,0 +1,320 @@
+/**
+ * @file mbsched.c
+ * @brief Modbus Request Scheduler - Prioritized request queue above the transports
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbsched.h"
+#include "mbadu.h"
+#include "mbadu_ascii.h"
+#include "mbadu_tcp.h"
+#include "mbconfig.h"
+#include "mbdef.h"
+#include "mbinst.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Current time of the scheduler clock, 0 without clock
+ */
+static uint64_t now(const struct mbsched_s *sched)
+{
+	return (sched->clock_cb!=NULL) ? sched->clock_cb() : 0u;
+}
+
+/**
+ * @brief Get the unit id and function code of a request
+ *
+ * @retval 1 Request fits the transport
+ * @retval 0 Wrong size or framing
+ */
+static int req_header(
+	enum mbsched_transport_e transport,
+	const uint8_t *req,
+	size_t req_len,
+	uint8_t *unit_id,
+	uint8_t *fc)
+{
+	switch (transport) {
+	case MBSCHED_RTU:
+		if ((req_len<MBADU_SIZE_MIN) || (req_len>MBADU_SIZE_MAX)) return 0;
+		*unit_id = req[0];
+		*fc = req[1];
+		return 1;
+#if MBCFG_ASCII
+	case MBSCHED_ASCII:
+		if ((req_len<MBADU_ASCII_SIZE_MIN) || (req_len>MBADU_ASCII_SIZE_MAX)) return 0;
+		return (req[0]==MBADU_ASCII_START_CHAR) && mbadu_ascii_hex_byte(req+1u, unit_id) && mbadu_ascii_hex_byte(req+3u, fc);
+#endif
+	case MBSCHED_TCP:
+		if ((req_len<MBADU_TCP_SIZE_MIN) || (req_len>MBADU_TCP_SIZE_MAX)) return 0;
+		*unit_id = req[MBAP_POS_UNIT_ID];
+		*fc = req[MBAP_SIZE];
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief Append a job to the queue of its priority
+ */
+static void enqueue(struct mbsched_s *sched, uint16_t ix)
+{
+	uint8_t prio = sched->jobs[ix].prio;
+
+	sched->jobs[ix].next = MBSCHED_NONE;
+	if (sched->tail[prio]==MBSCHED_NONE) {
+		sched->head[prio] = ix;
+	} else {
+		sched->jobs[sched->tail[prio]].next = ix;
+	}
+	sched->tail[prio] = ix;
+	++sched->n_queued[prio];
+}
+
+/**
+ * @brief Remove the oldest job of a priority
+ *
+ * @return Index of the job, the queue must not be empty
+ */
+static uint16_t dequeue(struct mbsched_s *sched, size_t prio)
+{
+	uint16_t ix = sched->head[prio];
+
+	sched->head[prio] = sched->jobs[ix].next;
+	if (sched->head[prio]==MBSCHED_NONE) {
+		sched->tail[prio] = MBSCHED_NONE;
+	}
+	--sched->n_queued[prio];
+	return ix;
+}
+
+/**
+ * @brief Put a job back on the free list
+ */
+static void release(struct mbsched_s *sched, uint16_t ix)
+{
+	sched->jobs[ix].next = sched->free;
+	sched->free = ix;
+}
+
+/**
+ * @brief Choose the queue of the next job
+ *
+ * @return Priority to dequeue from, MBSCHED_N_PRIOS if all queues are empty
+ */
+static size_t pick(struct mbsched_s *sched, uint64_t t)
+{
+	size_t best, p;
+
+	for (best=0u; (best<MBSCHED_N_PRIOS) && (sched->head[best]==MBSCHED_NONE); ++best) {}
+	if ((best==0u) || (best==MBSCHED_N_PRIOS) || (sched->age_ticks==0u) || (sched->clock_cb==NULL)) {
+		return best;
+	}
+
+	for (p=best+1u; p<MBSCHED_N_PRIOS; ++p) {
+		if ((sched->head[p]!=MBSCHED_NONE)
+				&& ((t - sched->jobs[sched->head[p]].queued_at) >= sched->age_ticks)) {
+			++sched->stats[p].n_aged;
+			return p;
+		}
+	}
+	return best;
+}
+
+/**
+ * @brief Handle a request with the ADU function of its transport
+ */
+static size_t handle(struct mbsched_s *sched, const struct mbsched_job_s *job)
+{
+	switch (job->transport) {
+	case MBSCHED_RTU:
+		return mbadu_handle_req(job->inst, job->req, job->req_len, sched->res);
+#if MBCFG_ASCII
+	case MBSCHED_ASCII:
+		return mbadu_ascii_handle_req(job->inst, job->req, job->req_len, sched->res);
+#endif
+	case MBSCHED_TCP:
+		return mbadu_tcp_handle_req(job->inst, job->req, job->req_len, sched->res);
+	default:
+		return 0u;
+	}
+}
+
+extern void mbsched_init(struct mbsched_s *sched)
+{
+	size_t i;
+
+	if (sched==NULL) return;
+
+	sched->free = MBSCHED_NONE;
+	for (i=sched->n_jobs; i>0u; --i) {
+		release(sched, (uint16_t)(i-1u));
+	}
+	for (i=0u; i<MBSCHED_N_PRIOS; ++i) {
+		sched->head[i] = MBSCHED_NONE;
+		sched->tail[i] = MBSCHED_NONE;
+		sched->n_queued[i] = 0u;
+		sched->stats[i] = (struct mbsched_prio_stats_s){0};
+	}
+}
+
+extern uint8_t mbsched_default_prio(void *ctx, enum mbsched_transport_e transport, uint8_t unit_id, uint8_t fc)
+{
+	(void)ctx;
+	(void)transport;
+	(void)unit_id;
+
+	switch (fc) {
+	case MBFC_WRITE_SINGLE_COIL:
+	case MBFC_WRITE_SINGLE_REG:
+	case MBFC_WRITE_MULTIPLE_COILS:
+	case MBFC_WRITE_MULTIPLE_REGS:
+	case MBFC_MASK_WRITE_REG:
+		return 0u;
+	case MBFC_READ_COILS:
+	case MBFC_READ_DISC_INPUTS:
+	case MBFC_READ_HOLDING_REGS:
+	case MBFC_READ_INPUT_REGS:
+	case MBFC_READ_EXCEPTION_STATUS:
+	case MBFC_DIAGNOSTICS:
+	case MBFC_COMM_EVENT_COUNTER:
+		return 1u;
+	default:
+		return 2u;
+	}
+}
+
+extern int mbsched_submit(
+	struct mbsched_s *sched,
+	struct mbinst_s *inst,
+	enum mbsched_transport_e transport,
+	void *ctx,
+	const uint8_t *req,
+	size_t req_len)
+{
+	struct mbsched_job_s *job;
+	uint8_t unit_id, fc, prio;
+	uint16_t ix;
+	size_t p, i;
+
+	if ((sched==NULL) || (inst==NULL) || (req==NULL)) return 0;
+	if (!req_header(transport, req, req_len, &unit_id, &fc)) return 0;
+
+	prio = (sched->prio_cb!=NULL)
+		? sched->prio_cb(ctx, transport, unit_id, fc)
+		: mbsched_default_prio(ctx, transport, unit_id, fc);
+	if (prio>=MBSCHED_N_PRIOS) prio = MBSCHED_N_PRIOS-1u;
+
+	if (sched->free==MBSCHED_NONE) {
+		/* Make room by dropping the oldest request of the lowest priority below */
+		for (p=MBSCHED_N_PRIOS-1u; (p>prio) && (sched->head[p]==MBSCHED_NONE); --p) {}
+		if (p==prio) {
+			++sched->stats[prio].n_dropped;
+			return 0;
+		}
+		ix = dequeue(sched, p);
+		++sched->stats[p].n_dropped;
+		if (sched->done_cb!=NULL) {
+			sched->done_cb(sched->jobs[ix].ctx, sched->res, 0u);
+		}
+		release(sched, ix);
+	}
+
+	ix = sched->free;
+	job = &sched->jobs[ix];
+	sched->free = job->next;
+
+	job->inst = inst;
+	job->ctx = ctx;
+	job->queued_at = now(sched);
+	job->req_len = (uint16_t)req_len;
+	job->transport = (uint8_t)transport;
+	job->prio = prio;
+	for (i=0u; i<req_len; ++i) {
+		job->req[i] = req[i];
+	}
+	enqueue(sched, ix);
+
+	return 1;
+}
+
+extern size_t mbsched_run(struct mbsched_s *sched, uint64_t budget_ticks)
+{
+	struct mbsched_prio_stats_s *stats;
+	struct mbsched_job_s *job;
+	uint64_t t_start, t, t_end;
+	size_t n, p, res_len;
+	uint16_t ix;
+
+	if (sched==NULL) return 0u;
+
+	t_start = now(sched);
+	t = t_start;
+	n = 0u;
+	for (;;) {
+		p = pick(sched, t);
+		if (p==MBSCHED_N_PRIOS) break;
+
+		ix = dequeue(sched, p);
+		job = &sched->jobs[ix];
+		stats = &sched->stats[p];
+
+		res_len = handle(sched, job);
+		t_end = now(sched);
+
+		++stats->n_handled;
+		stats->wait_ticks += t - job->queued_at;
+		if ((t - job->queued_at) > stats->wait_max) stats->wait_max = t - job->queued_at;
+		if ((t_end - t) > stats->exec_max) stats->exec_max = t_end - t;
+
+		if (sched->done_cb!=NULL) {
+			sched->done_cb(job->ctx, sched->res, res_len);
+		}
+		release(sched, ix);
+		++n;
+
+		t = t_end;
+		if ((budget_ticks!=0u) && (sched->clock_cb!=NULL) && ((t - t_start) >= budget_ticks)) break;
+	}
+
+	return n;
+}
+
+extern size_t mbsched_pending(const struct mbsched_s *sched)
+{
+	size_t n, p;
+
+	if (sched==NULL) return 0u;
+
+	n = 0u;
+	for (p=0u; p<MBSCHED_N_PRIOS; ++p) {
+		n += sched->n_queued[p];
+	}
+	return n;
+}
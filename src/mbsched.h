@@ -0,0 +1,210 @@
+/**
+ * @file mbsched.h
+ * @brief Modbus Request Scheduler - Prioritized request queue above the transports
+ * @author Jonas Almås
+ *
+ * @details Queues requests of several transports and handles them by priority
+ * instead of arrival order. Each request gets a priority from its function code,
+ * unit id or connection; the highest priority requests run first and a request
+ * that waited longer than a set age runs ahead of them, so short writes are not
+ * starved by long file reads or transactions. mbsched_run() handles requests
+ * until a time budget is spent. Requests are not preempted, a queued top priority
+ * request waits for at most the request in progress.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBSCHED_H_INCLUDED
+#define MBSCHED_H_INCLUDED
+
+#include "mbadu_ascii.h"
+#include "mbinst.h"
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+	MBSCHED_N_PRIOS=4u, /**< Priorities, 0 is the highest */
+	MBSCHED_REQ_SIZE_MAX=MBADU_ASCII_SIZE_MAX, /**< Largest queued request ADU of any transport */
+	MBSCHED_RES_SIZE_MAX=MBADU_ASCII_SIZE_MAX, /**< Largest response ADU of any transport */
+	MBSCHED_NONE=0xFFFFu, /**< End of a job list */
+};
+
+/**
+ * @brief Framing of a queued request
+ */
+enum mbsched_transport_e {
+	MBSCHED_RTU, /**< Handled with mbadu_handle_req() */
+	MBSCHED_ASCII, /**< Handled with mbadu_ascii_handle_req() */
+	MBSCHED_TCP, /**< Handled with mbadu_tcp_handle_req() */
+};
+
+/**
+ * @brief Queued request
+ *
+ * @note Shall not be accessed by client code directly
+ */
+struct mbsched_job_s {
+	struct mbinst_s *inst; /**< Instance handling the request */
+	void *ctx; /**< Connection or port of the request, passed to the callbacks */
+	uint64_t queued_at; /**< Time queued, in clock_cb units */
+	uint16_t next; /**< Next job of the same queue or MBSCHED_NONE */
+	uint16_t req_len; /**< Size of req in bytes */
+	uint8_t transport; /**< mbsched_transport_e */
+	uint8_t prio; /**< Priority the job was queued with */
+	uint8_t req[MBSCHED_REQ_SIZE_MAX]; /**< Copy of the request ADU */
+};
+
+/**
+ * @brief Counters of one priority
+ */
+struct mbsched_prio_stats_s {
+	uint32_t n_handled; /**< Requests handled */
+	uint32_t n_dropped; /**< Requests dropped because the queue was full */
+	uint32_t n_aged; /**< Requests handled ahead of a higher priority after waiting age_ticks */
+	uint64_t wait_ticks; /**< Total time requests were queued, in clock_cb units */
+	uint64_t wait_max; /**< Longest time a request was queued, in clock_cb units */
+	uint64_t exec_max; /**< Longest time handling one request, in clock_cb units */
+};
+
+/**
+ * @brief Request scheduler
+ *
+ * @note Configuration fields are set by the application, the remaining
+ *       fields are state cleared by mbsched_init()
+ * @note Not thread safe, submit and run from one thread or lock around both
+ */
+struct mbsched_s {
+	struct mbsched_job_s *jobs; /**< Caller supplied storage, bounds the queued requests */
+	size_t n_jobs; /**< Number of entries in jobs, at most 65535 */
+
+	/**
+	 * @brief Monotonic clock for waiting times and the run budget
+	 *
+	 * @note Can be left as NULL, mbsched_run() then empties the queue and no times are measured
+	 */
+	uint64_t (*clock_cb)(void);
+
+	/**
+	 * @brief Priority of a request
+	 *
+	 * @param ctx Connection or port the request was submitted with
+	 * @param transport Framing of the request
+	 * @param unit_id Slave address (serial) or unit id (TCP)
+	 * @param fc Function code
+	 *
+	 * @return Priority, 0 is the highest, values above MBSCHED_N_PRIOS-1 are clamped
+	 *
+	 * @note Can be left as NULL, mbsched_default_prio() is then used
+	 */
+	uint8_t (*prio_cb)(void *ctx, enum mbsched_transport_e transport, uint8_t unit_id, uint8_t fc);
+
+	/**
+	 * @brief Response of a request is ready
+	 *
+	 * @param ctx Connection or port the request was submitted with
+	 * @param res Response ADU
+	 * @param res_len Size of res in bytes, 0 if no response should be sent
+	 *
+	 * @note Deferred requests (MB_PENDING) report 0 here and are completed
+	 *       through the transport as usual, e.g. with mbadu_tcp_complete()
+	 */
+	void (*done_cb)(void *ctx, const uint8_t *res, size_t res_len);
+
+	uint64_t age_ticks; /**< Waiting time after which a request runs ahead of all but priority 0, 0 to disable */
+
+	uint16_t free; /**< First unused job */
+	uint16_t head[MBSCHED_N_PRIOS]; /**< Oldest job of each priority */
+	uint16_t tail[MBSCHED_N_PRIOS]; /**< Newest job of each priority */
+	size_t n_queued[MBSCHED_N_PRIOS]; /**< Jobs waiting per priority */
+	struct mbsched_prio_stats_s stats[MBSCHED_N_PRIOS]; /**< Counters per priority */
+	uint8_t res[MBSCHED_RES_SIZE_MAX]; /**< Response of the request being handled */
+};
+
+/**
+ * @brief Empty the queue and clear the counters, the configuration is kept
+ *
+ * @param sched Scheduler to initialize (jobs, n_jobs and callbacks set)
+ */
+extern void mbsched_init(struct mbsched_s *sched);
+
+/**
+ * @brief Default priorities by function code
+ *
+ * - 0: Single and multiple coil and register writes (0x05, 0x06, 0x0F, 0x10, 0x16)
+ * - 1: Coil, input and register reads, and short diagnostics (0x01 to 0x04, 0x07, 0x08, 0x0B)
+ * - 2: Everything else, e.g. file records (0x14, 0x15), 0x17 and FIFO reads
+ *
+ * Priority 3 is left for the application, e.g. a bulk polling connection.
+ */
+extern uint8_t mbsched_default_prio(void *ctx, enum mbsched_transport_e transport, uint8_t unit_id, uint8_t fc);
+
+/**
+ * @brief Queue a request
+ *
+ * The request is copied, the receive buffer can be reused once this returns.
+ * When the queue is full the oldest request of the lowest priority below the
+ * new one is dropped to make room, its done_cb is called with a res_len of 0.
+ *
+ * @param sched Scheduler
+ * @param inst Instance handling the request
+ * @param transport Framing of the request
+ * @param ctx Connection or port of the request, passed to the callbacks
+ * @param req Request ADU
+ * @param req_len Size of req in bytes
+ *
+ * @retval 1 Request queued
+ * @retval 0 Not queued: the queue is full of requests of the same or higher
+ *           priority (counted in n_dropped), or req_len does not fit the transport
+ */
+extern int mbsched_submit(
+	struct mbsched_s *sched,
+	struct mbinst_s *inst,
+	enum mbsched_transport_e transport,
+	void *ctx,
+	const uint8_t *req,
+	size_t req_len);
+
+/**
+ * @brief Handle queued requests by priority
+ *
+ * Handles requests and reports their responses through done_cb until the
+ * queue is empty or budget_ticks have passed. The budget is checked between
+ * requests, a run can exceed it by the time of one request.
+ *
+ * @param sched Scheduler
+ * @param budget_ticks Time budget in clock_cb units, 0 for no limit
+ *
+ * @return Number of requests handled
+ */
+extern size_t mbsched_run(struct mbsched_s *sched, uint64_t budget_ticks);
+
+/**
+ * @brief Number of queued requests
+ *
+ * @param sched Scheduler (Can be NULL)
+ */
+extern size_t mbsched_pending(const struct mbsched_s *sched);
+
+#endif /* MBSCHED_H_INCLUDED */
@@ -0,0 +1,67 @@
+/**
+ * @file mbseqlock.c
+ * @brief Implementation of sequence lock
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbseqlock.h"
+#include "mbatomic.h"
+#include <stddef.h>
+#include <stdint.h>
+
+extern void mbseqlock_init(struct mbseqlock_s *lock)
+{
+	if (lock==NULL) return;
+
+	lock->seq = 0u;
+}
+
+extern void mbseqlock_write_begin(struct mbseqlock_s *lock)
+{
+	lock->seq = lock->seq + 1u;
+	MBATOMIC_FENCE();
+}
+
+extern void mbseqlock_write_end(struct mbseqlock_s *lock)
+{
+	MBATOMIC_FENCE();
+	lock->seq = lock->seq + 1u;
+}
+
+extern uint32_t mbseqlock_read_begin(const struct mbseqlock_s *lock)
+{
+	uint32_t seq = lock->seq;
+
+	MBATOMIC_FENCE();
+	return seq;
+}
+
+extern int mbseqlock_read_retry(const struct mbseqlock_s *lock, uint32_t seq)
+{
+	MBATOMIC_FENCE();
+	return ((seq & 1u) != 0u) || (lock->seq != seq);
+}
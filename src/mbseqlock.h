@@ -0,0 +1,96 @@
+/**
+ * @file mbseqlock.h
+ * @brief Sequence lock for consistent multi-register snapshots
+ * @author Jonas Almås
+ *
+ * @details Sequence lock letting a single writer (application task, ISR or
+ * another core) publish multi-word values while Modbus reads take consistent
+ * snapshots without disabling interrupts.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBSEQLOCK_H_INCLUDED
+#define MBSEQLOCK_H_INCLUDED
+
+#include "mbconfig.h"
+#include <stdint.h>
+
+/**
+ * @brief Sequence lock
+ *
+ * The sequence number is odd while the writer is updating the protected data.
+ *
+ * @note Supports a single writer, concurrent writers must be serialized by the application
+ * @note Shall not be accessed by client code directly
+ */
+struct mbseqlock_s {
+	volatile uint32_t seq; /**< Sequence number, odd while a write is in progress */
+};
+
+/**
+ * @brief Initialize sequence lock
+ *
+ * @param lock Lock to initialize
+ */
+extern void mbseqlock_init(struct mbseqlock_s *lock);
+
+/**
+ * @brief Start publishing new values
+ *
+ * @param lock Lock protecting the values
+ *
+ * @note Must be followed by mbseqlock_write_end()
+ */
+extern void mbseqlock_write_begin(struct mbseqlock_s *lock);
+
+/**
+ * @brief Finish publishing new values
+ *
+ * @param lock Lock protecting the values
+ */
+extern void mbseqlock_write_end(struct mbseqlock_s *lock);
+
+/**
+ * @brief Start reading a snapshot
+ *
+ * @param lock Lock protecting the values
+ *
+ * @return Sequence number to pass to mbseqlock_read_retry()
+ */
+extern uint32_t mbseqlock_read_begin(const struct mbseqlock_s *lock);
+
+/**
+ * @brief Check whether values read since mbseqlock_read_begin() are consistent
+ *
+ * @param lock Lock protecting the values
+ * @param seq Sequence number returned by mbseqlock_read_begin()
+ *
+ * @retval 0 Snapshot is consistent
+ * @retval 1 A write was in progress or happened meanwhile, read again
+ */
+extern int mbseqlock_read_retry(const struct mbseqlock_s *lock, uint32_t seq);
+
+#endif /* MBSEQLOCK_H_INCLUDED */
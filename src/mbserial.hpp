@@ -0,0 +1,254 @@
+/**
+ * @file mbserial.hpp
+ * @brief Modbus Serial - Non-blocking RTU and ASCII serial slaves for C++
+ * @author Jonas Almås
+ *
+ * @details Header-only C++11 slaves for one serial port, RTU (rtu_slave) and
+ * ASCII (ascii_slave), built on mbrtu_rx_recv()/mbrtu_rx_handle() and
+ * mbadu_ascii_handle_req(). poll() never blocks: it takes the received bytes,
+ * hands complete frames to the instance and queues as much of the response as
+ * the port accepts, leaving transmission to the port's interrupt or DMA. The
+ * RS-485 driver is enabled for the response and released once the port reports
+ * the last byte sent. Call poll() from loop(), a cooperative scheduler or a
+ * C++20 coroutine, as often as bytes can arrive. Needs no C++ standard library,
+ * so it builds for AVR Arduino cores.
+ *
+ * The port is any class providing:
+ * - `size_t read(uint8_t *buf, size_t n)`: up to n received bytes, 0 if none
+ * - `size_t write(const uint8_t *buf, size_t n)`: queue up to n bytes for
+ *   transmission, return the number queued (0 if the transmitter is busy)
+ * - `bool tx_done()`: the last queued byte has left the shift register
+ * - `void set_de(bool on)`: RS-485 driver enable, empty for RS-232
+ * - `uint32_t now_us()`: time in microseconds (May wrap)
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+#ifndef MBSERIAL_HPP_INCLUDED
+#define MBSERIAL_HPP_INCLUDED
+
+extern "C" {
+#include "mbadu.h"
+#include "mbadu_ascii.h"
+#include "mbinst.h"
+#include "mbrtu_rx.h"
+}
+#include <stddef.h>
+#include <stdint.h>
+
+namespace mbserial {
+
+/**
+ * @brief What a slave is doing, see rtu_slave::poll() and ascii_slave::poll()
+ */
+enum class state : uint8_t {
+	receiving, /**< Waiting for or receiving a request */
+	transmitting, /**< Queueing the response to the port */
+	draining, /**< Response queued, waiting for the port to send the last byte */
+};
+
+namespace detail {
+
+enum : size_t {RX_CHUNK=32u}; /* Bytes read from the port per step */
+
+/**
+ * @brief Response transmission shared by the RTU and ASCII slaves
+ */
+template <typename Port, size_t N>
+class tx_engine {
+public:
+	explicit tx_engine(Port &port) : port_(port) {}
+
+	state get_state() const { return state_; }
+
+	/**
+	 * @brief Start sending a response of len bytes from buf()
+	 */
+	void start(size_t len)
+	{
+		len_ = len;
+		pos_ = 0u;
+		port_.set_de(true);
+		state_ = state::transmitting;
+		step();
+	}
+
+	/**
+	 * @brief Queue more of the response, release the driver when sent
+	 *
+	 * @return true once back to receiving
+	 */
+	bool step()
+	{
+		if (state_==state::transmitting) {
+			pos_ += port_.write(buf_ + pos_, len_ - pos_);
+			if (pos_ < len_) return false;
+			state_ = state::draining;
+		}
+		if (state_==state::draining) {
+			if (!port_.tx_done()) return false;
+			port_.set_de(false);
+			state_ = state::receiving;
+		}
+		return true;
+	}
+
+	uint8_t *buf() { return buf_; }
+
+private:
+	Port &port_;
+	uint8_t buf_[N];
+	size_t len_ = 0u;
+	size_t pos_ = 0u;
+	state state_ = state::receiving;
+};
+
+} /* namespace detail */
+
+/**
+ * @brief Non-blocking Modbus RTU slave on one serial port
+ */
+template <typename Port>
+class rtu_slave {
+public:
+	/**
+	 * @param port Serial port, see the file description
+	 * @param inst Initialized Modbus instance
+	 * @param baud Baud rate of the port, for the t1.5 and t3.5 timing
+	 */
+	rtu_slave(Port &port, mbinst_s &inst, uint32_t baud) : port_(port), inst_(inst), tx_(port)
+	{
+		mbrtu_rx_init(&rx_, baud);
+		port_.set_de(false);
+	}
+
+	/**
+	 * @brief Receive, handle and send without blocking
+	 *
+	 * @return Current state, state::receiving when nothing is in flight
+	 */
+	state poll()
+	{
+		uint8_t chunk[detail::RX_CHUNK];
+		size_t n, res_len;
+
+		if (!tx_.step()) return tx_.get_state();
+
+		n = port_.read(chunk, sizeof chunk);
+		if (n > 0u) {
+			(void)mbrtu_rx_recv(&rx_, chunk, n, port_.now_us());
+		} else {
+			(void)mbrtu_rx_poll(&rx_, port_.now_us()); /* Frames of unknown length end after t3.5 */
+		}
+
+		res_len = mbrtu_rx_handle(&rx_, &inst_, tx_.buf());
+		if (res_len > 0u) tx_.start(res_len);
+
+		return tx_.get_state();
+	}
+
+	/**
+	 * @brief Signal a UART idle-line event, see mbrtu_rx_idle()
+	 */
+	void idle_line() { (void)mbrtu_rx_idle(&rx_); }
+
+	/**
+	 * @brief Receiver counters
+	 */
+	const mbrtu_rx_s &rx() const { return rx_; }
+
+private:
+	Port &port_;
+	mbinst_s &inst_;
+	mbrtu_rx_s rx_;
+	detail::tx_engine<Port, MBADU_SIZE_MAX> tx_;
+};
+
+/**
+ * @brief Non-blocking Modbus ASCII slave on one serial port
+ */
+template <typename Port>
+class ascii_slave {
+public:
+	/**
+	 * @param port Serial port, see the file description
+	 * @param inst Initialized Modbus instance
+	 * @param timeout_us Drop a partial frame after this much silence
+	 */
+	ascii_slave(Port &port, mbinst_s &inst, uint32_t timeout_us=1000000u) : port_(port), inst_(inst), tx_(port), timeout_us_(timeout_us)
+	{
+		port_.set_de(false);
+	}
+
+	/**
+	 * @brief Receive, handle and send without blocking
+	 *
+	 * @return Current state, state::receiving when nothing is in flight
+	 */
+	state poll()
+	{
+		uint8_t chunk[detail::RX_CHUNK];
+		size_t n, i, res_len;
+
+		if (!tx_.step()) return tx_.get_state();
+
+		n = port_.read(chunk, sizeof chunk);
+		if (n == 0u) {
+			if ((rx_len_ > 0u) && ((uint32_t)(port_.now_us() - last_us_) > timeout_us_)) rx_len_ = 0u;
+			return tx_.get_state();
+		}
+		last_us_ = port_.now_us();
+
+		for (i=0u; i<n; ++i) {
+			if ((chunk[i]==MBADU_ASCII_START_CHAR) || (rx_len_ >= MBADU_ASCII_SIZE_MAX)) rx_len_ = 0u;
+			rx_[rx_len_++] = chunk[i];
+
+			if ((rx_len_ > MBADU_ASCII_HEADER_SIZE)
+					&& (rx_[rx_len_-2u]=='\r')
+					&& (rx_[rx_len_-1u]==inst_.state.ascii_delimiter)) {
+				res_len = mbadu_ascii_handle_req(&inst_, rx_, rx_len_, tx_.buf());
+				rx_len_ = 0u;
+				if (res_len > 0u) {
+					tx_.start(res_len);
+					break; /* Half duplex, the rest of the chunk is dropped */
+				}
+			}
+		}
+
+		return tx_.get_state();
+	}
+
+private:
+	Port &port_;
+	mbinst_s &inst_;
+	detail::tx_engine<Port, MBADU_ASCII_SIZE_MAX> tx_;
+	uint32_t timeout_us_;
+	uint32_t last_us_ = 0u;
+	uint8_t rx_[MBADU_ASCII_SIZE_MAX];
+	size_t rx_len_ = 0u;
+};
+
+} /* namespace mbserial */
+
+#endif /* MBSERIAL_HPP_INCLUDED */
@@ -0,0 +1,204 @@
+/**
+ * @file mbshm.c
+ * @brief Modbus Shared Memory - Register image shared with another process
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbshm.h"
+#include "mbatomic.h"
+#include "mbdef.h"
+#include "mbseqlock.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* The processes sharing the segment may run on different cores, a compiler
+   barrier is not enough */
+#if defined(__STDC_NO_ATOMICS__)
+#error "mbshm requires C11 atomics"
+#endif
+
+enum {
+	ALIGN = 8u, /* Alignment of the image and the ring in the segment */
+};
+
+/**
+ * @brief Round n up to the segment alignment
+ */
+static size_t align_up(size_t n)
+{
+	return (n + (ALIGN - 1u)) & ~(size_t)(ALIGN - 1u);
+}
+
+/**
+ * @brief Set the view of a segment from its header
+ */
+static void set_view(struct mbshm_s *shm, void *mem)
+{
+	uint8_t *p = mem;
+
+	shm->hdr = mem;
+	shm->regs = p + align_up(sizeof(struct mbshm_hdr_s));
+	shm->cmds = (struct mbshm_cmd_s *)(void *)(shm->regs + align_up(2u*(size_t)shm->hdr->n_regs));
+}
+
+/**
+ * @brief Check that a register range lies inside the image
+ */
+static int in_image(const struct mbshm_hdr_s *hdr, uint16_t addr, size_t n)
+{
+	return (addr >= hdr->start) && (((size_t)addr + n) <= ((size_t)hdr->start + hdr->n_regs));
+}
+
+/**
+ * @brief Check that a ring size is a power of two
+ */
+static int is_pow2(uint16_t n)
+{
+	return (n!=0u) && ((n & (n - 1u))==0u);
+}
+
+extern size_t mbshm_size(uint16_t n_regs, uint16_t n_cmds)
+{
+	return align_up(sizeof(struct mbshm_hdr_s))
+		+ align_up(2u*(size_t)n_regs)
+		+ ((size_t)n_cmds * sizeof(struct mbshm_cmd_s));
+}
+
+extern int mbshm_format(
+	struct mbshm_s *shm,
+	void *mem,
+	size_t size,
+	uint16_t start,
+	uint16_t n_regs,
+	uint16_t n_cmds)
+{
+	struct mbshm_hdr_s *hdr = mem;
+
+	if ((shm==NULL) || (mem==NULL)) return 0;
+	if (!is_pow2(n_cmds) || (((size_t)start + n_regs) > 0x10000u)) return 0;
+	if (size < mbshm_size(n_regs, n_cmds)) return 0;
+
+	hdr->magic = 0u;
+	MBATOMIC_FENCE();
+	hdr->version = MBSHM_VERSION;
+	hdr->start = start;
+	hdr->n_regs = n_regs;
+	hdr->n_cmds = n_cmds;
+	mbseqlock_init(&hdr->lock);
+	hdr->cmd_head = 0u;
+	hdr->cmd_tail = 0u;
+	hdr->n_full = 0u;
+	set_view(shm, mem);
+	(void)memset(shm->regs, 0, 2u*(size_t)n_regs);
+
+	/* A server attaching meanwhile sees the magic only after the layout */
+	MBATOMIC_FENCE();
+	hdr->magic = MBSHM_MAGIC;
+	MBATOMIC_FENCE();
+
+	return 1;
+}
+
+extern int mbshm_attach(struct mbshm_s *shm, void *mem, size_t size)
+{
+	const struct mbshm_hdr_s *hdr = mem;
+
+	if ((shm==NULL) || (mem==NULL) || (size < sizeof *hdr)) return 0;
+	if (hdr->magic!=MBSHM_MAGIC) return 0;
+	MBATOMIC_FENCE();
+	if (hdr->version!=MBSHM_VERSION) return 0;
+	if (!is_pow2(hdr->n_cmds) || (((size_t)hdr->start + hdr->n_regs) > 0x10000u)) return 0;
+	if (size < mbshm_size(hdr->n_regs, hdr->n_cmds)) return 0;
+
+	set_view(shm, mem);
+	return 1;
+}
+
+extern const struct mbseqlock_s *mbshm_lock(const struct mbshm_s *shm)
+{
+	return &shm->hdr->lock;
+}
+
+extern uint8_t *mbshm_update_begin(struct mbshm_s *shm)
+{
+	mbseqlock_write_begin(&shm->hdr->lock);
+	return shm->regs;
+}
+
+extern void mbshm_update_end(struct mbshm_s *shm)
+{
+	mbseqlock_write_end(&shm->hdr->lock);
+}
+
+extern int mbshm_cmd_pop(struct mbshm_s *shm, struct mbshm_cmd_s *cmd)
+{
+	struct mbshm_hdr_s *hdr = shm->hdr;
+	uint32_t tail = hdr->cmd_tail;
+
+	if (hdr->cmd_head==tail) return 0;
+	MBATOMIC_FENCE(); /* Command complete before it is copied */
+	(void)memcpy(cmd, &shm->cmds[tail & (hdr->n_cmds - 1u)], sizeof *cmd);
+	MBATOMIC_FENCE(); /* Copied before the entry is handed back */
+	hdr->cmd_tail = tail + 1u;
+
+	return 1;
+}
+
+extern enum mbstatus_e mbshm_read(const struct mbshm_s *shm, uint16_t addr, size_t n, uint8_t *buf)
+{
+	const struct mbshm_hdr_s *hdr = shm->hdr;
+
+	if (!in_image(hdr, addr, n)) return MB_ILLEGAL_DATA_ADDR;
+
+	(void)memcpy(buf, shm->regs + (2u*(size_t)(addr - hdr->start)), 2u*n);
+	return MB_OK;
+}
+
+extern enum mbstatus_e mbshm_write(const struct mbshm_s *shm, uint16_t addr, size_t n, const uint8_t *buf)
+{
+	struct mbshm_hdr_s *hdr = shm->hdr;
+	uint32_t head = hdr->cmd_head;
+	struct mbshm_cmd_s *cmd;
+
+	if ((n > MBSHM_CMD_N_REGS_MAX) || !in_image(hdr, addr, n)) return MB_ILLEGAL_DATA_ADDR;
+	if ((head - hdr->cmd_tail) >= hdr->n_cmds) {
+		hdr->n_full = hdr->n_full + 1u;
+		return MB_BUSY;
+	}
+	MBATOMIC_FENCE(); /* Entry handed back by the owner before it is reused */
+
+	cmd = &shm->cmds[head & (hdr->n_cmds - 1u)];
+	cmd->addr = addr;
+	cmd->n = (uint16_t)n;
+	(void)memcpy(cmd->data, buf, 2u*n);
+
+	MBATOMIC_FENCE(); /* Command complete before it is published */
+	hdr->cmd_head = head + 1u;
+
+	return MB_OK;
+}
@@ -0,0 +1,209 @@
+/**
+ * @file mbshm.h
+ * @brief Modbus Shared Memory - Register image shared with another process
+ * @author Jonas Almås
+ *
+ * @details Register image and write command ring laid out in a memory segment
+ * shared with another process, e.g. a POSIX shm_open()/mmap() segment owned by
+ * a PLC runtime. The owner publishes register values under a sequence lock in
+ * the segment and applies writes taken from a single producer, single consumer
+ * ring. The Modbus server serves the image through bulk descriptors, so
+ * requests cost no system call and no process switch. Requires a compiler
+ * with C11 atomics.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBSHM_H_INCLUDED
+#define MBSHM_H_INCLUDED
+
+#include "mbdef.h"
+#include "mbseqlock.h"
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+	MBSHM_MAGIC = 0x4D425348u, /**< "MBSH", identifies a formatted segment */
+	MBSHM_VERSION = 1u, /**< Layout version, changed with the segment layout */
+	MBSHM_CMD_N_REGS_MAX = 0x7Bu, /**< Registers per write command, as fc 0x10 */
+};
+
+/**
+ * @brief Segment header, at the start of the shared memory
+ *
+ * Followed by the register image (big-endian, 2 bytes per register from
+ * start, padded to 8 bytes) and n_cmds write commands.
+ *
+ * @note Shall not be accessed by client code directly
+ */
+struct mbshm_hdr_s {
+	uint32_t magic; /**< MBSHM_MAGIC once formatted */
+	uint16_t version; /**< MBSHM_VERSION */
+	uint16_t start; /**< First register address of the image */
+	uint16_t n_regs; /**< Number of registers in the image */
+	uint16_t n_cmds; /**< Write command ring entries, power of two */
+
+	struct mbseqlock_s lock; /**< Held by the owner while updating the image */
+	volatile uint32_t cmd_head; /**< Commands pushed, written by the Modbus server */
+	volatile uint32_t cmd_tail; /**< Commands taken, written by the owner */
+	volatile uint32_t n_full; /**< Writes refused with a full ring */
+};
+
+/**
+ * @brief Register write passed from the Modbus server to the owner
+ */
+struct mbshm_cmd_s {
+	uint16_t addr; /**< First register address */
+	uint16_t n; /**< Number of registers */
+	uint8_t data[2u*MBSHM_CMD_N_REGS_MAX]; /**< Big-endian register values, 2*n bytes */
+};
+
+/**
+ * @brief Process local view of a segment, set by mbshm_format() or mbshm_attach()
+ *
+ * The segment may be mapped at different addresses in each process, it holds
+ * no pointers.
+ */
+struct mbshm_s {
+	struct mbshm_hdr_s *hdr; /**< Segment header */
+	uint8_t *regs; /**< Register image */
+	struct mbshm_cmd_s *cmds; /**< Write command ring */
+};
+
+/**
+ * @brief Size of a segment
+ *
+ * @param n_regs Number of registers in the image
+ * @param n_cmds Write command ring entries
+ *
+ * @return Bytes to allocate or map
+ */
+extern size_t mbshm_size(uint16_t n_regs, uint16_t n_cmds);
+
+/**
+ * @brief Lay out a new segment, called by the owner before the server attaches
+ *
+ * The image is zeroed and the ring empty.
+ *
+ * @param shm View to set
+ * @param mem Segment, 8 byte aligned (Page aligned when mapped)
+ * @param size Size of mem, at least mbshm_size()
+ * @param start First register address of the image
+ * @param n_regs Number of registers in the image
+ * @param n_cmds Write command ring entries, a power of two
+ *
+ * @retval 1 Success
+ * @retval 0 Invalid arguments
+ */
+extern int mbshm_format(
+	struct mbshm_s *shm,
+	void *mem,
+	size_t size,
+	uint16_t start,
+	uint16_t n_regs,
+	uint16_t n_cmds);
+
+/**
+ * @brief Attach to a segment formatted by the owner
+ *
+ * @param shm View to set
+ * @param mem Mapped segment
+ * @param size Size of mem
+ *
+ * @retval 1 Success
+ * @retval 0 Not formatted, other layout version or larger than size
+ */
+extern int mbshm_attach(struct mbshm_s *shm, void *mem, size_t size);
+
+/**
+ * @brief Lock held while the image is updated, see mbinst_s::hold_regs_lock
+ *
+ * @param shm Attached segment
+ *
+ * @return Sequence lock in the segment
+ */
+extern const struct mbseqlock_s *mbshm_lock(const struct mbshm_s *shm);
+
+/**
+ * @brief Start updating the image, called by the owner
+ *
+ * @param shm Segment
+ *
+ * @return Register image, 2*n_regs bytes of big-endian register values
+ *
+ * @note Must be followed by mbshm_update_end()
+ */
+extern uint8_t *mbshm_update_begin(struct mbshm_s *shm);
+
+/**
+ * @brief Finish updating the image
+ *
+ * @param shm Segment
+ */
+extern void mbshm_update_end(struct mbshm_s *shm);
+
+/**
+ * @brief Take the oldest write command, called by the owner
+ *
+ * @param shm Segment
+ * @param cmd Destination
+ *
+ * @retval 1 Command taken
+ * @retval 0 Ring empty
+ *
+ * @note Writes reach reads once the owner has applied them and updated the image
+ */
+extern int mbshm_cmd_pop(struct mbshm_s *shm, struct mbshm_cmd_s *cmd);
+
+/**
+ * @brief Copy registers from the image, for bulk read callbacks
+ *
+ * @param shm Attached segment
+ * @param addr First register address
+ * @param n Number of registers
+ * @param buf Destination, 2*n bytes
+ *
+ * @return MB_OK, or MB_ILLEGAL_DATA_ADDR outside the image
+ *
+ * @note Takes no snapshot, set mbshm_lock() as lock of the map
+ */
+extern enum mbstatus_e mbshm_read(const struct mbshm_s *shm, uint16_t addr, size_t n, uint8_t *buf);
+
+/**
+ * @brief Queue a write for the owner, for bulk write callbacks
+ *
+ * @param shm Attached segment
+ * @param addr First register address
+ * @param n Number of registers, at most MBSHM_CMD_N_REGS_MAX
+ * @param buf Big-endian register values, 2*n bytes
+ *
+ * @return MB_OK, MB_ILLEGAL_DATA_ADDR outside the image or MB_BUSY when the
+ *         owner has not taken the earlier commands
+ *
+ * @note Single producer, concurrent server threads must be serialized by the application
+ */
+extern enum mbstatus_e mbshm_write(const struct mbshm_s *shm, uint16_t addr, size_t n, const uint8_t *buf);
+
+#endif /* MBSHM_H_INCLUDED */
@@ -0,0 +1,264 @@
+/**
+ * @file mbstats.c
+ * @brief Implementation of Modbus statistics
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbstats.h"
+#include "endian.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Log2 histogram bucket of a latency, see mbstats_s::latency_hist
+ */
+static size_t bucket(uint64_t ticks)
+{
+	size_t i;
+
+	for (i=0u; (ticks!=0u) && (i<(MBSTATS_N_BUCKETS-1u)); ++i) {
+		ticks >>= 1u;
+	}
+
+	return i;
+}
+
+/**
+ * @brief Report each non-zero entry of a 32-bit counter array
+ */
+static void export_u32(
+	const char *name,
+	const uint32_t *values,
+	size_t n,
+	void (*export_cb)(void *ctx, const char *name, size_t idx, uint64_t value),
+	void *ctx)
+{
+	size_t i;
+
+	for (i=0u; i<n; ++i) {
+		if (values[i]!=0u) export_cb(ctx, name, i, values[i]);
+	}
+}
+
+/**
+ * @brief Report each non-zero entry of a 64-bit counter array
+ */
+static void export_u64(
+	const char *name,
+	const uint64_t *values,
+	size_t n,
+	void (*export_cb)(void *ctx, const char *name, size_t idx, uint64_t value),
+	void *ctx)
+{
+	size_t i;
+
+	for (i=0u; i<n; ++i) {
+		if (values[i]!=0u) export_cb(ctx, name, i, values[i]);
+	}
+}
+
+/**
+ * @brief Value of the i-th 64-bit counter of the register window, see MBSTATS_REG_*
+ */
+static uint64_t reg_counter(const struct mbstats_s *stats, size_t i)
+{
+	uint64_t n_req, ticks;
+	size_t k;
+
+	switch (i) {
+	case MBSTATS_REG_EXCEPTION_COUNT/4u: return stats->exception_count;
+	case MBSTATS_REG_CRC_ERR_COUNT/4u: return stats->crc_err_count;
+	case MBSTATS_REG_BYTES_IN/4u: return stats->bytes_in;
+	case MBSTATS_REG_BYTES_OUT/4u: return stats->bytes_out;
+	case MBSTATS_REG_LATENCY_MAX/4u: return stats->latency_max;
+	case MBSTATS_REG_REQ_COUNT/4u:
+	case MBSTATS_REG_LATENCY_AVG/4u:
+		n_req = 0u;
+		ticks = 0u;
+		for (k=0u; k<MBSTATS_N_FC; ++k) {
+			n_req += stats->fc_count[k];
+			ticks += stats->fc_ticks[k];
+		}
+		if (i==(MBSTATS_REG_REQ_COUNT/4u)) return n_req;
+		return (n_req!=0u) ? (ticks / n_req) : 0u;
+	default: break;
+	}
+
+	i *= 4u;
+	if (i < MBSTATS_REG_TR_BYTES_IN) return stats->tr_frames_in[(i - MBSTATS_REG_TR_FRAMES_IN)/4u];
+	if (i < MBSTATS_REG_TR_BYTES_OUT) return stats->tr_bytes_in[(i - MBSTATS_REG_TR_BYTES_IN)/4u];
+	if (i < MBSTATS_REG_FC_COUNT) return stats->tr_bytes_out[(i - MBSTATS_REG_TR_BYTES_OUT)/4u];
+	if (i < MBSTATS_REG_FC_TICKS) return stats->fc_count[(i - MBSTATS_REG_FC_COUNT)/4u];
+	return stats->fc_ticks[(i - MBSTATS_REG_FC_TICKS)/4u];
+}
+
+extern void mbstats_init(struct mbstats_s *stats, uint64_t (*clock_cb)(void))
+{
+	if (stats==NULL) return;
+
+	(void)memset(stats, 0, sizeof *stats);
+	stats->clock_cb = clock_cb;
+}
+
+extern void mbstats_sum(
+	struct mbstats_s *sum,
+	const struct mbstats_s *const *stats,
+	size_t n_stats)
+{
+	size_t i, k;
+	const struct mbstats_s *st;
+
+	if (sum==NULL) return;
+
+	mbstats_init(sum, NULL);
+	if (stats==NULL) return;
+
+	for (i=0u; i<n_stats; ++i) {
+		if ((st = stats[i]) == NULL) continue;
+
+		for (k=0u; k<MBSTATS_N_FC; ++k) {
+			sum->fc_count[k] += st->fc_count[k];
+			sum->fc_ticks[k] += st->fc_ticks[k];
+		}
+		for (k=0u; k<MBSTATS_N_BUCKETS; ++k) {
+			sum->latency_hist[k] += st->latency_hist[k];
+		}
+		if (st->latency_max > sum->latency_max) sum->latency_max = st->latency_max;
+		for (k=0u; k<MBSTATS_N_MAPS; ++k) {
+			sum->lookup_count[k] += st->lookup_count[k];
+		}
+		sum->exception_count += st->exception_count;
+		sum->crc_err_count += st->crc_err_count;
+		sum->bytes_in += st->bytes_in;
+		sum->bytes_out += st->bytes_out;
+		for (k=0u; k<MBSTATS_N_TRANSPORTS; ++k) {
+			sum->tr_frames_in[k] += st->tr_frames_in[k];
+			sum->tr_bytes_in[k] += st->tr_bytes_in[k];
+			sum->tr_bytes_out[k] += st->tr_bytes_out[k];
+		}
+	}
+}
+
+extern void mbstats_export(
+	const struct mbstats_s *stats,
+	void (*export_cb)(void *ctx, const char *name, size_t idx, uint64_t value),
+	void *ctx)
+{
+	if ((stats==NULL) || (export_cb==NULL)) return;
+
+	export_u64("fc_count", stats->fc_count, MBSTATS_N_FC, export_cb, ctx);
+	export_u64("fc_ticks", stats->fc_ticks, MBSTATS_N_FC, export_cb, ctx);
+	export_u32("latency_hist", stats->latency_hist, MBSTATS_N_BUCKETS, export_cb, ctx);
+	if (stats->latency_max!=0u) export_cb(ctx, "latency_max", 0u, stats->latency_max);
+	export_u32("lookup_count", stats->lookup_count, MBSTATS_N_MAPS, export_cb, ctx);
+	export_u64("exception_count", &stats->exception_count, 1u, export_cb, ctx);
+	export_u64("crc_err_count", &stats->crc_err_count, 1u, export_cb, ctx);
+	export_u64("bytes_in", &stats->bytes_in, 1u, export_cb, ctx);
+	export_u64("bytes_out", &stats->bytes_out, 1u, export_cb, ctx);
+	export_u64("tr_frames_in", stats->tr_frames_in, MBSTATS_N_TRANSPORTS, export_cb, ctx);
+	export_u64("tr_bytes_in", stats->tr_bytes_in, MBSTATS_N_TRANSPORTS, export_cb, ctx);
+	export_u64("tr_bytes_out", stats->tr_bytes_out, MBSTATS_N_TRANSPORTS, export_cb, ctx);
+}
+
+extern enum mbstatus_e mbstats_read_regs(
+	const struct mbstats_s *stats,
+	uint16_t offset,
+	size_t n,
+	uint8_t *buf)
+{
+	size_t i, end;
+	uint64_t value;
+
+	if ((stats==NULL) || (buf==NULL) || (n > MBSTATS_N_REGS)
+			|| (offset > (MBSTATS_N_REGS - n))) {
+		return MB_ILLEGAL_DATA_ADDR;
+	}
+
+	end = (size_t)offset + n;
+	value = reg_counter(stats, offset/4u);
+	for (i=offset; i<end; ++i) {
+		if ((i>offset) && ((i%4u)==0u)) value = reg_counter(stats, i/4u);
+		u16tobe((uint16_t)(value >> (16u*(3u - (i%4u)))), buf);
+		buf += 2u;
+	}
+
+	return MB_OK;
+}
+
+extern uint64_t mbstats_now(const struct mbstats_s *stats)
+{
+	return ((stats!=NULL) && (stats->clock_cb!=NULL)) ? stats->clock_cb() : 0u;
+}
+
+extern void mbstats_count_req(struct mbstats_s *stats, uint8_t fc, uint64_t t_start)
+{
+	uint64_t ticks;
+
+	if (stats==NULL) return;
+
+	fc &= (uint8_t)(MBSTATS_N_FC-1u);
+	++stats->fc_count[fc];
+
+	if (stats->clock_cb==NULL) return;
+
+	ticks = stats->clock_cb() - t_start;
+	stats->fc_ticks[fc] += ticks;
+	++stats->latency_hist[bucket(ticks)];
+	if (ticks > stats->latency_max) stats->latency_max = ticks;
+}
+
+extern void mbstats_count_lookup(struct mbstats_s *stats, enum mbstats_map_e map)
+{
+	if ((stats==NULL) || ((size_t)map >= MBSTATS_N_MAPS)) return;
+
+	++stats->lookup_count[map];
+}
+
+extern void mbstats_count_bytes(
+	struct mbstats_s *stats,
+	enum mbstats_transport_e tr,
+	size_t n_in,
+	size_t n_out)
+{
+	if (stats==NULL) return;
+
+	stats->bytes_in += n_in;
+	stats->bytes_out += n_out;
+
+	if ((size_t)tr >= MBSTATS_N_TRANSPORTS) return;
+	if (n_in!=0u) ++stats->tr_frames_in[tr];
+	stats->tr_bytes_in[tr] += n_in;
+	stats->tr_bytes_out[tr] += n_out;
+}
+
+extern void mbstats_count_crc_err(struct mbstats_s *stats)
+{
+	if (stats==NULL) return;
+
+	++stats->crc_err_count;
+}
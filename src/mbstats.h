@@ -0,0 +1,251 @@
+/**
+ * @file mbstats.h
+ * @brief Modbus Statistics - Request counters and latency histograms
+ * @author Jonas Almås
+ *
+ * @details Optional performance instrumentation of a Modbus instance. Counts
+ * requests per function code, measures handler latency with an application
+ * supplied clock, and counts descriptor lookups, bytes and CRC/LRC failures.
+ * All counters are 32 or 64-bit and meant for field diagnostics, unlike the
+ * 16-bit serial diagnostic counters of mbinst_state_s.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBSTATS_H_INCLUDED
+#define MBSTATS_H_INCLUDED
+
+#include "mbdef.h"
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+	MBSTATS_N_FC=128u, /* Function codes 0 to 127 */
+	MBSTATS_N_BUCKETS=32u, /* Log2 latency buckets */
+};
+
+/**
+ * @brief Descriptor maps counted by mbstats_s::lookup_count
+ */
+enum mbstats_map_e {
+	MBSTATS_MAP_COILS,
+	MBSTATS_MAP_DISC_INPUTS,
+	MBSTATS_MAP_HOLD_REGS,
+	MBSTATS_MAP_INPUT_REGS,
+	MBSTATS_MAP_FILES,
+	MBSTATS_N_MAPS,
+};
+
+/**
+ * @brief Transports counted by mbstats_s::tr_frames_in, tr_bytes_in and tr_bytes_out
+ */
+enum mbstats_transport_e {
+	MBSTATS_TR_RTU, /**< Serial RTU and RTU over TCP (mbadu.c) */
+	MBSTATS_TR_ASCII, /**< Serial ASCII (mbadu_ascii.c) */
+	MBSTATS_TR_TCP, /**< TCP/IP and UDP (mbadu_tcp.c) */
+	MBSTATS_N_TRANSPORTS,
+};
+
+/**
+ * @brief Register offsets of the counters in mbstats_read_regs()
+ *
+ * Every counter is a 64-bit value in 4 registers, most significant register
+ * first. Array counters take 4 registers per entry.
+ */
+enum {
+	MBSTATS_REG_REQ_COUNT=0u, /**< Requests handled, sum of fc_count */
+	MBSTATS_REG_EXCEPTION_COUNT=4u,
+	MBSTATS_REG_CRC_ERR_COUNT=8u,
+	MBSTATS_REG_BYTES_IN=12u,
+	MBSTATS_REG_BYTES_OUT=16u,
+	MBSTATS_REG_LATENCY_MAX=20u,
+	MBSTATS_REG_LATENCY_AVG=24u, /**< Average handler latency, sum of fc_ticks by REQ_COUNT */
+	MBSTATS_REG_TR_FRAMES_IN=28u, /**< Per mbstats_transport_e */
+	MBSTATS_REG_TR_BYTES_IN=28u + (4u*MBSTATS_N_TRANSPORTS),
+	MBSTATS_REG_TR_BYTES_OUT=28u + (8u*MBSTATS_N_TRANSPORTS),
+	MBSTATS_REG_FC_COUNT=28u + (12u*MBSTATS_N_TRANSPORTS), /**< Per function code */
+	MBSTATS_REG_FC_TICKS=MBSTATS_REG_FC_COUNT + (4u*MBSTATS_N_FC), /**< Per function code */
+	MBSTATS_N_REGS=MBSTATS_REG_FC_TICKS + (4u*MBSTATS_N_FC),
+};
+
+/**
+ * @brief Performance counters of one Modbus instance
+ *
+ * Attached to an instance through mbinst_s::stats. Updated by the library
+ * while handling requests, read through mbstats_export() or directly.
+ *
+ * @note Not thread safe, give each worker instance its own block and sum them with mbstats_sum()
+ */
+struct mbstats_s {
+	/**
+	 * @brief Monotonic clock used to measure handler latency
+	 *
+	 * @return Current time in any unit (e.g. microseconds or CPU cycles)
+	 *
+	 * @note Can be left as NULL, latency is then not measured
+	 */
+	uint64_t (*clock_cb)(void);
+
+	uint64_t fc_count[MBSTATS_N_FC]; /**< Requests handled per function code */
+	uint64_t fc_ticks[MBSTATS_N_FC]; /**< Total handler time per function code, in clock_cb units */
+
+	/**
+	 * @brief Handler latency histogram
+	 *
+	 * Bucket 0 counts latencies of 0 ticks, bucket i>0 latencies from
+	 * 2^(i-1) to 2^i-1 ticks. The last bucket also counts everything above.
+	 */
+	uint32_t latency_hist[MBSTATS_N_BUCKETS];
+	uint64_t latency_max; /**< Longest handler latency, in clock_cb units */
+
+	uint32_t lookup_count[MBSTATS_N_MAPS]; /**< Descriptor searches per map */
+
+	uint64_t exception_count; /**< Exception responses */
+	uint64_t crc_err_count; /**< Frames dropped because of a CRC/LRC mismatch */
+	uint64_t bytes_in; /**< ADU bytes received */
+	uint64_t bytes_out; /**< ADU bytes sent */
+
+	uint64_t tr_frames_in[MBSTATS_N_TRANSPORTS]; /**< Frames received per mbstats_transport_e, 64-bit bus_msg_counter */
+	uint64_t tr_bytes_in[MBSTATS_N_TRANSPORTS]; /**< ADU bytes received per mbstats_transport_e */
+	uint64_t tr_bytes_out[MBSTATS_N_TRANSPORTS]; /**< ADU bytes sent per mbstats_transport_e */
+};
+
+/**
+ * @brief Clear all counters and set the clock callback
+ *
+ * @param stats Counters to initialize
+ * @param clock_cb Monotonic clock (Can be NULL)
+ */
+extern void mbstats_init(struct mbstats_s *stats, uint64_t (*clock_cb)(void));
+
+/**
+ * @brief Sum the counters of several blocks, e.g. one per worker instance
+ *
+ * @param sum Out parameter with the summed counters, clock_cb is set to NULL
+ * @param stats Blocks to sum (NULL entries are skipped)
+ * @param n_stats Number of entries in stats
+ *
+ * @note latency_max is the maximum of all blocks
+ */
+extern void mbstats_sum(
+	struct mbstats_s *sum,
+	const struct mbstats_s *const *stats,
+	size_t n_stats);
+
+/**
+ * @brief Visit every non-zero counter
+ *
+ * Calls export_cb once per counter with its name, e.g. to format them for a
+ * log or a metrics endpoint. Array counters are reported once per non-zero
+ * entry with the function code, bucket or mbstats_map_e as index; scalar
+ * counters have index 0.
+ *
+ * Names: "fc_count", "fc_ticks", "latency_hist", "latency_max",
+ * "lookup_count", "exception_count", "crc_err_count", "bytes_in", "bytes_out",
+ * "tr_frames_in", "tr_bytes_in" and "tr_bytes_out".
+ *
+ * @param stats Counters to export
+ * @param export_cb Called for each non-zero counter
+ * @param ctx Passed through to export_cb
+ */
+extern void mbstats_export(
+	const struct mbstats_s *stats,
+	void (*export_cb)(void *ctx, const char *name, size_t idx, uint64_t value),
+	void *ctx);
+
+/**
+ * @brief Read the counters as a window of 16-bit registers
+ *
+ * Backs a read only register block, e.g. in the input registers, so a
+ * network management station reads all counters of interest in a single
+ * request. The layout is given by the MBSTATS_REG_* offsets. Called from a
+ * MRACC_R_BULK callback of the instance owning the counters, the values are
+ * consistent with each other and do not include the request being read.
+ *
+ * @code
+ * static enum mbstatus_e stats_regs(uint16_t addr, size_t n, uint8_t *buf)
+ * {
+ *     return mbstats_read_regs(&s_stats, (uint16_t)(addr - 0x8000u), n, buf);
+ * }
+ * @endcode
+ *
+ * @param stats Counters to read
+ * @param offset First register of the window to read
+ * @param n Number of registers to read
+ * @param buf Destination for 2*n bytes of big-endian register data
+ *
+ * @retval MB_OK Registers read
+ * @retval MB_ILLEGAL_DATA_ADDR Registers outside of the window (MBSTATS_N_REGS)
+ */
+extern enum mbstatus_e mbstats_read_regs(
+	const struct mbstats_s *stats,
+	uint16_t offset,
+	size_t n,
+	uint8_t *buf);
+
+/**
+ * @brief Current time of the clock, 0 without stats or clock
+ *
+ * @note Library internal function
+ */
+extern uint64_t mbstats_now(const struct mbstats_s *stats);
+
+/**
+ * @brief Count a handled request and its handler latency
+ *
+ * @param stats Counters (Can be NULL)
+ * @param fc Function code of the request
+ * @param t_start Result of mbstats_now() before handling the request
+ *
+ * @note Library internal function
+ */
+extern void mbstats_count_req(struct mbstats_s *stats, uint8_t fc, uint64_t t_start);
+
+/**
+ * @brief Count a descriptor search in one of the maps
+ *
+ * @note Library internal function
+ */
+extern void mbstats_count_lookup(struct mbstats_s *stats, enum mbstats_map_e map);
+
+/**
+ * @brief Count received and sent ADU bytes, a non-zero n_in counts a received frame
+ *
+ * @note Library internal function
+ */
+extern void mbstats_count_bytes(
+	struct mbstats_s *stats,
+	enum mbstats_transport_e tr,
+	size_t n_in,
+	size_t n_out);
+
+/**
+ * @brief Count a frame with a CRC/LRC mismatch
+ *
+ * @note Library internal function
+ */
+extern void mbstats_count_crc_err(struct mbstats_s *stats);
+
+#endif /* MBSTATS_H_INCLUDED */
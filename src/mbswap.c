@@ -0,0 +1,143 @@
+/**
+ * @file mbswap.c
+ * @brief Modbus Map Swap - Atomic replacement of descriptor maps
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbswap.h"
+#include "mbatomic.h"
+#include "mbcache.h"
+#include "mbinst.h"
+#include "mbplan.h"
+#include "mbreg.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Copy the maps of a set to a worker instance
+ *
+ * Responses, plans and function register values of the worker were taken
+ * from the previous maps. A reused set can hold a new map at the same
+ * address, so they are dropped on every change.
+ */
+static void apply(struct mbinst_s *inst, const struct mbinst_s *maps)
+{
+	inst->coils = maps->coils;
+	inst->n_coils = maps->n_coils;
+	inst->coils_ix = maps->coils_ix;
+	inst->disc_inputs = maps->disc_inputs;
+	inst->n_disc_inputs = maps->n_disc_inputs;
+	inst->disc_inputs_ix = maps->disc_inputs_ix;
+	inst->hold_regs = maps->hold_regs;
+	inst->n_hold_regs = maps->n_hold_regs;
+	inst->hold_regs_ix = maps->hold_regs_ix;
+	inst->hold_regs_kern = maps->hold_regs_kern;
+	inst->input_regs = maps->input_regs;
+	inst->n_input_regs = maps->n_input_regs;
+	inst->input_regs_ix = maps->input_regs_ix;
+	inst->input_regs_kern = maps->input_regs_kern;
+	inst->files = maps->files;
+	inst->n_files = maps->n_files;
+	inst->files_ix = maps->files_ix;
+
+	mbcache_invalidate(inst->cache);
+	mbplan_init(inst->plan);
+	mbreg_fn_cache_invalidate(inst->fn_cache);
+}
+
+extern void mbswap_init(struct mbswap_s *swap, struct mbswap_set_s *set)
+{
+	size_t i;
+
+	for (i=0u; i<swap->n_readers; ++i) {
+		swap->readers[i].gen = 0u;
+		swap->readers[i].applied_gen = 0u;
+	}
+	swap->gen = 1u;
+	set->gen = swap->gen;
+	swap->retired = NULL;
+	swap->cur = set;
+	MBATOMIC_FENCE();
+}
+
+extern int mbswap_publish(struct mbswap_s *swap, struct mbswap_set_s *set)
+{
+	if (swap->retired!=NULL) return 0;
+
+	/* Generation 0 marks quiescent readers */
+	swap->gen = (swap->gen==UINT32_MAX) ? 1u : (swap->gen + 1u);
+	set->gen = swap->gen;
+
+	swap->retired = swap->cur;
+	MBATOMIC_FENCE(); /* Set complete before it is published */
+	swap->cur = set;
+	MBATOMIC_FENCE(); /* Published before readers are checked in mbswap_reclaim() */
+
+	return 1;
+}
+
+extern struct mbswap_set_s *mbswap_reclaim(struct mbswap_s *swap)
+{
+	struct mbswap_set_s *set = swap->retired;
+	size_t i;
+
+	if (set==NULL) return NULL;
+
+	MBATOMIC_FENCE();
+	for (i=0u; i<swap->n_readers; ++i) {
+		if (swap->readers[i].gen==set->gen) return NULL;
+	}
+	MBATOMIC_FENCE(); /* Readers done with the set before it is handed back */
+
+	swap->retired = NULL;
+	return set;
+}
+
+extern void mbswap_enter(struct mbswap_s *swap, size_t reader_ix, struct mbinst_s *inst)
+{
+	struct mbswap_reader_s *reader = &swap->readers[reader_ix];
+	struct mbswap_set_s *set;
+
+	/* Announce the set before using it. A publish in between is seen when
+	   checking again, a reclaim after the announcement sees the reader. */
+	do {
+		set = swap->cur;
+		reader->gen = set->gen;
+		MBATOMIC_FENCE();
+	} while (swap->cur!=set);
+
+	if (reader->applied_gen!=set->gen) { /* Sets are reused, compare generations */
+		apply(inst, &set->maps);
+		reader->applied_gen = set->gen;
+	}
+}
+
+extern void mbswap_exit(struct mbswap_s *swap, size_t reader_ix)
+{
+	MBATOMIC_FENCE(); /* Request done before the set is released */
+	swap->readers[reader_ix].gen = 0u;
+}
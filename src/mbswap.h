@@ -0,0 +1,150 @@
+/**
+ * @file mbswap.h
+ * @brief Modbus Map Swap - Atomic replacement of descriptor maps
+ * @author Jonas Almås
+ *
+ * @details Replaces the descriptor maps of running worker instances without
+ * stopping them. The configuration task prepares a new map set and publishes
+ * it with one pointer store. Each worker picks up the published set when it
+ * starts a request and marks itself quiescent afterwards, so requests in
+ * flight finish on the set they started with. The old set is reclaimed once
+ * no worker uses it any longer, without locks on the request path.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBSWAP_H_INCLUDED
+#define MBSWAP_H_INCLUDED
+
+#include "mbinst.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Map set, descriptor maps with their lookup structures
+ *
+ * The coil, discrete input, register and file maps of maps are swapped in,
+ * together with the indices and kernels mbinst_prepare() attached.
+ * Other fields of maps are not used.
+ *
+ * @note Configuration fields are set by the application, gen is set by mbswap_publish()
+ * @note Must not be modified while published or not yet reclaimed
+ */
+struct mbswap_set_s {
+	struct mbinst_s maps; /**< Instance holding the maps, prepared with mbinst_prepare() */
+	struct mbinst_prep_s prep; /**< Storage of the lookup structures of maps */
+
+	uint32_t gen; /**< Generation, set when published */
+};
+
+/**
+ * @brief Worker side of a swap
+ *
+ * @note Set by mbswap_init(), one per worker instance
+ * @note Shall not be accessed by client code directly
+ */
+struct mbswap_reader_s {
+	volatile uint32_t gen; /**< Generation in use, 0 while the worker is quiescent */
+	uint32_t applied_gen; /**< Generation last copied to the worker instance */
+};
+
+/**
+ * @brief Published map set and its readers
+ *
+ * @note Configuration fields are set by the application, the remaining
+ *       fields are state set by mbswap_init()
+ * @note Supports a single publisher, concurrent publishers must be serialized by the application
+ */
+struct mbswap_s {
+	struct mbswap_reader_s *readers; /**< One per worker instance */
+	size_t n_readers; /**< Number of readers */
+
+	struct mbswap_set_s *volatile cur; /**< Published set */
+	struct mbswap_set_s *retired; /**< Set replaced by the last publish, until reclaimed */
+	uint32_t gen; /**< Generation of the last publish */
+};
+
+/**
+ * @brief Initialize a swap with its first map set
+ *
+ * @param swap Swap with configuration fields set
+ * @param set First map set, prepared
+ */
+extern void mbswap_init(struct mbswap_s *swap, struct mbswap_set_s *set);
+
+/**
+ * @brief Publish a new map set
+ *
+ * Workers starting a request afterwards use set, requests already started
+ * finish on the set they started with.
+ *
+ * @param swap Swap
+ * @param set Map set, prepared
+ *
+ * @retval 1 Published
+ * @retval 0 The set replaced by the previous publish is not reclaimed yet
+ *
+ * @note Called by the configuration task
+ */
+extern int mbswap_publish(struct mbswap_s *swap, struct mbswap_set_s *set);
+
+/**
+ * @brief Take back the set replaced by the last publish once no worker uses it
+ *
+ * @param swap Swap
+ *
+ * @return Replaced set, free to modify or release, or NULL while a worker
+ *         still uses it (or nothing was replaced)
+ *
+ * @note Called by the configuration task, e.g. periodically after a publish
+ */
+extern struct mbswap_set_s *mbswap_reclaim(struct mbswap_s *swap);
+
+/**
+ * @brief Start a request on the published map set
+ *
+ * Copies the maps of the published set to inst when they changed since the
+ * last request of the worker. The response cache, read plans and function
+ * register values of inst are then dropped.
+ *
+ * @param swap Swap
+ * @param reader_ix Reader of the worker, below n_readers
+ * @param inst Worker instance
+ *
+ * @note Called by the worker before handling a request, must be followed by mbswap_exit()
+ */
+extern void mbswap_enter(struct mbswap_s *swap, size_t reader_ix, struct mbinst_s *inst);
+
+/**
+ * @brief Finish a request, the worker no longer uses the set
+ *
+ * @param swap Swap
+ * @param reader_ix Reader of the worker
+ *
+ * @note A deferred response (MB_PENDING) keeps using the set, exit once it is completed
+ */
+extern void mbswap_exit(struct mbswap_s *swap, size_t reader_ix);
+
+#endif /* MBSWAP_H_INCLUDED */
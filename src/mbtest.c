@@ -92,6 +92,12 @@ extern int mbtest_coils_valid_access(
 					return 0;
 				}
 				break;
+			case MCACC_R_BULK:
+				if (coil->read.bulk == NULL) {
+					if (issue_addr) *issue_addr = coil->address;
+					return 0;
+				}
+				break;
 			default:
 				/* Multiple read access methods specified */
 				if (issue_addr) *issue_addr = coil->address;
@@ -114,6 +120,12 @@ extern int mbtest_coils_valid_access(
 					return 0;
 				}
 				break;
+			case MCACC_W_BULK:
+				if (coil->write.bulk == NULL) {
+					if (issue_addr) *issue_addr = coil->address;
+					return 0;
+				}
+				break;
 			default:
 				/* Multiple write access methods specified */
 				if (issue_addr) *issue_addr = coil->address;
@@ -167,6 +179,9 @@ extern int mbtest_coils_no_duplicates(
 
 	if (!coils || !n_coils) return 1;
 
+	/* Ascending addresses have no duplicates, only unsorted maps are searched */
+	if (mbtest_coils_asc(coils, n_coils, NULL)) return 1;
+
 	for (i=0; i<n_coils; ++i) {
 		for (j=i+1; j<n_coils; ++j) {
 			if (coils[i].address == coils[j].address) {
@@ -179,6 +194,60 @@ extern int mbtest_coils_no_duplicates(
 	return 1;
 }
 
+extern int mbtest_coils_dont_overlap(
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils,
+	uint16_t *issue_addr)
+{
+	size_t i, end, prev_end;
+
+	if (!coils || !n_coils) return 1;
+
+	prev_end = 0;
+	for (i=0; i<n_coils; ++i) {
+		end = (size_t)coils[i].address
+			+ ((coils[i].n_block_entries > 1) ? coils[i].n_block_entries : 1);
+
+		/* Blocks must not cover a following coil or run past the address space */
+		if ((coils[i].address < prev_end) || (end > 0x10000u)) {
+			if (issue_addr) *issue_addr = coils[i].address;
+			return 0;
+		}
+		prev_end = end;
+	}
+
+	return 1;
+}
+
+extern int mbtest_coils_valid_block_access(
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils,
+	uint16_t *issue_addr)
+{
+	const struct mbcoil_desc_s *coil;
+	size_t i;
+
+	if (!coils || !n_coils) return 1;
+
+	for (i=0; i<n_coils; ++i) {
+		coil = coils+i;
+		if (coil->n_block_entries > 1) {
+			if ((coil->access & MCACC_R_MASK)
+				&& !(coil->access & (MCACC_R_PTR|MCACC_R_BULK))) {
+				if (issue_addr) *issue_addr = coil->address;
+				return 0;
+			}
+			if ((coil->access & MCACC_W_MASK)
+				&& !(coil->access & (MCACC_W_PTR|MCACC_W_BULK))) {
+				if (issue_addr) *issue_addr = coil->address;
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
 extern int mbtest_coils_validate_all(
 	const struct mbcoil_desc_s *coils,
 	size_t n_coils,
@@ -189,6 +258,8 @@ extern int mbtest_coils_validate_all(
 	if (!mbtest_coils_valid_access(coils, n_coils, issue_addr)) return 0;
 	if (!mbtest_coils_valid_bit_index(coils, n_coils, issue_addr)) return 0;
 	if (!mbtest_coils_no_duplicates(coils, n_coils, issue_addr)) return 0;
+	if (!mbtest_coils_dont_overlap(coils, n_coils, issue_addr)) return 0;
+	if (!mbtest_coils_valid_block_access(coils, n_coils, issue_addr)) return 0;
 
 	return 1;
 }
@@ -335,6 +406,12 @@ extern int mbtest_regs_valid_access(
 					return 0;
 				}
 				break;
+			case MRACC_R_BULK:
+				if (reg->read.bulk == NULL) {
+					if (issue_addr) *issue_addr = reg->address;
+					return 0;
+				}
+				break;
 			default: /* Make sure there is one and only one access method */
 				if (issue_addr) *issue_addr = reg->address;
 				return 0;
@@ -364,6 +441,12 @@ extern int mbtest_regs_valid_access(
 					return 0;
 				}
 				break;
+			case MRACC_W_BULK:
+				if (reg->write.bulk == NULL) {
+					if (issue_addr) *issue_addr = reg->address;
+					return 0;
+				}
+				break;
 			default: /* Make sure there is one and only one access method */
 				if (issue_addr) *issue_addr = reg->address;
 				return 0;
@@ -396,11 +479,11 @@ extern int mbtest_regs_valid_block_access(
 	for (i=0; i<n_regs; ++i) {
 		reg = regs+i;
 		if (reg->type & MRTYPE_BLOCK) {
-			if ((reg->access & MRACC_R_MASK) && !(reg->access & MRACC_R_PTR)) {
+			if ((reg->access & MRACC_R_MASK) && !(reg->access & (MRACC_R_PTR|MRACC_R_BULK))) {
 				*issue_addr = reg->address;
 				return 0;
 			}
-			if ((reg->access & MRACC_W_MASK) && !(reg->access & MRACC_W_PTR)) {
+			if ((reg->access & MRACC_W_MASK) && !(reg->access & (MRACC_W_PTR|MRACC_W_BULK))) {
 				*issue_addr = reg->address;
 				return 0;
 			}
@@ -85,6 +85,26 @@ extern int mbtest_coils_no_duplicates(
 	size_t n_coils,
 	uint16_t *issue_addr);
 
+/**
+ * @brief Check that no block coil descriptors overlap following coils
+ * @param issue_addr Optional - e.g. printf("0x%04x\n", issue_addr);
+ * @return 1 success, 0 failure
+ */
+extern int mbtest_coils_dont_overlap(
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils,
+	uint16_t *issue_addr);
+
+/**
+ * @brief Check if all coil block accesses are valid (pointer or bulk)
+ * @param issue_addr Optional - e.g. printf("0x%04x\n", issue_addr);
+ * @return 1 success, 0 failure
+ */
+extern int mbtest_coils_valid_block_access(
+	const struct mbcoil_desc_s *coils,
+	size_t n_coils,
+	uint16_t *issue_addr);
+
 /**
  * @brief Comprehensive coil validation - runs all coil tests
  * @param issue_addr Optional - e.g. printf("0x%04x\n", issue_addr);
@@ -0,0 +1,135 @@
+/**
+ * @file mbtrace.c
+ * @brief Modbus Trace - Binary event ring for field profiling
+ * @author Jonas Almås
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#include "mbtrace.h"
+#include "mbatomic.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+extern int mbtrace_init(
+	struct mbtrace_s *trace,
+	struct mbtrace_rec_s *recs,
+	uint32_t n_recs,
+	uint64_t (*clock_cb)(void))
+{
+	if (trace==NULL) return 0;
+
+	trace->clock_cb = NULL;
+	trace->recs = NULL;
+	trace->n_recs = 0u;
+	trace->head = 0u;
+
+	if ((recs==NULL) || (n_recs==0u) || ((n_recs & (n_recs-1u)) != 0u)) return 0;
+
+	trace->recs = recs;
+	trace->n_recs = n_recs;
+	trace->clock_cb = clock_cb;
+	return 1;
+}
+
+extern size_t mbtrace_read(
+	const struct mbtrace_s *trace,
+	uint32_t *pos,
+	struct mbtrace_rec_s *out,
+	size_t n_max)
+{
+	uint32_t head, first, safe;
+	size_t n, i;
+
+	if ((trace==NULL) || (pos==NULL) || (out==NULL) || (trace->recs==NULL)) return 0u;
+
+	head = trace->head;
+	MBATOMIC_FENCE(); /* Records complete before they are copied */
+
+	first = *pos;
+	/* The slot of record head is the oldest one, the writer may be filling it */
+	if ((head - first) >= trace->n_recs) first = head - trace->n_recs + 1u;
+	n = (size_t)(head - first);
+	if (n > n_max) n = n_max;
+
+	for (i=0u; i<n; ++i) {
+		out[i] = trace->recs[(first + (uint32_t)i) & (trace->n_recs - 1u)];
+	}
+
+	/* Drop what the writer passed while copying */
+	MBATOMIC_FENCE();
+	head = trace->head;
+	safe = head - trace->n_recs + 1u;
+	if ((n > 0u) && ((int32_t)(safe - first) > 0)) {
+		i = (size_t)(safe - first);
+		if (i > n) i = n;
+		n -= i;
+		(void)memmove(out, out + i, n * sizeof out[0]);
+		first += (uint32_t)i;
+	}
+
+	*pos = first + (uint32_t)n;
+	return n;
+}
+
+#if MBCFG_TRACE
+extern uint64_t mbtrace_now(const struct mbtrace_s *trace)
+{
+	return ((trace!=NULL) && (trace->clock_cb!=NULL)) ? trace->clock_cb() : 0u;
+}
+
+extern void mbtrace_emit(
+	struct mbtrace_s *trace,
+	enum mbtrace_ev_e ev,
+	uint8_t fc,
+	uint16_t addr,
+	uint64_t t_start)
+{
+	struct mbtrace_rec_s *rec;
+	uint32_t head;
+
+	if ((trace==NULL) || (trace->clock_cb==NULL) || (trace->recs==NULL)) return;
+
+	head = trace->head;
+	rec = &trace->recs[head & (trace->n_recs - 1u)];
+	rec->t = (uint32_t)t_start;
+	rec->dur = (uint32_t)(trace->clock_cb() - t_start);
+	rec->addr = addr;
+	rec->fc = fc;
+	rec->ev = (uint8_t)ev;
+
+	MBATOMIC_FENCE(); /* Record complete before it is published */
+	trace->head = head + 1u;
+}
+
+extern void mbtrace_call(struct mbtrace_s *trace, uint8_t fc, uint16_t addr, void (*cb)(void))
+{
+	uint64_t t_start = mbtrace_now(trace);
+
+	cb();
+	mbtrace_emit(trace, MBTRACE_EV_CB, fc, addr, t_start);
+}
+#endif /* MBCFG_TRACE */
@@ -0,0 +1,161 @@
+/**
+ * @file mbtrace.h
+ * @brief Modbus Trace - Binary event ring for field profiling
+ * @author Jonas Almås
+ *
+ * @details Optional field tracing of a Modbus instance. Request handling,
+ * descriptor lookups, application callbacks and ADU handling append a fixed
+ * size binary record with timestamp, function code, address and duration to a
+ * ring supplied by the application, which a diagnostics task drains at its own
+ * pace with mbtrace_read(). The instance is the only writer, so recording is a
+ * few stores and no locks.
+ *
+ * With MBCFG_TRACE set to 0 (the default) the hooks compile to nothing and
+ * mbinst_s has no trace field.
+ */
+
+/*
+ * Copyright (c) 2025 Siemens Energy AS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+ * EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+ * (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+ */
+
+#ifndef MBTRACE_H_INCLUDED
+#define MBTRACE_H_INCLUDED
+
+#include "mbconfig.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Kind of a traced event
+ */
+enum mbtrace_ev_e {
+	MBTRACE_EV_ADU = 1u, /**< Frame handled by the ADU layer, addr is the slave address or unit id */
+	MBTRACE_EV_REQ, /**< Request handled by the PDU layer, addr is the start address of the request */
+	MBTRACE_EV_LOOKUP, /**< Descriptor lookup of the start address */
+	MBTRACE_EV_CB, /**< Application callback (fn/bulk read, post_write_cb, commit callbacks) */
+};
+
+/**
+ * @brief One trace record
+ *
+ * Events are recorded when they end, so the events of a request precede its
+ * MBTRACE_EV_REQ record, which precedes the MBTRACE_EV_ADU record of the frame.
+ */
+struct mbtrace_rec_s {
+	uint32_t t; /**< Start of the event, lower 32 bits of clock_cb */
+	uint32_t dur; /**< Duration of the event in clock_cb units */
+	uint16_t addr; /**< Register, coil or file address, see mbtrace_ev_e */
+	uint8_t fc; /**< Function code of the request, 0 where shared by several (commit_regs_write_cb) */
+	uint8_t ev; /**< Kind of event, see mbtrace_ev_e */
+};
+
+/**
+ * @brief Trace ring of one Modbus instance
+ *
+ * @note Written by the instance only, give each worker instance its own ring
+ * @note Shall not be accessed by client code directly, set up with mbtrace_init()
+ */
+struct mbtrace_s {
+	uint64_t (*clock_cb)(void); /**< Monotonic clock, events are not recorded when NULL */
+	struct mbtrace_rec_s *recs; /**< Ring storage */
+	uint32_t n_recs; /**< Ring size, a power of two */
+	volatile uint32_t head; /**< Number of records written since mbtrace_init() */
+};
+
+/**
+ * @brief Set up a trace ring
+ *
+ * @param trace Ring to initialize
+ * @param recs Storage for the records
+ * @param n_recs Number of records in recs, a power of two
+ * @param clock_cb Monotonic clock in any unit (e.g. CPU cycles)
+ *
+ * @retval 1 Ring set up
+ * @retval 0 Invalid parameters, nothing is recorded
+ */
+extern int mbtrace_init(
+	struct mbtrace_s *trace,
+	struct mbtrace_rec_s *recs,
+	uint32_t n_recs,
+	uint64_t (*clock_cb)(void));
+
+/**
+ * @brief Copy new records from a trace ring
+ *
+ * May run in another thread or interrupt than the instance, the ring holds
+ * n_recs-1 records not yet overwritten. Records
+ * overwritten before they were read are skipped, which shows as a jump of
+ * pos by more than the number of records returned.
+ *
+ * @param trace Ring to read
+ * @param pos Read position, start at 0 and keep between calls
+ * @param out Destination of the records, oldest first
+ * @param n_max Maximum number of records to copy
+ *
+ * @return Number of records copied to out
+ */
+extern size_t mbtrace_read(
+	const struct mbtrace_s *trace,
+	uint32_t *pos,
+	struct mbtrace_rec_s *out,
+	size_t n_max);
+
+#if MBCFG_TRACE
+/**
+ * @brief Current time of the clock, 0 without trace or clock
+ *
+ * @note Library internal function
+ */
+extern uint64_t mbtrace_now(const struct mbtrace_s *trace);
+
+/**
+ * @brief Record an event that started at t_start
+ *
+ * @param trace Ring (Can be NULL)
+ * @param ev Kind of event, see mbtrace_ev_e
+ * @param fc Function code of the request
+ * @param addr Address of the event
+ * @param t_start Result of mbtrace_now() when the event started
+ *
+ * @note Library internal function
+ */
+extern void mbtrace_emit(
+	struct mbtrace_s *trace,
+	enum mbtrace_ev_e ev,
+	uint8_t fc,
+	uint16_t addr,
+	uint64_t t_start);
+
+/**
+ * @brief Call an application callback and record it as MBTRACE_EV_CB
+ *
+ * @note Library internal function
+ */
+extern void mbtrace_call(struct mbtrace_s *trace, uint8_t fc, uint16_t addr, void (*cb)(void));
+#else
+#define mbtrace_now(trace) (0u)
+#define mbtrace_emit(trace, ev, fc, addr, t_start) ((void)(ev), (void)(fc), (void)(addr), (void)(t_start))
+#define mbtrace_call(trace, fc, addr, cb) ((void)(fc), (void)(addr), (cb)())
+#endif
+
+#endif /* MBTRACE_H_INCLUDED */
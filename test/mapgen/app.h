@@ -0,0 +1,26 @@
+#ifndef APP_H_INCLUDED
+#define APP_H_INCLUDED
+
+#include "mbdef.h"
+#include <stdint.h>
+
+/* Sources of the registers in devmap.csv and devmap.json */
+struct app_s {
+	uint16_t setpoints[2];
+	float gain;
+	uint32_t serial;
+};
+
+struct meas_s {
+	float voltage;
+	uint64_t energy;
+};
+
+extern struct app_s app;
+extern struct meas_s meas;
+
+extern void on_gain(void);
+extern uint16_t read_speed(void);
+extern enum mbstatus_e write_speed(uint16_t speed);
+
+#endif /* APP_H_INCLUDED */
@@ -0,0 +1,94 @@
+#include "test_lib.h"
+#include "app.h"
+#include "devmap.h"
+#include <mbinst.h>
+#include <mbpdu.h>
+
+struct app_s app;
+struct meas_s meas;
+
+static int s_n_gain_writes;
+static uint16_t s_speed;
+
+extern void on_gain(void)
+{
+	++s_n_gain_writes;
+}
+
+extern uint16_t read_speed(void)
+{
+	return s_speed;
+}
+
+extern enum mbstatus_e write_speed(uint16_t speed)
+{
+	s_speed = speed;
+	return MB_OK;
+}
+
+TEST(mbmapgen_tables_validate)
+{
+	uint16_t issue_addr = 0xFFFFu;
+
+	ASSERT_EQ(1, dev_validate(&issue_addr));
+	ASSERT_EQ(5u, dev_n_hold_regs); /* Setpoints merged into one block */
+	ASSERT_EQ(1u, dev_n_input_regs); /* Hot rows served by one bulk callback */
+}
+
+TEST(mbmapgen_writes_reach_sources)
+{
+	struct mbinst_s inst = {.hold_regs=dev_hold_regs, .n_hold_regs=dev_n_hold_regs};
+	const uint8_t req[] = {MBFC_WRITE_MULTIPLE_REGS, 0x00, 0x00, 0x00, 0x02, 0x04, 0x12, 0x34, 0x56, 0x78};
+	const uint8_t gain_req[] = {MBFC_WRITE_MULTIPLE_REGS, 0x00, 0x10, 0x00, 0x02, 0x04, 0x3F, 0x80, 0x00, 0x00};
+	const uint8_t speed_req[] = {MBFC_WRITE_SINGLE_REG, 0x00, 0x20, 0x0B, 0xB8};
+	uint8_t res[MBPDU_SIZE_MAX];
+	mbinst_init(&inst);
+
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(0x1234u, app.setpoints[0]);
+	ASSERT_EQ(0x5678u, app.setpoints[1]);
+
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, gain_req, sizeof gain_req, res));
+	ASSERT(app.gain == 1.0f);
+	ASSERT_EQ(1, s_n_gain_writes);
+
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, speed_req, sizeof speed_req, res));
+	ASSERT_EQ(3000u, s_speed);
+}
+
+TEST(mbmapgen_reads_hot_range_and_byte_order)
+{
+	struct mbinst_s inst = {
+		.hold_regs=dev_hold_regs,
+		.n_hold_regs=dev_n_hold_regs,
+		.input_regs=dev_input_regs,
+		.n_input_regs=dev_n_input_regs,
+	};
+	const uint8_t input_req[] = {MBFC_READ_INPUT_REGS, 0x00, 0x01, 0x00, 0x03};
+	const uint8_t serial_req[] = {MBFC_READ_HOLDING_REGS, 0x00, 0x40, 0x00, 0x02};
+	uint8_t res[MBPDU_SIZE_MAX];
+	mbinst_init(&inst);
+
+	meas.voltage = 1.0f; /* 0x3F800000 */
+	meas.energy = 0x0102030405060708u;
+	ASSERT_EQ(8u, mbpdu_handle_req(&inst, input_req, sizeof input_req, res));
+	ASSERT_EQ(0x00u, res[2]); /* Low word of the voltage */
+	ASSERT_EQ(0x00u, res[3]);
+	ASSERT_EQ(0x01u, res[4]); /* High words of the energy */
+	ASSERT_EQ(0x02u, res[5]);
+	ASSERT_EQ(0x03u, res[6]);
+	ASSERT_EQ(0x04u, res[7]);
+
+	app.serial = 0x11223344u;
+	ASSERT_EQ(6u, mbpdu_handle_req(&inst, serial_req, sizeof serial_req, res));
+	ASSERT_EQ(0x33u, res[2]); /* CDAB, low word first */
+	ASSERT_EQ(0x44u, res[3]);
+	ASSERT_EQ(0x11u, res[4]);
+	ASSERT_EQ(0x22u, res[5]);
+}
+
+TEST_MAIN(
+	mbmapgen_tables_validate,
+	mbmapgen_writes_reach_sources,
+	mbmapgen_reads_hot_range_and_byte_order
+);
@@ -1,5 +1,6 @@
 #include "test_lib.h"
 #include <mbadu_ascii.h>
+#include <string.h>
 
 TEST(mbadu_ascii_works)
 {
@@ -378,6 +379,181 @@ TEST(mbadu_ascii_high_slave_address)
 	ASSERT_EQ('8', tx_buf[10]); /* Data */
 }
 
+TEST(mbadu_ascii_buf_writes_after_headroom)
+{
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x10u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=0x1234}},
+	};
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=sizeof regs / sizeof regs[0],
+		.serial={.slave_addr=1u}
+	};
+	mbinst_init(&inst);
+
+	uint8_t tx_buf[3u+MBADU_ASCII_SIZE_MAX] = {0};
+	uint8_t rx_buf[] = ":010300100001EB\r\n";
+	struct mbadu_buf_s res = {.p=tx_buf, .size=sizeof tx_buf, .head=3u};
+
+	size_t res_size = mbadu_ascii_handle_req_buf(&inst, rx_buf, (sizeof rx_buf)-1, &res);
+	ASSERT_EQ(15u, res_size);
+	ASSERT_EQ(15u, res.len);
+	ASSERT_EQ(0x00, tx_buf[2]);
+	ASSERT_EQ(':', tx_buf[3]);
+	ASSERT_EQ('B', tx_buf[3u+11u]); /* LRC H */
+	ASSERT_EQ('\n', tx_buf[3u+14u]);
+
+	res.head = 4u;
+	ASSERT_EQ(0u, mbadu_ascii_handle_req_buf(&inst, rx_buf, (sizeof rx_buf)-1, &res));
+}
+
+TEST(mbadu_ascii_hex_boundary_chars_rejected)
+{
+	uint8_t tx_buf[MBADU_ASCII_SIZE_MAX];
+	struct mbinst_s inst = {.serial={.slave_addr=1u}};
+	mbinst_init(&inst);
+
+	/* Characters next to the hex digit ranges */
+	const uint8_t bad[] = {'/', ':', '@', 'G', '`', 'g', 0x80u, 0xFFu};
+	for (size_t i=0u; i<sizeof bad; ++i) {
+		uint8_t rx_buf[] = ":010300100001EB\r\n";
+		rx_buf[4] = bad[i];
+		ASSERT_EQ(0u, mbadu_ascii_handle_req(&inst, rx_buf, (sizeof rx_buf)-1, tx_buf));
+	}
+
+	/* Not counted as communication errors */
+	ASSERT_EQ(0u, inst.state.bus_comm_err_counter);
+}
+
+TEST(mbadu_ascii_invalid_lrc_counted)
+{
+	uint8_t tx_buf[MBADU_ASCII_SIZE_MAX];
+	struct mbinst_s inst = {.serial={.slave_addr=1u}};
+	mbinst_init(&inst);
+
+	uint8_t rx_buf[] = ":010300100001EC\r\n";
+	ASSERT_EQ(0u, mbadu_ascii_handle_req(&inst, rx_buf, (sizeof rx_buf)-1, tx_buf));
+	ASSERT_EQ(1u, inst.state.bus_comm_err_counter);
+}
+
+TEST(mbadu_ascii_response_lrc_all_byte_values)
+{
+	uint16_t vals[4] = {0};
+	const struct mbreg_desc_s regs[] = {
+		{
+			.address=0x00u,
+			.type=MRTYPE_U16 | MRTYPE_BLOCK,
+			.access=MRACC_RW_PTR,
+			.read={.pu16=vals},
+			.write={.pu16=vals},
+			.n_block_entries=4u,
+		}
+	};
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=1u,
+		.serial={.slave_addr=1u}
+	};
+	mbinst_init(&inst);
+
+	uint8_t tx_buf[MBADU_ASCII_SIZE_MAX];
+	/* Read 4 registers with high and low nibble extremes */
+	vals[0] = 0x00FFu;
+	vals[1] = 0xF00Fu;
+	vals[2] = 0x9AA9u;
+	vals[3] = 0x5A0Fu;
+	uint8_t rx_buf[] = ":010300000004F8\r\n";
+
+	size_t res_size = mbadu_ascii_handle_req(&inst, rx_buf, (sizeof rx_buf)-1, tx_buf);
+	ASSERT_EQ(27u, res_size);
+	ASSERT(memcmp(tx_buf, ":01030800FFF00F9AA95A0F", 23u)==0);
+
+	/* LRC: -(01+03+08+00+FF+F0+0F+9A+A9+5A+0F) */
+	uint8_t sum = (uint8_t)((0x01u+0x03u+0x08u+0x00u+0xFFu+0xF0u+0x0Fu+0x9Au+0xA9u+0x5Au+0x0Fu) & 0xFFu);
+	const char *hex = "0123456789ABCDEF";
+	sum = (uint8_t)(0u-sum);
+	ASSERT_EQ(hex[sum>>4], tx_buf[23]);
+	ASSERT_EQ(hex[sum&0x0Fu], tx_buf[24]);
+}
+
+static size_t to_ascii(const uint8_t *bin, size_t n, uint8_t *out)
+{
+	const char *hex = "0123456789ABCDEF";
+	uint8_t sum = 0u;
+	size_t len = 0u;
+
+	out[len++] = ':';
+	for (size_t i=0u; i<n; ++i) {
+		out[len++] = (uint8_t)hex[bin[i]>>4];
+		out[len++] = (uint8_t)hex[bin[i]&0x0Fu];
+		sum = (uint8_t)(sum + bin[i]);
+	}
+	sum = (uint8_t)(0u-sum);
+	out[len++] = (uint8_t)hex[sum>>4];
+	out[len++] = (uint8_t)hex[sum&0x0Fu];
+	out[len++] = '\r';
+	out[len++] = '\n';
+	return len;
+}
+
+TEST(mbadu_ascii_max_size_write_and_read)
+{
+	uint16_t vals[125] = {0};
+	const struct mbreg_desc_s regs[] = {
+		{
+			.address=0x00u,
+			.type=MRTYPE_U16 | MRTYPE_BLOCK,
+			.access=MRACC_RW_PTR,
+			.read={.pu16=vals},
+			.write={.pu16=vals},
+			.n_block_entries=125u,
+		}
+	};
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=1u,
+		.serial={.slave_addr=1u}
+	};
+	mbinst_init(&inst);
+
+	uint8_t bin[1u+MBPDU_SIZE_MAX];
+	uint8_t rx_buf[MBADU_ASCII_SIZE_MAX];
+	uint8_t tx_buf[MBADU_ASCII_SIZE_MAX];
+	size_t n = 0u, res_size;
+
+	/* Largest write: 123 registers */
+	bin[n++] = 0x01u;
+	bin[n++] = MBFC_WRITE_MULTIPLE_REGS;
+	bin[n++] = 0x00u; bin[n++] = 0x00u;
+	bin[n++] = 0x00u; bin[n++] = 123u;
+	bin[n++] = 246u;
+	for (size_t i=0u; i<123u; ++i) {
+		bin[n++] = (uint8_t)i;
+		bin[n++] = (uint8_t)(0xFFu-i);
+	}
+	ASSERT_EQ(253u, n);
+
+	res_size = mbadu_ascii_handle_req(&inst, rx_buf, to_ascii(bin, n, rx_buf), tx_buf);
+	ASSERT_EQ(17u, res_size);
+	ASSERT_EQ(0x00FFu, vals[0]);
+	ASSERT_EQ(0x7A85u, vals[122]);
+
+	/* Largest read: 125 registers */
+	const uint8_t read_bin[] = {0x01u, MBFC_READ_HOLDING_REGS, 0x00u, 0x00u, 0x00u, 125u};
+	res_size = mbadu_ascii_handle_req(&inst, rx_buf, to_ascii(read_bin, sizeof read_bin, rx_buf), tx_buf);
+
+	n = 0u;
+	bin[n++] = 0x01u;
+	bin[n++] = MBFC_READ_HOLDING_REGS;
+	bin[n++] = 250u;
+	for (size_t i=0u; i<125u; ++i) {
+		bin[n++] = (uint8_t)(vals[i]>>8);
+		bin[n++] = (uint8_t)vals[i];
+	}
+	ASSERT_EQ(to_ascii(bin, n, rx_buf), res_size);
+	ASSERT(memcmp(rx_buf, tx_buf, res_size)==0);
+}
+
 TEST_MAIN(
 	mbadu_ascii_works,
 	mbadu_ascii_null_pointers,
@@ -393,5 +569,10 @@ TEST_MAIN(
 	mbadu_ascii_invalid_lrc,
 	mbadu_ascii_lowercase_hex,
 	mbadu_ascii_mixed_case_hex,
-	mbadu_ascii_high_slave_address
+	mbadu_ascii_high_slave_address,
+	mbadu_ascii_buf_writes_after_headroom,
+	mbadu_ascii_hex_boundary_chars_rejected,
+	mbadu_ascii_invalid_lrc_counted,
+	mbadu_ascii_response_lrc_all_byte_values,
+	mbadu_ascii_max_size_write_and_read
 )
@@ -0,0 +1,328 @@
+#include "test_lib.h"
+#include <mbadu.h>
+#include <mbadu_stream.h>
+#include <mbadu_tcp.h>
+#include <mbcrc.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <string.h>
+
+enum {REQ_SIZE=12u, RES_SIZE=11u};
+
+static const struct mbreg_desc_s s_regs[] = {
+	{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=0x1234}},
+	{.address=0x01u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=0x5678}},
+};
+
+static void init_inst(struct mbinst_s *inst)
+{
+	memset(inst, 0, sizeof *inst);
+	inst->hold_regs = s_regs;
+	inst->n_hold_regs = sizeof s_regs / sizeof s_regs[0];
+	mbinst_init(inst);
+}
+
+static void make_req(uint8_t *req, uint8_t trans_id, uint8_t addr)
+{
+	const uint8_t frame[REQ_SIZE] = {
+		0x00, trans_id, /* Transaction ID */
+		0x00, 0x00, /* Protocol ID */
+		0x00, 0x06, /* Length */
+		0x01,       /* Unit ID */
+		MBFC_READ_HOLDING_REGS,
+		0x00, addr, /* Start addr */
+		0x00, 0x01, /* n read regs */
+	};
+	memcpy(req, frame, sizeof frame);
+}
+
+TEST(mbadu_stream_pipelined_frames_handled)
+{
+	struct mbinst_s inst;
+	struct mbadu_stream_s stream;
+	uint8_t data[2u*REQ_SIZE];
+	uint8_t res[2u*MBADU_TCP_SIZE_MAX];
+	size_t n_consumed, res_len;
+
+	init_inst(&inst);
+	mbadu_stream_init(&stream);
+	make_req(data, 1u, 0u);
+	make_req(data+REQ_SIZE, 2u, 1u);
+
+	ASSERT_EQ(MBADU_STREAM_OK, mbadu_stream_tcp_proc(&stream, &inst, data, sizeof data,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(sizeof data, n_consumed);
+	ASSERT_EQ(2u*RES_SIZE, res_len);
+
+	ASSERT_EQ(0x01, res[1]);
+	ASSERT_EQ(0x12, res[9]);
+	ASSERT_EQ(0x34, res[10]);
+	ASSERT_EQ(0x02, res[RES_SIZE+1u]);
+	ASSERT_EQ(0x56, res[RES_SIZE+9u]);
+	ASSERT_EQ(0x78, res[RES_SIZE+10u]);
+}
+
+TEST(mbadu_stream_split_frame_reassembled)
+{
+	struct mbinst_s inst;
+	struct mbadu_stream_s stream;
+	uint8_t data[REQ_SIZE];
+	uint8_t res[MBADU_TCP_SIZE_MAX];
+	size_t n_consumed, res_len;
+	/* Split inside MBAP header, after header and inside PDU */
+	const size_t splits[] = {0u, 3u, 7u, 9u, REQ_SIZE};
+
+	init_inst(&inst);
+	mbadu_stream_init(&stream);
+	make_req(data, 7u, 1u);
+
+	for (size_t i=0u; i<(sizeof splits / sizeof splits[0])-1u; ++i) {
+		size_t len = splits[i+1u]-splits[i];
+		ASSERT_EQ(MBADU_STREAM_OK, mbadu_stream_tcp_proc(&stream, &inst, data+splits[i], len,
+			&n_consumed, res, sizeof res, &res_len));
+		ASSERT_EQ(len, n_consumed);
+		if (splits[i+1u] < REQ_SIZE) {
+			ASSERT_EQ(0u, res_len);
+		}
+	}
+
+	ASSERT_EQ(RES_SIZE, res_len);
+	ASSERT_EQ(0x07, res[1]);
+	ASSERT_EQ(0x56, res[9]);
+	ASSERT_EQ(0x78, res[10]);
+}
+
+TEST(mbadu_stream_frame_and_partial_buffered)
+{
+	struct mbinst_s inst;
+	struct mbadu_stream_s stream;
+	uint8_t data[2u*REQ_SIZE];
+	uint8_t res[2u*MBADU_TCP_SIZE_MAX];
+	size_t n_consumed, res_len;
+
+	init_inst(&inst);
+	mbadu_stream_init(&stream);
+	make_req(data, 1u, 0u);
+	make_req(data+REQ_SIZE, 2u, 1u);
+
+	ASSERT_EQ(MBADU_STREAM_OK, mbadu_stream_tcp_proc(&stream, &inst, data, REQ_SIZE+5u,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(REQ_SIZE+5u, n_consumed);
+	ASSERT_EQ(RES_SIZE, res_len);
+
+	ASSERT_EQ(MBADU_STREAM_OK, mbadu_stream_tcp_proc(&stream, &inst, data+REQ_SIZE+5u, REQ_SIZE-5u,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(REQ_SIZE-5u, n_consumed);
+	ASSERT_EQ(RES_SIZE, res_len);
+	ASSERT_EQ(0x02, res[1]);
+}
+
+TEST(mbadu_stream_res_full_resumes)
+{
+	struct mbinst_s inst;
+	struct mbadu_stream_s stream;
+	uint8_t data[2u*REQ_SIZE];
+	uint8_t res[MBADU_TCP_SIZE_MAX];
+	size_t n_consumed, res_len;
+
+	init_inst(&inst);
+	mbadu_stream_init(&stream);
+	make_req(data, 1u, 0u);
+	make_req(data+REQ_SIZE, 2u, 1u);
+
+	ASSERT_EQ(MBADU_STREAM_RES_FULL, mbadu_stream_tcp_proc(&stream, &inst, data, sizeof data,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(REQ_SIZE, n_consumed);
+	ASSERT_EQ(RES_SIZE, res_len);
+	ASSERT_EQ(0x01, res[1]);
+
+	ASSERT_EQ(MBADU_STREAM_OK, mbadu_stream_tcp_proc(&stream, &inst, data+n_consumed, sizeof data-n_consumed,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(REQ_SIZE, n_consumed);
+	ASSERT_EQ(RES_SIZE, res_len);
+	ASSERT_EQ(0x02, res[1]);
+}
+
+TEST(mbadu_stream_buffered_frame_res_full_resumes)
+{
+	struct mbinst_s inst;
+	struct mbadu_stream_s stream;
+	uint8_t data[REQ_SIZE];
+	uint8_t res[MBADU_TCP_SIZE_MAX];
+	size_t n_consumed, res_len;
+
+	init_inst(&inst);
+	mbadu_stream_init(&stream);
+	make_req(data, 3u, 0u);
+
+	ASSERT_EQ(MBADU_STREAM_OK, mbadu_stream_tcp_proc(&stream, &inst, data, 4u,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(MBADU_STREAM_RES_FULL, mbadu_stream_tcp_proc(&stream, &inst, data+4u, REQ_SIZE-4u,
+		&n_consumed, res, MBADU_TCP_SIZE_MAX-1u, &res_len));
+	ASSERT_EQ(REQ_SIZE-4u, n_consumed);
+	ASSERT_EQ(0u, res_len);
+
+	/* Buffered frame is handled without new data */
+	ASSERT_EQ(MBADU_STREAM_OK, mbadu_stream_tcp_proc(&stream, &inst, NULL, 0u,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(0u, n_consumed);
+	ASSERT_EQ(RES_SIZE, res_len);
+	ASSERT_EQ(0x03, res[1]);
+}
+
+TEST(mbadu_stream_invalid_prot_id_malformed)
+{
+	struct mbinst_s inst;
+	struct mbadu_stream_s stream;
+	uint8_t data[2u*REQ_SIZE];
+	uint8_t res[2u*MBADU_TCP_SIZE_MAX];
+	size_t n_consumed, res_len;
+
+	init_inst(&inst);
+	mbadu_stream_init(&stream);
+	make_req(data, 1u, 0u);
+	make_req(data+REQ_SIZE, 2u, 1u);
+	data[REQ_SIZE+MBAP_POS_PROT_ID+1u] = 0x01;
+
+	ASSERT_EQ(MBADU_STREAM_MALFORMED, mbadu_stream_tcp_proc(&stream, &inst, data, sizeof data,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(REQ_SIZE, n_consumed);
+	ASSERT_EQ(RES_SIZE, res_len);
+}
+
+TEST(mbadu_stream_invalid_len_malformed)
+{
+	struct mbinst_s inst;
+	struct mbadu_stream_s stream;
+	uint8_t data[REQ_SIZE];
+	uint8_t res[MBADU_TCP_SIZE_MAX];
+	size_t n_consumed, res_len;
+
+	init_inst(&inst);
+	mbadu_stream_init(&stream);
+	make_req(data, 1u, 0u);
+	data[MBAP_POS_LEN] = 0xFF;
+
+	/* Detected once the buffered header is complete */
+	ASSERT_EQ(MBADU_STREAM_OK, mbadu_stream_tcp_proc(&stream, &inst, data, 3u,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(MBADU_STREAM_MALFORMED, mbadu_stream_tcp_proc(&stream, &inst, data+3u, REQ_SIZE-3u,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(0u, res_len);
+}
+
+TEST(mbadu_stream_null_args_fail)
+{
+	struct mbinst_s inst;
+	struct mbadu_stream_s stream;
+	uint8_t data[REQ_SIZE];
+	uint8_t res[MBADU_TCP_SIZE_MAX];
+	size_t n_consumed, res_len;
+
+	init_inst(&inst);
+	mbadu_stream_init(&stream);
+	make_req(data, 1u, 0u);
+
+	ASSERT_EQ(MBADU_STREAM_MALFORMED, mbadu_stream_tcp_proc(NULL, &inst, data, sizeof data,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(MBADU_STREAM_MALFORMED, mbadu_stream_tcp_proc(&stream, NULL, data, sizeof data,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(MBADU_STREAM_MALFORMED, mbadu_stream_tcp_proc(&stream, &inst, NULL, sizeof data,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(MBADU_STREAM_MALFORMED, mbadu_stream_tcp_proc(&stream, &inst, data, sizeof data,
+		&n_consumed, NULL, sizeof res, &res_len));
+}
+
+static size_t make_rtu_req(uint8_t *req, const uint8_t *pdu, size_t pdu_len)
+{
+	uint16_t crc;
+
+	req[0] = 0x01u; /* Slave address */
+	memcpy(req+1u, pdu, pdu_len);
+	crc = mbcrc16(req, 1u+pdu_len);
+	req[1u+pdu_len] = (uint8_t)crc;
+	req[2u+pdu_len] = (uint8_t)(crc >> 8);
+	return 3u+pdu_len;
+}
+
+TEST(mbadu_stream_rtu_frames_reassembled)
+{
+	static uint16_t hold = 0u;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&hold}, .write={.pu16=&hold}},
+	};
+	const uint8_t rd[] = {MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x01};
+	const uint8_t wr[] = {MBFC_WRITE_MULTIPLE_REGS, 0x00, 0x00, 0x00, 0x01, 0x02, 0xAB, 0xCD};
+	struct mbinst_s inst = {.hold_regs=regs, .n_hold_regs=1u, .serial={.slave_addr=1u}};
+	struct mbadu_stream_s stream;
+	uint8_t data[64];
+	uint8_t res[4u*MBADU_SIZE_MAX];
+	size_t len, i, n_consumed, res_len, total;
+
+	mbinst_init(&inst);
+	mbadu_stream_init(&stream);
+	len = make_rtu_req(data, wr, sizeof wr);
+	len += make_rtu_req(data+len, rd, sizeof rd);
+
+	/* Pipelined in one segment */
+	ASSERT_EQ(MBADU_STREAM_OK, mbadu_stream_rtu_proc(&stream, &inst, data, len,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(len, n_consumed);
+	ASSERT_EQ(8u + 7u, res_len);
+	ASSERT_EQ(MBFC_WRITE_MULTIPLE_REGS, res[1]);
+	ASSERT_EQ(MBFC_READ_HOLDING_REGS, res[9]);
+	ASSERT_EQ(0xABu, res[11]);
+	ASSERT_EQ(0xCDu, res[12]);
+	ASSERT_EQ(0u, mbcrc16(res+8u, 7u));
+
+	/* One byte at a time */
+	total = 0u;
+	for (i=0u; i<len; ++i) {
+		ASSERT_EQ(MBADU_STREAM_OK, mbadu_stream_rtu_proc(&stream, &inst, data+i, 1u,
+			&n_consumed, res+total, sizeof res - total, &res_len));
+		ASSERT_EQ(1u, n_consumed);
+		total += res_len;
+	}
+	ASSERT_EQ(8u + 7u, total);
+	ASSERT_EQ(0u, stream.n);
+}
+
+TEST(mbadu_stream_rtu_crc_error_malformed)
+{
+	const uint8_t rd[] = {MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x01};
+	const uint8_t custom[] = {0x41u, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+	struct mbinst_s inst;
+	struct mbadu_stream_s stream;
+	uint8_t data[16];
+	uint8_t res[MBADU_SIZE_MAX];
+	size_t len, n_consumed, res_len;
+
+	init_inst(&inst);
+	inst.serial.slave_addr = 1u;
+	mbadu_stream_init(&stream);
+	len = make_rtu_req(data, rd, sizeof rd);
+	data[len-1u] ^= 0xFFu;
+
+	ASSERT_EQ(MBADU_STREAM_MALFORMED, mbadu_stream_rtu_proc(&stream, &inst, data, len,
+		&n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(0u, res_len);
+
+	/* No way to find the end of a custom function code */
+	mbadu_stream_init(&stream);
+	len = make_rtu_req(data, custom, sizeof custom);
+	ASSERT_EQ(MBADU_STREAM_MALFORMED, mbadu_stream_rtu_proc(&stream, &inst, data, len,
+		&n_consumed, res, sizeof res, &res_len));
+}
+
+TEST_MAIN(
+	mbadu_stream_pipelined_frames_handled,
+	mbadu_stream_split_frame_reassembled,
+	mbadu_stream_frame_and_partial_buffered,
+	mbadu_stream_res_full_resumes,
+	mbadu_stream_buffered_frame_res_full_resumes,
+	mbadu_stream_invalid_prot_id_malformed,
+	mbadu_stream_invalid_len_malformed,
+	mbadu_stream_null_args_fail,
+	mbadu_stream_rtu_frames_reassembled,
+	mbadu_stream_rtu_crc_error_malformed
+);
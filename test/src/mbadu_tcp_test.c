@@ -499,6 +499,167 @@ TEST(mbadu_tcp_exactly_min_size_works)
 	ASSERT(res_size >= 0); /* May be 0 or error response */
 }
 
+TEST(mbadu_tcp_buf_writes_after_headroom)
+{
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=0x1234}},
+	};
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=sizeof regs / sizeof regs[0],
+	};
+	mbinst_init(&inst);
+
+	uint8_t rx_buf[] = {
+		0x00, 0x01, /* Transaction ID */
+		0x00, 0x00, /* Protocol ID */
+		0x00, 0x06, /* Length */
+		0x01,       /* Unit ID */
+		MBFC_READ_HOLDING_REGS,
+		0x00, 0x00, /* Start addr */
+		0x00, 0x01, /* n read regs */
+	};
+	uint8_t sock_buf[2u+MBADU_TCP_SIZE_MAX] = {0};
+	struct mbadu_buf_s res = {.p=sock_buf, .size=sizeof sock_buf, .head=2u};
+
+	size_t res_size = mbadu_tcp_handle_req_buf(&inst, rx_buf, sizeof rx_buf, &res);
+	ASSERT_EQ(11u, res_size);
+	ASSERT_EQ(11u, res.len);
+	ASSERT_EQ(0x00, sock_buf[1]);
+	ASSERT_EQ(0x01, sock_buf[3]); /* Transaction ID L */
+	ASSERT_EQ(0x12, sock_buf[2u+9u]);
+	ASSERT_EQ(0x34, sock_buf[2u+10u]);
+
+	res.size = MBADU_TCP_SIZE_MAX;
+	ASSERT_EQ(0u, mbadu_tcp_handle_req_buf(&inst, rx_buf, sizeof rx_buf, &res));
+}
+
+static uint16_t s_flash_val;
+
+static enum mbstatus_e slow_flash_write(uint16_t value)
+{
+	s_flash_val = value;
+	return MB_PENDING;
+}
+
+TEST(mbadu_tcp_pending_write_completed_later)
+{
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0010u, .type=MRTYPE_U16, .access=MRACC_R_VAL|MRACC_W_FN, .read={.u16=0u}, .write={.fu16=slow_flash_write}},
+	};
+	struct mbinst_s inst = {.hold_regs=regs, .n_hold_regs=1u};
+	mbinst_init(&inst);
+	uint8_t tx_buf[MBADU_TCP_SIZE_MAX];
+	const uint8_t wreq[] = {
+		0x12, 0x34, 0x00, 0x00, 0x00, 0x06, 0x07,
+		MBFC_WRITE_SINGLE_REG, 0x00, 0x10, 0xAB, 0xCD,
+	};
+	const uint8_t rreq[] = {
+		0x12, 0x35, 0x00, 0x00, 0x00, 0x06, 0x07,
+		MBFC_READ_HOLDING_REGS, 0x00, 0x10, 0x00, 0x01,
+	};
+
+	/* No response while the write is pending */
+	ASSERT_EQ(0u, mbadu_tcp_handle_req(&inst, wreq, sizeof wreq, tx_buf));
+	ASSERT_EQ(0xABCDu, s_flash_val);
+
+	/* Other requests are rejected as busy meanwhile */
+	ASSERT_EQ(9u, mbadu_tcp_handle_req(&inst, rreq, sizeof rreq, tx_buf));
+	ASSERT_EQ(0x35u, tx_buf[1]);
+	ASSERT_EQ(MBFC_READ_HOLDING_REGS|0x80u, tx_buf[7]);
+	ASSERT_EQ(MB_BUSY, tx_buf[8]);
+
+	/* Completion produces the echo response with the original MBAP fields */
+	ASSERT_EQ(12u, mbadu_tcp_complete(&inst, MB_OK, NULL, 0u, tx_buf));
+	for (size_t i=0u; i<sizeof wreq; ++i) {
+		if (i==5u) continue;
+		ASSERT_EQ(wreq[i], tx_buf[i]);
+	}
+	ASSERT_EQ(0x06u, tx_buf[5]);
+
+	/* Nothing more to complete */
+	ASSERT_EQ(0u, mbadu_tcp_complete(&inst, MB_OK, NULL, 0u, tx_buf));
+
+	/* Reads work again */
+	ASSERT_EQ(11u, mbadu_tcp_handle_req(&inst, rreq, sizeof rreq, tx_buf));
+}
+
+static enum mbstatus_e deferred_custom_fn(
+	const struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbpdu_buf_s *res)
+{
+	(void)inst; (void)req; (void)req_len; (void)res;
+	return MB_PENDING;
+}
+
+TEST(mbadu_tcp_pending_custom_fn_completed_with_data_or_exception)
+{
+	struct mbinst_s inst = {.handle_fn_cb=deferred_custom_fn};
+	mbinst_init(&inst);
+	uint8_t tx_buf[MBADU_TCP_SIZE_MAX];
+	const uint8_t req[] = {0x00, 0x09, 0x00, 0x00, 0x00, 0x02, 0x01, 0x41};
+	const uint8_t data[] = {0x02, 0xAA, 0xBB};
+
+	ASSERT_EQ(0u, mbadu_tcp_handle_req(&inst, req, sizeof req, tx_buf));
+	ASSERT_EQ(11u, mbadu_tcp_complete(&inst, MB_OK, data, sizeof data, tx_buf));
+	ASSERT_EQ(0x09u, tx_buf[1]);
+	ASSERT_EQ(5u, betou16(tx_buf+4u));
+	ASSERT_EQ(0x41u, tx_buf[7]);
+	ASSERT_EQ(0xBBu, tx_buf[10]);
+
+	ASSERT_EQ(0u, mbadu_tcp_handle_req(&inst, req, sizeof req, tx_buf));
+	ASSERT_EQ(9u, mbadu_tcp_complete(&inst, MB_DEV_FAIL, NULL, 0u, tx_buf));
+	ASSERT_EQ(0xC1u, tx_buf[7]);
+	ASSERT_EQ(MB_DEV_FAIL, tx_buf[8]);
+	ASSERT_EQ(1u, inst.state.exception_counter);
+}
+
+TEST(mbadu_tcp_pending_read_write_regs_fails)
+{
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0010u, .type=MRTYPE_U16, .access=MRACC_R_VAL|MRACC_W_FN, .read={.u16=0u}, .write={.fu16=slow_flash_write}},
+	};
+	struct mbinst_s inst = {.hold_regs=regs, .n_hold_regs=1u};
+	mbinst_init(&inst);
+	uint8_t tx_buf[MBADU_TCP_SIZE_MAX];
+	const uint8_t req[] = {
+		0x00, 0x01, 0x00, 0x00, 0x00, 0x0D, 0x07,
+		MBFC_READ_WRITE_REGS, 0x00, 0x10, 0x00, 0x01, 0x00, 0x10, 0x00, 0x01, 0x02, 0x12, 0x34,
+	};
+
+	/* The response needs the registers read after the write, it cannot be deferred */
+	ASSERT_EQ(9u, mbadu_tcp_handle_req(&inst, req, sizeof req, tx_buf));
+	ASSERT_EQ(MBFC_READ_WRITE_REGS|0x80u, tx_buf[7]);
+	ASSERT_EQ(MB_DEV_FAIL, tx_buf[8]);
+	ASSERT_EQ(0u, inst.state.pending.is_active);
+
+	ASSERT_EQ(0u, mbadu_tcp_complete(&inst, MB_OK, NULL, 0u, tx_buf));
+	ASSERT_EQ(1u, inst.state.no_resp_counter);
+}
+
+TEST(mbadu_tcp_second_pending_write_fails)
+{
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0010u, .type=MRTYPE_U16, .access=MRACC_R_VAL|MRACC_W_FN, .read={.u16=0u}, .write={.fu16=slow_flash_write}},
+		{.address=0x0011u, .type=MRTYPE_U16, .access=MRACC_R_VAL|MRACC_W_FN, .read={.u16=0u}, .write={.fu16=slow_flash_write}},
+	};
+	struct mbinst_s inst = {.hold_regs=regs, .n_hold_regs=2u};
+	mbinst_init(&inst);
+	uint8_t tx_buf[MBADU_TCP_SIZE_MAX];
+	const uint8_t req[] = {
+		0x00, 0x02, 0x00, 0x00, 0x00, 0x0B, 0x07,
+		MBFC_WRITE_MULTIPLE_REGS, 0x00, 0x10, 0x00, 0x02, 0x04, 0x00, 0x01, 0x00, 0x02,
+	};
+
+	/* Only one write callback of a request may defer */
+	ASSERT_EQ(9u, mbadu_tcp_handle_req(&inst, req, sizeof req, tx_buf));
+	ASSERT_EQ(MBFC_WRITE_MULTIPLE_REGS|0x80u, tx_buf[7]);
+	ASSERT_EQ(MB_DEV_FAIL, tx_buf[8]);
+	ASSERT_EQ(0u, inst.state.pending.is_active);
+}
+
 TEST_MAIN(
 	mbadu_tcp_null_inst_fails,
 	mbadu_tcp_null_request_data_fails,
@@ -513,5 +674,10 @@ TEST_MAIN(
 	mbadu_tcp_length_field_correct,
 	mbadu_tcp_multiple_regs_read_works,
 	mbadu_tcp_zero_size_request_fails,
-	mbadu_tcp_exactly_min_size_works
+	mbadu_tcp_exactly_min_size_works,
+	mbadu_tcp_buf_writes_after_headroom,
+	mbadu_tcp_pending_write_completed_later,
+	mbadu_tcp_pending_custom_fn_completed_with_data_or_exception,
+	mbadu_tcp_pending_read_write_regs_fails,
+	mbadu_tcp_second_pending_write_fails
 );
@@ -466,6 +466,277 @@ TEST(mbadu_incorrect_crc_fails)
 	ASSERT_EQ(0u, res_size);
 }
 
+TEST(mbadu_precomputed_crc_works)
+{
+	const struct mbreg_desc_s regs[] = {
+		{
+			.address=0x00u,
+			.type=MRTYPE_U16,
+			.access=MRACC_R_VAL,
+			.read={.u16=0x1234},
+		}
+	};
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=sizeof regs / sizeof regs[0],
+		.serial={.slave_addr=1u}
+	};
+	mbinst_init(&inst);
+
+	uint8_t rx_buf[] = {
+		0x01,
+		MBFC_READ_HOLDING_REGS,
+		0x00, 0x00, /* Start addr */
+		0x00, 0x01, /* n read regs */
+		0x00, 0x00, /* CRC */
+	};
+	u16tole(mbcrc16(rx_buf, sizeof rx_buf - 2), rx_buf + sizeof rx_buf - 2);
+
+	/* Accumulate byte by byte as a receiver interrupt would */
+	uint16_t crc = mbcrc16_init();
+	size_t i;
+	for (i=0u; i<sizeof rx_buf; ++i) {
+		crc = mbcrc16_update(crc, rx_buf+i, 1u);
+	}
+	crc = mbcrc16_final(crc);
+	ASSERT_EQ(0u, crc);
+
+	uint8_t tx_buf[MBADU_SIZE_MAX];
+	uint8_t ref_buf[MBADU_SIZE_MAX];
+	size_t res_size = mbadu_handle_req_crc(&inst, rx_buf, sizeof rx_buf, crc, tx_buf);
+	ASSERT_EQ(7u, res_size);
+	ASSERT_EQ(res_size, mbadu_handle_req(&inst, rx_buf, sizeof rx_buf, ref_buf));
+	ASSERT(memcmp(tx_buf, ref_buf, res_size) == 0);
+}
+
+TEST(mbadu_precomputed_crc_mismatch_fails)
+{
+	const struct mbreg_desc_s regs[] = {
+		{
+			.address=0x00u,
+			.type=MRTYPE_U16,
+			.access=MRACC_R_VAL,
+			.read={.u16=0x1234},
+		}
+	};
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=sizeof regs / sizeof regs[0],
+		.serial={.slave_addr=1u}
+	};
+	mbinst_init(&inst);
+
+	uint8_t rx_buf[] = {0x01, MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00};
+	uint8_t tx_buf[MBADU_SIZE_MAX];
+
+	size_t res_size = mbadu_handle_req_crc(&inst, rx_buf, sizeof rx_buf, 0x1234u, tx_buf);
+	ASSERT_EQ(0u, res_size);
+	ASSERT_EQ(1u, inst.state.bus_msg_counter);
+	ASSERT_EQ(1u, inst.state.bus_comm_err_counter);
+}
+
+TEST(mbadu_buf_writes_after_headroom)
+{
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=0x1234}},
+	};
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=sizeof regs / sizeof regs[0],
+		.serial={.slave_addr=1u},
+	};
+	mbinst_init(&inst);
+
+	uint8_t rx_buf[] = {0x01, MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00};
+	u16tole(mbcrc16(rx_buf, sizeof rx_buf - 2), rx_buf + sizeof rx_buf - 2);
+
+	uint8_t dma_buf[4u+MBADU_SIZE_MAX] = {0};
+	struct mbadu_buf_s res = {.p=dma_buf, .size=sizeof dma_buf, .head=4u};
+
+	size_t res_size = mbadu_handle_req_buf(&inst, rx_buf, sizeof rx_buf, &res);
+	ASSERT_EQ(7u, res_size);
+	ASSERT_EQ(7u, res.len);
+	ASSERT_EQ(0x00, dma_buf[3]); /* Headroom untouched */
+	ASSERT_EQ(0x01, dma_buf[4]); /* Slave address */
+	ASSERT_EQ(MBFC_READ_HOLDING_REGS, dma_buf[5]);
+	ASSERT_EQ(0x12, dma_buf[7]);
+	ASSERT_EQ(mbcrc16(dma_buf+4u, 5u), letou16(dma_buf+9u));
+}
+
+TEST(mbadu_buf_without_room_fails)
+{
+	struct mbinst_s inst = {.serial={.slave_addr=1u}};
+	mbinst_init(&inst);
+
+	uint8_t rx_buf[] = {0x01, MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00};
+	u16tole(mbcrc16(rx_buf, sizeof rx_buf - 2), rx_buf + sizeof rx_buf - 2);
+
+	uint8_t dma_buf[MBADU_SIZE_MAX];
+	struct mbadu_buf_s res = {.p=dma_buf, .size=sizeof dma_buf, .head=1u, .len=5u};
+
+	ASSERT_EQ(0u, mbadu_handle_req_buf(&inst, rx_buf, sizeof rx_buf, &res));
+	ASSERT_EQ(0u, res.len);
+
+	res.head = sizeof dma_buf + 1u;
+	ASSERT_EQ(0u, mbadu_handle_req_buf(&inst, rx_buf, sizeof rx_buf, &res));
+	ASSERT_EQ(0u, mbadu_handle_req_buf(&inst, rx_buf, sizeof rx_buf, NULL));
+}
+
+static uint8_t s_pending_coils;
+
+static enum mbstatus_e slow_coil_write(int value)
+{
+	s_pending_coils = (uint8_t)value;
+	return MB_PENDING;
+}
+
+TEST(mbadu_pending_write_completed_with_slave_addr_and_crc)
+{
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x0003u, .access=MCACC_W_FN, .write={.fn=slow_coil_write}},
+	};
+	struct mbinst_s inst = {.coils=coils, .n_coils=1u, .serial={.slave_addr=5u}};
+	mbinst_init(&inst);
+	uint8_t tx_buf[MBADU_SIZE_MAX];
+	uint8_t rx_buf[] = {5u, MBFC_WRITE_SINGLE_COIL, 0x00, 0x03, 0xFF, 0x00, 0x00, 0x00};
+	u16tole(mbcrc16(rx_buf, sizeof rx_buf - 2), rx_buf + sizeof rx_buf - 2);
+
+	ASSERT_EQ(0u, mbadu_handle_req(&inst, rx_buf, sizeof rx_buf, tx_buf));
+	ASSERT_EQ(1u, s_pending_coils);
+	ASSERT_EQ(0u, inst.state.no_resp_counter);
+
+	ASSERT_EQ(sizeof rx_buf, mbadu_complete(&inst, MB_OK, NULL, 0u, tx_buf));
+	for (size_t i=0u; i<sizeof rx_buf; ++i) {
+		ASSERT_EQ(rx_buf[i], tx_buf[i]);
+	}
+	ASSERT_EQ(1u, inst.state.comm_event_counter);
+}
+
+TEST(mbadu_expected_len_fixed_size_requests)
+{
+	const uint8_t read_regs[] = {0x01, 0x03};
+	const uint8_t mask_write[] = {0x01, 0x16};
+	const uint8_t fifo[] = {0x01, 0x18};
+	const uint8_t slave_id[] = {0x01, 0x11};
+	const uint8_t custom[] = {0x01, 0x41, 0x00, 0x00};
+	const uint8_t dev_id[] = {0x01, 0x2B, 0x0E};
+	const uint8_t canopen[] = {0x01, 0x2B, 0x0D};
+
+	ASSERT_EQ(0u, mbadu_expected_len(read_regs, 1u));
+	ASSERT_EQ(8u, mbadu_expected_len(read_regs, 2u));
+	ASSERT_EQ(10u, mbadu_expected_len(mask_write, 2u));
+	ASSERT_EQ(6u, mbadu_expected_len(fifo, 2u));
+	ASSERT_EQ(4u, mbadu_expected_len(slave_id, 2u));
+	ASSERT_EQ(0u, mbadu_expected_len(custom, sizeof custom));
+	ASSERT_EQ(0u, mbadu_expected_len(dev_id, 2u));
+	ASSERT_EQ(7u, mbadu_expected_len(dev_id, 3u));
+	ASSERT_EQ(0u, mbadu_expected_len(canopen, sizeof canopen));
+	ASSERT_EQ(0u, mbadu_expected_len(NULL, 2u));
+}
+
+TEST(mbadu_expected_len_byte_count_requests)
+{
+	const uint8_t write_regs[] = {0x01, 0x10, 0x00, 0x00, 0x00, 0x02, 0x04};
+	const uint8_t write_file[] = {0x01, 0x15, 0x0D};
+	const uint8_t read_write[] = {0x01, 0x17, 0x00, 0x00, 0x00, 0x01, 0x00, 0x10, 0x00, 0x01, 0x02};
+
+	ASSERT_EQ(0u, mbadu_expected_len(write_regs, 6u));
+	ASSERT_EQ(13u, mbadu_expected_len(write_regs, 7u));
+	ASSERT_EQ(0u, mbadu_expected_len(write_file, 2u));
+	ASSERT_EQ(18u, mbadu_expected_len(write_file, 3u));
+	ASSERT_EQ(0u, mbadu_expected_len(read_write, 10u));
+	ASSERT_EQ(15u, mbadu_expected_len(read_write, 11u));
+}
+
+TEST(mbadu_exc_table_matches_crc)
+{
+	struct mbadu_exc_table_s table;
+	uint8_t frame[3];
+	size_t fc, code;
+
+	mbadu_exc_table_init(&table, 0x11u);
+	frame[0] = 0x11u;
+	for (fc=0u; fc<MBPDU_N_FN; ++fc) {
+		for (code=0u; code<MBADU_N_EXC; ++code) {
+			frame[1] = (uint8_t)(fc | MB_ERR_FLG);
+			frame[2] = (uint8_t)code;
+			ASSERT_EQ(mbcrc16(frame, sizeof frame), (uint16_t)(table.fc_crc[fc] ^ table.code_crc[code]));
+		}
+	}
+}
+
+TEST(mbadu_exc_table_illegal_fn_response)
+{
+	struct mbadu_exc_table_s table;
+	struct mbinst_s inst = {.serial={.slave_addr=1u, .exc_table=&table}};
+	uint8_t tx_buf[MBADU_SIZE_MAX];
+	uint8_t rx_buf[] = {0x01u, 0x41u, 0x00u, 0x00u, 0x00u, 0x00u};
+	size_t res_size;
+
+	mbinst_init(&inst);
+	mbadu_exc_table_init(&table, 1u);
+	u16tole(mbcrc16(rx_buf, sizeof rx_buf - 2u), rx_buf + sizeof rx_buf - 2u);
+
+	res_size = mbadu_handle_req(&inst, rx_buf, sizeof rx_buf, tx_buf);
+	ASSERT_EQ(5u, res_size);
+	ASSERT_EQ(0xC1u, tx_buf[1]);
+	ASSERT_EQ(MB_ILLEGAL_FN, tx_buf[2]);
+	ASSERT_EQ(0u, mbcrc16(tx_buf, res_size));
+	ASSERT_EQ(1u, inst.state.msg_counter);
+	ASSERT_EQ(1u, inst.state.exception_counter);
+	ASSERT_EQ(0u, inst.state.comm_event_counter);
+
+	/* Table of another address is not used */
+	mbadu_exc_table_init(&table, 2u);
+	res_size = mbadu_handle_req(&inst, rx_buf, sizeof rx_buf, tx_buf);
+	ASSERT_EQ(5u, res_size);
+	ASSERT_EQ(0u, mbcrc16(tx_buf, res_size));
+}
+
+static int s_bcast_reads;
+static uint16_t bcast_read_cb(void)
+{
+	++s_bcast_reads;
+	return 0x1234u;
+}
+
+TEST(mbadu_broadcast_read_is_dropped)
+{
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_R_FN, .read={.fu16=bcast_read_cb}},
+	};
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=sizeof regs / sizeof regs[0],
+		.serial={.slave_addr=1u}
+	};
+	mbinst_init(&inst);
+	s_bcast_reads = 0;
+
+	uint8_t tx_buf[MBADU_SIZE_MAX];
+	uint8_t rx_buf[] = {
+		0x00, /* Slave addr (Broadcast) */
+		MBFC_READ_HOLDING_REGS,
+		0x00, 0x00, /* Start addr */
+		0x00, 0x01, /* n read regs */
+		0x00, 0x00, /* CRC */
+	};
+	u16tole(mbcrc16(rx_buf, sizeof rx_buf - 2), rx_buf + sizeof rx_buf - 2);
+
+	ASSERT_EQ(0u, mbadu_handle_req(&inst, rx_buf, sizeof rx_buf, tx_buf));
+	ASSERT_EQ(0, s_bcast_reads); /* Never dispatched */
+	ASSERT_EQ(1u, inst.state.msg_counter);
+	ASSERT_EQ(1u, inst.state.no_resp_counter);
+	ASSERT_EQ(0u, inst.state.comm_event_counter);
+	ASSERT_EQ(0u, inst.state.exception_counter);
+
+	/* Same request to this slave is answered */
+	rx_buf[0] = 1u;
+	u16tole(mbcrc16(rx_buf, sizeof rx_buf - 2), rx_buf + sizeof rx_buf - 2);
+	ASSERT_EQ(7u, mbadu_handle_req(&inst, rx_buf, sizeof rx_buf, tx_buf));
+	ASSERT_EQ(1, s_bcast_reads);
+}
+
 TEST_MAIN(
 	mbadu_null_inst_fails,
 	mbadu_null_request_data_fails,
@@ -480,5 +751,15 @@ TEST_MAIN(
 	mbadu_response_crc_works,
 	mbadu_read_holding_reg_works,
 	mbadu_less_than_min_size_fails,
-	mbadu_more_than_max_size_fails
+	mbadu_more_than_max_size_fails,
+	mbadu_precomputed_crc_works,
+	mbadu_precomputed_crc_mismatch_fails,
+	mbadu_buf_writes_after_headroom,
+	mbadu_buf_without_room_fails,
+	mbadu_pending_write_completed_with_slave_addr_and_crc,
+	mbadu_expected_len_fixed_size_requests,
+	mbadu_expected_len_byte_count_requests,
+	mbadu_exc_table_matches_crc,
+	mbadu_exc_table_illegal_fn_response,
+	mbadu_broadcast_read_is_dropped
 );
@@ -0,0 +1,117 @@
+#include "test_lib.h"
+#include <endian.h>
+#include <mbarena.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <stdint.h>
+
+static uint16_t s_a, s_b[4];
+static const struct mbreg_desc_s s_regs[] = {
+	{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&s_a}, .write={.pu16=&s_a}},
+	{.address=0x01u, .type=MRTYPE_U16|MRTYPE_BLOCK, .n_block_entries=4u, .access=MRACC_RW_PTR, .read={.pu16=s_b}, .write={.pu16=s_b}},
+};
+
+static size_t write_regs(struct mbinst_s *inst, uint16_t n)
+{
+	uint8_t req[MBPDU_SIZE_MAX] = {MBFC_WRITE_MULTIPLE_REGS, 0x00, 0x00};
+	uint8_t res[MBPDU_SIZE_MAX];
+	uint16_t i;
+
+	u16tobe(n, req+3u);
+	req[5] = (uint8_t)(n*2u);
+	for (i=0u; i<n; ++i) {
+		u16tobe((uint16_t)(0x100u + i), req+6u+(2u*i));
+	}
+	return mbpdu_handle_req(inst, req, 6u + (n*2u), res);
+}
+
+TEST(mbarena_alloc_aligns_and_exhausts)
+{
+	_Alignas(max_align_t) uint8_t buf[4u*MBARENA_ALIGN];
+	struct mbarena_s arena = {.buf=buf, .size=sizeof buf};
+	uint8_t *p1, *p2;
+
+	mbarena_init(&arena);
+	p1 = mbarena_alloc(&arena, 1u);
+	p2 = mbarena_alloc(&arena, 2u*MBARENA_ALIGN);
+	ASSERT(p1==buf);
+	ASSERT(p2==(buf + MBARENA_ALIGN));
+	ASSERT(mbarena_alloc(&arena, MBARENA_ALIGN + 1u)==NULL);
+	ASSERT(mbarena_alloc(&arena, MBARENA_ALIGN)!=NULL);
+	ASSERT(mbarena_alloc(&arena, 1u)==NULL);
+	ASSERT_EQ(4u*MBARENA_ALIGN, arena.peak);
+
+	mbarena_reset(&arena);
+	ASSERT_EQ(0u, arena.used);
+	ASSERT_EQ(4u*MBARENA_ALIGN, arena.peak);
+	ASSERT(mbarena_alloc(&arena, 3u)==buf);
+
+	ASSERT(mbarena_alloc(NULL, 1u)==NULL);
+	mbarena_reset(NULL);
+}
+
+TEST(mbarena_write_regs_with_and_without_scratch)
+{
+	_Alignas(max_align_t) uint8_t buf[64];
+	struct mbarena_s arena = {.buf=buf, .size=sizeof buf};
+	struct mbinst_s inst = {.hold_regs=s_regs, .n_hold_regs=2u, .arena=&arena};
+
+	mbinst_init(&inst);
+	mbarena_init(&arena);
+
+	ASSERT_EQ(5u, write_regs(&inst, 5u));
+	ASSERT_EQ(0x100u, s_a);
+	ASSERT_EQ(0x104u, s_b[3]);
+	ASSERT_EQ(10u, arena.peak); /* Plan of 5 descriptors */
+	ASSERT_EQ(5u, write_regs(&inst, 2u));
+	ASSERT_EQ(4u, arena.used); /* Reset by the request */
+
+	/* Arena too small, descriptors searched again */
+	arena.size = 4u;
+	s_b[3] = 0u;
+	ASSERT_EQ(5u, write_regs(&inst, 5u));
+	ASSERT_EQ(0x104u, s_b[3]);
+
+	inst.arena = NULL;
+	s_b[3] = 0u;
+	ASSERT_EQ(5u, write_regs(&inst, 5u));
+	ASSERT_EQ(0x104u, s_b[3]);
+}
+
+TEST(mbarena_file_write_uses_plan)
+{
+	_Alignas(max_align_t) uint8_t buf[256];
+	struct mbarena_s arena = {.buf=buf, .size=sizeof buf};
+	uint16_t v1 = 0u, v2 = 0u;
+	const struct mbreg_desc_s file1[] = {
+		{.address=0x01u, .type=MRTYPE_U16, .access=MRACC_W_PTR, .write={.pu16=&v1}},
+	};
+	const struct mbreg_desc_s file2[] = {
+		{.address=0x02u, .type=MRTYPE_U16, .access=MRACC_W_PTR, .write={.pu16=&v2}},
+	};
+	const struct mbfile_desc_s files[] = {
+		{.file_no=0x01u, .records=file1, .n_records=1u},
+		{.file_no=0x02u, .records=file2, .n_records=1u},
+	};
+	struct mbinst_s inst = {.files=files, .n_files=2u, .arena=&arena};
+	const uint8_t req[] = {
+		MBFC_WRITE_FILE_RECORD, 0x12,
+		0x06, 0x00, 0x01, 0x00, 0x01, 0x00, 0x01, 0x12, 0x34,
+		0x06, 0x00, 0x02, 0x00, 0x02, 0x00, 0x01, 0x56, 0x78,
+	};
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	mbinst_init(&inst);
+	mbarena_init(&arena);
+
+	ASSERT_EQ(sizeof req, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(0x1234u, v1);
+	ASSERT_EQ(0x5678u, v2);
+	ASSERT(arena.peak > 0u);
+}
+
+TEST_MAIN(
+	mbarena_alloc_aligns_and_exhausts,
+	mbarena_write_regs_with_and_without_scratch,
+	mbarena_file_write_uses_plan
+);
@@ -0,0 +1,183 @@
+#include "test_lib.h"
+#include "test_policy.h"
+#include <endian.h>
+#include <mbcache.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint64_t s_now;
+static uint64_t clock_cb(void)
+{
+	return s_now;
+}
+
+static size_t s_n_reads;
+static uint16_t read_cb(void)
+{
+	++s_n_reads;
+	return 0x1111u;
+}
+
+static int s_locked;
+static int lock_cb(void)
+{
+	return s_locked;
+}
+
+#if MBCFG_COMPACT_REGS
+const struct mbreg_policy_s mbreg_policies[] = {
+	{0},
+	{.rlock_cb=lock_cb},
+};
+#endif
+
+static uint16_t s_val[4];
+static const struct mbreg_desc_s s_regs[] = {
+	{.address=0x00u, .type=MRTYPE_U16|MRTYPE_BLOCK, .n_block_entries=4u, .access=MRACC_RW_PTR, .read={.pu16=s_val}, .write={.pu16=s_val}},
+	{.address=0x10u, .type=MRTYPE_U16, .access=MRACC_R_FN, .read={.fu16=read_cb}},
+	{.address=0x20u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=0x2222u}, REG_CBS(1u, .rlock_cb=lock_cb)},
+};
+
+static const struct mbcoil_desc_s s_coils[] = {
+	{.address=0x00u, .access=MCACC_R_VAL, .read={.val=1u}},
+	{.address=0x40u, .access=MCACC_R_VAL, .read={.val=1u}, .rlock_cb=lock_cb},
+};
+
+static struct mbcache_entry_s s_entries[2];
+
+static void setup(struct mbinst_s *inst, struct mbcache_s *cache)
+{
+	(void)memset(inst, 0, sizeof *inst);
+	inst->hold_regs = s_regs;
+	inst->n_hold_regs = 3u;
+	inst->coils = s_coils;
+	inst->n_coils = 2u;
+	inst->cache = cache;
+	mbinst_init(inst);
+	mbcache_init(cache);
+	(void)memset(s_val, 0, sizeof s_val);
+	s_n_reads = 0u;
+	s_locked = 0;
+}
+
+static size_t read_regs(struct mbinst_s *inst, uint16_t addr, uint16_t n, uint8_t *res)
+{
+	uint8_t req[5] = {MBFC_READ_HOLDING_REGS};
+
+	u16tobe(addr, req+1u);
+	u16tobe(n, req+3u);
+	return mbpdu_handle_req(inst, req, sizeof req, res);
+}
+
+TEST(mbcache_repeated_read_is_cached)
+{
+	struct mbcache_s cache = {.entries=s_entries, .n_entries=2u};
+	struct mbinst_s inst;
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	setup(&inst, &cache);
+
+	ASSERT_EQ(4u, read_regs(&inst, 0x10u, 1u, res));
+	ASSERT_EQ(4u, read_regs(&inst, 0x10u, 1u, res));
+	ASSERT_EQ(0x1111u, betou16(res+2));
+	ASSERT_EQ(1u, s_n_reads);
+	ASSERT_EQ(1u, cache.n_hits);
+	ASSERT_EQ(1u, cache.n_misses);
+	ASSERT_EQ(2u, inst.state.msg_counter);
+
+	/* Exceptions are not cached */
+	ASSERT_EQ(2u, read_regs(&inst, 0x30u, 1u, res));
+	ASSERT_EQ(2u, read_regs(&inst, 0x30u, 1u, res));
+	ASSERT_EQ(3u, cache.n_misses);
+}
+
+TEST(mbcache_write_and_epoch_invalidate)
+{
+	struct mbcache_s cache = {.entries=s_entries, .n_entries=2u};
+	struct mbinst_s inst;
+	uint8_t res[MBPDU_SIZE_MAX];
+	const uint8_t write_req[] = {MBFC_WRITE_SINGLE_REG, 0x00, 0x01, 0xAB, 0xCD};
+
+	setup(&inst, &cache);
+
+	ASSERT_EQ(10u, read_regs(&inst, 0x00u, 4u, res));
+	ASSERT_EQ(0u, betou16(res+4));
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, write_req, sizeof write_req, res));
+	ASSERT_EQ(10u, read_regs(&inst, 0x00u, 4u, res));
+	ASSERT_EQ(0xABCDu, betou16(res+4));
+	ASSERT_EQ(0u, cache.n_hits);
+
+	/* Application update */
+	s_val[0] = 7u;
+	ASSERT_EQ(10u, read_regs(&inst, 0x00u, 4u, res));
+	ASSERT_EQ(0u, betou16(res+2));
+	mbcache_invalidate(&cache);
+	ASSERT_EQ(10u, read_regs(&inst, 0x00u, 4u, res));
+	ASSERT_EQ(7u, betou16(res+2));
+}
+
+TEST(mbcache_max_age_and_replacement)
+{
+	struct mbcache_s cache = {.entries=s_entries, .n_entries=2u, .clock_cb=clock_cb, .max_age_ticks=100u};
+	struct mbinst_s inst;
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	setup(&inst, &cache);
+
+	s_now = 1000u;
+	ASSERT_EQ(4u, read_regs(&inst, 0x10u, 1u, res));
+	s_now = 1099u;
+	ASSERT_EQ(4u, read_regs(&inst, 0x10u, 1u, res));
+	ASSERT_EQ(1u, s_n_reads);
+	s_now = 1100u;
+	ASSERT_EQ(4u, read_regs(&inst, 0x10u, 1u, res));
+	ASSERT_EQ(2u, s_n_reads);
+
+	/* Two more requests replace the oldest entry */
+	ASSERT_EQ(4u, read_regs(&inst, 0x00u, 1u, res));
+	ASSERT_EQ(6u, read_regs(&inst, 0x00u, 2u, res));
+	ASSERT_EQ(4u, read_regs(&inst, 0x10u, 1u, res));
+	ASSERT_EQ(3u, s_n_reads);
+}
+
+TEST(mbcache_read_locked_ranges_not_cached)
+{
+	struct mbcache_s cache = {.entries=s_entries, .n_entries=2u};
+	struct mbinst_s inst;
+	uint8_t res[MBPDU_SIZE_MAX];
+	const uint8_t coils_req[] = {MBFC_READ_COILS, 0x00, 0x00, 0x00, 0x48};
+	const uint8_t other_req[] = {MBFC_READ_COILS, 0x00, 0x00, 0x00, 0x08};
+
+	setup(&inst, &cache);
+
+	/* Lock engaged between two identical reads */
+	ASSERT_EQ(4u, read_regs(&inst, 0x20u, 1u, res));
+	ASSERT_EQ(0x2222u, betou16(res+2));
+	s_locked = 1;
+	ASSERT_EQ(2u, read_regs(&inst, 0x20u, 1u, res));
+	ASSERT_EQ(MBFC_READ_HOLDING_REGS|0x80u, res[0]);
+	ASSERT_EQ(MB_ILLEGAL_DATA_ADDR, res[1]);
+	ASSERT_EQ(0u, cache.n_hits);
+
+	/* A locked coil at the end of the range, past a gap */
+	s_locked = 0;
+	ASSERT_EQ(11u, mbpdu_handle_req(&inst, coils_req, sizeof coils_req, res));
+	s_locked = 1;
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, coils_req, sizeof coils_req, res));
+	ASSERT_EQ(MBFC_READ_COILS|0x80u, res[0]);
+	ASSERT_EQ(0u, cache.n_hits);
+
+	/* Ranges without read locks are still cached */
+	ASSERT_EQ(3u, mbpdu_handle_req(&inst, other_req, sizeof other_req, res));
+	ASSERT_EQ(3u, mbpdu_handle_req(&inst, other_req, sizeof other_req, res));
+	ASSERT_EQ(1u, cache.n_hits);
+}
+
+TEST_MAIN(
+	mbcache_repeated_read_is_cached,
+	mbcache_write_and_epoch_invalidate,
+	mbcache_max_age_and_replacement,
+	mbcache_read_locked_ranges_not_cached
+);
@@ -3,6 +3,7 @@
 #include <mbcoil.h>
 #include <mbpdu.h>
 #include <stdint.h>
+#include <string.h>
 
 TEST(mbcoil_null_coil_read_fails)
 {
@@ -534,6 +535,397 @@ TEST(mbcoil_invalid_coil_address)
 	ASSERT_EQ(MB_ILLEGAL_DATA_ADDR, res[1]);
 }
 
+TEST(mbcoil_cursor_matches_search)
+{
+	uint8_t coil_data = 0u;
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x0002, .access=MCACC_R_VAL, .read={.val=1}},
+		{.address=0x0003, .access=MCACC_R_PTR, .read={.ptr=&coil_data, .ix=0}},
+		{.address=0x0007, .access=MCACC_R_PTR, .read={.ptr=&coil_data, .ix=1}},
+		{.address=0x0010, .access=MCACC_R_VAL, .read={.val=0}},
+	};
+	const size_t n_coils = sizeof coils / sizeof coils[0];
+	struct mbcoil_cursor_s cur;
+	uint32_t start, addr;
+
+	for (start=0x0000u; start<0x0014u; ++start) {
+		mbcoil_cursor_init(&cur, NULL, coils, n_coils, (uint16_t)start);
+		for (addr=start; addr<0x0014u; ++addr) {
+			ASSERT_EQ(mbcoil_find_desc(coils, n_coils, (uint16_t)addr), mbcoil_cursor_find(&cur, (uint16_t)addr));
+		}
+	}
+}
+
+TEST(mbcoil_cursor_gap_reaches_next_coil)
+{
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x0002, .access=MCACC_R_VAL, .read={.val=1}},
+		{.address=0x0100, .access=MCACC_R_VAL, .read={.val=1}},
+		{.address=0x0700, .access=MCACC_R_VAL, .read={.val=1}},
+	};
+	struct mbcoil_cursor_s cur;
+	uint8_t req[] = {MBFC_READ_COILS, 0x00, 0x02, 0x07, 0xD0};
+	uint8_t res[MBPDU_SIZE_MAX];
+	struct mbinst_s inst = {.coils=coils, .n_coils=3u};
+	size_t i, n_set;
+
+	mbcoil_cursor_init(&cur, NULL, coils, 3u, 0x0003u);
+	ASSERT(mbcoil_cursor_find(&cur, 0x0003u) == NULL);
+	ASSERT_EQ(0xFDu, mbcoil_cursor_gap(&cur, 0x0003u, 2000u));
+	ASSERT_EQ(0x10u, mbcoil_cursor_gap(&cur, 0x0003u, 0x10u));
+	ASSERT(mbcoil_cursor_find(&cur, 0x0701u) == NULL);
+	ASSERT_EQ(5u, mbcoil_cursor_gap(&cur, 0x0701u, 5u)); /* Past the last coil */
+
+	/* A wide read of a sparse map */
+	mbinst_init(&inst);
+	ASSERT_EQ(2u + 250u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	for (i=0u, n_set=0u; i<250u; ++i) {
+		n_set += (res[2u+i]!=0u);
+	}
+	ASSERT_EQ(3u, n_set);
+	ASSERT_EQ(0x01u, res[2]);
+	ASSERT_EQ(0x40u, res[2u + (0xFEu/8u)]);
+	ASSERT_EQ(0x40u, res[2u + (0x6FEu/8u)]);
+}
+
+/* --- Block (packed bitmap) coils --- */
+
+static int s_lock_calls = 0;
+static int counting_lock(void) { ++s_lock_calls; return 1; }
+
+TEST(mbcoil_find_desc_in_block)
+{
+	uint8_t bits[4] = {0};
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x0000u, .access=MCACC_R_PTR, .read={.ptr=bits, .ix=0u}},
+		{.address=0x0010u, .access=MCACC_R_PTR, .read={.ptr=bits, .ix=1u}, .n_block_entries=20u},
+		{.address=0x0030u, .access=MCACC_R_PTR, .read={.ptr=bits, .ix=2u}},
+	};
+	struct mbcoil_cursor_s cur;
+
+	ASSERT(mbcoil_find_desc(coils, 3u, 0x0010u) == &coils[1]);
+	ASSERT(mbcoil_find_desc(coils, 3u, 0x0023u) == &coils[1]);
+	ASSERT(mbcoil_find_desc(coils, 3u, 0x0024u) == NULL);
+	ASSERT(mbcoil_find_desc(coils, 3u, 0x000Fu) == NULL);
+
+	mbcoil_cursor_init(&cur, NULL, coils, 3u, 0x0015u);
+	ASSERT(mbcoil_cursor_find(&cur, 0x0015u) == &coils[1]);
+	ASSERT(mbcoil_cursor_find(&cur, 0x0023u) == &coils[1]);
+	ASSERT(mbcoil_cursor_find(&cur, 0x0024u) == NULL);
+	ASSERT(mbcoil_cursor_find(&cur, 0x0030u) == &coils[2]);
+}
+
+TEST(mbcoil_read_bits_unaligned_block)
+{
+	/* Bit n of the block is bit (3+n) of the bitmap */
+	const uint8_t bits_src[4] = {0xA8u, 0x5Fu, 0xC3u, 0x01u};
+	uint8_t bits[4];
+	memcpy(bits, bits_src, sizeof bits);
+	const struct mbcoil_desc_s coil = {
+		.address=0x0100u, .access=MCACC_R_PTR, .read={.ptr=bits, .ix=3u}, .n_block_entries=26u,
+	};
+	uint8_t dst[5];
+	size_t n;
+
+	for (size_t start=0u; start<26u; ++start) {
+		for (size_t dst_bit=0u; dst_bit<8u; ++dst_bit) {
+			memset(dst, 0, sizeof dst);
+			ASSERT_EQ(MB_OK, mbcoil_read_bits(&coil, (uint16_t)(0x0100u+start), 30u, dst, dst_bit, &n));
+			ASSERT_EQ(26u-start, n);
+			for (size_t j=0u; j<n; ++j) {
+				size_t sb = 3u+start+j;
+				size_t db = dst_bit+j;
+				ASSERT_EQ((bits[sb/8u]>>(sb%8u))&1u, (size_t)((dst[db/8u]>>(db%8u))&1u));
+			}
+			ASSERT_EQ(0, dst[0] & ((1u<<dst_bit)-1u)); /* Bits before dst_bit untouched */
+		}
+	}
+}
+
+TEST(mbcoil_write_bits_unaligned_block_preserves_other_bits)
+{
+	uint8_t bits[4];
+	const struct mbcoil_desc_s coil = {
+		.address=0x0000u, .access=MCACC_RW_PTR,
+		.read={.ptr=bits, .ix=5u}, .write={.ptr=bits, .ix=5u}, .n_block_entries=20u,
+	};
+	const uint8_t src[3] = {0x3Cu, 0xA5u, 0x0Fu};
+	size_t n;
+
+	for (size_t start=0u; start<20u; ++start) {
+		for (size_t len=1u; len<=20u-start; ++len) {
+			memset(bits, 0xFF, sizeof bits);
+			ASSERT_EQ(MB_OK, mbcoil_write_bits(&coil, (uint16_t)start, len, src, 1u, &n));
+			ASSERT_EQ(len, n);
+			for (size_t b=0u; b<32u; ++b) {
+				unsigned expected = 1u;
+				if ((b >= 5u+start) && (b < 5u+start+len)) {
+					size_t sb = 1u+(b-5u-start);
+					expected = (src[sb/8u]>>(sb%8u))&1u;
+				}
+				ASSERT_EQ(expected, (unsigned)((bits[b/8u]>>(b%8u))&1u));
+			}
+		}
+	}
+}
+
+TEST(mbcoil_block_2000_coils_read_and_write)
+{
+	uint8_t bits[256] = {0};
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x0000u, .access=MCACC_RW_PTR, .read={.ptr=bits, .ix=0u}, .write={.ptr=bits, .ix=0u}, .n_block_entries=2048u},
+	};
+	struct mbinst_s inst = {.coils=coils, .n_coils=1u};
+	mbinst_init(&inst);
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	for (size_t i=0u; i<sizeof bits; ++i) {
+		bits[i] = (uint8_t)(i*7u);
+	}
+
+	/* Read 2000 coils from address 5 */
+	uint8_t req[] = {MBFC_READ_COILS, 0x00u, 0x05u, 0x07u, 0xD0u};
+	size_t res_size = mbpdu_handle_req(&inst, req, sizeof req, res);
+	ASSERT_EQ(2u+250u, res_size);
+	for (size_t i=0u; i<2000u; ++i) {
+		size_t sb = 5u+i;
+		ASSERT_EQ((bits[sb/8u]>>(sb%8u))&1u, ((unsigned)res[2u+(i/8u)]>>(i%8u))&1u);
+	}
+
+	/* Write 12 coils at address 1001 */
+	uint8_t wreq[] = {MBFC_WRITE_MULTIPLE_COILS, 0x03u, 0xE9u, 0x00u, 0x0Cu, 0x02u, 0xFFu, 0x0Au};
+	memset(bits, 0, sizeof bits);
+	res_size = mbpdu_handle_req(&inst, wreq, sizeof wreq, res);
+	ASSERT_EQ(5u, res_size);
+	ASSERT_EQ(0x00u, bits[124]);
+	ASSERT_EQ(0xFEu, bits[125]); /* Coils 1001-1007 */
+	ASSERT_EQ(0x15u, bits[126]); /* Coils 1008-1012 = 1,1,0,1,0 -> ...10101 */
+	ASSERT_EQ(0x00u, bits[127]);
+
+	/* Write single coil inside block */
+	uint8_t sreq[] = {MBFC_WRITE_SINGLE_COIL, 0x07u, 0xFFu, 0xFFu, 0x00u};
+	res_size = mbpdu_handle_req(&inst, sreq, sizeof sreq, res);
+	ASSERT_EQ(5u, res_size);
+	ASSERT_EQ(0x80u, bits[255]);
+}
+
+TEST(mbcoil_block_mixed_with_single_coils)
+{
+	uint8_t bits = 0xFFu;
+	uint8_t single = 0x01u;
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x0000u, .access=MCACC_R_PTR, .read={.ptr=&single, .ix=0u}},
+		{.address=0x0002u, .access=MCACC_R_PTR, .read={.ptr=&bits, .ix=4u}, .n_block_entries=3u},
+		{.address=0x0005u, .access=MCACC_R_VAL, .read={.val=1u}},
+	};
+	struct mbinst_s inst = {.coils=coils, .n_coils=3u};
+	mbinst_init(&inst);
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	uint8_t req[] = {MBFC_READ_COILS, 0x00u, 0x00u, 0x00u, 0x08u};
+	size_t res_size = mbpdu_handle_req(&inst, req, sizeof req, res);
+	ASSERT_EQ(3u, res_size);
+	ASSERT_EQ(0x3Du, res[2]); /* 0:1 1:0 2-4:1 5:1 6-7:0 */
+}
+
+TEST(mbcoil_block_locked_once)
+{
+	uint8_t bits[2] = {0};
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x0000u, .access=MCACC_RW_PTR, .read={.ptr=bits}, .write={.ptr=bits}, .n_block_entries=16u, .wlock_cb=counting_lock},
+	};
+	struct mbinst_s inst = {.coils=coils, .n_coils=1u};
+	mbinst_init(&inst);
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	s_lock_calls = 0;
+	uint8_t wreq[] = {MBFC_WRITE_MULTIPLE_COILS, 0x00u, 0x00u, 0x00u, 0x10u, 0x02u, 0xFFu, 0xFFu};
+	size_t res_size = mbpdu_handle_req(&inst, wreq, sizeof wreq, res);
+	ASSERT_EQ(2u, res_size);
+	ASSERT_EQ(MB_ILLEGAL_DATA_ADDR, res[1]);
+	ASSERT_EQ(1, s_lock_calls);
+	ASSERT_EQ(0u, bits[0]);
+}
+
+static uint8_t s_bulk_bits[64];
+static int s_bulk_calls;
+
+static enum mbstatus_e bulk_read(uint16_t addr, size_t n, uint8_t *bits)
+{
+	++s_bulk_calls;
+	for (size_t j=0u; j<n; ++j) {
+		size_t sb = (size_t)(addr-0x0200u)+j;
+		bits[j/8u] |= (uint8_t)(((s_bulk_bits[sb/8u]>>(sb%8u))&1u) << (j%8u));
+	}
+	return MB_OK;
+}
+
+static enum mbstatus_e bulk_write(uint16_t addr, size_t n, const uint8_t *bits)
+{
+	++s_bulk_calls;
+	for (size_t j=0u; j<n; ++j) {
+		size_t db = (size_t)(addr-0x0200u)+j;
+		s_bulk_bits[db/8u] = (uint8_t)((s_bulk_bits[db/8u] & ~(1u<<(db%8u)))
+			| (((bits[j/8u]>>(j%8u))&1u) << (db%8u)));
+	}
+	return MB_OK;
+}
+
+TEST(mbcoil_bulk_read_aligned_and_unaligned)
+{
+	const struct mbcoil_desc_s coil = {
+		.address=0x0200u, .access=MCACC_R_BULK, .read={.bulk=bulk_read}, .n_block_entries=400u,
+	};
+	uint8_t dst[64];
+	size_t n;
+
+	for (size_t i=0u; i<sizeof s_bulk_bits; ++i) {
+		s_bulk_bits[i] = (uint8_t)(i*13u+5u);
+	}
+
+	for (size_t dst_bit=0u; dst_bit<8u; ++dst_bit) {
+		memset(dst, 0, sizeof dst);
+		s_bulk_calls = 0;
+		ASSERT_EQ(MB_OK, mbcoil_read_bits(&coil, 0x0203u, 500u, dst, dst_bit, &n));
+		ASSERT_EQ(397u, n);
+		ASSERT_EQ((dst_bit==0u) ? 1 : 2, s_bulk_calls); /* 256 bits of scratch per call */
+		for (size_t j=0u; j<n; ++j) {
+			size_t sb = 3u+j;
+			size_t db = dst_bit+j;
+			ASSERT_EQ((s_bulk_bits[sb/8u]>>(sb%8u))&1u, (size_t)((dst[db/8u]>>(db%8u))&1u));
+		}
+	}
+}
+
+TEST(mbcoil_bulk_write_through_pdu)
+{
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x01FFu, .access=MCACC_RW_PTR, .read={.ptr=s_bulk_bits}, .write={.ptr=s_bulk_bits}},
+		{.address=0x0200u, .access=MCACC_RW_BULK, .read={.bulk=bulk_read}, .write={.bulk=bulk_write}, .n_block_entries=16u},
+	};
+	struct mbinst_s inst = {.coils=coils, .n_coils=2u};
+	mbinst_init(&inst);
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	/* Aligned: request bitmap handed straight to the callback */
+	memset(s_bulk_bits, 0, sizeof s_bulk_bits);
+	s_bulk_calls = 0;
+	uint8_t wreq[] = {MBFC_WRITE_MULTIPLE_COILS, 0x02u, 0x00u, 0x00u, 0x0Cu, 0x02u, 0xA5u, 0x0Fu};
+	size_t res_size = mbpdu_handle_req(&inst, wreq, sizeof wreq, res);
+	ASSERT_EQ(5u, res_size);
+	ASSERT_EQ(1, s_bulk_calls);
+	ASSERT_EQ(0xA5u, s_bulk_bits[0]);
+	ASSERT_EQ(0x0Fu, s_bulk_bits[1]);
+
+	/* Single coil inside the range */
+	uint8_t sreq[] = {MBFC_WRITE_SINGLE_COIL, 0x02u, 0x0Fu, 0xFFu, 0x00u};
+	res_size = mbpdu_handle_req(&inst, sreq, sizeof sreq, res);
+	ASSERT_EQ(5u, res_size);
+	ASSERT_EQ(0x8Fu, s_bulk_bits[1]);
+
+	/* Read from the single coil into the range (unaligned) */
+	uint8_t rreq[] = {MBFC_READ_COILS, 0x01u, 0xFFu, 0x00u, 0x0Au};
+	s_bulk_calls = 0;
+	res_size = mbpdu_handle_req(&inst, rreq, sizeof rreq, res);
+	ASSERT_EQ(4u, res_size);
+	ASSERT_EQ(1, s_bulk_calls);
+	ASSERT_EQ(0x4Bu, res[2]); /* 0x1FF is bit 0 of 0xA5, then 0xA5 shifted by one */
+	ASSERT_EQ(0x03u, res[3]); /* Last 0xA5 bit, then coil 0x208 */
+}
+
+TEST(mbcoil_validate_checks_map_in_one_pass)
+{
+	uint8_t bits = 0u;
+	uint16_t issue = 0u;
+	const struct mbcoil_desc_s valid[] = {
+		{.address=0x00u, .access=MCACC_RW_PTR, .read={.ptr=&bits, .ix=7u}, .write={.ptr=&bits, .ix=7u}},
+		{.address=0x01u, .access=MCACC_R_PTR, .read={.ptr=&bits}, .n_block_entries=8u},
+		{.address=0x09u, .access=MCACC_R_VAL},
+	};
+	const struct mbcoil_desc_s block_overlap[] = {
+		{.address=0x00u, .access=MCACC_R_PTR, .read={.ptr=&bits}, .n_block_entries=8u},
+		{.address=0x07u, .access=MCACC_R_VAL},
+	};
+	const struct mbcoil_desc_s bad_ix[] = {
+		{.address=0x02u, .access=MCACC_R_PTR, .read={.ptr=&bits, .ix=8u}},
+	};
+	const struct mbcoil_desc_s no_access[] = {
+		{.address=0x03u},
+	};
+
+	ASSERT_EQ(1, mbcoil_validate(valid, 3u, &issue));
+	ASSERT_EQ(0, mbcoil_validate(block_overlap, 2u, &issue));
+	ASSERT_EQ(0x07u, issue);
+	ASSERT_EQ(0, mbcoil_validate(bad_ix, 1u, &issue));
+	ASSERT_EQ(0x02u, issue);
+	ASSERT_EQ(0, mbcoil_validate(no_access, 1u, &issue));
+	ASSERT_EQ(0x03u, issue);
+}
+
+TEST(mbcoil_index_matches_search)
+{
+	uint8_t coil_data = 0u;
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x0002, .access=MCACC_R_VAL, .read={.val=1}},
+		{.address=0x0003, .access=MCACC_R_PTR, .read={.ptr=&coil_data, .ix=0}},
+		{.address=0x1007, .access=MCACC_R_PTR, .read={.ptr=&coil_data, .ix=1}},
+		{.address=0xFFFF, .access=MCACC_R_VAL, .read={.val=0}},
+	};
+	const size_t n_coils = sizeof coils / sizeof coils[0];
+	uint16_t storage[MBPAGE_STORAGE_SIZE(3)];
+	struct mbcoil_index_s ix;
+	struct mbcoil_cursor_s cur;
+	uint32_t addr;
+
+	ASSERT_EQ(MBPAGE_STORAGE_SIZE(3), mbcoil_index_size(coils, n_coils));
+	ASSERT_EQ(1, mbcoil_index_build(&ix, coils, n_coils, storage, sizeof storage / sizeof storage[0]));
+
+	for (addr=0u; addr<=0xFFFFu; ++addr) {
+		ASSERT_EQ(mbcoil_find_desc(coils, n_coils, (uint16_t)addr), mbcoil_index_find(&ix, coils, n_coils, (uint16_t)addr));
+	}
+
+	mbcoil_cursor_init(&cur, &ix, coils, n_coils, 0x1000u);
+	ASSERT_EQ(NULL, mbcoil_cursor_find(&cur, 0x1000u));
+	ASSERT_EQ(&coils[2], mbcoil_cursor_find(&cur, 0x1007u));
+	ASSERT_EQ(&coils[3], mbcoil_cursor_find(&cur, 0xFFFFu));
+
+	/* Too little storage, lookups fall back to search */
+	ASSERT_EQ(0, mbcoil_index_build(&ix, coils+1, 1u, storage, MBPAGE_N_PAGES));
+	ASSERT_EQ(&coils[1], mbcoil_index_find(&ix, coils+1, 1u, 0x0003u));
+}
+
+TEST(mbcoil_cursor_write_bits_merges_run)
+{
+	uint8_t a = 0xF0u, b = 0x00u;
+	const uint8_t src[] = {0x2Du};
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x0010, .access=MCACC_W_PTR, .write={.ptr=&a, .ix=1}},
+		{.address=0x0011, .access=MCACC_W_PTR, .write={.ptr=&a, .ix=2}},
+		{.address=0x0012, .access=MCACC_W_PTR, .write={.ptr=&a, .ix=3}},
+		{.address=0x0013, .access=MCACC_W_PTR, .write={.ptr=&b, .ix=0}},
+		{.address=0x0014, .access=MCACC_W_PTR, .write={.ptr=&b, .ix=2}},
+	};
+	const size_t n_coils = sizeof coils / sizeof coils[0];
+	struct mbcoil_cursor_s cur;
+	size_t n;
+
+	mbcoil_cursor_init(&cur, NULL, coils, n_coils, 0x0010u);
+
+	/* Run ends where the pointer changes */
+	ASSERT_EQ(MB_OK, mbcoil_cursor_write_bits(&cur, 0x0010u, 5u, src, 0u, &n));
+	ASSERT_EQ(3u, n);
+	ASSERT_EQ(0xFAu, a); /* Bits 1-3 = 1,0,1 */
+
+	/* Run ends where the bit index is not consecutive */
+	ASSERT_EQ(MB_OK, mbcoil_cursor_write_bits(&cur, 0x0013u, 2u, src, 3u, &n));
+	ASSERT_EQ(1u, n);
+	ASSERT_EQ(MB_OK, mbcoil_cursor_write_bits(&cur, 0x0014u, 1u, src, 2u, &n));
+	ASSERT_EQ(1u, n);
+	ASSERT_EQ(0x05u, b);
+
+	ASSERT_EQ(MB_DEV_FAIL, mbcoil_cursor_write_bits(&cur, 0x0015u, 1u, src, 0u, &n));
+}
+
 TEST_MAIN(
 	mbcoil_null_coil_read_fails,
 	mbcoil_null_coil_write_fails,
@@ -558,5 +950,18 @@ TEST_MAIN(
 	mbcoil_write_single_coil_on,
 	mbcoil_write_single_coil_off,
 	mbcoil_write_multiple_coils,
-	mbcoil_invalid_coil_address
+	mbcoil_invalid_coil_address,
+	mbcoil_cursor_matches_search,
+	mbcoil_cursor_gap_reaches_next_coil,
+	mbcoil_find_desc_in_block,
+	mbcoil_read_bits_unaligned_block,
+	mbcoil_write_bits_unaligned_block_preserves_other_bits,
+	mbcoil_block_2000_coils_read_and_write,
+	mbcoil_block_mixed_with_single_coils,
+	mbcoil_block_locked_once,
+	mbcoil_bulk_read_aligned_and_unaligned,
+	mbcoil_bulk_write_through_pdu,
+	mbcoil_validate_checks_map_in_one_pass,
+	mbcoil_index_matches_search,
+	mbcoil_cursor_write_bits_merges_run
 );
@@ -0,0 +1,191 @@
+#include "test_lib.h"
+#include <endian.h>
+#include <mbcommit.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint64_t s_now;
+static uint64_t clock_cb(void)
+{
+	return s_now;
+}
+
+static size_t s_n_commits;
+static size_t s_n_ranges;
+static struct mbcommit_range_s s_ranges[MBCOMMIT_N_RANGES];
+static void commit_cb(const struct mbinst_s *inst, const struct mbcommit_range_s *ranges, size_t n_ranges)
+{
+	(void)inst;
+	++s_n_commits;
+	s_n_ranges = n_ranges;
+	memcpy(s_ranges, ranges, n_ranges * sizeof ranges[0]);
+}
+
+static size_t s_n_legacy_commits;
+static void legacy_commit_cb(const struct mbinst_s *inst)
+{
+	(void)inst;
+	++s_n_legacy_commits;
+}
+
+static uint16_t s_regs_val[64];
+static const struct mbreg_desc_s s_regs[] = {
+	{
+		.address=0x100u,
+		.type=MRTYPE_U16 | MRTYPE_BLOCK,
+		.n_block_entries=64u,
+		.access=MRACC_RW_PTR,
+		.read={.pu16=s_regs_val},
+		.write={.pu16=s_regs_val},
+	},
+};
+
+static size_t write_regs(struct mbinst_s *inst, uint16_t addr, uint16_t n)
+{
+	uint8_t req[MBPDU_SIZE_MAX] = {MBFC_WRITE_MULTIPLE_REGS};
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	u16tobe(addr, req+1u);
+	u16tobe(n, req+3u);
+	req[5] = (uint8_t)(n*2u);
+	return mbpdu_handle_req(inst, req, 6u + (n*2u), res);
+}
+
+TEST(mbcommit_mark_merges_adjacent_and_overlapping)
+{
+	struct mbcommit_s commit = {0};
+	mbcommit_init(&commit);
+
+	mbcommit_mark(&commit, 10u, 5u);
+	mbcommit_mark(&commit, 30u, 5u);
+	mbcommit_mark(&commit, 15u, 2u); /* Adjacent to first */
+	mbcommit_mark(&commit, 28u, 4u); /* Overlaps second */
+
+	ASSERT_EQ(2u, commit.n_ranges);
+	ASSERT_EQ(10u, commit.ranges[0].start);
+	ASSERT_EQ(7u, commit.ranges[0].n);
+	ASSERT_EQ(28u, commit.ranges[1].start);
+	ASSERT_EQ(7u, commit.ranges[1].n);
+	ASSERT_EQ(28u, mbcommit_dirty_bytes(&commit));
+
+	mbcommit_mark(&commit, 0u, 100u); /* Covers everything */
+	ASSERT_EQ(1u, commit.n_ranges);
+	ASSERT_EQ(0u, commit.ranges[0].start);
+	ASSERT_EQ(100u, commit.ranges[0].n);
+}
+
+TEST(mbcommit_mark_merges_closest_when_full)
+{
+	struct mbcommit_s commit = {0};
+	size_t i;
+	mbcommit_init(&commit);
+
+	for (i=0u; i<MBCOMMIT_N_RANGES; ++i) {
+		mbcommit_mark(&commit, (uint16_t)(i*100u), 1u);
+	}
+	ASSERT_EQ(MBCOMMIT_N_RANGES, commit.n_ranges);
+
+	mbcommit_mark(&commit, 203u, 1u); /* Closest to the range at 200 */
+
+	ASSERT_EQ(MBCOMMIT_N_RANGES, commit.n_ranges);
+	ASSERT_EQ(200u, commit.ranges[2].start);
+	ASSERT_EQ(4u, commit.ranges[2].n);
+	ASSERT_EQ(300u, commit.ranges[3].start);
+	for (i=1u; i<commit.n_ranges; ++i) {
+		ASSERT(commit.ranges[i-1u].start < commit.ranges[i].start);
+	}
+}
+
+TEST(mbcommit_coalesces_requests_until_flush)
+{
+	struct mbcommit_s commit = {.commit_cb=commit_cb};
+	struct mbinst_s inst = {
+		.hold_regs=s_regs,
+		.n_hold_regs=1u,
+		.commit_regs_write_cb=legacy_commit_cb,
+		.commit=&commit,
+	};
+	mbinst_init(&inst);
+	mbcommit_init(&commit);
+	s_n_commits = 0u;
+	s_n_legacy_commits = 0u;
+
+	ASSERT_EQ(5u, write_regs(&inst, 0x100u, 16u));
+	ASSERT_EQ(5u, write_regs(&inst, 0x110u, 16u));
+	ASSERT_EQ(5u, write_regs(&inst, 0x130u, 4u));
+	ASSERT_EQ(0u, s_n_commits);
+	ASSERT_EQ(0u, s_n_legacy_commits);
+
+	mbcommit_flush(&inst);
+	ASSERT_EQ(1u, s_n_commits);
+	ASSERT_EQ(2u, s_n_ranges);
+	ASSERT_EQ(0x100u, s_ranges[0].start);
+	ASSERT_EQ(32u, s_ranges[0].n);
+	ASSERT_EQ(0x130u, s_ranges[1].start);
+	ASSERT_EQ(4u, s_ranges[1].n);
+
+	mbcommit_flush(&inst); /* Nothing dirty */
+	ASSERT_EQ(1u, s_n_commits);
+	ASSERT_EQ(0u, s_n_legacy_commits);
+}
+
+TEST(mbcommit_commits_at_dirty_limit)
+{
+	struct mbcommit_s commit = {.commit_cb=commit_cb, .max_dirty_bytes=64u};
+	struct mbinst_s inst = {.hold_regs=s_regs, .n_hold_regs=1u, .commit=&commit};
+	mbinst_init(&inst);
+	mbcommit_init(&commit);
+	s_n_commits = 0u;
+
+	ASSERT_EQ(5u, write_regs(&inst, 0x100u, 16u));
+	ASSERT_EQ(0u, s_n_commits);
+	ASSERT_EQ(5u, write_regs(&inst, 0x110u, 16u));
+	ASSERT_EQ(1u, s_n_commits);
+	ASSERT_EQ(1u, s_n_ranges);
+	ASSERT_EQ(0u, commit.n_ranges);
+}
+
+TEST(mbcommit_poll_commits_after_quiet_period)
+{
+	struct mbcommit_s commit = {.commit_cb=commit_cb, .clock_cb=clock_cb, .quiet_ticks=100u};
+	struct mbinst_s inst = {.hold_regs=s_regs, .n_hold_regs=1u, .commit=&commit};
+	mbinst_init(&inst);
+	mbcommit_init(&commit);
+	s_n_commits = 0u;
+
+	s_now = 1000u;
+	ASSERT_EQ(5u, write_regs(&inst, 0x100u, 1u));
+	s_now = 1050u;
+	mbcommit_poll(&inst);
+	ASSERT_EQ(0u, s_n_commits);
+	ASSERT_EQ(5u, write_regs(&inst, 0x101u, 1u)); /* Restarts the quiet period */
+	s_now = 1120u;
+	mbcommit_poll(&inst);
+	ASSERT_EQ(0u, s_n_commits);
+	s_now = 1150u;
+	mbcommit_poll(&inst);
+	ASSERT_EQ(1u, s_n_commits);
+	ASSERT_EQ(2u, s_ranges[0].n);
+}
+
+TEST(mbcommit_without_policy_calls_commit_cb_per_request)
+{
+	struct mbinst_s inst = {.hold_regs=s_regs, .n_hold_regs=1u, .commit_regs_write_cb=legacy_commit_cb};
+	mbinst_init(&inst);
+	s_n_legacy_commits = 0u;
+
+	ASSERT_EQ(5u, write_regs(&inst, 0x100u, 2u));
+	ASSERT_EQ(5u, write_regs(&inst, 0x102u, 2u));
+	ASSERT_EQ(2u, s_n_legacy_commits);
+}
+
+TEST_MAIN(
+	mbcommit_mark_merges_adjacent_and_overlapping,
+	mbcommit_mark_merges_closest_when_full,
+	mbcommit_coalesces_requests_until_flush,
+	mbcommit_commits_at_dirty_limit,
+	mbcommit_poll_commits_after_quiet_period,
+	mbcommit_without_policy_calls_commit_cb_per_request
+);
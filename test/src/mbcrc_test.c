@@ -1,5 +1,7 @@
 #include "test_lib.h"
 #include <mbcrc.h>
+#include <stddef.h>
+#include <stdint.h>
 
 TEST(mbcrc16_known_values)
 {
@@ -64,9 +66,56 @@ TEST(mbcrc16_single_byte_values)
 	}
 }
 
+static uint16_t crc16_bitwise(const uint8_t *data, size_t size)
+{
+	uint16_t crc = 0xFFFFu;
+	size_t i, bit;
+
+	for (i=0u; i<size; ++i) {
+		crc ^= data[i];
+		for (bit=0u; bit<8u; ++bit) {
+			crc = (crc & 1u) ? (uint16_t)((crc >> 1) ^ 0xA001u) : (uint16_t)(crc >> 1);
+		}
+	}
+
+	return crc;
+}
+
+TEST(mbcrc16_matches_bitwise_reference)
+{
+	uint8_t buf[300];
+	size_t i;
+	uint32_t x = 12345u;
+
+	for (i=0u; i<sizeof buf; ++i) {
+		x = x*1103515245u + 12345u;
+		buf[i] = (uint8_t)(x >> 16);
+	}
+
+	/* All lengths and alignments to cover both sliced and byte tails */
+	for (i=0u; i<=sizeof buf - 8u; ++i) {
+		ASSERT_EQ(crc16_bitwise(buf, i), mbcrc16(buf, i));
+		ASSERT_EQ(crc16_bitwise(buf+(i%8u), i), mbcrc16(buf+(i%8u), i));
+	}
+}
+
+TEST(mbcrc16_incremental_matches_oneshot)
+{
+	const uint8_t frame[] = {0x01, 0x10, 0x00, 0x01, 0x00, 0x02, 0x04, 0x00, 0x0A, 0x01, 0x02};
+	uint16_t crc;
+
+	crc = mbcrc16_init();
+	crc = mbcrc16_update(crc, frame, 3u);
+	crc = mbcrc16_update(crc, frame+3u, 0u);
+	crc = mbcrc16_update(crc, frame+3u, sizeof frame - 3u);
+	ASSERT_EQ(mbcrc16(frame, sizeof frame), mbcrc16_final(crc));
+}
+
 TEST_MAIN(
 	mbcrc16_known_values,
 	mbcrc16_modbus_frame_examples,
 	mbcrc16_zero_size_input,
-	mbcrc16_single_byte_values
+	mbcrc16_single_byte_values,
+	mbcrc16_matches_bitwise_reference,
+	mbcrc16_incremental_matches_oneshot
 )
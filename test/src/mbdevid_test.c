@@ -0,0 +1,161 @@
+#include "test_lib.h"
+#include <mbdef.h>
+#include <mbdevid.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <stdint.h>
+#include <string.h>
+
+static char s_long[3][200];
+
+static const struct mbdevid_obj_s s_objs[] = {
+	{.id=MBDEVID_VENDOR_NAME, .len=7u, .value="Company"},
+	{.id=MBDEVID_PRODUCT_CODE, .len=4u, .value="P123"},
+	{.id=MBDEVID_MAJOR_MINOR_REV, .len=4u, .value="V1.2"},
+	{.id=MBDEVID_PRODUCT_NAME, .len=5u, .value="Relay"},
+	{.id=0x80u, .len=200u, .value=s_long[0]},
+	{.id=0x81u, .len=200u, .value=s_long[1]},
+	{.id=0x90u, .len=200u, .value=s_long[2]},
+};
+
+static size_t read_dev_id(struct mbinst_s *inst, uint8_t code, uint8_t id, uint8_t *res)
+{
+	const uint8_t req[] = {MBFC_ENCAP_IFACE_TRANSPORT, MBMEI_READ_DEV_ID, code, id};
+
+	return mbpdu_handle_req(inst, req, sizeof req, res);
+}
+
+TEST(mbdevid_init_validates_objects)
+{
+	const struct mbdevid_obj_s no_rev[] = {
+		{.id=MBDEVID_VENDOR_NAME, .len=1u, .value="A"},
+		{.id=MBDEVID_PRODUCT_CODE, .len=1u, .value="B"},
+		{.id=MBDEVID_PRODUCT_NAME, .len=1u, .value="C"},
+	};
+	uint8_t buf[1024];
+	struct mbdevid_s devid = {.objs=s_objs, .n_objs=7u, .buf=buf, .buf_size=sizeof buf};
+
+	ASSERT_EQ((2u*7u) + 20u + 600u, mbdevid_size(s_objs, 7u));
+	ASSERT_EQ(1, mbdevid_init(&devid));
+	ASSERT_EQ(0x83u, devid.conformity);
+	ASSERT_EQ(mbdevid_size(s_objs, 7u), devid.len);
+
+	devid.n_objs = 4u;
+	ASSERT_EQ(1, mbdevid_init(&devid));
+	ASSERT_EQ(0x82u, devid.conformity);
+	devid.n_objs = 3u;
+	ASSERT_EQ(1, mbdevid_init(&devid));
+	ASSERT_EQ(0x81u, devid.conformity);
+
+	devid.buf_size = 10u;
+	ASSERT_EQ(0, mbdevid_init(&devid));
+
+	devid.objs = no_rev;
+	devid.buf_size = sizeof buf;
+	ASSERT_EQ(0, mbdevid_init(&devid)); /* Basic object 0x02 missing */
+}
+
+TEST(mbdevid_stream_access_by_category)
+{
+	uint8_t buf[1024];
+	struct mbdevid_s devid = {.objs=s_objs, .n_objs=7u, .buf=buf, .buf_size=sizeof buf};
+	struct mbinst_s inst = {.devid=&devid};
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	ASSERT_EQ(1, mbdevid_init(&devid));
+	mbinst_init(&inst);
+
+	ASSERT_EQ(7u + 9u + 6u + 6u, read_dev_id(&inst, MBDEVID_BASIC, 0x00u, res));
+	ASSERT_EQ(MBFC_ENCAP_IFACE_TRANSPORT, res[0]);
+	ASSERT_EQ(MBMEI_READ_DEV_ID, res[1]);
+	ASSERT_EQ(MBDEVID_BASIC, res[2]);
+	ASSERT_EQ(0x83u, res[3]);
+	ASSERT_EQ(0x00u, res[4]); /* No more follows */
+	ASSERT_EQ(0x00u, res[5]);
+	ASSERT_EQ(3u, res[6]);
+	ASSERT_EQ(MBDEVID_VENDOR_NAME, res[7]);
+	ASSERT_EQ(7u, res[8]);
+	ASSERT_EQ(0, memcmp(res+9u, "Company", 7u));
+	ASSERT_EQ(MBDEVID_MAJOR_MINOR_REV, res[7u+9u+6u]);
+
+	ASSERT_EQ(7u + 9u + 6u + 6u + 7u, read_dev_id(&inst, MBDEVID_REGULAR, 0x00u, res));
+	ASSERT_EQ(4u, res[6]);
+
+	/* Starting at a given object */
+	ASSERT_EQ(7u + 6u + 6u + 7u, read_dev_id(&inst, MBDEVID_REGULAR, MBDEVID_PRODUCT_CODE, res));
+	ASSERT_EQ(3u, res[6]);
+	ASSERT_EQ(MBDEVID_PRODUCT_CODE, res[7]);
+
+	/* Unknown object id restarts at object 0x00 */
+	ASSERT_EQ(7u + 9u + 6u + 6u, read_dev_id(&inst, MBDEVID_BASIC, 0x55u, res));
+	ASSERT_EQ(MBDEVID_VENDOR_NAME, res[7]);
+}
+
+TEST(mbdevid_stream_more_follows)
+{
+	uint8_t buf[1024];
+	struct mbdevid_s devid = {.objs=s_objs, .n_objs=7u, .buf=buf, .buf_size=sizeof buf};
+	struct mbinst_s inst = {.devid=&devid};
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	memset(s_long, 'x', sizeof s_long);
+	ASSERT_EQ(1, mbdevid_init(&devid));
+	mbinst_init(&inst);
+
+	ASSERT_EQ(7u + 9u + 6u + 6u + 7u + 202u, read_dev_id(&inst, MBDEVID_EXTENDED, 0x00u, res));
+	ASSERT_EQ(0xFFu, res[4]);
+	ASSERT_EQ(0x81u, res[5]);
+	ASSERT_EQ(5u, res[6]);
+
+	ASSERT_EQ(7u + 202u, read_dev_id(&inst, MBDEVID_EXTENDED, res[5], res));
+	ASSERT_EQ(0xFFu, res[4]);
+	ASSERT_EQ(0x90u, res[5]);
+	ASSERT_EQ(1u, res[6]);
+	ASSERT_EQ(0x81u, res[7]);
+	ASSERT_EQ('x', res[9]);
+
+	ASSERT_EQ(7u + 202u, read_dev_id(&inst, MBDEVID_EXTENDED, res[5], res));
+	ASSERT_EQ(0x00u, res[4]);
+	ASSERT_EQ(0x00u, res[5]);
+	ASSERT_EQ(0x90u, res[7]);
+}
+
+TEST(mbdevid_individual_access_and_exceptions)
+{
+	uint8_t buf[1024];
+	struct mbdevid_s devid = {.objs=s_objs, .n_objs=7u, .buf=buf, .buf_size=sizeof buf};
+	struct mbinst_s inst = {.devid=&devid};
+	struct mbinst_s no_devid = {0};
+	const uint8_t canopen[] = {MBFC_ENCAP_IFACE_TRANSPORT, MBMEI_CANOPEN, 0x00, 0x00};
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	ASSERT_EQ(1, mbdevid_init(&devid));
+	mbinst_init(&inst);
+	mbinst_init(&no_devid);
+
+	ASSERT_EQ(7u + 7u, read_dev_id(&inst, MBDEVID_INDIVIDUAL, MBDEVID_PRODUCT_NAME, res));
+	ASSERT_EQ(MBDEVID_INDIVIDUAL, res[2]);
+	ASSERT_EQ(1u, res[6]);
+	ASSERT_EQ(MBDEVID_PRODUCT_NAME, res[7]);
+	ASSERT_EQ(0, memcmp(res+9u, "Relay", 5u));
+
+	ASSERT_EQ(2u, read_dev_id(&inst, MBDEVID_INDIVIDUAL, MBDEVID_VENDOR_URL, res));
+	ASSERT_EQ(MBFC_ENCAP_IFACE_TRANSPORT | 0x80u, res[0]);
+	ASSERT_EQ(MB_ILLEGAL_DATA_ADDR, res[1]);
+
+	ASSERT_EQ(2u, read_dev_id(&inst, 0x05u, 0x00u, res));
+	ASSERT_EQ(MB_ILLEGAL_DATA_VAL, res[1]);
+
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, canopen, sizeof canopen, res));
+	ASSERT_EQ(MB_ILLEGAL_FN, res[1]);
+
+	ASSERT_EQ(2u, read_dev_id(&no_devid, MBDEVID_BASIC, 0x00u, res));
+	ASSERT_EQ(MB_ILLEGAL_FN, res[1]);
+}
+
+TEST_MAIN(
+	mbdevid_init_validates_objects,
+	mbdevid_stream_access_by_category,
+	mbdevid_stream_more_follows,
+	mbdevid_individual_access_and_exceptions
+);
@@ -3,6 +3,13 @@
 #include <mbpdu.h>
 #include <mbdef.h>
 
+#if MBCFG_EVENT_LOG_EXTERN
+static uint8_t s_event_log[MB_COMM_EVENT_LOG_LEN];
+#define ATTACH_EVENT_LOG(inst) mbinst_set_event_log((inst), s_event_log)
+#else
+#define ATTACH_EVENT_LOG(inst) ((void)(inst))
+#endif
+
 /* Test diagnostic function code 0x08 (MBFC_DIAGNOSTICS) with various subfunctions */
 
 TEST(mbdiag_loopback_works)
@@ -125,9 +132,12 @@ TEST(mbdiag_restart_comms_with_callback)
 		}
 	};
 	mbinst_init(&inst);
+	ATTACH_EVENT_LOG(&inst);
 	s_restart_called = 0;
+#if MBCFG_EVENT_LOG
 	inst.state.event_log_write_pos = 1;
 	inst.state.event_log_count = 1;
+#endif
 
 	uint8_t pdu_data[] = {
 		MBFC_DIAGNOSTICS,
@@ -144,8 +154,10 @@ TEST(mbdiag_restart_comms_with_callback)
 	ASSERT_EQ(0x00, res[4]); /* Echo data L */
 
 	ASSERT_EQ(1, s_restart_called); /* Callback should have been invoked */
+#if MBCFG_EVENT_LOG
 	ASSERT_EQ(1, inst.state.event_log_write_pos);
 	ASSERT_EQ(1, inst.state.event_log_count);
+#endif
 }
 
 TEST(mbdiag_restart_comms_invalid_data_fails)
@@ -737,8 +749,10 @@ TEST(mbdiag_get_comm_event_counter_invalid_length_fails)
 
 TEST(mbdiag_get_comm_event_log_works)
 {
+#if MBCFG_EVENT_LOG
 	struct mbinst_s inst = {0};
 	mbinst_init(&inst);
+	ATTACH_EVENT_LOG(&inst);
 
 	/* Set known values */
 	inst.state.status = 0x1234;
@@ -767,6 +781,7 @@ TEST(mbdiag_get_comm_event_log_works)
 	ASSERT_EQ(0xCC, res[8]); /* Event 0 */
 	ASSERT_EQ(0xBB, res[9]); /* Event 1 */
 	ASSERT_EQ(0xAA, res[10]); /* Event 2 */
+#endif
 }
 
 TEST(mbdiag_get_comm_event_log_empty_works)
@@ -777,7 +792,9 @@ TEST(mbdiag_get_comm_event_log_empty_works)
 	/* No events in log */
 	inst.state.status = 0x0000;
 	inst.state.comm_event_counter = 0x0000;
+#if MBCFG_EVENT_LOG
 	inst.state.event_log_count = 0;
+#endif
 
 	uint8_t pdu_data[] = {
 		MBFC_COMM_EVENT_LOG,
@@ -861,6 +878,45 @@ TEST(mbdiag_listen_only_allows_restart_comms)
 	ASSERT_EQ(0, inst.state.is_listen_only); /* Device should exit listen only mode */
 }
 
+TEST(mbdiag_get_comm_event_log_wrapped_newest_first)
+{
+#if MBCFG_EVENT_LOG
+	struct mbinst_s inst = {0};
+	uint8_t pdu_data[] = {MBFC_COMM_EVENT_LOG};
+	uint8_t res[MBPDU_SIZE_MAX];
+	size_t i;
+
+	mbinst_init(&inst);
+	ATTACH_EVENT_LOG(&inst);
+	for (i=0u; i<MB_COMM_EVENT_LOG_LEN+5u; ++i) {
+		mb_add_comm_event(&inst, (uint8_t)i);
+	}
+
+	ASSERT_EQ(8u + MB_COMM_EVENT_LOG_LEN, mbpdu_handle_req(&inst, pdu_data, sizeof pdu_data, res));
+	ASSERT_EQ(6u + MB_COMM_EVENT_LOG_LEN, res[1]);
+	for (i=0u; i<MB_COMM_EVENT_LOG_LEN; ++i) {
+		ASSERT_EQ(MB_COMM_EVENT_LOG_LEN+4u-i, res[8u+i]);
+	}
+#endif
+}
+
+TEST(mbdiag_get_comm_event_log_compiled_out_is_empty)
+{
+#if !MBCFG_EVENT_LOG
+	struct mbinst_s inst = {0};
+	uint8_t pdu_data[] = {MBFC_COMM_EVENT_LOG};
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	mbinst_init(&inst);
+	mb_add_comm_event(&inst, 0xAAu);
+
+	/* Events are not recorded, the log is answered empty */
+	ASSERT_EQ(8u, mbpdu_handle_req(&inst, pdu_data, sizeof pdu_data, res));
+	ASSERT_EQ(MBFC_COMM_EVENT_LOG, res[0]);
+	ASSERT_EQ(6u, res[1]);
+#endif
+}
+
 TEST_MAIN(
 	mbdiag_loopback_works,
 	mbdiag_restart_comms_works,
@@ -894,5 +950,7 @@ TEST_MAIN(
 	mbdiag_get_comm_event_log_empty_works,
 	mbdiag_get_comm_event_log_invalid_length_fails,
 	mbdiag_listen_only_mode_blocks_requests,
-	mbdiag_listen_only_allows_restart_comms
+	mbdiag_listen_only_allows_restart_comms,
+	mbdiag_get_comm_event_log_wrapped_newest_first,
+	mbdiag_get_comm_event_log_compiled_out_is_empty
 );
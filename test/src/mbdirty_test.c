@@ -0,0 +1,133 @@
+#include "test_lib.h"
+#include <endian.h>
+#include <mbdirty.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint16_t s_regs_val[64];
+static const struct mbreg_desc_s s_regs[] = {
+	{
+		.address=0x100u,
+		.type=MRTYPE_U16 | MRTYPE_BLOCK,
+		.n_block_entries=64u,
+		.access=MRACC_RW_PTR,
+		.read={.pu16=s_regs_val},
+		.write={.pu16=s_regs_val},
+	},
+};
+
+static uint8_t s_coils_val[4];
+static const struct mbcoil_desc_s s_coils[] = {
+	{.address=0x00u, .access=MCACC_RW_PTR, .read={.ptr=s_coils_val, .ix=0u}, .write={.ptr=s_coils_val, .ix=0u}},
+	{.address=0x01u, .access=MCACC_RW_PTR, .read={.ptr=s_coils_val, .ix=1u}, .write={.ptr=s_coils_val, .ix=1u}},
+	{.address=0x02u, .access=MCACC_RW_PTR, .read={.ptr=s_coils_val, .ix=2u}, .write={.ptr=s_coils_val, .ix=2u}},
+};
+
+TEST(mbdirty_init_checks_storage)
+{
+	struct mbdirty_s dirty;
+	uint8_t bits[2];
+
+	ASSERT_EQ(0, mbdirty_init(&dirty, bits, sizeof bits, 0u, 17u));
+	ASSERT_EQ(1, mbdirty_init(&dirty, bits, sizeof bits, 0u, 16u));
+	ASSERT_EQ(0, mbdirty_init(&dirty, bits, sizeof bits, 0xFFF8u, 16u)); /* Past the address space */
+	ASSERT(dirty.bits==NULL);
+
+	mbdirty_mark(&dirty, 0u, 1u); /* Not tracked, no effect */
+}
+
+TEST(mbdirty_mark_and_consume_ranges)
+{
+	struct mbdirty_s dirty;
+	uint8_t bits[MBDIRTY_BITMAP_SIZE(100u)];
+	struct mbdirty_range_s ranges[4];
+
+	ASSERT_EQ(1, mbdirty_init(&dirty, bits, sizeof bits, 10u, 100u));
+
+	mbdirty_mark(&dirty, 12u, 3u);
+	mbdirty_mark(&dirty, 15u, 1u); /* Adjacent, merged */
+	mbdirty_mark(&dirty, 30u, 40u); /* Spans whole bytes */
+	mbdirty_mark(&dirty, 5u, 6u); /* Clipped to 10 */
+	mbdirty_mark(&dirty, 105u, 20u); /* Clipped to 109 */
+
+	ASSERT_EQ(4u, mbdirty_consume(&dirty, ranges, 4u));
+	ASSERT_EQ(10u, ranges[0].start);
+	ASSERT_EQ(1u, ranges[0].n);
+	ASSERT_EQ(12u, ranges[1].start);
+	ASSERT_EQ(4u, ranges[1].n);
+	ASSERT_EQ(30u, ranges[2].start);
+	ASSERT_EQ(40u, ranges[2].n);
+	ASSERT_EQ(105u, ranges[3].start);
+	ASSERT_EQ(5u, ranges[3].n);
+
+	ASSERT_EQ(0u, mbdirty_consume(&dirty, ranges, 4u));
+}
+
+TEST(mbdirty_consume_keeps_remaining_ranges)
+{
+	struct mbdirty_s dirty;
+	uint8_t bits[MBDIRTY_BITMAP_SIZE(32u)];
+	struct mbdirty_range_s ranges[1];
+
+	ASSERT_EQ(1, mbdirty_init(&dirty, bits, sizeof bits, 0u, 32u));
+	mbdirty_mark(&dirty, 1u, 1u);
+	mbdirty_mark(&dirty, 20u, 2u);
+
+	ASSERT_EQ(1u, mbdirty_consume(&dirty, ranges, 1u));
+	ASSERT_EQ(1u, ranges[0].start);
+	ASSERT_EQ(1u, mbdirty_consume(&dirty, ranges, 1u));
+	ASSERT_EQ(20u, ranges[0].start);
+	ASSERT_EQ(2u, ranges[0].n);
+	ASSERT_EQ(0u, mbdirty_consume(&dirty, ranges, 1u));
+}
+
+TEST(mbinst_consume_dirty_tracks_writes)
+{
+	struct mbdirty_s hold_dirty, coils_dirty;
+	uint8_t hold_bits[MBDIRTY_BITMAP_SIZE(64u)];
+	uint8_t coils_bits[MBDIRTY_BITMAP_SIZE(3u)];
+	struct mbdirty_range_s ranges[4];
+	struct mbinst_s inst = {
+		.hold_regs=s_regs,
+		.n_hold_regs=1u,
+		.coils=s_coils,
+		.n_coils=sizeof s_coils / sizeof s_coils[0],
+		.hold_regs_dirty=&hold_dirty,
+		.coils_dirty=&coils_dirty,
+	};
+	uint8_t res[MBPDU_SIZE_MAX];
+	const uint8_t write_regs[] = {MBFC_WRITE_MULTIPLE_REGS, 0x01, 0x04, 0x00, 0x02, 0x04, 0x12, 0x34, 0x56, 0x78};
+	const uint8_t write_reg[] = {MBFC_WRITE_SINGLE_REG, 0x01, 0x20, 0xAB, 0xCD};
+	const uint8_t write_coil[] = {MBFC_WRITE_SINGLE_COIL, 0x00, 0x02, 0xFF, 0x00};
+	const uint8_t read_regs[] = {MBFC_READ_HOLDING_REGS, 0x01, 0x00, 0x00, 0x10};
+
+	mbinst_init(&inst);
+	ASSERT_EQ(1, mbdirty_init(&hold_dirty, hold_bits, sizeof hold_bits, 0x100u, 64u));
+	ASSERT_EQ(1, mbdirty_init(&coils_dirty, coils_bits, sizeof coils_bits, 0u, 3u));
+
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, write_regs, sizeof write_regs, res));
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, write_reg, sizeof write_reg, res));
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, write_coil, sizeof write_coil, res));
+	ASSERT_EQ(34u, mbpdu_handle_req(&inst, read_regs, sizeof read_regs, res)); /* Reads are not tracked */
+
+	ASSERT_EQ(2u, mbinst_consume_dirty(&inst, MBINST_DIRTY_HOLD_REGS, ranges, 4u));
+	ASSERT_EQ(0x104u, ranges[0].start);
+	ASSERT_EQ(2u, ranges[0].n);
+	ASSERT_EQ(0x120u, ranges[1].start);
+	ASSERT_EQ(1u, ranges[1].n);
+
+	ASSERT_EQ(1u, mbinst_consume_dirty(&inst, MBINST_DIRTY_COILS, ranges, 4u));
+	ASSERT_EQ(2u, ranges[0].start);
+	ASSERT_EQ(1u, ranges[0].n);
+
+	ASSERT_EQ(0u, mbinst_consume_dirty(&inst, MBINST_DIRTY_HOLD_REGS, ranges, 4u));
+}
+
+TEST_MAIN(
+	mbdirty_init_checks_storage,
+	mbdirty_mark_and_consume_ranges,
+	mbdirty_consume_keeps_remaining_ranges,
+	mbinst_consume_dirty_tracks_writes
+);
@@ -0,0 +1,128 @@
+#include "test_lib.h"
+#include <endian.h>
+#include <mbdef.h>
+#include <mbfifo.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <stdint.h>
+
+static size_t read_fifo(struct mbinst_s *inst, uint16_t addr, uint8_t *res)
+{
+	uint8_t req[3] = {MBFC_READ_FIFO_QUEUE};
+
+	u16tobe(addr, req+1u);
+	return mbpdu_handle_req(inst, req, sizeof req, res);
+}
+
+TEST(mbfifo_init_validates_size)
+{
+	uint16_t buf[8];
+	struct mbfifo_s fifo = {.buf=buf, .size=8u};
+
+	ASSERT_EQ(1, mbfifo_init(&fifo));
+	fifo.size = 6u;
+	ASSERT_EQ(0, mbfifo_init(&fifo));
+	fifo.size = 0u;
+	ASSERT_EQ(0, mbfifo_init(&fifo));
+	fifo.size = 8u;
+	fifo.buf = NULL;
+	ASSERT_EQ(0, mbfifo_init(&fifo));
+}
+
+TEST(mbfifo_push_drain_wraps)
+{
+	uint16_t buf[4];
+	struct mbfifo_s fifo = {.buf=buf, .size=4u};
+	uint8_t out[8];
+	uint16_t i;
+
+	ASSERT_EQ(1, mbfifo_init(&fifo));
+	fifo.head = 0xFFFEu; /* Indices wrap while entries are queued */
+	fifo.tail = 0xFFFEu;
+
+	for (i=0u; i<4u; ++i) {
+		ASSERT_EQ(1, mbfifo_push(&fifo, (uint16_t)(0x100u + i)));
+	}
+	ASSERT_EQ(0, mbfifo_push(&fifo, 0xDEADu)); /* Full */
+	ASSERT_EQ(4u, mbfifo_count(&fifo));
+
+	ASSERT_EQ(3u, mbfifo_drain(&fifo, out, 3u));
+	ASSERT_EQ(0x01u, out[0]);
+	ASSERT_EQ(0x00u, out[1]);
+	ASSERT_EQ(0x02u, out[5]);
+	ASSERT_EQ(1u, mbfifo_count(&fifo));
+
+	ASSERT_EQ(1, mbfifo_push(&fifo, 0x0104u));
+	ASSERT_EQ(2u, mbfifo_drain(&fifo, out, 4u));
+	ASSERT_EQ(0x03u, out[1]);
+	ASSERT_EQ(0x04u, out[3]);
+	ASSERT_EQ(0u, mbfifo_drain(&fifo, out, 4u));
+}
+
+TEST(mbfifo_read_fifo_queue_drains_entries)
+{
+	uint16_t buf[64];
+	struct mbfifo_s fifos[] = {{.address=0x04DEu, .buf=buf, .size=64u}};
+	struct mbinst_s inst = {.fifos=fifos, .n_fifos=1u};
+	uint8_t res[MBPDU_SIZE_MAX];
+	uint16_t i;
+
+	mbinst_init(&inst);
+	ASSERT_EQ(1, mbfifo_init(&fifos[0]));
+
+	/* Empty FIFO */
+	ASSERT_EQ(5u, read_fifo(&inst, 0x04DEu, res));
+	ASSERT_EQ(MBFC_READ_FIFO_QUEUE, res[0]);
+	ASSERT_EQ(2u, betou16(res+1u));
+	ASSERT_EQ(0u, betou16(res+3u));
+
+	ASSERT_EQ(1, mbfifo_push(&fifos[0], 0x01B8u));
+	ASSERT_EQ(1, mbfifo_push(&fifos[0], 0x1284u));
+	ASSERT_EQ(9u, read_fifo(&inst, 0x04DEu, res));
+	ASSERT_EQ(6u, betou16(res+1u));
+	ASSERT_EQ(2u, betou16(res+3u));
+	ASSERT_EQ(0x01B8u, betou16(res+5u));
+	ASSERT_EQ(0x1284u, betou16(res+7u));
+	ASSERT_EQ(0u, mbfifo_count(&fifos[0]));
+
+	/* More than fits in one response */
+	for (i=0u; i<40u; ++i) {
+		ASSERT_EQ(1, mbfifo_push(&fifos[0], i));
+	}
+	ASSERT_EQ(5u + (2u*MBFIFO_READ_MAX), read_fifo(&inst, 0x04DEu, res));
+	ASSERT_EQ(MBFIFO_READ_MAX, betou16(res+3u));
+	ASSERT_EQ(30u, betou16(res+5u+60u));
+	ASSERT_EQ(5u + 18u, read_fifo(&inst, 0x04DEu, res));
+	ASSERT_EQ(31u, betou16(res+5u));
+}
+
+TEST(mbfifo_read_fifo_queue_exceptions)
+{
+	uint16_t buf[4];
+	struct mbfifo_s fifos[] = {{.address=0x10u, .buf=buf, .size=4u}};
+	struct mbinst_s inst = {.fifos=fifos, .n_fifos=1u};
+	struct mbinst_s no_fifos = {0};
+	const uint8_t long_req[] = {MBFC_READ_FIFO_QUEUE, 0x00, 0x10, 0x00};
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	mbinst_init(&inst);
+	mbinst_init(&no_fifos);
+	ASSERT_EQ(1, mbfifo_init(&fifos[0]));
+
+	ASSERT_EQ(2u, read_fifo(&inst, 0x11u, res));
+	ASSERT_EQ(MBFC_READ_FIFO_QUEUE | 0x80u, res[0]);
+	ASSERT_EQ(MB_ILLEGAL_DATA_ADDR, res[1]);
+
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, long_req, sizeof long_req, res));
+	ASSERT_EQ(MB_ILLEGAL_DATA_VAL, res[1]);
+
+	ASSERT_EQ(2u, read_fifo(&no_fifos, 0x10u, res));
+	ASSERT_EQ(MB_ILLEGAL_FN, res[1]);
+}
+
+TEST_MAIN(
+	mbfifo_init_validates_size,
+	mbfifo_push_drain_wraps,
+	mbfifo_read_fifo_queue_drains_entries,
+	mbfifo_read_fifo_queue_exceptions
+);
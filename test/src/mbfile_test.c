@@ -267,6 +267,154 @@ TEST(mbfile_write_success)
 	ASSERT_EQ(0x5678u, val2);
 }
 
+TEST(mbfile_read_words)
+{
+	const uint16_t words[] = {0x1111u, 0x2222u, 0x3333u};
+	const struct mbfile_desc_s file = {
+		.file_no=1,
+		.words=words,
+		.n_words=3
+	};
+
+	uint8_t buffer[10];
+	struct mbpdu_buf_s res = {.p=buffer, .size=0};
+
+	/* Read from 1 to 4 (past the end of the file reads zero) */
+	enum mbfile_read_status_e status = mbfile_read(&file, 1, 4, &res);
+	ASSERT_EQ(MBFILE_READ_OK, status);
+	ASSERT_EQ(8u, res.size);
+
+	ASSERT_EQ(0x22u, buffer[0]);
+	ASSERT_EQ(0x22u, buffer[1]);
+	ASSERT_EQ(0x33u, buffer[2]);
+	ASSERT_EQ(0x33u, buffer[3]);
+	ASSERT_EQ(0x00u, buffer[4]);
+	ASSERT_EQ(0x00u, buffer[5]);
+	ASSERT_EQ(0x00u, buffer[6]);
+	ASSERT_EQ(0x00u, buffer[7]);
+}
+
+TEST(mbfile_read_words_missing_first_record)
+{
+	const uint16_t words[] = {0x1111u, 0x2222u};
+	const struct mbfile_desc_s file = {
+		.file_no=1,
+		.words=words,
+		.n_words=2
+	};
+
+	ASSERT_EQ(MBFILE_READ_ILLEGAL_ADDR, mbfile_read(&file, 2, 1, NULL));
+	ASSERT_EQ(MBFILE_READ_OK, mbfile_read(&file, 1, 1, NULL));
+}
+
+TEST(mbfile_write_allowed_words_read_only)
+{
+	const uint16_t words[] = {0x1111u, 0x2222u};
+	const struct mbfile_desc_s file = {
+		.file_no=1,
+		.words=words,
+		.n_words=2
+	};
+	const uint8_t val[] = {0x12, 0x34};
+
+	ASSERT_EQ(0, mbfile_write_allowed(&file, 0, 1, val));
+}
+
+static uint16_t s_region_write_no;
+static size_t s_region_write_n;
+static uint8_t s_region_write_val[8];
+static size_t s_region_write_calls;
+
+static enum mbstatus_e region_write_cb(uint16_t record_no, size_t n, const uint8_t *val)
+{
+	s_region_write_no = record_no;
+	s_region_write_n = n;
+	memcpy(s_region_write_val, val, n*2u);
+	++s_region_write_calls;
+	return MB_OK;
+}
+
+TEST(mbfile_read_region_le)
+{
+	const uint8_t bytes[] = {0x11, 0x22, 0x33, 0x44, 0x55}; /* Trailing odd byte is not a record */
+	const struct mbfile_region_s region = {.p=bytes, .size=sizeof bytes};
+	const struct mbfile_desc_s file = {.file_no=1, .region=&region};
+
+	uint8_t buffer[8];
+	struct mbpdu_buf_s res = {.p=buffer, .size=0};
+
+	ASSERT_EQ(MBFILE_READ_OK, mbfile_read(&file, 0, 3, &res));
+	ASSERT_EQ(6u, res.size);
+	ASSERT_EQ(0x22u, buffer[0]);
+	ASSERT_EQ(0x11u, buffer[1]);
+	ASSERT_EQ(0x44u, buffer[2]);
+	ASSERT_EQ(0x33u, buffer[3]);
+	ASSERT_EQ(0x00u, buffer[4]);
+	ASSERT_EQ(0x00u, buffer[5]);
+
+	ASSERT_EQ(MBFILE_READ_ILLEGAL_ADDR, mbfile_read(&file, 2, 1, NULL));
+}
+
+TEST(mbfile_read_region_be)
+{
+	const uint8_t bytes[] = {0x11, 0x22, 0x33, 0x44};
+	const struct mbfile_region_s region = {.p=bytes, .size=sizeof bytes, .is_be=1};
+	const struct mbfile_desc_s file = {.file_no=1, .region=&region};
+
+	uint8_t buffer[4];
+	struct mbpdu_buf_s res = {.p=buffer, .size=0};
+
+	ASSERT_EQ(MBFILE_READ_OK, mbfile_read(&file, 1, 1, &res));
+	ASSERT_EQ(2u, res.size);
+	ASSERT_EQ(0x33u, buffer[0]);
+	ASSERT_EQ(0x44u, buffer[1]);
+}
+
+TEST(mbfile_write_region)
+{
+	const uint8_t bytes[8] = {0};
+	const struct mbfile_region_s region = {.p=bytes, .size=sizeof bytes, .write_cb=region_write_cb};
+	const struct mbfile_region_s read_only = {.p=bytes, .size=sizeof bytes};
+	const struct mbfile_desc_s file = {.file_no=1, .region=&region};
+	const struct mbfile_desc_s ro_file = {.file_no=2, .region=&read_only};
+	const uint8_t val[] = {0x12, 0x34, 0x56, 0x78};
+
+	ASSERT_EQ(1, mbfile_write_allowed(&file, 2, 2, val));
+	ASSERT_EQ(0, mbfile_write_allowed(&file, 3, 2, val)); /* Past the end */
+	ASSERT_EQ(0, mbfile_write_allowed(&ro_file, 0, 1, val));
+
+	s_region_write_calls = 0u;
+	ASSERT_EQ(MB_OK, mbfile_write(&file, 2, 2, val));
+	ASSERT_EQ(1u, s_region_write_calls); /* Both records in one call */
+	ASSERT_EQ(2u, s_region_write_no);
+	ASSERT_EQ(2u, s_region_write_n);
+	ASSERT_EQ(0, memcmp(val, s_region_write_val, sizeof val));
+}
+
+TEST(mbfile_index_matches_search)
+{
+	const struct mbreg_desc_s regs[] = {
+		{.address=1, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=0x1234}}
+	};
+	const struct mbfile_desc_s files[] = {
+		{.file_no=1, .records=regs, .n_records=1},
+		{.file_no=3, .records=regs, .n_records=1},
+		{.file_no=0x9000, .records=regs, .n_records=1},
+	};
+	const size_t n_files = sizeof files / sizeof files[0];
+	uint16_t storage[MBPAGE_STORAGE_SIZE(2)];
+	struct mbfile_index_s ix;
+	uint32_t file_no;
+
+	ASSERT_EQ(MBPAGE_STORAGE_SIZE(2), mbfile_index_size(files, n_files));
+	ASSERT_EQ(1, mbfile_index_build(&ix, files, n_files, storage, sizeof storage / sizeof storage[0]));
+
+	for (file_no=0u; file_no<=0xFFFFu; ++file_no) {
+		ASSERT_EQ(mbfile_find(files, n_files, (uint16_t)file_no), mbfile_index_find(&ix, files, n_files, (uint16_t)file_no));
+	}
+	ASSERT_EQ(&files[1], mbfile_index_find(NULL, files, n_files, 3u));
+}
+
 TEST_MAIN(
 	mbfile_find_null_params,
 	mbfile_find_empty_array,
@@ -278,5 +426,12 @@ TEST_MAIN(
 	mbfile_read_null_buffer,
 	mbfile_write_allowed_missing_register,
 	mbfile_write_allowed_partial_success,
-	mbfile_write_success
+	mbfile_write_success,
+	mbfile_read_words,
+	mbfile_read_words_missing_first_record,
+	mbfile_write_allowed_words_read_only,
+	mbfile_read_region_le,
+	mbfile_read_region_be,
+	mbfile_write_region,
+	mbfile_index_matches_search
 );
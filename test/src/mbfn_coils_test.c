@@ -859,6 +859,43 @@ TEST(mbpdu_write_multiple_coils_calls_commit_cb_once)
 	ASSERT_EQ(1, s_commit_count); /* called exactly once regardless of coil count */
 }
 
+TEST(mbpdu_write_multiple_coils_merges_runs_sharing_a_byte)
+{
+	uint8_t b0 = 0x00u, b1 = 0x83u;
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x0000u, .access=MCACC_W_PTR, .write={.ptr=&b0, .ix=0u}},
+		{.address=0x0001u, .access=MCACC_W_PTR, .write={.ptr=&b0, .ix=1u}},
+		{.address=0x0002u, .access=MCACC_W_PTR, .write={.ptr=&b0, .ix=2u}},
+		{.address=0x0003u, .access=MCACC_W_PTR, .write={.ptr=&b0, .ix=3u}},
+		{.address=0x0004u, .access=MCACC_W_PTR, .write={.ptr=&b0, .ix=4u}},
+		{.address=0x0005u, .access=MCACC_W_PTR, .write={.ptr=&b0, .ix=5u}},
+		{.address=0x0006u, .access=MCACC_W_PTR, .write={.ptr=&b0, .ix=6u}},
+		{.address=0x0007u, .access=MCACC_W_PTR, .write={.ptr=&b0, .ix=7u}},
+		{.address=0x0008u, .access=MCACC_W_PTR, .write={.ptr=&b1, .ix=2u}},
+		{.address=0x0009u, .access=MCACC_W_PTR, .write={.ptr=&b1, .ix=3u}},
+		{.address=0x000Au, .access=MCACC_W_PTR, .write={.ptr=&b1, .ix=4u}},
+		{.address=0x000Bu, .access=MCACC_W_PTR, .write={.ptr=&b1, .ix=5u}},
+		{.address=0x000Cu, .access=MCACC_W_PTR, .write={.ptr=&b1, .ix=6u}, .post_write_cb=post_write_cb},
+	};
+	struct mbinst_s inst = {
+		.coils=coils,
+		.n_coils=sizeof coils / sizeof coils[0]
+	};
+	mbinst_init(&inst);
+	s_post_write_count = 0;
+
+	/* qty=13, byte_count=2 */
+	uint8_t pdu[] = {MBFC_WRITE_MULTIPLE_COILS, 0x00u, 0x00u, 0x00u, 0x0Du, 0x02u, 0xA5u, 0x1Eu};
+	uint8_t res[MBPDU_SIZE_MAX];
+	size_t res_size = mbpdu_handle_req(&inst, pdu, sizeof pdu, res);
+
+	ASSERT_EQ(5u, res_size);
+	ASSERT_EQ(MBFC_WRITE_MULTIPLE_COILS, res[0]);
+	ASSERT_EQ(0xA5u, b0);
+	ASSERT_EQ(0xFBu, b1); /* Bits 0, 1 and 7 kept */
+	ASSERT_EQ(1, s_post_write_count);
+}
+
 TEST_MAIN(
 	mbfn_read_coils_null_inst_fails,
 	mbfn_read_coils_null_coils_fails,
@@ -901,5 +938,6 @@ TEST_MAIN(
 	mbpdu_write_multiple_coils_addr_missing_fails,
 	mbpdu_write_multiple_coils_readonly_fails,
 	mbpdu_write_multiple_coils_calls_post_write_cb_per_coil,
-	mbpdu_write_multiple_coils_calls_commit_cb_once
+	mbpdu_write_multiple_coils_calls_commit_cb_once,
+	mbpdu_write_multiple_coils_merges_runs_sharing_a_byte
 );
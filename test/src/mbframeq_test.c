@@ -0,0 +1,126 @@
+#include "test_lib.h"
+#include <endian.h>
+#include <mbcrc.h>
+#include <mbframeq.h>
+#include <mbinst.h>
+#include <mbreg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint16_t s_reg;
+
+static const struct mbreg_desc_s s_regs[] = {
+	{.address=0x0000, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&s_reg}, .write={.pu16=&s_reg}},
+};
+
+static struct mbframeq_slot_s s_slots[4];
+
+/* Receives a read of holding register 0 into a reserved slot, as a DMA would */
+static void recv_read(struct mbframeq_s *q, struct mbframeq_slot_s *slot, uint8_t slave_addr)
+{
+	static const uint8_t pdu[] = {0x03, 0x00, 0x00, 0x00, 0x01};
+
+	slot->req[0] = slave_addr;
+	memcpy(slot->req+1, pdu, sizeof pdu);
+	u16tole(mbcrc16(slot->req, 1u + sizeof pdu), slot->req + 1u + sizeof pdu);
+	mbframeq_commit(q, slot, 3u + sizeof pdu);
+}
+
+TEST(mbframeq_init_checks_slots)
+{
+	struct mbframeq_s q;
+
+	ASSERT_EQ(0, mbframeq_init(&q, s_slots, 0u));
+	ASSERT_EQ(0, mbframeq_init(&q, s_slots, 3u));
+	ASSERT_EQ(0, mbframeq_init(&q, NULL, 4u));
+	ASSERT_EQ(1, mbframeq_init(&q, s_slots, 4u));
+	ASSERT_EQ(0u, mbframeq_pending(&q));
+	ASSERT(mbframeq_pop(&q) == NULL);
+}
+
+TEST(mbframeq_handles_frames_in_place)
+{
+	struct mbframeq_s q;
+	struct mbinst_s inst = {.serial={.slave_addr=1u}, .hold_regs=s_regs, .n_hold_regs=1u};
+	struct mbframeq_slot_s *rx, *slot;
+	mbinst_init(&inst);
+	s_reg = 0x1234u;
+	ASSERT_EQ(1, mbframeq_init(&q, s_slots, 4u));
+
+	rx = mbframeq_reserve(&q);
+	ASSERT(rx != NULL);
+	ASSERT(mbframeq_handle(&q, &inst) == NULL); /* Not committed yet */
+	recv_read(&q, rx, 1u);
+	ASSERT_EQ(1u, mbframeq_pending(&q));
+
+	slot = mbframeq_handle(&q, &inst);
+	ASSERT(slot == rx);
+	ASSERT_EQ(7u, slot->res_len);
+	ASSERT_EQ(0x03u, slot->res[1]);
+	ASSERT_EQ(0x12u, slot->res[3]);
+	ASSERT_EQ(0x34u, slot->res[4]);
+	ASSERT_EQ(0u, mbframeq_pending(&q));
+
+	/* Other slaves and dropped frames get no response */
+	recv_read(&q, mbframeq_reserve(&q), 2u);
+	mbframeq_commit(&q, mbframeq_reserve(&q), 0u);
+	ASSERT_EQ(0u, mbframeq_handle(&q, &inst)->res_len);
+	ASSERT_EQ(0u, mbframeq_handle(&q, &inst)->res_len);
+	ASSERT(mbframeq_handle(&q, &inst) == NULL);
+
+	mbframeq_release(&q);
+	mbframeq_release(&q);
+	mbframeq_release(&q);
+	mbframeq_release(&q); /* Nothing popped */
+	ASSERT_EQ(0u, q.n_dropped);
+}
+
+TEST(mbframeq_full_queue_drops_frames)
+{
+	struct mbframeq_s q;
+	struct mbframeq_slot_s *first;
+	size_t i;
+	ASSERT_EQ(1, mbframeq_init(&q, s_slots, 4u));
+
+	first = mbframeq_reserve(&q);
+	for (i=1u; i<4u; ++i) {
+		ASSERT(mbframeq_reserve(&q) != NULL);
+	}
+	ASSERT(mbframeq_reserve(&q) == NULL);
+	ASSERT_EQ(1u, q.n_dropped);
+
+	/* A popped slot stays in use until released, e.g. while its response is sent */
+	mbframeq_commit(&q, first, 0u);
+	ASSERT(mbframeq_pop(&q) == first);
+	ASSERT(mbframeq_reserve(&q) == NULL);
+	mbframeq_release(&q);
+	ASSERT(mbframeq_reserve(&q) == first);
+	ASSERT_EQ(2u, q.n_dropped);
+}
+
+TEST(mbframeq_pops_in_reservation_order)
+{
+	struct mbframeq_s q;
+	struct mbframeq_slot_s *low, *high;
+	ASSERT_EQ(1, mbframeq_init(&q, s_slots, 4u));
+
+	/* A higher priority interrupt commits while a lower one is still receiving */
+	low = mbframeq_reserve(&q);
+	high = mbframeq_reserve(&q);
+	mbframeq_commit(&q, high, 8u);
+	ASSERT_EQ(2u, mbframeq_pending(&q));
+	ASSERT(mbframeq_pop(&q) == NULL);
+
+	mbframeq_commit(&q, low, 8u);
+	ASSERT(mbframeq_pop(&q) == low);
+	ASSERT(mbframeq_pop(&q) == high);
+	ASSERT(mbframeq_pop(&q) == NULL);
+}
+
+TEST_MAIN(
+	mbframeq_init_checks_slots,
+	mbframeq_handles_frames_in_place,
+	mbframeq_full_queue_drops_frames,
+	mbframeq_pops_in_reservation_order
+);
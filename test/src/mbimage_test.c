@@ -0,0 +1,179 @@
+#include "test_lib.h"
+#include "test_policy.h"
+#include <endian.h>
+#include <mbimage.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint16_t s_vals[4];
+static uint32_t s_u32;
+static int s_locked;
+static int lock_cb(void)
+{
+	return s_locked;
+}
+
+#if MBCFG_COMPACT_REGS
+const struct mbreg_policy_s mbreg_policies[] = {
+	{0},
+	{.rlock_cb=lock_cb},
+};
+#endif
+
+static const struct mbreg_desc_s s_regs[] = {
+	{
+		.address=0x10u,
+		.type=MRTYPE_U16 | MRTYPE_BLOCK,
+		.access=MRACC_R_PTR,
+		.read={.pu16=s_vals},
+		.n_block_entries=4u,
+	},
+	/* 0x14 not mapped */
+	{
+		.address=0x15u,
+		.type=MRTYPE_U32,
+		.access=MRACC_R_PTR,
+		.read={.pu32=&s_u32},
+		REG_CBS(1u, .rlock_cb=lock_cb),
+	},
+};
+
+static uint8_t s_bufs[3][2u*7u];
+
+static size_t read_input_regs(struct mbinst_s *inst, uint16_t addr, uint16_t n, uint8_t *res)
+{
+	uint8_t req[5] = {MBFC_READ_INPUT_REGS};
+
+	u16tobe(addr, req+1u);
+	u16tobe(n, req+3u);
+	return mbpdu_handle_req(inst, req, sizeof req, res);
+}
+
+TEST(mbimage_init_validates_configuration)
+{
+	struct mbimage_s img = {.start=0x10u, .n_regs=7u, .bufs={s_bufs[0], s_bufs[1]}, .n_bufs=2u};
+
+	ASSERT_EQ(1, mbimage_init(&img));
+	img.n_bufs = 1u;
+	ASSERT_EQ(0, mbimage_init(&img));
+	img.n_bufs = 3u; /* Third image missing */
+	ASSERT_EQ(0, mbimage_init(&img));
+	img.bufs[2] = s_bufs[2];
+	ASSERT_EQ(1, mbimage_init(&img));
+	img.start = 0xFFFFu;
+	ASSERT_EQ(0, mbimage_init(&img));
+}
+
+TEST(mbimage_publish_rotates_images)
+{
+	struct mbimage_s img = {.start=0x10u, .n_regs=7u, .bufs={s_bufs[0], s_bufs[1], s_bufs[2]}, .n_bufs=3u};
+	uint8_t out[2];
+	ASSERT_EQ(1, mbimage_init(&img));
+
+	ASSERT(mbimage_back(&img)==s_bufs[1]);
+	u16tobe(0x1111u, mbimage_back(&img));
+	ASSERT_EQ(MB_OK, mbimage_read(&img, 0x10u, 1u, out));
+	ASSERT_EQ(0x0000u, betou16(out)); /* Not yet published */
+
+	mbimage_publish(&img);
+	ASSERT_EQ(MB_OK, mbimage_read(&img, 0x10u, 1u, out));
+	ASSERT_EQ(0x1111u, betou16(out));
+	ASSERT(mbimage_back(&img)==s_bufs[2]);
+
+	mbimage_publish(&img);
+	ASSERT(mbimage_back(&img)==s_bufs[0]);
+	mbimage_publish(&img);
+	ASSERT(mbimage_back(&img)==s_bufs[1]);
+}
+
+TEST(mbimage_covers_checks_range)
+{
+	struct mbimage_s img = {.start=0x10u, .n_regs=7u, .bufs={s_bufs[0], s_bufs[1]}, .n_bufs=2u};
+	ASSERT_EQ(1, mbimage_init(&img));
+
+	ASSERT_EQ(1, mbimage_covers(&img, 0x10u, 7u));
+	ASSERT_EQ(1, mbimage_covers(&img, 0x16u, 1u));
+	ASSERT_EQ(0, mbimage_covers(&img, 0x0Fu, 2u));
+	ASSERT_EQ(0, mbimage_covers(&img, 0x16u, 2u));
+	ASSERT_EQ(0, mbimage_covers(NULL, 0x10u, 1u));
+}
+
+TEST(mbimage_serves_published_scan)
+{
+	struct mbimage_s img = {.start=0x10u, .n_regs=7u, .bufs={s_bufs[0], s_bufs[1]}, .n_bufs=2u};
+	struct mbinst_s inst = {
+		.input_regs=s_regs,
+		.n_input_regs=2u,
+		.input_regs_image=&img,
+	};
+	uint8_t res[MBPDU_SIZE_MAX];
+	mbinst_init(&inst);
+	ASSERT_EQ(1, mbimage_init(&img));
+
+	s_vals[0] = 0x0102u;
+	s_vals[3] = 0x0304u;
+	s_u32 = 0x05060708u;
+	s_locked = 0;
+	ASSERT_EQ(MB_OK, mbimage_capture(&img, s_regs, 2u, 0));
+	mbimage_publish(&img);
+
+	/* Next scan in progress, not published */
+	s_vals[0] = 0xFFFFu;
+	s_u32 = 0xFFFFFFFFu;
+	ASSERT_EQ(MB_OK, mbimage_capture(&img, s_regs, 2u, 0));
+
+	ASSERT_EQ(16u, read_input_regs(&inst, 0x10u, 7u, res));
+	ASSERT_EQ(14u, res[1]);
+	ASSERT_EQ(0x0102u, betou16(res+2u));
+	ASSERT_EQ(0x0304u, betou16(res+8u));
+	ASSERT_EQ(0x0000u, betou16(res+10u)); /* Gap */
+	ASSERT_EQ(0x0506u, betou16(res+12u));
+	ASSERT_EQ(0x0708u, betou16(res+14u));
+
+	mbimage_publish(&img);
+	ASSERT_EQ(6u, read_input_regs(&inst, 0x15u, 2u, res));
+	ASSERT_EQ(0xFFFFu, betou16(res+2u));
+
+	/* Locked registers are captured as zero */
+	s_locked = 1;
+	ASSERT_EQ(MB_OK, mbimage_capture(&img, s_regs, 2u, 0));
+	mbimage_publish(&img);
+	ASSERT_EQ(6u, read_input_regs(&inst, 0x15u, 2u, res));
+	ASSERT_EQ(0x0000u, betou16(res+2u));
+	s_locked = 0;
+}
+
+TEST(mbimage_outside_range_reads_descriptors)
+{
+	static uint16_t other = 0xABCDu;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_R_PTR, .read={.pu16=&other}},
+		{.address=0x10u, .type=MRTYPE_U16, .access=MRACC_R_PTR, .read={.pu16=&other}},
+	};
+	struct mbimage_s img = {.start=0x10u, .n_regs=7u, .bufs={s_bufs[0], s_bufs[1]}, .n_bufs=2u};
+	struct mbinst_s inst = {
+		.input_regs=regs,
+		.n_input_regs=2u,
+		.input_regs_image=&img,
+	};
+	uint8_t res[MBPDU_SIZE_MAX];
+	mbinst_init(&inst);
+	ASSERT_EQ(1, mbimage_init(&img)); /* Image all zero */
+
+	ASSERT_EQ(4u, read_input_regs(&inst, 0x00u, 1u, res));
+	ASSERT_EQ(0xABCDu, betou16(res+2u));
+	ASSERT_EQ(4u, read_input_regs(&inst, 0x10u, 1u, res));
+	ASSERT_EQ(0x0000u, betou16(res+2u));
+	ASSERT_EQ(2u, read_input_regs(&inst, 0x10u, 0u, res)); /* Quantity still checked */
+	ASSERT_EQ(MBFC_READ_INPUT_REGS | 0x80u, res[0]);
+}
+
+TEST_MAIN(
+	mbimage_init_validates_configuration,
+	mbimage_publish_rotates_images,
+	mbimage_covers_checks_range,
+	mbimage_serves_published_scan,
+	mbimage_outside_range_reads_descriptors
+);
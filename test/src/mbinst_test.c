@@ -1,6 +1,19 @@
 #include "test_lib.h"
+#include <endian.h>
+#include <mbadu.h>
+#include <mbcrc.h>
 #include <mbinst.h>
 #include <stdint.h>
+#if MBCFG_ATOMIC_STATE && !defined(__STDC_NO_THREADS__)
+#include <threads.h>
+#endif
+
+#if MBCFG_EVENT_LOG_EXTERN
+static uint8_t s_event_log[MB_COMM_EVENT_LOG_LEN];
+#define ATTACH_EVENT_LOG(inst) mbinst_set_event_log((inst), s_event_log)
+#else
+#define ATTACH_EVENT_LOG(inst) ((void)(inst))
+#endif
 
 TEST(mbinst_init_clears_is_listen_only)
 {
@@ -28,12 +41,14 @@ TEST(mbinst_init_clears_comm_event_counter)
 
 TEST(mbinst_init_clears_event_log_state)
 {
+#if MBCFG_EVENT_LOG
 	struct mbinst_s inst = {0};
 	inst.state.event_log_write_pos = 10;
 	inst.state.event_log_count = 5;
 	mbinst_init(&inst);
 	ASSERT_EQ(0, inst.state.event_log_write_pos);
 	ASSERT_EQ(0, inst.state.event_log_count);
+#endif
 }
 
 TEST(mbinst_init_clears_bus_counters)
@@ -68,62 +83,79 @@ TEST(mbinst_init_sets_ascii_delimiter_to_newline)
 
 TEST(mb_add_comm_event_stores_event_at_pos_zero)
 {
+#if MBCFG_EVENT_LOG
 	struct mbinst_s inst = {0};
 	mbinst_init(&inst);
+	ATTACH_EVENT_LOG(&inst);
 	mb_add_comm_event(&inst, 0xABu);
 	ASSERT_EQ(0xABu, inst.state.event_log[0]);
+#endif
 }
 
 TEST(mb_add_comm_event_increments_count)
 {
+#if MBCFG_EVENT_LOG
 	struct mbinst_s inst = {0};
 	mbinst_init(&inst);
+	ATTACH_EVENT_LOG(&inst);
 	ASSERT_EQ(0, inst.state.event_log_count);
 	mb_add_comm_event(&inst, 0x01u);
 	ASSERT_EQ(1, inst.state.event_log_count);
 	mb_add_comm_event(&inst, 0x02u);
 	ASSERT_EQ(2, inst.state.event_log_count);
+#endif
 }
 
 TEST(mb_add_comm_event_advances_write_pos)
 {
+#if MBCFG_EVENT_LOG
 	struct mbinst_s inst = {0};
 	mbinst_init(&inst);
+	ATTACH_EVENT_LOG(&inst);
 	mb_add_comm_event(&inst, 0x01u);
 	ASSERT_EQ(1, inst.state.event_log_write_pos);
 	mb_add_comm_event(&inst, 0x02u);
 	ASSERT_EQ(2, inst.state.event_log_write_pos);
 	ASSERT_EQ(0x01u, inst.state.event_log[0]);
 	ASSERT_EQ(0x02u, inst.state.event_log[1]);
+#endif
 }
 
 TEST(mb_add_comm_event_wraps_write_pos_at_log_len)
 {
+#if MBCFG_EVENT_LOG
 	struct mbinst_s inst = {0};
 	int i;
 	mbinst_init(&inst);
+	ATTACH_EVENT_LOG(&inst);
 	for (i = 0; i < MB_COMM_EVENT_LOG_LEN; ++i) {
 		mb_add_comm_event(&inst, (uint8_t)i);
 	}
 	ASSERT_EQ(0, inst.state.event_log_write_pos);
+#endif
 }
 
 TEST(mb_add_comm_event_count_caps_at_log_len)
 {
+#if MBCFG_EVENT_LOG
 	struct mbinst_s inst = {0};
 	int i;
 	mbinst_init(&inst);
+	ATTACH_EVENT_LOG(&inst);
 	for (i = 0; i < MB_COMM_EVENT_LOG_LEN + 10; ++i) {
 		mb_add_comm_event(&inst, (uint8_t)i);
 	}
 	ASSERT_EQ(MB_COMM_EVENT_LOG_LEN, inst.state.event_log_count);
+#endif
 }
 
 TEST(mb_add_comm_event_overwrites_oldest_when_full)
 {
+#if MBCFG_EVENT_LOG
 	struct mbinst_s inst = {0};
 	int i;
 	mbinst_init(&inst);
+	ATTACH_EVENT_LOG(&inst);
 	/* Fill ring buffer with sequential values 0..63 */
 	for (i = 0; i < MB_COMM_EVENT_LOG_LEN; ++i) {
 		mb_add_comm_event(&inst, (uint8_t)i);
@@ -132,8 +164,315 @@ TEST(mb_add_comm_event_overwrites_oldest_when_full)
 	mb_add_comm_event(&inst, 0xFFu);
 	ASSERT_EQ(0xFFu, inst.state.event_log[0]);
 	ASSERT_EQ(MB_COMM_EVENT_LOG_LEN, inst.state.event_log_count);
+#endif
+}
+
+TEST(mbinst_set_event_log_null_logs_nothing)
+{
+#if MBCFG_EVENT_LOG_EXTERN
+	struct mbinst_s inst = {0};
+	mbinst_init(&inst);
+	mbinst_set_event_log(&inst, NULL);
+	mb_add_comm_event(&inst, 0x01u);
+	ASSERT_EQ(0, inst.state.event_log_count);
+	ASSERT_EQ(0, inst.state.event_log_write_pos);
+
+	/* Attaching a buffer starts an empty log */
+	mbinst_set_event_log(&inst, s_event_log);
+	mb_add_comm_event(&inst, 0x02u);
+	ASSERT_EQ(1, inst.state.event_log_count);
+	ASSERT_EQ(0x02u, s_event_log[0]);
+	mbinst_set_event_log(&inst, s_event_log);
+	ASSERT_EQ(0, inst.state.event_log_count);
+	ASSERT_EQ(0, inst.state.event_log_write_pos);
+
+	mbinst_set_event_log(NULL, s_event_log); /* No effect */
+#endif
+}
+
+TEST(mbinst_init_worker_shares_config)
+{
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=0x1234}},
+	};
+	struct mbinst_s base = {
+		.hold_regs=regs,
+		.n_hold_regs=1u,
+		.swap_words=1,
+	};
+	struct mbinst_s worker;
+
+	mbinst_init(&base);
+	base.state.msg_counter = 5u;
+	base.state.is_listen_only = 1;
+
+	mbinst_init_worker(&worker, &base);
+	ASSERT(worker.hold_regs == regs);
+	ASSERT_EQ(1u, worker.n_hold_regs);
+	ASSERT_EQ(1, worker.swap_words);
+	ASSERT_EQ(0u, worker.state.msg_counter);
+	ASSERT_EQ(0, worker.state.is_listen_only);
+	ASSERT_EQ(5u, base.state.msg_counter);
+}
+
+TEST(mbinst_sum_counters_sums_workers)
+{
+	struct mbinst_s workers[3];
+	struct mbinst_state_s sum;
+
+	for (size_t i=0u; i<3u; ++i) {
+		mbinst_init(&workers[i]);
+		workers[i].state.msg_counter = (uint16_t)(i+1u);
+		workers[i].state.exception_counter = 0x8000u;
+		workers[i].state.is_listen_only = 1;
+	}
+
+	mbinst_sum_counters(&sum, workers, 3u);
+	ASSERT_EQ(6u, sum.msg_counter);
+	ASSERT_EQ(0x8000u, sum.exception_counter); /* Wraps at 16 bits */
+	ASSERT_EQ(0, sum.is_listen_only);
+#if MBCFG_EVENT_LOG
+	ASSERT_EQ(0, sum.event_log_count);
+#endif
+}
+
+TEST(mbinst_sum_counters_no_insts_clears)
+{
+	struct mbinst_state_s sum;
+
+	sum.msg_counter = 7u;
+	mbinst_sum_counters(&sum, NULL, 0u);
+	ASSERT_EQ(0u, sum.msg_counter);
+}
+
+static uint16_t s_prep_vals[8];
+static uint64_t s_prep_now;
+static uint64_t prep_clock_cb(void)
+{
+	return s_prep_now += 10u;
+}
+
+TEST(mbinst_prepare_builds_index_and_kernels)
+{
+	const struct mbreg_desc_s hold_regs[] = {
+		{.address=0x10u, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&s_prep_vals[0]}, .write={.pu16=&s_prep_vals[0]}},
+		{.address=0x11u, .type=MRTYPE_U16 | MRTYPE_BLOCK, .n_block_entries=4u, .access=MRACC_R_PTR, .read={.pu16=&s_prep_vals[1]}},
+	};
+	const struct mbreg_desc_s input_regs[] = {
+		{.address=0x0000u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=1u}},
+		{.address=0x4000u, .type=MRTYPE_U32, .access=MRACC_R_VAL, .read={.u32=2u}},
+	};
+	struct mbinst_s inst = {
+		.hold_regs=hold_regs,
+		.n_hold_regs=2u,
+		.input_regs=input_regs,
+		.n_input_regs=2u,
+	};
+	uint16_t ix_buf[16];
+	struct mbreg_kernel_s kern_buf[3];
+	struct mbinst_prep_s prep = {
+		.ix_buf=ix_buf,
+		.ix_buf_len=16u,
+		.kern_buf=kern_buf,
+		.kern_buf_len=3u,
+		.clock_cb=prep_clock_cb,
+	};
+
+	mbinst_init(&inst);
+	ASSERT_EQ(1, mbinst_prepare(&inst, &prep));
+
+	/* Holding registers dense (5 addresses), input registers as ranges (4 entries) */
+	ASSERT(inst.hold_regs_ix == &prep.hold_regs_ix);
+	ASSERT(prep.hold_regs_ix.slots != NULL);
+	ASSERT(inst.input_regs_ix == &prep.input_regs_ix);
+	ASSERT(prep.input_regs_ix.starts != NULL);
+	ASSERT_EQ(9u, prep.n_ix_used);
+
+	/* Only the holding register kernels fit */
+	ASSERT(inst.hold_regs_kern == kern_buf);
+	ASSERT(inst.input_regs_kern == NULL);
+	ASSERT_EQ(2u, prep.n_kern_used);
+	ASSERT_EQ((9u * sizeof ix_buf[0]) + (2u * sizeof kern_buf[0]), prep.n_bytes);
+	ASSERT_EQ(10u, prep.ticks);
+
+	ASSERT(mbreg_index_find(inst.input_regs_ix, input_regs, 2u, 0x4001u) == &input_regs[1]);
+	ASSERT(mbreg_index_find(inst.hold_regs_ix, hold_regs, 2u, 0x14u) == &hold_regs[1]);
+}
+
+TEST(mbinst_prepare_reports_invalid_descriptor)
+{
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x00u, .access=MCACC_R_VAL},
+		{.address=0x01u, .access=MCACC_R_VAL},
+	};
+	const struct mbreg_desc_s hold_regs[] = {
+		{.address=0x10u, .type=MRTYPE_U32, .access=MRACC_R_VAL},
+		{.address=0x11u, .type=MRTYPE_U16, .access=MRACC_R_VAL}, /* Inside the U32 */
+	};
+	struct mbinst_s inst = {
+		.coils=coils,
+		.n_coils=2u,
+		.hold_regs=hold_regs,
+		.n_hold_regs=2u,
+	};
+	struct mbinst_prep_s prep = {0};
+
+	mbinst_init(&inst);
+	ASSERT_EQ(0, mbinst_prepare(&inst, &prep));
+	ASSERT_EQ(MBINST_MAP_HOLD_REGS, prep.issue_map);
+	ASSERT_EQ(0x11u, prep.issue_addr);
+	ASSERT(inst.hold_regs_ix == NULL);
+
+	inst.n_hold_regs = 1u;
+	ASSERT_EQ(1, mbinst_prepare(&inst, &prep));
+	ASSERT(inst.hold_regs_ix == NULL); /* No storage, lookups search the map */
+	ASSERT_EQ(0u, prep.n_bytes);
+}
+
+TEST(mbinst_prepare_builds_paged_indices)
+{
+	const struct mbreg_desc_s hold_regs[] = {
+		{.address=0x0010u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=1u}},
+		{.address=0xF000u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=2u}},
+	};
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x0000u, .access=MCACC_R_VAL, .read={.val=1}},
+		{.address=0x8000u, .access=MCACC_R_VAL, .read={.val=0}},
+	};
+	struct mbinst_s inst = {
+		.hold_regs=hold_regs,
+		.n_hold_regs=2u,
+		.coils=coils,
+		.n_coils=2u,
+		.disc_inputs=coils,
+		.n_disc_inputs=2u,
+	};
+	static uint16_t ix_buf[2u * MBPAGE_STORAGE_SIZE(2)];
+	struct mbinst_prep_s prep = {
+		.ix_buf=ix_buf,
+		.ix_buf_len=sizeof ix_buf / sizeof ix_buf[0],
+	};
+
+	mbinst_init(&inst);
+	ASSERT_EQ(1, mbinst_prepare(&inst, &prep));
+
+	/* Paged is smaller than dense for the holding registers, only one coil index fits */
+	ASSERT(inst.hold_regs_ix == &prep.hold_regs_ix);
+	ASSERT(prep.hold_regs_ix.pages.dir != NULL);
+	ASSERT(inst.coils_ix == &prep.coils_ix);
+	ASSERT(inst.disc_inputs_ix == NULL);
+	ASSERT_EQ(2u * MBPAGE_STORAGE_SIZE(2), prep.n_ix_used);
+
+	ASSERT(mbreg_index_find(inst.hold_regs_ix, hold_regs, 2u, 0xF000u) == &hold_regs[1]);
+	ASSERT(mbcoil_index_find(inst.coils_ix, coils, 2u, 0x8000u) == &coils[1]);
+}
+
+TEST(mbinst_prepare_const_time_requires_index)
+{
+	const struct mbreg_desc_s hold_regs[] = {
+		{.address=0x0000u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=1u}},
+		{.address=0x4000u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=2u}},
+	};
+	struct mbinst_s inst = {
+		.hold_regs=hold_regs,
+		.n_hold_regs=2u,
+	};
+	static uint16_t ix_buf[MBPAGE_STORAGE_SIZE(2)];
+	struct mbinst_prep_s prep = {
+		.ix_buf=ix_buf,
+		.ix_buf_len=4u, /* Room for the range index only */
+		.const_time=1,
+	};
+
+	mbinst_init(&inst);
+	ASSERT_EQ(0, mbinst_prepare(&inst, &prep));
+	ASSERT_EQ(MBINST_MAP_HOLD_REGS, prep.issue_map);
+	ASSERT_EQ(0x0000u, prep.issue_addr);
+	ASSERT(inst.hold_regs_ix == NULL);
+
+	prep.ix_buf_len = sizeof ix_buf / sizeof ix_buf[0];
+	ASSERT_EQ(1, mbinst_prepare(&inst, &prep));
+	ASSERT(inst.hold_regs_ix == &prep.hold_regs_ix);
+	ASSERT(prep.hold_regs_ix.pages.dir != NULL);
+
+	/* Without const_time the range index is accepted */
+	prep.ix_buf_len = 4u;
+	prep.const_time = 0;
+	ASSERT_EQ(1, mbinst_prepare(&inst, &prep));
+	ASSERT(prep.hold_regs_ix.starts != NULL);
+}
+
+#if MBCFG_ATOMIC_STATE && !defined(__STDC_NO_THREADS__)
+enum {N_THREADS=4, N_REQS_PER_THREAD=2000};
+
+static int handle_reqs(void *arg)
+{
+	struct mbinst_s *inst = arg;
+	uint8_t req[] = {1u, MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00};
+	uint8_t res[MBADU_SIZE_MAX];
+	int i;
+	u16tole(mbcrc16(req, sizeof req - 2u), req + sizeof req - 2u);
+
+	for (i=0; i<N_REQS_PER_THREAD; ++i) {
+		if (mbadu_handle_req(inst, req, sizeof req, res)==0u) return 1;
+	}
+	return 0;
+}
+
+TEST(mbinst_atomic_state_counts_requests_of_all_threads)
+{
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=0x1234}},
+	};
+	struct mbinst_s inst = {.hold_regs=regs, .n_hold_regs=1u, .serial={.slave_addr=1u}};
+	thrd_t thrds[N_THREADS];
+	int i, rc;
+	mbinst_init(&inst);
+	ATTACH_EVENT_LOG(&inst);
+
+	for (i=0; i<N_THREADS; ++i) {
+		ASSERT_EQ(thrd_success, thrd_create(&thrds[i], handle_reqs, &inst));
+	}
+	for (i=0; i<N_THREADS; ++i) {
+		ASSERT_EQ(thrd_success, thrd_join(thrds[i], &rc));
+		ASSERT_EQ(0, rc);
+	}
+
+	ASSERT_EQ(N_THREADS*N_REQS_PER_THREAD, inst.state.bus_msg_counter);
+	ASSERT_EQ(N_THREADS*N_REQS_PER_THREAD, inst.state.msg_counter);
+	ASSERT_EQ(N_THREADS*N_REQS_PER_THREAD, inst.state.comm_event_counter);
+#if MBCFG_EVENT_LOG
+	ASSERT_EQ(MB_COMM_EVENT_LOG_LEN, inst.state.event_log_count);
+	ASSERT_EQ((N_THREADS*N_REQS_PER_THREAD*2) & MB_COMM_EVENT_LOG_MASK, inst.state.event_log_write_pos);
+#endif
 }
+#endif
 
+#if MBCFG_ATOMIC_STATE && !defined(__STDC_NO_THREADS__)
+TEST_MAIN(
+	mbinst_init_clears_is_listen_only,
+	mbinst_init_clears_status,
+	mbinst_init_clears_comm_event_counter,
+	mbinst_init_clears_event_log_state,
+	mbinst_init_clears_bus_counters,
+	mbinst_init_sets_ascii_delimiter_to_newline,
+	mb_add_comm_event_stores_event_at_pos_zero,
+	mb_add_comm_event_increments_count,
+	mb_add_comm_event_advances_write_pos,
+	mb_add_comm_event_wraps_write_pos_at_log_len,
+	mb_add_comm_event_count_caps_at_log_len,
+	mb_add_comm_event_overwrites_oldest_when_full,
+	mbinst_set_event_log_null_logs_nothing,
+	mbinst_init_worker_shares_config,
+	mbinst_sum_counters_sums_workers,
+	mbinst_sum_counters_no_insts_clears,
+	mbinst_prepare_builds_index_and_kernels,
+	mbinst_prepare_reports_invalid_descriptor,
+	mbinst_prepare_builds_paged_indices,
+	mbinst_prepare_const_time_requires_index,
+	mbinst_atomic_state_counts_requests_of_all_threads
+);
+#else
 TEST_MAIN(
 	mbinst_init_clears_is_listen_only,
 	mbinst_init_clears_status,
@@ -146,5 +485,14 @@ TEST_MAIN(
 	mb_add_comm_event_advances_write_pos,
 	mb_add_comm_event_wraps_write_pos_at_log_len,
 	mb_add_comm_event_count_caps_at_log_len,
-	mb_add_comm_event_overwrites_oldest_when_full
+	mb_add_comm_event_overwrites_oldest_when_full,
+	mbinst_set_event_log_null_logs_nothing,
+	mbinst_init_worker_shares_config,
+	mbinst_sum_counters_sums_workers,
+	mbinst_sum_counters_no_insts_clears,
+	mbinst_prepare_builds_index_and_kernels,
+	mbinst_prepare_reports_invalid_descriptor,
+	mbinst_prepare_builds_paged_indices,
+	mbinst_prepare_const_time_requires_index
 );
+#endif
@@ -0,0 +1,64 @@
+#include "test_lib.h"
+#include <mbmap.hpp>
+
+static volatile uint16_t s_setpoint = 0x1234u;
+static volatile float s_gain;
+static volatile uint16_t s_table[4];
+static uint32_t read_uptime(void) { return 0x00010002u; }
+
+static constexpr auto s_regs = mbmap::regs(
+	mbmap::rw(0x0000, &s_setpoint),
+	mbmap::rw(0x0001, &s_gain),
+	mbmap::fn(0x0003, read_uptime),
+	mbmap::block_rw(0x0100, s_table)
+);
+static_assert(mbmap::is_valid(s_regs), "Valid table rejected");
+static_assert(mbmap::index_span(s_regs) == 0x104u, "Span ends after the block");
+
+static constexpr auto s_slots = mbmap::index_slots<mbmap::index_span(s_regs)>(s_regs);
+static constexpr mbreg_index_s s_ix = mbmap::index(s_regs, s_slots);
+
+/* Tables the checks must reject */
+static constexpr auto s_unordered = mbmap::regs(
+	mbmap::val<uint16_t>(0x0001, 0u),
+	mbmap::val<uint16_t>(0x0000, 0u)
+);
+static_assert(!mbmap::is_ascending(s_unordered) && !mbmap::is_valid(s_unordered), "Unordered table accepted");
+
+static constexpr auto s_overlapping = mbmap::regs(
+	mbmap::val<uint32_t>(0x0000, 0u),
+	mbmap::val<uint16_t>(0x0001, 0u)
+);
+static_assert(mbmap::is_ascending(s_overlapping), "Ascending table rejected");
+static_assert(!mbmap::is_non_overlapping(s_overlapping) && !mbmap::is_valid(s_overlapping), "Overlap accepted");
+
+static constexpr auto s_bad_access = mbmap::regs(
+	mbmap::detail::desc(0x0000, MRTYPE_U16 | MRTYPE_BLOCK, MRACC_R_VAL, mbmap::detail::read_u{}, mbmap::detail::write_u{}, 2u)
+);
+static_assert(!mbmap::is_valid_access(s_bad_access) && !mbmap::is_valid(s_bad_access), "Block by value accepted");
+
+TEST(mbmap_table_fields_follow_types)
+{
+	ASSERT(s_regs[0].type == MRTYPE_U16);
+	ASSERT(s_regs[0].access == MRACC_RW_PTR);
+	ASSERT(s_regs[0].read.pu16 == &s_setpoint);
+	ASSERT(s_regs[1].type == MRTYPE_F32);
+	ASSERT(s_regs[2].type == MRTYPE_U32);
+	ASSERT(s_regs[2].read.fu32 == read_uptime);
+	ASSERT(s_regs[3].type == (MRTYPE_U16 | MRTYPE_BLOCK));
+	ASSERT(s_regs[3].n_block_entries == 4u);
+}
+
+TEST(mbmap_index_finds_descriptors)
+{
+	ASSERT(mbreg_index_find(&s_ix, s_regs.data(), s_regs.size(), 0x0002u) == &s_regs[1]);
+	ASSERT(mbreg_index_find(&s_ix, s_regs.data(), s_regs.size(), 0x0004u) == &s_regs[2]);
+	ASSERT(mbreg_index_find(&s_ix, s_regs.data(), s_regs.size(), 0x0103u) == &s_regs[3]);
+	ASSERT(mbreg_index_find(&s_ix, s_regs.data(), s_regs.size(), 0x0005u) == nullptr);
+	ASSERT(mbreg_index_find(&s_ix, s_regs.data(), s_regs.size(), 0x0104u) == nullptr);
+}
+
+TEST_MAIN(
+	mbmap_table_fields_follow_types,
+	mbmap_index_finds_descriptors
+);
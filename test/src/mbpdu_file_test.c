@@ -2,6 +2,8 @@
 #include <endian.h>
 #include <mbinst.h>
 #include <mbpdu.h>
+#include <mbstats.h>
+#include <string.h>
 
 TEST(mbpdu_file_read_works)
 {
@@ -581,6 +583,194 @@ TEST(mbpdu_file_write_insufficient_data)
 	ASSERT_EQ(MB_ILLEGAL_DATA_VAL, res[1]);
 }
 
+TEST(mbpdu_file_read_words_works)
+{
+	uint16_t history[10000];
+	size_t i;
+	for (i=0u; i<(sizeof history / sizeof history[0]); ++i) {
+		history[i] = (uint16_t)i;
+	}
+	const struct mbfile_desc_s files[] = {
+		{
+			.file_no=0x01u,
+			.words=history,
+			.n_words=sizeof history / sizeof history[0],
+		}
+	};
+	struct mbstats_s stats;
+	mbstats_init(&stats, NULL);
+	struct mbinst_s inst = {
+		.files=files,
+		.n_files=sizeof files / sizeof files[0],
+		.stats=&stats,
+	};
+	mbinst_init(&inst);
+
+	uint8_t pdu_data[] = {
+		MBFC_READ_FILE_RECORD,
+		0x0E, /* Byte count */
+		0x06, /* Sub-req 1, Ref type */
+		0x00, 0x01, /* Sub-req 1, File number */
+		0x27, 0x0E, /* Sub-req 1, Record number 9998 */
+		0x00, 0x02, /* Sub-req 1, Record length */
+		0x06, /* Sub-req 2, Ref type */
+		0x00, 0x01, /* Sub-req 2, File number */
+		0x01, 0x02, /* Sub-req 2, Record number 258 */
+		0x00, 0x01, /* Sub-req 2, Record length */
+	};
+
+	uint8_t res[MBPDU_SIZE_MAX];
+	size_t res_size = mbpdu_handle_req(&inst, pdu_data, sizeof pdu_data, res);
+
+	ASSERT_EQ(MBFC_READ_FILE_RECORD, res[0]);
+	ASSERT_EQ(12u, res_size);
+	ASSERT_EQ(10u, res[1]); /* Byte count */
+
+	ASSERT_EQ(5u, res[2]); /* Sub-req 1, File resp. length */
+	ASSERT_EQ(0x06u, res[3]);
+	ASSERT_EQ(0x27u, res[4]);
+	ASSERT_EQ(0x0Eu, res[5]);
+	ASSERT_EQ(0x27u, res[6]);
+	ASSERT_EQ(0x0Fu, res[7]);
+
+	ASSERT_EQ(3u, res[8]); /* Sub-req 2, File resp. length */
+	ASSERT_EQ(0x06u, res[9]);
+	ASSERT_EQ(0x01u, res[10]);
+	ASSERT_EQ(0x02u, res[11]);
+
+	/* The file is looked up once for both sub-requests */
+	ASSERT_EQ(1u, stats.lookup_count[MBSTATS_MAP_FILES]);
+}
+
+static int s_n_file_fn_calls = 0;
+static uint32_t file_fn_u32(void) {++s_n_file_fn_calls; return 0x11223344u;}
+
+TEST(mbpdu_file_read_calls_fn_once_per_request)
+{
+	const struct mbreg_desc_s records[] = {
+		{.address=0x00u, .type=MRTYPE_U32, .access=MRACC_R_FN, .read={.fu32=file_fn_u32}},
+	};
+	const struct mbfile_desc_s files[] = {
+		{.file_no=0x01u, .records=records, .n_records=1u},
+	};
+	struct mbinst_s inst = {.files=files, .n_files=1u};
+	const uint8_t req[] = {
+		MBFC_READ_FILE_RECORD,
+		0x0E, /* Byte count */
+		0x06, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, /* Whole value */
+		0x06, 0x00, 0x01, 0x00, 0x01, 0x00, 0x01, /* Low word only */
+	};
+	uint8_t res[MBPDU_SIZE_MAX];
+	mbinst_init(&inst);
+	s_n_file_fn_calls = 0;
+
+	ASSERT_EQ(12u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(0x11u, res[4]);
+	ASSERT_EQ(0x44u, res[7]);
+	ASSERT_EQ(0x33u, res[10]);
+	ASSERT_EQ(0x44u, res[11]);
+	ASSERT_EQ(1, s_n_file_fn_calls);
+}
+
+static void put_sub_req(uint8_t *p, uint16_t file_no, uint16_t record_no, uint16_t record_length)
+{
+	p[0] = 0x06u; /* Ref type */
+	u16tobe(file_no, p+1u);
+	u16tobe(record_no, p+3u);
+	u16tobe(record_length, p+5u);
+}
+
+static uint8_t s_flash[64];
+static size_t s_n_flash_reads;
+static enum mbstatus_e flash_read_cb(uint16_t record_no, size_t n, uint8_t *dst)
+{
+	++s_n_flash_reads;
+	(void)memcpy(dst, s_flash + (2u*(size_t)record_no), 2u*n);
+	return MB_OK;
+}
+
+TEST(mbpdu_file_read_adjacent_sub_reqs_as_one_span)
+{
+	uint16_t words[8];
+	size_t i;
+	for (i=0u; i<sizeof s_flash; ++i) s_flash[i] = (uint8_t)i;
+	for (i=0u; i<8u; ++i) words[i] = (uint16_t)(0x100u + i);
+	const struct mbfile_region_s region = {.size=sizeof s_flash, .is_be=0, .read_cb=flash_read_cb};
+	const struct mbfile_desc_s files[] = {
+		{.file_no=0x01u, .region=&region},
+		{.file_no=0x02u, .words=words, .n_words=8u},
+	};
+	struct mbinst_s inst = {.files=files, .n_files=2u};
+	uint8_t req[2u + (6u*7u)];
+	uint8_t res[MBPDU_SIZE_MAX];
+	size_t res_size;
+	mbinst_init(&inst);
+	s_n_flash_reads = 0u;
+
+	req[0] = MBFC_READ_FILE_RECORD;
+	req[1] = 6u*7u;
+	put_sub_req(req+2u, 0x01u, 4u, 3u); /* Run of three */
+	put_sub_req(req+9u, 0x01u, 7u, 1u);
+	put_sub_req(req+16u, 0x01u, 8u, 2u);
+	put_sub_req(req+23u, 0x02u, 6u, 1u); /* Other file, read per sub-request */
+	put_sub_req(req+30u, 0x02u, 7u, 3u);
+	put_sub_req(req+37u, 0x02u, 0u, 1u); /* Not adjacent */
+
+	res_size = mbpdu_handle_req(&inst, req, sizeof req, res);
+	ASSERT_EQ(2u + (6u*2u) + (11u*2u), res_size);
+	ASSERT_EQ(res_size - 2u, res[1]);
+	ASSERT_EQ(1u, s_n_flash_reads);
+
+	ASSERT_EQ(7u, res[2]); /* File resp. length */
+	ASSERT_EQ(0x06u, res[3]);
+	ASSERT_EQ(0x09u, res[4]); /* Record 4, little endian in the region */
+	ASSERT_EQ(0x08u, res[5]);
+	ASSERT_EQ(0x0Du, res[8]); /* Record 6 */
+	ASSERT_EQ(0x0Cu, res[9]);
+	ASSERT_EQ(3u, res[10]);
+	ASSERT_EQ(0x06u, res[11]);
+	ASSERT_EQ(0x0Fu, res[12]); /* Record 7 */
+	ASSERT_EQ(0x0Eu, res[13]);
+	ASSERT_EQ(5u, res[14]);
+	ASSERT_EQ(0x06u, res[15]);
+	ASSERT_EQ(0x11u, res[16]); /* Record 8, read with the run */
+	ASSERT_EQ(0x13u, res[18]); /* Record 9 */
+
+	ASSERT_EQ(3u, res[20]);
+	ASSERT_EQ(0x01u, res[22]); /* Word 6 */
+	ASSERT_EQ(0x06u, res[23]);
+	ASSERT_EQ(7u, res[24]);
+	ASSERT_EQ(0x06u, res[25]);
+	ASSERT_EQ(0x01u, res[26]); /* Word 7 */
+	ASSERT_EQ(0x07u, res[27]);
+	ASSERT_EQ(0x00u, res[28]); /* Past the end of the file */
+	ASSERT_EQ(0x00u, res[31]);
+	ASSERT_EQ(3u, res[32]);
+	ASSERT_EQ(0x01u, res[34]); /* Word 0 */
+	ASSERT_EQ(0x00u, res[35]);
+}
+
+TEST(mbpdu_file_read_adjacent_sub_req_past_end_fails)
+{
+	const struct mbfile_region_s region = {.size=8u, .is_be=1, .read_cb=flash_read_cb};
+	const struct mbfile_desc_s files[] = {
+		{.file_no=0x01u, .region=&region},
+	};
+	struct mbinst_s inst = {.files=files, .n_files=1u};
+	uint8_t req[2u + (2u*7u)];
+	uint8_t res[MBPDU_SIZE_MAX];
+	mbinst_init(&inst);
+
+	req[0] = MBFC_READ_FILE_RECORD;
+	req[1] = 2u*7u;
+	put_sub_req(req+2u, 0x01u, 2u, 2u);
+	put_sub_req(req+9u, 0x01u, 4u, 1u); /* Starts past the end, as when read alone */
+
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(MBFC_READ_FILE_RECORD | MB_ERR_FLG, res[0]);
+	ASSERT_EQ(MB_ILLEGAL_DATA_ADDR, res[1]);
+}
+
 TEST_MAIN(
 	mbpdu_file_read_works,
 	mbpdu_file_write_works,
@@ -593,5 +783,9 @@ TEST_MAIN(
 	mbpdu_file_read_response_too_large,
 	mbpdu_file_write_too_short_request,
 	mbpdu_file_write_invalid_byte_count,
-	mbpdu_file_write_insufficient_data
+	mbpdu_file_write_insufficient_data,
+	mbpdu_file_read_words_works,
+	mbpdu_file_read_calls_fn_once_per_request,
+	mbpdu_file_read_adjacent_sub_reqs_as_one_span,
+	mbpdu_file_read_adjacent_sub_req_past_end_fails
 );
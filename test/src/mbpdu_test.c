@@ -1,7 +1,38 @@
 #include "test_lib.h"
+#include "test_policy.h"
 #include <endian.h>
 #include <mbinst.h>
 #include <mbpdu.h>
+#include <mbstats.h>
+
+/* Entries of mbreg_policies with MBCFG_COMPACT_REGS */
+enum {
+	POLICY_TEST_RLOCK=1u,
+	POLICY_TEST_WLOCK,
+	POLICY_POST_WRITE,
+	POLICY_COUNT_WLOCK,
+	POLICY_SHARED_LOCK,
+	POLICY_LOCKED_OVERRIDE,
+};
+
+#if MBCFG_COMPACT_REGS
+static int test_lock_callback(void);
+static void test_post_write_callback(void);
+static int count_wlock_callback(void);
+static int shared_lock_cb(void);
+static int locked_cb(void);
+static int count_override_cb(const struct mbreg_desc_s *reg, uint16_t start_addr, size_t n, const uint8_t *val);
+
+const struct mbreg_policy_s mbreg_policies[] = {
+	{0},
+	[POLICY_TEST_RLOCK] = {.rlock_cb=test_lock_callback},
+	[POLICY_TEST_WLOCK] = {.wlock_cb=test_lock_callback},
+	[POLICY_POST_WRITE] = {.post_write_cb=test_post_write_callback},
+	[POLICY_COUNT_WLOCK] = {.wlock_cb=count_wlock_callback},
+	[POLICY_SHARED_LOCK] = {.rlock_cb=shared_lock_cb, .wlock_cb=shared_lock_cb},
+	[POLICY_LOCKED_OVERRIDE] = {.rlock_cb=shared_lock_cb, .wlock_cb=locked_cb, .wlock_override_cb=count_override_cb},
+};
+#endif
 
 TEST(mbpdu_read_holding_reg_works)
 {
@@ -941,7 +972,7 @@ TEST(mbpdu_read_locked_reg_access_denied)
 			.type=MRTYPE_U16,
 			.access=MRACC_R_VAL,
 			.read={.u16=0x1234u},
-			.rlock_cb=test_lock_callback,
+			REG_CBS(POLICY_TEST_RLOCK, .rlock_cb=test_lock_callback),
 		}
 	};
 	struct mbinst_s inst = {
@@ -975,7 +1006,7 @@ TEST(mbpdu_write_locked_reg_access_denied)
 			.access=MRACC_RW_PTR,
 			.read={.pu16=&reg_val},
 			.write={.pu16=&reg_val},
-			.wlock_cb=test_lock_callback,
+			REG_CBS(POLICY_TEST_WLOCK, .wlock_cb=test_lock_callback),
 		}
 	};
 	struct mbinst_s inst = {
@@ -1015,7 +1046,7 @@ TEST(mbpdu_post_write_callback_executed)
 			.access=MRACC_RW_PTR,
 			.read={.pu16=&reg_val},
 			.write={.pu16=&reg_val},
-			.post_write_cb=test_post_write_callback,
+			REG_CBS(POLICY_POST_WRITE, .post_write_cb=test_post_write_callback),
 		}
 	};
 	struct mbinst_s inst = {
@@ -3200,6 +3231,419 @@ TEST(mbpdu_write_out_of_bounds_fails)
 	ASSERT_EQ(MB_ILLEGAL_DATA_VAL, res[1]);
 }
 
+TEST(mbpdu_indexed_regs_work)
+{
+	uint16_t blk[3] = {0x1111, 0x2222, 0x3333};
+	uint32_t u32 = 0x44445555;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0100, .type=MRTYPE_U16|MRTYPE_BLOCK, .access=MRACC_RW_PTR, .read={.pu16=blk}, .write={.pu16=blk}, .n_block_entries=3},
+		{.address=0x0104, .type=MRTYPE_U32, .access=MRACC_RW_PTR, .read={.pu32=&u32}, .write={.pu32=&u32}},
+	};
+	uint16_t storage[8];
+	struct mbreg_index_s ix;
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=sizeof regs / sizeof regs[0],
+		.hold_regs_ix=&ix,
+	};
+	mbinst_init(&inst);
+	ASSERT_EQ(1, mbreg_index_build(&ix, regs, inst.n_hold_regs, storage, sizeof storage / sizeof storage[0]));
+
+	const uint8_t read_req[] = {MBFC_READ_HOLDING_REGS, 0x01, 0x00, 0x00, 0x06};
+	uint8_t res[MBPDU_SIZE_MAX];
+	size_t res_size = mbpdu_handle_req(&inst, read_req, sizeof read_req, res);
+
+	ASSERT_EQ(14u, res_size);
+	ASSERT_EQ(12u, res[1]);
+	ASSERT_EQ(0x33u, res[6]);
+	ASSERT_EQ(0x00u, res[8]); /* Gap at 0x0103 */
+	ASSERT_EQ(0x00u, res[9]);
+	ASSERT_EQ(0x44u, res[10]);
+	ASSERT_EQ(0x55u, res[13]);
+
+	const uint8_t write_req[] = {MBFC_WRITE_MULTIPLE_REGS, 0x01, 0x04, 0x00, 0x02, 0x04, 0x12, 0x34, 0x56, 0x78};
+	res_size = mbpdu_handle_req(&inst, write_req, sizeof write_req, res);
+	ASSERT_EQ(5u, res_size);
+	ASSERT_EQ(0x12345678u, u32);
+
+	const uint8_t bad_req[] = {MBFC_READ_HOLDING_REGS, 0x01, 0x03, 0x00, 0x01};
+	res_size = mbpdu_handle_req(&inst, bad_req, sizeof bad_req, res);
+	ASSERT_EQ(2u, res_size);
+	ASSERT_EQ(MB_ILLEGAL_DATA_ADDR, res[1]);
+}
+
+static enum mbstatus_e vendor_fn(
+	struct mbinst_s *inst,
+	const uint8_t *req,
+	size_t req_len,
+	struct mbpdu_buf_s *res)
+{
+	(void)inst;
+	(void)req_len;
+	res->p[1] = req[1];
+	res->size = 2u;
+	return MB_OK;
+}
+
+TEST(mbpdu_fn_table_overrides_builtin)
+{
+	uint16_t reg_val = 0x1234u;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_R_PTR, .read={.pu16=&reg_val}},
+	};
+	struct mbpdu_fn_table_s table;
+	mbpdu_fn_table_init(&table);
+	table.fn[MBFC_READ_HOLDING_REGS] = vendor_fn;
+	table.fn[0x41] = vendor_fn;
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=sizeof regs / sizeof regs[0],
+		.input_regs=regs,
+		.n_input_regs=sizeof regs / sizeof regs[0],
+		.fn_table=&table,
+		.handle_fn_cb=custom_function_handler,
+	};
+	mbinst_init(&inst);
+
+	uint8_t res[MBPDU_SIZE_MAX];
+	const uint8_t read_hold[] = {MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x01};
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, read_hold, sizeof read_hold, res));
+	ASSERT_EQ(MBFC_READ_HOLDING_REGS, res[0]);
+	ASSERT_EQ(0x00, res[1]);
+
+	/* Built-in handlers are kept for other function codes */
+	const uint8_t read_input[] = {MBFC_READ_INPUT_REGS, 0x00, 0x00, 0x00, 0x01};
+	ASSERT_EQ(4u, mbpdu_handle_req(&inst, read_input, sizeof read_input, res));
+	ASSERT_EQ(0x12, res[2]);
+	ASSERT_EQ(0x34, res[3]);
+
+	/* Vendor function code is handled without the fallback */
+	s_custom_handler_called = 0;
+	const uint8_t vendor[] = {0x41, 0x99};
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, vendor, sizeof vendor, res));
+	ASSERT_EQ(0x99, res[1]);
+	ASSERT_EQ(0, s_custom_handler_called);
+}
+
+TEST(mbpdu_fn_table_empty_entry_uses_fallback)
+{
+	struct mbpdu_fn_table_s table;
+	mbpdu_fn_table_init(&table);
+	table.fn[MBFC_READ_COILS] = NULL;
+	static uint8_t coil_val = 1u;
+	const struct mbcoil_desc_s coils[] = {
+		{.address=0x00u, .access=MCACC_R_PTR, .read={.ptr=&coil_val, .ix=0u}},
+	};
+	struct mbinst_s inst = {
+		.coils=coils,
+		.n_coils=sizeof coils / sizeof coils[0],
+		.fn_table=&table,
+		.handle_fn_cb=custom_function_handler,
+	};
+	mbinst_init(&inst);
+
+	s_custom_handler_called = 0;
+	uint8_t res[MBPDU_SIZE_MAX];
+	const uint8_t req[] = {MBFC_READ_COILS, 0x00, 0x00, 0x00, 0x01};
+	(void)mbpdu_handle_req(&inst, req, sizeof req, res);
+	ASSERT_EQ(1, s_custom_handler_called);
+	ASSERT_EQ(MBFC_READ_COILS, s_last_custom_fc);
+}
+
+static int s_n_wlock_calls = 0;
+static int count_wlock_callback(void)
+{
+	++s_n_wlock_calls;
+	return 0;
+}
+
+TEST(mbpdu_write_max_quantity_mixed_regs_works)
+{
+	uint16_t reg_0 = 0u;
+	uint32_t reg_1 = 0u;
+	uint16_t block[120] = {0};
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&reg_0}, .write={.pu16=&reg_0}, REG_CBS(POLICY_COUNT_WLOCK, .wlock_cb=count_wlock_callback)},
+		{.address=0x01u, .type=MRTYPE_U32, .access=MRACC_RW_PTR, .read={.pu32=&reg_1}, .write={.pu32=&reg_1}, REG_CBS(POLICY_COUNT_WLOCK, .wlock_cb=count_wlock_callback)},
+		{.address=0x03u, .type=MRTYPE_U16|MRTYPE_BLOCK, .n_block_entries=120u, .access=MRACC_RW_PTR, .read={.pu16=block}, .write={.pu16=block}},
+	};
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=sizeof regs / sizeof regs[0]
+	};
+	uint8_t req[6u + 123u*2u] = {MBFC_WRITE_MULTIPLE_REGS, 0x00, 0x00, 0x00, 123u, 246u};
+	uint8_t res[MBPDU_SIZE_MAX];
+	size_t i;
+	mbinst_init(&inst);
+
+	for (i=0u; i<123u; ++i) {
+		u16tobe((uint16_t)(0x100u+i), req+6u+(i*2u));
+	}
+	s_n_wlock_calls = 0;
+
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(MBFC_WRITE_MULTIPLE_REGS, res[0]);
+	ASSERT_EQ(123u, betou16(res+3));
+	ASSERT_EQ(0x100u, reg_0);
+	ASSERT_EQ(0x01010102u, reg_1);
+	ASSERT_EQ(0x103u, block[0]);
+	ASSERT_EQ(0x17Au, block[119]);
+	ASSERT_EQ(1, s_n_wlock_calls); /* Only checked while validating, once for the shared callback */
+}
+
+static int s_n_shared_lock_calls = 0;
+static int shared_lock_cb(void)
+{
+	++s_n_shared_lock_calls;
+	return 0;
+}
+
+static int s_n_override_calls = 0;
+static int locked_cb(void)
+{
+	++s_n_shared_lock_calls;
+	return 1;
+}
+static int count_override_cb(const struct mbreg_desc_s *reg, uint16_t start_addr, size_t n, const uint8_t *val)
+{
+	(void)reg; (void)start_addr; (void)n; (void)val;
+	++s_n_override_calls;
+	return 1;
+}
+
+TEST(mbpdu_lock_callbacks_called_once_per_request)
+{
+	static uint16_t vals[8];
+	struct mbreg_desc_s regs[8];
+	uint8_t res[MBPDU_SIZE_MAX];
+	const uint8_t req_rd[] = {MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x08};
+	uint8_t req_wr[6u + 16u] = {MBFC_WRITE_MULTIPLE_REGS, 0x00, 0x00, 0x00, 0x08, 0x10};
+	struct mbinst_s inst = {.hold_regs=regs, .n_hold_regs=8u};
+	size_t i;
+
+	for (i=0u; i<8u; ++i) {
+		regs[i] = (struct mbreg_desc_s){
+			.address=(uint16_t)i,
+			.type=MRTYPE_U16,
+			.access=MRACC_RW_PTR,
+			.read={.pu16=&vals[i]},
+			.write={.pu16=&vals[i]},
+			REG_CBS(POLICY_SHARED_LOCK, .rlock_cb=shared_lock_cb, .wlock_cb=shared_lock_cb),
+		};
+	}
+	mbinst_init(&inst);
+
+	s_n_shared_lock_calls = 0;
+	ASSERT_EQ(18u, mbpdu_handle_req(&inst, req_rd, sizeof req_rd, res));
+	ASSERT_EQ(1, s_n_shared_lock_calls);
+
+	s_n_shared_lock_calls = 0;
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, req_wr, sizeof req_wr, res));
+	ASSERT_EQ(1, s_n_shared_lock_calls);
+
+	/* The override is still asked for every locked register */
+	for (i=0u; i<8u; ++i) {
+#if MBCFG_COMPACT_REGS
+		regs[i].policy = POLICY_LOCKED_OVERRIDE;
+#else
+		regs[i].wlock_cb = locked_cb;
+		regs[i].wlock_override_cb = count_override_cb;
+#endif
+	}
+	s_n_shared_lock_calls = 0;
+	s_n_override_calls = 0;
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, req_wr, sizeof req_wr, res));
+	ASSERT_EQ(1, s_n_shared_lock_calls);
+	ASSERT_EQ(8, s_n_override_calls);
+}
+
+TEST(mbpdu_read_write_regs_adjacent_ranges_one_lookup)
+{
+	uint16_t vals[4] = {0x0000, 0x1111, 0x2222, 0x3333};
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0010, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&vals[0]}, .write={.pu16=&vals[0]}},
+		{.address=0x0011, .type=MRTYPE_U16 | MRTYPE_BLOCK, .n_block_entries=3u, .access=MRACC_RW_PTR, .read={.pu16=&vals[1]}, .write={.pu16=&vals[1]}},
+	};
+	struct mbstats_s stats;
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=sizeof regs / sizeof regs[0],
+		.stats=&stats,
+	};
+	mbinst_init(&inst);
+	mbstats_init(&stats, NULL);
+
+	/* Write the command register, read it back with the status registers */
+	uint8_t pdu_data[] = {
+		MBFC_READ_WRITE_REGS,
+		0x00, 0x10, /* Read start addr */
+		0x00, 0x04, /* Read quantity */
+		0x00, 0x10, /* Write start addr */
+		0x00, 0x01, /* Write quantity */
+		0x02, /* Write byte count */
+		0xAB, 0xCD,
+	};
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	ASSERT_EQ(10u, mbpdu_handle_req(&inst, pdu_data, sizeof pdu_data, res));
+	ASSERT_EQ(0xABCDu, betou16(res+2u));
+	ASSERT_EQ(0x3333u, betou16(res+8u));
+	ASSERT_EQ(1u, stats.lookup_count[MBSTATS_MAP_HOLD_REGS]);
+
+	/* Write after the read range, adjacent */
+	u16tobe(0x0010u, pdu_data+1u);
+	u16tobe(0x0002u, pdu_data+3u);
+	u16tobe(0x0012u, pdu_data+5u);
+	ASSERT_EQ(6u, mbpdu_handle_req(&inst, pdu_data, sizeof pdu_data, res));
+	ASSERT_EQ(0xABCDu, vals[2]);
+	ASSERT_EQ(0x1111u, betou16(res+4u));
+	ASSERT_EQ(2u, stats.lookup_count[MBSTATS_MAP_HOLD_REGS]);
+
+	/* Read after the write range, one register apart */
+	u16tobe(0x0013u, pdu_data+1u);
+	u16tobe(0x0001u, pdu_data+3u);
+	u16tobe(0x0011u, pdu_data+5u);
+	ASSERT_EQ(4u, mbpdu_handle_req(&inst, pdu_data, sizeof pdu_data, res));
+	ASSERT_EQ(0xABCDu, vals[1]);
+	ASSERT_EQ(0x3333u, betou16(res+2u));
+	ASSERT_EQ(5u, stats.lookup_count[MBSTATS_MAP_HOLD_REGS]); /* Searched by dry run, write and read */
+}
+
+static int s_rw_scope_depth;
+static int s_rw_scope_calls;
+static int s_rw_write_in_scope;
+static void rw_scope_cb(const struct mbinst_s *inst, int begin)
+{
+	(void)inst;
+	s_rw_scope_depth += begin ? 1 : -1;
+	++s_rw_scope_calls;
+}
+static enum mbstatus_e rw_scope_write_cb(uint16_t value)
+{
+	(void)value;
+	s_rw_write_in_scope = s_rw_scope_depth;
+	return MB_OK;
+}
+
+TEST(mbpdu_read_write_regs_scope_callback)
+{
+	uint16_t status = 0x0042;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0001, .type=MRTYPE_U16, .access=MRACC_W_FN, .write={.fu16=rw_scope_write_cb}},
+		{.address=0x0002, .type=MRTYPE_U16, .access=MRACC_R_PTR, .read={.pu16=&status}},
+	};
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=sizeof regs / sizeof regs[0],
+		.read_write_scope_cb=rw_scope_cb,
+	};
+	mbinst_init(&inst);
+	s_rw_scope_depth = 0;
+	s_rw_scope_calls = 0;
+	s_rw_write_in_scope = 0;
+
+	uint8_t pdu_data[] = {
+		MBFC_READ_WRITE_REGS,
+		0x00, 0x02, /* Read start addr */
+		0x00, 0x01, /* Read quantity */
+		0x00, 0x01, /* Write start addr */
+		0x00, 0x01, /* Write quantity */
+		0x02, /* Write byte count */
+		0x00, 0x07,
+	};
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	ASSERT_EQ(4u, mbpdu_handle_req(&inst, pdu_data, sizeof pdu_data, res));
+	ASSERT_EQ(0x0042u, betou16(res+2u));
+	ASSERT_EQ(1, s_rw_write_in_scope);
+	ASSERT_EQ(2, s_rw_scope_calls);
+	ASSERT_EQ(0, s_rw_scope_depth);
+
+	/* Left on failure as well */
+	u16tobe(0x0003u, pdu_data+1u); /* Missing */
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, pdu_data, sizeof pdu_data, res));
+	ASSERT_EQ(MB_ILLEGAL_DATA_ADDR, res[1]);
+	ASSERT_EQ(4, s_rw_scope_calls);
+	ASSERT_EQ(0, s_rw_scope_depth);
+}
+
+TEST(mbpdu_work_budget_refuses_large_requests)
+{
+	uint16_t vals[4] = {1u, 2u, 3u, 4u};
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x00u, .type=MRTYPE_U16 | MRTYPE_BLOCK, .n_block_entries=4u, .access=MRACC_RW_PTR, .read={.pu16=vals}, .write={.pu16=vals}},
+	};
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=sizeof regs / sizeof regs[0],
+		.work_budget=2u,
+	};
+	const uint8_t read2[] = {MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x02};
+	const uint8_t write3[] = {MBFC_WRITE_MULTIPLE_REGS, 0x00, 0x00, 0x00, 0x03, 0x06, 0x00, 0x09, 0x00, 0x09, 0x00, 0x09};
+	const uint8_t rw[] = {MBFC_READ_WRITE_REGS, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x02, 0x04, 0x00, 0x09, 0x00, 0x09};
+	const uint8_t excess[] = {MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x7E};
+	const uint8_t rw_excess[] = {MBFC_READ_WRITE_REGS, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x7A, 0x02, 0x00, 0x09};
+	uint8_t res[MBPDU_SIZE_MAX];
+	mbinst_init(&inst);
+
+	ASSERT_EQ(2u, mbpdu_req_work(read2, sizeof read2));
+	ASSERT_EQ(3u, mbpdu_req_work(write3, sizeof write3));
+	ASSERT_EQ(3u, mbpdu_req_work(rw, sizeof rw));
+	ASSERT_EQ(0u, mbpdu_req_work(excess, sizeof excess));
+	ASSERT_EQ(0u, mbpdu_req_work(rw_excess, sizeof rw_excess));
+
+	ASSERT_EQ(6u, mbpdu_handle_req(&inst, read2, sizeof read2, res));
+	ASSERT_EQ(MBFC_READ_HOLDING_REGS, res[0]);
+
+	/* Refused whole, nothing written */
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, write3, sizeof write3, res));
+	ASSERT_EQ(MBFC_WRITE_MULTIPLE_REGS | MB_ERR_FLG, res[0]);
+	ASSERT_EQ(MB_BUSY, res[1]);
+	ASSERT_EQ(1u, vals[0]);
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, rw, sizeof rw, res));
+	ASSERT_EQ(MB_BUSY, res[1]);
+	ASSERT_EQ(2u, vals[1]);
+	ASSERT_EQ(2u, inst.state.busy_counter);
+
+	/* Quantities above the limit are malformed, not busy */
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, excess, sizeof excess, res));
+	ASSERT_EQ(MBFC_READ_HOLDING_REGS | MB_ERR_FLG, res[0]);
+	ASSERT_EQ(MB_ILLEGAL_DATA_VAL, res[1]);
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, rw_excess, sizeof rw_excess, res));
+	ASSERT_EQ(MB_ILLEGAL_DATA_VAL, res[1]);
+	ASSERT_EQ(2u, inst.state.busy_counter);
+
+	inst.work_budget = 0u;
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, write3, sizeof write3, res));
+	ASSERT_EQ(9u, vals[2]);
+}
+
+TEST(mbpdu_work_max_bounds_function_codes)
+{
+	const uint8_t fc14[] = {
+		MBFC_READ_FILE_RECORD, 0x0E,
+		0x06, 0x00, 0x01, 0x00, 0x00, 0x00, 0x03,
+		0x06, 0x00, 0x02, 0x00, 0x00, 0x00, 0x05,
+	};
+	uint8_t fc14_long[] = {MBFC_READ_FILE_RECORD, 0x07, 0x06, 0x00, 0x01, 0x00, 0x00, 0x00, 0x79};
+	const uint8_t coils[] = {MBFC_READ_COILS, 0x00, 0x00, 0x00, 0x10};
+
+	ASSERT_EQ(2000u, mbpdu_work_max(MBFC_READ_COILS));
+	ASSERT_EQ(1968u, mbpdu_work_max(MBFC_WRITE_MULTIPLE_COILS));
+	ASSERT_EQ(125u, mbpdu_work_max(MBFC_READ_INPUT_REGS));
+	ASSERT_EQ(123u, mbpdu_work_max(MBFC_WRITE_MULTIPLE_REGS));
+	ASSERT_EQ(246u, mbpdu_work_max(MBFC_READ_WRITE_REGS));
+	ASSERT_EQ(1u, mbpdu_work_max(MBFC_WRITE_SINGLE_REG));
+	ASSERT_EQ(0u, mbpdu_work_max(MBFC_DIAGNOSTICS));
+
+	ASSERT_EQ(8u, mbpdu_req_work(fc14, sizeof fc14));
+	ASSERT_EQ(16u, mbpdu_req_work(coils, sizeof coils));
+	ASSERT_EQ(0u, mbpdu_req_work(coils, 3u)); /* Too short, the handler rejects it */
+	ASSERT_EQ(121u, mbpdu_req_work(fc14_long, sizeof fc14_long));
+	fc14_long[8] = 0x7Au; /* 122 registers in one record, larger than a response */
+	ASSERT_EQ(0u, mbpdu_req_work(fc14_long, sizeof fc14_long));
+}
+
 TEST_MAIN(
 	mbpdu_read_holding_reg_works,
 	mbpdu_read_input_reg_works,
@@ -3282,5 +3726,14 @@ TEST_MAIN(
 	mbpdu_write_multiple_regs_excess_quantity_fails,
 	mbpdu_read_write_regs_excess_read_quantity_fails,
 	mbpdu_read_write_regs_excess_write_quantity_fails,
-	mbpdu_write_out_of_bounds_fails
+	mbpdu_write_out_of_bounds_fails,
+	mbpdu_indexed_regs_work,
+	mbpdu_fn_table_overrides_builtin,
+	mbpdu_fn_table_empty_entry_uses_fallback,
+	mbpdu_write_max_quantity_mixed_regs_works,
+	mbpdu_lock_callbacks_called_once_per_request,
+	mbpdu_read_write_regs_adjacent_ranges_one_lookup,
+	mbpdu_read_write_regs_scope_callback,
+	mbpdu_work_budget_refuses_large_requests,
+	mbpdu_work_max_bounds_function_codes
 );
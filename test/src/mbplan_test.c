@@ -0,0 +1,203 @@
+#include "test_lib.h"
+#include "test_policy.h"
+#include <endian.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <mbplan.h>
+#include <mbstats.h>
+#include <stdint.h>
+#include <string.h>
+
+static int s_locked;
+static int rlock_cb(void)
+{
+	return s_locked;
+}
+
+static size_t s_n_reads;
+static uint32_t read_cb(void)
+{
+	++s_n_reads;
+	return 0x11112222u;
+}
+
+#if MBCFG_COMPACT_REGS
+const struct mbreg_policy_s mbreg_policies[] = {
+	{0},
+	{.rlock_cb=rlock_cb},
+};
+#endif
+
+static uint16_t s_val[4];
+static uint16_t s_lockable;
+static const struct mbreg_desc_s s_regs[] = {
+	{.address=0x00u, .type=MRTYPE_U16|MRTYPE_BLOCK, .n_block_entries=4u, .access=MRACC_RW_PTR, .read={.pu16=s_val}, .write={.pu16=s_val}},
+	/* 0x04 to 0x07 unmapped */
+	{.address=0x08u, .type=MRTYPE_U32, .access=MRACC_R_FN, .read={.fu32=read_cb}},
+	{.address=0x0Au, .type=MRTYPE_U16, .access=MRACC_R_PTR, .read={.pu16=&s_lockable}, REG_CBS(1u, .rlock_cb=rlock_cb)},
+};
+
+static struct mbplan_entry_s s_entries[2];
+
+static void setup(struct mbinst_s *inst, struct mbplan_s *plan, struct mbstats_s *stats)
+{
+	(void)memset(inst, 0, sizeof *inst);
+	(void)memset(stats, 0, sizeof *stats);
+	inst->hold_regs = s_regs;
+	inst->n_hold_regs = sizeof s_regs / sizeof s_regs[0];
+	inst->plan = plan;
+	inst->stats = stats;
+	mbinst_init(inst);
+	mbplan_init(plan);
+	(void)memset(s_val, 0, sizeof s_val);
+	s_lockable = 0u;
+	s_locked = 0;
+	s_n_reads = 0u;
+}
+
+static size_t read_regs(struct mbinst_s *inst, uint16_t addr, uint16_t n, uint8_t *res)
+{
+	uint8_t req[5] = {MBFC_READ_HOLDING_REGS};
+
+	u16tobe(addr, req+1u);
+	u16tobe(n, req+3u);
+	return mbpdu_handle_req(inst, req, sizeof req, res);
+}
+
+TEST(mbplan_repeated_read_skips_lookup)
+{
+	struct mbplan_s plan = {.entries=s_entries, .n_entries=2u};
+	struct mbstats_s stats;
+	struct mbinst_s inst;
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	setup(&inst, &plan, &stats);
+
+	ASSERT_EQ(22u, read_regs(&inst, 0x00u, 10u, res));
+	ASSERT_EQ(1u, plan.n_misses);
+	ASSERT_EQ(1u, stats.lookup_count[MBSTATS_MAP_HOLD_REGS]);
+
+	/* Data is still read live */
+	s_val[1] = 0xABCDu;
+	ASSERT_EQ(22u, read_regs(&inst, 0x00u, 10u, res));
+	ASSERT_EQ(1u, plan.n_hits);
+	ASSERT_EQ(1u, stats.lookup_count[MBSTATS_MAP_HOLD_REGS]);
+	ASSERT_EQ(2u, s_n_reads);
+	ASSERT_EQ(20u, res[1]);
+	ASSERT_EQ(0xABCDu, betou16(res+4));
+	ASSERT_EQ(0x0000u, betou16(res+10)); /* Hole stays zero */
+	ASSERT_EQ(0x0000u, betou16(res+16));
+	ASSERT_EQ(0x1111u, betou16(res+18));
+	ASSERT_EQ(0x2222u, betou16(res+20));
+}
+
+TEST(mbplan_planned_read_matches_walk)
+{
+	struct mbplan_s plan = {.entries=s_entries, .n_entries=2u};
+	struct mbstats_s stats;
+	struct mbinst_s inst;
+	uint8_t walked[MBPDU_SIZE_MAX], planned[MBPDU_SIZE_MAX];
+	size_t n;
+
+	setup(&inst, &plan, &stats);
+	s_val[0] = 0x0102u;
+	s_val[3] = 0x0304u;
+	s_lockable = 0x0506u;
+
+	n = read_regs(&inst, 0x01u, 10u, walked);
+	ASSERT_EQ(22u, n);
+	ASSERT_EQ(n, read_regs(&inst, 0x01u, 10u, planned));
+	ASSERT_EQ(1u, plan.n_hits);
+	ASSERT(memcmp(walked, planned, n)==0);
+}
+
+TEST(mbplan_locks_still_apply)
+{
+	struct mbplan_s plan = {.entries=s_entries, .n_entries=2u};
+	struct mbstats_s stats;
+	struct mbinst_s inst;
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	setup(&inst, &plan, &stats);
+
+	/* A failed read is not recorded */
+	s_locked = 1;
+	ASSERT_EQ(2u, read_regs(&inst, 0x0Au, 1u, res));
+	ASSERT_EQ(0x80u|MBFC_READ_HOLDING_REGS, res[0]);
+	ASSERT_EQ(2u, read_regs(&inst, 0x0Au, 1u, res));
+	ASSERT_EQ(0u, plan.n_hits);
+
+	s_locked = 0;
+	ASSERT_EQ(4u, read_regs(&inst, 0x0Au, 1u, res));
+	ASSERT_EQ(4u, read_regs(&inst, 0x0Au, 1u, res));
+	ASSERT_EQ(1u, plan.n_hits);
+
+	/* The lock is evaluated on planned reads too */
+	s_locked = 1;
+	ASSERT_EQ(2u, read_regs(&inst, 0x0Au, 1u, res));
+	ASSERT_EQ(MB_ILLEGAL_DATA_ADDR, res[1]);
+}
+
+TEST(mbplan_other_map_misses)
+{
+	static const struct mbreg_desc_s other[] = {
+		{.address=0x00u, .type=MRTYPE_U16|MRTYPE_BLOCK, .n_block_entries=4u, .access=MRACC_R_PTR, .read={.pu16=s_val}},
+	};
+	const uint8_t input_req[] = {MBFC_READ_INPUT_REGS, 0x00, 0x00, 0x00, 0x04};
+	struct mbplan_s plan = {.entries=s_entries, .n_entries=2u};
+	struct mbstats_s stats;
+	struct mbinst_s inst;
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	setup(&inst, &plan, &stats);
+
+	ASSERT_EQ(10u, read_regs(&inst, 0x00u, 4u, res));
+	inst.hold_regs = other;
+	inst.n_hold_regs = 1u;
+	ASSERT_EQ(10u, read_regs(&inst, 0x00u, 4u, res));
+	ASSERT_EQ(0u, plan.n_hits);
+	ASSERT_EQ(2u, plan.n_misses);
+
+	/* Input registers of the same range are planned apart */
+	inst.input_regs = other;
+	inst.n_input_regs = 1u;
+	ASSERT_EQ(10u, mbpdu_handle_req(&inst, input_req, sizeof input_req, res));
+	ASSERT_EQ(0u, plan.n_hits);
+}
+
+TEST(mbplan_long_walk_is_not_planned)
+{
+	static uint16_t vals[MBPLAN_N_STEPS+1u];
+	static struct mbreg_desc_s regs[MBPLAN_N_STEPS+1u];
+	struct mbplan_s plan = {.entries=s_entries, .n_entries=2u};
+	struct mbstats_s stats;
+	struct mbinst_s inst;
+	uint8_t res[MBPDU_SIZE_MAX];
+	size_t i;
+
+	for (i=0u; i<MBPLAN_N_STEPS+1u; ++i) {
+		regs[i].address = (uint16_t)i;
+		regs[i].type = MRTYPE_U16;
+		regs[i].access = MRACC_R_PTR;
+		regs[i].read.pu16 = &vals[i];
+	}
+	setup(&inst, &plan, &stats);
+	inst.hold_regs = regs;
+	inst.n_hold_regs = MBPLAN_N_STEPS+1u;
+
+	ASSERT_EQ(2u+2u*MBPLAN_N_STEPS, read_regs(&inst, 0x00u, MBPLAN_N_STEPS, res));
+	ASSERT_EQ(2u+2u*MBPLAN_N_STEPS, read_regs(&inst, 0x00u, MBPLAN_N_STEPS, res));
+	ASSERT_EQ(1u, plan.n_hits);
+
+	ASSERT_EQ(4u+2u*MBPLAN_N_STEPS, read_regs(&inst, 0x00u, MBPLAN_N_STEPS+1u, res));
+	ASSERT_EQ(4u+2u*MBPLAN_N_STEPS, read_regs(&inst, 0x00u, MBPLAN_N_STEPS+1u, res));
+	ASSERT_EQ(1u, plan.n_hits);
+}
+
+TEST_MAIN(
+	mbplan_repeated_read_skips_lookup,
+	mbplan_planned_read_matches_walk,
+	mbplan_locks_still_apply,
+	mbplan_other_map_misses,
+	mbplan_long_walk_is_not_planned
+);
@@ -0,0 +1,146 @@
+#include "test_lib.h"
+#include <endian.h>
+#include <mbadu.h>
+#include <mbadu_stream.h>
+#include <mbadu_tcp.h>
+#include <mbcrc.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <mbrate.h>
+#include <mbreg.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint64_t s_now;
+static uint64_t clock_cb(void)
+{
+	return s_now;
+}
+
+static uint16_t s_val;
+static const struct mbreg_desc_s s_regs[] = {
+	{.address=0x0000, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&s_val}, .write={.pu16=&s_val}},
+};
+
+TEST(mbrate_refills_up_to_burst)
+{
+	struct mbrate_s rate = {.clock_cb=clock_cb, .ticks_per_token=10u, .burst=2u};
+
+	s_now = 1000u;
+	mbrate_init(&rate);
+	ASSERT_EQ(1, mbrate_take(&rate));
+	ASSERT_EQ(1, mbrate_take(&rate));
+	ASSERT_EQ(0, mbrate_take(&rate));
+
+	s_now = 1019u; /* One token, the remainder is kept */
+	ASSERT_EQ(1, mbrate_take(&rate));
+	ASSERT_EQ(0, mbrate_take(&rate));
+	s_now = 1020u;
+	ASSERT_EQ(1, mbrate_take(&rate));
+
+	s_now = 5000u; /* Long pause, capped at burst */
+	ASSERT_EQ(1, mbrate_take(&rate));
+	ASSERT_EQ(1, mbrate_take(&rate));
+	ASSERT_EQ(0, mbrate_take(&rate));
+	ASSERT_EQ(3u, rate.n_limited);
+
+	ASSERT_EQ(1, mbrate_take(NULL));
+}
+
+TEST(mbrate_instance_answers_busy)
+{
+	const uint8_t req[] = {MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x01};
+	uint8_t res[MBPDU_SIZE_MAX];
+	struct mbrate_s rate = {.clock_cb=clock_cb, .ticks_per_token=100u, .burst=1u};
+	struct mbinst_s inst = {.hold_regs=s_regs, .n_hold_regs=1u, .rate=&rate};
+
+	s_now = 0u;
+	mbinst_init(&inst);
+	mbrate_init(&rate);
+
+	ASSERT_EQ(4u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(MBFC_READ_HOLDING_REGS | MB_ERR_FLG, res[0]);
+	ASSERT_EQ(MB_BUSY, res[1]);
+	ASSERT_EQ(1u, inst.state.busy_counter);
+
+	s_now = 100u;
+	ASSERT_EQ(4u, mbpdu_handle_req(&inst, req, sizeof req, res));
+}
+
+TEST(mbrate_stream_sheds_tcp_frames)
+{
+	const uint8_t req[] = {
+		0x12, 0x34, 0x00, 0x00, 0x00, 0x06, 0x01,
+		MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x01,
+	};
+	uint8_t data[2u*sizeof req];
+	uint8_t res[2u*MBADU_TCP_SIZE_MAX];
+	struct mbrate_s rate = {.clock_cb=clock_cb, .ticks_per_token=100u, .burst=1u};
+	struct mbinst_s inst = {.hold_regs=s_regs, .n_hold_regs=1u};
+	struct mbadu_stream_s stream;
+	size_t n_consumed, res_len;
+
+	s_now = 0u;
+	mbinst_init(&inst);
+	mbrate_init(&rate);
+	mbadu_stream_init(&stream);
+	stream.rate = &rate;
+
+	memcpy(data, req, sizeof req);
+	memcpy(data+sizeof req, req, sizeof req);
+	data[sizeof req + 1u] = 0x35;
+
+	ASSERT_EQ(MBADU_STREAM_OK, mbadu_stream_tcp_proc(&stream, &inst, data, sizeof data, &n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(sizeof data, n_consumed);
+	ASSERT_EQ(11u + 9u, res_len);
+
+	/* Second request shed before reaching the instance */
+	ASSERT_EQ(0x1235u, betou16(res+11u+MBAP_POS_TRANS_ID));
+	ASSERT_EQ(3u, betou16(res+11u+MBAP_POS_LEN));
+	ASSERT_EQ(0x01u, res[11u+MBAP_POS_UNIT_ID]);
+	ASSERT_EQ(MBFC_READ_HOLDING_REGS | MB_ERR_FLG, res[11u+MBAP_SIZE]);
+	ASSERT_EQ(MB_BUSY, res[11u+MBAP_SIZE+1u]);
+	ASSERT_EQ(1u, inst.state.msg_counter);
+	ASSERT_EQ(1u, inst.state.busy_counter);
+	ASSERT_EQ(1u, rate.n_limited);
+}
+
+TEST(mbrate_stream_sheds_rtu_frames)
+{
+	uint8_t req[8] = {0x01, MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x01};
+	uint8_t res[2u*MBADU_SIZE_MAX];
+	struct mbrate_s rate = {.clock_cb=clock_cb, .ticks_per_token=100u, .burst=0u};
+	struct mbinst_s inst = {.serial={.slave_addr=1u}, .hold_regs=s_regs, .n_hold_regs=1u};
+	struct mbadu_stream_s stream;
+	size_t n_consumed, res_len;
+
+	s_now = 0u;
+	mbinst_init(&inst);
+	mbrate_init(&rate);
+	mbadu_stream_init(&stream);
+	stream.rate = &rate;
+	u16tole(mbcrc16(req, 6u), req+6u);
+
+	ASSERT_EQ(MBADU_STREAM_OK, mbadu_stream_rtu_proc(&stream, &inst, req, sizeof req, &n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(5u, res_len);
+	ASSERT_EQ(0x01u, res[0]);
+	ASSERT_EQ(MBFC_READ_HOLDING_REGS | MB_ERR_FLG, res[1]);
+	ASSERT_EQ(MB_BUSY, res[2]);
+	ASSERT_EQ(0u, mbcrc16(res, 5u));
+	ASSERT_EQ(1u, inst.state.busy_counter);
+	ASSERT_EQ(0u, inst.state.msg_counter);
+
+	/* Frames for other slaves get no response */
+	req[0] = 0x02;
+	u16tole(mbcrc16(req, 6u), req+6u);
+	ASSERT_EQ(MBADU_STREAM_OK, mbadu_stream_rtu_proc(&stream, &inst, req, sizeof req, &n_consumed, res, sizeof res, &res_len));
+	ASSERT_EQ(0u, res_len);
+}
+
+TEST_MAIN(
+	mbrate_refills_up_to_burst,
+	mbrate_instance_answers_busy,
+	mbrate_stream_sheds_tcp_frames,
+	mbrate_stream_sheds_rtu_frames
+);
@@ -1,7 +1,30 @@
 #include "test_lib.h"
+#include "test_policy.h"
 #include <endian.h>
 #include <mbreg.h>
 #include <mbinst.h>
+#include <mbpdu.h>
+#include <string.h>
+
+/* Entries of mbreg_policies with MBCFG_COMPACT_REGS */
+enum {POLICY_RLOCKED=1u, POLICY_WLOCKED, POLICY_BULK_RLOCK, POLICY_KERN_RLOCK, POLICY_CONFIG};
+
+#if MBCFG_COMPACT_REGS
+static int always_locked(void);
+static int bulk_unlocked(void);
+static int kern_lock(void);
+static int config_lock(void);
+static void config_written(void);
+
+const struct mbreg_policy_s mbreg_policies[] = {
+	{0},
+	[POLICY_RLOCKED] = {.rlock_cb=always_locked},
+	[POLICY_WLOCKED] = {.wlock_cb=always_locked},
+	[POLICY_BULK_RLOCK] = {.rlock_cb=bulk_unlocked},
+	[POLICY_KERN_RLOCK] = {.rlock_cb=kern_lock},
+	[POLICY_CONFIG] = {.rlock_cb=config_lock, .wlock_cb=config_lock, .post_write_cb=config_written},
+};
+#endif
 
 /* Test register size calculations for different data types */
 
@@ -217,7 +240,7 @@ TEST(mbreg_read_locked_fails)
 		.type=MRTYPE_U16,
 		.access=MRACC_R_VAL,
 		.read={.u16=0x1234},
-		.rlock_cb=always_locked
+		REG_CBS(POLICY_RLOCKED, .rlock_cb=always_locked)
 	};
 	uint8_t res[MBPDU_DATA_SIZE_MAX];
 
@@ -233,7 +256,7 @@ TEST(mbreg_write_locked_fails)
 		.type=MRTYPE_U16,
 		.access=MRACC_W_PTR,
 		.write={.pu16=&test_val},
-		.wlock_cb=always_locked
+		REG_CBS(POLICY_WLOCKED, .wlock_cb=always_locked)
 	};
 	uint8_t data[] = {0x56, 0x78};
 
@@ -309,6 +332,849 @@ TEST(mbreg_partial_reg_write_works)
 	ASSERT_EQ(0x12345678, reg_val);
 }
 
+/* Test precompiled register index */
+
+TEST(mbreg_index_span_works)
+{
+	uint16_t blk[4] = {0};
+	uint32_t u32 = 0u;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0010, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+		{.address=0x0012, .type=MRTYPE_U32, .access=MRACC_R_PTR, .read={.pu32=&u32}},
+		{.address=0x0020, .type=MRTYPE_U16|MRTYPE_BLOCK, .access=MRACC_R_PTR, .read={.pu16=blk}, .n_block_entries=4},
+	};
+
+	ASSERT_EQ(0u, mbreg_index_span(NULL, 0u));
+	ASSERT_EQ(0x14u, mbreg_index_span(regs, sizeof regs / sizeof regs[0]));
+}
+
+TEST(mbreg_index_find_matches_search)
+{
+	uint16_t blk[4] = {0};
+	uint32_t u32s[3] = {0};
+	uint64_t u64 = 0u;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0010, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+		{.address=0x0012, .type=MRTYPE_U64, .access=MRACC_R_PTR, .read={.pu64=&u64}},
+		{.address=0x0020, .type=MRTYPE_U16|MRTYPE_BLOCK, .access=MRACC_R_PTR, .read={.pu16=blk}, .n_block_entries=4},
+		{.address=0x0024, .type=MRTYPE_U32|MRTYPE_BLOCK, .access=MRACC_R_PTR, .read={.pu32=u32s}, .n_block_entries=3},
+		{.address=0x0040, .type=MRTYPE_I8, .access=MRACC_R_VAL},
+	};
+	const size_t n_regs = sizeof regs / sizeof regs[0];
+	uint16_t storage[0x40];
+	struct mbreg_index_s ix;
+	uint32_t addr;
+
+	ASSERT_EQ(1, mbreg_index_build(&ix, regs, n_regs, storage, sizeof storage / sizeof storage[0]));
+	ASSERT_EQ(0x0010u, ix.base);
+	ASSERT_EQ(0x31u, ix.n_slots);
+
+	for (addr=0u; addr<=0xFFFFu; ++addr) {
+		ASSERT_EQ(mbreg_find_desc(regs, n_regs, (uint16_t)addr), mbreg_index_find(&ix, regs, n_regs, (uint16_t)addr));
+	}
+}
+
+TEST(mbreg_index_build_too_little_storage_fails)
+{
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0000, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+		{.address=0x0010, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+	};
+	const size_t n_regs = sizeof regs / sizeof regs[0];
+	uint16_t storage[0x10];
+	struct mbreg_index_s ix;
+
+	ASSERT_EQ(0, mbreg_index_build(&ix, regs, n_regs, storage, sizeof storage / sizeof storage[0]));
+
+	/* Empty index falls back to search */
+	ASSERT_EQ(regs+1, mbreg_index_find(&ix, regs, n_regs, 0x0010));
+}
+
+TEST(mbreg_index_build_overlapping_map_fails)
+{
+	uint32_t u32 = 0u;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0000, .type=MRTYPE_U32, .access=MRACC_R_PTR, .read={.pu32=&u32}},
+		{.address=0x0001, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+	};
+	uint16_t storage[0x10];
+	struct mbreg_index_s ix;
+
+	ASSERT_EQ(0, mbreg_index_build(&ix, regs, sizeof regs / sizeof regs[0], storage, sizeof storage / sizeof storage[0]));
+}
+
+TEST(mbreg_index_find_other_map_falls_back)
+{
+	const struct mbreg_desc_s regs_a[] = {
+		{.address=0x0000, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+	};
+	const struct mbreg_desc_s regs_b[] = {
+		{.address=0x0005, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+	};
+	uint16_t storage[1];
+	struct mbreg_index_s ix;
+
+	ASSERT_EQ(1, mbreg_index_build(&ix, regs_a, 1u, storage, 1u));
+	ASSERT_EQ(regs_b, mbreg_index_find(&ix, regs_b, 1u, 0x0005));
+	ASSERT_EQ(NULL, mbreg_index_find(&ix, regs_a, 1u, 0x0005));
+}
+
+TEST(mbreg_index_ranges_match_search)
+{
+	uint16_t blk[4] = {0};
+	uint32_t u32s[3] = {0};
+	uint64_t u64 = 0u;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0010, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+		{.address=0x0012, .type=MRTYPE_U64, .access=MRACC_R_PTR, .read={.pu64=&u64}},
+		{.address=0x0020, .type=MRTYPE_U16|MRTYPE_BLOCK, .access=MRACC_R_PTR, .read={.pu16=blk}, .n_block_entries=4},
+		{.address=0x0024, .type=MRTYPE_U32|MRTYPE_BLOCK, .access=MRACC_R_PTR, .read={.pu32=u32s}, .n_block_entries=3},
+		{.address=0x0040, .type=MRTYPE_I8, .access=MRACC_R_VAL},
+		{.address=0x8000, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+		{.address=0xFFFE, .type=MRTYPE_U32, .access=MRACC_R_PTR, .read={.pu32=u32s}},
+	};
+	const size_t n_regs = sizeof regs / sizeof regs[0];
+	uint16_t storage[MBREG_RANGE_INDEX_SIZE(sizeof regs / sizeof regs[0])];
+	struct mbreg_index_s ix;
+	uint32_t addr;
+
+	ASSERT_EQ(1, mbreg_index_build_ranges(&ix, regs, n_regs, storage, sizeof storage / sizeof storage[0]));
+	ASSERT_EQ(NULL, ix.slots);
+
+	for (addr=0u; addr<=0xFFFFu; ++addr) {
+		ASSERT_EQ(mbreg_find_desc(regs, n_regs, (uint16_t)addr), mbreg_index_find(&ix, regs, n_regs, (uint16_t)addr));
+	}
+}
+
+TEST(mbreg_index_ranges_build_fails)
+{
+	uint32_t u32 = 0u;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0000, .type=MRTYPE_U32, .access=MRACC_R_PTR, .read={.pu32=&u32}},
+		{.address=0x0001, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+	};
+	uint16_t storage[4];
+	struct mbreg_index_s ix;
+
+	ASSERT_EQ(0, mbreg_index_build_ranges(&ix, regs, 1u, storage, 1u)); /* Too little storage */
+	ASSERT_EQ(0, mbreg_index_build_ranges(&ix, regs, 2u, storage, 4u)); /* Overlapping */
+
+	/* Empty index falls back to search */
+	ASSERT_EQ(regs, mbreg_index_find(&ix, regs, 2u, 0x0001));
+}
+
+TEST(mbreg_cursor_with_range_index_works)
+{
+	uint16_t blk[4] = {0};
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0001, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+		{.address=0x0004, .type=MRTYPE_U16|MRTYPE_BLOCK, .access=MRACC_R_PTR, .read={.pu16=blk}, .n_block_entries=4},
+	};
+	uint16_t storage[MBREG_RANGE_INDEX_SIZE(2u)];
+	struct mbreg_index_s ix;
+	struct mbreg_cursor_s cur;
+
+	ASSERT_EQ(1, mbreg_index_build_ranges(&ix, regs, 2u, storage, sizeof storage / sizeof storage[0]));
+
+	mbreg_cursor_init(&cur, &ix, regs, 2u, 0x0002); /* Unmapped start */
+	ASSERT_EQ(NULL, mbreg_cursor_find(&cur, 0x0002));
+	ASSERT_EQ(regs+1, mbreg_cursor_find(&cur, 0x0004));
+	ASSERT_EQ(regs+1, mbreg_cursor_find(&cur, 0x0007));
+	ASSERT_EQ(NULL, mbreg_cursor_find(&cur, 0x0008));
+}
+
+TEST(mbreg_cursor_matches_search)
+{
+	uint16_t blk[4] = {0};
+	uint64_t u64 = 0u;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0010, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+		{.address=0x0012, .type=MRTYPE_U64, .access=MRACC_R_PTR, .read={.pu64=&u64}},
+		{.address=0x0020, .type=MRTYPE_U16|MRTYPE_BLOCK, .access=MRACC_R_PTR, .read={.pu16=blk}, .n_block_entries=4},
+		{.address=0x0030, .type=MRTYPE_I8, .access=MRACC_R_VAL},
+	};
+	const size_t n_regs = sizeof regs / sizeof regs[0];
+	struct mbreg_cursor_s cur;
+	uint32_t start, addr;
+
+	for (start=0x0000u; start<0x0040u; ++start) {
+		mbreg_cursor_init(&cur, NULL, regs, n_regs, (uint16_t)start);
+		for (addr=start; addr<0x0040u; ++addr) {
+			ASSERT_EQ(mbreg_find_desc(regs, n_regs, (uint16_t)addr), mbreg_cursor_find(&cur, (uint16_t)addr));
+		}
+	}
+}
+
+TEST(mbreg_cursor_with_index_works)
+{
+	uint16_t blk[4] = {0};
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0001, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+		{.address=0x0004, .type=MRTYPE_U16|MRTYPE_BLOCK, .access=MRACC_R_PTR, .read={.pu16=blk}, .n_block_entries=4},
+	};
+	uint16_t storage[8];
+	struct mbreg_index_s ix;
+	struct mbreg_cursor_s cur;
+
+	ASSERT_EQ(1, mbreg_index_build(&ix, regs, 2u, storage, sizeof storage / sizeof storage[0]));
+
+	mbreg_cursor_init(&cur, &ix, regs, 2u, 0x0006);
+	ASSERT_EQ(regs+1, mbreg_cursor_find(&cur, 0x0006));
+	ASSERT_EQ(regs+1, mbreg_cursor_find(&cur, 0x0007));
+	ASSERT_EQ(NULL, mbreg_cursor_find(&cur, 0x0008));
+
+	mbreg_cursor_init(&cur, &ix, regs, 2u, 0x0002); /* Unmapped start */
+	ASSERT_EQ(NULL, mbreg_cursor_find(&cur, 0x0002));
+	ASSERT_EQ(regs+1, mbreg_cursor_find(&cur, 0x0004));
+}
+
+/* Test bulk copy of 16-bit blocks */
+
+TEST(mbreg_bulk_u16_block_read_works)
+{
+	uint16_t blk[4] = {0x0102, 0x0304, 0x0506, 0x0708};
+	const struct mbreg_desc_s reg = {
+		.address=0x0010,
+		.type=MRTYPE_U16|MRTYPE_BLOCK,
+		.access=MRACC_R_PTR,
+		.read={.pu16=blk},
+		.n_block_entries=4
+	};
+	uint8_t buf[8] = {0};
+
+	ASSERT_EQ(3u, mbreg_read(&reg, 0x0011, 10u, buf, 0));
+	ASSERT_EQ(0x03u, buf[0]);
+	ASSERT_EQ(0x04u, buf[1]);
+	ASSERT_EQ(0x07u, buf[4]);
+	ASSERT_EQ(0x08u, buf[5]);
+
+	ASSERT_EQ(2u, mbreg_read(&reg, 0x0010, 2u, NULL, 0)); /* Dry run */
+	ASSERT_EQ(MBREG_READ_DEV_FAIL, mbreg_read(&reg, 0x0014, 1u, buf, 0)); /* Past end of block */
+}
+
+TEST(mbreg_bulk_u16_block_write_works)
+{
+	int16_t blk[4] = {0};
+	const struct mbreg_desc_s reg = {
+		.address=0x0010,
+		.type=MRTYPE_I16|MRTYPE_BLOCK,
+		.access=MRACC_W_PTR,
+		.write={.pi16=blk},
+		.n_block_entries=4
+	};
+	const uint8_t val[] = {0xFF, 0xFE, 0x12, 0x34, 0xAA, 0xBB};
+	size_t n_written = 0u;
+
+	ASSERT_EQ(3u, mbreg_write_allowed(&reg, 0x0011, 0x0011, 3u, val));
+	ASSERT_EQ(MB_OK, mbreg_write(&reg, 0x0011, 3u, val, &n_written));
+	ASSERT_EQ(3u, n_written);
+	ASSERT_EQ(0, blk[0]);
+	ASSERT_EQ(-2, blk[1]);
+	ASSERT_EQ(0x1234, blk[2]);
+	ASSERT_EQ((int16_t)0xAABB, blk[3]);
+
+	ASSERT_EQ(1u, mbreg_write_allowed(&reg, 0x0013, 0x0011, 3u, val)); /* Limited by end of block */
+}
+
+static int bulk_unlocked(void) { return 0; }
+
+TEST(mbreg_bulk_u16_block_with_lock_reads_per_element)
+{
+	uint16_t blk[4] = {0x0102, 0x0304, 0x0506, 0x0708};
+	const struct mbreg_desc_s reg = {
+		.address=0x0010,
+		.type=MRTYPE_U16|MRTYPE_BLOCK,
+		.access=MRACC_R_PTR,
+		.read={.pu16=blk},
+		REG_CBS(POLICY_BULK_RLOCK, .rlock_cb=bulk_unlocked),
+		.n_block_entries=4
+	};
+	uint8_t buf[8] = {0};
+
+	ASSERT_EQ(1u, mbreg_read(&reg, 0x0011, 3u, buf, 0));
+	ASSERT_EQ(0x03u, buf[0]);
+	ASSERT_EQ(0x04u, buf[1]);
+}
+
+static uint16_t s_adc[16];
+static int s_adc_calls;
+static size_t s_adc_last_n;
+
+static enum mbstatus_e adc_burst_read(uint16_t addr, size_t n, uint8_t *buf)
+{
+	++s_adc_calls;
+	s_adc_last_n = n;
+	for (size_t i=0u; i<n; ++i) {
+		buf[2u*i] = (uint8_t)(s_adc[addr-0x0100u+i] >> 8);
+		buf[(2u*i)+1u] = (uint8_t)s_adc[addr-0x0100u+i];
+	}
+	return MB_OK;
+}
+
+static enum mbstatus_e adc_burst_write(uint16_t addr, size_t n, const uint8_t *buf)
+{
+	++s_adc_calls;
+	s_adc_last_n = n;
+	for (size_t i=0u; i<n; ++i) {
+		s_adc[addr-0x0100u+i] = (uint16_t)((buf[2u*i] << 8) | buf[(2u*i)+1u]);
+	}
+	return MB_OK;
+}
+
+static enum mbstatus_e adc_burst_fail(uint16_t addr, size_t n, uint8_t *buf)
+{
+	(void)addr; (void)n; (void)buf;
+	return MB_DEV_FAIL;
+}
+
+TEST(mbreg_bulk_fn_read_write_works)
+{
+	const struct mbreg_desc_s reg = {
+		.address=0x0100,
+		.type=MRTYPE_U16|MRTYPE_BLOCK,
+		.access=MRACC_RW_BULK,
+		.read={.bulk=adc_burst_read},
+		.write={.bulk=adc_burst_write},
+		.n_block_entries=16
+	};
+	const uint8_t val[] = {0x12, 0x34, 0x56, 0x78};
+	uint8_t buf[32] = {0};
+	size_t n_written = 0u;
+
+	s_adc_calls = 0;
+	ASSERT_EQ(2u, mbreg_write_allowed(&reg, 0x010E, 0x010E, 5u, val)); /* Limited by end of block */
+	ASSERT_EQ(MB_OK, mbreg_write(&reg, 0x010E, 5u, val, &n_written));
+	ASSERT_EQ(2u, n_written);
+	ASSERT_EQ(0x1234u, s_adc[14]);
+	ASSERT_EQ(0x5678u, s_adc[15]);
+
+	ASSERT_EQ(3u, mbreg_read(&reg, 0x010D, 10u, buf, 0));
+	ASSERT_EQ(0x12u, buf[2]);
+	ASSERT_EQ(0x78u, buf[5]);
+	ASSERT_EQ(2, s_adc_calls);
+
+	ASSERT_EQ(16u, mbreg_read(&reg, 0x0100, 20u, NULL, 0)); /* Dry run doesn't call back */
+	ASSERT_EQ(2, s_adc_calls);
+}
+
+TEST(mbreg_bulk_fn_failure_is_dev_fail)
+{
+	const struct mbreg_desc_s reg = {
+		.address=0x0100, .type=MRTYPE_U16, .access=MRACC_R_BULK, .read={.bulk=adc_burst_fail},
+	};
+	uint8_t buf[2];
+
+	ASSERT_EQ(MBREG_READ_DEV_FAIL, mbreg_read(&reg, 0x0100, 1u, buf, 0));
+}
+
+TEST(mbreg_bulk_fn_adjacent_descriptors_merged)
+{
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0100, .type=MRTYPE_U16, .access=MRACC_RW_BULK, .read={.bulk=adc_burst_read}, .write={.bulk=adc_burst_write}},
+		{.address=0x0101, .type=MRTYPE_U32, .access=MRACC_RW_BULK, .read={.bulk=adc_burst_read}, .write={.bulk=adc_burst_write}},
+		{.address=0x0103, .type=MRTYPE_U16|MRTYPE_BLOCK, .access=MRACC_RW_BULK, .read={.bulk=adc_burst_read}, .write={.bulk=adc_burst_write}, .n_block_entries=5},
+		{.address=0x0108, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=0xBEEF}},
+		{.address=0x0109, .type=MRTYPE_U16, .access=MRACC_RW_BULK, .read={.bulk=adc_burst_read}, .write={.bulk=adc_burst_write}},
+	};
+	struct mbinst_s inst = {.hold_regs=regs, .n_hold_regs=sizeof regs/sizeof regs[0]};
+	mbinst_init(&inst);
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	for (size_t i=0u; i<16u; ++i) {
+		s_adc[i] = (uint16_t)(0x1000u + i);
+	}
+
+	/* Read 0x0101-0x0109: one call for 0x0101-0x0107, a value and one call for 0x0109 */
+	s_adc_calls = 0;
+	uint8_t req[] = {MBFC_READ_HOLDING_REGS, 0x01, 0x01, 0x00, 0x09};
+	ASSERT_EQ(2u+18u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(2, s_adc_calls);
+	ASSERT_EQ(0x10u, res[2]);
+	ASSERT_EQ(0x01u, res[3]);
+	ASSERT_EQ(0x07u, res[15]);
+	ASSERT_EQ(0xBEu, res[16]);
+	ASSERT_EQ(0xEFu, res[17]);
+	ASSERT_EQ(0x09u, res[19]);
+
+	/* Write 0x0100-0x0104 in one call */
+	s_adc_calls = 0;
+	uint8_t wreq[] = {MBFC_WRITE_MULTIPLE_REGS, 0x01, 0x00, 0x00, 0x05, 0x0A,
+		0x00, 0x01, 0x00, 0x02, 0x00, 0x03, 0x00, 0x04, 0x00, 0x05};
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, wreq, sizeof wreq, res));
+	ASSERT_EQ(1, s_adc_calls);
+	ASSERT_EQ(5u, s_adc_last_n);
+	ASSERT_EQ(0x0001u, s_adc[0]);
+	ASSERT_EQ(0x0005u, s_adc[4]);
+	ASSERT_EQ(0x1005u, s_adc[5]);
+}
+
+static int32_t s_kern_i32 = -2;
+static int32_t kern_read_i32(void) {return s_kern_i32;}
+static enum mbstatus_e kern_write_i32(int32_t v) {s_kern_i32 = v; return MB_OK;}
+static int s_kern_locked = 0;
+static int kern_lock(void) {return s_kern_locked;}
+
+TEST(mbreg_kernels_match_generic_access)
+{
+	uint8_t u8 = 0x12u;
+	uint64_t u64 = 0x0102030405060708u;
+	float f32 = 1.5f;
+	uint16_t block[2] = {0xAAAAu, 0xBBBBu};
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x00u, .type=MRTYPE_U8, .access=MRACC_RW_PTR, .read={.pu8=&u8}, .write={.pu8=&u8}},
+		{.address=0x01u, .type=MRTYPE_U64, .access=MRACC_RW_PTR, .read={.pu64=&u64}, .write={.pu64=&u64}},
+		{.address=0x05u, .type=MRTYPE_F32, .access=MRACC_RW_PTR, .read={.pf32=&f32}, .write={.pf32=&f32}, REG_CBS(POLICY_KERN_RLOCK, .rlock_cb=kern_lock)},
+		{.address=0x07u, .type=MRTYPE_I32, .access=MRACC_RW_FN, .read={.fi32=kern_read_i32}, .write={.fi32=kern_write_i32}},
+		{.address=0x09u, .type=MRTYPE_U32, .access=MRACC_R_VAL, .read={.u32=0xDEADBEEFu}},
+		{.address=0x0Bu, .type=MRTYPE_U16|MRTYPE_BLOCK, .n_block_entries=2u, .access=MRACC_RW_PTR, .read={.pu16=block}, .write={.pu16=block}},
+	};
+	struct mbreg_kernel_s kern[sizeof regs / sizeof regs[0]];
+	struct mbinst_s inst = {.input_regs=regs, .n_input_regs=sizeof regs / sizeof regs[0], .swap_words=1};
+	const uint8_t read_req[] = {MBFC_READ_INPUT_REGS, 0x00, 0x00, 0x00, 0x0D};
+	const uint8_t rd_part[] = {MBFC_READ_INPUT_REGS, 0x00, 0x02, 0x00, 0x02};
+	uint8_t res_generic[MBPDU_SIZE_MAX], res_kern[MBPDU_SIZE_MAX];
+	size_t n;
+
+	mbinst_init(&inst);
+	mbreg_kernels_build(kern, regs, sizeof regs / sizeof regs[0], inst.swap_words);
+	ASSERT(kern[0].read!=NULL);
+	ASSERT(kern[4].read!=NULL);
+	ASSERT(kern[4].write==NULL);
+	ASSERT(kern[5].read==NULL); /* Blocks use mbreg_read() */
+	ASSERT_EQ(4u, kern[1].n_words);
+
+	n = mbpdu_handle_req(&inst, read_req, sizeof read_req, res_generic);
+	ASSERT_EQ(28u, n);
+	inst.input_regs_kern = kern;
+	ASSERT_EQ(n, mbpdu_handle_req(&inst, read_req, sizeof read_req, res_kern));
+	ASSERT(memcmp(res_generic, res_kern, n)==0);
+	ASSERT_EQ(0xBEEFu, betou16(res_kern+20)); /* Word swapped */
+
+	/* Partial registers, locks and other word orders take the generic path */
+	ASSERT_EQ(6u, mbpdu_handle_req(&inst, rd_part, sizeof rd_part, res_kern));
+	s_kern_locked = 1;
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, read_req, sizeof read_req, res_kern));
+	s_kern_locked = 0;
+	ASSERT_EQ(2u, mbreg_read_kernel(NULL, &kern[5], &regs[5], 0x0Bu, 2u, res_kern, 1));
+	ASSERT_EQ(0xBBBBu, betou16(res_kern+2));
+	ASSERT_EQ(4u, mbreg_read_kernel(NULL, &kern[1], &regs[1], 0x01u, 4u, res_kern, 0));
+	ASSERT_EQ(0x0102u, betou16(res_kern));
+}
+
+TEST(mbreg_kernels_write_through_instance)
+{
+	uint8_t u8 = 0u;
+	uint64_t u64 = 0u;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x00u, .type=MRTYPE_U8, .access=MRACC_RW_PTR, .read={.pu8=&u8}, .write={.pu8=&u8}},
+		{.address=0x01u, .type=MRTYPE_U64, .access=MRACC_RW_PTR, .read={.pu64=&u64}, .write={.pu64=&u64}},
+		{.address=0x05u, .type=MRTYPE_I32, .access=MRACC_RW_FN, .read={.fi32=kern_read_i32}, .write={.fi32=kern_write_i32}},
+	};
+	struct mbreg_kernel_s kern[sizeof regs / sizeof regs[0]];
+	struct mbinst_s inst = {.hold_regs=regs, .n_hold_regs=sizeof regs / sizeof regs[0], .hold_regs_kern=kern};
+	const uint8_t req[] = {
+		MBFC_WRITE_MULTIPLE_REGS, 0x00, 0x00, 0x00, 0x07, 0x0E,
+		0x00, 0x34,
+		0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88,
+		0xFF, 0xFF, 0xFF, 0xFD,
+	};
+	const uint8_t part_req[] = {MBFC_WRITE_MULTIPLE_REGS, 0x00, 0x04, 0x00, 0x01, 0x02, 0x99, 0x99};
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	mbinst_init(&inst);
+	mbreg_kernels_build(kern, regs, sizeof regs / sizeof regs[0], 0);
+
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(0x34u, u8);
+	ASSERT_EQ(0x1122334455667788u, u64);
+	ASSERT_EQ(-3, s_kern_i32);
+
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, part_req, sizeof part_req, res)); /* Last word only */
+	ASSERT_EQ(0x1122334455669999u, u64);
+}
+
+TEST(mbreg_byte_order_u32_read_write_works)
+{
+	static const struct {uint8_t order; uint8_t wire[4];} cases[] = {
+		{MBREG_ORDER_ABCD, {0x12, 0x34, 0x56, 0x78}},
+		{MBREG_ORDER_CDAB, {0x56, 0x78, 0x12, 0x34}},
+		{MBREG_ORDER_BADC, {0x34, 0x12, 0x78, 0x56}},
+		{MBREG_ORDER_DCBA, {0x78, 0x56, 0x34, 0x12}},
+	};
+	uint32_t v;
+	uint8_t buf[4];
+	size_t i, n_written;
+	struct mbreg_desc_s reg = {
+		.address=0x0010,
+		.type=MRTYPE_U32,
+		.access=MRACC_RW_PTR,
+		.read={.pu32=&v},
+		.write={.pu32=&v},
+	};
+
+	for (i=0u; i<(sizeof cases / sizeof cases[0]); ++i) {
+		reg.byte_order = cases[i].order;
+		v = 0x12345678u;
+		ASSERT_EQ(2u, mbreg_read(&reg, 0x0010, 2u, buf, 0));
+		ASSERT(memcmp(buf, cases[i].wire, 4u)==0);
+		ASSERT_EQ(2u, mbreg_read(&reg, 0x0010, 2u, buf, 1)); /* Descriptor order wins */
+		ASSERT(memcmp(buf, cases[i].wire, 4u)==0);
+
+		v = 0u;
+		ASSERT_EQ(MB_OK, mbreg_write(&reg, 0x0010, 2u, cases[i].wire, &n_written));
+		ASSERT_EQ(0x12345678u, v);
+
+		/* Partial write of the second register keeps the first */
+		v = 0x12345678u;
+		buf[0] = 0xAAu;
+		buf[1] = 0xBBu;
+		ASSERT_EQ(MB_OK, mbreg_write(&reg, 0x0011, 1u, buf, &n_written));
+		ASSERT_EQ(2u, mbreg_read(&reg, 0x0010, 2u, buf+0u, 0));
+		ASSERT_EQ(cases[i].wire[0], buf[0]);
+		ASSERT_EQ(cases[i].wire[1], buf[1]);
+		ASSERT_EQ(0xAAu, buf[2]);
+		ASSERT_EQ(0xBBu, buf[3]);
+	}
+}
+
+TEST(mbreg_byte_order_u64_and_f64_works)
+{
+	uint64_t u = 0x0102030405060708uLL;
+	double f = 1.0; /* 3F F0 00 00 00 00 00 00 */
+	const uint8_t u_cdab[8] = {0x07, 0x08, 0x05, 0x06, 0x03, 0x04, 0x01, 0x02};
+	const uint8_t u_badc[8] = {0x02, 0x01, 0x04, 0x03, 0x06, 0x05, 0x08, 0x07};
+	const uint8_t f_dcba[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0x3F};
+	uint8_t buf[8];
+	struct mbreg_desc_s ureg = {
+		.address=0x0000,
+		.byte_order=MBREG_ORDER_CDAB,
+		.type=MRTYPE_U64,
+		.access=MRACC_RW_PTR,
+		.read={.pu64=&u},
+		.write={.pu64=&u},
+	};
+	const struct mbreg_desc_s freg = {
+		.address=0x0000,
+		.byte_order=MBREG_ORDER_DCBA,
+		.type=MRTYPE_F64,
+		.access=MRACC_R_PTR,
+		.read={.pf64=&f},
+	};
+
+	ASSERT_EQ(4u, mbreg_read(&ureg, 0x0000, 4u, buf, 0));
+	ASSERT(memcmp(buf, u_cdab, 8u)==0);
+
+	ureg.byte_order = MBREG_ORDER_BADC;
+	ASSERT_EQ(4u, mbreg_read(&ureg, 0x0000, 4u, buf, 0));
+	ASSERT(memcmp(buf, u_badc, 8u)==0);
+	u = 0u;
+	ASSERT_EQ(MB_OK, mbreg_write(&ureg, 0x0000, 4u, u_badc, NULL));
+	ASSERT_EQ(0x0102030405060708uLL, u);
+
+	ASSERT_EQ(4u, mbreg_read(&freg, 0x0000, 4u, buf, 0));
+	ASSERT(memcmp(buf, f_dcba, 8u)==0);
+}
+
+TEST(mbreg_byte_order_badc_u16_block_works)
+{
+	uint16_t arr[3] = {0x1234, 0x5678, 0x9ABC};
+	uint8_t buf[6];
+	const uint8_t wire[6] = {0x34, 0x12, 0x78, 0x56, 0xBC, 0x9A};
+	const struct mbreg_desc_s reg = {
+		.address=0x0100,
+		.byte_order=MBREG_ORDER_BADC,
+		.type=MRTYPE_U16 | MRTYPE_BLOCK,
+		.access=MRACC_RW_PTR,
+		.read={.pu16=arr},
+		.write={.pu16=arr},
+		.n_block_entries=3u,
+	};
+
+	ASSERT_EQ(1u, mbreg_read(&reg, 0x0100, 3u, buf+0u, 0)); /* No bulk copy */
+	ASSERT_EQ(1u, mbreg_read(&reg, 0x0101, 2u, buf+2u, 0));
+	ASSERT_EQ(1u, mbreg_read(&reg, 0x0102, 1u, buf+4u, 0));
+	ASSERT(memcmp(buf, wire, 6u)==0);
+
+	buf[0] = 0xCD;
+	buf[1] = 0xAB;
+	ASSERT_EQ(MB_OK, mbreg_write(&reg, 0x0101, 1u, buf, NULL));
+	ASSERT_EQ(0xABCDu, arr[1]);
+}
+
+TEST(mbreg_byte_order_kernels_fall_back)
+{
+	uint32_t v = 0x12345678u;
+	uint8_t res[MBPDU_SIZE_MAX];
+	const uint8_t req_rd[] = {MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x04};
+	const uint8_t req_wr[] = {MBFC_WRITE_MULTIPLE_REGS, 0x00, 0x02, 0x00, 0x02, 0x04, 0x78, 0x56, 0x34, 0x12};
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0000, .byte_order=MBREG_ORDER_CDAB, .type=MRTYPE_U32, .access=MRACC_R_PTR, .read={.pu32=&v}},
+		{.address=0x0002, .byte_order=MBREG_ORDER_DCBA, .type=MRTYPE_U32, .access=MRACC_RW_PTR, .read={.pu32=&v}, .write={.pu32=&v}},
+	};
+	struct mbreg_kernel_s kernels[2];
+	struct mbinst_s inst = {
+		.hold_regs=regs,
+		.n_hold_regs=2u,
+		.hold_regs_kern=kernels,
+	};
+	mbinst_init(&inst);
+	mbreg_kernels_build(kernels, regs, 2u, 0);
+
+	ASSERT(kernels[0].read!=NULL);
+	ASSERT(kernels[1].read==NULL);
+	ASSERT(kernels[1].write==NULL);
+
+	ASSERT_EQ(10u, mbpdu_handle_req(&inst, req_rd, sizeof req_rd, res));
+	ASSERT_EQ(0x56u, res[2]);
+	ASSERT_EQ(0x78u, res[3]);
+	ASSERT_EQ(0x12u, res[4]);
+	ASSERT_EQ(0x34u, res[5]);
+	ASSERT_EQ(0x78u, res[6]);
+	ASSERT_EQ(0x56u, res[7]);
+	ASSERT_EQ(0x34u, res[8]);
+	ASSERT_EQ(0x12u, res[9]);
+
+	v = 0u;
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, req_wr, sizeof req_wr, res));
+	ASSERT_EQ(0x12345678u, v);
+}
+
+static int s_n_memo_calls = 0;
+static int memo_lock_a(void) {++s_n_memo_calls; return 1;}
+static int memo_lock_b(void) {++s_n_memo_calls; return 0;}
+
+TEST(mbreg_memo_calls_each_lock_once)
+{
+	struct mbreg_memo_s memo;
+	mbreg_memo_init(&memo);
+	s_n_memo_calls = 0;
+
+	ASSERT_EQ(0, mbreg_memo_locked(&memo, NULL));
+	ASSERT_EQ(1, mbreg_memo_locked(&memo, memo_lock_a));
+	ASSERT_EQ(0, mbreg_memo_locked(&memo, memo_lock_b));
+	ASSERT_EQ(1, mbreg_memo_locked(&memo, memo_lock_a));
+	ASSERT_EQ(0, mbreg_memo_locked(&memo, memo_lock_b));
+	ASSERT_EQ(2, s_n_memo_calls);
+
+	ASSERT_EQ(1, mbreg_memo_locked(NULL, memo_lock_a)); /* No memo, always called */
+	ASSERT_EQ(3, s_n_memo_calls);
+
+	mbreg_memo_init(&memo); /* Next request */
+	ASSERT_EQ(1, mbreg_memo_locked(&memo, memo_lock_a));
+	ASSERT_EQ(4, s_n_memo_calls);
+}
+
+TEST(mbreg_validate_checks_map_in_one_pass)
+{
+	uint16_t vals[4];
+	uint16_t issue = 0u;
+	const struct mbreg_desc_s valid[] = {
+		{.address=0x00u, .type=MRTYPE_U16 | MRTYPE_BLOCK, .n_block_entries=4u, .access=MRACC_RW_PTR, .read={.pu16=vals}, .write={.pu16=vals}},
+		{.address=0x04u, .type=MRTYPE_F32, .access=MRACC_R_VAL, .read={.f32=1.0f}},
+	};
+	const struct mbreg_desc_s block_overlap[] = {
+		{.address=0x00u, .type=MRTYPE_U16 | MRTYPE_BLOCK, .n_block_entries=4u, .access=MRACC_R_PTR, .read={.pu16=vals}},
+		{.address=0x03u, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+	};
+	const struct mbreg_desc_s no_ptr[] = {
+		{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+		{.address=0x01u, .type=MRTYPE_U16, .access=MRACC_W_PTR},
+	};
+	const struct mbreg_desc_s block_val[] = {
+		{.address=0x07u, .type=MRTYPE_U16 | MRTYPE_BLOCK, .n_block_entries=2u, .access=MRACC_R_VAL},
+	};
+	const struct mbreg_desc_s two_types[] = {
+		{.address=0x05u, .type=MRTYPE_U16 | MRTYPE_SIGNED, .access=MRACC_R_VAL},
+	};
+
+	ASSERT_EQ(1, mbreg_validate(valid, 2u, &issue));
+	ASSERT_EQ(1, mbreg_validate(NULL, 0u, &issue));
+	ASSERT_EQ(0, mbreg_validate(block_overlap, 2u, &issue));
+	ASSERT_EQ(0x03u, issue);
+	ASSERT_EQ(0, mbreg_validate(no_ptr, 2u, &issue));
+	ASSERT_EQ(0x01u, issue);
+	ASSERT_EQ(0, mbreg_validate(block_val, 1u, &issue));
+	ASSERT_EQ(0x07u, issue);
+	ASSERT_EQ(0, mbreg_validate(two_types, 1u, NULL));
+}
+
+TEST(mbreg_index_paged_matches_search)
+{
+	uint16_t blk[4] = {0};
+	uint32_t u32s[3] = {0};
+	uint64_t u64 = 0u;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0010, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+		{.address=0x0012, .type=MRTYPE_U64, .access=MRACC_R_PTR, .read={.pu64=&u64}},
+		{.address=0x0020, .type=MRTYPE_U16|MRTYPE_BLOCK, .access=MRACC_R_PTR, .read={.pu16=blk}, .n_block_entries=4},
+		{.address=0x01FE, .type=MRTYPE_U32|MRTYPE_BLOCK, .access=MRACC_R_PTR, .read={.pu32=u32s}, .n_block_entries=2},
+		{.address=0x8000, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+		{.address=0xFFFE, .type=MRTYPE_U32, .access=MRACC_R_PTR, .read={.pu32=u32s}},
+	};
+	const size_t n_regs = sizeof regs / sizeof regs[0];
+	uint16_t storage[MBPAGE_STORAGE_SIZE(5)];
+	struct mbreg_index_s ix;
+	uint32_t addr;
+
+	/* Pages 0x00, 0x01, 0x02, 0x80 and 0xFF populated */
+	ASSERT_EQ(MBPAGE_STORAGE_SIZE(5), mbreg_index_paged_size(regs, n_regs));
+	ASSERT_EQ(0, mbreg_index_build_paged(&ix, regs, n_regs, storage, MBPAGE_STORAGE_SIZE(4)));
+	ASSERT_EQ(1, mbreg_index_build_paged(&ix, regs, n_regs, storage, sizeof storage / sizeof storage[0]));
+	ASSERT_EQ(NULL, ix.slots);
+	ASSERT_EQ(NULL, ix.starts);
+
+	for (addr=0u; addr<=0xFFFFu; ++addr) {
+		ASSERT_EQ(mbreg_find_desc(regs, n_regs, (uint16_t)addr), mbreg_index_find(&ix, regs, n_regs, (uint16_t)addr));
+	}
+}
+
+TEST(mbreg_index_paged_build_fails)
+{
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x0010, .type=MRTYPE_U32, .access=MRACC_R_VAL},
+		{.address=0x0011, .type=MRTYPE_U16, .access=MRACC_R_VAL},
+	};
+	uint16_t storage[MBPAGE_STORAGE_SIZE(1)];
+	struct mbreg_index_s ix;
+
+	ASSERT_EQ(0u, mbreg_index_paged_size(regs, 2u)); /* Overlapping */
+	ASSERT_EQ(0, mbreg_index_build_paged(&ix, regs, 2u, storage, sizeof storage / sizeof storage[0]));
+
+	/* Empty index falls back to search */
+	ASSERT_EQ(mbreg_find_desc(regs, 2u, 0x0011), mbreg_index_find(&ix, regs, 2u, 0x0011));
+}
+
+static int s_n_fn_calls = 0;
+static double memo_fn_f64(void) {++s_n_fn_calls; return 1234.5678;}
+
+TEST(mbreg_memo_calls_read_fn_once)
+{
+	const struct mbreg_desc_s reg = {.address=0x10u, .type=MRTYPE_F64, .access=MRACC_R_FN, .read={.ff64=memo_fn_f64}};
+	struct mbreg_memo_s memo;
+	uint8_t full[8], swapped[8], res[8];
+	mbreg_memo_init(&memo);
+
+	ASSERT_EQ(4u, mbreg_read(&reg, 0x10u, 4u, full, 0));
+	ASSERT_EQ(4u, mbreg_read(&reg, 0x10u, 4u, swapped, 1));
+	s_n_fn_calls = 0;
+
+	/* A read of the two halves calls the function once */
+	ASSERT_EQ(2u, mbreg_read_memo(&memo, &reg, 0x10u, 2u, res, 0));
+	ASSERT_EQ(2u, mbreg_read_memo(&memo, &reg, 0x12u, 2u, res+4u, 0));
+	ASSERT(memcmp(res, full, sizeof res)==0);
+	ASSERT_EQ(1, s_n_fn_calls);
+
+	/* The remembered value is encoded for each word order */
+	ASSERT_EQ(4u, mbreg_read_memo(&memo, &reg, 0x10u, 4u, res, 1));
+	ASSERT(memcmp(res, swapped, sizeof res)==0);
+	ASSERT_EQ(1, s_n_fn_calls);
+
+	mbreg_memo_drop_vals(&memo);
+	ASSERT_EQ(4u, mbreg_read_memo(&memo, &reg, 0x10u, 4u, res, 0));
+	ASSERT_EQ(2, s_n_fn_calls);
+
+	mbreg_memo_init(&memo); /* Next request */
+	ASSERT_EQ(4u, mbreg_read_memo(&memo, &reg, 0x10u, 4u, res, 0));
+	ASSERT_EQ(3, s_n_fn_calls);
+}
+
+static uint64_t s_fn_now;
+static uint64_t fn_clock_cb(void) {return s_fn_now;}
+static uint16_t s_fn_hold;
+
+TEST(mbreg_fn_cache_keeps_values_for_max_age)
+{
+	const struct mbreg_desc_s input_regs[] = {
+		{.address=0x10u, .type=MRTYPE_F64, .access=MRACC_R_FN, .read={.ff64=memo_fn_f64}},
+	};
+	const struct mbreg_desc_s hold_regs[] = {
+		{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&s_fn_hold}, .write={.pu16=&s_fn_hold}},
+	};
+	struct mbreg_fn_cache_entry_s entries[2];
+	struct mbreg_fn_cache_s fn_cache = {.entries=entries, .n_entries=2u, .clock_cb=fn_clock_cb, .max_age_ticks=100u};
+	struct mbinst_s inst = {
+		.input_regs=input_regs, .n_input_regs=1u,
+		.hold_regs=hold_regs, .n_hold_regs=1u,
+		.fn_cache=&fn_cache,
+	};
+	const uint8_t req_lo[] = {MBFC_READ_INPUT_REGS, 0x00, 0x10, 0x00, 0x02};
+	const uint8_t req_hi[] = {MBFC_READ_INPUT_REGS, 0x00, 0x12, 0x00, 0x02};
+	const uint8_t req_wr[] = {MBFC_WRITE_SINGLE_REG, 0x00, 0x00, 0x00, 0x01};
+	uint8_t res[MBPDU_SIZE_MAX];
+	uint8_t full[8];
+	mbinst_init(&inst);
+	mbreg_fn_cache_init(&fn_cache);
+	ASSERT_EQ(4u, mbreg_read(&input_regs[0], 0x10u, 4u, full, 0));
+	s_fn_now = 1000u;
+	s_n_fn_calls = 0;
+
+	/* The halves of the value are read by separate polls */
+	ASSERT_EQ(6u, mbpdu_handle_req(&inst, req_lo, sizeof req_lo, res));
+	ASSERT(memcmp(res+2u, full, 4u)==0);
+	s_fn_now += 50u;
+	ASSERT_EQ(6u, mbpdu_handle_req(&inst, req_hi, sizeof req_hi, res));
+	ASSERT(memcmp(res+2u, full+4u, 4u)==0);
+	ASSERT_EQ(1, s_n_fn_calls);
+	ASSERT_EQ(1u, fn_cache.n_hits);
+	ASSERT_EQ(1u, fn_cache.n_misses);
+
+	s_fn_now += 100u; /* Older than max_age_ticks */
+	ASSERT_EQ(6u, mbpdu_handle_req(&inst, req_hi, sizeof req_hi, res));
+	ASSERT_EQ(2, s_n_fn_calls);
+
+	/* A write request drops the values */
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, req_wr, sizeof req_wr, res));
+	ASSERT_EQ(6u, mbpdu_handle_req(&inst, req_lo, sizeof req_lo, res));
+	ASSERT_EQ(3, s_n_fn_calls);
+
+	mbreg_fn_cache_invalidate(&fn_cache);
+	ASSERT_EQ(6u, mbpdu_handle_req(&inst, req_lo, sizeof req_lo, res));
+	ASSERT_EQ(4, s_n_fn_calls);
+	ASSERT_EQ(1u, fn_cache.n_hits);
+}
+
+static int s_config_locked;
+static int s_n_config_writes;
+static int config_lock(void) {return s_config_locked;}
+static void config_written(void) {++s_n_config_writes;}
+
+TEST(mbreg_callbacks_write_read_and_locked_read)
+{
+	uint16_t config = 0u;
+	uint16_t plain = 0x1111u;
+	const struct mbreg_desc_s regs[] = {
+		{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&plain}, .write={.pu16=&plain}},
+		{.address=0x01u, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&config}, .write={.pu16=&config},
+			REG_CBS(POLICY_CONFIG, .rlock_cb=config_lock, .wlock_cb=config_lock, .post_write_cb=config_written)},
+	};
+	struct mbinst_s inst = {.hold_regs=regs, .n_hold_regs=2u};
+	const uint8_t write_req[] = {MBFC_WRITE_SINGLE_REG, 0x00, 0x01, 0x12, 0x34};
+	const uint8_t read_req[] = {MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x02};
+	const uint8_t plain_req[] = {MBFC_READ_HOLDING_REGS, 0x00, 0x00, 0x00, 0x01};
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	mbinst_init(&inst);
+	s_config_locked = 0;
+	s_n_config_writes = 0;
+
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, write_req, sizeof write_req, res));
+	ASSERT_EQ(0x1234u, config);
+	ASSERT_EQ(1, s_n_config_writes);
+	ASSERT_EQ(6u, mbpdu_handle_req(&inst, read_req, sizeof read_req, res));
+	ASSERT_EQ(0x1111u, betou16(res+2));
+	ASSERT_EQ(0x1234u, betou16(res+4));
+
+	/* Locked reads and writes are refused, the other register is unaffected */
+	s_config_locked = 1;
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, read_req, sizeof read_req, res));
+	ASSERT_EQ(MBFC_READ_HOLDING_REGS|MB_ERR_FLG, res[0]);
+	ASSERT_EQ(MB_ILLEGAL_DATA_ADDR, res[1]);
+	ASSERT_EQ(2u, mbpdu_handle_req(&inst, write_req, sizeof write_req, res));
+	ASSERT_EQ(1, s_n_config_writes);
+	ASSERT_EQ(4u, mbpdu_handle_req(&inst, plain_req, sizeof plain_req, res));
+	ASSERT_EQ(0x1111u, betou16(res+2));
+}
+
 TEST_MAIN(
 	mbreg_invalid_type_size_zero,
 	mbreg_size_calculation_u8,
@@ -329,5 +1195,31 @@ TEST_MAIN(
 	mbreg_write_locked_fails,
 	mbreg_function_write_failure,
 	mbreg_partial_reg_read_works,
-	mbreg_partial_reg_write_works
+	mbreg_partial_reg_write_works,
+	mbreg_index_span_works,
+	mbreg_index_find_matches_search,
+	mbreg_index_build_too_little_storage_fails,
+	mbreg_index_build_overlapping_map_fails,
+	mbreg_index_find_other_map_falls_back,
+	mbreg_cursor_matches_search,
+	mbreg_cursor_with_index_works,
+	mbreg_bulk_u16_block_read_works,
+	mbreg_bulk_u16_block_write_works,
+	mbreg_bulk_u16_block_with_lock_reads_per_element,
+	mbreg_bulk_fn_read_write_works,
+	mbreg_bulk_fn_failure_is_dev_fail,
+	mbreg_bulk_fn_adjacent_descriptors_merged,
+	mbreg_kernels_match_generic_access,
+	mbreg_kernels_write_through_instance,
+	mbreg_byte_order_u32_read_write_works,
+	mbreg_byte_order_u64_and_f64_works,
+	mbreg_byte_order_badc_u16_block_works,
+	mbreg_byte_order_kernels_fall_back,
+	mbreg_memo_calls_each_lock_once,
+	mbreg_validate_checks_map_in_one_pass,
+	mbreg_index_paged_matches_search,
+	mbreg_index_paged_build_fails,
+	mbreg_memo_calls_read_fn_once,
+	mbreg_fn_cache_keeps_values_for_max_age,
+	mbreg_callbacks_write_read_and_locked_read
 );
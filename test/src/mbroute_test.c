@@ -0,0 +1,182 @@
+#include "test_lib.h"
+#include <endian.h>
+#include <mbadu.h>
+#include <mbadu_ascii.h>
+#include <mbadu_tcp.h>
+#include <mbcrc.h>
+#include <mbinst.h>
+#include <mbreg.h>
+#include <mbroute.h>
+#include <mbrtu_rx.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint16_t s_vals[3];
+
+static const struct mbreg_desc_s s_regs[3][1] = {
+	{{.address=0x0000, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&s_vals[0]}, .write={.pu16=&s_vals[0]}}},
+	{{.address=0x0000, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&s_vals[1]}, .write={.pu16=&s_vals[1]}}},
+	{{.address=0x0000, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&s_vals[2]}, .write={.pu16=&s_vals[2]}}},
+};
+
+static struct mbinst_s s_insts[3];
+static struct mbroute_s s_route;
+
+static void setup(void)
+{
+	size_t i;
+
+	mbroute_init(&s_route);
+	for (i=0u; i<3u; ++i) {
+		(void)memset(&s_insts[i], 0, sizeof s_insts[i]);
+		s_insts[i].serial.slave_addr = (uint8_t)(10u+i);
+		s_insts[i].hold_regs = s_regs[i];
+		s_insts[i].n_hold_regs = 1u;
+		mbinst_init(&s_insts[i]);
+		(void)mbroute_set(&s_route, (uint8_t)(10u+i), &s_insts[i]);
+		s_vals[i] = (uint16_t)(0x100u+i);
+	}
+}
+
+static size_t rtu_frame(uint8_t *adu, uint8_t addr, const uint8_t *pdu, size_t pdu_len)
+{
+	adu[0] = addr;
+	memcpy(adu+1, pdu, pdu_len);
+	u16tole(mbcrc16(adu, pdu_len+1u), adu+pdu_len+1u);
+	return pdu_len+3u;
+}
+
+TEST(mbroute_rtu_routes_by_address)
+{
+	const uint8_t pdu[] = {0x03, 0x00, 0x00, 0x00, 0x01};
+	uint8_t req[16], res[MBADU_SIZE_MAX];
+	size_t req_len;
+
+	setup();
+
+	req_len = rtu_frame(req, 11u, pdu, sizeof pdu);
+	ASSERT_EQ(7u, mbroute_handle_req(&s_route, req, req_len, res));
+	ASSERT_EQ(11u, res[0]);
+	ASSERT_EQ(0x0101u, betou16(res+3));
+	ASSERT_EQ(0u, s_insts[0].state.bus_msg_counter);
+	ASSERT_EQ(1u, s_insts[1].state.bus_msg_counter);
+
+	/* Unrouted address */
+	req_len = rtu_frame(req, 20u, pdu, sizeof pdu);
+	ASSERT_EQ(0u, mbroute_handle_req(&s_route, req, req_len, res));
+
+	/* CRC error counted by the addressed slave only */
+	req_len = rtu_frame(req, 12u, pdu, sizeof pdu);
+	req[req_len-1u] ^= 0xFFu;
+	ASSERT_EQ(0u, mbroute_handle_req(&s_route, req, req_len, res));
+	ASSERT_EQ(1u, s_insts[2].state.bus_comm_err_counter);
+	ASSERT_EQ(0u, s_insts[1].state.bus_comm_err_counter);
+}
+
+TEST(mbroute_rtu_broadcast_fans_out)
+{
+	const uint8_t pdu[] = {0x06, 0x00, 0x00, 0x12, 0x34};
+	uint8_t req[16], res[MBADU_SIZE_MAX];
+	size_t req_len;
+
+	setup();
+	ASSERT_EQ(1, mbroute_set(&s_route, 11u, NULL)); /* Removed route */
+
+	req_len = rtu_frame(req, 0u, pdu, sizeof pdu);
+	ASSERT_EQ(0u, mbroute_handle_req(&s_route, req, req_len, res));
+	ASSERT_EQ(0x1234u, s_vals[0]);
+	ASSERT_EQ(0x0101u, s_vals[1]);
+	ASSERT_EQ(0x1234u, s_vals[2]);
+}
+
+TEST(mbroute_ascii_routes_by_address)
+{
+	const char *req = ":0C0300000001F0\r\n";
+	const char *bcast = ":000600001234B4\r\n";
+	uint8_t res[MBADU_ASCII_SIZE_MAX];
+
+	setup();
+
+	ASSERT_EQ(15u, mbroute_ascii_handle_req(&s_route, (const uint8_t *)req, strlen(req), res));
+	ASSERT(memcmp(res, ":0C03020102EC\r\n", 15u) == 0);
+
+	ASSERT_EQ(0u, mbroute_ascii_handle_req(&s_route, (const uint8_t *)bcast, strlen(bcast), res));
+	ASSERT_EQ(0x1234u, s_vals[0]);
+	ASSERT_EQ(0x1234u, s_vals[1]);
+	ASSERT_EQ(0x1234u, s_vals[2]);
+}
+
+TEST(mbroute_tcp_routes_by_unit_id)
+{
+	uint8_t req[] = {0x00, 0x07, 0x00, 0x00, 0x00, 0x06, 0x0A, 0x03, 0x00, 0x00, 0x00, 0x01};
+	uint8_t res[MBADU_TCP_SIZE_MAX];
+
+	setup();
+
+	ASSERT_EQ(11u, mbroute_tcp_handle_req(&s_route, req, sizeof req, res));
+	ASSERT_EQ(0x0007u, betou16(res));
+	ASSERT_EQ(0x0Au, res[6]);
+	ASSERT_EQ(0x0100u, betou16(res+9));
+
+	/* No route, gateway path unavailable */
+	req[6] = 0x01u;
+	ASSERT_EQ(9u, mbroute_tcp_handle_req(&s_route, req, sizeof req, res));
+	ASSERT_EQ(0x0007u, betou16(res));
+	ASSERT_EQ(3u, betou16(res+4));
+	ASSERT_EQ(0x01u, res[6]);
+	ASSERT_EQ(0x83u, res[7]);
+	ASSERT_EQ(MB_GW_PATH_UNAVAIL, res[8]);
+}
+
+TEST(mbroute_set_get_works)
+{
+	struct mbinst_s inst = {0};
+
+	mbroute_init(&s_route);
+	ASSERT_EQ(0, mbroute_set(NULL, 1u, &inst));
+	ASSERT_EQ(NULL, mbroute_get(&s_route, 1u));
+	ASSERT_EQ(1, mbroute_set(&s_route, 1u, &inst));
+	ASSERT_EQ(1, mbroute_set(&s_route, 1u, &inst)); /* Replace */
+	ASSERT_EQ(&inst, mbroute_get(&s_route, 1u));
+	ASSERT_EQ(1u, s_route.n_addrs);
+	ASSERT_EQ(1, mbroute_set(&s_route, 1u, NULL));
+	ASSERT_EQ(NULL, mbroute_get(&s_route, 1u));
+	ASSERT_EQ(0u, s_route.n_addrs);
+}
+
+TEST(mbroute_rtu_rx_routes_received_frame)
+{
+	const uint8_t pdu[] = {0x03, 0x00, 0x00, 0x00, 0x01};
+	uint8_t req[16], res[MBADU_SIZE_MAX];
+	size_t req_len;
+	struct mbrtu_rx_s rx;
+
+	setup();
+	mbrtu_rx_init(&rx, 19200u);
+
+	ASSERT_EQ(0u, mbroute_rtu_rx_handle(&s_route, &rx, res)); /* No frame yet */
+
+	req_len = rtu_frame(req, 12u, pdu, sizeof pdu);
+	ASSERT_EQ(1, mbrtu_rx_recv(&rx, req, req_len, 0u));
+	ASSERT_EQ(7u, mbroute_rtu_rx_handle(&s_route, &rx, res));
+	ASSERT_EQ(12u, res[0]);
+	ASSERT_EQ(0x0102u, betou16(res+3));
+	ASSERT_EQ(1u, s_insts[2].state.bus_msg_counter);
+	ASSERT_EQ(0u, rx.len); /* Ready for the next frame */
+	ASSERT_EQ(MBRTU_RX_IDLE, rx.state);
+
+	/* Unrouted address is dropped but still clears the receiver */
+	req_len = rtu_frame(req, 20u, pdu, sizeof pdu);
+	ASSERT_EQ(1, mbrtu_rx_recv(&rx, req, req_len, 10000u));
+	ASSERT_EQ(0u, mbroute_rtu_rx_handle(&s_route, &rx, res));
+	ASSERT_EQ(MBRTU_RX_IDLE, rx.state);
+}
+
+TEST_MAIN(
+	mbroute_rtu_routes_by_address,
+	mbroute_rtu_broadcast_fans_out,
+	mbroute_ascii_routes_by_address,
+	mbroute_tcp_routes_by_unit_id,
+	mbroute_set_get_works,
+	mbroute_rtu_rx_routes_received_frame
+);
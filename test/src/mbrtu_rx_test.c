@@ -0,0 +1,157 @@
+#include "test_lib.h"
+#include <endian.h>
+#include <mbadu.h>
+#include <mbcrc.h>
+#include <mbinst.h>
+#include <mbreg.h>
+#include <mbrtu_rx.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint16_t s_reg;
+
+static const struct mbreg_desc_s s_regs[] = {
+	{.address=0x0000, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&s_reg}, .write={.pu16=&s_reg}},
+};
+
+static struct mbinst_s s_inst;
+
+static void setup_inst(void)
+{
+	(void)memset(&s_inst, 0, sizeof s_inst);
+	s_inst.serial.slave_addr = 1u;
+	s_inst.hold_regs = s_regs;
+	s_inst.n_hold_regs = 1u;
+	mbinst_init(&s_inst);
+	s_reg = 0x1234u;
+}
+
+static size_t rtu_frame(uint8_t *adu, const uint8_t *pdu, size_t pdu_len)
+{
+	adu[0] = 1u;
+	memcpy(adu+1, pdu, pdu_len);
+	u16tole(mbcrc16(adu, pdu_len+1u), adu+pdu_len+1u);
+	return pdu_len+3u;
+}
+
+TEST(mbrtu_rx_init_timing_works)
+{
+	struct mbrtu_rx_s rx;
+
+	mbrtu_rx_init(&rx, 9600u);
+	ASSERT_EQ(1145u, rx.char_us);
+	ASSERT_EQ(1718u, rx.t15_us);
+	ASSERT_EQ(4010u, rx.t35_us);
+
+	mbrtu_rx_init(&rx, 115200u);
+	ASSERT_EQ(750u, rx.t15_us);
+	ASSERT_EQ(1750u, rx.t35_us);
+}
+
+TEST(mbrtu_rx_completes_known_length_early)
+{
+	const uint8_t pdu[] = {0x03, 0x00, 0x00, 0x00, 0x01};
+	uint8_t req[16], res[MBADU_SIZE_MAX];
+	struct mbrtu_rx_s rx;
+	size_t i, req_len;
+	uint32_t t = 100000u;
+
+	setup_inst();
+	mbrtu_rx_init(&rx, 115200u);
+	req_len = rtu_frame(req, pdu, sizeof pdu);
+
+	/* Byte by byte, complete on the last byte without waiting for t3.5 */
+	for (i=0u; i<req_len-1u; ++i) {
+		ASSERT_EQ(0, mbrtu_rx_recv(&rx, req+i, 1u, t));
+		t += 100u;
+	}
+	ASSERT_EQ(1, mbrtu_rx_recv(&rx, req+i, 1u, t));
+	ASSERT_EQ(7u, mbrtu_rx_handle(&rx, &s_inst, res));
+	ASSERT_EQ(0x1234u, betou16(res+3));
+	ASSERT_EQ(0u, mbrtu_rx_handle(&rx, &s_inst, res)); /* Nothing ready */
+
+	/* Bytes before t3.5 silence are not a new frame */
+	ASSERT_EQ(0, mbrtu_rx_recv(&rx, req, req_len, t+500u));
+	ASSERT_EQ(0, mbrtu_rx_poll(&rx, t+3000u));
+
+	/* Chunk (DMA) after silence */
+	t += 10000u;
+	ASSERT_EQ(1, mbrtu_rx_recv(&rx, req, req_len, t));
+	ASSERT_EQ(7u, mbrtu_rx_handle(&rx, &s_inst, res));
+}
+
+TEST(mbrtu_rx_t35_completes_frame)
+{
+	const uint8_t pdu[] = {0x2B, 0x0D, 0x01, 0x00}; /* Length not predicted (CANopen MEI) */
+	uint8_t req[16], res[MBADU_SIZE_MAX];
+	struct mbrtu_rx_s rx;
+	size_t req_len;
+
+	setup_inst();
+	mbrtu_rx_init(&rx, 115200u);
+	req_len = rtu_frame(req, pdu, sizeof pdu);
+
+	ASSERT_EQ(0, mbrtu_rx_recv(&rx, req, 3u, 10000u));
+	ASSERT_EQ(0, mbrtu_rx_recv(&rx, req+3, req_len-3u, 10300u));
+	ASSERT_EQ(0, mbrtu_rx_poll(&rx, 11000u));
+	ASSERT_EQ(1, mbrtu_rx_poll(&rx, 12050u));
+	ASSERT_EQ(1, mbrtu_rx_poll(&rx, 12060u)); /* Stays ready */
+	ASSERT(mbrtu_rx_handle(&rx, &s_inst, res) > 0u); /* Illegal function response */
+	ASSERT_EQ(0x2Bu|0x80u, res[1]);
+	ASSERT_EQ(0, mbrtu_rx_poll(&rx, 20000u));
+}
+
+TEST(mbrtu_rx_idle_line_completes_frame)
+{
+	const uint8_t pdu[] = {0x2B, 0x0D, 0x01, 0x00};
+	uint8_t req[16];
+	struct mbrtu_rx_s rx;
+	size_t req_len;
+
+	mbrtu_rx_init(&rx, 115200u);
+	req_len = rtu_frame(req, pdu, sizeof pdu);
+
+	ASSERT_EQ(0, mbrtu_rx_recv(&rx, req, 3u, 10000u));
+	ASSERT_EQ(0, mbrtu_rx_idle(&rx)); /* CRC does not match yet */
+	ASSERT_EQ(0, mbrtu_rx_recv(&rx, req+3, req_len-3u, 10300u));
+	ASSERT_EQ(1, mbrtu_rx_idle(&rx));
+	ASSERT_EQ((uint8_t)MBRTU_RX_READY, rx.state);
+}
+
+TEST(mbrtu_rx_bad_frames_discarded)
+{
+	const uint8_t pdu[] = {0x03, 0x00, 0x00, 0x00, 0x01};
+	uint8_t req[16], junk[MBADU_SIZE_MAX+1u];
+	struct mbrtu_rx_s rx;
+	size_t req_len;
+
+	mbrtu_rx_init(&rx, 115200u);
+	req_len = rtu_frame(req, pdu, sizeof pdu);
+
+	/* Gap above t1.5 */
+	ASSERT_EQ(0, mbrtu_rx_recv(&rx, req, 3u, 10000u));
+	ASSERT_EQ(0, mbrtu_rx_recv(&rx, req+3, req_len-3u, 10000u+1000u+5u*87u));
+	ASSERT_EQ(1u, rx.n_gap_errors);
+	ASSERT_EQ(0, mbrtu_rx_poll(&rx, 20000u));
+
+	/* Overrun */
+	memset(junk, 0, sizeof junk);
+	ASSERT_EQ(0, mbrtu_rx_recv(&rx, junk, sizeof junk, 30000u));
+	ASSERT_EQ(1u, rx.n_overruns);
+	ASSERT_EQ(0, mbrtu_rx_recv(&rx, req, req_len, 31000u)); /* Still discarding */
+	ASSERT_EQ(1, mbrtu_rx_recv(&rx, req, req_len, 40000u));
+
+	/* Without t1.5 check */
+	mbrtu_rx_init(&rx, 115200u);
+	rx.t15_us = 0u;
+	ASSERT_EQ(0, mbrtu_rx_recv(&rx, req, 3u, 10000u));
+	ASSERT_EQ(1, mbrtu_rx_recv(&rx, req+3, req_len-3u, 10000u+1000u+5u*87u));
+}
+
+TEST_MAIN(
+	mbrtu_rx_init_timing_works,
+	mbrtu_rx_completes_known_length_early,
+	mbrtu_rx_t35_completes_frame,
+	mbrtu_rx_idle_line_completes_frame,
+	mbrtu_rx_bad_frames_discarded
+);
@@ -0,0 +1,162 @@
+#include "test_lib.h"
+#include <endian.h>
+#include <mbadu_tcp.h>
+#include <mbinst.h>
+#include <mbreg.h>
+#include <mbsched.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint16_t s_vals[4];
+static const struct mbreg_desc_s s_regs[] = {
+	{.address=0x0000, .type=MRTYPE_U16 | MRTYPE_BLOCK, .n_block_entries=4u, .access=MRACC_RW_PTR, .read={.pu16=s_vals}, .write={.pu16=s_vals}},
+};
+static struct mbinst_s s_inst;
+
+static struct mbsched_job_s s_jobs[4];
+static struct mbsched_s s_sched;
+
+/* Transaction ids of the responses in the order they were reported, 0xFFFF for dropped requests */
+static uint16_t s_done[16];
+static size_t s_n_done;
+static void done_cb(void *ctx, const uint8_t *res, size_t res_len)
+{
+	(void)ctx;
+	s_done[s_n_done++] = (res_len!=0u) ? betou16(res+MBAP_POS_TRANS_ID) : 0xFFFFu;
+}
+
+static uint64_t s_now;
+static uint64_t clock_cb(void)
+{
+	return s_now;
+}
+
+/* Every reading advances the clock by 5 ticks */
+static uint64_t step_clock_cb(void)
+{
+	s_now += 5u;
+	return s_now;
+}
+
+static void setup(uint64_t (*clock)(void), uint64_t age_ticks)
+{
+	(void)memset(&s_inst, 0, sizeof s_inst);
+	s_inst.hold_regs = s_regs;
+	s_inst.n_hold_regs = 1u;
+	mbinst_init(&s_inst);
+
+	(void)memset(&s_sched, 0, sizeof s_sched);
+	s_sched.jobs = s_jobs;
+	s_sched.n_jobs = sizeof s_jobs / sizeof s_jobs[0];
+	s_sched.clock_cb = clock;
+	s_sched.done_cb = done_cb;
+	s_sched.age_ticks = age_ticks;
+	mbsched_init(&s_sched);
+
+	s_n_done = 0u;
+	s_now = 0u;
+}
+
+static int submit(uint16_t trans_id, uint8_t fc)
+{
+	uint8_t req[MBAP_SIZE+5u];
+
+	u16tobe(trans_id, req+MBAP_POS_TRANS_ID);
+	u16tobe(MBADU_TCP_PROT_ID, req+MBAP_POS_PROT_ID);
+	u16tobe(6u, req+MBAP_POS_LEN);
+	req[MBAP_POS_UNIT_ID] = 1u;
+	req[MBAP_SIZE] = fc;
+	u16tobe(0u, req+MBAP_SIZE+1u);
+	u16tobe(1u, req+MBAP_SIZE+3u);
+	return mbsched_submit(&s_sched, &s_inst, MBSCHED_TCP, NULL, req, sizeof req);
+}
+
+TEST(mbsched_runs_writes_before_reads)
+{
+	setup(NULL, 0u);
+
+	ASSERT_EQ(1, submit(1u, MBFC_READ_FILE_RECORD));
+	ASSERT_EQ(1, submit(2u, MBFC_READ_HOLDING_REGS));
+	ASSERT_EQ(1, submit(3u, MBFC_WRITE_SINGLE_REG));
+	ASSERT_EQ(1, submit(4u, MBFC_READ_HOLDING_REGS));
+	ASSERT_EQ(4u, mbsched_pending(&s_sched));
+
+	ASSERT_EQ(4u, mbsched_run(&s_sched, 0u));
+	ASSERT_EQ(4u, s_n_done);
+	ASSERT_EQ(3u, s_done[0]);
+	ASSERT_EQ(2u, s_done[1]);
+	ASSERT_EQ(4u, s_done[2]);
+	ASSERT_EQ(1u, s_done[3]);
+	ASSERT_EQ(0u, mbsched_pending(&s_sched));
+	ASSERT_EQ(1u, s_sched.stats[0].n_handled);
+	ASSERT_EQ(2u, s_sched.stats[1].n_handled);
+	ASSERT_EQ(1u, s_sched.stats[2].n_handled);
+}
+
+TEST(mbsched_full_queue_drops_lowest_priority)
+{
+	uint8_t bad[MBAP_SIZE] = {0};
+
+	setup(NULL, 0u);
+
+	ASSERT_EQ(1, submit(1u, MBFC_READ_FILE_RECORD));
+	ASSERT_EQ(1, submit(2u, MBFC_READ_FILE_RECORD));
+	ASSERT_EQ(1, submit(3u, MBFC_READ_HOLDING_REGS));
+	ASSERT_EQ(1, submit(4u, MBFC_WRITE_SINGLE_REG));
+
+	/* Full: a write drops the oldest file read, another file read is refused */
+	ASSERT_EQ(1, submit(5u, MBFC_WRITE_SINGLE_REG));
+	ASSERT_EQ(1u, s_n_done);
+	ASSERT_EQ(0xFFFFu, s_done[0]);
+	ASSERT_EQ(0, submit(6u, MBFC_READ_FILE_RECORD));
+	ASSERT_EQ(2u, s_sched.stats[2].n_dropped);
+
+	/* Too short for the transport */
+	ASSERT_EQ(0, mbsched_submit(&s_sched, &s_inst, MBSCHED_TCP, NULL, bad, sizeof bad));
+
+	ASSERT_EQ(4u, mbsched_run(&s_sched, 0u));
+	ASSERT_EQ(4u, s_done[1]);
+	ASSERT_EQ(5u, s_done[2]);
+	ASSERT_EQ(3u, s_done[3]);
+	ASSERT_EQ(2u, s_done[4]);
+}
+
+TEST(mbsched_aged_request_runs_ahead_of_reads)
+{
+	setup(clock_cb, 100u);
+
+	ASSERT_EQ(1, submit(1u, MBFC_READ_FILE_RECORD));
+	s_now = 150u;
+	ASSERT_EQ(1, submit(2u, MBFC_READ_HOLDING_REGS));
+	ASSERT_EQ(1, submit(3u, MBFC_WRITE_SINGLE_REG));
+
+	ASSERT_EQ(3u, mbsched_run(&s_sched, 0u));
+	ASSERT_EQ(3u, s_done[0]); /* The top priority is never overtaken */
+	ASSERT_EQ(1u, s_done[1]);
+	ASSERT_EQ(2u, s_done[2]);
+	ASSERT_EQ(1u, s_sched.stats[2].n_aged);
+	ASSERT_EQ(150u, s_sched.stats[2].wait_max);
+}
+
+TEST(mbsched_run_stops_at_budget)
+{
+	setup(step_clock_cb, 0u);
+
+	ASSERT_EQ(1, submit(1u, MBFC_READ_HOLDING_REGS));
+	ASSERT_EQ(1, submit(2u, MBFC_READ_HOLDING_REGS));
+	ASSERT_EQ(1, submit(3u, MBFC_READ_HOLDING_REGS));
+
+	/* Each request takes 5 ticks, the budget is checked after each */
+	ASSERT_EQ(2u, mbsched_run(&s_sched, 8u));
+	ASSERT_EQ(1u, mbsched_pending(&s_sched));
+	ASSERT_EQ(5u, s_sched.stats[1].exec_max);
+	ASSERT_EQ(1u, mbsched_run(&s_sched, 8u));
+	ASSERT_EQ(0u, mbsched_run(&s_sched, 8u));
+}
+
+TEST_MAIN(
+	mbsched_runs_writes_before_reads,
+	mbsched_full_queue_drops_lowest_priority,
+	mbsched_aged_request_runs_ahead_of_reads,
+	mbsched_run_stops_at_budget
+);
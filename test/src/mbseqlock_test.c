@@ -0,0 +1,129 @@
+#include "test_lib.h"
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <mbseqlock.h>
+#include <stdint.h>
+
+static struct mbseqlock_s s_lock;
+static uint32_t s_a, s_b;
+static int s_n_b_reads;
+
+static uint32_t read_a(void)
+{
+	return s_a;
+}
+
+/* Writer publishes new values between the two reads of the first attempt */
+static uint32_t read_b(void)
+{
+	if (s_n_b_reads++ == 0) {
+		mbseqlock_write_begin(&s_lock);
+		s_a = 2u;
+		s_b = 2u;
+		mbseqlock_write_end(&s_lock);
+	}
+	return s_b;
+}
+
+static const struct mbreg_desc_s s_regs[] = {
+	{.address=0x00u, .type=MRTYPE_U32, .access=MRACC_R_FN, .read={.fu32=read_a}},
+	{.address=0x02u, .type=MRTYPE_U32, .access=MRACC_R_FN, .read={.fu32=read_b}},
+};
+
+static const uint8_t s_req[] = {
+	MBFC_READ_INPUT_REGS,
+	0x00, 0x00, /* Start addr */
+	0x00, 0x04, /* n read regs */
+};
+
+TEST(mbseqlock_write_makes_seq_odd_then_even)
+{
+	struct mbseqlock_s lock;
+	uint32_t seq;
+
+	mbseqlock_init(&lock);
+	seq = mbseqlock_read_begin(&lock);
+	ASSERT_EQ(0, mbseqlock_read_retry(&lock, seq));
+
+	mbseqlock_write_begin(&lock);
+	ASSERT_EQ(1, mbseqlock_read_retry(&lock, mbseqlock_read_begin(&lock)));
+	mbseqlock_write_end(&lock);
+
+	ASSERT_EQ(1, mbseqlock_read_retry(&lock, seq));
+	seq = mbseqlock_read_begin(&lock);
+	ASSERT_EQ(0, mbseqlock_read_retry(&lock, seq));
+}
+
+TEST(mbseqlock_read_retried_on_concurrent_write)
+{
+	struct mbinst_s inst = {
+		.input_regs=s_regs,
+		.n_input_regs=sizeof s_regs / sizeof s_regs[0],
+		.input_regs_lock=&s_lock,
+	};
+	uint8_t res[MBPDU_SIZE_MAX];
+	size_t res_size;
+
+	mbinst_init(&inst);
+	mbseqlock_init(&s_lock);
+	s_a = 1u;
+	s_b = 1u;
+	s_n_b_reads = 0;
+
+	res_size = mbpdu_handle_req(&inst, s_req, sizeof s_req, res);
+	ASSERT_EQ(10u, res_size);
+	ASSERT_EQ(2, s_n_b_reads);
+	ASSERT_EQ(0x02, res[5]); /* a */
+	ASSERT_EQ(0x02, res[9]); /* b */
+}
+
+TEST(mbseqlock_read_without_lock_can_tear)
+{
+	struct mbinst_s inst = {
+		.input_regs=s_regs,
+		.n_input_regs=sizeof s_regs / sizeof s_regs[0],
+	};
+	uint8_t res[MBPDU_SIZE_MAX];
+	size_t res_size;
+
+	mbinst_init(&inst);
+	s_a = 1u;
+	s_b = 1u;
+	s_n_b_reads = 0;
+
+	res_size = mbpdu_handle_req(&inst, s_req, sizeof s_req, res);
+	ASSERT_EQ(10u, res_size);
+	ASSERT_EQ(1, s_n_b_reads);
+	ASSERT_EQ(0x01, res[5]);
+	ASSERT_EQ(0x02, res[9]);
+}
+
+TEST(mbseqlock_read_busy_while_writing)
+{
+	struct mbinst_s inst = {
+		.input_regs=s_regs,
+		.n_input_regs=sizeof s_regs / sizeof s_regs[0],
+		.input_regs_lock=&s_lock,
+	};
+	uint8_t res[MBPDU_SIZE_MAX];
+	size_t res_size;
+
+	mbinst_init(&inst);
+	mbseqlock_init(&s_lock);
+	s_n_b_reads = 1; /* No concurrent publish from read_b */
+
+	mbseqlock_write_begin(&s_lock);
+	res_size = mbpdu_handle_req(&inst, s_req, sizeof s_req, res);
+	mbseqlock_write_end(&s_lock);
+
+	ASSERT_EQ(2u, res_size);
+	ASSERT_EQ(MBFC_READ_INPUT_REGS | MB_ERR_FLG, res[0]);
+	ASSERT_EQ(MB_BUSY, res[1]);
+}
+
+TEST_MAIN(
+	mbseqlock_write_makes_seq_odd_then_even,
+	mbseqlock_read_retried_on_concurrent_write,
+	mbseqlock_read_without_lock_can_tear,
+	mbseqlock_read_busy_while_writing
+);
@@ -0,0 +1,163 @@
+#include "test_lib.h"
+#include <endian.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <mbshm.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {
+	START = 0x200u,
+	N_REGS = 16u,
+	N_CMDS = 2u,
+};
+
+static uint64_t s_seg[1024]; /* Stands in for the mapped segment */
+static struct mbshm_s s_owner;
+static struct mbshm_s s_server;
+
+static enum mbstatus_e shm_read(uint16_t addr, size_t n, uint8_t *buf)
+{
+	return mbshm_read(&s_server, addr, n, buf);
+}
+
+static enum mbstatus_e shm_write(uint16_t addr, size_t n, const uint8_t *buf)
+{
+	return mbshm_write(&s_server, addr, n, buf);
+}
+
+static const struct mbreg_desc_s s_regs[] = {
+	{
+		.address=START,
+		.type=MRTYPE_U16 | MRTYPE_BLOCK,
+		.n_block_entries=N_REGS,
+		.access=MRACC_RW_BULK,
+		.read={.bulk=shm_read},
+		.write={.bulk=shm_write},
+	},
+};
+
+static int setup(struct mbinst_s *inst)
+{
+	if (!mbshm_format(&s_owner, s_seg, sizeof s_seg, START, N_REGS, N_CMDS)) return 0;
+	if (!mbshm_attach(&s_server, s_seg, sizeof s_seg)) return 0;
+	*inst = (struct mbinst_s){
+		.hold_regs=s_regs,
+		.n_hold_regs=1u,
+		.hold_regs_lock=mbshm_lock(&s_server),
+	};
+	mbinst_init(inst);
+	return 1;
+}
+
+static size_t read_regs(struct mbinst_s *inst, uint16_t addr, uint16_t n, uint8_t *res)
+{
+	uint8_t req[5] = {MBFC_READ_HOLDING_REGS};
+
+	u16tobe(addr, req+1u);
+	u16tobe(n, req+3u);
+	return mbpdu_handle_req(inst, req, sizeof req, res);
+}
+
+static size_t write_reg(struct mbinst_s *inst, uint16_t addr, uint16_t val, uint8_t *res)
+{
+	uint8_t req[5] = {MBFC_WRITE_SINGLE_REG};
+
+	u16tobe(addr, req+1u);
+	u16tobe(val, req+3u);
+	return mbpdu_handle_req(inst, req, sizeof req, res);
+}
+
+TEST(mbshm_attach_validates_segment)
+{
+	struct mbshm_s shm;
+
+	ASSERT_EQ(0, mbshm_format(&shm, s_seg, sizeof s_seg, START, N_REGS, 3u)); /* Not a power of two */
+	ASSERT_EQ(0, mbshm_format(&shm, s_seg, mbshm_size(N_REGS, N_CMDS) - 1u, START, N_REGS, N_CMDS));
+	ASSERT_EQ(0, mbshm_format(&shm, s_seg, sizeof s_seg, 0xFFF8u, N_REGS, N_CMDS));
+
+	memset(s_seg, 0, sizeof s_seg);
+	ASSERT_EQ(0, mbshm_attach(&shm, s_seg, sizeof s_seg)); /* Not formatted */
+
+	ASSERT_EQ(1, mbshm_format(&s_owner, s_seg, sizeof s_seg, START, N_REGS, N_CMDS));
+	ASSERT_EQ(0, mbshm_attach(&shm, s_seg, mbshm_size(N_REGS, N_CMDS) - 1u));
+	ASSERT_EQ(1, mbshm_attach(&shm, s_seg, mbshm_size(N_REGS, N_CMDS)));
+	ASSERT(shm.regs==s_owner.regs);
+	ASSERT(shm.cmds==s_owner.cmds);
+	ASSERT_EQ(0u, (uintptr_t)shm.cmds % 8u);
+}
+
+TEST(mbshm_reads_published_image)
+{
+	struct mbinst_s inst;
+	uint8_t res[MBPDU_SIZE_MAX];
+	uint8_t *img;
+
+	ASSERT_EQ(1, setup(&inst));
+	img = mbshm_update_begin(&s_owner);
+	u16tobe(0x1234u, img + 2u);
+	u16tobe(0x5678u, img + 4u);
+	mbshm_update_end(&s_owner);
+
+	ASSERT_EQ(6u, read_regs(&inst, START + 1u, 2u, res));
+	ASSERT_EQ(4u, res[1]);
+	ASSERT_EQ(0x1234u, betou16(res+2u));
+	ASSERT_EQ(0x5678u, betou16(res+4u));
+
+	ASSERT_EQ(2u, read_regs(&inst, START + N_REGS, 1u, res));
+	ASSERT_EQ(MB_ILLEGAL_DATA_ADDR, res[1]);
+}
+
+TEST(mbshm_read_busy_while_owner_updates)
+{
+	struct mbinst_s inst;
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	ASSERT_EQ(1, setup(&inst));
+	(void)mbshm_update_begin(&s_owner);
+	ASSERT_EQ(2u, read_regs(&inst, START, 1u, res));
+	ASSERT_EQ(MBFC_READ_HOLDING_REGS | MB_ERR_FLG, res[0]);
+	ASSERT_EQ(MB_BUSY, res[1]);
+	mbshm_update_end(&s_owner);
+
+	ASSERT_EQ(4u, read_regs(&inst, START, 1u, res));
+}
+
+TEST(mbshm_writes_pass_through_command_ring)
+{
+	struct mbinst_s inst;
+	struct mbshm_cmd_s cmd;
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	ASSERT_EQ(1, setup(&inst));
+	ASSERT_EQ(0, mbshm_cmd_pop(&s_owner, &cmd));
+
+	ASSERT_EQ(5u, write_reg(&inst, START + 3u, 0xBEEFu, res));
+	ASSERT_EQ(5u, write_reg(&inst, START + 4u, 0xCAFEu, res));
+	ASSERT_EQ(2u, write_reg(&inst, START + 5u, 0x0001u, res)); /* Ring full */
+	ASSERT_EQ(MB_BUSY, res[1]);
+	ASSERT_EQ(1u, s_owner.hdr->n_full);
+
+	ASSERT_EQ(1, mbshm_cmd_pop(&s_owner, &cmd));
+	ASSERT_EQ(START + 3u, cmd.addr);
+	ASSERT_EQ(1u, cmd.n);
+	ASSERT_EQ(0xBEEFu, betou16(cmd.data));
+
+	ASSERT_EQ(5u, write_reg(&inst, START + 5u, 0x0001u, res)); /* Entry reused */
+	ASSERT_EQ(1, mbshm_cmd_pop(&s_owner, &cmd));
+	ASSERT_EQ(0xCAFEu, betou16(cmd.data));
+	ASSERT_EQ(1, mbshm_cmd_pop(&s_owner, &cmd));
+	ASSERT_EQ(START + 5u, cmd.addr);
+	ASSERT_EQ(0, mbshm_cmd_pop(&s_owner, &cmd));
+
+	/* Not visible to reads until the owner applies it */
+	ASSERT_EQ(4u, read_regs(&inst, START + 3u, 1u, res));
+	ASSERT_EQ(0u, betou16(res+2u));
+}
+
+TEST_MAIN(
+	mbshm_attach_validates_segment,
+	mbshm_reads_published_image,
+	mbshm_read_busy_while_owner_updates,
+	mbshm_writes_pass_through_command_ring
+);
@@ -0,0 +1,255 @@
+#include "test_lib.h"
+#include <endian.h>
+#include <mbadu.h>
+#include <mbadu_tcp.h>
+#include <mbcrc.h>
+#include <mbinst.h>
+#include <mbstats.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint64_t s_now;
+
+/* Each reading of the clock advances it, so a handler takes 5 ticks */
+static uint64_t clock_cb(void)
+{
+	uint64_t t = s_now;
+	s_now += 5u;
+	return t;
+}
+
+static uint16_t s_reg_val = 0x1234u;
+static const struct mbreg_desc_s s_regs[] = {
+	{.address=0x10u, .type=MRTYPE_U16, .access=MRACC_RW_PTR, .read={.pu16=&s_reg_val}, .write={.pu16=&s_reg_val}},
+};
+
+struct export_ctx_s {
+	size_t n_calls;
+	uint64_t fc3_count;
+	uint64_t bytes_out;
+};
+
+static void export_cb(void *ctx, const char *name, size_t idx, uint64_t value)
+{
+	struct export_ctx_s *exp = ctx;
+
+	++exp->n_calls;
+	if ((strcmp(name, "fc_count")==0) && (idx==MBFC_READ_HOLDING_REGS)) exp->fc3_count = value;
+	if (strcmp(name, "bytes_out")==0) exp->bytes_out = value;
+}
+
+TEST(mbstats_rtu_request_counted)
+{
+	struct mbstats_s stats;
+	struct mbinst_s inst = {
+		.hold_regs=s_regs,
+		.n_hold_regs=sizeof s_regs / sizeof s_regs[0],
+		.serial={.slave_addr=1u},
+		.stats=&stats,
+	};
+	mbinst_init(&inst);
+	mbstats_init(&stats, clock_cb);
+
+	uint8_t tx_buf[MBADU_SIZE_MAX];
+	uint8_t rx_buf[] = {
+		0x01, /* Slave addr */
+		MBFC_READ_HOLDING_REGS,
+		0x00, 0x10, /* Start addr */
+		0x00, 0x01, /* n read regs */
+		0x00, 0x00, /* CRC */
+	};
+	u16tole(mbcrc16(rx_buf, sizeof rx_buf - 2), rx_buf + sizeof rx_buf - 2);
+
+	ASSERT_EQ(7u, mbadu_handle_req(&inst, rx_buf, sizeof rx_buf, tx_buf));
+
+	ASSERT_EQ(1u, stats.fc_count[MBFC_READ_HOLDING_REGS]);
+	ASSERT_EQ(5u, stats.fc_ticks[MBFC_READ_HOLDING_REGS]);
+	ASSERT_EQ(1u, stats.latency_hist[3]); /* 4 to 7 ticks */
+	ASSERT_EQ(5u, stats.latency_max);
+	ASSERT_EQ(1u, stats.lookup_count[MBSTATS_MAP_HOLD_REGS]);
+	ASSERT_EQ(0u, stats.exception_count);
+	ASSERT_EQ(sizeof rx_buf, stats.bytes_in);
+	ASSERT_EQ(7u, stats.bytes_out);
+
+	/* CRC failure */
+	rx_buf[sizeof rx_buf - 1u] ^= 0xFFu;
+	ASSERT_EQ(0u, mbadu_handle_req(&inst, rx_buf, sizeof rx_buf, tx_buf));
+	ASSERT_EQ(1u, stats.crc_err_count);
+	ASSERT_EQ(1u, stats.fc_count[MBFC_READ_HOLDING_REGS]);
+	ASSERT_EQ(2u*sizeof rx_buf, stats.bytes_in);
+}
+
+TEST(mbstats_tcp_exception_counted)
+{
+	struct mbstats_s stats;
+	struct mbinst_s inst = {
+		.hold_regs=s_regs,
+		.n_hold_regs=sizeof s_regs / sizeof s_regs[0],
+		.stats=&stats,
+	};
+	mbinst_init(&inst);
+	mbstats_init(&stats, NULL);
+
+	uint8_t tx_buf[MBADU_TCP_SIZE_MAX];
+	const uint8_t rx_buf[] = {
+		0x00, 0x01, /* Transaction id */
+		0x00, 0x00, /* Protocol id */
+		0x00, 0x06, /* Length */
+		0x01, /* Unit id */
+		MBFC_READ_HOLDING_REGS,
+		0x00, 0x20, /* Start addr (Missing) */
+		0x00, 0x01, /* n read regs */
+	};
+
+	ASSERT_EQ(9u, mbadu_tcp_handle_req(&inst, rx_buf, sizeof rx_buf, tx_buf));
+
+	ASSERT_EQ(1u, stats.fc_count[MBFC_READ_HOLDING_REGS]);
+	ASSERT_EQ(1u, stats.exception_count);
+	ASSERT_EQ(0u, stats.fc_ticks[MBFC_READ_HOLDING_REGS]); /* Without clock */
+	ASSERT_EQ(0u, stats.latency_hist[0]);
+	ASSERT_EQ(sizeof rx_buf, stats.bytes_in);
+	ASSERT_EQ(9u, stats.bytes_out);
+}
+
+TEST(mbstats_worker_does_not_share_stats)
+{
+	struct mbstats_s stats;
+	struct mbinst_s worker;
+	struct mbinst_s base = {
+		.hold_regs=s_regs,
+		.n_hold_regs=sizeof s_regs / sizeof s_regs[0],
+		.stats=&stats,
+	};
+
+	mbinst_init_worker(&worker, &base);
+	ASSERT(worker.stats == NULL);
+	ASSERT(base.stats == &stats);
+}
+
+TEST(mbstats_sum_and_export)
+{
+	struct mbstats_s a, b, sum;
+	const struct mbstats_s *blocks[] = {&a, NULL, &b};
+	struct export_ctx_s exp = {0};
+
+	mbstats_init(&a, NULL);
+	mbstats_init(&b, NULL);
+	a.fc_count[MBFC_READ_HOLDING_REGS] = 2u;
+	b.fc_count[MBFC_READ_HOLDING_REGS] = 3u;
+	a.latency_max = 10u;
+	b.latency_max = 7u;
+	b.bytes_out = 100u;
+
+	mbstats_sum(&sum, blocks, sizeof blocks / sizeof blocks[0]);
+	ASSERT_EQ(5u, sum.fc_count[MBFC_READ_HOLDING_REGS]);
+	ASSERT_EQ(10u, sum.latency_max);
+	ASSERT_EQ(100u, sum.bytes_out);
+
+	mbstats_export(&sum, export_cb, &exp);
+	ASSERT_EQ(3u, exp.n_calls); /* Only non-zero counters */
+	ASSERT_EQ(5u, exp.fc3_count);
+	ASSERT_EQ(100u, exp.bytes_out);
+}
+
+TEST(mbstats_long_latency_in_last_bucket)
+{
+	struct mbstats_s stats;
+
+	mbstats_init(&stats, clock_cb);
+	s_now = UINT64_MAX - 4u; /* Read at the start of the request */
+	mbstats_count_req(&stats, MBFC_READ_COILS, 0u);
+	ASSERT_EQ(1u, stats.latency_hist[MBSTATS_N_BUCKETS-1u]);
+	ASSERT_EQ(UINT64_MAX - 4u, stats.latency_max);
+}
+
+TEST(mbstats_bytes_counted_per_transport)
+{
+	struct mbstats_s stats;
+
+	mbstats_init(&stats, NULL);
+	mbstats_count_bytes(&stats, MBSTATS_TR_ASCII, 17u, 0u);
+	mbstats_count_bytes(&stats, MBSTATS_TR_ASCII, 0u, 15u);
+	mbstats_count_bytes(&stats, MBSTATS_TR_TCP, 12u, 11u);
+
+	ASSERT_EQ(1u, stats.tr_frames_in[MBSTATS_TR_ASCII]);
+	ASSERT_EQ(17u, stats.tr_bytes_in[MBSTATS_TR_ASCII]);
+	ASSERT_EQ(15u, stats.tr_bytes_out[MBSTATS_TR_ASCII]);
+	ASSERT_EQ(1u, stats.tr_frames_in[MBSTATS_TR_TCP]);
+	ASSERT_EQ(0u, stats.tr_frames_in[MBSTATS_TR_RTU]);
+	ASSERT_EQ(29u, stats.bytes_in);
+	ASSERT_EQ(26u, stats.bytes_out);
+}
+
+static struct mbstats_s s_win_stats;
+static enum mbstatus_e stats_regs(uint16_t addr, size_t n, uint8_t *buf)
+{
+	return mbstats_read_regs(&s_win_stats, (uint16_t)(addr - 0x8000u), n, buf);
+}
+static const struct mbreg_desc_s s_win_regs[] = {
+	{
+		.address=0x8000u,
+		.type=MRTYPE_U16 | MRTYPE_BLOCK,
+		.n_block_entries=MBSTATS_N_REGS,
+		.access=MRACC_R_BULK,
+		.read={.bulk=stats_regs},
+	},
+};
+
+TEST(mbstats_read_regs_through_input_regs)
+{
+	uint8_t res[MBPDU_SIZE_MAX];
+	uint8_t req[] = {MBFC_READ_INPUT_REGS, 0x80, 0x00, 0x00, 0x08};
+	struct mbinst_s inst = {
+		.input_regs=s_win_regs,
+		.n_input_regs=1u,
+		.stats=&s_win_stats,
+	};
+	mbinst_init(&inst);
+	mbstats_init(&s_win_stats, clock_cb);
+	s_win_stats.fc_count[MBFC_READ_COILS] = 0x100000000u;
+	s_win_stats.fc_ticks[MBFC_READ_COILS] = 0x300000000u;
+	s_win_stats.exception_count = 0x0102030405060708u;
+
+	ASSERT_EQ(18u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(16u, res[1]);
+	ASSERT_EQ(0x0000u, betou16(res+2u)); /* REQ_COUNT, the current request is not counted yet */
+	ASSERT_EQ(0x0001u, betou16(res+4u));
+	ASSERT_EQ(0x0000u, betou16(res+6u));
+	ASSERT_EQ(0x0000u, betou16(res+8u));
+	ASSERT_EQ(0x0102u, betou16(res+10u)); /* EXCEPTION_COUNT */
+	ASSERT_EQ(0x0708u, betou16(res+16u));
+
+	/* Start in the middle of a counter */
+	u16tobe(0x8000u + MBSTATS_REG_LATENCY_AVG + 3u, req+1u);
+	u16tobe(1u, req+3u);
+	ASSERT_EQ(4u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(3u, betou16(res+2u));
+
+	/* Per function code count, now including the first request */
+	u16tobe(0x8000u + MBSTATS_REG_FC_COUNT + (4u*MBFC_READ_INPUT_REGS), req+1u);
+	u16tobe(4u, req+3u);
+	ASSERT_EQ(10u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(2u, betou16(res+8u));
+}
+
+TEST(mbstats_read_regs_outside_window)
+{
+	struct mbstats_s stats;
+	uint8_t buf[8];
+
+	mbstats_init(&stats, NULL);
+	ASSERT_EQ(MB_OK, mbstats_read_regs(&stats, MBSTATS_N_REGS - 4u, 4u, buf));
+	ASSERT_EQ(MB_ILLEGAL_DATA_ADDR, mbstats_read_regs(&stats, MBSTATS_N_REGS - 3u, 4u, buf));
+	ASSERT_EQ(MB_ILLEGAL_DATA_ADDR, mbstats_read_regs(&stats, 0u, MBSTATS_N_REGS + 1u, NULL));
+}
+
+TEST_MAIN(
+	mbstats_rtu_request_counted,
+	mbstats_tcp_exception_counted,
+	mbstats_worker_does_not_share_stats,
+	mbstats_sum_and_export,
+	mbstats_long_latency_in_last_bucket,
+	mbstats_bytes_counted_per_transport,
+	mbstats_read_regs_through_input_regs,
+	mbstats_read_regs_outside_window
+);
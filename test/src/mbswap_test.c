@@ -0,0 +1,139 @@
+#include "test_lib.h"
+#include <endian.h>
+#include <mbcache.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <mbplan.h>
+#include <mbswap.h>
+#include <stdint.h>
+#include <string.h>
+
+static const struct mbreg_desc_s s_regs_a[] = {
+	{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=0xAAAAu}},
+};
+static const struct mbreg_desc_s s_regs_b[] = {
+	{.address=0x00u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=0xBBBBu}},
+	{.address=0x01u, .type=MRTYPE_U16, .access=MRACC_R_VAL, .read={.u16=0xBBBCu}},
+};
+
+static uint16_t s_ix_bufs[2][8];
+static struct mbswap_set_s s_sets[2];
+static struct mbswap_reader_s s_readers[2];
+static struct mbswap_s s_swap = {.readers=s_readers, .n_readers=2u};
+
+static int prepare_set(struct mbswap_set_s *set, const struct mbreg_desc_s *regs, size_t n_regs, uint16_t *ix_buf)
+{
+	memset(set, 0, sizeof *set);
+	set->maps.hold_regs = regs;
+	set->maps.n_hold_regs = n_regs;
+	set->prep.ix_buf = ix_buf;
+	set->prep.ix_buf_len = 8u;
+	return mbinst_prepare(&set->maps, &set->prep);
+}
+
+static uint16_t read_reg(struct mbinst_s *inst, uint16_t addr)
+{
+	uint8_t req[5] = {MBFC_READ_HOLDING_REGS};
+	uint8_t res[MBPDU_SIZE_MAX];
+
+	u16tobe(addr, req+1u);
+	u16tobe(1u, req+3u);
+	if (mbpdu_handle_req(inst, req, sizeof req, res) != 4u) return 0u;
+	return betou16(res+2u);
+}
+
+TEST(mbswap_requests_in_flight_finish_on_old_set)
+{
+	struct mbinst_s workers[2] = {0};
+
+	ASSERT_EQ(1, prepare_set(&s_sets[0], s_regs_a, 1u, s_ix_bufs[0]));
+	ASSERT_EQ(1, prepare_set(&s_sets[1], s_regs_b, 2u, s_ix_bufs[1]));
+	mbinst_init(&workers[0]);
+	mbinst_init(&workers[1]);
+	mbswap_init(&s_swap, &s_sets[0]);
+
+	mbswap_enter(&s_swap, 0u, &workers[0]); /* Request in flight on A */
+	ASSERT_EQ(1, mbswap_publish(&s_swap, &s_sets[1]));
+	ASSERT_EQ(0, mbswap_publish(&s_swap, &s_sets[0])); /* A not reclaimed yet */
+
+	mbswap_enter(&s_swap, 1u, &workers[1]);
+	ASSERT_EQ(0xBBBCu, read_reg(&workers[1], 0x01u));
+	ASSERT(workers[1].hold_regs_ix == &s_sets[1].prep.hold_regs_ix);
+	mbswap_exit(&s_swap, 1u);
+
+	ASSERT_EQ(0xAAAAu, read_reg(&workers[0], 0x00u));
+	ASSERT(mbswap_reclaim(&s_swap) == NULL);
+	mbswap_exit(&s_swap, 0u);
+	ASSERT(mbswap_reclaim(&s_swap) == &s_sets[0]);
+	ASSERT(mbswap_reclaim(&s_swap) == NULL);
+
+	mbswap_enter(&s_swap, 0u, &workers[0]); /* Next request on B */
+	ASSERT_EQ(0xBBBBu, read_reg(&workers[0], 0x00u));
+	mbswap_exit(&s_swap, 0u);
+}
+
+TEST(mbswap_reused_set_is_applied_again)
+{
+	struct mbinst_s worker = {0};
+
+	ASSERT_EQ(1, prepare_set(&s_sets[0], s_regs_a, 1u, s_ix_bufs[0]));
+	ASSERT_EQ(1, prepare_set(&s_sets[1], s_regs_b, 2u, s_ix_bufs[1]));
+	mbinst_init(&worker);
+	mbswap_init(&s_swap, &s_sets[0]);
+
+	mbswap_enter(&s_swap, 0u, &worker);
+	mbswap_exit(&s_swap, 0u);
+	ASSERT_EQ(1, mbswap_publish(&s_swap, &s_sets[1]));
+	ASSERT(mbswap_reclaim(&s_swap) == &s_sets[0]); /* No reader on A */
+
+	/* Reclaimed set loaded with a new map and published again */
+	ASSERT_EQ(1, prepare_set(&s_sets[0], s_regs_b, 1u, s_ix_bufs[0]));
+	ASSERT_EQ(1, mbswap_publish(&s_swap, &s_sets[0]));
+	mbswap_enter(&s_swap, 0u, &worker);
+	ASSERT_EQ(1u, worker.n_hold_regs);
+	ASSERT_EQ(0xBBBBu, read_reg(&worker, 0x00u));
+	mbswap_exit(&s_swap, 0u);
+}
+
+TEST(mbswap_apply_drops_worker_caches)
+{
+	static struct mbreg_desc_s regs[1];
+	static struct mbcache_entry_s cache_entries[2];
+	static struct mbplan_entry_s plan_entries[2];
+	struct mbcache_s cache = {.entries=cache_entries, .n_entries=2u};
+	struct mbplan_s plan = {.entries=plan_entries, .n_entries=2u};
+	struct mbinst_s worker = {.cache=&cache, .plan=&plan};
+
+	regs[0] = s_regs_a[0];
+	ASSERT_EQ(1, prepare_set(&s_sets[0], regs, 1u, s_ix_bufs[0]));
+	ASSERT_EQ(1, prepare_set(&s_sets[1], s_regs_b, 2u, s_ix_bufs[1]));
+	mbinst_init(&worker);
+	mbcache_init(&cache);
+	mbplan_init(&plan);
+	mbswap_init(&s_swap, &s_sets[0]);
+
+	mbswap_enter(&s_swap, 0u, &worker);
+	ASSERT_EQ(0xAAAAu, read_reg(&worker, 0x00u));
+	mbswap_exit(&s_swap, 0u);
+	ASSERT_EQ(1u, plan.n_misses);
+
+	/* Same descriptor array refilled in place and published again */
+	ASSERT_EQ(1, mbswap_publish(&s_swap, &s_sets[1]));
+	ASSERT(mbswap_reclaim(&s_swap) == &s_sets[0]);
+	regs[0] = s_regs_b[0];
+	ASSERT_EQ(1, prepare_set(&s_sets[0], regs, 1u, s_ix_bufs[0]));
+	ASSERT_EQ(1, mbswap_publish(&s_swap, &s_sets[0]));
+
+	mbswap_enter(&s_swap, 0u, &worker);
+	ASSERT_EQ(0xBBBBu, read_reg(&worker, 0x00u));
+	mbswap_exit(&s_swap, 0u);
+	ASSERT_EQ(0u, cache.n_hits);
+	ASSERT_EQ(0u, plan.n_hits);
+	ASSERT_EQ(1u, plan.n_misses); /* Recorded again in the emptied table */
+}
+
+TEST_MAIN(
+	mbswap_requests_in_flight_finish_on_old_set,
+	mbswap_reused_set_is_applied_again,
+	mbswap_apply_drops_worker_caches
+);
@@ -503,7 +503,7 @@ TEST(mbtest_regs_invalid_data_type_fails)
 	const struct mbreg_desc_s regs[] = {
 		{
 			.address=0x0001,
-			.type=0x1000, /* Invalid type */
+			.type=MRTYPE_SIZE_16 | MRTYPE_SIGNED | MRTYPE_UNSIGNED, /* Invalid type, fits compact descriptors */
 			.access=MRACC_R_PTR,
 			.read={.pu16=&test_val}
 		}
@@ -753,6 +753,79 @@ TEST(mbtest_regs_validate_all_passes_valid_config)
 	ASSERT_EQ(1, result); /* Should pass all validations */
 }
 
+static enum mbstatus_e dummy_bulk_read(uint16_t addr, size_t n, uint8_t *bits)
+{
+	(void)addr; (void)n; (void)bits;
+	return MB_OK;
+}
+
+TEST(mbtest_coils_block_access)
+{
+	uint8_t bits[4] = {0};
+	const struct mbcoil_desc_s valid[] = {
+		{.address=0x0000, .access=MCACC_R_PTR, .read={.ptr=bits}, .n_block_entries=32},
+		{.address=0x0020, .access=MCACC_R_BULK, .read={.bulk=dummy_bulk_read}, .n_block_entries=100},
+		{.address=0x0084, .access=MCACC_R_VAL, .read={.val=1}},
+	};
+	const struct mbcoil_desc_s fn_block[] = {
+		{.address=0x0010, .access=MCACC_R_FN, .read={.fn=test_coil_read_fn}, .n_block_entries=8},
+	};
+	const struct mbcoil_desc_s null_bulk[] = {
+		{.address=0x0010, .access=MCACC_R_BULK, .read={.bulk=NULL}, .n_block_entries=8},
+	};
+	uint16_t issue_addr = 0;
+
+	ASSERT_EQ(1, mbtest_coils_validate_all(valid, 3, &issue_addr));
+
+	ASSERT_EQ(0, mbtest_coils_validate_all(fn_block, 1, &issue_addr));
+	ASSERT_EQ(0x0010, issue_addr);
+
+	issue_addr = 0;
+	ASSERT_EQ(0, mbtest_coils_validate_all(null_bulk, 1, &issue_addr));
+	ASSERT_EQ(0x0010, issue_addr);
+}
+
+TEST(mbtest_coils_block_overlap_fails)
+{
+	uint8_t bits[4] = {0};
+	const struct mbcoil_desc_s overlap[] = {
+		{.address=0x0000, .access=MCACC_R_PTR, .read={.ptr=bits}, .n_block_entries=32},
+		{.address=0x001F, .access=MCACC_R_VAL, .read={.val=1}},
+	};
+	const struct mbcoil_desc_s past_end[] = {
+		{.address=0xFFF0, .access=MCACC_R_PTR, .read={.ptr=bits}, .n_block_entries=17},
+	};
+	uint16_t issue_addr = 0;
+
+	ASSERT_EQ(0, mbtest_coils_validate_all(overlap, 2, &issue_addr));
+	ASSERT_EQ(0x001F, issue_addr);
+
+	ASSERT_EQ(0, mbtest_coils_dont_overlap(past_end, 1, &issue_addr));
+	ASSERT_EQ(0xFFF0, issue_addr);
+}
+
+static enum mbstatus_e dummy_reg_bulk_read(uint16_t addr, size_t n, uint8_t *buf)
+{
+	(void)addr; (void)n; (void)buf;
+	return MB_OK;
+}
+
+TEST(mbtest_regs_bulk_access)
+{
+	const struct mbreg_desc_s valid[] = {
+		{.address=0x0000, .type=MRTYPE_U16|MRTYPE_BLOCK, .access=MRACC_R_BULK, .read={.bulk=dummy_reg_bulk_read}, .n_block_entries=10},
+		{.address=0x000A, .type=MRTYPE_U32, .access=MRACC_R_BULK, .read={.bulk=dummy_reg_bulk_read}},
+	};
+	const struct mbreg_desc_s null_bulk[] = {
+		{.address=0x0010, .type=MRTYPE_U16, .access=MRACC_R_BULK, .read={.bulk=NULL}},
+	};
+	uint16_t issue_addr = 0;
+
+	ASSERT_EQ(1, mbtest_regs_validate_all(valid, 2, &issue_addr));
+	ASSERT_EQ(0, mbtest_regs_validate_all(null_bulk, 1, &issue_addr));
+	ASSERT_EQ(0x0010, issue_addr);
+}
+
 TEST_MAIN(
 	mbtest_coils_not_ascending_fails,
 	mbtest_coils_duplicate_address_fails,
@@ -785,5 +858,8 @@ TEST_MAIN(
 	mbtest_regs_null_issue_addr_works,
 	mbtest_single_register_validation,
 	mbtest_regs_validate_all_fails_on_any_error,
-	mbtest_regs_validate_all_passes_valid_config
+	mbtest_regs_validate_all_passes_valid_config,
+	mbtest_coils_block_access,
+	mbtest_coils_block_overlap_fails,
+	mbtest_regs_bulk_access
 )
@@ -0,0 +1,184 @@
+#include "test_lib.h"
+#include "test_policy.h"
+#include <endian.h>
+#include <mbinst.h>
+#include <mbpdu.h>
+#include <mbtrace.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint64_t s_now;
+
+/* Each reading of the clock advances it, so every event takes at least 5 ticks */
+static uint64_t clock_cb(void)
+{
+	uint64_t t = s_now;
+	s_now += 5u;
+	return t;
+}
+
+/* Stands in for the instance, records numbered by their t */
+static void fill(struct mbtrace_s *trace, uint32_t n)
+{
+	uint32_t i;
+	for (i=0u; i<n; ++i) {
+		trace->recs[trace->head & (trace->n_recs - 1u)].t = trace->head;
+		++trace->head;
+	}
+}
+
+TEST(mbtrace_init_requires_power_of_two)
+{
+	struct mbtrace_s trace;
+	struct mbtrace_rec_s recs[8];
+
+	ASSERT_EQ(0, mbtrace_init(NULL, recs, 8u, clock_cb));
+	ASSERT_EQ(0, mbtrace_init(&trace, NULL, 8u, clock_cb));
+	ASSERT_EQ(0, mbtrace_init(&trace, recs, 0u, clock_cb));
+	ASSERT_EQ(0, mbtrace_init(&trace, recs, 6u, clock_cb));
+	ASSERT(trace.recs == NULL);
+	ASSERT_EQ(1, mbtrace_init(&trace, recs, 8u, clock_cb));
+	ASSERT_EQ(8u, trace.n_recs);
+	ASSERT_EQ(0u, trace.head);
+}
+
+TEST(mbtrace_read_in_chunks)
+{
+	struct mbtrace_s trace;
+	struct mbtrace_rec_s recs[8];
+	struct mbtrace_rec_s out[8];
+	uint32_t pos = 0u;
+	mbtrace_init(&trace, recs, 8u, clock_cb);
+
+	ASSERT_EQ(0u, mbtrace_read(&trace, &pos, out, 8u));
+	fill(&trace, 5u);
+	ASSERT_EQ(3u, mbtrace_read(&trace, &pos, out, 3u));
+	ASSERT_EQ(0u, out[0].t);
+	ASSERT_EQ(2u, out[2].t);
+	ASSERT_EQ(3u, pos);
+	ASSERT_EQ(2u, mbtrace_read(&trace, &pos, out, 8u));
+	ASSERT_EQ(3u, out[0].t);
+	ASSERT_EQ(4u, out[1].t);
+	ASSERT_EQ(0u, mbtrace_read(&trace, &pos, out, 8u));
+	ASSERT_EQ(5u, pos);
+}
+
+TEST(mbtrace_read_skips_overwritten)
+{
+	struct mbtrace_s trace;
+	struct mbtrace_rec_s recs[8];
+	struct mbtrace_rec_s out[8];
+	uint32_t pos = 0u;
+	mbtrace_init(&trace, recs, 8u, clock_cb);
+
+	fill(&trace, 20u);
+	ASSERT_EQ(7u, mbtrace_read(&trace, &pos, out, 8u));
+	ASSERT_EQ(13u, out[0].t); /* Records 0..12 are lost */
+	ASSERT_EQ(19u, out[6].t);
+	ASSERT_EQ(20u, pos);
+}
+
+TEST(mbtrace_read_across_counter_wrap)
+{
+	struct mbtrace_s trace;
+	struct mbtrace_rec_s recs[4];
+	struct mbtrace_rec_s out[4];
+	uint32_t pos = 0xFFFFFFFEu;
+	mbtrace_init(&trace, recs, 4u, clock_cb);
+	trace.head = 0xFFFFFFFEu;
+
+	fill(&trace, 3u);
+	ASSERT_EQ(3u, mbtrace_read(&trace, &pos, out, 4u));
+	ASSERT_EQ(0xFFFFFFFEu, out[0].t);
+	ASSERT_EQ(0u, out[2].t);
+	ASSERT_EQ(1u, pos);
+}
+
+#if MBCFG_TRACE
+static uint16_t s_regs_val[4];
+static size_t s_n_post_writes;
+static void post_write_cb(void)
+{
+	++s_n_post_writes;
+}
+#if MBCFG_COMPACT_REGS
+const struct mbreg_policy_s mbreg_policies[] = {
+	{0},
+	{.post_write_cb=post_write_cb},
+};
+#endif
+static const struct mbreg_desc_s s_regs[] = {
+	{
+		.address=0x100u,
+		.type=MRTYPE_U16 | MRTYPE_BLOCK,
+		.n_block_entries=4u,
+		.access=MRACC_RW_PTR,
+		.read={.pu16=s_regs_val},
+		.write={.pu16=s_regs_val},
+		REG_CBS(1u, .post_write_cb=post_write_cb),
+	},
+};
+
+TEST(mbtrace_records_request_events)
+{
+	struct mbtrace_s trace;
+	struct mbtrace_rec_s recs[16];
+	struct mbtrace_rec_s out[16];
+	uint32_t pos = 0u;
+	size_t n;
+	uint8_t req[] = {MBFC_WRITE_SINGLE_REG, 0x01, 0x02, 0x12, 0x34};
+	uint8_t res[MBPDU_SIZE_MAX];
+	struct mbinst_s inst = {.hold_regs=s_regs, .n_hold_regs=1u, .trace=&trace};
+	mbinst_init(&inst);
+	mbtrace_init(&trace, recs, 16u, clock_cb);
+	s_n_post_writes = 0u;
+
+	ASSERT_EQ(5u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(1u, s_n_post_writes);
+
+	n = mbtrace_read(&trace, &pos, out, 16u);
+	ASSERT(n >= 2u);
+	ASSERT_EQ(MBTRACE_EV_CB, out[n-2u].ev);
+	ASSERT_EQ(MBFC_WRITE_SINGLE_REG, out[n-2u].fc);
+	ASSERT_EQ(0x102u, out[n-2u].addr);
+	ASSERT(out[n-2u].dur >= 5u);
+
+	ASSERT_EQ(MBTRACE_EV_REQ, out[n-1u].ev); /* Request ends last */
+	ASSERT_EQ(MBFC_WRITE_SINGLE_REG, out[n-1u].fc);
+	ASSERT_EQ(0x102u, out[n-1u].addr);
+	ASSERT(out[n-1u].t <= out[n-2u].t);
+	ASSERT(out[n-1u].dur > out[n-2u].dur);
+}
+
+TEST(mbtrace_without_clock_records_nothing)
+{
+	struct mbtrace_s trace;
+	struct mbtrace_rec_s recs[4];
+	uint8_t req[] = {MBFC_READ_HOLDING_REGS, 0x01, 0x00, 0x00, 0x01};
+	uint8_t res[MBPDU_SIZE_MAX];
+	struct mbinst_s inst = {.hold_regs=s_regs, .n_hold_regs=1u, .trace=&trace};
+	mbinst_init(&inst);
+	mbtrace_init(&trace, recs, 4u, NULL);
+
+	ASSERT_EQ(4u, mbpdu_handle_req(&inst, req, sizeof req, res));
+	ASSERT_EQ(0u, trace.head);
+}
+#endif
+
+#if MBCFG_TRACE
+TEST_MAIN(
+	mbtrace_init_requires_power_of_two,
+	mbtrace_read_in_chunks,
+	mbtrace_read_skips_overwritten,
+	mbtrace_read_across_counter_wrap,
+	mbtrace_records_request_events,
+	mbtrace_without_clock_records_nothing
+);
+#else
+TEST_MAIN(
+	mbtrace_init_requires_power_of_two,
+	mbtrace_read_in_chunks,
+	mbtrace_read_skips_overwritten,
+	mbtrace_read_across_counter_wrap
+);
+#endif
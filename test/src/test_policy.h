@@ -0,0 +1,23 @@
+/**
+ * @file test_policy.h
+ * @brief Register callbacks of test fixtures with and without MBCFG_COMPACT_REGS
+ */
+#ifndef TEST_POLICY_H_INCLUDED
+#define TEST_POLICY_H_INCLUDED
+
+#include <mbreg.h>
+
+/*
+ * Callbacks of a register descriptor initializer. Compact descriptors name
+ * their entry of mbreg_policies instead, a test using them defines a table
+ * holding the same callbacks at that index.
+ *
+ * E.g. {.address=0u, ..., REG_CBS(1u, .rlock_cb=lock_cb)}
+ */
+#if MBCFG_COMPACT_REGS
+#define REG_CBS(policy_ix, ...) .policy=(policy_ix)
+#else
+#define REG_CBS(policy_ix, ...) __VA_ARGS__
+#endif
+
+#endif /* TEST_POLICY_H_INCLUDED */
@@ -0,0 +1,7 @@
+#include <mbreg.h>
+
+/* Policy table of test binaries defining none. Linked from an archive, so a
+   test with its own mbreg_policies replaces it. */
+const struct mbreg_policy_s mbreg_policies[] = {
+	{0},
+};
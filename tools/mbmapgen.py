@@ -0,0 +1,418 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2025 Siemens Energy AS
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OR CONDITIONS OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OR CONDITIONS
+# OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+# EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+# OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+# (INCLUDING NEGLIGENCE) OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+# THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+# Authorized representative: Edgar Vorland, SE TI EAD MF&P SUS OMS, Group Manager Electronics
+#
+"""Register map compiler
+
+Reads a register map (CSV or JSON) and generates:
+  <out>.h        Declarations of the descriptor tables
+  <out>.c        Descriptor tables and bulk callbacks of hot ranges
+  <out>_check.c  <prefix>_validate(), mbtest assertions for unit tests
+
+Each row describes one register with the fields:
+  map         hold | input
+  address     Start address, decimal or 0x prefixed hex
+  name        Name used in comments (optional)
+  type        u8 u16 u32 u64 i8 i16 i32 i64 f32 f64
+  access      r | rw | const
+  source      C lvalue backing the register (r/rw), literal value (const),
+              or fn:read_fn[/write_fn] for callback backed registers
+  post_write  Post write callback (optional)
+  hot         1 to serve the row from a generated bulk callback (optional)
+  order       Byte order abcd | cdab | badc | dcba (optional, default of the map)
+
+Consecutive pointer backed rows of the same type and access, at contiguous
+addresses, with sources that are consecutive array elements (a[3], a[4]) or
+fields of one struct variable (s.a, s.b), are merged into one MRTYPE_BLOCK
+descriptor. Adjacency of merged struct fields is checked by <prefix>_validate().
+
+Consecutive hot rows at contiguous addresses form one range served by a
+generated MRACC_R_BULK (and MRACC_W_BULK for rw ranges) callback, converting
+each field with straight-line code instead of the generic type switch of
+mbreg_read(). Bulk callbacks are not word swapped (mbinst_s::swap_words).
+
+Usage: mbmapgen.py [--prefix P] [--include H]... -o OUT MAP.csv|MAP.json
+"""
+
+import argparse
+import csv
+import json
+import os
+import re
+import sys
+
+TYPES = {
+	# name: (MRTYPE, C type, size in registers, union suffix, be encoder, be decoder)
+	'u8': ('MRTYPE_U8', 'uint8_t', 1, 'u8', 'u16tobe((uint16_t)v, buf)', '(uint8_t)betou16(buf)'),
+	'u16': ('MRTYPE_U16', 'uint16_t', 1, 'u16', 'u16tobe(v, buf)', 'betou16(buf)'),
+	'u32': ('MRTYPE_U32', 'uint32_t', 2, 'u32', 'u32tobe(v, buf)', 'betou32(buf)'),
+	'u64': ('MRTYPE_U64', 'uint64_t', 4, 'u64', 'u64tobe(v, buf)', 'betou64(buf)'),
+	'i8': ('MRTYPE_I8', 'int8_t', 1, 'i8', 'i16tobe((int16_t)v, buf)', '(int8_t)betoi16(buf)'),
+	'i16': ('MRTYPE_I16', 'int16_t', 1, 'i16', 'i16tobe(v, buf)', 'betoi16(buf)'),
+	'i32': ('MRTYPE_I32', 'int32_t', 2, 'i32', 'i32tobe(v, buf)', 'betoi32(buf)'),
+	'i64': ('MRTYPE_I64', 'int64_t', 4, 'i64', 'i64tobe(v, buf)', 'betoi64(buf)'),
+	'f32': ('MRTYPE_F32', 'float', 2, 'f32', 'f32tobe(v, buf)', 'betof32(buf)'),
+	'f64': ('MRTYPE_F64', 'double', 4, 'f64', 'f64tobe(v, buf)', 'betof64(buf)'),
+}
+
+ORDERS = {
+	'abcd': 'MBREG_ORDER_ABCD',
+	'cdab': 'MBREG_ORDER_CDAB',
+	'badc': 'MBREG_ORDER_BADC',
+	'dcba': 'MBREG_ORDER_DCBA',
+}
+
+MAPS = {
+	'hold': 'hold_regs',
+	'input': 'input_regs',
+}
+
+RE_ARRAY_ELEM = re.compile(r'^(?P<base>.+)\[(?P<ix>\d+)\]$')
+RE_STRUCT_FIELD = re.compile(r'^(?P<base>[A-Za-z_][\w\.\[\]]*?)\.(?P<field>[A-Za-z_]\w*)$')
+
+
+class MapError(Exception):
+	pass
+
+
+def parse_int(text, what):
+	try:
+		return int(str(text).strip(), 0)
+	except ValueError:
+		raise MapError(f'invalid {what} "{text}"') from None
+
+
+def load_rows(path):
+	if path.endswith('.json'):
+		with open(path, encoding='utf-8') as f:
+			data = json.load(f)
+		if isinstance(data, dict):
+			data = data.get('registers', [])
+		return [{k: ('' if v is None else str(v)) for k, v in row.items()} for row in data]
+
+	with open(path, newline='', encoding='utf-8') as f:
+		return [row for row in csv.DictReader(f) if any((v or '').strip() for v in row.values())]
+
+
+def parse_row(row, line):
+	def field(key, default=''):
+		return (row.get(key) or default).strip()
+
+	reg = {'line': line}
+	reg['map'] = field('map').lower()
+	if reg['map'] not in MAPS:
+		raise MapError(f'row {line}: map must be one of {", ".join(MAPS)}')
+	reg['address'] = parse_int(field('address'), f'address on row {line}')
+	if not 0 <= reg['address'] <= 0xFFFF:
+		raise MapError(f'row {line}: address out of range')
+	reg['name'] = field('name')
+	reg['type'] = field('type').lower()
+	if reg['type'] not in TYPES:
+		raise MapError(f'row {line}: unknown type "{reg["type"]}"')
+	reg['access'] = field('access').lower()
+	if reg['access'] not in ('r', 'rw', 'const'):
+		raise MapError(f'row {line}: access must be r, rw or const')
+	reg['source'] = field('source')
+	if not reg['source']:
+		raise MapError(f'row {line}: missing source')
+	reg['post_write'] = field('post_write')
+	reg['hot'] = field('hot') in ('1', 'true', 'yes')
+	reg['order'] = field('order').lower()
+	if reg['order'] and reg['order'] not in ORDERS:
+		raise MapError(f'row {line}: order must be one of {", ".join(ORDERS)}')
+	if reg['order'] and reg['hot']:
+		raise MapError(f'row {line}: hot rows are served in the default order')
+
+	reg['read_fn'] = reg['write_fn'] = ''
+	if reg['source'].startswith('fn:'):
+		fns = reg['source'][3:].split('/')
+		reg['read_fn'] = fns[0].strip()
+		reg['write_fn'] = fns[1].strip() if len(fns) > 1 else ''
+		if reg['access'] == 'const' or (reg['access'] == 'rw') != bool(reg['write_fn']):
+			raise MapError(f'row {line}: fn: sources need read_fn for r and read_fn/write_fn for rw')
+		if reg['hot']:
+			raise MapError(f'row {line}: only variable backed rows can be hot')
+	elif reg['hot'] and reg['access'] == 'const':
+		raise MapError(f'row {line}: only variable backed rows can be hot')
+	if reg['map'] == 'input' and reg['access'] == 'rw':
+		raise MapError(f'row {line}: input registers are read only')
+
+	reg['size'] = TYPES[reg['type']][2]
+	return reg
+
+
+def check_layout(regs):
+	for prev, reg in zip(regs, regs[1:]):
+		if reg['address'] < prev['address'] + prev['size']:
+			raise MapError(f'row {reg["line"]}: address 0x{reg["address"]:04X} overlaps row {prev["line"]}')
+
+
+def is_ptr(reg):
+	return reg['access'] in ('r', 'rw') and not reg['read_fn']
+
+
+def adjacent_source(a, b):
+	"""Whether b is the element or field right after a, 'array', 'struct' or None"""
+	ma, mb = RE_ARRAY_ELEM.match(a), RE_ARRAY_ELEM.match(b)
+	if ma and mb and ma['base'] == mb['base'] and int(mb['ix']) == int(ma['ix']) + 1:
+		return 'array'
+	ma, mb = RE_STRUCT_FIELD.match(a), RE_STRUCT_FIELD.match(b)
+	if ma and mb and ma['base'] == mb['base'] and ma['field'] != mb['field']:
+		return 'struct'
+	return None
+
+
+def group(regs):
+	"""Split a sorted map into hot ranges, blocks and single descriptors"""
+	out = []
+	for reg in regs:
+		last = out[-1] if out else None
+		contiguous = last is not None and reg['address'] == last['end']
+
+		if reg['hot']:
+			if contiguous and last['kind'] == 'hot' and (reg['access'] == 'rw') == last['rw']:
+				last['rows'].append(reg)
+				last['end'] = reg['address'] + reg['size']
+				continue
+			out.append({'kind': 'hot', 'rows': [reg], 'address': reg['address'],
+				'end': reg['address'] + reg['size'], 'rw': reg['access'] == 'rw'})
+			continue
+
+		if (contiguous and last['kind'] in ('single', 'block') and is_ptr(reg) and is_ptr(last['rows'][-1])
+				and reg['type'] == last['rows'][-1]['type'] and reg['access'] == last['rows'][-1]['access']
+				and reg['post_write'] == last['rows'][-1]['post_write'] and reg['order'] == last['rows'][-1]['order']):
+			adj = adjacent_source(last['rows'][-1]['source'], reg['source'])
+			if adj is not None:
+				last['kind'] = 'block'
+				last['rows'].append(reg)
+				last['end'] = reg['address'] + reg['size']
+				if adj == 'struct':
+					last['checks'].append((last['rows'][-2]['source'], reg['source']))
+				continue
+
+		out.append({'kind': 'single', 'rows': [reg], 'address': reg['address'],
+			'end': reg['address'] + reg['size'], 'checks': []})
+	return out
+
+
+def comment(rows):
+	names = [r['name'] for r in rows if r['name']]
+	if not names:
+		return ''
+	if len(names) > 3:
+		names = [names[0], '...', names[-1]]
+	return ' /* ' + ', '.join(names) + ' */'
+
+
+def emit_desc(entry, table, hot_ix):
+	first = entry['rows'][0]
+	mrtype, _, _, sfx, _, _ = TYPES[first['type']]
+	lines = ['\t{' + comment(entry['rows'])]
+	lines.append(f'\t\t.address=0x{entry["address"]:04X}u,')
+
+	if entry['kind'] == 'hot':
+		fn = f'{table}_hot{hot_ix}'
+		lines.append('\t\t.type=MRTYPE_U16 | MRTYPE_BLOCK,')
+		lines.append(f'\t\t.access={"MRACC_RW_BULK" if entry["rw"] else "MRACC_R_BULK"},')
+		lines.append(f'\t\t.read={{.bulk={fn}_read}},')
+		if entry['rw']:
+			lines.append(f'\t\t.write={{.bulk={fn}_write}},')
+		lines.append(f'\t\t.n_block_entries={entry["end"] - entry["address"]}u,')
+	else:
+		is_block = entry['kind'] == 'block'
+		lines.append(f'\t\t.type={mrtype} | MRTYPE_BLOCK,' if is_block else f'\t\t.type={mrtype},')
+		if first['access'] == 'const':
+			lines.append('\t\t.access=MRACC_R_VAL,')
+			lines.append(f'\t\t.read={{.{sfx}={first["source"]}}},')
+		elif first['read_fn']:
+			lines.append(f'\t\t.access={"MRACC_RW_FN" if first["write_fn"] else "MRACC_R_FN"},')
+			lines.append(f'\t\t.read={{.f{sfx}={first["read_fn"]}}},')
+			if first['write_fn']:
+				lines.append(f'\t\t.write={{.f{sfx}={first["write_fn"]}}},')
+		else:
+			ptr = '&' + first['source']
+			lines.append(f'\t\t.access={"MRACC_RW_PTR" if first["access"] == "rw" else "MRACC_R_PTR"},')
+			lines.append(f'\t\t.read={{.p{sfx}={ptr}}},')
+			if first['access'] == 'rw':
+				lines.append(f'\t\t.write={{.p{sfx}={ptr}}},')
+		if is_block:
+			lines.append(f'\t\t.n_block_entries={len(entry["rows"])}u,')
+		if first['order']:
+			lines.append(f'\t\t.byte_order={ORDERS[first["order"]]},')
+		if first['post_write']:
+			lines.append(f'\t\t.post_write_cb={first["post_write"]},')
+	lines[-1] = lines[-1].rstrip(',')
+	lines.append('\t},')
+	return lines
+
+
+def emit_hot(entry, table, hot_ix):
+	fn = f'{table}_hot{hot_ix}'
+	base = entry['address']
+	n = entry['end'] - base
+	out = []
+	if base == 0:
+		range_check = f'\tif (((size_t)addr + n) > {n}u) return MB_DEV_FAIL;'
+	else:
+		range_check = f'\tif ((addr < 0x{base:04X}u) || (((size_t)addr - 0x{base:04X}u + n) > {n}u)) return MB_DEV_FAIL;'
+
+	out.append(f'/**\n * @brief Read registers 0x{base:04X} to 0x{entry["end"]-1:04X}\n */')
+	out.append(f'static enum mbstatus_e {fn}_read(uint16_t addr, size_t n, uint8_t *buf)')
+	out.append('{')
+	out.append(f'\tuint8_t image[{n*2}u];')
+	out.append('')
+	out.append(range_check)
+	out.append('')
+	for reg in entry['rows']:
+		_, _, _, _, enc, _ = TYPES[reg['type']]
+		enc = enc.replace('v,', f'{reg["source"]},').replace('buf)', f'image+{(reg["address"]-base)*2}u)')
+		out.append(f'\t{enc};' + comment([reg]))
+	out.append(f'\t(void)memcpy(buf, image + ((size_t)addr - 0x{base:04X}u)*2u, n*2u);')
+	out.append('')
+	out.append('\treturn MB_OK;')
+	out.append('}')
+	out.append('')
+
+	if not entry['rw']:
+		return out
+
+	out.append(f'/**\n * @brief Write registers 0x{base:04X} to 0x{entry["end"]-1:04X}, partially written fields keep their other words\n */')
+	out.append(f'static enum mbstatus_e {fn}_write(uint16_t addr, size_t n, const uint8_t *buf)')
+	out.append('{')
+	out.append(f'\tuint8_t image[{n*2}u];')
+	out.append('\tsize_t lo, hi;')
+	out.append('')
+	out.append(range_check)
+	out.append(f'\t(void){fn}_read(0x{base:04X}u, {n}u, image);')
+	out.append(f'\t(void)memcpy(image + ((size_t)addr - 0x{base:04X}u)*2u, buf, n*2u);')
+	out.append('')
+	out.append(f'\tlo = (size_t)addr - 0x{base:04X}u;')
+	out.append('\thi = lo + n;')
+	for reg in entry['rows']:
+		_, _, size, _, _, dec = TYPES[reg['type']]
+		offs = reg['address'] - base
+		dec = dec.replace('buf)', f'image+{offs*2}u)')
+		out.append(f'\tif ((lo < {offs+size}u) && (hi > {offs}u)) {reg["source"]} = {dec};' + comment([reg]))
+	out.append('')
+	out.append('\treturn MB_OK;')
+	out.append('}')
+	out.append('')
+	return out
+
+
+def generate(regs, prefix, includes, out):
+	tables = {}
+	for key, suffix in MAPS.items():
+		rows = sorted((r for r in regs if r['map'] == key), key=lambda r: r['address'])
+		if rows:
+			check_layout(rows)
+			tables[f'{prefix}_{suffix}'] = group(rows)
+
+	base = os.path.basename(out)
+	guard = re.sub(r'\W', '_', base).upper() + '_H_INCLUDED'
+	banner = f'/* Generated by tools/mbmapgen.py, do not edit */\n'
+
+	h = [banner, f'#ifndef {guard}', f'#define {guard}', '', '#include "mbreg.h"', '#include <stddef.h>', '#include <stdint.h>', '']
+	for table in tables:
+		h.append(f'extern const struct mbreg_desc_s {table}[];')
+		h.append(f'extern const size_t {table.replace(prefix + "_", prefix + "_n_", 1)};')
+		h.append('')
+	h.append('/**')
+	h.append(' * @brief Validate the generated tables with mbtest (Unit testing only)')
+	h.append(' *')
+	h.append(' * @param issue_addr Out parameter with the address of the first issue (Can be NULL)')
+	h.append(' *')
+	h.append(' * @retval 1 Valid')
+	h.append(' * @retval 0 Invalid')
+	h.append(' */')
+	h.append(f'extern int {prefix}_validate(uint16_t *issue_addr);')
+	h.append('')
+	h.append(f'#endif /* {guard} */')
+
+	c = [banner, f'#include "{base}.h"', '#include "endian.h"', '#include "mbdef.h"', '#include "mbreg.h"']
+	c += [f'#include {inc}' if inc[0] in '<"' else f'#include "{inc}"' for inc in includes]
+	c += ['#include <stddef.h>', '#include <stdint.h>', '#include <string.h>', '']
+	for table, entries in tables.items():
+		hot = [e for e in entries if e['kind'] == 'hot']
+		for i, entry in enumerate(hot):
+			c += emit_hot(entry, table, i)
+	for table, entries in tables.items():
+		c.append(f'const struct mbreg_desc_s {table}[] = {{')
+		hot_ix = 0
+		for entry in entries:
+			c += emit_desc(entry, table, hot_ix)
+			hot_ix += entry['kind'] == 'hot'
+		c.append('};')
+		c.append(f'const size_t {table.replace(prefix + "_", prefix + "_n_", 1)} = sizeof {table} / sizeof {table}[0];')
+		c.append('')
+
+	t = [banner, f'#include "{base}.h"', '#include "mbtest.h"']
+	t += [f'#include {inc}' if inc[0] in '<"' else f'#include "{inc}"' for inc in includes]
+	t += ['#include <stddef.h>', '#include <stdint.h>', '']
+	t.append(f'extern int {prefix}_validate(uint16_t *issue_addr)')
+	t.append('{')
+	for table, entries in tables.items():
+		n = table.replace(prefix + '_', prefix + '_n_', 1)
+		t.append(f'\tif (!mbtest_regs_validate_all({table}, {n}, issue_addr)) return 0;')
+	for table, entries in tables.items():
+		for entry in entries:
+			for a, b in entry.get('checks', []):
+				ctype = TYPES[entry['rows'][0]['type']][1]
+				t.append(f'\tif ((const volatile {ctype} *)&{b} != (const volatile {ctype} *)&{a} + 1) {{ /* Merged into one block */')
+				t.append(f'\t\tif (issue_addr) *issue_addr = 0x{entry["address"]:04X}u;')
+				t.append('\t\treturn 0;')
+				t.append('\t}')
+	t.append('')
+	t.append('\treturn 1;')
+	t.append('}')
+
+	for path, lines in ((out + '.h', h), (out + '.c', c), (out + '_check.c', t)):
+		with open(path, 'w', encoding='utf-8') as f:
+			f.write('\n'.join(lines).rstrip('\n') + '\n')
+
+	return {table: len(entries) for table, entries in tables.items()}
+
+
+def main():
+	ap = argparse.ArgumentParser(description='Generate C register descriptor tables from a CSV or JSON map')
+	ap.add_argument('map', help='Register map (.csv or .json)')
+	ap.add_argument('-o', '--out', required=True, help='Output path without extension')
+	ap.add_argument('--prefix', default='app', help='Prefix of the generated symbols (Default: app)')
+	ap.add_argument('--include', action='append', default=[], help='Header declaring the sources (Repeatable)')
+	args = ap.parse_args()
+
+	try:
+		rows = load_rows(args.map)
+		regs = [parse_row(row, i + 2) for i, row in enumerate(rows)]
+		counts = generate(regs, args.prefix, args.include, args.out)
+	except (MapError, OSError, json.JSONDecodeError) as e:
+		print(f'{args.map}: {e}', file=sys.stderr)
+		return 1
+
+	for table, n in counts.items():
+		print(f'{table}: {n} descriptors')
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit(main())